@@ -0,0 +1,349 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Factory tool: bulk generation of device keys, CSRs and DI m-strings.
+ *
+ * Generates the credentials of a batch of devices on all cores, one device
+ * at a time per thread. Each device gets a directory named after its serial
+ * number, laid out as the storage layer of the device expects it:
+ *
+ *   <out>/<serial>/data/...privkey.*       device private key (ECDSA_PRIVKEY)
+ *   <out>/<serial>/data/manufacturer_sn.bin serial number (SERIAL_FILE)
+ *   <out>/<serial>/data/manufacturer_mod.bin model number (MODEL_FILE)
+ *   <out>/<serial>/csr.pem                  device CSR
+ *   <out>/<serial>/m_string.bin             m-string DI sends in msg10
+ *
+ * The key, serial and model files are copied into the data directory of the
+ * device when it is flashed; the CSR and m-string let the manufacturer
+ * server side be prepared ahead of DI.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "util.h"
+#include "safe_lib.h"
+#include "sdoprot.h"
+#include "storage_al.h"
+#include "ec_key.h"
+
+#define FACTORY_MAX_DEVICES 1000000
+#define FACTORY_MAX_THREADS 256
+#define FACTORY_SERIAL_LEN 31
+
+enum {
+	FACTORY_KEYGEN,
+	FACTORY_CSR,
+	FACTORY_M_STRING,
+	FACTORY_WRITE,
+	FACTORY_NUM_STAGES
+};
+
+typedef struct {
+	uint32_t done;
+	uint32_t failed;
+	uint64_t stage_us[FACTORY_NUM_STAGES];
+} factory_stats_t;
+
+static const char *const factory_stage_names[FACTORY_NUM_STAGES] = {
+    "keygen", "csr", "m-string", "write"};
+
+static struct {
+	const char *out_dir;
+	const char *prefix;
+	const char *model;
+	uint32_t first;
+	uint32_t devices;
+	uint32_t threads;
+
+	pthread_mutex_t lock;
+	uint32_t next;
+	factory_stats_t total;
+} factory;
+
+static uint64_t factory_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/* Add the time since *t to stage and restart *t */
+static void factory_lap(factory_stats_t *st, int stage, uint64_t *t)
+{
+	uint64_t now = factory_now_us();
+
+	st->stage_us[stage] += now - *t;
+	*t = now;
+}
+
+/* Create every missing directory on the way to the file at path */
+static bool factory_mkdirs(const char *path)
+{
+	char dir[PATH_MAX];
+	char *p;
+
+	if (strcpy_s(dir, sizeof(dir), path) != 0)
+		return false;
+	for (p = dir + 1; *p; p++) {
+		if (*p != '/')
+			continue;
+		*p = '\0';
+		if (mkdir(dir, 0700) != 0 && errno != EEXIST)
+			return false;
+		*p = '/';
+	}
+	return true;
+}
+
+/* Store len bytes at <dev>/<file> through the storage layer */
+static bool factory_put(const char *dev, const char *file,
+			const uint8_t *data, size_t len)
+{
+	char path[PATH_MAX];
+
+	if (snprintf(path, sizeof(path), "%s/%s", dev, file) >=
+		(int)sizeof(path) ||
+	    !factory_mkdirs(path)) {
+		fprintf(stderr, "factory: bad path %s/%s\n", dev, file);
+		return false;
+	}
+	if (sdo_blob_write(path, SDO_SDK_RAW_DATA, data, (uint32_t)len) !=
+	    (int32_t)len) {
+		fprintf(stderr, "factory: cannot write %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Generate and store the credentials of device number idx.
+ */
+static bool factory_device(uint32_t idx, factory_stats_t *st)
+{
+	char serial[FACTORY_SERIAL_LEN + 1];
+	char dev[PATH_MAX];
+	EC_KEY *ec_key = NULL;
+	uint8_t *privkey = NULL;
+	size_t privkey_len = 0;
+	sdo_byte_array_t *csr = NULL;
+	sdo_byte_array_t *m_string = NULL;
+	uint64_t t = factory_now_us();
+	bool ret = false;
+
+	if (snprintf(serial, sizeof(serial), "%s%08u", factory.prefix,
+		     factory.first + idx) >= (int)sizeof(serial) ||
+	    snprintf(dev, sizeof(dev), "%s/%s", factory.out_dir, serial) >=
+		(int)sizeof(dev))
+		goto end;
+
+	ec_key = ec_key_generate();
+	if (!ec_key || ec_key_to_buf(ec_key, &privkey, &privkey_len) != 0)
+		goto end;
+	factory_lap(st, FACTORY_KEYGEN, &t);
+
+	if (ec_key_get_csr(ec_key, &csr) != 0)
+		goto end;
+	factory_lap(st, FACTORY_CSR, &t);
+
+	m_string = sdo_m_string_build(serial, factory.model, csr);
+	if (!m_string)
+		goto end;
+	factory_lap(st, FACTORY_M_STRING, &t);
+
+	if (!factory_put(dev, ECDSA_PRIVKEY, privkey, privkey_len) ||
+	    !factory_put(dev, SERIAL_FILE, (const uint8_t *)serial,
+			 strnlen_s(serial, sizeof(serial))) ||
+	    !factory_put(dev, MODEL_FILE, (const uint8_t *)factory.model,
+			 strnlen_s(factory.model, SDO_MAX_STR_SIZE)) ||
+	    !factory_put(dev, "csr.pem", csr->bytes, csr->byte_sz) ||
+	    !factory_put(dev, "m_string.bin", m_string->bytes,
+			 m_string->byte_sz))
+		goto end;
+	factory_lap(st, FACTORY_WRITE, &t);
+	ret = true;
+
+end:
+	if (!ret)
+		fprintf(stderr, "factory: device %u failed\n",
+			factory.first + idx);
+	if (privkey) {
+		if (memset_s(privkey, privkey_len, 0) != 0)
+			ret = false;
+		sdo_free(privkey);
+	}
+	if (ec_key)
+		EC_KEY_free(ec_key);
+	if (csr)
+		sdo_byte_array_free(csr);
+	if (m_string)
+		sdo_byte_array_free(m_string);
+	return ret;
+}
+
+/**
+ * Worker thread: take the next device number until the batch is done.
+ */
+static void *factory_worker(void *arg)
+{
+	factory_stats_t st = {0};
+	uint32_t idx;
+	int i;
+
+	(void)arg;
+	for (;;) {
+		pthread_mutex_lock(&factory.lock);
+		idx = factory.next;
+		if (idx < factory.devices)
+			factory.next++;
+		pthread_mutex_unlock(&factory.lock);
+		if (idx >= factory.devices)
+			break;
+
+		if (factory_device(idx, &st))
+			st.done++;
+		else
+			st.failed++;
+	}
+
+	pthread_mutex_lock(&factory.lock);
+	factory.total.done += st.done;
+	factory.total.failed += st.failed;
+	for (i = 0; i < FACTORY_NUM_STAGES; i++)
+		factory.total.stage_us[i] += st.stage_us[i];
+	pthread_mutex_unlock(&factory.lock);
+	return NULL;
+}
+
+static void factory_usage(const char *prog)
+{
+	printf("Usage: %s -o DIR [options]\n"
+	       "  -o DIR  output directory, one subdirectory per device\n"
+	       "  -n N    devices (default 1)\n"
+	       "  -j N    threads (default: online cores)\n"
+	       "  -s STR  serial number prefix (default SDO)\n"
+	       "  -f N    number of the first device (default 0)\n"
+	       "  -m STR  model number (default 0)\n",
+	       prog);
+}
+
+static bool factory_parse_args(int argc, char **argv)
+{
+	unsigned long v;
+	char *end;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "o:n:j:s:f:m:h")) != -1) {
+		switch (opt) {
+		case 'o':
+			factory.out_dir = optarg;
+			continue;
+		case 's':
+			factory.prefix = optarg;
+			continue;
+		case 'm':
+			factory.model = optarg;
+			continue;
+		case 'n':
+		case 'j':
+		case 'f':
+			break;
+		default:
+			factory_usage(argv[0]);
+			return false;
+		}
+		v = strtoul(optarg, &end, 10);
+		if (*end || v > UINT32_MAX) {
+			factory_usage(argv[0]);
+			return false;
+		}
+		if (opt == 'n')
+			factory.devices = (uint32_t)v;
+		else if (opt == 'j')
+			factory.threads = (uint32_t)v;
+		else
+			factory.first = (uint32_t)v;
+	}
+
+	if (!factory.out_dir) {
+		factory_usage(argv[0]);
+		return false;
+	}
+	/* The m-string limits serial and model numbers to 31 characters */
+	if (!factory.devices || factory.devices > FACTORY_MAX_DEVICES ||
+	    !factory.threads || factory.threads > FACTORY_MAX_THREADS ||
+	    strnlen_s(factory.prefix, FACTORY_SERIAL_LEN) + 8 >
+		FACTORY_SERIAL_LEN ||
+	    strnlen_s(factory.model, FACTORY_SERIAL_LEN + 1) >
+		FACTORY_SERIAL_LEN) {
+		fprintf(stderr, "factory: parameters out of range\n");
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t threads[FACTORY_MAX_THREADS];
+	uint32_t i, started = 0;
+	uint64_t t0;
+	double wall;
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+	factory.prefix = "SDO";
+	factory.model = "0";
+	factory.devices = 1;
+	factory.threads = cores > 0 ? (uint32_t)cores : 1;
+	if (factory.threads > FACTORY_MAX_THREADS)
+		factory.threads = FACTORY_MAX_THREADS;
+	if (!factory_parse_args(argc, argv))
+		return 2;
+
+	/* The device paths are placed below each device directory */
+	if (ECDSA_PRIVKEY[0] == '/' || SERIAL_FILE[0] == '/' ||
+	    MODEL_FILE[0] == '/') {
+		fprintf(stderr, "factory: blob paths are absolute, build with "
+				"a relative BLOB_PATH\n");
+		return 2;
+	}
+	if (pthread_mutex_init(&factory.lock, NULL) != 0)
+		return 1;
+
+	t0 = factory_now_us();
+	for (i = 0; i < factory.threads; i++) {
+		if (pthread_create(&threads[i], NULL, factory_worker, NULL) !=
+		    0)
+			break;
+		started++;
+	}
+	/* The calling thread works too if not all threads could start */
+	if (!started)
+		factory_worker(NULL);
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	wall = (double)(factory_now_us() - t0) / 1000000.0;
+	pthread_mutex_destroy(&factory.lock);
+
+	printf("%u devices in %.3f s on %u threads: %.1f devices/s\n",
+	       factory.total.done, wall, started ? started : 1,
+	       wall > 0.0 ? factory.total.done / wall : 0.0);
+	printf("\n%-10s %12s\n", "stage", "avg/device");
+	for (i = 0; factory.total.done && i < FACTORY_NUM_STAGES; i++)
+		printf("%-10s %9.3f ms\n", factory_stage_names[i],
+		       (double)factory.total.stage_us[i] / 1000.0 /
+			   factory.total.done);
+	if (factory.total.failed)
+		printf("\n%u devices failed\n", factory.total.failed);
+	return factory.total.failed ? 1 : 0;
+}
@@ -102,7 +102,7 @@ static sdo_sdk_service_info_module *sdo_sv_info_modules_init(void)
 	sdo_sdk_service_info_module *module_info = NULL;
 
 #ifdef MODULES_ENABLED
-	module_info = malloc(SDO_MAX_MODULES * (sizeof(*module_info)));
+	module_info = calloc(SDO_MAX_MODULES, sizeof(*module_info));
 
 	if (!module_info) {
 		LOG(LOG_ERROR, "Malloc failed!\n");
@@ -116,7 +116,8 @@ static sdo_sdk_service_info_module *sdo_sv_info_modules_init(void)
 		free(module_info);
 		return NULL;
 	}
-	module_info[0].service_info_callback = sdo_sys;
+	module_info[0].service_info_callback_v2 = sdo_sys;
+	module_info[0].flags = SDO_SI_FLAG_DECODE_B64 | SDO_SI_FLAG_ASYNC_OSI;
 
 #if defined(EXTRA_MODULES)
 	/* module#2: devconfig */
@@ -21,6 +21,7 @@ if(TARGET_OS MATCHES linux)
     -DMANUFACTURER_IP=\"${BLOB_PATH}/data/manufacturer_ip.bin\"
     -DMANUFACTURER_DN=\"${BLOB_PATH}/data/manufacturer_dn.bin\"
     -DMANUFACTURER_PORT=\"${BLOB_PATH}/data/manufacturer_port.bin\"
+    -DSDO_CRED_STORE=\"${BLOB_PATH}/data/cred.store\"
     )
   if (${DA} MATCHES tpm)
     client_sdk_compile_definitions(
@@ -54,7 +55,9 @@ if(TARGET_OS MATCHES linux)
         -DSDO_CRED_SECURE=\"${BLOB_PATH}/data/Secure.blob\"
         -DSDO_CRED_MFG=\"${BLOB_PATH}/data/Mfg.blob\"
         -DSDO_CRED_NORMAL=\"${BLOB_PATH}/data/Normal.blob\"
+        -DSDO_CRED_SNAPSHOT=\"${BLOB_PATH}/data/Normal.snap\"
         -DRAW_BLOB=\"${BLOB_PATH}/data/raw.blob\"
+        -DSDO_TO2_CHECKPOINT=\"${BLOB_PATH}/data/to2_checkpoint.blob\"
         )
     else() 				#Not unit tests
       if (${DA} MATCHES ecdsa256)	#ecdsa 256 selected
@@ -81,7 +84,9 @@ if(TARGET_OS MATCHES linux)
 	-DSDO_CRED_SECURE=\"${BLOB_PATH}/data/Secure.blob\"
 	-DSDO_CRED_MFG=\"${BLOB_PATH}/data/Mfg.blob\"
 	-DSDO_CRED_NORMAL=\"${BLOB_PATH}/data/Normal.blob\"
+	-DSDO_CRED_SNAPSHOT=\"${BLOB_PATH}/data/Normal.snap\"
 	-DRAW_BLOB=\"${BLOB_PATH}/data/raw.blob\"
+	-DSDO_TO2_CHECKPOINT=\"${BLOB_PATH}/data/to2_checkpoint.blob\"
 	)
     endif()
     if (NOT(${HTTPPROXY} STREQUAL ""))
@@ -114,7 +119,9 @@ if(TARGET_OS MATCHES linux)
 	-DSDO_CRED_SECURE=\"${BLOB_PATH}/data/Secure.blob\"
 	-DSDO_CRED_MFG=\"${BLOB_PATH}/data/Mfg.blob\"
 	-DSDO_CRED_NORMAL=\"${BLOB_PATH}/data/Normal.blob\"
+	-DSDO_CRED_SNAPSHOT=\"${BLOB_PATH}/data/Normal.snap\"
 	-DRAW_BLOB=\"${BLOB_PATH}/data/raw.blob\"
+	-DSDO_TO2_CHECKPOINT=\"${BLOB_PATH}/data/to2_checkpoint.blob\"
 	)
       if (${DA_FILE} MATCHES pem)
 	client_sdk_compile_definitions(
@@ -132,7 +139,9 @@ if(TARGET_OS MATCHES linux)
 	-DSDO_CRED_SECURE=\"${BLOB_PATH}/data/Secure.blob\"
 	-DSDO_CRED_MFG=\"${BLOB_PATH}/data/Mfg.blob\"
 	-DSDO_CRED_NORMAL=\"${BLOB_PATH}/data/Normal.blob\"
-	-DRAW_BLOB=\"${BLOB_PATH}/data/raw.blob\")
+	-DSDO_CRED_SNAPSHOT=\"${BLOB_PATH}/data/Normal.snap\"
+	-DRAW_BLOB=\"${BLOB_PATH}/data/raw.blob\"
+	-DSDO_TO2_CHECKPOINT=\"${BLOB_PATH}/data/to2_checkpoint.blob\")
 
       if (${DA} MATCHES ecdsa256)
 	if (${DA_FILE} MATCHES pem)
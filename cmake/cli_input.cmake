@@ -25,6 +25,7 @@ set (CRYPTO_HW false)
 set (ARCH x86)
 set (RETRY true)
 set (unit-test false)
+set (loopback-test false)
 set (MANUFACTURER_TOOLKIT false)
 set (STORAGE true)
 set (BOARD NUCLEO_F767ZI)
@@ -32,6 +33,11 @@ set (BLOB_PATH .)
 set (TPM2_TCTI_TYPE tabrmd)
 set (RESALE false)
 set (REUSE true)
+set (CRED_STORE false)
+set (CRED_SNAPSHOT false)
+set (TRACE false)
+set (LOG_RING false)
+set (HEAP_TRACK false)
 
 #following are specific to only mbedos
 set (DATASTORE sd)
@@ -413,6 +419,36 @@ if (${unit-test} STREQUAL true)
   message("Selected UNIT-TEST ${unit-test}")
 endif()
 
+###########################################
+# FOR LOOPBACK-TEST
+get_property(cached_loopback-test_value CACHE loopback-test PROPERTY VALUE)
+
+set(loopback-test_cli_arg ${cached_loopback-test_value})
+if(loopback-test_cli_arg STREQUAL CACHED_LOOPBACK-TEST)
+  unset(loopback-test_cli_arg)
+endif()
+
+set(loopback-test_app_cmake_lists ${loopback-test})
+if(cached_loopback-test_value STREQUAL loopback-test)
+  unset(loopback-test_app_cmake_lists)
+endif()
+
+if(CACHED_LOOPBACK-TEST)
+  if ((loopback-test_cli_arg) AND (NOT(CACHED_LOOPBACK-TEST STREQUAL loopback-test_cli_arg)))
+    message(WARNING "Need to do make pristine before cmake args can change.")
+  endif()
+  set(loopback-test ${CACHED_LOOPBACK-TEST})
+elseif(loopback-test_cli_arg)
+  set(loopback-test ${loopback-test_cli_arg})
+elseif(loopback-test_app_cmake_lists)
+  set(loopback-test ${loopback-test_app_cmake_lists})
+endif()
+
+set(CACHED_LOOPBACK-TEST ${loopback-test} CACHE STRING "Selected loopback-test")
+if (${loopback-test} STREQUAL true)
+  message("Selected LOOPBACK-TEST ${loopback-test}")
+endif()
+
 ###########################################
 # FOR MANUFACTURER_TOOLKIT
 get_property(cached_manufacturer_toolkit_value CACHE MANUFACTURER_TOOLKIT PROPERTY VALUE)
@@ -825,3 +861,143 @@ set(CACHED_REUSE ${REUSE} CACHE STRING "Selected REUSE")
 message("Selected REUSE ${REUSE}")
 
 ###########################################
+# FOR CRED_STORE
+get_property(cached_cred_store_value CACHE CRED_STORE PROPERTY VALUE)
+
+set(cred_store_cli_arg ${cached_cred_store_value})
+if(cred_store_cli_arg STREQUAL CACHED_CRED_STORE)
+  unset(cred_store_cli_arg)
+endif()
+
+set(cred_store_app_cmake_lists ${CRED_STORE})
+if(cached_cred_store_value STREQUAL CRED_STORE)
+  unset(cred_store_app_cmake_lists)
+endif()
+
+if(CACHED_CRED_STORE)
+  if ((cred_store_cli_arg) AND (NOT(CACHED_CRED_STORE STREQUAL cred_store_cli_arg)))
+    message(WARNING "Need to do make pristine before cmake args can change.")
+  endif()
+  set(CRED_STORE ${CACHED_CRED_STORE})
+elseif(cred_store_cli_arg)
+  set(CRED_STORE ${cred_store_cli_arg})
+elseif(cred_store_app_cmake_lists)
+  set(CRED_STORE ${cred_store_app_cmake_lists})
+endif()
+
+set(CACHED_CRED_STORE ${CRED_STORE} CACHE STRING "Selected CRED_STORE")
+message("Selected CRED_STORE ${CRED_STORE}")
+
+###########################################
+# FOR CRED_SNAPSHOT
+get_property(cached_cred_snapshot_value CACHE CRED_SNAPSHOT PROPERTY VALUE)
+
+set(cred_snapshot_cli_arg ${cached_cred_snapshot_value})
+if(cred_snapshot_cli_arg STREQUAL CACHED_CRED_SNAPSHOT)
+  unset(cred_snapshot_cli_arg)
+endif()
+
+set(cred_snapshot_app_cmake_lists ${CRED_SNAPSHOT})
+if(cached_cred_snapshot_value STREQUAL CRED_SNAPSHOT)
+  unset(cred_snapshot_app_cmake_lists)
+endif()
+
+if(CACHED_CRED_SNAPSHOT)
+  if ((cred_snapshot_cli_arg) AND (NOT(CACHED_CRED_SNAPSHOT STREQUAL cred_snapshot_cli_arg)))
+    message(WARNING "Need to do make pristine before cmake args can change.")
+  endif()
+  set(CRED_SNAPSHOT ${CACHED_CRED_SNAPSHOT})
+elseif(cred_snapshot_cli_arg)
+  set(CRED_SNAPSHOT ${cred_snapshot_cli_arg})
+elseif(cred_snapshot_app_cmake_lists)
+  set(CRED_SNAPSHOT ${cred_snapshot_app_cmake_lists})
+endif()
+
+set(CACHED_CRED_SNAPSHOT ${CRED_SNAPSHOT} CACHE STRING "Selected CRED_SNAPSHOT")
+message("Selected CRED_SNAPSHOT ${CRED_SNAPSHOT}")
+
+###########################################
+# FOR TRACE
+get_property(cached_trace_value CACHE TRACE PROPERTY VALUE)
+
+set(trace_cli_arg ${cached_trace_value})
+if(trace_cli_arg STREQUAL CACHED_TRACE)
+  unset(trace_cli_arg)
+endif()
+
+set(trace_app_cmake_lists ${TRACE})
+if(cached_trace_value STREQUAL TRACE)
+  unset(trace_app_cmake_lists)
+endif()
+
+if(CACHED_TRACE)
+  if ((trace_cli_arg) AND (NOT(CACHED_TRACE STREQUAL trace_cli_arg)))
+    message(WARNING "Need to do make pristine before cmake args can change.")
+  endif()
+  set(TRACE ${CACHED_TRACE})
+elseif(trace_cli_arg)
+  set(TRACE ${trace_cli_arg})
+elseif(trace_app_cmake_lists)
+  set(TRACE ${trace_app_cmake_lists})
+endif()
+
+set(CACHED_TRACE ${TRACE} CACHE STRING "Selected TRACE")
+message("Selected TRACE ${TRACE}")
+
+###########################################
+# FOR LOG_RING
+get_property(cached_log_ring_value CACHE LOG_RING PROPERTY VALUE)
+
+set(log_ring_cli_arg ${cached_log_ring_value})
+if(log_ring_cli_arg STREQUAL CACHED_LOG_RING)
+  unset(log_ring_cli_arg)
+endif()
+
+set(log_ring_app_cmake_lists ${LOG_RING})
+if(cached_log_ring_value STREQUAL LOG_RING)
+  unset(log_ring_app_cmake_lists)
+endif()
+
+if(CACHED_LOG_RING)
+  if ((log_ring_cli_arg) AND (NOT(CACHED_LOG_RING STREQUAL log_ring_cli_arg)))
+    message(WARNING "Need to do make pristine before cmake args can change.")
+  endif()
+  set(LOG_RING ${CACHED_LOG_RING})
+elseif(log_ring_cli_arg)
+  set(LOG_RING ${log_ring_cli_arg})
+elseif(log_ring_app_cmake_lists)
+  set(LOG_RING ${log_ring_app_cmake_lists})
+endif()
+
+set(CACHED_LOG_RING ${LOG_RING} CACHE STRING "Selected LOG_RING")
+message("Selected LOG_RING ${LOG_RING}")
+
+###########################################
+# FOR HEAP_TRACK
+get_property(cached_heap_track_value CACHE HEAP_TRACK PROPERTY VALUE)
+
+set(heap_track_cli_arg ${cached_heap_track_value})
+if(heap_track_cli_arg STREQUAL CACHED_HEAP_TRACK)
+  unset(heap_track_cli_arg)
+endif()
+
+set(heap_track_app_cmake_lists ${HEAP_TRACK})
+if(cached_heap_track_value STREQUAL HEAP_TRACK)
+  unset(heap_track_app_cmake_lists)
+endif()
+
+if(CACHED_HEAP_TRACK)
+  if ((heap_track_cli_arg) AND (NOT(CACHED_HEAP_TRACK STREQUAL heap_track_cli_arg)))
+    message(WARNING "Need to do make pristine before cmake args can change.")
+  endif()
+  set(HEAP_TRACK ${CACHED_HEAP_TRACK})
+elseif(heap_track_cli_arg)
+  set(HEAP_TRACK ${heap_track_cli_arg})
+elseif(heap_track_app_cmake_lists)
+  set(HEAP_TRACK ${heap_track_app_cmake_lists})
+endif()
+
+set(CACHED_HEAP_TRACK ${HEAP_TRACK} CACHE STRING "Selected HEAP_TRACK")
+message("Selected HEAP_TRACK ${HEAP_TRACK}")
+
+###########################################
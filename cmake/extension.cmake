@@ -275,4 +275,36 @@ if(${REUSE} STREQUAL true)
   client_sdk_compile_definitions(-DREUSE_SUPPORTED)
 endif()
 
+if(${CRED_STORE} STREQUAL true)
+  if (NOT(${TARGET_OS} MATCHES linux))
+    message(FATAL_ERROR "CRED_STORE is only supported on linux")
+  endif()
+  client_sdk_compile_definitions(-DCRED_STORE_ENABLED)
+endif()
+
+if(${CRED_SNAPSHOT} STREQUAL true)
+  client_sdk_compile_definitions(-DCRED_SNAPSHOT_ENABLED)
+endif()
+
+if(${TRACE} STREQUAL true)
+  if (NOT(${TARGET_OS} MATCHES linux))
+    message(FATAL_ERROR "TRACE is only supported on linux")
+  endif()
+  client_sdk_compile_definitions(-DTRACE_ENABLED)
+endif()
+
+if(${LOG_RING} STREQUAL true)
+  if (NOT(${TARGET_OS} MATCHES linux))
+    message(FATAL_ERROR "LOG_RING is only supported on linux")
+  endif()
+  client_sdk_compile_definitions(-DLOG_RING_ENABLED)
+endif()
+
+if(${HEAP_TRACK} STREQUAL true)
+  if (NOT(${TARGET_OS} MATCHES linux))
+    message(FATAL_ERROR "HEAP_TRACK is only supported on linux")
+  endif()
+  client_sdk_compile_definitions(-DHEAP_TRACK_ENABLED)
+endif()
+
 ############################################################
@@ -9,6 +9,8 @@
 #include "sdoCryptoCtx.h"
 #include "sdoCrypto.h"
 #include "network_al.h"
+#include "sdotrace.h"
+#include "sdostats.h"
 
 /**
  * This API helps compute the size of the buffer that holds the ciphertext
@@ -135,6 +137,7 @@ int32_t sdo_msg_encrypt(uint8_t *clear_text, uint32_t clear_text_length,
 	sdo_aes_keyset_t *keyset = get_keyset();
 	uint8_t *sek;
 	uint8_t sek_len;
+	int32_t ret;
 
 	if (!keyset) {
 		goto error;
@@ -152,9 +155,13 @@ int32_t sdo_msg_encrypt(uint8_t *clear_text, uint32_t clear_text_length,
 		goto error;
 	}
 
-	if (0 != crypto_hal_aes_encrypt(clear_text, clear_text_length, cipher,
-					cipher_length, SDO_AES_BLOCK_SIZE, iv,
-					sek, sek_len)) {
+	SDO_TRACE_BEGIN(SDO_TRACE_CRYPTO, "aes_encrypt", 0);
+	sdo_stats_crypto(SDO_STATS_ENCRYPT);
+	ret = crypto_hal_aes_encrypt(clear_text, clear_text_length, cipher,
+				     cipher_length, SDO_AES_BLOCK_SIZE, iv, sek,
+				     sek_len);
+	SDO_TRACE_END(SDO_TRACE_CRYPTO, "aes_encrypt", 0);
+	if (0 != ret) {
 		goto error;
 	}
 	return 0;
@@ -210,6 +217,7 @@ int32_t sdo_msg_decrypt(uint8_t *clear_text, uint32_t *clear_text_length,
 	sdo_aes_keyset_t *keyset = get_keyset();
 	uint8_t *sek;
 	uint8_t sek_len;
+	int32_t ret;
 
 	if (!keyset) {
 		goto error;
@@ -221,9 +229,13 @@ int32_t sdo_msg_decrypt(uint8_t *clear_text, uint32_t *clear_text_length,
 		goto error;
 	}
 
-	if (0 != crypto_hal_aes_decrypt(clear_text, clear_text_length, cipher,
-					cipher_length, SDO_AES_BLOCK_SIZE, iv,
-					sek, sek_len)) {
+	SDO_TRACE_BEGIN(SDO_TRACE_CRYPTO, "aes_decrypt", 0);
+	sdo_stats_crypto(SDO_STATS_DECRYPT);
+	ret = crypto_hal_aes_decrypt(clear_text, clear_text_length, cipher,
+				     cipher_length, SDO_AES_BLOCK_SIZE, iv, sek,
+				     sek_len);
+	SDO_TRACE_END(SDO_TRACE_CRYPTO, "aes_decrypt", 0);
+	if (0 != ret) {
 		LOG(LOG_ERROR, "decrypt failed\n");
 		goto error;
 	}
@@ -10,8 +10,10 @@
 #include "stdlib.h"
 #include "sdoCryptoCtx.h"
 #include "sdoCrypto.h"
+#include "sdoctx.h"
 
-static sdo_crypto_context_t crypto_ctx;
+/* Sessions holding the crypto library open */
+static unsigned int crypto_users;
 static void cleanup_ctx(void);
 
 /******************************************************************************/
@@ -21,7 +23,7 @@ static void cleanup_ctx(void);
  */
 sdo_string_t *sdo_get_device_kex_method(void)
 {
-	return crypto_ctx.kex.kx;
+	return sdo_ctx_current()->crypto.kex.kx;
 }
 
 /**
@@ -30,7 +32,7 @@ sdo_string_t *sdo_get_device_kex_method(void)
  */
 sdo_string_t *sdo_get_device_crypto_suite(void)
 {
-	return crypto_ctx.kex.cs;
+	return sdo_ctx_current()->crypto.kex.cs;
 }
 
 /**
@@ -39,7 +41,7 @@ sdo_string_t *sdo_get_device_crypto_suite(void)
  */
 sdo_aes_keyset_t *get_keyset(void)
 {
-	return &crypto_ctx.to2Sym_enc.keyset;
+	return &sdo_ctx_current()->crypto.to2Sym_enc.keyset;
 }
 
 /**
@@ -48,7 +50,7 @@ sdo_aes_keyset_t *get_keyset(void)
  */
 sdo_byte_array_t **getOVKey(void)
 {
-	return &crypto_ctx.OVKey;
+	return &sdo_ctx_current()->crypto.OVKey;
 }
 
 /**
@@ -57,7 +59,7 @@ sdo_byte_array_t **getOVKey(void)
  */
 sdo_dev_key_ctx_t *getsdo_dev_key_ctx(void)
 {
-	return &crypto_ctx.dev_key;
+	return &sdo_ctx_current()->crypto.dev_key;
 }
 
 /**
@@ -66,7 +68,7 @@ sdo_dev_key_ctx_t *getsdo_dev_key_ctx(void)
  */
 sdo_kex_ctx_t *getsdo_key_ctx(void)
 {
-	return &crypto_ctx.kex;
+	return &sdo_ctx_current()->crypto.kex;
 }
 
 /**
@@ -75,21 +77,27 @@ sdo_kex_ctx_t *getsdo_key_ctx(void)
  */
 sdo_to2Sym_enc_ctx_t *get_sdo_to2_ctx(void)
 {
-	return &crypto_ctx.to2Sym_enc;
+	return &sdo_ctx_current()->crypto.to2Sym_enc;
 }
 
 int32_t sdo_crypto_init(void)
 {
 	int32_t ret = -1;
 
-	if (crypto_init()) {
-		goto err;
-	}
-	if (dev_attestation_init()) {
-		goto err;
+	/* The library is set up once for all the contexts using it */
+	sdo_ctx_lock();
+	if (crypto_users == 0) {
+		if (crypto_init()) {
+			goto err;
+		}
+		if (dev_attestation_init()) {
+			goto err;
+		}
 	}
+	crypto_users++;
 	ret = 0;
 err:
+	sdo_ctx_unlock();
 	return ret;
 }
 
@@ -97,9 +105,14 @@ int32_t sdo_crypto_close(void)
 {
 	int32_t ret = 0;
 
-	dev_attestation_close();
-
-	ret = crypto_close();
+	sdo_ctx_lock();
+	if (crypto_users > 0)
+		crypto_users--;
+	if (crypto_users == 0) {
+		dev_attestation_close();
+		ret = crypto_close();
+	}
+	sdo_ctx_unlock();
 	/* CLeanup of context structs */
 	cleanup_ctx();
 	return ret;
@@ -107,16 +120,18 @@ int32_t sdo_crypto_close(void)
 
 static void cleanup_ctx(void)
 {
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+
 	/* dev_key cleanup*/
-	if (crypto_ctx.dev_key.eA) {
-		sdo_public_key_free(crypto_ctx.dev_key.eA->pubkey);
-		sdo_free(crypto_ctx.dev_key.eA);
-		crypto_ctx.dev_key.eA = NULL;
+	if (ctx->crypto.dev_key.eA) {
+		sdo_public_key_free(ctx->crypto.dev_key.eA->pubkey);
+		sdo_free(ctx->crypto.dev_key.eA);
+		ctx->crypto.dev_key.eA = NULL;
 	}
 
 	/* cleanup ovkey */
-	sdo_byte_array_free(crypto_ctx.OVKey);
-	crypto_ctx.OVKey = NULL;
+	sdo_byte_array_free(ctx->crypto.OVKey);
+	ctx->crypto.OVKey = NULL;
 }
 
 /**
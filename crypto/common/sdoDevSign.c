@@ -10,6 +10,8 @@
 #include "stdlib.h"
 #include "sdoCryptoCtx.h"
 #include "sdoCrypto.h"
+#include "sdotrace.h"
+#include "sdostats.h"
 
 #define ECDSA_SIGNATURE_MAX_LEN BUFF_SIZE_256_BYTES
 
@@ -45,8 +47,14 @@ int32_t sdo_device_sign(const uint8_t *message, size_t message_length,
 		goto end;
 	}
 
-	if (0 != crypto_hal_ecdsa_sign(message, message_length, (*signature)->bytes,
-				&(*signature)->byte_sz)) {
+	SDO_TRACE_BEGIN(SDO_TRACE_CRYPTO, "ecdsa_sign", 0);
+	sdo_stats_crypto(SDO_STATS_SIGN);
+	ret = crypto_hal_ecdsa_sign(message, message_length,
+				    (*signature)->bytes,
+				    &(*signature)->byte_sz);
+	SDO_TRACE_END(SDO_TRACE_CRYPTO, "ecdsa_sign", 0);
+	if (0 != ret) {
+		ret = -1;
 		LOG(LOG_ERROR, "ECDSA signing failed!\n");
 		sdo_byte_array_free(*signature);
 		*signature = NULL;
@@ -58,3 +66,29 @@ int32_t sdo_device_sign(const uint8_t *message, size_t message_length,
 end:
 	return ret;
 }
+
+/**
+ * Prepare the message independent part of the next device signatures, so
+ * that the proofs in msg32 and msg44 only pay for the final signing step.
+ * Each prepared value is used for a single signature. Run off the protocol
+ * path, by the key share worker of sdo_kex_precompute_start().
+ * @return 0 on success and -1 on failure
+ */
+int32_t sdo_device_sign_precompute(void)
+{
+#if defined(ECDSA256_DA) || defined(ECDSA384_DA)
+	return crypto_hal_ecdsa_sign_precompute();
+#else
+	return 0;
+#endif
+}
+
+/**
+ * Discard, and clear, device signature values prepared but not used.
+ */
+void sdo_device_sign_precompute_clear(void)
+{
+#if defined(ECDSA256_DA) || defined(ECDSA384_DA)
+	crypto_hal_ecdsa_sign_precompute_clear();
+#endif
+}
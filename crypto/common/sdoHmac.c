@@ -9,6 +9,8 @@
 #include "sdoCryptoCtx.h"
 #include "sdoCrypto.h"
 #include "sdoprot.h"
+#include "sdotrace.h"
+#include "sdostats.h"
 #include "storage_al.h"
 #include "platform_utils.h"
 
@@ -35,6 +37,7 @@ int32_t sdo_to2_hmac(uint8_t *to2Msg, size_t to2Msg_len, uint8_t *hmac,
 	sdo_aes_keyset_t *keyset = get_keyset();
 	uint8_t *svk;
 	uint8_t svk_len;
+	int32_t ret;
 
 	if (NULL == keyset || (NULL == keyset->svk) || (NULL == to2Msg)) {
 		return -1;
@@ -45,8 +48,12 @@ int32_t sdo_to2_hmac(uint8_t *to2Msg, size_t to2Msg_len, uint8_t *hmac,
 	if (!svk || !svk_len || !to2Msg_len || !hmac_len)
 		goto error;
 
-	if (0 != crypto_hal_hmac(SDO_CRYPTO_HMAC_TYPE_USED, to2Msg, to2Msg_len,
-				 hmac, hmac_len, svk, svk_len)) {
+	SDO_TRACE_BEGIN(SDO_TRACE_CRYPTO, "hmac", 0);
+	sdo_stats_crypto(SDO_STATS_HMAC);
+	ret = crypto_hal_hmac(SDO_CRYPTO_HMAC_TYPE_USED, to2Msg, to2Msg_len,
+			      hmac, hmac_len, svk, svk_len);
+	SDO_TRACE_END(SDO_TRACE_CRYPTO, "hmac", 0);
+	if (0 != ret) {
 		LOG(LOG_ERROR, "Failed to perform HMAC\n");
 		goto error;
 	}
@@ -130,11 +137,17 @@ int32_t sdo_device_ov_hmac(uint8_t *OVHdr, size_t OVHdr_len, uint8_t *hmac,
 	uint8_t *hmac_key = (*keyset)->bytes;
 	uint8_t hmac_key_len = (*keyset)->byte_sz;
 
+	int32_t ret;
+
 	if (!hmac_key || !hmac_key_len || !OVHdr_len || !hmac_len)
 		goto error;
 
-	if (0 != crypto_hal_hmac(SDO_CRYPTO_HMAC_TYPE_USED, OVHdr, OVHdr_len,
-				 hmac, hmac_len, hmac_key, hmac_key_len)) {
+	SDO_TRACE_BEGIN(SDO_TRACE_CRYPTO, "ov_hmac", 0);
+	sdo_stats_crypto(SDO_STATS_HMAC);
+	ret = crypto_hal_hmac(SDO_CRYPTO_HMAC_TYPE_USED, OVHdr, OVHdr_len, hmac,
+			      hmac_len, hmac_key, hmac_key_len);
+	SDO_TRACE_END(SDO_TRACE_CRYPTO, "ov_hmac", 0);
+	if (0 != ret) {
 		LOG(LOG_ERROR, "Failed to perform HMAC\n");
 		goto error;
 	}
@@ -158,13 +171,18 @@ error:
 int32_t sdo_crypto_hash(const uint8_t *message, size_t message_length,
 			uint8_t *hash, size_t hash_length)
 {
+	int32_t ret;
 
 	if (!message || !message_length || !hash || !hash_length) {
 		return -1;
 	}
 
-	if (0 != crypto_hal_hash(SDO_CRYPTO_HASH_TYPE_USED, message,
-				  message_length, hash, hash_length)) {
+	SDO_TRACE_BEGIN(SDO_TRACE_CRYPTO, "hash", 0);
+	sdo_stats_crypto(SDO_STATS_HASH);
+	ret = crypto_hal_hash(SDO_CRYPTO_HASH_TYPE_USED, message,
+			      message_length, hash, hash_length);
+	SDO_TRACE_END(SDO_TRACE_CRYPTO, "hash", 0);
+	if (0 != ret) {
 
 		return -1;
 	}
@@ -278,6 +296,86 @@ error:
 #endif
 	return ret;
 }
+
+/**
+ * sdo_storage_hmac_begin function starts a storage HMAC computed over data
+ * passed in parts, for blobs too large to hold in memory at once
+ *
+ * @return
+ *        return context for sdo_storage_hmac_update/end, NULL on failure.
+ */
+void *sdo_storage_hmac_begin(void)
+{
+#if defined(DEVICE_TPM20_ENABLED)
+	LOG(LOG_ERROR, "Incremental storage HMAC is not supported with TPM!\n");
+	return NULL;
+#else
+	uint8_t hmac_key[PLATFORM_HMAC_KEY_DEFAULT_LEN] = {0};
+	void *ctx = NULL;
+
+	if (!get_platform_hmac_key(hmac_key, PLATFORM_HMAC_KEY_DEFAULT_LEN)) {
+		LOG(LOG_ERROR, "Could not get platform HMAC key!\n");
+		goto error;
+	}
+
+	ctx = crypto_hal_hmac_begin(SDO_CRYPTO_HMAC_TYPE_SHA_256, hmac_key,
+				    HMACSHA256_KEY_SIZE);
+	if (!ctx)
+		LOG(LOG_ERROR, "Failed to start storage HMAC!\n");
+
+error:
+	if (memset_s(hmac_key, PLATFORM_HMAC_KEY_DEFAULT_LEN, 0)) {
+		LOG(LOG_ERROR, "Failed to clear HMAC key\n");
+		if (ctx)
+			(void)crypto_hal_hmac_end(ctx, NULL, 0);
+		ctx = NULL;
+	}
+	return ctx;
+#endif
+}
+
+/**
+ * sdo_storage_hmac_update function adds the next part of the data to a
+ * storage HMAC
+ * @param ctx: context from sdo_storage_hmac_begin
+ * @param data: pointer to the input data
+ * @param data_length: length of the input data
+ *
+ * @return
+ *        return 0 on success, -1 on failure.
+ */
+int32_t sdo_storage_hmac_update(void *ctx, const uint8_t *data,
+				uint32_t data_length)
+{
+	if (0 != crypto_hal_hmac_update(ctx, data, data_length)) {
+		LOG(LOG_ERROR, "Storage HMAC update failed!\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * sdo_storage_hmac_end function completes a storage HMAC and frees its
+ * context
+ * @param ctx: context from sdo_storage_hmac_begin
+ * @param computed_hmac: pointer to the computed HMAC, NULL to discard
+ * @param computed_hmac_size: size of the computed HMAC buffer
+ *
+ * @return
+ *        return 0 on success, -1 on failure.
+ */
+int32_t sdo_storage_hmac_end(void *ctx, uint8_t *computed_hmac,
+			     int computed_hmac_size)
+{
+	if (computed_hmac && computed_hmac_size != PLATFORM_HMAC_SIZE) {
+		(void)crypto_hal_hmac_end(ctx, NULL, 0);
+		return -1;
+	}
+
+	if (0 != crypto_hal_hmac_end(ctx, computed_hmac, computed_hmac_size))
+		return -1;
+	return 0;
+}
 #endif
 
 /**
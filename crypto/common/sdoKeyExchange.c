@@ -11,10 +11,111 @@
 #include "stdlib.h"
 #include "sdoCryptoCtx.h"
 #include "sdoCrypto.h"
+#include "sdoctx.h"
+#include "sdotrace.h"
+#include "sdostats.h"
+
+/*
+ * The ephemeral share is generated on a worker thread only where the crypto
+ * library is known to be safe to call concurrently (openssl RAND is locked
+ * internally; the mbedtls DRBG and the secure element are not).
+ */
+#if defined(TARGET_OS_LINUX) && defined(USE_OPENSSL) && !defined(SECURE_ELEMENT)
+#define KEX_PRECOMPUTE_THREAD
+#endif
 
 /* Static functions */
 static int32_t remove_java_compatible_byte_array(sdo_byte_array_t *BArray);
 
+/**
+ * Internal API
+ * Generate the device ephemeral key share. The worker thread has no context
+ * bound, so it is handed the precompute slot of the context that started it.
+ * On the worker thread, the device signatures are prepared next, in the
+ * same idle time rather than alongside it; a signature needed before they
+ * are ready is computed in full.
+ * @param arg - sdo_kex_precompute_t to fill in.
+ */
+static void *kex_precompute(void *arg)
+{
+	sdo_kex_precompute_t *pre = arg;
+
+	pre->status = crypto_hal_kex_init(&pre->context);
+#ifdef KEX_PRECOMPUTE_THREAD
+	if (sdo_device_sign_precompute())
+		LOG(LOG_DEBUG, "Device signatures will not be precomputed\n");
+#endif
+	return NULL;
+}
+
+/**
+ * Internal API
+ * Wait for an outstanding precompute and hand over its context.
+ * @return the precomputed kex context, or NULL if there is none.
+ */
+static void *kex_precompute_claim(void)
+{
+	sdo_kex_precompute_t *pre = &sdo_ctx_current()->kex_pre;
+	void *context = NULL;
+
+	if (!pre->pending)
+		return NULL;
+
+#ifdef KEX_PRECOMPUTE_THREAD
+	pthread_join(pre->thread, NULL);
+#endif
+	pre->pending = false;
+	if (pre->status == 0)
+		context = pre->context;
+	else
+		LOG(LOG_ERROR, "Key exchange precompute failed\n");
+	pre->context = NULL;
+	return context;
+}
+
+/**
+ * sdo_kex_precompute_start() - generate the device key share ahead of TO2
+ * The ephemeral DH/ECDH key generation is the most expensive part of
+ * building msg44, so it is started as soon as the device knows it is headed
+ * for TO2. The result is consumed by the next sdo_kex_init(). Calling this
+ * while a share is already pending is a no-op.
+ * @return 0 on success, -1 on failure
+ */
+int32_t sdo_kex_precompute_start(void)
+{
+	sdo_kex_precompute_t *pre = &sdo_ctx_current()->kex_pre;
+
+	if (pre->pending)
+		return 0;
+
+	pre->status = -1;
+	pre->context = NULL;
+	pre->pending = true;
+#ifdef KEX_PRECOMPUTE_THREAD
+	if (pthread_create(&pre->thread, NULL, kex_precompute, pre) == 0)
+		return 0;
+	LOG(LOG_ERROR, "Failed to start key exchange precompute thread\n");
+	pre->pending = false;
+	return -1;
+#else
+	(void)kex_precompute(pre);
+	return pre->status;
+#endif
+}
+
+/**
+ * sdo_kex_precompute_discard() - drop an unused precomputed key share
+ * The kex context is released through crypto_hal_kex_close(), which clears
+ * the private values.
+ */
+void sdo_kex_precompute_discard(void)
+{
+	void *context = kex_precompute_claim();
+
+	if (context)
+		crypto_hal_kex_close(&context);
+}
+
 /******************************************************************************/
 /**
  * sdo_kex_init() - Initialize key exchange context
@@ -71,9 +172,18 @@ int32_t sdo_kex_init(void)
 	if (!to2sym_ctx->keyset.svk)
 		goto err;
 
-	if (crypto_hal_kex_init(&(kex_ctx->context))) {
-		goto err;
+	/* Use the key share generated ahead of time if there is one */
+	kex_ctx->context = kex_precompute_claim();
+	if (!kex_ctx->context) {
+		SDO_TRACE_BEGIN(SDO_TRACE_CRYPTO, "kex_init", 0);
+		ret = crypto_hal_kex_init(&(kex_ctx->context));
+		SDO_TRACE_END(SDO_TRACE_CRYPTO, "kex_init", 0);
+		if (ret) {
+			ret = -1;
+			goto err;
+		}
 	}
+	sdo_stats_crypto(SDO_STATS_KEX);
 
 	/* Fill out the labels */
 	kex_ctx->kdf_label = "MarshalPointKDF";
@@ -134,6 +244,8 @@ int32_t sdo_kex_close(void)
 		sdo_free(to2sym_ctx->initialization_vector);
 		to2sym_ctx->initialization_vector = NULL;
 	}
+	/* A new session starts a new IV, not the old counter without one */
+	to2sym_ctx->ctr_value = 0;
 
 	if (kex_ctx->context) {
 		crypto_hal_kex_close((void *)&kex_ctx->context);
@@ -554,12 +666,15 @@ int32_t sdo_set_kex_paramA(sdo_byte_array_t *xA, sdo_public_key_t *encrypt_key)
 		return -1;
 	}
 
+	SDO_TRACE_BEGIN(SDO_TRACE_CRYPTO, "kex_derive", 0);
+	sdo_stats_crypto(SDO_STATS_KEX);
 	if (0 != crypto_hal_set_peer_random(key_ex_data->context, xA->bytes,
 					    xA->byte_sz)) {
 		LOG(LOG_ERROR, "Failed set peer random\n");
-		return -1;
+		ret = -1;
+	} else {
+		ret = kex_kdf();
 	}
-
-	ret = kex_kdf();
+	SDO_TRACE_END(SDO_TRACE_CRYPTO, "kex_derive", 0);
 	return ret;
 }
@@ -11,6 +11,8 @@
 #include "sdotypes.h"
 #include "sdoCryptoHal.h"
 #include "sdoCrypto.h"
+#include "sdotrace.h"
+#include "sdostats.h"
 
 /**
  * This function verifies if the signature message_signature of length
@@ -38,6 +40,8 @@ int32_t sdo_ov_verify(uint8_t *message, uint32_t message_length,
 		return -1;
 	}
 
+	SDO_TRACE_BEGIN(SDO_TRACE_CRYPTO, "sig_verify", 0);
+	sdo_stats_crypto(SDO_STATS_VERIFY);
 	ret = crypto_hal_sig_verify(
 	    pubkey->pkenc, pubkey->pkalg, message, message_length,
 	    message_signature, signature_length, pubkey->key1->bytes,
@@ -45,6 +49,7 @@ int32_t sdo_ov_verify(uint8_t *message, uint32_t message_length,
 	    /* X.509 encoded pubkeys only have key1 parameter */
 	    (pubkey->key2 ? pubkey->key2->bytes : NULL),
 	    (pubkey->key2 ? pubkey->key2->byte_sz : 0));
+	SDO_TRACE_END(SDO_TRACE_CRYPTO, "sig_verify", 0);
 
 	*result = (0 == ret) ? true : false;
 	return ret;
@@ -6,6 +6,10 @@
 #define __EC_KEY_H__
 
 #include <openssl/ec.h>
+#include "sdotypes.h"
 
 EC_KEY *get_ec_key(void);
+EC_KEY *ec_key_generate(void);
+int32_t ec_key_to_buf(EC_KEY *ec_key, uint8_t **buf, size_t *length);
+int32_t ec_key_get_csr(EC_KEY *ec_key, sdo_byte_array_t **csr);
 #endif
@@ -82,6 +82,8 @@ int32_t sdo_crypto_random_bytes(uint8_t *random_buffer, size_t num_bytes);
 
 int32_t sdo_kex_init(void);
 int32_t sdo_kex_close(void);
+int32_t sdo_kex_precompute_start(void);
+void sdo_kex_precompute_discard(void);
 
 sdo_string_t *sdo_get_device_kex_method(void);
 sdo_string_t *sdo_get_device_crypto_suite(void);
@@ -112,6 +114,8 @@ int set_currentIV(uint8_t *iv);
 
 int32_t sdo_device_sign(const uint8_t *message, size_t message_length,
 			sdo_byte_array_t **signature);
+int32_t sdo_device_sign_precompute(void);
+void sdo_device_sign_precompute_clear(void);
 
 sdo_dev_key_ctx_t *getsdo_dev_key_ctx(void);
 sdo_kex_ctx_t *getsdo_key_ctx(void);
@@ -122,6 +126,11 @@ int32_t sdo_generate_ov_hmac_key(void);
 int32_t sdo_compute_storage_hmac(const uint8_t *data, uint32_t data_length,
 				 uint8_t *computed_hmac,
 				 int computed_hmac_size);
+void *sdo_storage_hmac_begin(void);
+int32_t sdo_storage_hmac_update(void *ctx, const uint8_t *data,
+				uint32_t data_length);
+int32_t sdo_storage_hmac_end(void *ctx, uint8_t *computed_hmac,
+			     int computed_hmac_size);
 int32_t sdo_generate_storage_hmac_key(void);
 
 int32_t sdo_get_device_csr(sdo_byte_array_t **csr);
@@ -70,6 +70,16 @@ int32_t crypto_hal_hash(uint8_t hash_type, const uint8_t *buffer,
 			 size_t buffer_length, uint8_t *output,
 			 size_t output_length);
 
+/* Incremental hash, for data that is produced or consumed in chunks.
+ * crypto_hal_hash_begin returns a context to feed with
+ * crypto_hal_hash_update; crypto_hal_hash_end places the result in "output"
+ * (unless it is NULL) and always frees the context.
+ */
+void *crypto_hal_hash_begin(uint8_t hash_type);
+int32_t crypto_hal_hash_update(void *ctx, const uint8_t *buffer,
+			       size_t buffer_length);
+int32_t crypto_hal_hash_end(void *ctx, uint8_t *output, size_t output_length);
+
 /* Calculate hmac of "buffer" using "key", and place the result in "output".
  * "output" must be allocated already.
  */
@@ -78,6 +88,16 @@ int32_t crypto_hal_hmac(uint8_t hmac_type, const uint8_t *buffer,
 			size_t output_length, const uint8_t *key,
 			size_t key_length);
 
+/* Incremental hmac, for data that is produced or consumed in chunks.
+ * crypto_hal_hmac_begin returns a context to feed with
+ * crypto_hal_hmac_update; crypto_hal_hmac_end places the result in "output"
+ * (unless it is NULL) and always frees the context.
+ */
+void *crypto_hal_hmac_begin(uint8_t hmac_type, const uint8_t *key,
+			    size_t key_length);
+int32_t crypto_hal_hmac_update(void *ctx, const uint8_t *buffer,
+			       size_t buffer_length);
+int32_t crypto_hal_hmac_end(void *ctx, uint8_t *output, size_t output_length);
 
 /* crypto_hal_sig_verify
  * Verify an RSA PKCS v1.5 Signature using provided public key
@@ -113,6 +133,10 @@ int32_t crypto_hal_sig_verify(uint8_t key_encoding, uint8_t key_algorithm,
 int32_t crypto_hal_ecdsa_sign(const uint8_t *message, size_t message_len,
 		       unsigned char *signature, size_t *signature_len);
 
+/* Prepare/discard the message independent part of upcoming signatures */
+int32_t crypto_hal_ecdsa_sign_precompute(void);
+void crypto_hal_ecdsa_sign_precompute_clear(void);
+
 /* Encrypt "clear_text" using rsa pubkeys. */
 int32_t crypto_hal_rsa_encrypt(uint8_t hash_type, uint8_t key_encoding,
 			       uint8_t key_algorithm, const uint8_t *clear_text,
@@ -169,6 +193,19 @@ int32_t sdo_crypto_aes_gcm_decrypt(uint8_t *clear_text,
 				   const uint8_t *key, uint32_t key_length,
 				   uint8_t *tag, uint32_t tag_length);
 
+/* Incremental AES-GCM, for data that is produced or consumed in chunks.
+ * Every sdo_crypto_aes_gcm_update but the last must process a multiple of
+ * 16 bytes; "in" and "out" may be the same buffer. sdo_crypto_aes_gcm_end
+ * returns the tag when encrypting, checks it when decrypting, and always
+ * frees the context.
+ */
+void *sdo_crypto_aes_gcm_begin(bool encrypt, const uint8_t *iv,
+			       uint32_t iv_length, const uint8_t *key,
+			       uint32_t key_length);
+int32_t sdo_crypto_aes_gcm_update(void *ctx, const uint8_t *in, uint8_t *out,
+				  uint32_t length);
+int32_t sdo_crypto_aes_gcm_end(void *ctx, uint8_t *tag, uint32_t tag_length);
+
 /*
  * Helper API designed to convert the raw signature into DER format required by
  * SDO.
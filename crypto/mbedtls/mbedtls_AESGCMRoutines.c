@@ -178,3 +178,152 @@ end:
 	mbedtls_gcm_free(&ctx);
 	return retval;
 }
+
+/* Incremental GCM state; the tag is checked by hand when decrypting */
+typedef struct {
+	mbedtls_gcm_context gcm;
+	int mode;
+} sdo_gcm_stream_t;
+
+/**
+ * sdo_crypto_aes_gcm_begin -  Start an incremental AES GCM encryption or
+ * decryption.
+ *
+ * @param encrypt
+ *        true to encrypt, false to decrypt.
+ * @param iv
+ *        AES encryption IV.
+ * @param iv_length
+ *        AES encryption IV size in bytes.
+ * @param key
+ *        Key in Byte_array format used in encryption.
+ * @param key_length
+ *        Key size in Bytes. Only AES128 is supported
+ * @return ret
+ *        context for sdo_crypto_aes_gcm_update/end, NULL on error.
+ */
+void *sdo_crypto_aes_gcm_begin(bool encrypt, const uint8_t *iv,
+			       uint32_t iv_length, const uint8_t *key,
+			       uint32_t key_length)
+{
+	sdo_gcm_stream_t *ctx = NULL;
+
+	if (NULL == iv || 0 == iv_length || NULL == key ||
+	    key_length != PLATFORM_AES_KEY_DEFAULT_LEN) {
+		LOG(LOG_ERROR, "Invalid parameters!\n");
+		return NULL;
+	}
+
+	ctx = sdo_alloc(sizeof(sdo_gcm_stream_t));
+	if (NULL == ctx)
+		return NULL;
+
+	mbedtls_gcm_init(&ctx->gcm);
+	ctx->mode = encrypt ? MBEDTLS_GCM_ENCRYPT : MBEDTLS_GCM_DECRYPT;
+
+	if (mbedtls_gcm_setkey(&ctx->gcm, MBEDTLS_CIPHER_ID_AES,
+			       (const unsigned char *)key,
+			       key_length * 8) != 0 ||
+	    mbedtls_gcm_starts(&ctx->gcm, ctx->mode,
+			       (const unsigned char *)iv, iv_length, NULL,
+			       0) != 0) {
+		LOG(LOG_ERROR, "AES GCM: initialization failed!\n");
+		mbedtls_gcm_free(&ctx->gcm);
+		sdo_free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+/**
+ * sdo_crypto_aes_gcm_update -  Encrypt or decrypt the next part of the data.
+ *
+ * @param ctx
+ *        context from sdo_crypto_aes_gcm_begin.
+ * @param in
+ *        input text.
+ * @param out
+ *        output text, may be the same as in.
+ * @param length
+ *        size of in and out in bytes; a multiple of 16 except for the last
+ *        part.
+ * @return ret
+ *        return 0 on success and -1 during any error.
+ */
+int32_t sdo_crypto_aes_gcm_update(void *ctx, const uint8_t *in, uint8_t *out,
+				  uint32_t length)
+{
+	sdo_gcm_stream_t *stream = ctx;
+
+	if (NULL == stream || NULL == in || NULL == out) {
+		LOG(LOG_ERROR, "Invalid parameters!\n");
+		return -1;
+	}
+
+	if (0 == length)
+		return 0;
+
+	if (mbedtls_gcm_update(&stream->gcm, length, in, out) != 0) {
+		LOG(LOG_ERROR, "AES GCM: update failed!\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * sdo_crypto_aes_gcm_end -  Finish an incremental AES GCM operation and free
+ * its context.
+ *
+ * @param ctx
+ *        context from sdo_crypto_aes_gcm_begin.
+ * @param tag
+ *        tag added during encryption (output), or expected when decrypting.
+ *        NULL only discards the context.
+ * @param tag_length
+ *        tag size in Bytes.
+ * @return ret
+ *        return 0 on success and -1 during any error, including a tag
+ *        mismatch.
+ */
+int32_t sdo_crypto_aes_gcm_end(void *ctx, uint8_t *tag, uint32_t tag_length)
+{
+	sdo_gcm_stream_t *stream = ctx;
+	uint8_t computed_tag[AES_GCM_TAG_LEN] = {0};
+	uint8_t diff = 0;
+	int32_t retval = -1;
+	uint32_t i;
+
+	if (NULL == stream)
+		return -1;
+
+	if (NULL == tag)
+		goto end;
+
+	if (tag_length != AES_GCM_TAG_LEN) {
+		LOG(LOG_ERROR, "Invalid parameters!\n");
+		goto end;
+	}
+
+	if (mbedtls_gcm_finish(&stream->gcm, computed_tag, tag_length) != 0) {
+		LOG(LOG_ERROR, "AES GCM: finish failed!\n");
+		goto end;
+	}
+
+	if (stream->mode == MBEDTLS_GCM_ENCRYPT) {
+		if (memcpy_s(tag, tag_length, computed_tag, tag_length) != 0)
+			goto end;
+	} else {
+		/* Constant time compare */
+		for (i = 0; i < tag_length; i++)
+			diff |= computed_tag[i] ^ tag[i];
+		if (diff != 0)
+			goto end;
+	}
+	retval = 0;
+
+end:
+	mbedtls_gcm_free(&stream->gcm);
+	sdo_free(stream);
+	return retval;
+}
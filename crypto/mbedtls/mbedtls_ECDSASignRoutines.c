@@ -147,3 +147,20 @@ end:
 	}
 	return ret;
 }
+
+/**
+ * mbedTLS has no sign setup facility, so there is nothing to
+ * precompute. Signatures are computed entirely in crypto_hal_ecdsa_sign().
+ * @return 0 always.
+ */
+int32_t crypto_hal_ecdsa_sign_precompute(void)
+{
+	return 0;
+}
+
+/**
+ * Nothing is precomputed, so there is nothing to discard.
+ */
+void crypto_hal_ecdsa_sign_precompute_clear(void)
+{
+}
@@ -226,6 +226,99 @@ int32_t crypto_hal_hash(uint8_t _hash_type, const uint8_t *buffer,
 	return 0;
 }
 
+/**
+ * crypto_hal_hash_begin function starts an incremental hash
+ *
+ * @param hash_type - Hash type (SDO_CRYPTO_HASH_TYPE_SHA_256/
+ *				SDO_CRYPTO_HASH_TYPE_SHA_384)
+ * @return
+ *        return context for crypto_hal_hash_update/end, NULL on failure.
+ */
+void *crypto_hal_hash_begin(uint8_t hash_type)
+{
+	const mbedtls_md_info_t *md_info = NULL;
+	mbedtls_md_context_t *ctx = NULL;
+
+	switch (hash_type) {
+	case SDO_CRYPTO_HASH_TYPE_SHA_256:
+		md_info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+		break;
+	case SDO_CRYPTO_HASH_TYPE_SHA_384:
+		md_info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA384);
+		break;
+	default:
+		return NULL;
+	}
+
+	ctx = sdo_alloc(sizeof(mbedtls_md_context_t));
+	if (NULL == ctx)
+		return NULL;
+
+	mbedtls_md_init(ctx);
+	if (mbedtls_md_setup(ctx, md_info, 0) != 0 ||
+	    mbedtls_md_starts(ctx) != 0) {
+		mbedtls_md_free(ctx);
+		sdo_free(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+/**
+ * crypto_hal_hash_update function adds input data to an incremental hash
+ *
+ * @param ctx - context from crypto_hal_hash_begin.
+ * @param buffer - pointer to input data buffer of uint8_t type.
+ * @param buffer_length - input data buffer size
+ * @return
+ *        return 0 on success. -ve value on failure.
+ */
+int32_t crypto_hal_hash_update(void *ctx, const uint8_t *buffer,
+			       size_t buffer_length)
+{
+	if (NULL == ctx || (NULL == buffer && 0 != buffer_length))
+		return -1;
+
+	if (0 == buffer_length)
+		return 0;
+
+	return mbedtls_md_update(ctx, buffer, buffer_length);
+}
+
+/**
+ * crypto_hal_hash_end function completes an incremental hash and frees its
+ * context
+ *
+ * @param ctx - context from crypto_hal_hash_begin.
+ * @param output - pointer to output data buffer of uint8_t type, NULL to
+ *		   only free the context.
+ * @param output_length - output data buffer size
+ * @return
+ *        return 0 on success. -ve value on failure.
+ */
+int32_t crypto_hal_hash_end(void *ctx, uint8_t *output, size_t output_length)
+{
+	mbedtls_md_context_t *md_ctx = ctx;
+	int32_t ret = -1;
+
+	if (NULL == md_ctx)
+		return -1;
+
+	if (NULL == output)
+		goto end;
+
+	if (output_length < mbedtls_md_get_size(md_ctx->md_info))
+		goto end;
+
+	if (mbedtls_md_finish(md_ctx, output) == 0)
+		ret = 0;
+
+end:
+	mbedtls_md_free(md_ctx);
+	sdo_free(md_ctx);
+	return ret;
+}
+
 /**
  * crypto_hal_hmac function calculate hmac on input data
  *
@@ -276,4 +369,103 @@ int32_t crypto_hal_hmac(uint8_t hmac_type, const uint8_t *buffer,
 
 	return -1;
 }
+/**
+ * crypto_hal_hmac_begin function starts an incremental hmac
+ *
+ * @param hmac_type - Hmac type (SDO_CRYPTO_HMAC_TYPE_SHA_256/
+ *				SDO_CRYPTO_HMAC_TYPE_SHA_384)
+ * @param key - pointer to hmac key buffer of uint8_t type.
+ * @param key_length - hmac key size
+ * @return
+ *        return context for crypto_hal_hmac_update/end, NULL on failure.
+ */
+void *crypto_hal_hmac_begin(uint8_t hmac_type, const uint8_t *key,
+			    size_t key_length)
+{
+	const mbedtls_md_info_t *md_info = NULL;
+	mbedtls_md_context_t *ctx = NULL;
+
+	if (NULL == key || 0 == key_length)
+		return NULL;
+
+	switch (hmac_type) {
+	case SDO_CRYPTO_HMAC_TYPE_SHA_256:
+		md_info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+		break;
+	case SDO_CRYPTO_HMAC_TYPE_SHA_384:
+		md_info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA384);
+		break;
+	default:
+		return NULL;
+	}
+
+	ctx = sdo_alloc(sizeof(mbedtls_md_context_t));
+	if (NULL == ctx)
+		return NULL;
+
+	mbedtls_md_init(ctx);
+	if (mbedtls_md_setup(ctx, md_info, 1) != 0 ||
+	    mbedtls_md_hmac_starts(ctx, key, key_length) != 0) {
+		mbedtls_md_free(ctx);
+		sdo_free(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+/**
+ * crypto_hal_hmac_update function adds input data to an incremental hmac
+ *
+ * @param ctx - context from crypto_hal_hmac_begin.
+ * @param buffer - pointer to input data buffer of uint8_t type.
+ * @param buffer_length - input data buffer size
+ * @return
+ *        return 0 on success. -ve value on failure.
+ */
+int32_t crypto_hal_hmac_update(void *ctx, const uint8_t *buffer,
+			       size_t buffer_length)
+{
+	if (NULL == ctx || (NULL == buffer && 0 != buffer_length))
+		return -1;
+
+	if (0 == buffer_length)
+		return 0;
+
+	return mbedtls_md_hmac_update(ctx, buffer, buffer_length);
+}
+
+/**
+ * crypto_hal_hmac_end function completes an incremental hmac and frees its
+ * context
+ *
+ * @param ctx - context from crypto_hal_hmac_begin.
+ * @param output - pointer to output data buffer of uint8_t type, NULL to
+ *		   only free the context.
+ * @param output_length - output data buffer size
+ * @return
+ *        return 0 on success. -ve value on failure.
+ */
+int32_t crypto_hal_hmac_end(void *ctx, uint8_t *output, size_t output_length)
+{
+	mbedtls_md_context_t *md_ctx = ctx;
+	int32_t ret = -1;
+
+	if (NULL == md_ctx)
+		return -1;
+
+	if (NULL == output)
+		goto end;
+
+	if (output_length < mbedtls_md_get_size(md_ctx->md_info))
+		goto end;
+
+	if (mbedtls_md_hmac_finish(md_ctx, output) == 0)
+		ret = 0;
+
+end:
+	mbedtls_md_free(md_ctx);
+	sdo_free(md_ctx);
+	return ret;
+}
+
 #endif /* SECURE_ELEMENT */
@@ -142,3 +142,102 @@ err:
 	return ec_key;
 }
 #endif
+
+/**
+ * Generate a new device private key on the curve of the device attestation.
+ * @return the key, or NULL on failure.
+ */
+EC_KEY *ec_key_generate(void)
+{
+	int32_t curve = NID_X9_62_prime256v1;
+	EC_KEY *ec_key = NULL;
+
+#ifdef ECDSA384_DA
+	curve = NID_secp384r1;
+#endif
+
+	ec_key = EC_KEY_new_by_curve_name(curve);
+	if (!ec_key) {
+		LOG(LOG_ERROR, "Failed to allocate ec key\n");
+		return NULL;
+	}
+	/* PEM keys carry the curve by name, as the provisioned ones do */
+	EC_KEY_set_asn1_flag(ec_key, OPENSSL_EC_NAMED_CURVE);
+
+	if (!EC_KEY_generate_key(ec_key)) {
+		LOG(LOG_ERROR, "Failed to generate ec key\n");
+		EC_KEY_free(ec_key);
+		return NULL;
+	}
+	return ec_key;
+}
+
+/**
+ * Write the private key in the format get_ec_key() loads from ECDSA_PRIVKEY:
+ * PEM, or the raw big-endian private key.
+ * @param ec_key - key to write.
+ * @param buf - output, sdo_alloc()ed buffer the caller frees.
+ * @param length - output, size of buf.
+ * @return 0 on success, -1 otherwise.
+ */
+int32_t ec_key_to_buf(EC_KEY *ec_key, uint8_t **buf, size_t *length)
+{
+	int32_t ret = -1;
+	uint8_t *privkey = NULL;
+	size_t privkey_size = 0;
+#ifdef ECDSA_PEM
+	BIO *bio = NULL;
+	char *pem = NULL;
+#else
+	const BIGNUM *bn = NULL;
+#endif
+
+	if (!ec_key || !buf || !length) {
+		LOG(LOG_ERROR, "Invalid parameters\n");
+		return -1;
+	}
+
+#ifdef ECDSA_PEM
+	/* secure heap: the private key is cleared when the BIO is freed */
+	bio = BIO_new(BIO_s_secmem());
+	if (!bio ||
+	    !PEM_write_bio_ECPKParameters(bio, EC_KEY_get0_group(ec_key)) ||
+	    !PEM_write_bio_ECPrivateKey(bio, ec_key, NULL, NULL, 0, NULL,
+					NULL)) {
+		LOG(LOG_ERROR, "Failed to write ec key in PEM\n");
+		goto err;
+	}
+	privkey_size = BIO_get_mem_data(bio, &pem);
+	privkey = sdo_alloc(privkey_size);
+	if (!privkey || memcpy_s(privkey, privkey_size, pem, privkey_size)) {
+		LOG(LOG_ERROR, "Failed to copy ec key\n");
+		goto err;
+	}
+#else
+	bn = EC_KEY_get0_private_key(ec_key);
+	privkey_size = (size_t)(EC_GROUP_order_bits(EC_KEY_get0_group(ec_key)) +
+				7) / 8;
+	privkey = sdo_alloc(privkey_size);
+	if (!bn || !privkey ||
+	    BN_bn2binpad(bn, privkey, (int)privkey_size) != (int)privkey_size) {
+		LOG(LOG_ERROR, "Failed to write ec private key\n");
+		goto err;
+	}
+#endif
+
+	*buf = privkey;
+	*length = privkey_size;
+	privkey = NULL;
+	ret = 0;
+err:
+	if (privkey) {
+		if (memset_s(privkey, privkey_size, 0) != 0)
+			LOG(LOG_ERROR, "Memset Failed\n");
+		sdo_free(privkey);
+	}
+#ifdef ECDSA_PEM
+	if (bio)
+		BIO_free(bio);
+#endif
+	return ret;
+}
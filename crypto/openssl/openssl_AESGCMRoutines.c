@@ -256,3 +256,144 @@ end:
 		EVP_CIPHER_CTX_free(ctx);
 	return retval;
 }
+
+/**
+ * sdo_crypto_aes_gcm_begin -  Start an incremental AES GCM encryption or
+ * decryption.
+ *
+ * @param encrypt
+ *        true to encrypt, false to decrypt.
+ * @param iv
+ *        AES encryption IV.
+ * @param iv_length
+ *        AES encryption IV size in bytes.
+ * @param key
+ *        Key in Byte_array format used in encryption.
+ * @param key_length
+ *        Key size in Bytes. Only AES128 is supported
+ * @return ret
+ *        context for sdo_crypto_aes_gcm_update/end, NULL on error.
+ */
+void *sdo_crypto_aes_gcm_begin(bool encrypt, const uint8_t *iv,
+			       uint32_t iv_length, const uint8_t *key,
+			       uint32_t key_length)
+{
+	EVP_CIPHER_CTX *ctx = NULL;
+
+	if (NULL == iv || 0 == iv_length || NULL == key ||
+	    key_length != PLATFORM_AES_KEY_DEFAULT_LEN) {
+		LOG(LOG_ERROR, "Invalid parameters!\n");
+		return NULL;
+	}
+
+	ctx = EVP_CIPHER_CTX_new();
+	if (NULL == ctx) {
+		LOG(LOG_ERROR, "Error during Initializing EVP cipher ctx!\n");
+		return NULL;
+	}
+
+	if (1 != EVP_CipherInit_ex(ctx, EVP_aes_128_gcm(), NULL, NULL, NULL,
+				   encrypt ? 1 : 0) ||
+	    1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, iv_length,
+				     NULL) ||
+	    1 != EVP_CipherInit_ex(ctx, NULL, NULL, key, iv, encrypt ? 1 : 0)) {
+		LOG(LOG_ERROR, "AES GCM: initialization failed!\n");
+		EVP_CIPHER_CTX_free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+/**
+ * sdo_crypto_aes_gcm_update -  Encrypt or decrypt the next part of the data.
+ *
+ * @param ctx
+ *        context from sdo_crypto_aes_gcm_begin.
+ * @param in
+ *        input text.
+ * @param out
+ *        output text, may be the same as in.
+ * @param length
+ *        size of in and out in bytes.
+ * @return ret
+ *        return 0 on success and -1 during any error.
+ */
+int32_t sdo_crypto_aes_gcm_update(void *ctx, const uint8_t *in, uint8_t *out,
+				  uint32_t length)
+{
+	int len = 0;
+
+	if (NULL == ctx || NULL == in || NULL == out) {
+		LOG(LOG_ERROR, "Invalid parameters!\n");
+		return -1;
+	}
+
+	if (0 == length)
+		return 0;
+
+	if (1 != EVP_CipherUpdate(ctx, out, &len, in, length) ||
+	    (uint32_t)len != length) {
+		LOG(LOG_ERROR, "AES GCM: EVP_CipherUpdate() failed!\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * sdo_crypto_aes_gcm_end -  Finish an incremental AES GCM operation and free
+ * its context.
+ *
+ * @param ctx
+ *        context from sdo_crypto_aes_gcm_begin.
+ * @param tag
+ *        tag added during encryption (output), or expected when decrypting.
+ *        NULL only discards the context.
+ * @param tag_length
+ *        tag size in Bytes.
+ * @return ret
+ *        return 0 on success and -1 during any error, including a tag
+ *        mismatch.
+ */
+int32_t sdo_crypto_aes_gcm_end(void *ctx, uint8_t *tag, uint32_t tag_length)
+{
+	int32_t retval = -1;
+	uint8_t final_block[AES_GCM_TAG_LEN];
+	int len = 0;
+
+	if (NULL == ctx)
+		return -1;
+
+	if (NULL == tag)
+		goto end;
+
+	if (tag_length != AES_GCM_TAG_LEN) {
+		LOG(LOG_ERROR, "Invalid parameters!\n");
+		goto end;
+	}
+
+	if (EVP_CIPHER_CTX_encrypting(ctx)) {
+		if (1 != EVP_EncryptFinal_ex(ctx, final_block, &len) ||
+		    1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG,
+					     tag_length, tag)) {
+			LOG(LOG_ERROR, "AES GCM: could not get required tag "
+				       "value during encryption!\n");
+			goto end;
+		}
+	} else {
+		if (1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG,
+					     tag_length, tag)) {
+			LOG(LOG_ERROR, "AES GCM: could not set exptected tag "
+				       "value during decryption!\n");
+			goto end;
+		}
+		/* A positive return value indicates authentication passed */
+		if (EVP_DecryptFinal_ex(ctx, final_block, &len) <= 0)
+			goto end;
+	}
+	retval = 0;
+
+end:
+	EVP_CIPHER_CTX_free(ctx);
+	return retval;
+}
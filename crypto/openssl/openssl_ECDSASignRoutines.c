@@ -13,12 +13,199 @@
 #include <openssl/ssl.h>
 #include <openssl/ossl_typ.h>
 #include <openssl/pem.h>
+#include <pthread.h>
 #include "sdoCryptoHal.h"
 #include "util.h"
 #include "storage_al.h"
 #include "safe_lib.h"
 #include "ec_key.h"
 
+/* Number of prepared signatures: one each for msg32 and msg44 */
+#define ECDSA_PRECOMPUTE_POOL 2
+
+/*
+ * Message independent part of an ECDSA signature: k^-1 and r. Each entry is
+ * consumed by exactly one signature and cleared after use.
+ */
+typedef struct {
+	BIGNUM *kinv;
+	BIGNUM *rp;
+} ecdsa_precomp_t;
+
+/* The pool belongs to the device key, so SDK contexts share it */
+static ecdsa_precomp_t ecdsa_pool[ECDSA_PRECOMPUTE_POOL];
+static pthread_mutex_t ecdsa_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t ecdsa_pool_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Internal API
+ * Release a pool entry, clearing the secret values.
+ */
+static void ecdsa_precomp_free(ecdsa_precomp_t *pre)
+{
+	if (pre->kinv) {
+		BN_clear_free(pre->kinv);
+		pre->kinv = NULL;
+	}
+	if (pre->rp) {
+		BN_clear_free(pre->rp);
+		pre->rp = NULL;
+	}
+}
+
+/**
+ * Internal API
+ * Release every pool entry, with ecdsa_pool_lock held.
+ */
+static void ecdsa_pool_drain(void)
+{
+	for (int i = 0; i < ECDSA_PRECOMPUTE_POOL; i++)
+		ecdsa_precomp_free(&ecdsa_pool[i]);
+}
+
+/**
+ * Internal API
+ * fork() handlers. The pool is held across the fork, so the child gets a
+ * consistent copy, which it drains: an entry used by both processes would
+ * sign twice with one nonce and disclose the device key.
+ */
+static void ecdsa_pool_fork_prepare(void)
+{
+	(void)pthread_mutex_lock(&ecdsa_pool_lock);
+}
+
+static void ecdsa_pool_fork_parent(void)
+{
+	(void)pthread_mutex_unlock(&ecdsa_pool_lock);
+}
+
+static void ecdsa_pool_fork_child(void)
+{
+	ecdsa_pool_drain();
+	(void)pthread_mutex_unlock(&ecdsa_pool_lock);
+}
+
+/**
+ * Internal API
+ * Register the fork() handlers, once, before the first entry is pooled.
+ */
+static void ecdsa_pool_init(void)
+{
+	if (pthread_atfork(ecdsa_pool_fork_prepare, ecdsa_pool_fork_parent,
+			   ecdsa_pool_fork_child) != 0)
+		LOG(LOG_ERROR, "Failed to register ECDSA pool fork handlers\n");
+}
+
+/**
+ * Internal API
+ * Whether the pool has an empty entry.
+ */
+static bool ecdsa_pool_has_room(void)
+{
+	bool room = false;
+
+	(void)pthread_mutex_lock(&ecdsa_pool_lock);
+	for (int i = 0; i < ECDSA_PRECOMPUTE_POOL; i++)
+		if (!ecdsa_pool[i].kinv)
+			room = true;
+	(void)pthread_mutex_unlock(&ecdsa_pool_lock);
+	return room;
+}
+
+/**
+ * Internal API
+ * Put a prepared entry into an empty slot of the pool, or clear it if the
+ * pool was filled meanwhile.
+ */
+static void ecdsa_pool_put(ecdsa_precomp_t *pre)
+{
+	(void)pthread_once(&ecdsa_pool_once, ecdsa_pool_init);
+	(void)pthread_mutex_lock(&ecdsa_pool_lock);
+	for (int i = 0; i < ECDSA_PRECOMPUTE_POOL; i++) {
+		if (!ecdsa_pool[i].kinv) {
+			ecdsa_pool[i] = *pre;
+			pre->kinv = NULL;
+			pre->rp = NULL;
+			break;
+		}
+	}
+	(void)pthread_mutex_unlock(&ecdsa_pool_lock);
+	ecdsa_precomp_free(pre);
+}
+
+/**
+ * Fill the empty entries of the signature precompute pool using
+ * ECDSA_sign_setup(), so that signing on the protocol path only does the
+ * message dependent step. The pool is not locked while an entry is
+ * computed, so a signature needed meanwhile is not held up: it takes an
+ * entry that is ready, or signs without one.
+ * @return 0 on success, else -1.
+ */
+int32_t crypto_hal_ecdsa_sign_precompute(void)
+{
+	int32_t ret = -1;
+	EC_KEY *eckey = NULL;
+	BN_CTX *bn_ctx = NULL;
+	ecdsa_precomp_t pre = {NULL, NULL};
+
+	if (!ecdsa_pool_has_room())
+		return 0;
+
+	eckey = get_ec_key();
+	bn_ctx = BN_CTX_new();
+	if (!eckey || !bn_ctx) {
+		LOG(LOG_ERROR, "Failed to prepare ECDSA precompute\n");
+		goto end;
+	}
+
+	do {
+		if (ECDSA_sign_setup(eckey, bn_ctx, &pre.kinv, &pre.rp) != 1) {
+			LOG(LOG_ERROR, "ECDSA_sign_setup() failed!\n");
+			ecdsa_precomp_free(&pre);
+			goto end;
+		}
+		ecdsa_pool_put(&pre);
+	} while (ecdsa_pool_has_room());
+	ret = 0;
+
+end:
+	if (bn_ctx)
+		BN_CTX_free(bn_ctx);
+	if (eckey)
+		EC_KEY_free(eckey);
+	return ret;
+}
+
+/**
+ * Discard all unused precomputed signature values. A child process does
+ * this on its own right after fork().
+ */
+void crypto_hal_ecdsa_sign_precompute_clear(void)
+{
+	(void)pthread_mutex_lock(&ecdsa_pool_lock);
+	ecdsa_pool_drain();
+	(void)pthread_mutex_unlock(&ecdsa_pool_lock);
+}
+
+/**
+ * Internal API
+ * Take a pool entry out of the pool, so it can never be handed out twice.
+ * @param pre - filled with the entry, left empty if the pool is drained.
+ */
+static void ecdsa_precomp_take(ecdsa_precomp_t *pre)
+{
+	(void)pthread_mutex_lock(&ecdsa_pool_lock);
+	for (int i = 0; i < ECDSA_PRECOMPUTE_POOL; i++) {
+		if (ecdsa_pool[i].kinv && ecdsa_pool[i].rp) {
+			*pre = ecdsa_pool[i];
+			ecdsa_pool[i].kinv = NULL;
+			ecdsa_pool[i].rp = NULL;
+			break;
+		}
+	}
+	(void)pthread_mutex_unlock(&ecdsa_pool_lock);
+}
+
 /**
  * Sign a message using provided ECDSA Private Keys.
  * @param data - pointer of type uint8_t, holds the plaintext message.
@@ -38,6 +225,7 @@ int32_t crypto_hal_ecdsa_sign(const uint8_t *data, size_t data_len,
 	unsigned char *signature = NULL;
 	unsigned int sig_len = 0;
 	size_t hash_length = 0;
+	ecdsa_precomp_t pre = {NULL, NULL};
 
 	if (!data || !data_len || !message_signature || !signature_length) {
 		LOG(LOG_ERROR, "sdo_cryptoECDSASign params not valid\n");
@@ -78,9 +266,12 @@ int32_t crypto_hal_ecdsa_sign(const uint8_t *data, size_t data_len,
 		goto end;
 #endif
 
-	// ECDSA_sign return 1 on success, 0 on failure
-	int result =
-	    ECDSA_sign(0, hash, hash_length, signature, &sig_len, eckey);
+	/* Use a precomputed k^-1/r if available, else compute them now */
+	ecdsa_precomp_take(&pre);
+
+	// ECDSA_sign_ex return 1 on success, 0 on failure
+	int result = ECDSA_sign_ex(0, hash, hash_length, signature, &sig_len,
+				   pre.kinv, pre.rp, eckey);
 	if (result == 0) {
 		LOG(LOG_ERROR, "ECDSA_sign() failed!\n");
 		goto end;
@@ -95,6 +286,7 @@ int32_t crypto_hal_ecdsa_sign(const uint8_t *data, size_t data_len,
 	ret = 0;
 
 end:
+	ecdsa_precomp_free(&pre);
 	if (signature)
 		OPENSSL_free(signature);
 	if (eckey)
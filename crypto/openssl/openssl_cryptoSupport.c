@@ -15,6 +15,10 @@
 #include <openssl/err.h>
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
 
 #include <openssl/sha.h>
 #include <openssl/ssl.h>
@@ -100,8 +104,8 @@ int32_t inc_rollover_ctr(uint8_t *first_iv, uint8_t *new_iv, uint8_t iv_len,
 		goto err;
 	}
 
-	/* Write bn to binary data */
-	if (BN_bn2bin(iv_bn_new, new_iv) > iv_len) {
+	/* Write bn to binary data, keeping leading zero bytes */
+	if (BN_bn2binpad(iv_bn_new, new_iv, iv_len) != iv_len) {
 		LOG(LOG_ERROR, "New iv from BN write failed\n");
 		goto err;
 	}
@@ -277,6 +281,96 @@ int32_t crypto_hal_hash(uint8_t _hash_type, const uint8_t *buffer,
 	return 0;
 }
 
+/**
+ * crypto_hal_hash_begin function starts an incremental hash
+ *
+ * @param hash_type - Hash type (SDO_CRYPTO_HASH_TYPE_SHA_256/
+ *				SDO_CRYPTO_HASH_TYPE_SHA_384)
+ * @return
+ *        return context for crypto_hal_hash_update/end, NULL on failure.
+ */
+void *crypto_hal_hash_begin(uint8_t hash_type)
+{
+	const EVP_MD *md = NULL;
+	EVP_MD_CTX *ctx = NULL;
+
+	switch (hash_type) {
+	case SDO_CRYPTO_HASH_TYPE_SHA_256:
+		md = EVP_sha256();
+		break;
+	case SDO_CRYPTO_HASH_TYPE_SHA_384:
+		md = EVP_sha384();
+		break;
+	default:
+		return NULL;
+	}
+
+	ctx = EVP_MD_CTX_new();
+	if (NULL == ctx)
+		return NULL;
+
+	if (1 != EVP_DigestInit_ex(ctx, md, NULL)) {
+		EVP_MD_CTX_free(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+/**
+ * crypto_hal_hash_update function adds input data to an incremental hash
+ *
+ * @param ctx - context from crypto_hal_hash_begin.
+ * @param buffer - pointer to input data buffer of uint8_t type.
+ * @param buffer_length - input data buffer size
+ * @return
+ *        return 0 on success. -ve value on failure.
+ */
+int32_t crypto_hal_hash_update(void *ctx, const uint8_t *buffer,
+			       size_t buffer_length)
+{
+	if (NULL == ctx || (NULL == buffer && 0 != buffer_length))
+		return -1;
+
+	if (0 == buffer_length)
+		return 0;
+
+	if (1 != EVP_DigestUpdate(ctx, buffer, buffer_length))
+		return -1;
+	return 0;
+}
+
+/**
+ * crypto_hal_hash_end function completes an incremental hash and frees its
+ * context
+ *
+ * @param ctx - context from crypto_hal_hash_begin.
+ * @param output - pointer to output data buffer of uint8_t type, NULL to
+ *		   only free the context.
+ * @param output_length - output data buffer size
+ * @return
+ *        return 0 on success. -ve value on failure.
+ */
+int32_t crypto_hal_hash_end(void *ctx, uint8_t *output, size_t output_length)
+{
+	int32_t ret = -1;
+
+	if (NULL == ctx)
+		return -1;
+
+	if (NULL == output)
+		goto end;
+
+	if (output_length < (size_t)EVP_MD_CTX_size(ctx))
+		goto end;
+
+	if (1 == EVP_DigestFinal_ex(ctx, output, NULL))
+		ret = 0;
+
+end:
+	EVP_MD_CTX_free(ctx);
+	return ret;
+}
+
 /**
  * crypto_hal_hmac function calculate hmac on input data
  *
@@ -325,4 +419,158 @@ int32_t crypto_hal_hmac(uint8_t hmac_type, const uint8_t *buffer,
 
 	return 0;
 }
+
+/**
+ * crypto_hal_hmac_begin function starts an incremental hmac
+ *
+ * @param hmac_type - Hmac type (SDO_CRYPTO_HMAC_TYPE_SHA_256/
+ *				SDO_CRYPTO_HMAC_TYPE_SHA_384)
+ * @param key - pointer to hmac key buffer of uint8_t type.
+ * @param key_length - hmac key size
+ * @return
+ *        return context for crypto_hal_hmac_update/end, NULL on failure.
+ */
+void *crypto_hal_hmac_begin(uint8_t hmac_type, const uint8_t *key,
+			    size_t key_length)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	const char *digest = NULL;
+	EVP_MAC *mac = NULL;
+	EVP_MAC_CTX *ctx = NULL;
+	OSSL_PARAM params[2];
+#else
+	const EVP_MD *md = NULL;
+	HMAC_CTX *ctx = NULL;
+#endif
+
+	if (NULL == key || 0 == key_length)
+		return NULL;
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	switch (hmac_type) {
+	case SDO_CRYPTO_HMAC_TYPE_SHA_256:
+		digest = "SHA256";
+		break;
+	case SDO_CRYPTO_HMAC_TYPE_SHA_384:
+		digest = "SHA384";
+		break;
+	default:
+		return NULL;
+	}
+
+	mac = EVP_MAC_fetch(NULL, OSSL_MAC_NAME_HMAC, NULL);
+	if (NULL == mac)
+		return NULL;
+	/* the context keeps its own reference to mac */
+	ctx = EVP_MAC_CTX_new(mac);
+	EVP_MAC_free(mac);
+	if (NULL == ctx)
+		return NULL;
+
+	params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+						     (char *)digest, 0);
+	params[1] = OSSL_PARAM_construct_end();
+	if (1 != EVP_MAC_init(ctx, key, key_length, params)) {
+		EVP_MAC_CTX_free(ctx);
+		return NULL;
+	}
+#else
+	switch (hmac_type) {
+	case SDO_CRYPTO_HMAC_TYPE_SHA_256:
+		md = EVP_sha256();
+		break;
+	case SDO_CRYPTO_HMAC_TYPE_SHA_384:
+		md = EVP_sha384();
+		break;
+	default:
+		return NULL;
+	}
+
+	ctx = HMAC_CTX_new();
+	if (NULL == ctx)
+		return NULL;
+
+	if (1 != HMAC_Init_ex(ctx, key, (int)key_length, md, NULL)) {
+		HMAC_CTX_free(ctx);
+		return NULL;
+	}
+#endif
+	return ctx;
+}
+
+/**
+ * crypto_hal_hmac_update function adds input data to an incremental hmac
+ *
+ * @param ctx - context from crypto_hal_hmac_begin.
+ * @param buffer - pointer to input data buffer of uint8_t type.
+ * @param buffer_length - input data buffer size
+ * @return
+ *        return 0 on success. -ve value on failure.
+ */
+int32_t crypto_hal_hmac_update(void *ctx, const uint8_t *buffer,
+			       size_t buffer_length)
+{
+	if (NULL == ctx || (NULL == buffer && 0 != buffer_length))
+		return -1;
+
+	if (0 == buffer_length)
+		return 0;
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	if (1 != EVP_MAC_update(ctx, buffer, buffer_length))
+#else
+	if (1 != HMAC_Update(ctx, buffer, buffer_length))
+#endif
+		return -1;
+	return 0;
+}
+
+/**
+ * crypto_hal_hmac_end function completes an incremental hmac and frees its
+ * context
+ *
+ * @param ctx - context from crypto_hal_hmac_begin.
+ * @param output - pointer to output data buffer of uint8_t type, NULL to
+ *		   only free the context.
+ * @param output_length - output data buffer size
+ * @return
+ *        return 0 on success. -ve value on failure.
+ */
+int32_t crypto_hal_hmac_end(void *ctx, uint8_t *output, size_t output_length)
+{
+	int32_t ret = -1;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	size_t len = 0;
+#else
+	unsigned int len = 0;
+#endif
+
+	if (NULL == ctx)
+		return -1;
+
+	if (NULL == output)
+		goto end;
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	if (output_length < EVP_MAC_CTX_get_mac_size(ctx))
+		goto end;
+
+	if (1 == EVP_MAC_final(ctx, output, &len, output_length))
+		ret = 0;
+#else
+	if (output_length < (size_t)HMAC_size(ctx))
+		goto end;
+
+	if (1 == HMAC_Final(ctx, output, &len))
+		ret = 0;
+#endif
+
+end:
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	EVP_MAC_CTX_free(ctx);
+#else
+	HMAC_CTX_free(ctx);
+#endif
+	return ret;
+}
 #endif /* SECURE_ELEMENT */
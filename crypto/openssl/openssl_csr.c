@@ -20,14 +20,18 @@
 #include "sdoCryptoHal.h"
 
 /**
- * crypto_hal_get_device_csr() - get the device CSR
+ * ec_key_get_csr() - get the CSR of an EC private key
+ * The public key is derived from the private key and set on ec_key. The key
+ * is not consumed, so callers can generate CSRs for keys they hold.
+ * @param ec_key - EC key holding the private key.
+ * @param csr - output, the CSR in PEM format.
+ * @return 0 on success, -1 otherwise.
  */
-int32_t crypto_hal_get_device_csr(sdo_byte_array_t **csr)
+int32_t ec_key_get_csr(EC_KEY *ec_key, sdo_byte_array_t **csr)
 {
 	int ret = -1;
 	char *csr_data = NULL;
 	size_t csr_size = 0;
-	EC_KEY *ec_key = NULL;
 
 	const EC_GROUP *ec_grp = NULL;
 	BIO *csr_mem_bio = NULL;
@@ -39,15 +43,7 @@ int32_t crypto_hal_get_device_csr(sdo_byte_array_t **csr)
 	X509_REQ *x509_req = X509_REQ_new();
 	sdo_byte_array_t *csr_byte_arr = NULL;
 
-	if (!ec_pkey || !x509_req) {
-		ret = -1;
-		goto err;
-	}
-
-	/* Get the EC private key from storage */
-	ec_key = get_ec_key();
-	if (!ec_key) {
-		LOG(LOG_ERROR, "Failed to load the ec key for CSR\n");
+	if (!ec_pkey || !x509_req || !ec_key || !csr) {
 		ret = -1;
 		goto err;
 	}
@@ -118,7 +114,7 @@ int32_t crypto_hal_get_device_csr(sdo_byte_array_t **csr)
 		goto err;
 	}
 
-	ret = EVP_PKEY_assign_EC_KEY(ec_pkey, ec_key);
+	ret = EVP_PKEY_set1_EC_KEY(ec_pkey, ec_key);
 	if (!ret) {
 		LOG(LOG_ERROR, "Failed to get ec_key reference\n");
 		ret = -1;
@@ -195,10 +191,6 @@ err:
 	}
 	if (ec_pkey) {
 		EVP_PKEY_free(ec_pkey);
-		ec_key = NULL; // evp_pkey_free clears attached ec_key too
-	}
-	if (ec_key) {
-		EC_KEY_free(ec_key);
 	}
 	if (pub_key) {
 		EC_POINT_free(pub_key);
@@ -206,6 +198,29 @@ err:
 	if (x509_req) {
 		X509_REQ_free(x509_req);
 	}
-	*csr = csr_byte_arr;
+	if (csr)
+		*csr = csr_byte_arr;
+	return ret;
+}
+
+/**
+ * crypto_hal_get_device_csr() - get the device CSR
+ */
+int32_t crypto_hal_get_device_csr(sdo_byte_array_t **csr)
+{
+	int32_t ret = -1;
+	EC_KEY *ec_key = NULL;
+
+	/* Get the EC private key from storage */
+	ec_key = get_ec_key();
+	if (!ec_key) {
+		LOG(LOG_ERROR, "Failed to load the ec key for CSR\n");
+		if (csr)
+			*csr = NULL;
+		return -1;
+	}
+
+	ret = ec_key_get_csr(ec_key, csr);
+	EC_KEY_free(ec_key);
 	return ret;
 }
@@ -177,3 +177,154 @@ int32_t sdo_crypto_aes_gcm_decrypt(uint8_t *clear_text,
 
 	return 0;
 }
+
+/* Incremental GCM state kept on the host side of the SE session */
+typedef struct {
+	atca_aes_gcm_ctx_t gcm;
+	bool encrypt;
+} sdo_gcm_stream_t;
+
+/**
+ * sdo_crypto_aes_gcm_begin -  Start an incremental AES GCM encryption or
+ * decryption with the key provisioned in the SE.
+ *
+ * @param encrypt
+ *        true to encrypt, false to decrypt.
+ * @param iv
+ *        AES encryption IV.
+ * @param iv_length
+ *        AES encryption IV size in bytes.
+ * @param key
+ *        Key in Byte_array format used in encryption.
+ * @param key_length
+ *        Key size in Bytes.
+ * @return ret
+ *        context for sdo_crypto_aes_gcm_update/end, NULL on error.
+ */
+void *sdo_crypto_aes_gcm_begin(bool encrypt, const uint8_t *iv,
+			       uint32_t iv_length, const uint8_t *key,
+			       uint32_t key_length)
+{
+	sdo_gcm_stream_t *ctx = NULL;
+
+	if (NULL == iv || 0 == iv_length || NULL == key || 0 == key_length) {
+		LOG(LOG_ERROR, "Invalid parameters!\n");
+		return NULL;
+	}
+
+	ctx = sdo_alloc(sizeof(sdo_gcm_stream_t));
+	if (NULL == ctx)
+		return NULL;
+
+	ctx->encrypt = encrypt;
+	if (ATCA_SUCCESS != atcab_aes_gcm_init(&ctx->gcm, AES_KEY_ID,
+					       AES_KEY_BLOCK, iv, iv_length)) {
+		LOG(LOG_ERROR, " AES GCM Init on SE failed with errno %d\n",
+		    errno);
+		sdo_free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+/**
+ * sdo_crypto_aes_gcm_update -  Encrypt or decrypt the next part of the data.
+ *
+ * @param ctx
+ *        context from sdo_crypto_aes_gcm_begin.
+ * @param in
+ *        input text.
+ * @param out
+ *        output text, may be the same as in.
+ * @param length
+ *        size of in and out in bytes; a multiple of 16 except for the last
+ *        part.
+ * @return ret
+ *        return 0 on success and -1 during any error.
+ */
+int32_t sdo_crypto_aes_gcm_update(void *ctx, const uint8_t *in, uint8_t *out,
+				  uint32_t length)
+{
+	sdo_gcm_stream_t *stream = ctx;
+	ATCA_STATUS status;
+
+	if (NULL == stream || NULL == in || NULL == out) {
+		LOG(LOG_ERROR, "Invalid parameters!\n");
+		return -1;
+	}
+
+	if (0 == length)
+		return 0;
+
+	if (stream->encrypt)
+		status = atcab_aes_gcm_encrypt_update(&stream->gcm, in, length,
+						      out);
+	else
+		status = atcab_aes_gcm_decrypt_update(&stream->gcm, in, length,
+						      out);
+
+	if (ATCA_SUCCESS != status) {
+		LOG(LOG_ERROR, " AES GCM update on SE failed with errno %d\n",
+		    errno);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * sdo_crypto_aes_gcm_end -  Finish an incremental AES GCM operation and free
+ * its context.
+ *
+ * @param ctx
+ *        context from sdo_crypto_aes_gcm_begin.
+ * @param tag
+ *        tag added during encryption (output), or expected when decrypting.
+ *        NULL only discards the context.
+ * @param tag_length
+ *        tag size in Bytes.
+ * @return ret
+ *        return 0 on success and -1 during any error, including a tag
+ *        mismatch.
+ */
+int32_t sdo_crypto_aes_gcm_end(void *ctx, uint8_t *tag, uint32_t tag_length)
+{
+	sdo_gcm_stream_t *stream = ctx;
+	bool verified = false;
+	int32_t retval = -1;
+
+	if (NULL == stream)
+		return -1;
+
+	if (NULL == tag)
+		goto end;
+
+	if (tag_length != AES_GCM_TAG_LEN) {
+		LOG(LOG_ERROR, "Invalid parameters!\n");
+		goto end;
+	}
+
+	if (stream->encrypt) {
+		if (ATCA_SUCCESS != atcab_aes_gcm_encrypt_finish(
+					&stream->gcm, tag, tag_length)) {
+			LOG(LOG_ERROR,
+			    " AES GCM encrypt finish on SE failed with errno "
+			    "%d\n",
+			    errno);
+			goto end;
+		}
+	} else {
+		if (ATCA_SUCCESS != atcab_aes_gcm_decrypt_finish(
+					&stream->gcm, tag, tag_length,
+					&verified) ||
+		    true != verified) {
+			LOG(LOG_ERROR, "GCM decrypt authentication failure\n");
+			goto end;
+		}
+	}
+	retval = 0;
+
+end:
+	sdo_free(stream);
+	return retval;
+}
@@ -64,3 +64,20 @@ err:
 	}
 	return ret;
 }
+
+/**
+ * The secure element has no sign setup facility, so there is nothing to
+ * precompute. Signatures are computed entirely in crypto_hal_ecdsa_sign().
+ * @return 0 always.
+ */
+int32_t crypto_hal_ecdsa_sign_precompute(void)
+{
+	return 0;
+}
+
+/**
+ * Nothing is precomputed, so there is nothing to discard.
+ */
+void crypto_hal_ecdsa_sign_precompute_clear(void)
+{
+}
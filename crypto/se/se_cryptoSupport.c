@@ -263,3 +263,110 @@ int32_t crypto_hal_hmac(uint8_t hmac_type, const uint8_t *buffer,
 
 	return 0;
 }
+
+/**
+ * crypto_hal_hash_begin function starts an incremental hash. The SE hashes
+ * in a single command here, so this is not supported.
+ *
+ * @param hash_type - Hash type (SDO_CRYPTO_HASH_TYPE_SHA_256)
+ * @return
+ *        return NULL always.
+ */
+void *crypto_hal_hash_begin(uint8_t hash_type)
+{
+	(void)hash_type;
+
+	LOG(LOG_ERROR, "Incremental hash is not supported on SE\n");
+	return NULL;
+}
+
+/**
+ * crypto_hal_hash_update function adds input data to an incremental hash
+ *
+ * @param ctx - context from crypto_hal_hash_begin.
+ * @param buffer - pointer to input data buffer of uint8_t type.
+ * @param buffer_length - input data buffer size
+ * @return
+ *        return -1 always.
+ */
+int32_t crypto_hal_hash_update(void *ctx, const uint8_t *buffer,
+			       size_t buffer_length)
+{
+	(void)ctx;
+	(void)buffer;
+	(void)buffer_length;
+	return -1;
+}
+
+/**
+ * crypto_hal_hash_end function completes an incremental hash
+ *
+ * @param ctx - context from crypto_hal_hash_begin.
+ * @param output - pointer to output data buffer of uint8_t type.
+ * @param output_length - output data buffer size
+ * @return
+ *        return -1 always.
+ */
+int32_t crypto_hal_hash_end(void *ctx, uint8_t *output, size_t output_length)
+{
+	(void)ctx;
+	(void)output;
+	(void)output_length;
+	return -1;
+}
+
+/**
+ * crypto_hal_hmac_begin function starts an incremental hmac. The SE computes
+ * the hmac in a single command, so this is not supported.
+ *
+ * @param hmac_type - Hmac type (SDO_CRYPTO_HMAC_TYPE_SHA_256)
+ * @param key - pointer to hmac key slot of uint16_t type and less than 15.
+ * @param key_length - hmac key size
+ * @return
+ *        return NULL always.
+ */
+void *crypto_hal_hmac_begin(uint8_t hmac_type, const uint8_t *key,
+			    size_t key_length)
+{
+	(void)hmac_type;
+	(void)key;
+	(void)key_length;
+
+	LOG(LOG_ERROR, "Incremental HMAC is not supported on SE\n");
+	return NULL;
+}
+
+/**
+ * crypto_hal_hmac_update function adds input data to an incremental hmac
+ *
+ * @param ctx - context from crypto_hal_hmac_begin.
+ * @param buffer - pointer to input data buffer of uint8_t type.
+ * @param buffer_length - input data buffer size
+ * @return
+ *        return -1 always.
+ */
+int32_t crypto_hal_hmac_update(void *ctx, const uint8_t *buffer,
+			       size_t buffer_length)
+{
+	(void)ctx;
+	(void)buffer;
+	(void)buffer_length;
+	return -1;
+}
+
+/**
+ * crypto_hal_hmac_end function completes an incremental hmac
+ *
+ * @param ctx - context from crypto_hal_hmac_begin.
+ * @param output - pointer to output data buffer of uint8_t type.
+ * @param output_length - output data buffer size
+ * @return
+ *        return -1 always.
+ */
+int32_t crypto_hal_hmac_end(void *ctx, uint8_t *output, size_t output_length)
+{
+	(void)ctx;
+	(void)output;
+	(void)output_length;
+	return -1;
+}
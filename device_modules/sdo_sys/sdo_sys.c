@@ -5,30 +5,32 @@
 
 
 #include "sdo_sys.h"
-#include "base64.h"
 #include "safe_lib.h"
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include "sdo_sys_utils.h"
 
-int sdo_sys(sdoSdkSiType type, int *count, sdoSdkSiKeyValue *sv)
+/* Compare a key view with a NUL-terminated module message */
+static bool sdo_sys_key_is(const sdoSdkSiView *key, const char *msg)
+{
+	size_t msg_len = strnlen_s(msg, SDO_MAX_STR_SIZE);
+	int result = 1;
+
+	if (key->len != msg_len)
+		return false;
+	if (memcmp_s(key->data, key->len, msg, msg_len, &result) != 0)
+		return false;
+	return result == 0;
+}
+
+int sdo_sys(sdoSdkSiType type, int *count, sdoSdkSiKvView *sv)
 {
-	int ret = 0;
-	static char *mod_data = NULL;
-	static char *mod_msg = NULL;
 	static char fileName[FILE_NAME_LEN];
-	int strcmp_maxver = 1;
-	int strcmp_minver = 1;
-	size_t sv_key_len = 0;
-	size_t sv_value_len = 0;
-	int strcmp_filedesc = 1;
-	int strcmp_write = 1;
-	int strcmp_exec = 1;
-	int result = SDO_SI_INTERNAL_ERROR;
-	uint8_t *binData = NULL;
-	int binLen = 0;
-	int converted = 0;
+	char size[21];
+	unsigned long long file_size;
+	char *end = NULL;
 
 	switch (type) {
 	case SDO_SI_START:
@@ -41,198 +43,110 @@ int sdo_sys(sdoSdkSiType type, int *count, sdoSdkSiKeyValue *sv)
 		return SDO_SI_INTERNAL_ERROR;
 
 	case SDO_SI_SET_PSI:
-		if (!sv || !sv->key || !sv->value)
+		if (!sv || !sv->key.data)
 			return SDO_SI_INTERNAL_ERROR;
 
-		sv_key_len = strnlen_s(sv->key, SDO_MAX_STR_SIZE);
-		sv_value_len = strnlen_s(sv->value, SDO_MAX_STR_SIZE);
-
-		if (sv_key_len == 0 || sv_value_len == 0 ||
-		    sv_key_len == SDO_MAX_STR_SIZE ||
-		    sv_value_len == SDO_MAX_STR_SIZE)
+		if (!sv->key.len || !sv->value.len)
 			return SDO_SI_CONTENT_ERROR;
 
-		strcmp_s(sv->key, sv_key_len, "maxver", &strcmp_maxver);
-		strcmp_s(sv->key, sv_key_len, "minver", &strcmp_minver);
-		if (strcmp_maxver == 0 || strcmp_minver == 0) {
+		if (sdo_sys_key_is(&sv->key, "maxver") ||
+		    sdo_sys_key_is(&sv->key, "minver")) {
 #ifdef DEBUG_LOGS
-			printf("sdo_sys-%s:%s\n", sv->key, sv->value);
+			printf("sdo_sys-%.*s:%.*s\n", (int)sv->key.len,
+			       (char *)sv->key.data, (int)sv->value.len,
+			       (char *)sv->value.data);
 #endif
 			return SDO_SI_SUCCESS;
 		} else
 			return SDO_SI_CONTENT_ERROR;
 
 	case SDO_SI_GET_DSI:
-		if (sv) {
-			if (!count)
-				return SDO_SI_INTERNAL_ERROR;
-			if (*count == 0) {
-				// send active status -> "active":"1"
-				mod_msg = ModuleAlloc(MOD_MAX_MSG_LEN);
-				if (!mod_msg) {
-#ifdef DEBUG_LOGS
-					printf("ModuleAlloc failed!\n");
-#endif
-					goto end_psi;
-				}
+		if (!sv || !count || *count != 0)
+			return SDO_SI_INTERNAL_ERROR;
 
-				ret = strcpy_s(mod_msg, MOD_MAX_MSG_LEN,
-					       MOD_ACTIVE_TAG);
+		// send active status -> "active":"1"
+		sv->key.data = (uint8_t *)MOD_ACTIVE_TAG;
+		sv->key.len = sizeof(MOD_ACTIVE_TAG) - 1;
+		sv->value.data = (uint8_t *)MOD_ACTIVE_STATUS;
+		sv->value.len = sizeof(MOD_ACTIVE_STATUS) - 1;
+		return SDO_SI_SUCCESS;
 
-				if (ret != 0) {
-#ifdef DEBUG_LOGS
-					printf("Strcpy failed!\n");
-#endif
-					goto end_psi;
-				}
+	case SDO_SI_SET_OSI:
+		// the SDK has base64-decoded the value already
+		if (!sv || !sv->key.data || !sv->value.data)
+			return SDO_SI_INTERNAL_ERROR;
 
-				sv->key = mod_msg;
-#ifdef DEBUG_LOGS
-				printf("sv->key:%s\n", sv->key);
-#endif
-				mod_data =
-				    ModuleAlloc(strnlen_s(MOD_ACTIVE_STATUS,
-							  SDO_MAX_STR_SIZE) +
-						1); // +1 for NULL termination
+		if (!sv->value.len)
+			return SDO_SI_CONTENT_ERROR;
 
-				if (!mod_data) {
-#ifdef DEBUG_LOGS
-					printf("ModuleAlloc failed!\n");
-#endif
-					goto end_psi;
-				}
-
-				if (0 != strcpy_s(mod_data,
-						  strnlen_s(MOD_ACTIVE_STATUS,
-							    SDO_MAX_STR_SIZE) +
-						      1,
-						  MOD_ACTIVE_STATUS)) {
+		if (sdo_sys_key_is(&sv->key, "filedesc")) {
+			if (sv->value.len >= FILE_NAME_LEN ||
+			    strncpy_s(fileName, FILE_NAME_LEN,
+				      (char *)sv->value.data,
+				      sv->value.len) != 0) {
 #ifdef DEBUG_LOGS
-					printf("Strcpy failed!\n");
+				printf("Strcpy failed!\n");
 #endif
-					goto end_psi;
-				}
-
-				sv->value = mod_data;
-				result = SDO_SI_SUCCESS;
-				return result;
-
-			end_psi:
-				if (mod_data)
-					ModuleFree(mod_data);
-				if (mod_msg)
-					ModuleFree(mod_msg);
-				return result;
+				return SDO_SI_INTERNAL_ERROR;
 			}
-			return SDO_SI_INTERNAL_ERROR;
-		}
-		return SDO_SI_INTERNAL_ERROR;
 
-	case SDO_SI_SET_OSI:
-		if (sv != NULL && sv->value != NULL && sv->key != NULL) {
-			sv_key_len = strnlen_s(sv->key, SDO_MAX_STR_SIZE);
-			sv_value_len = strnlen_s(sv->value, MOD_MAX_DATA_LEN);
-
-			if (sv_key_len == 0 || sv_value_len == 0 ||
-			    sv_key_len == SDO_MAX_STR_SIZE ||
-			    sv_value_len == MOD_MAX_DATA_LEN)
+			// the previous file, if any, is complete
+			if (!sys_file_finish(NULL, 0) ||
+			    !sys_file_open((const char *)fileName))
+				return SDO_SI_INTERNAL_ERROR;
+			return SDO_SI_SUCCESS;
+		} else if (sdo_sys_key_is(&sv->key, "filesize")) {
+			// optional: size of the file, to preallocate
+			if (sv->value.len >= sizeof(size) ||
+			    memcpy_s(size, sizeof(size), sv->value.data,
+				     sv->value.len) != 0)
 				return SDO_SI_CONTENT_ERROR;
-
-			strcmp_s(sv->key, sv_key_len, "filedesc",
-				 &strcmp_filedesc);
-			strcmp_s(sv->key, sv_key_len, "write", &strcmp_write);
-			strcmp_s(sv->key, sv_key_len, "exec", &strcmp_exec);
-
-			if (strcmp_filedesc != 0 && strcmp_exec != 0 &&
-			    strcmp_write != 0) {
-#ifdef DEBUG_LOGS
-				printf("Mod_Msg content is invalid for sdo_sys "
-				       "Module\n");
-#endif
+			size[sv->value.len] = '\0';
+			file_size = strtoull(size, &end, 10);
+			if (end == size || *end)
 				return SDO_SI_CONTENT_ERROR;
-			}
-
-			binLen = b64To_bin_length(sv_value_len);
-
-			if (!binLen) {
-				goto end;
-			}
-
-			binData = ModuleAlloc(binLen * sizeof(uint8_t));
-			if (!binData) {
+			if (!sys_file_reserve(file_size))
+				return SDO_SI_INTERNAL_ERROR;
+			return SDO_SI_SUCCESS;
+		} else if (sdo_sys_key_is(&sv->key, "write")) {
+			if (!process_data(SDO_SYS_MOD_MSG_WRITE,
+					  sv->value.data,
+					  (uint32_t)sv->value.len, fileName)) {
 #ifdef DEBUG_LOGS
-				printf("ModuleAlloc failed\n");
+				printf("Process_data for write fail");
 #endif
-				goto end;
+				return SDO_SI_INTERNAL_ERROR;
 			}
-
-			if (memset_s(binData, binLen, 0) != 0) {
+			return SDO_SI_SUCCESS;
+		} else if (sdo_sys_key_is(&sv->key, "sha256")) {
+			// optional: SHA-256 of the file, completes it
+			if (!sys_file_finish(sv->value.data, sv->value.len))
+				return SDO_SI_CONTENT_ERROR;
+			return SDO_SI_SUCCESS;
+		} else if (sdo_sys_key_is(&sv->key, "exec")) {
+			if (!sys_file_finish(NULL, 0) ||
+			    !process_data(SDO_SYS_MOD_MSG_EXEC,
+					  sv->value.data,
+					  (uint32_t)sv->value.len, fileName)) {
 #ifdef DEBUG_LOGS
-				printf("Memset failed!\n");
+				printf("Process_data for exec fail");
 #endif
-				goto end;
-			}
-
-			converted =
-			    b64To_bin(sv_value_len, (uint8_t *)sv->value, 0,
-				       (size_t)binLen, binData, 0);
-			if (converted <= 0) {
-				goto end;
+				return SDO_SI_INTERNAL_ERROR;
 			}
-			if (strcmp_filedesc == 0) {
-
-				if (strncpy_s(fileName, FILE_NAME_LEN,
-					      (char *)binData,
-					      converted) != 0) {
-#ifdef DEBUG_LOGS
-					printf("Strcpy failed!\n");
-#endif
-					goto end;
-				}
-
-				if (true ==
-				    delete_old_file((const char *)fileName)) {
-					result = SDO_SI_SUCCESS;
-				}
-
-				goto end;
-			} else if (strcmp_write == 0) {
-
-				if (!process_data(SDO_SYS_MOD_MSG_WRITE,
-						  binData, converted,
-						  fileName)) {
-#ifdef DEBUG_LOGS
-					printf("Process_data for write fail");
-#endif
-					goto end;
-				}
-				result = SDO_SI_SUCCESS;
-				goto end;
-			} else {
-				if (!process_data(SDO_SYS_MOD_MSG_EXEC, binData,
-						  converted, fileName)) {
+			return SDO_SI_SUCCESS;
+		}
 #ifdef DEBUG_LOGS
-					printf("Process_data for exec fail");
+		printf("Mod_Msg content is invalid for sdo_sys Module\n");
 #endif
-					goto end;
-				}
-				result = SDO_SI_SUCCESS;
-				goto end;
-			}
+		return SDO_SI_CONTENT_ERROR;
 
-		end:
-			if (binData)
-				ModuleFree(binData);
-			return result;
-		} else
+	case SDO_SI_END:
+		if (!sys_file_finish(NULL, 0))
 			return SDO_SI_INTERNAL_ERROR;
+		return SDO_SI_SUCCESS;
 
-	case SDO_SI_END:
 	case SDO_SI_FAILURE:
-		if (mod_msg)
-			ModuleFree(mod_msg);
-		if (mod_data)
-			ModuleFree(mod_data);
+		sys_file_abort();
 		return SDO_SI_SUCCESS;
 
 	default:
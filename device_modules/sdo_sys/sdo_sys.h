@@ -21,6 +21,7 @@
 
 #define MOD_MAX_DATA_LEN 1024
 
-int sdo_sys(sdoSdkSiType type, int *count, sdoSdkSiKeyValue *sv);
+/* v2 module, registered with SDO_SI_FLAG_DECODE_B64 */
+int sdo_sys(sdoSdkSiType type, int *count, sdoSdkSiKvView *sv);
 
 #endif /* __SDO_SYS_H__ */
@@ -6,6 +6,7 @@
 #ifndef __SYS_UTILS_H__
 #define __SYS_UTILS_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -29,5 +30,11 @@ void *ModuleAlloc(int size);
 bool process_data(sdoSysModMsg type, uint8_t *data, uint32_t dataLen,
 		  char *File_name);
 
-bool delete_old_file(const char *File_name);
+
+/* Streaming writes of the file named by filedesc */
+bool sys_file_open(const char *file_name);
+bool sys_file_reserve(uint64_t size);
+bool sys_file_write(const uint8_t *data, size_t len);
+bool sys_file_finish(const uint8_t *sha256, size_t sha256_len);
+void sys_file_abort(void);
 #endif /* __SYS_UTILS_H__ */
@@ -6,6 +6,9 @@
 #ifndef __SDOMODULES_H__
 #define __SDOMODULES_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
 /*
  * SDO module specific #defs (SvInfo)
  */
@@ -41,10 +44,30 @@ typedef struct sdoSdkSiKeyValue {
 typedef int (*sdoSdkServiceInfoCB)(sdoSdkSiType type, int *count,
                                    sdoSdkSiKeyValue *si);
 
+// length-delimited key or value, not NUL-terminated
+typedef struct sdoSdkSiView {
+  uint8_t *data;
+  size_t len;
+} sdoSdkSiView;
+
+typedef struct sdoSdkSiKvView {
+  sdoSdkSiView key;
+  sdoSdkSiView value;
+} sdoSdkSiKvView;
+
+// v2 callback to module
+typedef int (*sdoSdkServiceInfoV2CB)(sdoSdkSiType type, int *count,
+                                     sdoSdkSiKvView *si);
+
+// OSI values are base64-decoded in place before SDO_SI_SET_OSI
+#define SDO_SI_FLAG_DECODE_B64 0x1
+
 /* module struct for modules */
 typedef struct {
   char moduleName[SDO_MODULE_NAME_LEN];
   sdoSdkServiceInfoCB serviceInfoCallback;
+  sdoSdkServiceInfoV2CB serviceInfoV2Callback;
+  uint32_t flags;
 } sdoSdkServiceInfoModule;
 
 #endif /* __SDOTYPES_H__ */
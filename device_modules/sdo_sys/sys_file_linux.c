@@ -0,0 +1,272 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief sdo_sys file writes.
+ *
+ * The file named by filedesc stays open until it is complete. Chunks from
+ * write messages are buffered and hashed as they come; the file and its
+ * directory are synced once, when it is finished, and its SHA-256 can then
+ * be checked.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "safe_lib.h"
+#include "sdoCryptoHal.h"
+#include "sdo_sys_utils.h"
+
+#define SYS_FILE_BUF_SIZE (64 * 1024)
+
+static struct {
+	int fd;
+	char *name;
+	uint8_t *buf;
+	size_t buf_len;
+	uint64_t written;
+	uint64_t reserved;
+	void *sha;
+} sys_file = {-1, NULL, NULL, 0, 0, 0, NULL};
+
+/* Write len bytes at data to the file, retrying short writes */
+static bool sys_file_put(const uint8_t *data, size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		n = write(sys_file.fd, data, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+#ifdef DEBUG_LOGS
+			printf("sdo_sys: write failed, errno %d\n", errno);
+#endif
+			return false;
+		}
+		data += n;
+		len -= (size_t)n;
+		sys_file.written += (uint64_t)n;
+	}
+	return true;
+}
+
+static bool sys_file_flush(void)
+{
+	bool ret = sys_file_put(sys_file.buf, sys_file.buf_len);
+
+	sys_file.buf_len = 0;
+	return ret;
+}
+
+/* Release what the open file holds, without syncing it */
+static void sys_file_release(void)
+{
+	if (sys_file.fd >= 0)
+		(void)close(sys_file.fd);
+	if (sys_file.sha)
+		(void)crypto_hal_hash_end(sys_file.sha, NULL, 0);
+	if (sys_file.buf)
+		ModuleFree(sys_file.buf);
+	if (sys_file.name)
+		ModuleFree(sys_file.name);
+	sys_file.fd = -1;
+	sys_file.sha = NULL;
+	sys_file.buf_len = 0;
+	sys_file.written = 0;
+	sys_file.reserved = 0;
+}
+
+/* Sync the directory holding file_name, so that its entry is durable */
+static bool sys_file_sync_dir(const char *file_name)
+{
+	char dir[PATH_MAX];
+	const char *slash = strrchr(file_name, '/');
+	size_t len = slash ? (size_t)(slash - file_name) : 0;
+	bool ret;
+	int fd;
+
+	if (!slash)
+		dir[len++] = '.';
+	else if (!len)
+		dir[len++] = '/';
+	else if (memcpy_s(dir, sizeof(dir), file_name, len) != 0)
+		return false;
+	dir[len] = '\0';
+
+	fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	ret = fsync(fd) == 0;
+	if (close(fd) != 0)
+		ret = false;
+#ifdef DEBUG_LOGS
+	if (!ret)
+		printf("sdo_sys: could not sync directory %s\n", dir);
+#endif
+	return ret;
+}
+
+/**
+ * Create or truncate file_name and keep it open for sys_file_write().
+ * A file still open is abandoned.
+ */
+bool sys_file_open(const char *file_name)
+{
+	size_t name_len;
+
+	sys_file_release();
+	if (!file_name)
+		return false;
+
+	name_len = strnlen_s(file_name, PATH_MAX);
+	if (!name_len || name_len == PATH_MAX)
+		return false;
+
+	sys_file.name = ModuleAlloc(name_len + 1);
+	sys_file.buf = ModuleAlloc(SYS_FILE_BUF_SIZE);
+	if (!sys_file.name || !sys_file.buf ||
+	    strcpy_s(sys_file.name, name_len + 1, file_name) != 0)
+		goto err;
+
+	sys_file.fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			   0666);
+	if (sys_file.fd < 0) {
+#ifdef DEBUG_LOGS
+		printf("Could not open file(path): %s\n", file_name);
+#endif
+		goto err;
+	}
+
+	/* Without an incremental hash, the file cannot be verified */
+	sys_file.sha = crypto_hal_hash_begin(SDO_CRYPTO_HASH_TYPE_SHA_256);
+	return true;
+
+err:
+	sys_file_release();
+	return false;
+}
+
+/**
+ * Preallocate size bytes for the open file, as announced by the owner.
+ * Filesystems that cannot preallocate are not an error.
+ */
+bool sys_file_reserve(uint64_t size)
+{
+	int err;
+
+	if (sys_file.fd < 0 || size > (uint64_t)INT64_MAX)
+		return false;
+
+	err = posix_fallocate(sys_file.fd, 0, (off_t)size);
+	if (err != 0 && err != EINVAL && err != EOPNOTSUPP) {
+#ifdef DEBUG_LOGS
+		printf("sdo_sys: cannot reserve %llu bytes, errno %d\n",
+		       (unsigned long long)size, err);
+#endif
+		return false;
+	}
+	if (err == 0)
+		sys_file.reserved = size;
+	return true;
+}
+
+/**
+ * Append len bytes to the open file.
+ */
+bool sys_file_write(const uint8_t *data, size_t len)
+{
+	if (sys_file.fd < 0 || !data)
+		return false;
+
+	if (sys_file.sha &&
+	    crypto_hal_hash_update(sys_file.sha, data, len) != 0) {
+		(void)crypto_hal_hash_end(sys_file.sha, NULL, 0);
+		sys_file.sha = NULL;
+	}
+
+	if (sys_file.buf_len + len > SYS_FILE_BUF_SIZE && !sys_file_flush())
+		return false;
+
+	/* Chunks as large as the buffer bypass it */
+	if (len >= SYS_FILE_BUF_SIZE)
+		return sys_file_put(data, len);
+
+	if (memcpy_s(sys_file.buf + sys_file.buf_len,
+		     SYS_FILE_BUF_SIZE - sys_file.buf_len, data, len) != 0)
+		return false;
+	sys_file.buf_len += len;
+	return true;
+}
+
+/**
+ * Complete the open file: write what is buffered, give back preallocated
+ * space that was not used, sync the file, close it and sync its directory.
+ * If sha256 is not NULL, the file must have this SHA-256, or it is removed.
+ *
+ * @return true if no file was open, or if it is complete and verified.
+ */
+bool sys_file_finish(const uint8_t *sha256, size_t sha256_len)
+{
+	uint8_t digest[SHA256_DIGEST_SIZE];
+	bool ret = false;
+	int result = 1;
+
+	if (sys_file.fd < 0)
+		return sha256 == NULL;
+
+	if (!sys_file_flush())
+		goto end;
+	if (sys_file.reserved > sys_file.written &&
+	    ftruncate(sys_file.fd, (off_t)sys_file.written) != 0)
+		goto end;
+	if (fsync(sys_file.fd) != 0)
+		goto end;
+
+	if (!sha256) {
+		ret = true;
+		goto end;
+	}
+
+	if (sys_file.sha && sha256_len == sizeof(digest)) {
+		ret = crypto_hal_hash_end(sys_file.sha, digest,
+					  sizeof(digest)) == 0 &&
+		      memcmp_s(digest, sizeof(digest), sha256, sha256_len,
+			       &result) == 0 &&
+		      result == 0;
+		sys_file.sha = NULL;
+	}
+	if (!ret) {
+#ifdef DEBUG_LOGS
+		printf("sdo_sys: SHA-256 of %s does not match\n",
+		       sys_file.name);
+#endif
+		(void)unlink(sys_file.name);
+	}
+
+end:
+	if (ret) {
+		/* A new file can still vanish until its directory is synced */
+		ret = close(sys_file.fd) == 0;
+		sys_file.fd = -1;
+		if (ret)
+			ret = sys_file_sync_dir(sys_file.name);
+	}
+	sys_file_release();
+	return ret;
+}
+
+/**
+ * Abandon the open file, as it is, without syncing it.
+ */
+void sys_file_abort(void)
+{
+	sys_file_release();
+}
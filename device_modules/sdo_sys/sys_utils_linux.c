@@ -93,7 +93,6 @@ bool process_data(sdoSysModMsg type, uint8_t *data, uint32_t dataLen,
 		  char *File_name)
 {
 	int ret = false;
-	FILE *fp = NULL;
 	int error_code = 0;
 	char *new_filename = NULL;
 	int new_filename_sz = 0;
@@ -108,25 +107,9 @@ bool process_data(sdoSysModMsg type, uint8_t *data, uint32_t dataLen,
 	printf("sdo_sys: Filename : %s :Size: %x\n", File_name, dataLen);
 #endif
 
-	// For writing to a file
+	// For writing to a file, through the open file of filedesc
 	if (type == SDO_SYS_MOD_MSG_WRITE) {
-
-		fp = fopen(File_name, "a");
-		if (!fp) {
-#ifdef DEBUG_LOGS
-			printf("Could not open file(path): %s\n", File_name);
-#endif
-			goto end;
-		}
-
-		if (fwrite(data, sizeof(char), dataLen, fp) !=
-		    (size_t)dataLen) {
-#ifdef DEBUG_LOGS
-			printf("Error in fwrite");
-#endif
-			goto end;
-		}
-		ret = true;
+		ret = sys_file_write(data, dataLen);
 		goto end;
 	}
 
@@ -171,31 +154,8 @@ bool process_data(sdoSysModMsg type, uint8_t *data, uint32_t dataLen,
 	}
 
 end:
-	if (fp) {
-		if (fclose(fp) == EOF) {
-#ifdef DEBUG_LOGS
-			printf("Fclose failed\n");
-#endif
-		}
-	}
 	if (new_filename) {
 		free(new_filename);
 	}
 	return ret;
 }
-
-bool delete_old_file(const char *File_name)
-{
-	FILE *file = NULL;
-	bool ret = false;
-
-	file = fopen(File_name, "w");
-	if (file) {
-		if (!fclose(file)) {
-			ret = true;
-		}
-	} else {
-		ret = true;
-	}
-	return ret;
-}
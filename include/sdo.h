@@ -30,7 +30,8 @@ typedef enum {
 	SDO_RESALE_NOT_READY,
 	SDO_WARNING,
 	SDO_ERROR,
-	SDO_ABORT
+	SDO_ABORT,
+	SDO_IN_PROGRESS
 } sdo_sdk_status;
 
 typedef enum {
@@ -43,6 +44,22 @@ typedef enum {
 
 sdo_sdk_status sdo_sdk_run(void);
 
+// step-driven sdo_sdk_run(), for applications with an event loop
+#define SDO_WAIT_READ 0x1
+#define SDO_WAIT_WRITE 0x2
+
+typedef struct {
+	int fd;		    /* descriptor to watch, -1 if none */
+	uint32_t events;    /* SDO_WAIT_READ/SDO_WAIT_WRITE awaited on fd */
+	int32_t timeout_ms; /* step again after this long, -1 = when fd is ready */
+} sdo_sdk_wait;
+
+sdo_sdk_status sdo_sdk_start(void);
+
+sdo_sdk_status sdo_sdk_step(sdo_sdk_wait *wait);
+
+sdo_sdk_status sdo_sdk_cancel(void);
+
 sdo_sdk_status sdo_sdk_resale(void);
 
 sdo_sdk_device_state sdo_sdk_get_status(void);
@@ -54,7 +71,158 @@ sdo_sdk_status sdo_sdk_init(sdo_sdk_errorCB error_handling_callback,
 			    uint32_t num_modules,
 			    sdo_sdk_service_info_module *module_information);
 
+// retry phases for which a backoff policy can be configured
+typedef enum {
+	SDO_RETRY_CONNECT,
+	SDO_RETRY_NETIO,
+	SDO_RETRY_DI,
+	SDO_RETRY_TO1,
+	SDO_RETRY_TO2,
+	SDO_RETRY_PHASE_MAX
+} sdo_sdk_retry_phase;
+
+typedef struct {
+	uint32_t base_ms;      /* smallest delay between attempts */
+	uint32_t cap_ms;       /* largest delay between attempts */
+	uint32_t max_attempts; /* retries before giving up, 0 = unlimited */
+} sdo_sdk_retry_policy;
+
+// callback for retry telemetry, return SDO_ABORT to stop retrying
+typedef int (*sdo_sdk_retryCB)(sdo_sdk_retry_phase phase, uint32_t attempt,
+			       uint32_t delay_ms, uint32_t elapsed_ms);
+
+sdo_sdk_status sdo_sdk_set_retry_policy(sdo_sdk_retry_phase phase,
+					const sdo_sdk_retry_policy *policy);
+
+sdo_sdk_status sdo_sdk_set_retry_budget(uint32_t total_budget_ms);
+
+sdo_sdk_status sdo_sdk_register_retry_cb(sdo_sdk_retryCB retry_callback);
+
+// trace events, reported when the SDK is built with TRACE=true
+typedef enum {
+	SDO_TRACE_MSG,	   /* protocol message handler, msgNN() */
+	SDO_TRACE_NET,	   /* connect, send, receive, retry delay */
+	SDO_TRACE_CRYPTO,  /* signature, key exchange, AES, HMAC, hash */
+	SDO_TRACE_STORAGE, /* blob read or write */
+	SDO_TRACE_CAT_MAX
+} sdo_sdk_trace_cat;
+
+typedef struct {
+	const char *name;      /* what runs, a string that is never freed */
+	int32_t msg_type;      /* message it belongs to, 0 if not known */
+	sdo_sdk_trace_cat cat; /* layer it runs in */
+	char phase;	       /* 'B' as it begins, 'E' as it ends */
+	uint32_t tid;	       /* SDK-assigned number of the calling thread */
+	uint64_t ts_us;	       /* monotonic time stamp, in microseconds */
+} sdo_sdk_trace_event;
+
+// callback for trace events, called on the thread that runs the SDK
+typedef void (*sdo_sdk_traceCB)(const sdo_sdk_trace_event *event);
+
+sdo_sdk_status sdo_sdk_register_trace_cb(sdo_sdk_traceCB trace_callback);
+
+sdo_sdk_status sdo_sdk_trace_to_file(const char *path);
+
+// statistics of the process, see sdo_sdk_get_stats()
+typedef enum {
+	SDO_STATS_DI,
+	SDO_STATS_TO1,
+	SDO_STATS_TO2,
+	SDO_STATS_PHASE_MAX
+} sdo_sdk_stats_phase;
+
+typedef enum {
+	SDO_STATS_SIGN,	      /* device signature */
+	SDO_STATS_VERIFY,     /* signature verification */
+	SDO_STATS_KEX,	      /* key exchange: key share and key derivation */
+	SDO_STATS_ENCRYPT,    /* AES encryption of a message */
+	SDO_STATS_DECRYPT,    /* AES decryption of a message */
+	SDO_STATS_HMAC,	      /* message and ownership voucher HMAC */
+	SDO_STATS_HASH,
+	SDO_STATS_CRYPTO_MAX
+} sdo_sdk_stats_crypto;
+
+/* Message types 0..SDO_STATS_MSG_MAX - 1 have a latency histogram */
+#define SDO_STATS_MSG_MAX 52
+/* 4 buckets per power of two, from 1 us up to 2^32 us (71 minutes) */
+#define SDO_STATS_HIST_BUCKETS 124
+
+typedef struct {
+	uint32_t count;
+	uint64_t sum_us;
+	uint32_t bucket[SDO_STATS_HIST_BUCKETS]; /* see sdo_sdk_stats_bucket */
+} sdo_sdk_latency_hist;
+
+typedef struct {
+	uint64_t round_trips[SDO_STATS_PHASE_MAX];
+	uint64_t bytes_sent;	 /* REST headers and bodies */
+	uint64_t bytes_received; /* REST headers and bodies */
+	uint64_t connections;	 /* connections opened */
+	uint64_t connect_failures;
+	uint64_t dns_lookups;
+	uint64_t retries[SDO_RETRY_PHASE_MAX]; /* by what was retried */
+	uint64_t crypto_ops[SDO_STATS_CRYPTO_MAX];
+	/* connect to response, by the message type of the request */
+	sdo_sdk_latency_hist msg_latency[SDO_STATS_MSG_MAX];
+} sdo_sdk_stats;
+
+sdo_sdk_status sdo_sdk_get_stats(sdo_sdk_stats *stats);
+
+void sdo_sdk_reset_stats(void);
+
+uint64_t sdo_sdk_stats_bucket(uint32_t bucket);
+
+uint64_t sdo_sdk_stats_percentile(const sdo_sdk_latency_hist *hist,
+				  uint32_t percent);
+
+// last log records of each thread, with an SDK built with LOG_RING=true
+sdo_sdk_status sdo_sdk_log_dump(const char *path);
+
+// heap use of the SDK, tracked when it is built with HEAP_TRACK=true
+/* Size class n counts allocations of up to 16 << n bytes, the last larger */
+#define SDO_HEAP_SIZE_CLASSES 16
+/* Index of the heap phase outside DI, TO1 and TO2 */
+#define SDO_HEAP_PHASE_NONE SDO_STATS_PHASE_MAX
+
+typedef struct {
+	uint64_t allocs;      /* allocations made */
+	uint64_t alloc_bytes; /* bytes they asked for */
+	uint64_t live_bytes;  /* bytes of them not freed yet */
+	uint64_t peak_bytes;  /* most bytes live in the SDK at once meanwhile */
+} sdo_sdk_heap_use;
+
+typedef struct {
+	sdo_sdk_heap_use total;
+	uint64_t live_allocs;
+	uint64_t frees;
+	uint64_t over_budget; /* allocations refused by the budget */
+	uint64_t size_class[SDO_HEAP_SIZE_CLASSES];
+	/* by the message running on the thread, see sdo_sdk_get_heap_stats */
+	sdo_sdk_heap_use phase[SDO_HEAP_PHASE_NONE + 1];
+	sdo_sdk_heap_use msg[SDO_STATS_MSG_MAX];
+	/* made since the last sdo_sdk_init() and live after sdo_sdk_deinit() */
+	uint64_t leaked_allocs;
+	uint64_t leaked_bytes;
+} sdo_sdk_heap_stats;
+
+sdo_sdk_status sdo_sdk_get_heap_stats(sdo_sdk_heap_stats *stats);
+
+void sdo_sdk_reset_heap_peaks(void);
+
+sdo_sdk_status sdo_sdk_set_heap_budget(uint64_t budget_bytes);
+
 void sdo_sdk_deinit(void);
 int sdo_de_init(void);
 
+// independent SDK instance, so that threads can onboard in parallel
+typedef struct sdo_sdk_ctx sdo_sdk_ctx;
+
+sdo_sdk_ctx *sdo_sdk_ctx_new(void);
+
+void sdo_sdk_ctx_free(sdo_sdk_ctx *ctx);
+
+sdo_sdk_status sdo_sdk_ctx_use(sdo_sdk_ctx *ctx);
+
+sdo_sdk_status sdo_sdk_ctx_set_blob_dir(sdo_sdk_ctx *ctx, const char *dir);
+
 #endif /* __MP_H__ */
@@ -6,6 +6,9 @@
 #ifndef __SDOMODULES_H__
 #define __SDOMODULES_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
 /*
  * SDO module specific #defs (Sv_info)
  */
@@ -19,6 +22,9 @@
 #define SDO_MAX_MODULES 1
 #endif
 
+// Modules sdo_sdk_init() accepts; SDO_MAX_MODULES is what the app registers
+#define SDO_SDK_MAX_MODULES 64
+
 /*==================================================================*/
 /* Service Info module registration functionality */
 
@@ -45,17 +51,54 @@ typedef struct sdo_sdk_si_key_value {
 typedef int (*sdo_sdk_service_infoCB)(sdo_sdk_si_type type, int *count,
 				      sdo_sdk_si_key_value *si);
 
-/* module struct for modules */
+/*
+ * Length-delimited key or value, not NUL-terminated. For SDO_SI_SET_PSI and
+ * SDO_SI_SET_OSI it points into the message being processed and is only
+ * valid for the duration of the callback. For SDO_SI_GET_DSI the module
+ * points it at text of its own, which must stay valid until the next
+ * callback.
+ */
+typedef struct sdo_sdk_si_view {
+	uint8_t *data;
+	size_t len;
+} sdo_sdk_si_view;
+
+typedef struct sdo_sdk_si_kv_view {
+	sdo_sdk_si_view key;
+	sdo_sdk_si_view value;
+} sdo_sdk_si_kv_view;
+
+// v2 callback to module: keys and values are (pointer, length) views
+typedef int (*sdo_sdk_service_info_v2CB)(sdo_sdk_si_type type, int *count,
+					 sdo_sdk_si_kv_view *si);
+
+/* v2 module flags */
+// OSI values are base64-decoded in place before SDO_SI_SET_OSI
+#define SDO_SI_FLAG_DECODE_B64 0x1
+// SDO_SI_SET_OSI runs on a worker thread, overlapping the next round trip
+#define SDO_SI_FLAG_ASYNC_OSI 0x2
+// SDO_SI_GET_DSI runs ahead on a producer thread, while msg46 is in flight
+#define SDO_SI_FLAG_PREFETCH_DSI 0x4
+
+/*
+ * module struct for modules
+ * A module sets either service_info_callback (NUL-terminated strings, PSI
+ * values of at most SDO_MODULE_VALUE_LEN) or service_info_callback_v2
+ * (views, no value limit besides the message size). flags only apply to
+ * v2 modules.
+ */
 typedef struct {
 	char module_name[SDO_MODULE_NAME_LEN];
 	sdo_sdk_service_infoCB service_info_callback;
+	sdo_sdk_service_info_v2CB service_info_callback_v2;
+	uint32_t flags;
 } sdo_sdk_service_info_module;
 
 // Modules CB
 extern int devconfig(sdo_sdk_si_type type, int *count,
 		     sdo_sdk_si_key_value *si);
 extern int keypair(sdo_sdk_si_type type, int *count, sdo_sdk_si_key_value *si);
-extern int sdo_sys(sdo_sdk_si_type type, int *count, sdo_sdk_si_key_value *si);
+extern int sdo_sys(sdo_sdk_si_type type, int *count, sdo_sdk_si_kv_view *si);
 extern int pelionconfig(sdo_sdk_si_type type, int *count,
 			sdo_sdk_si_key_value *si);
 
@@ -0,0 +1,575 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Binary snapshot of the Normal device credentials.
+ *
+ * Decoding the Normal.blob JSON walks the rendezvous list through the sdor
+ * reader and allocates every field one tag at a time. The snapshot holds the
+ * same sdo_dev_cred_t state in a fixed, length-prefixed layout that decodes
+ * in a single pass. It is sealed like the Normal blob (SDO_SDK_NORMAL_DATA)
+ * and carries the storage HMAC the Normal blob was sealed with. Loading
+ * compares that tag with the first PLATFORM_HMAC_SIZE bytes of Normal.blob,
+ * so the blob itself is neither read in full nor authenticated again: the
+ * snapshot's own seal vouches for the state, the tag ties it to the blob.
+ * A snapshot left behind by a different Normal.blob, or by another layout
+ * version, is never used: the caller falls back to the JSON parser.
+ *
+ * Layout (integers are big endian):
+ *   magic(4) || version(2) || tag_len(2) || tag ||
+ *   ST(1) [ || pv(4) || pe(4) || guid || pkh || rvlst ]
+ * where guid is len(2) || bytes, pkh is type(2) || len(2) || bytes and rvlst
+ * is num_entries(2) followed by, per entry, num_params(4) || fields(2) and
+ * each field present in the fields bitmap, in sdo_rendezvous_write() order.
+ */
+
+#include "cred_snapshot.h"
+#include "load_credentials.h"
+#include "sdoCrypto.h"
+#include "storage_al.h"
+#include "safe_lib.h"
+#include "util.h"
+
+#define CRED_SNAPSHOT_MAGIC 0x53444f53 /* "SDOS" */
+
+/* Rendezvous fields present in an entry */
+#define SNAP_RV_ONLY (1 << 0)
+#define SNAP_RV_IP (1 << 1)
+#define SNAP_RV_PO (1 << 2)
+#define SNAP_RV_POW (1 << 3)
+#define SNAP_RV_DN (1 << 4)
+#define SNAP_RV_SCH (1 << 5)
+#define SNAP_RV_CCH (1 << 6)
+#define SNAP_RV_UI (1 << 7)
+#define SNAP_RV_SS (1 << 8)
+#define SNAP_RV_PW (1 << 9)
+#define SNAP_RV_WSP (1 << 10)
+#define SNAP_RV_ME (1 << 11)
+#define SNAP_RV_PR (1 << 12)
+#define SNAP_RV_DELAYSEC (1 << 13)
+
+/* Encoder; with buf == NULL it only measures */
+typedef struct {
+	uint8_t *buf;
+	size_t len;
+	size_t max;
+	bool ok;
+} snap_w_t;
+
+/* Decoder */
+typedef struct {
+	const uint8_t *buf;
+	size_t len;
+	size_t pos;
+	bool ok;
+} snap_r_t;
+
+static void put_bytes(snap_w_t *w, const void *p, size_t n)
+{
+	if (w->buf && n) {
+		if (w->len + n > w->max ||
+		    memcpy_s(w->buf + w->len, w->max - w->len, p, n) != 0) {
+			w->ok = false;
+			return;
+		}
+	}
+	w->len += n;
+}
+
+static void put_u8(snap_w_t *w, uint8_t v)
+{
+	put_bytes(w, &v, 1);
+}
+
+static void put_u16(snap_w_t *w, uint16_t v)
+{
+	uint8_t b[2] = {(uint8_t)(v >> 8), (uint8_t)v};
+
+	put_bytes(w, b, sizeof(b));
+}
+
+static void put_u32(snap_w_t *w, uint32_t v)
+{
+	uint8_t b[4] = {(uint8_t)(v >> 24), (uint8_t)(v >> 16),
+			(uint8_t)(v >> 8), (uint8_t)v};
+
+	put_bytes(w, b, sizeof(b));
+}
+
+static void put_blob(snap_w_t *w, const void *p, size_t n)
+{
+	if (n > UINT16_MAX) {
+		w->ok = false;
+		return;
+	}
+	put_u16(w, (uint16_t)n);
+	put_bytes(w, p, n);
+}
+
+static void put_string(snap_w_t *w, const sdo_string_t *s)
+{
+	put_blob(w, s->bytes, s->bytes ? (size_t)s->byte_sz : 0);
+}
+
+static void put_hash(snap_w_t *w, const sdo_hash_t *h)
+{
+	put_u16(w, (uint16_t)h->hash_type);
+	if (h->hash)
+		put_blob(w, h->hash->bytes, h->hash->byte_sz);
+	else
+		put_blob(w, NULL, 0);
+}
+
+static void put_rendezvous(snap_w_t *w, const sdo_rendezvous_t *rv)
+{
+	uint16_t fields = 0;
+
+	fields |= rv->only ? SNAP_RV_ONLY : 0;
+	fields |= rv->ip ? SNAP_RV_IP : 0;
+	fields |= rv->po ? SNAP_RV_PO : 0;
+	fields |= rv->pow ? SNAP_RV_POW : 0;
+	fields |= rv->dn ? SNAP_RV_DN : 0;
+	fields |= rv->sch ? SNAP_RV_SCH : 0;
+	fields |= rv->cch ? SNAP_RV_CCH : 0;
+	fields |= rv->ui ? SNAP_RV_UI : 0;
+	fields |= rv->ss ? SNAP_RV_SS : 0;
+	fields |= rv->pw ? SNAP_RV_PW : 0;
+	fields |= rv->wsp ? SNAP_RV_WSP : 0;
+	fields |= rv->me ? SNAP_RV_ME : 0;
+	fields |= rv->pr ? SNAP_RV_PR : 0;
+	fields |= rv->delaysec ? SNAP_RV_DELAYSEC : 0;
+
+	put_u32(w, (uint32_t)rv->num_params);
+	put_u16(w, fields);
+
+	if (rv->only)
+		put_string(w, rv->only);
+	if (rv->ip) {
+		put_u8(w, rv->ip->length);
+		put_bytes(w, rv->ip->addr, sizeof(rv->ip->addr));
+	}
+	if (rv->po)
+		put_u32(w, *rv->po);
+	if (rv->pow)
+		put_u32(w, *rv->pow);
+	if (rv->dn)
+		put_string(w, rv->dn);
+	if (rv->sch)
+		put_hash(w, rv->sch);
+	if (rv->cch)
+		put_hash(w, rv->cch);
+	if (rv->ui)
+		put_u32(w, *rv->ui);
+	if (rv->ss)
+		put_string(w, rv->ss);
+	if (rv->pw)
+		put_string(w, rv->pw);
+	if (rv->wsp)
+		put_string(w, rv->wsp);
+	if (rv->me)
+		put_string(w, rv->me);
+	if (rv->pr)
+		put_string(w, rv->pr);
+	if (rv->delaysec)
+		put_u32(w, *rv->delaysec);
+}
+
+static void encode(snap_w_t *w, const uint8_t *tag, sdo_dev_cred_t *ocred)
+{
+	sdo_cred_owner_t *owner = ocred->owner_blk;
+	sdo_rendezvous_t *rv;
+	uint16_t i;
+
+	put_u32(w, CRED_SNAPSHOT_MAGIC);
+	put_u16(w, CRED_SNAPSHOT_VERSION);
+	put_u16(w, PLATFORM_HMAC_SIZE);
+	put_bytes(w, tag, PLATFORM_HMAC_SIZE);
+	put_u8(w, ocred->ST);
+
+	if (ocred->ST < SDO_DEVICE_STATE_READY1)
+		return;
+
+	if (!owner || !owner->guid || !owner->pkh || !owner->rvlst) {
+		w->ok = false;
+		return;
+	}
+
+	put_u32(w, (uint32_t)owner->pv);
+	put_u32(w, (uint32_t)owner->pe);
+	put_blob(w, owner->guid->bytes, owner->guid->byte_sz);
+	put_hash(w, owner->pkh);
+
+	put_u16(w, owner->rvlst->num_entries);
+	rv = owner->rvlst->rv_entries;
+	for (i = 0; i < owner->rvlst->num_entries && rv; i++, rv = rv->next)
+		put_rendezvous(w, rv);
+	if (i != owner->rvlst->num_entries)
+		w->ok = false;
+}
+
+static const uint8_t *get_bytes(snap_r_t *r, size_t n)
+{
+	const uint8_t *p;
+
+	if (!r->ok || n > r->len - r->pos) {
+		r->ok = false;
+		return NULL;
+	}
+	p = r->buf + r->pos;
+	r->pos += n;
+	return p;
+}
+
+static uint8_t get_u8(snap_r_t *r)
+{
+	const uint8_t *p = get_bytes(r, 1);
+
+	return p ? p[0] : 0;
+}
+
+static uint16_t get_u16(snap_r_t *r)
+{
+	const uint8_t *p = get_bytes(r, 2);
+
+	return p ? (uint16_t)((p[0] << 8) | p[1]) : 0;
+}
+
+static uint32_t get_u32(snap_r_t *r)
+{
+	const uint8_t *p = get_bytes(r, 4);
+
+	if (!p)
+		return 0;
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+	       ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t *get_u32_alloc(snap_r_t *r)
+{
+	uint32_t *v = sdo_alloc(sizeof(uint32_t));
+
+	if (!v) {
+		r->ok = false;
+		return NULL;
+	}
+	*v = get_u32(r);
+	return v;
+}
+
+static sdo_string_t *get_string(snap_r_t *r)
+{
+	uint16_t n = get_u16(r);
+	const uint8_t *p = get_bytes(r, n);
+	sdo_string_t *s;
+
+	if (!p)
+		return NULL;
+
+	s = sdo_string_alloc();
+	if (!s)
+		goto err;
+	if (n) {
+		s->bytes = sdo_alloc(n);
+		if (!s->bytes || memcpy_s(s->bytes, n, p, n) != 0)
+			goto err;
+	}
+	s->byte_sz = n;
+	return s;
+
+err:
+	sdo_string_free(s);
+	r->ok = false;
+	return NULL;
+}
+
+static sdo_byte_array_t *get_byte_array(snap_r_t *r)
+{
+	uint16_t n = get_u16(r);
+	const uint8_t *p = get_bytes(r, n);
+	sdo_byte_array_t *ba;
+
+	if (!p)
+		return NULL;
+
+	ba = sdo_byte_array_alloc(n);
+	if (!ba || (n && memcpy_s(ba->bytes, ba->byte_sz, p, n) != 0)) {
+		sdo_byte_array_free(ba);
+		r->ok = false;
+		return NULL;
+	}
+	return ba;
+}
+
+static sdo_hash_t *get_hash(snap_r_t *r)
+{
+	int hash_type = get_u16(r);
+	sdo_hash_t *h;
+
+	if (!r->ok)
+		return NULL;
+
+	h = sdo_hash_alloc_empty();
+	if (!h) {
+		r->ok = false;
+		return NULL;
+	}
+	h->hash_type = hash_type;
+	h->hash = get_byte_array(r);
+	if (!h->hash) {
+		sdo_hash_free(h);
+		return NULL;
+	}
+	return h;
+}
+
+static sdo_ip_address_t *get_ip(snap_r_t *r)
+{
+	sdo_ip_address_t *ip = sdo_ipaddress_alloc();
+	const uint8_t *p;
+
+	if (!ip) {
+		r->ok = false;
+		return NULL;
+	}
+
+	ip->length = get_u8(r);
+	p = get_bytes(r, sizeof(ip->addr));
+	if (!p ||
+	    memcpy_s(ip->addr, sizeof(ip->addr), p, sizeof(ip->addr)) != 0) {
+		sdo_free(ip);
+		r->ok = false;
+		return NULL;
+	}
+	return ip;
+}
+
+static sdo_rendezvous_t *get_rendezvous(snap_r_t *r)
+{
+	sdo_rendezvous_t *rv = sdo_rendezvous_alloc();
+	uint16_t fields;
+
+	if (!rv) {
+		r->ok = false;
+		return NULL;
+	}
+
+	rv->num_params = (int)get_u32(r);
+	fields = get_u16(r);
+
+	if (fields & SNAP_RV_ONLY)
+		rv->only = get_string(r);
+	if (fields & SNAP_RV_IP)
+		rv->ip = get_ip(r);
+	if (fields & SNAP_RV_PO)
+		rv->po = get_u32_alloc(r);
+	if (fields & SNAP_RV_POW)
+		rv->pow = get_u32_alloc(r);
+	if (fields & SNAP_RV_DN)
+		rv->dn = get_string(r);
+	if (fields & SNAP_RV_SCH)
+		rv->sch = get_hash(r);
+	if (fields & SNAP_RV_CCH)
+		rv->cch = get_hash(r);
+	if (fields & SNAP_RV_UI)
+		rv->ui = get_u32_alloc(r);
+	if (fields & SNAP_RV_SS)
+		rv->ss = get_string(r);
+	if (fields & SNAP_RV_PW)
+		rv->pw = get_string(r);
+	if (fields & SNAP_RV_WSP)
+		rv->wsp = get_string(r);
+	if (fields & SNAP_RV_ME)
+		rv->me = get_string(r);
+	if (fields & SNAP_RV_PR)
+		rv->pr = get_string(r);
+	if (fields & SNAP_RV_DELAYSEC)
+		rv->delaysec = get_u32_alloc(r);
+
+	if (!r->ok) {
+		sdo_rendezvous_free(rv);
+		return NULL;
+	}
+	return rv;
+}
+
+static bool decode(snap_r_t *r, const uint8_t *tag,
+		   sdo_dev_cred_t *our_dev_cred)
+{
+	sdo_cred_owner_t *owner = NULL;
+	sdo_rendezvous_t *rv;
+	const uint8_t *snap_tag;
+	uint16_t num_entries, i;
+	uint8_t st;
+	int result = 1;
+
+	if (get_u32(r) != CRED_SNAPSHOT_MAGIC ||
+	    get_u16(r) != CRED_SNAPSHOT_VERSION ||
+	    get_u16(r) != PLATFORM_HMAC_SIZE) {
+		LOG(LOG_DEBUG, "Credential snapshot version mismatch\n");
+		return false;
+	}
+
+	snap_tag = get_bytes(r, PLATFORM_HMAC_SIZE);
+	if (!snap_tag ||
+	    memcmp_s(snap_tag, PLATFORM_HMAC_SIZE, tag, PLATFORM_HMAC_SIZE,
+		     &result) != 0 ||
+	    result != 0) {
+		LOG(LOG_DEBUG, "Credential snapshot is stale\n");
+		return false;
+	}
+
+	st = get_u8(r);
+	if (!r->ok)
+		return false;
+
+	if (st < SDO_DEVICE_STATE_READY1) {
+		if (r->pos != r->len)
+			return false;
+		our_dev_cred->ST = st;
+		return true;
+	}
+
+	owner = sdo_cred_owner_alloc();
+	if (!owner) {
+		LOG(LOG_ERROR, "dev_cred's owner_blk allocation failed\n");
+		return false;
+	}
+
+	owner->pv = (int)get_u32(r);
+	owner->pe = (int)get_u32(r);
+	owner->guid = get_byte_array(r);
+	owner->pkh = get_hash(r);
+	owner->rvlst = sdo_rendezvous_list_alloc();
+	if (!r->ok || !owner->pv || !owner->pe || !owner->rvlst)
+		goto err;
+
+	num_entries = get_u16(r);
+	for (i = 0; i < num_entries; i++) {
+		rv = get_rendezvous(r);
+		if (!rv)
+			goto err;
+		sdo_rendezvous_list_add(owner->rvlst, rv);
+	}
+
+	if (!r->ok || r->pos != r->len)
+		goto err;
+
+	if (our_dev_cred->owner_blk != NULL)
+		sdo_cred_owner_free(our_dev_cred->owner_blk);
+	our_dev_cred->owner_blk = owner;
+	our_dev_cred->ST = st;
+	return true;
+
+err:
+	LOG(LOG_DEBUG, "Credential snapshot is malformed\n");
+	sdo_cred_owner_free(owner);
+	return false;
+}
+
+/**
+ * Save a snapshot of the Normal device credentials.
+ * @param snap_file - blob the snapshot is written to
+ * @param json - the Normal credentials JSON, as written to its blob
+ * @param json_len - length of json
+ * @param ocred - the device credentials the JSON was written from
+ * @return true if the snapshot was written, otherwise false.
+ */
+bool cred_snapshot_save(const char *snap_file, const uint8_t *json,
+			size_t json_len, sdo_dev_cred_t *ocred)
+{
+	uint8_t tag[PLATFORM_HMAC_SIZE];
+	snap_w_t w = {.ok = true};
+	bool ret = false;
+
+	if (!snap_file || !json || !ocred)
+		return false;
+
+	/* The tag sdo_blob_write() sealed the JSON with */
+	if (json_len > UINT32_MAX ||
+	    sdo_compute_storage_hmac(json, (uint32_t)json_len, tag,
+				     sizeof(tag)) != 0) {
+		LOG(LOG_ERROR, "Could not compute the credentials tag\n");
+		return false;
+	}
+
+	/* Measure, then encode */
+	encode(&w, tag, ocred);
+	if (!w.ok)
+		goto end;
+
+	w.max = w.len;
+	w.len = 0;
+	w.buf = sdo_alloc(w.max);
+	if (!w.buf)
+		goto end;
+
+	encode(&w, tag, ocred);
+	if (!w.ok || w.len != w.max)
+		goto end;
+
+	if (sdo_blob_write(snap_file, SDO_SDK_NORMAL_DATA, w.buf, w.len) ==
+	    -1) {
+		LOG(LOG_ERROR, "Could not write the credential snapshot\n");
+		goto end;
+	}
+	ret = true;
+
+end:
+	if (w.buf)
+		sdo_free(w.buf);
+	return ret;
+}
+
+/**
+ * Load the Normal device credentials from their snapshot. Only the seal tag
+ * of cred_file is read, the JSON it holds is left alone.
+ * @param snap_file - blob the snapshot was written to
+ * @param cred_file - the Normal credentials blob the snapshot was taken of
+ * @param our_dev_cred - the device credentials to fill in
+ * @return true if a valid snapshot of cred_file was loaded, otherwise false,
+ * in which case our_dev_cred must be filled from the JSON instead.
+ */
+bool cred_snapshot_load(const char *snap_file, const char *cred_file,
+			sdo_dev_cred_t *our_dev_cred)
+{
+	uint8_t tag[PLATFORM_HMAC_SIZE];
+	uint8_t *buf = NULL;
+	int32_t snap_len;
+	snap_r_t r = {.ok = true};
+	bool ret = false;
+
+	if (!snap_file || !cred_file || !our_dev_cred)
+		return false;
+
+	/* Sealed as [HMAC || size || data], see sdo_blob_write() */
+	if (sdo_blob_size(cred_file, SDO_SDK_RAW_DATA) <=
+		(int32_t)(PLATFORM_HMAC_SIZE + BLOB_CONTENT_SIZE) ||
+	    sdo_blob_read(cred_file, SDO_SDK_RAW_DATA, tag, sizeof(tag)) ==
+		-1)
+		return false;
+
+	snap_len = sdo_blob_size(snap_file, SDO_SDK_NORMAL_DATA);
+	if (snap_len <= 0)
+		return false;
+
+	buf = sdo_alloc(snap_len);
+	if (!buf)
+		return false;
+
+	if (sdo_blob_read(snap_file, SDO_SDK_NORMAL_DATA, buf, snap_len) ==
+	    -1) {
+		LOG(LOG_DEBUG, "Could not read the credential snapshot\n");
+		goto end;
+	}
+
+	r.buf = buf;
+	r.len = snap_len;
+	ret = decode(&r, tag, our_dev_cred);
+
+end:
+	sdo_free(buf);
+	return ret;
+}
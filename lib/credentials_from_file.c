@@ -18,6 +18,9 @@
 #include "util.h"
 #include "safe_lib.h"
 #include "sdoCrypto.h"
+#ifdef CRED_SNAPSHOT_ENABLED
+#include "cred_snapshot.h"
+#endif
 #define verbose_dump_packets 0
 
 /**
@@ -84,6 +87,12 @@ bool write_normal_device_credentials(const char *dev_cred_file,
 		goto end;
 	}
 
+#ifdef CRED_SNAPSHOT_ENABLED
+	/* Best effort: a missing or stale snapshot only costs the JSON parse */
+	(void)cred_snapshot_save(SDO_CRED_SNAPSHOT, &sdow->b.block[0],
+				 sdow->b.block_size, ocred);
+#endif
+
 end:
 	if (sdow->b.block) {
 		sdo_free(sdow->b.block);
@@ -242,6 +251,16 @@ bool read_normal_device_credentials(const char *dev_cred_file,
 		goto end;
 	}
 
+#ifdef CRED_SNAPSHOT_ENABLED
+	if (flags == SDO_SDK_NORMAL_DATA &&
+	    cred_snapshot_load(SDO_CRED_SNAPSHOT, dev_cred_file,
+			       our_dev_cred)) {
+		LOG(LOG_DEBUG, "Loaded Ownership Credential from snapshot\n");
+		ret = true;
+		goto end;
+	}
+#endif
+
 	dev_cred_len = sdo_blob_size((char *)dev_cred_file, flags);
 	if (dev_cred_len > 0) {
 		// Resize sdob block size
@@ -627,12 +646,18 @@ static int sdoRFile_recv(sdor_t *sdor, int nbytes)
  */
 int store_credential(sdo_dev_cred_t *ocred)
 {
+	/* The three blobs describe one device state, store them together */
+	if (sdo_blob_batch_begin() != 0) {
+		LOG(LOG_ERROR, "Could not start a credential update\n");
+		return -1;
+	}
+
 	/* Write in the file and save the Normal device credentials */
 	LOG(LOG_DEBUG, "Writing to %s blob\n", "Normal.blob");
 	if (!write_normal_device_credentials((char *)SDO_CRED_NORMAL,
 					     SDO_SDK_NORMAL_DATA, ocred)) {
 		LOG(LOG_ERROR, "Could not write to Normal Credentials blob\n");
-		return -1;
+		goto err;
 	}
 
 	/* Write in the file and save the MFG device credentials */
@@ -640,7 +665,7 @@ int store_credential(sdo_dev_cred_t *ocred)
 	if (!write_mfg_device_credentials((char *)SDO_CRED_MFG,
 					  SDO_SDK_NORMAL_DATA, ocred)) {
 		LOG(LOG_ERROR, "Could not write to MFG Credentials blob\n");
-		return -1;
+		goto err;
 	}
 
 #if !defined(DEVICE_TPM20_ENABLED)
@@ -649,11 +674,19 @@ int store_credential(sdo_dev_cred_t *ocred)
 	if (!write_secure_device_credentials((char *)SDO_CRED_SECURE,
 					     SDO_SDK_SECURE_DATA, ocred)) {
 		LOG(LOG_ERROR, "Could not write to Secure Credentials blob\n");
-		return -1;
+		goto err;
 	}
 #endif
 
+	if (sdo_blob_batch_end(true) != 0) {
+		LOG(LOG_ERROR, "Could not commit the credential update\n");
+		return -1;
+	}
 	return 0;
+
+err:
+	(void)sdo_blob_batch_end(false);
+	return -1;
 }
 
 /**
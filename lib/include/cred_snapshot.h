@@ -0,0 +1,29 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*
+ * Device Credential Snapshot declaration
+ *
+ * Fixed-layout binary copy of the Normal device credentials, bound to the
+ * seal of the Normal blob it was taken from.
+ */
+
+#ifndef __CRED_SNAPSHOT_H__
+#define __CRED_SNAPSHOT_H__
+
+#include "sdocred.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bump whenever the snapshot layout changes */
+#define CRED_SNAPSHOT_VERSION 2
+
+bool cred_snapshot_save(const char *snap_file, const uint8_t *json,
+			size_t json_len, sdo_dev_cred_t *ocred);
+bool cred_snapshot_load(const char *snap_file, const char *cred_file,
+			sdo_dev_cred_t *our_dev_cred);
+
+#endif /* __CRED_SNAPSHOT_H__ */
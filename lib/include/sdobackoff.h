@@ -0,0 +1,66 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Retry/backoff scheduler shared by all SDO retry sites.
+ */
+
+#ifndef __SDOBACKOFF_H__
+#define __SDOBACKOFF_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdo.h"
+
+/* Default policies, delays in milliseconds */
+#define SDO_RETRY_CONNECT_BASE_MS 1000
+#define SDO_RETRY_CONNECT_CAP_MS 8000
+#define SDO_RETRY_CONNECT_ATTEMPTS 2
+
+#define SDO_RETRY_NETIO_BASE_MS 500
+#define SDO_RETRY_NETIO_CAP_MS 4000
+#define SDO_RETRY_NETIO_ATTEMPTS 2
+
+#define SDO_RETRY_PROTOCOL_BASE_MS 3000
+#define SDO_RETRY_PROTOCOL_CAP_MS 120000
+#define SDO_RETRY_PROTOCOL_ATTEMPTS 0 /* unlimited */
+
+/* Initializer of a policy table holding the defaults above */
+#define SDO_RETRY_DEFAULT_POLICIES                                             \
+	{                                                                      \
+		[SDO_RETRY_CONNECT] = {SDO_RETRY_CONNECT_BASE_MS,              \
+				       SDO_RETRY_CONNECT_CAP_MS,               \
+				       SDO_RETRY_CONNECT_ATTEMPTS},            \
+		[SDO_RETRY_NETIO] = {SDO_RETRY_NETIO_BASE_MS,                  \
+				     SDO_RETRY_NETIO_CAP_MS,                   \
+				     SDO_RETRY_NETIO_ATTEMPTS},                \
+		[SDO_RETRY_DI] = {SDO_RETRY_PROTOCOL_BASE_MS,                  \
+				  SDO_RETRY_PROTOCOL_CAP_MS,                   \
+				  SDO_RETRY_PROTOCOL_ATTEMPTS},                \
+		[SDO_RETRY_TO1] = {SDO_RETRY_PROTOCOL_BASE_MS,                 \
+				   SDO_RETRY_PROTOCOL_CAP_MS,                  \
+				   SDO_RETRY_PROTOCOL_ATTEMPTS},               \
+		[SDO_RETRY_TO2] = {SDO_RETRY_PROTOCOL_BASE_MS,                 \
+				   SDO_RETRY_PROTOCOL_CAP_MS,                  \
+				   SDO_RETRY_PROTOCOL_ATTEMPTS},               \
+	}
+
+/* Per retry-site backoff state */
+typedef struct sdo_backoff_s {
+	sdo_sdk_retry_phase phase;
+	uint32_t attempt;
+	uint32_t prev_ms;
+	uint32_t floor_ms;
+} sdo_backoff_t;
+
+void sdo_backoff_init(sdo_backoff_t *bo, sdo_sdk_retry_phase phase);
+void sdo_backoff_set_floor(sdo_backoff_t *bo, uint64_t floor_ms);
+bool sdo_backoff_next(sdo_backoff_t *bo, uint32_t *delay_ms);
+bool sdo_backoff_wait(sdo_backoff_t *bo);
+void sdo_backoff_budget_start(void);
+void sdo_backoff_reset_policies(void);
+
+#endif /* __SDOBACKOFF_H__ */
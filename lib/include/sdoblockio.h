@@ -7,6 +7,7 @@
 #define __SDOBLOCKIO_H__
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define INT2HEX(i) ((i) <= 9 ? '0' + (i) : 'A' - 10 + (i))
@@ -69,6 +70,8 @@ int sdo_read_array_sz(sdor_t *sdor);
 int sdo_read_array_no_state_change(sdor_t *sdor, uint8_t *buf);
 int sdo_read_string(sdor_t *sdor, char *bufp, int buf_sz);
 int sdo_read_tag(sdor_t *sdor, char *bufp, int buf_sz);
+bool sdo_read_string_view(sdor_t *sdor, uint8_t **data, size_t *len);
+bool sdo_read_tag_view(sdor_t *sdor, uint8_t **data, size_t *len);
 bool sdo_read_tag_finisher(sdor_t *sdor);
 int sdo_read_expected_tag(sdor_t *sdor, const char *tag);
 int sdo_read_byte_array_field(sdor_t *sdor, int b64Sz, uint8_t *bufp,
@@ -88,6 +91,8 @@ void sdo_write_tag_len(sdow_t *sdow, const char *tag, int len);
 void sdo_writeUInt(sdow_t *sdow, uint32_t i);
 void sdo_write_string(sdow_t *sdow, const char *s);
 void sdo_write_string_len(sdow_t *sdow, const char *s, int len);
+size_t sdo_write_string_size(const char *s, int len);
+bool sdo_write_serialized(sdow_t *sdow, const uint8_t *data, size_t len);
 void sdo_write_big_num_field(sdow_t *sdow, uint8_t *bufp, int buf_sz);
 void sdo_write_big_num(sdow_t *sdow, uint8_t *bufp, int buf_sz);
 void sdo_write_byte_array_field(sdow_t *sdow, uint8_t *bufp, int buf_sz);
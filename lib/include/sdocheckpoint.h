@@ -0,0 +1,27 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief TO2 checkpoint/resume.
+ */
+
+#ifndef __SDOCHECKPOINT_H__
+#define __SDOCHECKPOINT_H__
+
+#include <stdbool.h>
+#include "sdoprot.h"
+#include "sdoprotctx.h"
+
+#define SDO_TO2_CHECKPOINT_VERSION 1
+
+bool sdo_to2_resumable(sdo_prot_t *ps);
+bool sdo_to2_checkpoint_save(sdo_prot_ctx_t *prot_ctx);
+bool sdo_to2_checkpoint_load(sdo_byte_array_t *guid);
+bool sdo_to2_checkpoint_restore(sdo_prot_t *ps);
+bool sdo_to2_checkpoint_restore_session(sdo_prot_ctx_t *prot_ctx);
+void sdo_to2_checkpoint_discard(void);
+
+#endif /* __SDOCHECKPOINT_H__ */
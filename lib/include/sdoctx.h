@@ -0,0 +1,119 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief SDK context: the state of one onboarding session.
+ *
+ * Everything the protocol, network, REST and crypto layers keep between
+ * calls lives in a struct sdo_sdk_ctx. The application creates contexts with
+ * sdo_sdk_ctx_new() and binds one to the calling thread with
+ * sdo_sdk_ctx_use(); the layers below reach it through sdo_ctx_current().
+ * Threads that never bind a context share the default one, which keeps the
+ * single-session API working as before.
+ */
+
+#ifndef __SDOCTX_H__
+#define __SDOCTX_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdo.h"
+#include "sdotypes.h"
+#include "sdoblockio.h"
+#include "sdobackoff.h"
+#include "sdoCryptoCtx.h"
+#include "rest_interface.h"
+#ifdef CRED_STORE_ENABLED
+#include "cred_store.h"
+#endif
+
+#if defined(TARGET_OS_LINUX)
+#include <pthread.h>
+/* Storage class of the per-thread context binding */
+#define SDO_CTX_TLS __thread
+#else
+#define SDO_CTX_TLS
+#endif
+
+struct app_data_s;
+
+/* Device key share computed ahead of TO2, see sdo_kex_precompute_start() */
+typedef struct {
+	bool pending; /* precompute started and not yet claimed */
+	int32_t status;
+	void *context;
+#if defined(TARGET_OS_LINUX)
+	pthread_t thread;
+#endif
+} sdo_kex_precompute_t;
+
+#if defined(TARGET_OS_LINUX)
+/* Blob files written during a batch (the credentials and their snapshot
+ * need four) wait under their temporary name until sdo_blob_batch_end()
+ */
+#define SDO_BLOB_BATCH_MAX 8
+
+typedef struct {
+	char *name;
+	char *tmp_name;
+} sdo_blob_pending_t;
+
+/* Blob writes of an open sdo_blob_batch_begin() */
+typedef struct {
+	bool open;
+	sdo_blob_pending_t pending[SDO_BLOB_BATCH_MAX];
+	size_t count;
+} sdo_blob_batch_t;
+#endif
+
+struct sdo_sdk_ctx {
+	/* lib/sdo.c: state machine, credentials and service info */
+	struct app_data_s *sdo_data;
+	/* network/rest_interface.c */
+	rest_ctx_t *rest;
+	/* crypto/common: session keys and the precomputed key share */
+	sdo_crypto_context_t crypto;
+	sdo_kex_precompute_t kex_pre;
+	/* lib/sdonet.c: HTTP proxies */
+	sdo_ip_address_t rvproxy_ip;
+	uint16_t rvproxy_port;
+	sdo_ip_address_t mfgproxy_ip;
+	uint16_t mfgproxy_port;
+	sdo_ip_address_t ownerproxy_ip;
+	uint16_t ownerproxy_port;
+	/* lib/sdocheckpoint.c: TO2 checkpoint */
+	sdor_t cp_reader; /* loaded checkpoint, positioned after the GUID */
+	bool cp_on_disk;  /* a valid checkpoint may be present in storage */
+	/* REST session restored into the REST context by restore_session() */
+	char *cp_auth;
+	char *cp_xtoken;
+	/* lib/sdobackoff.c: retry policies and budget */
+	sdo_sdk_retry_policy retry_policy[SDO_RETRY_PHASE_MAX];
+	/* total retry budget for one sdo_sdk_run(), 0 means unlimited */
+	uint32_t retry_budget_ms;
+	uint64_t retry_budget_start_ms;
+	sdo_sdk_retryCB retry_callback;
+	/* storage: directory of the blobs, NULL for the working directory */
+	char *blob_dir;
+#if defined(TARGET_OS_LINUX)
+	sdo_blob_batch_t blob_batch;
+#endif
+#ifdef CRED_STORE_ENABLED
+	cred_store_t cred_store;
+#endif
+};
+
+/* A context as sdo_sdk_ctx_new() returns it */
+#define SDO_CTX_INITIALIZER                                                    \
+	{                                                                      \
+		.retry_policy = SDO_RETRY_DEFAULT_POLICIES                     \
+	}
+
+sdo_sdk_ctx *sdo_ctx_current(void);
+void sdo_ctx_lock(void);
+void sdo_ctx_unlock(void);
+
+#endif /* __SDOCTX_H__ */
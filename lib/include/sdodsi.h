@@ -0,0 +1,26 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Device service info built ahead of msg46 on a producer thread.
+ */
+
+#ifndef __SDODSI_H__
+#define __SDODSI_H__
+
+#include <stdbool.h>
+#include "sdotypes.h"
+#include "sdoblockio.h"
+
+/* DSIs the producer may have ready before it waits for msg46 */
+#define SDO_DSI_PREFETCH_DEPTH 2
+
+void sdo_dsi_prefetch_start(sdo_sv_info_dsi_info_t *dsi_info);
+bool sdo_dsi_write_next(sdo_sv_info_dsi_info_t *dsi_info, sdow_t *sdow,
+			int *cb_return_val);
+void sdo_dsi_prefetch_stop(sdo_sv_info_dsi_info_t *dsi_info);
+
+#endif /* __SDODSI_H__ */
@@ -0,0 +1,28 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Accounting of the heap the SDK allocates with sdo_alloc().
+ */
+
+#ifndef __SDOHEAP_H__
+#define __SDOHEAP_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Leaks listed one by one by the report of sdo_sdk_deinit() */
+#define SDO_HEAP_LEAKS_LISTED 16
+
+bool sdo_heap_track(void *ptr, size_t size, const void *caller);
+void *sdo_heap_realloc(void *ptr, size_t size, const void *caller);
+void sdo_heap_set_msg(int msg_type);
+void sdo_heap_session_start(void);
+void sdo_heap_leak_report(void);
+uint32_t sdo_heap_size_class(size_t size);
+
+#endif /* __SDOHEAP_H__ */
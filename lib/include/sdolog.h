@@ -0,0 +1,38 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Log records kept in per-thread rings and formatted later.
+ */
+
+#ifndef __SDOLOG_H__
+#define __SDOLOG_H__
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Argument bytes of one record; a record takes 256 bytes of its ring */
+#define SDO_LOG_ARG_BYTES 216
+/* Records each ring keeps; the oldest is overwritten by the next one */
+#define SDO_LOG_RING_SLOTS 256
+/* Threads that may log into a ring of their own at the same time */
+#define SDO_LOG_RINGS 4
+/* How long records wait for the log thread at most */
+#define SDO_LOG_DRAIN_MS 20
+
+size_t sdo_log_encode(uint8_t *buf, size_t size, const char *fmt,
+		      va_list ap, bool *truncated);
+void sdo_log_render(FILE *f, const char *fmt, const uint8_t *buf, size_t len,
+		    bool truncated);
+
+void sdo_log_record_hex(int level, const char *message, const void *buffer,
+			size_t size);
+void sdo_log_flush(void);
+
+#endif /* __SDOLOG_H__ */
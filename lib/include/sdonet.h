@@ -8,10 +8,12 @@
 
 #include "sdoprotctx.h"
 
-#define MANUFACTURER_CONNECT_RETRIES 2
-#define RENDEZVOUS_CONNECT_RETRIES 2
-#define OWNER_CONNECT_RETRIES 2
-#define RETRY_DELAY 1
+/* Servers the device connects to */
+typedef enum {
+	SDO_SERVER_MFG,
+	SDO_SERVER_RV,
+	SDO_SERVER_OWNER
+} sdo_server_t;
 
 void sdo_net_init(void);
 bool is_rv_proxy_defined(void);
@@ -23,6 +25,9 @@ bool setup_http_proxy(const char *filename, sdo_ip_address_t *sdoip,
 bool resolve_dn(const char *dn, sdo_ip_address_t **ip, uint16_t port,
 		void **ssl, bool proxy);
 
+bool sdo_net_target(sdo_server_t server, sdo_ip_address_t **ip,
+		    uint16_t *port, void ***ssl);
+
 bool connect_to_manufacturer(sdo_ip_address_t *ip, uint16_t port,
 			     sdo_con_handle *sock_hdl, void **ssl);
 
@@ -0,0 +1,30 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Owner service info run on module worker threads.
+ */
+
+#ifndef __SDOOSI_H__
+#define __SDOOSI_H__
+
+#include <stdbool.h>
+#include "sdotypes.h"
+
+/* OSI messages a module may have queued before msg49 waits for it */
+#define SDO_OSI_QUEUE_DEPTH 8
+
+bool sdo_osi_async_dispatch(sdo_sdk_service_info_module_list_t *module,
+			    sdo_sdk_si_kv_view *sv_kv, int *cb_return_val);
+bool sdo_osi_async_status(sdo_sdk_service_info_module_list_t *module_list,
+			  int *cb_return_val);
+bool sdo_osi_async_settle(sdo_sdk_service_info_module_list_t *module_list,
+			  sdo_sdk_service_info_module_list_t *module,
+			  int *cb_return_val);
+bool sdo_osi_async_join(sdo_sdk_service_info_module_list_t *module_list,
+			int *cb_return_val);
+
+#endif /* __SDOOSI_H__ */
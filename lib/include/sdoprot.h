@@ -217,6 +217,7 @@ typedef struct sdo_prot_s {
 	int total_dsi_rounds; // device service infos + module DSI counts
 	uint8_t rv_index;     // keep track of current rv index
 	bool reuse_enabled;   // REUSE protocol flag
+	bool resumed;	      // TO2 restored from a checkpoint
 } sdo_prot_t;
 
 /* DI function declarations */
@@ -264,4 +265,6 @@ void sdo_receive_error_message(sdor_t *sdor, int *ecode, int *msgnum,
 bool sdo_prot_rcv_msg(sdor_t *sdor, sdow_t *sdow, char *prot_name, int *statep);
 
 int ps_get_m_string(sdo_prot_t *ps);
+sdo_byte_array_t *sdo_m_string_build(const char *serial, const char *model,
+				     const sdo_byte_array_t *csr);
 #endif /* __SDOPROT_H__ */
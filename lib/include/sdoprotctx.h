@@ -8,6 +8,8 @@
 
 #include "sdoblockio.h"
 #include "sdoprot.h"
+#include "sdobackoff.h"
+#include "rest_interface.h"
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -19,6 +21,19 @@ typedef struct {
 	sdourl_t url[1]; // sdourl_t[numURL]
 } sdo_type_to_url_t;
 
+// Steps of sdo_prot_ctx_step()
+typedef enum {
+	SDO_PROT_STEP_START,	  /* set up REST, restore a resumed session */
+	SDO_PROT_STEP_BUILD,	  /* build the next message */
+	SDO_PROT_STEP_CONNECT,	  /* open the connection */
+	SDO_PROT_STEP_CONNECTING, /* non-blocking connect in progress */
+	SDO_PROT_STEP_SEND,
+	SDO_PROT_STEP_RECV_HEADER,
+	SDO_PROT_STEP_RECV_BODY,
+	SDO_PROT_STEP_DELAY, /* backoff delay, then next_step */
+	SDO_PROT_STEP_DONE
+} sdo_prot_step_t;
+
 // SDO protocol context
 typedef struct sdo_prot_ctx_s {
 	sdo_con_handle sock_hdl;
@@ -31,6 +46,30 @@ typedef struct sdo_prot_ctx_s {
 	uint16_t host_port;
 	const char *host_dns;
 	sdo_ip_address_t *resolved_ip;
+	int prevstate; /* state of the last connect, resumed after an error */
+	/* sdo_prot_ctx_step() */
+	sdo_prot_step_t step;
+	sdo_prot_step_t next_step;
+	uint64_t wake_ms;  /* end of the backoff delay */
+	bool resend;	   /* send the last message again as built */
+	bool io_retry;	   /* resend after a send/receive failure */
+	bool nonblocking;  /* socket I/O of the connection does not block */
+	int result;	   /* 0 or -1 once the step is SDO_PROT_STEP_DONE */
+	sdo_ip_address_t *conn_ip; /* address the connection goes to */
+	uint16_t conn_port;
+	bool conn_tls;
+	sdo_backoff_t connect_backoff;
+	sdo_backoff_t io_backoff;
+	sdo_backoff_t resume_backoff;
+	uint8_t *tx; /* REST header and body being sent */
+	size_t tx_len;
+	size_t tx_off;
+	char rx_hdr[REST_MAX_MSGHDR_SIZE]; /* REST header being received */
+	size_t rx_hdr_len;
+	uint32_t rx_len; /* length of the body being received */
+	uint32_t rx_off;
+	const char *trace_span; /* network span open in the trace, if any */
+	uint64_t connect_us;	/* start of the last connect, for the stats */
 } sdo_prot_ctx_t;
 
 sdo_prot_ctx_t *sdo_prot_ctx_alloc(bool (*protrun)(sdo_prot_t *ps),
@@ -40,6 +79,7 @@ sdo_prot_ctx_t *sdo_prot_ctx_alloc(bool (*protrun)(sdo_prot_t *ps),
 				   bool tls);
 
 int sdo_prot_ctx_run(sdo_prot_ctx_t *prot_ctx);
+int sdo_prot_ctx_step(sdo_prot_ctx_t *prot_ctx, sdo_sdk_wait *wait);
 void sdo_prot_ctx_free(sdo_prot_ctx_t *prot_ctx);
 
 #endif /* __SDOPROTCTX_H__ */
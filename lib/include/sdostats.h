@@ -0,0 +1,28 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Counters and latency histograms behind sdo_sdk_get_stats().
+ */
+
+#ifndef __SDOSTATS_H__
+#define __SDOSTATS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdo.h"
+
+void sdo_stats_bytes_sent(size_t bytes);
+void sdo_stats_bytes_received(size_t bytes);
+void sdo_stats_connect(bool connected);
+void sdo_stats_dns_lookup(void);
+void sdo_stats_retry(sdo_sdk_retry_phase phase);
+void sdo_stats_crypto(sdo_sdk_stats_crypto op);
+sdo_sdk_stats_phase sdo_stats_phase_of(int msg_type);
+void sdo_stats_round_trip(int msg_type, uint64_t latency_us);
+uint32_t sdo_stats_bucket_of(uint64_t us);
+
+#endif /* __SDOSTATS_H__ */
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Trace points of the protocol, network, crypto and storage phases.
+ */
+
+#ifndef __SDOTRACE_H__
+#define __SDOTRACE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdo.h"
+
+#ifdef TRACE_ENABLED
+/* set while a trace callback or file is registered */
+extern volatile bool sdo_trace_on;
+
+void sdo_trace(sdo_sdk_trace_cat cat, const char *name, int32_t msg_type,
+	       char phase);
+
+#define SDO_TRACE(cat, name, msg_type, phase)                                  \
+	do {                                                                   \
+		if (sdo_trace_on)                                              \
+			sdo_trace(cat, name, msg_type, phase);                 \
+	} while (0)
+#else
+#define SDO_TRACE(cat, name, msg_type, phase)                                  \
+	do {                                                                   \
+		(void)(msg_type);                                              \
+	} while (0)
+#endif
+
+#define SDO_TRACE_BEGIN(cat, name, msg_type) SDO_TRACE(cat, name, msg_type, 'B')
+#define SDO_TRACE_END(cat, name, msg_type) SDO_TRACE(cat, name, msg_type, 'E')
+
+#endif /* __SDOTRACE_H__ */
@@ -336,7 +336,6 @@ bool sdoOVSignature_verification(sdor_t *sdor, sdo_sig_t *sig,
 				 sdo_public_key_t *pk);
 
 typedef struct sdo_key_value_s {
-	struct sdo_key_value_s *next;
 	sdo_string_t *key;
 	sdo_string_t *val;
 } sdo_key_value_t;
@@ -389,9 +388,16 @@ sdo_rendezvous_t *sdo_rendezvous_list_get(sdo_rendezvous_list_t *list, int num);
 int sdo_rendezvous_list_read(sdor_t *sdor, sdo_rendezvous_list_t *list);
 bool sdo_rendezvous_list_write(sdow_t *sdow, sdo_rendezvous_list_t *list);
 
+/*
+ * Key/value table: entries in insertion order, looked up by key (case
+ * insensitive) through an open-addressed index of 2 * max_kv slots.
+ */
 typedef struct sdo_service_info_s {
 	int numKV;
-	sdo_key_value_t *kv;
+	int max_kv;	      // room in kv
+	sdo_key_value_t **kv; // numKV entries, then NULL
+	uint32_t *index;      // position in kv + 1, 0 for a free slot
+	size_t write_sz;      // bytes sdo_combine_platform_dsis() writes
 } sdo_service_info_t;
 
 sdo_service_info_t *sdo_service_info_alloc(void);
@@ -420,6 +426,9 @@ typedef struct sdo_sdk_service_info_module_list_s {
 	int module_psi_index;
 	int module_dsi_count;
 	int module_osi_index;
+	struct sdo_osi_queue_s *osi_queue; // see sdoosi.h
+	size_t name_len;		   // set by sdo_sv_info_index_build()
+	struct sdo_sv_info_index_s *index; // head only: module name lookup
 	struct sdo_sdk_service_info_module_list_s
 	    *next; // ptr to next module node
 } sdo_sdk_service_info_module_list_t;
@@ -427,6 +436,7 @@ typedef struct sdo_sdk_service_info_module_list_s {
 typedef struct sdo_sv_info_dsi_info_s {
 	sdo_sdk_service_info_module_list_t *list_dsi;
 	int module_dsi_index;
+	struct sdo_dsi_prefetch_s *prefetch; // see sdodsi.h
 } sdo_sv_info_dsi_info_t;
 
 /* exposed API for modules to registr */
@@ -450,18 +460,23 @@ bool sdo_mod_kv_write(sdow_t *sdow, sdo_sdk_si_key_value *kv);
 void sdo_sv_key_value_free(sdo_sdk_si_key_value *sv_kv);
 
 bool sdo_supply_modulePSI(sdo_sdk_service_info_module_list_t *module_list,
-			  char *mod_name, sdo_sdk_si_key_value *sv_kv,
+			  char *mod_name, sdo_sdk_si_kv_view *sv_kv,
 			  int *cb_return_val);
 bool sdo_supply_moduleOSI(sdo_sdk_service_info_module_list_t *module_list,
-			  char *mod_name, sdo_sdk_si_key_value *sv_kv,
+			  char *mod_name, sdo_sdk_si_kv_view *sv_kv,
 			  int *cb_return_val);
 bool sdo_osi_parsing(sdor_t *sdor,
 		     sdo_sdk_service_info_module_list_t *module_list,
-		     sdo_sdk_si_key_value *kv, int *cb_return_val);
+		     sdo_sdk_si_kv_view *kv, int *cb_return_val);
 bool sdo_osi_handling(sdo_sdk_service_info_module_list_t *module_list,
-		      sdo_sdk_si_key_value *sv, int *cb_return_val);
+		      sdo_sdk_si_kv_view *sv, int *cb_return_val);
 void sdo_sv_info_clear_module_psi_osi_index(
     sdo_sdk_service_info_module_list_t *module_list);
+bool sdo_sv_info_index_build(sdo_sdk_service_info_module_list_t *module_list);
+void sdo_sv_info_index_free(sdo_sdk_service_info_module_list_t *module_list);
+sdo_sdk_service_info_module_list_t *
+sdo_sv_info_find_module(sdo_sdk_service_info_module_list_t *module_list,
+			const char *name, size_t name_len);
 bool sdo_construct_module_list(sdo_sdk_service_info_module_list_t *module_list,
 			       char **mod_name);
 
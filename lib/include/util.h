@@ -29,6 +29,13 @@ extern "C" {
 
 int atoi(char *ptr);
 int isalnum(int c);
+#elif defined(HEAP_TRACK_ENABLED)
+void sdo_heap_free(void *ptr);
+#define sdo_free(x)                                                            \
+	{                                                                      \
+		sdo_heap_free(x);                                              \
+		x = NULL;                                                      \
+	}
 #else
 #define sdo_free(x)                                                            \
 	{                                                                      \
@@ -58,6 +65,12 @@ typedef enum log_level {
 #include <time.h>
 #include <string.h>
 #define TIMESTAMP_LEN 9
+#ifdef LOG_RING_ENABLED
+/* Kept in the log ring of the thread, printed by the log thread */
+void sdo_log_record(int level, const char *file, int line, const char *fmt,
+		    ...) __attribute__((format(printf, 4, 5)));
+#define LOG(level, ...) sdo_log_record(level, __FILE__, __LINE__, __VA_ARGS__)
+#else
 #define LOG(level, ...)                                                        \
 	{                                                                      \
 		if (level <= LOG_LEVEL) {                                      \
@@ -72,6 +85,7 @@ typedef enum log_level {
 		}                                                              \
 	}
 #endif
+#endif
 
 #ifndef TARGET_OS_MBEDOS
 #define ATTRIBUTE_FALLTHROUGH __attribute__((fallthrough))
@@ -170,6 +184,7 @@ int read_buffer_from_file(const char *filename, void *buffer, size_t size);
  * Allocate a buffer and set its contents to 0 before using it.
  */
 void *sdo_alloc(int size);
+void *sdo_realloc(void *buf, int size);
 
 /* Print timestamp */
 int print_timestamp(void);
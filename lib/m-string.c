@@ -63,15 +63,98 @@
 #define MAX_DEV_SERIAL_SZ 32
 #define MAX_MODEL_NO_SZ 32
 
+/* <key type id> follows the owner attestation, see above */
+#if defined(PK_ENC_RSA)
+#define M_STRING_KEY_TYPE SDO_CRYPTO_PUB_KEY_ALGO_RSA
+#elif defined(ECDSA384_DA)
+#define M_STRING_KEY_TYPE SDO_CRYPTO_PUB_KEY_ALGO_ECDSAp384
+#else
+#define M_STRING_KEY_TYPE SDO_CRYPTO_PUB_KEY_ALGO_ECDSAp256
+#endif
+
+/**
+ * Assemble the m-string of a device from its serial number, model number
+ * and, for ECDSA device attestation, its CSR. Only the arguments are used,
+ * so a factory tool can build the m-strings of many devices in parallel.
+ *
+ * @param serial - device serial number.
+ * @param model - device model number, may be empty.
+ * @param csr - device CSR, NULL when none is sent (RSA owner attestation).
+ * @return the m-string, or NULL on failure.
+ */
+sdo_byte_array_t *sdo_m_string_build(const char *serial, const char *model,
+				     const sdo_byte_array_t *csr)
+{
+	char key_id[MAX_KEY_ID_SIZE + 1] = {0};
+	size_t key_id_len = 0;
+	size_t serial_len = 0;
+	size_t model_len = 0;
+	size_t ofs = 0;
+	sdo_byte_array_t *m_string = NULL;
+
+	if (!serial || !model) {
+		LOG(LOG_ERROR, "Invalid m-string parameters\n");
+		return NULL;
+	}
+
+	if (snprintf_s_i(key_id, sizeof(key_id), "%u", M_STRING_KEY_TYPE) < 0) {
+		LOG(LOG_ERROR, "failed to fill in key id\n");
+		return NULL;
+	}
+
+	key_id_len = strnlen_s(key_id, sizeof(key_id));
+	serial_len = strnlen_s(serial, MAX_DEV_SERIAL_SZ);
+	model_len = strnlen_s(model, MAX_MODEL_NO_SZ);
+	if (serial_len == MAX_DEV_SERIAL_SZ || model_len == MAX_MODEL_NO_SZ) {
+		LOG(LOG_ERROR, "Serial or model number too long\n");
+		return NULL;
+	}
+
+	/*
+	 * <key id>\0<serial>\0<model>, then \0<CSR> when there is one. The
+	 * array is zeroed on allocation, so the separators are already there.
+	 */
+	m_string = sdo_byte_array_alloc(key_id_len + 1 + serial_len + 1 +
+					model_len +
+					(csr ? 1 + csr->byte_sz : 0));
+	if (!m_string) {
+		LOG(LOG_ERROR, "Failed to allocate m-string buffer\n");
+		return NULL;
+	}
+
+	if (memcpy_s(m_string->bytes, m_string->byte_sz, key_id, key_id_len))
+		goto err;
+	ofs = key_id_len + 1;
+	if (serial_len && memcpy_s(m_string->bytes + ofs,
+				   m_string->byte_sz - ofs, serial, serial_len))
+		goto err;
+	ofs += serial_len + 1;
+	if (model_len && memcpy_s(m_string->bytes + ofs,
+				  m_string->byte_sz - ofs, model, model_len))
+		goto err;
+	ofs += model_len;
+	if (csr && memcpy_s(m_string->bytes + ofs + 1,
+			    m_string->byte_sz - ofs - 1, csr->bytes,
+			    csr->byte_sz))
+		goto err;
+	return m_string;
+
+err:
+	LOG(LOG_ERROR, "Failed to fill in m-string\n");
+	sdo_byte_array_free(m_string);
+	return NULL;
+}
+
 #if defined(MANUFACTURER_TOOLKIT)
 /* TODO: Device serial number source need to be fixed */
 #define DEF_SERIAL_NO "abcdef"
 #define DEF_MODEL_NO "0"
-static char device_serial[MAX_DEV_SERIAL_SZ];
-static char model_number[MAX_MODEL_NO_SZ];
-static char key_id[MAX_KEY_ID_SIZE];
-
-static int read_fill_modelserial(void)
+/**
+ * Read the serial and model numbers of the device into device_serial
+ * (MAX_DEV_SERIAL_SZ bytes) and model_number (MAX_MODEL_NO_SZ bytes), both
+ * zeroed by the caller, so that they are NUL terminated.
+ */
+static int read_fill_modelserial(char *device_serial, char *model_number)
 {
 	int ret = -1;
 	uint8_t def_serial_sz = 0;
@@ -79,7 +162,10 @@ static int read_fill_modelserial(void)
 	int32_t fsize = 0;
 
 	fsize = sdo_blob_size((const char *)SERIAL_FILE, SDO_SDK_RAW_DATA);
-	if (fsize > 0) {
+	if (fsize >= MAX_DEV_SERIAL_SZ) {
+		LOG(LOG_ERROR, "Serial no is too long\n");
+		goto err;
+	} else if (fsize > 0) {
 
 		if (sdo_blob_read((const char *)SERIAL_FILE, SDO_SDK_RAW_DATA,
 				  (uint8_t *)device_serial, fsize) <= 0) {
@@ -100,7 +186,10 @@ static int read_fill_modelserial(void)
 	}
 
 	fsize = sdo_blob_size((const char *)MODEL_FILE, SDO_SDK_RAW_DATA);
-	if (fsize > 0) {
+	if (fsize >= MAX_MODEL_NO_SZ) {
+		LOG(LOG_ERROR, "Model no is too long\n");
+		goto err;
+	} else if (fsize > 0) {
 		if (sdo_blob_read((const char *)MODEL_FILE, SDO_SDK_RAW_DATA,
 				  (uint8_t *)model_number, fsize) <= 0) {
 			LOG(LOG_ERROR, "Failed to get serial no\n");
@@ -124,176 +213,38 @@ err:
 
 /**
  * Internal API
- * Returns the base common size of m_string;
  */
-static uint32_t get_base_m_string_size(void)
-{
-	return strnlen_s(key_id, MAX_KEY_ID_SIZE) + 1 +
-	       strnlen_s(device_serial, MAX_DEV_SERIAL_SZ) + 1 +
-	       strnlen_s(model_number, MAX_MODEL_NO_SZ);
-}
-
-/**
- * Internal API
- * Fills in the base m-string
- */
-static int fill_base_m_string(uint8_t *m_string_bytes, size_t m_string_sz,
-			      uint32_t *ofs)
-{
-	int ret = -1;
-	size_t key_id_len = strnlen_s(key_id, MAX_KEY_ID_SIZE);
-	size_t device_serial_len = strnlen_s(device_serial, MAX_DEV_SERIAL_SZ);
-	size_t model_number_len = strnlen_s(model_number, MAX_MODEL_NO_SZ);
-
-	/* Fill in the key ID. First param of m-string */
-	ret =
-	    strncpy_s((char *)m_string_bytes, m_string_sz, key_id, key_id_len);
-	if (ret) {
-		LOG(LOG_ERROR, "Failed to copy key_id in m-string\n");
-		goto err;
-	}
-	*ofs = key_id_len + 1;
-
-	/* Fill in the device serial */
-	ret = strncpy_s((char *)m_string_bytes + *ofs, m_string_sz - *ofs,
-			device_serial, device_serial_len);
-	if (ret) {
-		LOG(LOG_ERROR, "Failed to copy device serial in m-string\n");
-		goto err;
-	}
-	*ofs += device_serial_len + 1;
-
-#if defined(PK_ENC_ECDSA) && (defined(ECDSA256_DA) || defined(ECDSA384_DA))
-	/* Fill in the model number with NULL termination */
-	ret = strncpy_s((char *)m_string_bytes + *ofs, m_string_sz - *ofs,
-			model_number, model_number_len);
-	if (ret) {
-		LOG(LOG_ERROR, "Failed to copy model number in m-string\n");
-		goto err;
-	}
-	*ofs += strnlen_s(model_number, MAX_MODEL_NO_SZ) + 1;
-
-#else /* PK_ENC_RSA */
-	/* Fill in the model number without NULL termination, no space for it */
-
-	ret = memcpy_s((char *)m_string_bytes + *ofs, m_string_sz - *ofs,
-		       model_number, model_number_len);
-	if (ret) {
-		LOG(LOG_ERROR, "Failed to copy model number in m-string\n");
-		goto err;
-	}
-	*ofs += strnlen_s(model_number, MAX_MODEL_NO_SZ);
-#endif
-
-err:
-	return ret;
-}
-
-/**
- * Internal API
- * Fill in ps with non-CSR data. It is used for:
- * a. PK_ENC = rsa
- * b. PK_ENC = ecdsa
- */
-#if defined(PK_ENC_RSA)
-static int non_csr_m_string(sdo_prot_t *ps)
-{
-	int ret = -1;
-	uint32_t ofs = 0;
-	size_t m_string_sz = 0;
-	sdo_byte_array_t *m_string = NULL;
-
-	if (read_fill_modelserial()) {
-		return ret;
-	}
-
-	/* Get the total size of m-string (includes NULL + CSR) */
-	m_string_sz = get_base_m_string_size();
-	m_string = sdo_byte_array_alloc(m_string_sz);
-	if (!m_string) {
-		LOG(LOG_ERROR, "Failed to allocate m-string buffer\n");
-		goto err;
-	}
-
-	/* Fill the base part of m-string */
-	ret = fill_base_m_string(m_string->bytes, m_string->byte_sz, &ofs);
-	if (ret) {
-		LOG(LOG_ERROR, "Failed to fill in base ecc m-string\n");
-		goto err;
-	}
-
-	sdo_byte_array_write_chars(&ps->sdow, m_string);
-
-err:
-	if (m_string)
-		sdo_byte_array_free(m_string);
-	return ret;
-}
-#endif
-
-/**
- * Internal API
- */
-#if defined(PK_ENC_ECDSA)
-#if defined(ECDSA256_DA) || defined(ECDSA384_DA)
+#if defined(PK_ENC_RSA) ||                                                     \
+    (defined(PK_ENC_ECDSA) && (defined(ECDSA256_DA) || defined(ECDSA384_DA)))
 int ps_get_m_string(sdo_prot_t *ps)
 {
 	int ret = -1;
-	uint32_t ofs = 0;
-	size_t m_string_sz = 0;
+	char device_serial[MAX_DEV_SERIAL_SZ] = {0};
+	char model_number[MAX_MODEL_NO_SZ] = {0};
 	sdo_byte_array_t *csr = NULL;
 	sdo_byte_array_t *m_string = NULL;
 
-	if (read_fill_modelserial()) {
+	if (read_fill_modelserial(device_serial, model_number)) {
 		return ret;
 	}
 
+#if defined(PK_ENC_ECDSA)
 	/* Get the CSR data */
 	ret = sdo_get_device_csr(&csr);
 	if (0 != ret) {
 		LOG(LOG_ERROR, "Unable to get device CSR\n");
 		goto err;
 	}
-
-	/* Fill in the key id */
-#if defined(ECDSA256_DA)
-	if (snprintf_s_i(key_id, sizeof(key_id), "%u",
-			 SDO_CRYPTO_PUB_KEY_ALGO_ECDSAp256) < 0) {
-		LOG(LOG_ERROR, "failed to fill in key id for ecdsa256\n");
-		goto err;
-	}
-#else
-	if (snprintf_s_i(key_id, sizeof(key_id), "%u",
-			 SDO_CRYPTO_PUB_KEY_ALGO_ECDSAp384) < 0) {
-		LOG(LOG_ERROR, "failed to fill in key id for ecdsa384\n");
-		goto err;
-	}
 #endif
 
-	/* Get the total size of m-string (includes NULL + CSR) */
-	m_string_sz = get_base_m_string_size() + (1 + csr->byte_sz);
-	m_string = sdo_byte_array_alloc(m_string_sz);
+	m_string = sdo_m_string_build(device_serial, model_number, csr);
 	if (!m_string) {
-		LOG(LOG_ERROR, "Failed to allocate m-string buffer\n");
-		goto err;
-	}
-
-	/* Fill the base part of m-string */
-	ret = fill_base_m_string(m_string->bytes, m_string->byte_sz, &ofs);
-	if (ret) {
-		LOG(LOG_ERROR, "Failed to fill in base ecc m-string\n");
-		goto err;
-	}
-
-	/* Copy CSR */
-	ret = memcpy_s(m_string->bytes + ofs, m_string_sz - ofs, csr->bytes,
-		       csr->byte_sz);
-	if (ret) {
-		LOG(LOG_ERROR, "Failed to copy csr-data\n");
+		ret = -1;
 		goto err;
 	}
 
 	sdo_byte_array_write_chars(&ps->sdow, m_string);
+	ret = 0;
 
 err:
 	if (m_string)
@@ -302,24 +253,6 @@ err:
 		sdo_byte_array_free(csr);
 	return ret;
 }
-
-#endif /* #if defined (ECDSA256_DA) || defined (ECDSA384_DA) */
-
-#elif defined(PK_ENC_RSA)
-/**
- * Internal API
- */
-int ps_get_m_string(sdo_prot_t *ps)
-{
-	/* Fill in the key id */
-	if (snprintf_s_i(key_id, sizeof(key_id), "%u",
-			 SDO_CRYPTO_PUB_KEY_ALGO_RSA) < 0) {
-		LOG(LOG_ERROR, "failed to fill in key id for rsa\n");
-		return -1;
-	}
-
-	return non_csr_m_string(ps);
-}
 #endif
 #else /* If Manufacturer toolkit is not defined */
 /**
@@ -10,6 +10,7 @@
 
 #include "sdoprot.h"
 #include "sdokeyexchange.h"
+#include "sdodsi.h"
 #include "util.h"
 
 /**
@@ -53,29 +54,16 @@ int32_t msg46(sdo_prot_t *ps)
 			LOG(LOG_ERROR, "Error in combining platform DSI's!\n");
 			goto err;
 		}
+		/* Have the next module DSIs built while this one is sent */
+		if (ps->total_dsi_rounds > 1)
+			sdo_dsi_prefetch_start(ps->dsi_info);
 	} else {
 		int mod_ret_val = 0;
 
 		/* Sv_info external module(s) DSI's */
-		sdo_sdk_si_key_value *sv_kv =
-		    sdo_alloc(sizeof(sdo_sdk_si_key_value));
-		if (!sv_kv)
+		if (!sdo_dsi_write_next(ps->dsi_info, &ps->sdow,
+					&mod_ret_val))
 			goto err;
-
-		if (!sdo_construct_module_dsi(ps->dsi_info, sv_kv,
-					      &mod_ret_val)) {
-			LOG(LOG_DEBUG, "Sv_info: module DSI "
-				       "Construction Failed\n");
-			sdo_sv_key_value_free(sv_kv);
-			goto err;
-		}
-
-		if (!sdo_mod_kv_write(&ps->sdow, sv_kv)) {
-			sdo_sv_key_value_free(sv_kv);
-			goto err;
-		}
-		/* Free allocated memory */
-		sdo_sv_key_value_free(sv_kv);
 	}
 
 	sdow_end_object(&ps->sdow);
@@ -93,6 +81,7 @@ int32_t msg46(sdo_prot_t *ps)
 		ps->state = SDO_STATE_TO2_RCV_GET_NEXT_DEVICE_SERVICE_INFO;
 	} else {
 		/* Move to msg47 */
+		sdo_dsi_prefetch_stop(ps->dsi_info);
 		ps->state = SDO_STATE_TO2_RCV_SETUP_DEVICE;
 	}
 
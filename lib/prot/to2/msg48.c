@@ -10,6 +10,7 @@
 
 #include "sdoprot.h"
 #include "sdokeyexchange.h"
+#include "sdoosi.h"
 #include "util.h"
 
 /**
@@ -24,6 +25,12 @@ int32_t msg48(sdo_prot_t *ps)
 {
 	int ret = -1;
 
+	/* A module callback still running from msg49 may have failed */
+	if (!sdo_osi_async_status(ps->sv_info_mod_list_head, NULL)) {
+		LOG(LOG_ERROR, "Sv_info: OSI did not finish gracefully!\n");
+		goto err;
+	}
+
 	/* send entry number to load */
 	sdow_next_block(&ps->sdow, SDO_TO2_GET_NEXT_OWNER_SERVICE_INFO);
 	sdow_begin_object(&ps->sdow);
@@ -89,7 +89,7 @@ int32_t msg49(sdo_prot_t *ps)
 		 * 1. Fill OSI KV data structure
 		 * 2. Make appropriate module callback's
 		 */
-		sdo_sdk_si_key_value osiKV;
+		sdo_sdk_si_kv_view osiKV;
 
 		if (!sdo_osi_parsing(&ps->sdor, ps->sv_info_mod_list_head,
 				     &osiKV, &mod_ret_val)) {
@@ -11,6 +11,7 @@
 #include "sdoCrypto.h"
 #include "load_credentials.h"
 #include "sdoprot.h"
+#include "sdoosi.h"
 #include "util.h"
 
 #define REUSE_HMAC_MAX_LEN 1
@@ -34,6 +35,12 @@ int32_t msg50(sdo_prot_t *ps)
 
 	LOG(LOG_DEBUG, "SDO_STATE_TO2_SND_DONE: Starting\n");
 
+	/* All owner service info must be in place before TO2.Done */
+	if (!sdo_osi_async_join(ps->sv_info_mod_list_head, NULL)) {
+		LOG(LOG_ERROR, "Sv_info: OSI did not finish gracefully!\n");
+		goto err;
+	}
+
 	/* Check if REUSE is ON */
 	if (sdo_compare_public_keys(ps->owner_public_key, ps->new_pk) &&
 	    sdo_compare_byte_arrays(ps->dev_cred->owner_blk->guid, new_guid) &&
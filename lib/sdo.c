@@ -15,6 +15,7 @@
 #include "network_al.h"
 #include "sdoprotctx.h"
 #include "sdonet.h"
+#include "sdobackoff.h"
 #include "sdoprot.h"
 #include "load_credentials.h"
 #include "network_al.h"
@@ -24,6 +25,13 @@
 #include <unistd.h>
 #include "safe_lib.h"
 #include "sdodeviceinfo.h"
+#include "sdocheckpoint.h"
+#include "sdoosi.h"
+#include "sdodsi.h"
+#include "platform_utils.h"
+#include "sdoctx.h"
+#include "sdolog.h"
+#include "sdoheap.h"
 
 #define HTTPS_TAG "https"
 
@@ -40,32 +48,55 @@ typedef struct app_data_s {
 	/* Temp, use the value in the configured rendezvous */
 	sdo_ip_address_t *rendezvousIPAddr;
 	char *rendezvousdns;
-	uint32_t delaysec;
+	/* Backoff state of the DI/TO1/TO2 error recovery */
+	sdo_backoff_t di_backoff;
+	sdo_backoff_t to1_backoff;
+	sdo_backoff_t to2_backoff;
+	/* TO2 is resumed from a checkpoint */
+	bool to2_resume;
 	/* Error handling callback */
 	sdo_sdk_errorCB error_callback;
 	/* Global Sv_info Module_list head pointer */
 	sdo_sdk_service_info_module_list_t *module_list;
+	/* Protocol run in progress and the state handling its outcome */
+	sdo_prot_ctx_t *prot_ctx;
+	bool (*done_fn)(int result);
+	/* Manufacturer address of the DI run in progress */
+	sdo_ip_address_t *mfg_ip;
+	char *mfg_dns;
+	/* Recovery delay before state_fn runs, ends at wake_ms */
+	bool waiting;
+	uint64_t wake_ms;
+	/* Session opened by sdo_sdk_start() */
+	bool started;
+	bool stepping;
+	bool cancel;
+	sdo_sdk_status status;
 } app_data_t;
 
-/* Globals */
-static app_data_t *g_sdo_data;
 extern int g_argc;
 extern char **g_argv;
 
 static bool _STATE_DI(void);
+static bool _STATE_DI_Done(int result);
 static bool _STATE_TO1(void);
+static bool _STATE_TO1_Done(int result);
 static bool _STATE_TO2(void);
+static bool _STATE_TO2_Done(int result);
 static bool _STATE_Error(void);
 static bool _STATE_Shutdown(void);
 static bool _STATE_Shutdown_Error(void);
 
 static sdo_sdk_status app_initialize(void);
 static void app_close(void);
+static void sdo_protDIExit(app_data_t *app_data);
+static void sdo_protTO1Exit(app_data_t *app_data);
+static void sdo_protTO2Exit(app_data_t *app_data);
 
 #define ERROR()                                                                \
 	{                                                                      \
-		g_sdo_data->err = __LINE__;                                    \
-		g_sdo_data->state_fn = &_STATE_Error;                          \
+		ctx->sdo_data->err = __LINE__;                                 \
+		ctx->sdo_data->state_fn = &_STATE_Error;                       \
 	}
 
 /**
@@ -85,40 +116,225 @@ static void app_close(void);
  */
 sdo_sdk_status sdo_sdk_run(void)
 {
-	sdo_sdk_status ret = SDO_ERROR;
+	sdo_sdk_wait wait;
+	sdo_sdk_status ret;
 
-	if (!g_sdo_data) {
+	ret = sdo_sdk_start();
+	if (ret != SDO_SUCCESS)
+		return ret;
+
+	while ((ret = sdo_sdk_step(&wait)) == SDO_IN_PROGRESS)
+		(void)sdo_con_wait(wait.fd, wait.events, wait.timeout_ms);
+
+	return ret;
+}
+
+/**
+ * Internal API
+ * Close the session, as sdo_sdk_run() does when it returns.
+ */
+static void app_end(void)
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+
+	app_close();
+	/* This should be moved to sdo_sdk_exit when its available */
+	sdo_free(ctx->sdo_data);
+}
+
+/**
+ * Internal API
+ * Abandon the session: close the connection of the protocol run in
+ * progress and release what the protocols and the session hold. A TO2
+ * checkpoint is kept, so the next session resumes from it.
+ */
+static void app_abandon(void)
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+
+	if (ctx->sdo_data->prot_ctx) {
+		sdo_prot_ctx_free(ctx->sdo_data->prot_ctx);
+		sdo_protDIExit(ctx->sdo_data);
+		sdo_protTO1Exit(ctx->sdo_data);
+		sdo_protTO2Exit(ctx->sdo_data);
+		sdo_free(ctx->sdo_data->mfg_ip);
+		sdo_free(ctx->sdo_data->mfg_dns);
+	}
+	(void)_STATE_Shutdown();
+	LOG(LOG_INFO, "Secure Device Onboarding cancelled.\n");
+	app_end();
+}
+
+/**
+ * Internal API
+ * Hand a protocol run over to sdo_sdk_step(); done_fn gets its result.
+ */
+static void app_run_prot(sdo_prot_ctx_t *prot_ctx, bool (*done_fn)(int))
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+
+	ctx->sdo_data->prot_ctx = prot_ctx;
+	ctx->sdo_data->done_fn = done_fn;
+}
+
+/**
+ * Internal API
+ * Run the state machine again once the next backoff delay of a retry site
+ * has passed.
+ *
+ * @return true if another attempt is allowed, false if the site gave up.
+ */
+static bool app_backoff(sdo_backoff_t *bo)
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+	uint32_t delay_ms = 0;
+
+	if (!sdo_backoff_next(bo, &delay_ms))
+		return false;
+
+	ctx->sdo_data->wake_ms = sdo_get_time_ms() + delay_ms;
+	ctx->sdo_data->waiting = true;
+	return true;
+}
+
+/**
+ * Start device ownership transfer without blocking. Does what sdo_sdk_run()
+ * does first and leaves the rest to sdo_sdk_step().
+ * sdo_sdk_init should be called before calling this function
+ *
+ * @return
+ *        SDO_SUCCESS if the session started, then sdo_sdk_step() must be
+ * called until it returns something else than SDO_IN_PROGRESS. Any other
+ * value means the session is over, with the result sdo_sdk_run() would have
+ * returned.
+ */
+sdo_sdk_status sdo_sdk_start(void)
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+
+	if (!ctx->sdo_data) {
 		LOG(LOG_ERROR,
 		    "sdo_sdk not initialized. Call sdo_sdk_init first\n");
-		goto end;
+		return SDO_ERROR;
+	}
+
+	if (ctx->sdo_data->started) {
+		LOG(LOG_ERROR, "sdo_sdk already started\n");
+		return SDO_ERROR;
 	}
 
 	if (SDO_SUCCESS != app_initialize()) {
-		goto end;
+		app_end();
+		return SDO_ERROR;
 	}
 
-	/* Loop until last state has been reached */
-	while (1) {
+	ctx->sdo_data->prot_ctx = NULL;
+	ctx->sdo_data->waiting = false;
+	ctx->sdo_data->cancel = false;
+	ctx->sdo_data->status = SDO_ERROR;
+	ctx->sdo_data->started = true;
+	return SDO_SUCCESS;
+}
+
+/**
+ * Advance the session started by sdo_sdk_start() as far as it goes without
+ * waiting for the network or a retry delay. Messages are built and
+ * processed within the step; name resolution and TLS connections still
+ * block.
+ *
+ * @param wait - out, when SDO_IN_PROGRESS is returned: step again once
+ * wait->fd (if not -1) is ready for wait->events, or wait->timeout_ms (if
+ * not -1) milliseconds have passed, whichever comes first.
+ * @return
+ *        SDO_IN_PROGRESS while the session goes on. Otherwise the session is
+ * over and the return value is what sdo_sdk_run() would have returned, or
+ * SDO_ABORT if it was cancelled.
+ */
+sdo_sdk_status sdo_sdk_step(sdo_sdk_wait *wait)
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+	sdo_prot_ctx_t *prot_ctx;
+	sdo_sdk_status ret = SDO_IN_PROGRESS;
+	uint64_t now;
+	int result;
+
+	if (!wait || !ctx->sdo_data || !ctx->sdo_data->started) {
+		LOG(LOG_ERROR, "sdo_sdk not started. Call sdo_sdk_start first\n");
+		return SDO_ERROR;
+	}
+
+	ctx->sdo_data->stepping = true;
+	while (ret == SDO_IN_PROGRESS && !ctx->sdo_data->cancel) {
+		prot_ctx = ctx->sdo_data->prot_ctx;
+		if (prot_ctx) {
+			result = sdo_prot_ctx_step(prot_ctx, wait);
+			if (result > 0)
+				break;
+			ctx->sdo_data->prot_ctx = NULL;
+			sdo_prot_ctx_free(prot_ctx);
+			ctx->sdo_data->status = ctx->sdo_data->done_fn(result)
+						 ? SDO_SUCCESS
+						 : SDO_ERROR;
+			continue;
+		}
+
+		if (ctx->sdo_data->waiting) {
+			now = sdo_get_time_ms();
+			if (now < ctx->sdo_data->wake_ms) {
+				wait->fd = -1;
+				wait->events = 0;
+				wait->timeout_ms =
+				    ctx->sdo_data->wake_ms - now > INT32_MAX
+					? INT32_MAX
+					: (int32_t)(ctx->sdo_data->wake_ms -
+						    now);
+				break;
+			}
+			ctx->sdo_data->waiting = false;
+		}
+
 		/* Nothing left to perform in state machine */
-		if (!g_sdo_data->state_fn) {
+		if (!ctx->sdo_data->state_fn) {
+			ret = ctx->sdo_data->status;
 			break;
 		}
 
-		/* Start the state machine */
-		if (true == g_sdo_data->state_fn()) {
-			ret = SDO_SUCCESS;
-		} else {
-			ret = SDO_ERROR;
-		}
+		if (true == ctx->sdo_data->state_fn())
+			ctx->sdo_data->status = SDO_SUCCESS;
+		else
+			ctx->sdo_data->status = SDO_ERROR;
 	}
+	ctx->sdo_data->stepping = false;
 
-end:
-	app_close();
-	/* This should be moved to sdo_sdk_exit when its available */
-	sdo_free(g_sdo_data);
+	if (ctx->sdo_data->cancel) {
+		app_abandon();
+		return SDO_ABORT;
+	}
+	if (ret != SDO_IN_PROGRESS)
+		app_end();
 	return ret;
 }
 
+/**
+ * Cancel the session started by sdo_sdk_start(). Called between steps, the
+ * session is closed right away; called from a callback within a step, the
+ * step closes it and returns SDO_ABORT.
+ *
+ * @return SDO_SUCCESS, or SDO_ERROR if no session is in progress.
+ */
+sdo_sdk_status sdo_sdk_cancel(void)
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+
+	if (!ctx->sdo_data || !ctx->sdo_data->started)
+		return SDO_ERROR;
+
+	ctx->sdo_data->cancel = true;
+	if (!ctx->sdo_data->stepping)
+		app_abandon();
+	return SDO_SUCCESS;
+}
+
 /**
  * Deallocate allocated  memories in DI protocol and exit from DI.
  *
@@ -166,6 +382,9 @@ static void sdo_protTO2Exit(app_data_t *app_data)
 {
 	sdo_prot_t *ps = &app_data->prot;
 
+	sdo_dsi_prefetch_stop(ps->dsi_info);
+	(void)sdo_osi_async_join(ps->sv_info_mod_list_head, NULL);
+
 	if (ps->tls_key != NULL) {
 		sdo_public_key_free(ps->tls_key);
 		ps->tls_key = NULL;
@@ -230,19 +449,21 @@ static void sdo_protTO2Exit(app_data_t *app_data)
  */
 sdo_dev_cred_t *app_alloc_credentials(void)
 {
-	if (!g_sdo_data) {
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+
+	if (!ctx->sdo_data) {
 		return NULL;
 	}
-	if (g_sdo_data->devcred) {
-		sdo_dev_cred_free(g_sdo_data->devcred);
-		sdo_free(g_sdo_data->devcred);
+	if (ctx->sdo_data->devcred) {
+		sdo_dev_cred_free(ctx->sdo_data->devcred);
+		sdo_free(ctx->sdo_data->devcred);
 	}
-	g_sdo_data->devcred = sdo_dev_cred_alloc();
+	ctx->sdo_data->devcred = sdo_dev_cred_alloc();
 
-	if (!g_sdo_data->devcred)
+	if (!ctx->sdo_data->devcred)
 		LOG(LOG_ERROR, "Device Credentials allocation failed !!");
 
-	return g_sdo_data->devcred;
+	return ctx->sdo_data->devcred;
 }
 
 /**
@@ -255,7 +476,9 @@ sdo_dev_cred_t *app_alloc_credentials(void)
  */
 sdo_dev_cred_t *app_get_credentials(void)
 {
-	return g_sdo_data->devcred;
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+
+	return ctx->sdo_data->devcred;
 }
 
 /**
@@ -263,28 +486,33 @@ sdo_dev_cred_t *app_get_credentials(void)
  */
 static sdo_sdk_status app_initialize(void)
 {
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
 	int ret = SDO_ERROR;
 
-	if (!g_sdo_data)
+	if (!ctx->sdo_data)
 		return SDO_ERROR;
 
 	/* Initialize service_info to NULL in case of early error. */
-	g_sdo_data->service_info = NULL;
+	ctx->sdo_data->service_info = NULL;
 
 /* Enable/Disable Error Recovery */
 #ifdef RETRY_FALSE
-	g_sdo_data->error_recovery = false;
+	ctx->sdo_data->error_recovery = false;
 #else
-	g_sdo_data->error_recovery = true;
+	ctx->sdo_data->error_recovery = true;
 #endif
-	g_sdo_data->recovery_enabled = false;
-	g_sdo_data->state_fn = &_STATE_TO1;
-	if (memset_s(&g_sdo_data->prot, sizeof(sdo_prot_t), 0) != 0) {
+	ctx->sdo_data->recovery_enabled = false;
+	ctx->sdo_data->state_fn = &_STATE_TO1;
+	sdo_backoff_init(&ctx->sdo_data->di_backoff, SDO_RETRY_DI);
+	sdo_backoff_init(&ctx->sdo_data->to1_backoff, SDO_RETRY_TO1);
+	sdo_backoff_init(&ctx->sdo_data->to2_backoff, SDO_RETRY_TO2);
+	sdo_backoff_budget_start();
+	if (memset_s(&ctx->sdo_data->prot, sizeof(sdo_prot_t), 0) != 0) {
 		LOG(LOG_ERROR, "Memset Failed\n");
 		return SDO_ERROR;
 	}
 
-	g_sdo_data->err = 0;
+	ctx->sdo_data->err = 0;
 
 #ifdef CLI
 	/* Process command line input. */
@@ -294,90 +522,104 @@ static sdo_sdk_status app_initialize(void)
 	}
 #endif
 
-	if (!sdow_init(&g_sdo_data->prot.sdow)) {
+	if (!sdow_init(&ctx->sdo_data->prot.sdow)) {
 		LOG(LOG_ERROR, "sdow_init() failed!\n");
 		return SDO_ERROR;
 	}
-	if (!sdor_init(&g_sdo_data->prot.sdor, NULL, NULL)) {
+	if (!sdor_init(&ctx->sdo_data->prot.sdor, NULL, NULL)) {
 		LOG(LOG_ERROR, "sdor_init() failed!\n");
 		return SDO_ERROR;
 	}
 
-	if ((g_sdo_data->devcred->ST == SDO_DEVICE_STATE_READY1) ||
-	    (g_sdo_data->devcred->ST == SDO_DEVICE_STATE_READYN)) {
+	if ((ctx->sdo_data->devcred->ST == SDO_DEVICE_STATE_READY1) ||
+	    (ctx->sdo_data->devcred->ST == SDO_DEVICE_STATE_READYN)) {
 		ret = load_mfg_secret();
 		if (ret)
 			return SDO_ERROR;
 	}
 
 	// Read HMAC & MFG only if it is T01/T02.
-	if (g_sdo_data->devcred->ST == SDO_DEVICE_STATE_PC) {
-		g_sdo_data->state_fn = &_STATE_DI;
+	if (ctx->sdo_data->devcred->ST == SDO_DEVICE_STATE_PC) {
+		ctx->sdo_data->state_fn = &_STATE_DI;
 #ifndef NO_PERSISTENT_STORAGE
 		return 0;
 #endif
 	}
 
-	if (g_sdo_data->devcred->ST == SDO_DEVICE_STATE_IDLE) {
+	if (ctx->sdo_data->devcred->ST == SDO_DEVICE_STATE_IDLE) {
 		LOG(LOG_INFO,
 		    "SDO in Idle State. Device Onboarding already complete\n");
-		g_sdo_data->state_fn = &_STATE_Shutdown;
+		ctx->sdo_data->state_fn = &_STATE_Shutdown;
 		return SDO_SUCCESS;
 	}
 
 	/* Build up a test service info list */
 	char *get_modules = NULL;
 
-	g_sdo_data->service_info = sdo_service_info_alloc();
+	ctx->sdo_data->service_info = sdo_service_info_alloc();
 
-	if (!g_sdo_data->service_info) {
+	if (!ctx->sdo_data->service_info) {
 		LOG(LOG_ERROR, "Service_info List allocation failed!\n");
 		return SDO_ERROR;
 	}
 
-	sdo_service_info_add_kv_str(g_sdo_data->service_info, "sdodev:os",
+	sdo_service_info_add_kv_str(ctx->sdo_data->service_info, "sdodev:os",
 				    OS_NAME);
-	sdo_service_info_add_kv_str(g_sdo_data->service_info, "sdodev:arch",
+	sdo_service_info_add_kv_str(ctx->sdo_data->service_info, "sdodev:arch",
 				    ARCH);
-	sdo_service_info_add_kv_str(g_sdo_data->service_info, "sdodev:version",
-				    OS_VERSION);
-	sdo_service_info_add_kv_str(g_sdo_data->service_info, "sdodev:device",
+	sdo_service_info_add_kv_str(ctx->sdo_data->service_info,
+				    "sdodev:version", OS_VERSION);
+	sdo_service_info_add_kv_str(ctx->sdo_data->service_info,
+				    "sdodev:device",
 				    (char *)get_device_model());
-	sdo_service_info_add_kv_str(g_sdo_data->service_info, "sdodev:sn",
+	sdo_service_info_add_kv_str(ctx->sdo_data->service_info, "sdodev:sn",
 				    (char *)get_device_serial_number());
-	sdo_service_info_add_kv_str(g_sdo_data->service_info, "sdodev:sep",
+	sdo_service_info_add_kv_str(ctx->sdo_data->service_info, "sdodev:sep",
 				    SEPARATOR);
-	sdo_service_info_add_kv_str(g_sdo_data->service_info, "sdodev:bin",
+	sdo_service_info_add_kv_str(ctx->sdo_data->service_info, "sdodev:bin",
 				    BIN_TYPE);
-	if (g_sdo_data->devcred->mfg_blk && g_sdo_data->devcred->mfg_blk->cu &&
-	    g_sdo_data->devcred->mfg_blk->cu->byte_sz)
+	if (ctx->sdo_data->devcred->mfg_blk &&
+	    ctx->sdo_data->devcred->mfg_blk->cu &&
+	    ctx->sdo_data->devcred->mfg_blk->cu->byte_sz)
 		sdo_service_info_add_kv_str(
-		    g_sdo_data->service_info, "sdodev:cu",
-		    g_sdo_data->devcred->mfg_blk->cu->bytes);
+		    ctx->sdo_data->service_info, "sdodev:cu",
+		    ctx->sdo_data->devcred->mfg_blk->cu->bytes);
 	else
-		sdo_service_info_add_kv_str(g_sdo_data->service_info,
+		sdo_service_info_add_kv_str(ctx->sdo_data->service_info,
 					    "sdodev:cu", "");
 
-	if (g_sdo_data->devcred->mfg_blk && g_sdo_data->devcred->mfg_blk->ch &&
-	    g_sdo_data->devcred->mfg_blk->ch->hash->byte_sz)
+	if (ctx->sdo_data->devcred->mfg_blk &&
+	    ctx->sdo_data->devcred->mfg_blk->ch &&
+	    ctx->sdo_data->devcred->mfg_blk->ch->hash->byte_sz)
 		sdo_service_info_add_kv(
-		    g_sdo_data->service_info,
+		    ctx->sdo_data->service_info,
 		    sdo_kv_alloc_with_array(
-			"sdodev:ch", g_sdo_data->devcred->mfg_blk->ch->hash));
+			"sdodev:ch",
+			ctx->sdo_data->devcred->mfg_blk->ch->hash));
 	else
-		sdo_service_info_add_kv_str(g_sdo_data->service_info,
+		sdo_service_info_add_kv_str(ctx->sdo_data->service_info,
 					    "sdodev:ch", "");
 
-	if (sdo_construct_module_list(g_sdo_data->module_list, &get_modules)) {
-		sdo_service_info_add_kv_str(g_sdo_data->service_info,
+	if (sdo_construct_module_list(ctx->sdo_data->module_list,
+				      &get_modules)) {
+		sdo_service_info_add_kv_str(ctx->sdo_data->service_info,
 					    "sdodev:modules", get_modules);
 		sdo_free(get_modules);
 	}
 
-	if (sdo_null_ipaddress(&g_sdo_data->prot.i1) == false) {
+	if (sdo_null_ipaddress(&ctx->sdo_data->prot.i1) == false) {
 		return SDO_ERROR;
 	}
 
+	/* Pick up a TO2 interrupted by a restart where it left off */
+	ctx->sdo_data->to2_resume = false;
+	if (ctx->sdo_data->devcred->owner_blk &&
+	    sdo_to2_checkpoint_load(ctx->sdo_data->devcred->owner_blk->guid)) {
+		LOG(LOG_INFO, "Found TO2 checkpoint, skipping TO1\n");
+		ctx->sdo_data->to2_resume = true;
+		ctx->sdo_data->state_fn = &_STATE_TO2;
+	}
+
 	return SDO_SUCCESS;
 }
 
@@ -395,20 +637,21 @@ static sdo_sdk_status app_initialize(void)
  */
 sdo_sdk_device_state sdo_sdk_get_status(void)
 {
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
 	sdo_sdk_device_state status = SDO_STATE_ERROR;
 
-	if (g_sdo_data == NULL)
+	if (ctx->sdo_data == NULL)
 		return SDO_STATE_ERROR;
 
-	g_sdo_data->err = 0;
+	ctx->sdo_data->err = 0;
 
-	if (g_sdo_data->devcred->ST == SDO_DEVICE_STATE_PC) {
+	if (ctx->sdo_data->devcred->ST == SDO_DEVICE_STATE_PC) {
 		status = SDO_STATE_PRE_DI;
-	} else if (g_sdo_data->devcred->ST == SDO_DEVICE_STATE_READY1) {
+	} else if (ctx->sdo_data->devcred->ST == SDO_DEVICE_STATE_READY1) {
 		status = SDO_STATE_PRE_TO1;
-	} else if (g_sdo_data->devcred->ST == SDO_DEVICE_STATE_IDLE) {
+	} else if (ctx->sdo_data->devcred->ST == SDO_DEVICE_STATE_IDLE) {
 		status = SDO_STATE_IDLE;
-	} else if (g_sdo_data->devcred->ST == SDO_DEVICE_STATE_READYN) {
+	} else if (ctx->sdo_data->devcred->ST == SDO_DEVICE_STATE_READYN) {
 		status = SDO_STATE_RESALE;
 	}
 
@@ -430,6 +673,8 @@ sdo_sdk_device_state sdo_sdk_get_status(void)
 
 void sdo_sdk_service_info_register_module(sdo_sdk_service_info_module *module)
 {
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+
 	if (module == NULL)
 		return;
 
@@ -448,18 +693,22 @@ void sdo_sdk_service_info_register_module(sdo_sdk_service_info_module *module)
 		return;
 	}
 
-	if (g_sdo_data->module_list == NULL) {
+	if (ctx->sdo_data->module_list == NULL) {
 		// 1st module to register
-		g_sdo_data->module_list = new;
+		ctx->sdo_data->module_list = new;
 	} else {
 		sdo_sdk_service_info_module_list_t *list =
-		    g_sdo_data->module_list;
+		    ctx->sdo_data->module_list;
 
 		while (list->next != NULL)
 			list = list->next;
 
 		list->next = new;
 	}
+
+	/* Registered after sdo_sdk_init(): keep the index complete */
+	if (ctx->sdo_data->module_list->index)
+		(void)sdo_sv_info_index_build(ctx->sdo_data->module_list);
 }
 
 static sdo_sdk_service_info_module_list_t *
@@ -487,20 +736,27 @@ clear_modules_list(sdo_sdk_service_info_module_list_t *head)
 
 void sdo_sdk_service_info_deregister_module(void)
 {
-	sdo_sdk_service_info_module_list_t *list = g_sdo_data->module_list;
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+	sdo_sdk_service_info_module_list_t *list = ctx->sdo_data->module_list;
 	if (list) {
-		g_sdo_data->module_list = clear_modules_list(list);
+		sdo_sv_info_index_free(list);
+		ctx->sdo_data->module_list = clear_modules_list(list);
 	}
 }
 
 void sdo_sdk_deinit(void)
 {
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+
 	(void)sdo_crypto_close();
 
 	app_close();
-	if (g_sdo_data) {
-		sdo_free(g_sdo_data);
+	platform_keyring_close();
+	if (ctx->sdo_data) {
+		sdo_free(ctx->sdo_data);
 	}
+	sdo_heap_leak_report();
+	sdo_log_flush();
 }
 
 /**
@@ -523,17 +779,20 @@ sdo_sdk_status sdo_sdk_init(sdo_sdk_errorCB error_handling_callback,
 			    uint32_t num_modules,
 			    sdo_sdk_service_info_module *module_information)
 {
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
 	int ret;
 
+	sdo_heap_session_start();
+
 	/* sdo Global data initialization */
-	g_sdo_data = sdo_alloc(sizeof(app_data_t));
+	ctx->sdo_data = sdo_alloc(sizeof(app_data_t));
 
-	if (!g_sdo_data) {
+	if (!ctx->sdo_data) {
 		LOG(LOG_ERROR, "malloc failed to alloc app_data_t\n");
 		return SDO_ERROR;
 	}
 
-	g_sdo_data->err = 0;
+	ctx->sdo_data->err = 0;
 
 	/* Initialize Crypto services */
 	if (0 != sdo_crypto_init()) {
@@ -541,13 +800,19 @@ sdo_sdk_status sdo_sdk_init(sdo_sdk_errorCB error_handling_callback,
 		return SDO_ERROR;
 	}
 
+	/* Platform keys stay in memory until sdo_sdk_deinit() */
+	if (!platform_keyring_init()) {
+		LOG(LOG_ERROR, "platform_keyring_init failed!!\n");
+		return SDO_ERROR;
+	}
+
 	sdo_net_init();
 
-	if (!sdow_init(&g_sdo_data->prot.sdow)) {
+	if (!sdow_init(&ctx->sdo_data->prot.sdow)) {
 		LOG(LOG_ERROR, "sdow_init() failed!\n");
 		return SDO_ERROR;
 	}
-	if (!sdor_init(&g_sdo_data->prot.sdor, NULL, NULL)) {
+	if (!sdor_init(&ctx->sdo_data->prot.sdor, NULL, NULL)) {
 		LOG(LOG_ERROR, "sdor_init() failed!\n");
 		return SDO_ERROR;
 	}
@@ -560,9 +825,10 @@ sdo_sdk_status sdo_sdk_init(sdo_sdk_errorCB error_handling_callback,
 	}
 
 #ifdef MODULES_ENABLED
-	if ((num_modules == 0) || (num_modules > SDO_MAX_MODULES) ||
+	if ((num_modules == 0) || (num_modules > SDO_SDK_MAX_MODULES) ||
 	    (module_information == NULL) ||
-	    (module_information->service_info_callback == NULL))
+	    (module_information->service_info_callback == NULL &&
+	     module_information->service_info_callback_v2 == NULL))
 		return SDO_ERROR;
 
 	/* register service-info modules */
@@ -571,13 +837,17 @@ sdo_sdk_status sdo_sdk_init(sdo_sdk_errorCB error_handling_callback,
 			sdo_sdk_service_info_register_module(
 			    &module_information[i]);
 	}
+
+	/* PSI and OSI find their module by name from now on */
+	if (!sdo_sv_info_index_build(ctx->sdo_data->module_list))
+		LOG(LOG_ERROR, "Sv_info: modules are not indexed\n");
 #else
 	(void)num_modules;
 	(void)module_information;
 #endif
 
 	/* Get the callback from user */
-	g_sdo_data->error_callback = error_handling_callback;
+	ctx->sdo_data->error_callback = error_handling_callback;
 
 	return SDO_SUCCESS;
 }
@@ -588,7 +858,8 @@ sdo_sdk_status sdo_sdk_init(sdo_sdk_errorCB error_handling_callback,
  */
 void print_service_info_module_list(void)
 {
-	sdo_sdk_service_info_module_list_t *list = g_sdo_data->module_list;
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+	sdo_sdk_service_info_module_list_t *list = ctx->sdo_data->module_list;
 
 	if (list) {
 		while (list != NULL) {
@@ -612,6 +883,7 @@ void print_service_info_module_list(void)
  */
 sdo_sdk_status sdo_sdk_resale(void)
 {
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
 	int ret;
 	sdo_sdk_status r = SDO_ERROR;
 
@@ -619,21 +891,21 @@ sdo_sdk_status sdo_sdk_resale(void)
 	return SDO_RESALE_NOT_SUPPORTED;
 #endif
 
-	if (!g_sdo_data)
+	if (!ctx->sdo_data)
 		return SDO_ERROR;
 
-	if (!g_sdo_data->devcred)
+	if (!ctx->sdo_data->devcred)
 		return SDO_ERROR;
 
-	if (g_sdo_data->devcred->ST == SDO_DEVICE_STATE_IDLE) {
-		g_sdo_data->devcred->ST = SDO_DEVICE_STATE_READYN;
+	if (ctx->sdo_data->devcred->ST == SDO_DEVICE_STATE_IDLE) {
+		ctx->sdo_data->devcred->ST = SDO_DEVICE_STATE_READYN;
 
 		if (load_mfg_secret()) {
 			LOG(LOG_ERROR, "Reading {Mfg|Secret} blob failied!\n");
 			return SDO_ERROR;
 		}
 
-		ret = store_credential(g_sdo_data->devcred);
+		ret = store_credential(ctx->sdo_data->devcred);
 		if (!ret) {
 			LOG(LOG_INFO, "Set Resale complete\n");
 			r = SDO_SUCCESS;
@@ -647,14 +919,14 @@ sdo_sdk_status sdo_sdk_resale(void)
 	} else if (r == SDO_RESALE_NOT_READY) {
 		LOG(LOG_DEBUG, "Device is not ready for Resale\n");
 	}
-	if (g_sdo_data->devcred) {
-		sdo_dev_cred_free(g_sdo_data->devcred);
-		sdo_free(g_sdo_data->devcred);
-		g_sdo_data->devcred = NULL;
+	if (ctx->sdo_data->devcred) {
+		sdo_dev_cred_free(ctx->sdo_data->devcred);
+		sdo_free(ctx->sdo_data->devcred);
+		ctx->sdo_data->devcred = NULL;
 	}
 
-	sdo_free(g_sdo_data);
-	g_sdo_data = NULL;
+	sdo_free(ctx->sdo_data);
+	ctx->sdo_data = NULL;
 	return r;
 }
 
@@ -663,36 +935,39 @@ sdo_sdk_status sdo_sdk_resale(void)
  */
 static void app_close(void)
 {
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
 	sdo_block_t *sdob;
 
-	if (!g_sdo_data)
+	if (!ctx->sdo_data)
 		return;
 
+	sdo_kex_precompute_discard();
+	sdo_device_sign_precompute_clear();
 	sdo_kex_close();
 
-	if (g_sdo_data->service_info) {
-		sdo_service_info_free(g_sdo_data->service_info);
-		g_sdo_data->service_info = NULL;
+	if (ctx->sdo_data->service_info) {
+		sdo_service_info_free(ctx->sdo_data->service_info);
+		ctx->sdo_data->service_info = NULL;
 	}
 
 	sdo_sdk_service_info_deregister_module();
 
-	sdob = &g_sdo_data->prot.sdor.b;
+	sdob = &ctx->sdo_data->prot.sdor.b;
 	if (sdob->block) {
 		sdo_free(sdob->block);
 		sdob->block = NULL;
 	}
 
-	sdob = &g_sdo_data->prot.sdow.b;
+	sdob = &ctx->sdo_data->prot.sdow.b;
 	if (sdob->block) {
 		sdo_free(sdob->block);
 		sdob->block = NULL;
 	}
 
-	if (g_sdo_data->devcred) {
-		sdo_dev_cred_free(g_sdo_data->devcred);
-		sdo_free(g_sdo_data->devcred);
-		g_sdo_data->devcred = NULL;
+	if (ctx->sdo_data->devcred) {
+		sdo_dev_cred_free(ctx->sdo_data->devcred);
+		sdo_free(ctx->sdo_data->devcred);
+		ctx->sdo_data->devcred = NULL;
 	}
 
 }
@@ -708,9 +983,9 @@ static const uint16_t g_DI_PORT = 8039;
  */
 static bool _STATE_DI(void)
 {
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
 	bool ret = false;
 	sdo_prot_ctx_t *prot_ctx = NULL;
-	sdo_sdk_status status = SDO_SUCCESS;
 	uint16_t di_port = g_DI_PORT;
 
 	LOG(LOG_DEBUG, "\n-------------------------------------------"
@@ -724,7 +999,7 @@ static bool _STATE_DI(void)
 		       "-------------------------------------------"
 		       "-------------------------------------------\n");
 
-	sdo_prot_di_init(&g_sdo_data->prot, g_sdo_data->devcred);
+	sdo_prot_di_init(&ctx->sdo_data->prot, ctx->sdo_data->devcred);
 
 	sdo_ip_address_t *manIPAddr = NULL;
 
@@ -870,37 +1145,69 @@ static bool _STATE_DI(void)
 
 	LOG(LOG_DEBUG, "Manufacturer Port = %d.\n", di_port);
 
-	prot_ctx = sdo_prot_ctx_alloc(sdo_process_states, &g_sdo_data->prot,
+	prot_ctx = sdo_prot_ctx_alloc(sdo_process_states, &ctx->sdo_data->prot,
 				      manIPAddr, mfg_dns, di_port, false);
 	if (prot_ctx == NULL) {
 		ERROR();
 		goto end;
 	}
 
-	if (sdo_prot_ctx_run(prot_ctx) != 0) {
+	/* The address is in use until the run completes */
+	ctx->sdo_data->mfg_ip = manIPAddr;
+	ctx->sdo_data->mfg_dns = mfg_dns;
+	app_run_prot(prot_ctx, &_STATE_DI_Done);
+	return true;
+
+end:
+	sdo_protDIExit(ctx->sdo_data);
+	sdo_free(manIPAddr);
+	sdo_free(mfg_dns);
+	return ret;
+}
+
+/**
+ * Handles the outcome of the DI protocol run started by _STATE_DI().
+ *
+ * @param result
+ *         0 if the DI protocol run completed, -1 otherwise.
+ * @return ret
+ *         true if DI completes successfully. false in case of error.
+ */
+static bool _STATE_DI_Done(int result)
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+	bool ret = false;
+	sdo_sdk_status status = SDO_SUCCESS;
+
+	if (result != 0) {
 		LOG(LOG_ERROR, "DI failed.\n");
-		if (g_sdo_data->error_recovery) {
+		if (ctx->sdo_data->error_recovery) {
 			LOG(LOG_INFO, "Retrying,.....\n");
-			g_sdo_data->state_fn = &_STATE_DI;
-			if (g_sdo_data->error_callback) {
-				status = g_sdo_data->error_callback(
+			ctx->sdo_data->state_fn = &_STATE_DI;
+			if (ctx->sdo_data->error_callback) {
+				status = ctx->sdo_data->error_callback(
 				    SDO_WARNING, SDO_DI_ERROR);
 
 				if (status == SDO_ABORT) {
-					g_sdo_data->error_recovery = false;
-					g_sdo_data->recovery_enabled = false;
+					ctx->sdo_data->error_recovery = false;
+					ctx->sdo_data->recovery_enabled = false;
 					ERROR();
 					/* Aborting the state machine */
 					goto end;
 				}
 			}
-			sdo_sleep(3); /* Sleep and retry */
+			/* Wait and retry */
+			if (!app_backoff(&ctx->sdo_data->di_backoff)) {
+				ctx->sdo_data->error_recovery = false;
+				ctx->sdo_data->recovery_enabled = false;
+				ERROR();
+			}
 			goto end;
 		} else {
 			ERROR()
-			sdo_sleep(g_sdo_data->delaysec + sdo_random() % 25);
-			if (g_sdo_data->error_callback)
-				status = g_sdo_data->error_callback(
+			(void)app_backoff(&ctx->sdo_data->di_backoff);
+			if (ctx->sdo_data->error_callback)
+				status = ctx->sdo_data->error_callback(
 				    SDO_ERROR, SDO_DI_ERROR);
 			goto end;
 		}
@@ -908,19 +1215,20 @@ static bool _STATE_DI(void)
 
 	LOG(LOG_DEBUG, "\n------------------------------------ DI Successful "
 		       "--------------------------------------\n");
+	sdo_backoff_init(&ctx->sdo_data->di_backoff, SDO_RETRY_DI);
 
 #ifdef NO_PERSISTENT_STORAGE
-	g_sdo_data->state_fn = &_STATE_TO1;
-	sdo_sleep(5);
+	ctx->sdo_data->state_fn = &_STATE_TO1;
+	ctx->sdo_data->wake_ms = sdo_get_time_ms() + 5000;
+	ctx->sdo_data->waiting = true;
 #else
-	g_sdo_data->state_fn = &_STATE_Shutdown;
+	ctx->sdo_data->state_fn = &_STATE_Shutdown;
 #endif
 	ret = true;
 end:
-	sdo_protDIExit(g_sdo_data);
-	sdo_prot_ctx_free(prot_ctx);
-	sdo_free(manIPAddr);
-	sdo_free(mfg_dns);
+	sdo_protDIExit(ctx->sdo_data);
+	sdo_free(ctx->sdo_data->mfg_ip);
+	sdo_free(ctx->sdo_data->mfg_dns);
 	return ret;
 }
 
@@ -933,10 +1241,10 @@ end:
  */
 static bool _STATE_TO1(void)
 {
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
 	bool ret = false;
 	bool tls = false;
 	sdo_prot_ctx_t *prot_ctx = NULL;
-	sdo_sdk_status status = SDO_SUCCESS;
 
 	LOG(LOG_DEBUG, "\n-------------------------------------------"
 		       "-------------------------------------------"
@@ -949,27 +1257,37 @@ static bool _STATE_TO1(void)
 		       "-------------------------------------------"
 		       "-------------------------------------------\n");
 
-	if (sdo_prot_to1_init(&g_sdo_data->prot, g_sdo_data->devcred)) {
+	if (sdo_prot_to1_init(&ctx->sdo_data->prot, ctx->sdo_data->devcred)) {
 		goto end;
 	}
 
-	sdo_prot_t *ps = &g_sdo_data->prot;
+	/*
+	 * TO2 follows a successful TO1, so generate the device key share for
+	 * msg44, and then the device signatures, while TO1 and the rendezvous
+	 * delay are in progress. The share is kept across TO1 retries and
+	 * consumed by sdo_kex_init().
+	 */
+	if (sdo_kex_precompute_start())
+		LOG(LOG_DEBUG, "Key share will be generated at TO2 start\n");
+
+	sdo_prot_t *ps = &ctx->sdo_data->prot;
 
 	// check for rendezvous list
-	if (!g_sdo_data->devcred->owner_blk->rvlst ||
-	    g_sdo_data->devcred->owner_blk->rvlst->num_entries == 0) {
+	if (!ctx->sdo_data->devcred->owner_blk->rvlst ||
+	    ctx->sdo_data->devcred->owner_blk->rvlst->num_entries == 0) {
 		LOG(LOG_ERROR, "Stored Rendezvous_list is empty!!\n");
 		ERROR();
 		goto end;
 	}
 
 	ps->rv_index = ps->rv_index + 1;
-	if (ps->rv_index > g_sdo_data->devcred->owner_blk->rvlst->num_entries)
+	if (ps->rv_index >
+	    ctx->sdo_data->devcred->owner_blk->rvlst->num_entries)
 		ps->rv_index =
 		    ps->rv_index %
-		    g_sdo_data->devcred->owner_blk->rvlst->num_entries;
+		    ctx->sdo_data->devcred->owner_blk->rvlst->num_entries;
 	sdo_rendezvous_t *rv =
-	    g_sdo_data->devcred->owner_blk->rvlst->rv_entries;
+	    ctx->sdo_data->devcred->owner_blk->rvlst->rv_entries;
 	for (int i = 1; i < ps->rv_index; i++)
 		rv = rv->next;
 
@@ -994,42 +1312,74 @@ static bool _STATE_TO1(void)
 				 &strcmp_result);
 		if (0 == strcmp_result)
 			tls = true;
+
+		/* Honour the delay requested by the rendezvous entry */
+		sdo_backoff_set_floor(&ctx->sdo_data->to1_backoff,
+				      rv->delaysec
+					  ? (uint64_t)*rv->delaysec * 1000
+					  : 0);
 	}
 
 	prot_ctx =
-	    sdo_prot_ctx_alloc(sdo_process_states, &g_sdo_data->prot, rv->ip,
+	    sdo_prot_ctx_alloc(sdo_process_states, &ctx->sdo_data->prot, rv->ip,
 			       rv->dn ? rv->dn->bytes : NULL, *rv->po, tls);
 	if (prot_ctx == NULL) {
 		ERROR();
 		goto end;
 	}
 
-	if (sdo_prot_ctx_run(prot_ctx) != 0) {
+	app_run_prot(prot_ctx, &_STATE_TO1_Done);
+	return true;
+
+end:
+	sdo_protTO1Exit(ctx->sdo_data);
+	return ret;
+}
+
+/**
+ * Handles the outcome of the TO1 protocol run started by _STATE_TO1().
+ *
+ * @param result
+ *         0 if the TO1 protocol run completed, -1 otherwise.
+ * @return ret
+ *         true if TO1 completes successfully. false in case of error.
+ */
+static bool _STATE_TO1_Done(int result)
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+	bool ret = false;
+	sdo_sdk_status status = SDO_SUCCESS;
+
+	if (result != 0) {
 		LOG(LOG_ERROR, "TO1 failed.\n");
-		if (g_sdo_data->error_recovery) {
+		if (ctx->sdo_data->error_recovery) {
 			LOG(LOG_INFO, "Retrying,.....\n");
-			g_sdo_data->state_fn = &_STATE_TO1;
-			if (g_sdo_data->error_callback) {
-				status = g_sdo_data->error_callback(
+			ctx->sdo_data->state_fn = &_STATE_TO1;
+			if (ctx->sdo_data->error_callback) {
+				status = ctx->sdo_data->error_callback(
 				    SDO_WARNING, SDO_TO1_ERROR);
 
 				if (status == SDO_ABORT) {
-					g_sdo_data->error_recovery = false;
-					g_sdo_data->recovery_enabled = false;
+					ctx->sdo_data->error_recovery = false;
+					ctx->sdo_data->recovery_enabled = false;
 					ERROR();
 					goto end;
 				}
 			}
-			sdo_sleep(3);
+			if (!app_backoff(&ctx->sdo_data->to1_backoff)) {
+				ctx->sdo_data->error_recovery = false;
+				ctx->sdo_data->recovery_enabled = false;
+				ERROR();
+			}
 			/* Error recovery is enabled, so, it's not the final
 			 * status
 			 */
 			goto end;
 		} else {
 			ERROR()
-			sdo_sleep(g_sdo_data->delaysec + sdo_random() % 25);
-			if (g_sdo_data->error_callback)
-				status = g_sdo_data->error_callback(
+			(void)app_backoff(&ctx->sdo_data->to1_backoff);
+			if (ctx->sdo_data->error_callback)
+				status = ctx->sdo_data->error_callback(
 				    SDO_ERROR, SDO_TO1_ERROR);
 			goto end;
 		}
@@ -1038,14 +1388,54 @@ static bool _STATE_TO1(void)
 	LOG(LOG_DEBUG, "\n------------------------------------ TO1 Successful "
 		       "--------------------------------------\n");
 
-	g_sdo_data->state_fn = &_STATE_TO2;
+	ctx->sdo_data->state_fn = &_STATE_TO2;
+	sdo_backoff_init(&ctx->sdo_data->to1_backoff, SDO_RETRY_TO1);
 	ret = true;
 end:
-	sdo_protTO1Exit(g_sdo_data);
-	sdo_prot_ctx_free(prot_ctx);
+	sdo_protTO1Exit(ctx->sdo_data);
 	return ret;
 }
 
+/**
+ * Recovery from a failed TO2: discards the TO2 checkpoint and starts over
+ * with TO1 after the TO2 backoff delay, unless error recovery is disabled
+ * or the application aborts.
+ *
+ * @return ret
+ *         false always.
+ */
+static bool to2_failed(void)
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+	sdo_sdk_status status = SDO_SUCCESS;
+
+	sdo_to2_checkpoint_discard();
+	if (ctx->sdo_data->error_recovery) {
+		LOG(LOG_INFO, "Retrying TO2,.....\n");
+		ctx->sdo_data->recovery_enabled = true;
+		ctx->sdo_data->state_fn = &_STATE_TO1;
+		sdo_protTO2Exit(ctx->sdo_data);
+		if (ctx->sdo_data->error_callback)
+			status = ctx->sdo_data->error_callback(SDO_WARNING,
+							    SDO_TO2_ERROR);
+
+		if (status != SDO_ABORT &&
+		    !app_backoff(&ctx->sdo_data->to2_backoff))
+			status = SDO_ABORT;
+	} else {
+		if (ctx->sdo_data->error_callback)
+			status = ctx->sdo_data->error_callback(SDO_ERROR,
+							    SDO_TO2_ERROR);
+	}
+
+	if (status == SDO_ABORT) {
+		ctx->sdo_data->error_recovery = false;
+		ctx->sdo_data->recovery_enabled = false;
+		ERROR();
+	}
+	return false;
+}
+
 /**
  * Handles TO2 state of device. Initializes protocol context engine,
  * initializse state variables and runs the TO2 protocol.
@@ -1055,10 +1445,9 @@ end:
  */
 static bool _STATE_TO2(void)
 {
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
 	sdo_prot_ctx_t *prot_ctx = NULL;
-	sdo_block_t *sdob;
 	bool ret = false;
-	sdo_sdk_status status = SDO_SUCCESS;
 
 	LOG(LOG_DEBUG, "\n-------------------------------------------"
 		       "-------------------------------------------"
@@ -1077,44 +1466,82 @@ static bool _STATE_TO2(void)
 		return SDO_ERROR;
 	}
 
-	if (!sdo_prot_to2_init(&g_sdo_data->prot, g_sdo_data->service_info,
-
-			       g_sdo_data->devcred, g_sdo_data->module_list)) {
+	if (!sdo_prot_to2_init(&ctx->sdo_data->prot,
+			       ctx->sdo_data->service_info,
+			       ctx->sdo_data->devcred,
+			       ctx->sdo_data->module_list)) {
 		LOG(LOG_ERROR, "TO2_Init() failed!\n");
-		goto err;
+		return to2_failed();
+	}
+
+	if (ctx->sdo_data->to2_resume) {
+		ctx->sdo_data->to2_resume = false;
+		if (!sdo_to2_checkpoint_restore(&ctx->sdo_data->prot)) {
+			LOG(LOG_ERROR, "TO2 checkpoint unusable, "
+				       "starting over with TO1\n");
+			sdo_protTO2Exit(ctx->sdo_data);
+			sdo_kex_close();
+			ctx->sdo_data->state_fn = &_STATE_TO1;
+			return true;
+		}
 	}
 
 	prot_ctx = sdo_prot_ctx_alloc(
-	    sdo_process_states, &g_sdo_data->prot, &g_sdo_data->prot.i1,
-	    g_sdo_data->prot.dns1, (uint16_t)g_sdo_data->prot.port1, false);
+	    sdo_process_states, &ctx->sdo_data->prot, &ctx->sdo_data->prot.i1,
+	    ctx->sdo_data->prot.dns1, (uint16_t)ctx->sdo_data->prot.port1,
+	    false);
 	if (prot_ctx == NULL) {
 		ERROR();
-		goto err;
+		return to2_failed();
 	}
 
-	if (sdo_prot_ctx_run(prot_ctx) != 0) {
+	app_run_prot(prot_ctx, &_STATE_TO2_Done);
+	return true;
+}
+
+/**
+ * Handles the outcome of the TO2 protocol run started by _STATE_TO2().
+ *
+ * @param result
+ *         0 if the TO2 protocol run completed, -1 otherwise.
+ * @return ret
+ *         true if TO2 completes successfully. false in case of error.
+ */
+static bool _STATE_TO2_Done(int result)
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+	sdo_block_t *sdob;
+
+	/* No DSI or OSI callback may run past the end of the protocol run */
+	sdo_dsi_prefetch_stop(ctx->sdo_data->prot.dsi_info);
+	(void)sdo_osi_async_join(ctx->sdo_data->prot.sv_info_mod_list_head,
+				 NULL);
+
+	if (result != 0) {
 		ERROR();
-		goto err;
+		return to2_failed();
 	}
 
-	if (g_sdo_data->prot.success == false) {
+	if (ctx->sdo_data->prot.success == false) {
 		ERROR();
 		LOG(LOG_ERROR, "TO2 failed.\n");
 
 		/* Execute Sv_info type=FAILURE */
 		if (!sdo_mod_exec_sv_infotype(
-			g_sdo_data->prot.sv_info_mod_list_head,
+			ctx->sdo_data->prot.sv_info_mod_list_head,
 			SDO_SI_FAILURE)) {
 			LOG(LOG_ERROR, "Sv_info: One or more module's FAILURE "
 				       "CB failed\n");
 		}
 
-		goto err;
+		return to2_failed();
 	}
 
-	g_sdo_data->state_fn = &_STATE_Shutdown;
+	ctx->sdo_data->state_fn = &_STATE_Shutdown;
 
-	sdo_protTO2Exit(g_sdo_data);
+	sdo_backoff_init(&ctx->sdo_data->to2_backoff, SDO_RETRY_TO2);
+	sdo_to2_checkpoint_discard();
+	sdo_protTO2Exit(ctx->sdo_data);
 
 	LOG(LOG_DEBUG, "\n------------------------------------ TO2 Successful "
 		       "--------------------------------------\n\n");
@@ -1123,50 +1550,21 @@ static bool _STATE_TO2(void)
 	LOG(LOG_INFO, "@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@\n");
 	TO2_done = 1;
 
-	sdor_t *sdor = &prot_ctx->protdata->sdor;
-	sdow_t *sdow = &prot_ctx->protdata->sdow;
-
-	sdob = &sdor->b;
+	sdob = &ctx->sdo_data->prot.sdor.b;
 	if (sdob->block) {
 		sdo_free(sdob->block);
 		sdob->block = NULL;
 	}
 
-	sdob = &sdow->b;
+	sdob = &ctx->sdo_data->prot.sdow.b;
 	if (sdob->block) {
 		sdo_free(sdob->block);
 		sdob->block = NULL;
 	}
 
-	ret = true;
-err:
-	sdo_prot_ctx_free(prot_ctx);
-	if (g_sdo_data->prot.success == false) {
-		if (g_sdo_data->error_recovery) {
-			LOG(LOG_INFO, "Retrying TO2,.....\n");
-			g_sdo_data->recovery_enabled = true;
-			g_sdo_data->state_fn = &_STATE_TO1;
-			sdo_protTO2Exit(g_sdo_data);
-			if (g_sdo_data->error_callback)
-				status = g_sdo_data->error_callback(
-				    SDO_WARNING, SDO_TO2_ERROR);
-
-			sdo_sleep(3);
-		} else {
-			if (g_sdo_data->error_callback)
-				status = g_sdo_data->error_callback(
-				    SDO_ERROR, SDO_TO2_ERROR);
-		}
-
-		if (status == SDO_ABORT) {
-			g_sdo_data->error_recovery = false;
-			g_sdo_data->recovery_enabled = false;
-			ERROR();
-			ret = false;
-		}
-	}
-	return ret;
+	return true;
 }
+
 /**
  * Sets state varilable to error and notifies the same to user.
  *
@@ -1175,9 +1573,11 @@ err:
  */
 static bool _STATE_Error(void)
 {
-	LOG(LOG_ERROR, "err %d\n", g_sdo_data->err);
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+
+	LOG(LOG_ERROR, "err %d\n", ctx->sdo_data->err);
 	LOG(LOG_INFO, "Secure Device Onboarding Failed.\n");
-	g_sdo_data->state_fn = &_STATE_Shutdown_Error;
+	ctx->sdo_data->state_fn = &_STATE_Shutdown_Error;
 
 	return true;
 }
@@ -1190,17 +1590,19 @@ static bool _STATE_Error(void)
  */
 static bool _STATE_Shutdown(void)
 {
-	if (g_sdo_data->service_info) {
-		sdo_service_info_free(g_sdo_data->service_info);
-		g_sdo_data->service_info = NULL;
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+
+	if (ctx->sdo_data->service_info) {
+		sdo_service_info_free(ctx->sdo_data->service_info);
+		ctx->sdo_data->service_info = NULL;
 	}
-	if (g_sdo_data->devcred) {
-		sdo_dev_cred_free(g_sdo_data->devcred);
-		sdo_free(g_sdo_data->devcred);
-		g_sdo_data->devcred = NULL;
+	if (ctx->sdo_data->devcred) {
+		sdo_dev_cred_free(ctx->sdo_data->devcred);
+		sdo_free(ctx->sdo_data->devcred);
+		ctx->sdo_data->devcred = NULL;
 	}
 
-	g_sdo_data->state_fn = NULL;
+	ctx->sdo_data->state_fn = NULL;
 
 	/* Closing all crypto related functions.*/
 	(void)sdo_crypto_close();
@@ -0,0 +1,237 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Retry/backoff scheduler.
+ *
+ * Every retry site (connect, send/receive, DI/TO1/TO2 recovery) asks this
+ * module how long to wait before the next attempt. Delays follow the
+ * "decorrelated jitter" scheme:
+ *
+ *	delay = min(cap, random_between(base, prev_delay * 3))
+ *
+ * so that a fleet of devices failing at the same instant (e.g. after a
+ * power event) spreads its retries out instead of hitting the servers in
+ * lock-step. Each phase has its own base/cap/attempt limit, and all phases
+ * share one total time budget per sdo_sdk_run().
+ */
+
+#include "util.h"
+#include "sdobackoff.h"
+#include "network_al.h"
+#include "sdoCrypto.h"
+#include "sdoctx.h"
+#include "sdostats.h"
+
+static const sdo_sdk_retry_policy default_policy[SDO_RETRY_PHASE_MAX] =
+    SDO_RETRY_DEFAULT_POLICIES;
+
+static const char *const phase_name[SDO_RETRY_PHASE_MAX] = {
+    [SDO_RETRY_CONNECT] = "connect",
+    [SDO_RETRY_NETIO] = "net-io",
+    [SDO_RETRY_DI] = "DI",
+    [SDO_RETRY_TO1] = "TO1",
+    [SDO_RETRY_TO2] = "TO2",
+};
+
+/**
+ * Internal API
+ * Return a random value in the closed range [lo, hi]. The crypto RNG is
+ * preferred so that devices booted at the same time do not share a
+ * sequence; sdo_random() is only used if the RNG is unavailable.
+ */
+static uint32_t random_between(uint32_t lo, uint32_t hi)
+{
+	uint32_t r = 0;
+
+	if (hi <= lo)
+		return lo;
+
+	if (sdo_crypto_random_bytes((uint8_t *)&r, sizeof(r)) != 0)
+		r = (uint32_t)sdo_random();
+
+	return lo + (uint32_t)(r % ((uint64_t)hi - lo + 1));
+}
+
+/**
+ * Initialize backoff state for one retry site.
+ *
+ * @param bo - backoff state to initialize.
+ * @param phase - retry phase whose policy applies to this site.
+ */
+void sdo_backoff_init(sdo_backoff_t *bo, sdo_sdk_retry_phase phase)
+{
+	if (!bo || phase >= SDO_RETRY_PHASE_MAX)
+		return;
+
+	bo->phase = phase;
+	bo->attempt = 0;
+	bo->prev_ms = sdo_ctx_current()->retry_policy[phase].base_ms;
+	bo->floor_ms = 0;
+}
+
+/**
+ * Set a lower bound on the delays produced for this site, e.g. the
+ * delaysec advertised by a rendezvous entry.
+ *
+ * @param bo - backoff state.
+ * @param floor_ms - minimum delay in milliseconds, clamped to UINT32_MAX.
+ */
+void sdo_backoff_set_floor(sdo_backoff_t *bo, uint64_t floor_ms)
+{
+	if (bo)
+		bo->floor_ms =
+		    floor_ms > UINT32_MAX ? UINT32_MAX : (uint32_t)floor_ms;
+}
+
+/**
+ * Compute the delay before the next attempt and account for it. Does not
+ * sleep; callers that can block should use sdo_backoff_wait().
+ *
+ * @param bo - backoff state of the retry site.
+ * @param delay_ms - out, delay in milliseconds before the next attempt.
+ * @return true if another attempt is allowed, false if the attempt limit
+ * or the total budget is exhausted, or the application vetoed the retry.
+ */
+bool sdo_backoff_next(sdo_backoff_t *bo, uint32_t *delay_ms)
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+	const sdo_sdk_retry_policy *p;
+	uint32_t delay, elapsed = 0;
+	uint64_t hi;
+
+	if (!bo || !delay_ms || bo->phase >= SDO_RETRY_PHASE_MAX)
+		return false;
+
+	p = &ctx->retry_policy[bo->phase];
+	if (p->max_attempts && bo->attempt >= p->max_attempts) {
+		LOG(LOG_INFO, "%s: giving up after %u retries\n",
+		    phase_name[bo->phase], bo->attempt);
+		return false;
+	}
+
+	hi = (uint64_t)bo->prev_ms * 3;
+	if (hi > p->cap_ms)
+		hi = p->cap_ms;
+	delay = random_between(p->base_ms, (uint32_t)hi);
+	if (delay > p->cap_ms)
+		delay = p->cap_ms;
+	if (delay < bo->floor_ms)
+		delay = bo->floor_ms;
+
+	/* one budget for the whole sdo_sdk_run(), 0 means unlimited */
+	if (ctx->retry_budget_ms) {
+		elapsed = (uint32_t)(sdo_get_time_ms() -
+				     ctx->retry_budget_start_ms);
+		if ((uint64_t)elapsed + delay > ctx->retry_budget_ms) {
+			LOG(LOG_INFO, "%s: retry budget of %u ms exhausted\n",
+			    phase_name[bo->phase], ctx->retry_budget_ms);
+			return false;
+		}
+	}
+
+	bo->attempt++;
+	bo->prev_ms = delay;
+
+	LOG(LOG_INFO, "%s: retry %u in %u ms\n", phase_name[bo->phase],
+	    bo->attempt, delay);
+	if (ctx->retry_callback &&
+	    ctx->retry_callback(bo->phase, bo->attempt, delay, elapsed) ==
+		SDO_ABORT) {
+		LOG(LOG_INFO, "%s: retry aborted by application\n",
+		    phase_name[bo->phase]);
+		return false;
+	}
+
+	sdo_stats_retry(bo->phase);
+	*delay_ms = delay;
+	return true;
+}
+
+/**
+ * Sleep for the next backoff delay of this retry site.
+ *
+ * @param bo - backoff state of the retry site.
+ * @return true if the caller should retry, false if it should give up.
+ */
+bool sdo_backoff_wait(sdo_backoff_t *bo)
+{
+	uint32_t delay_ms = 0;
+
+	if (!sdo_backoff_next(bo, &delay_ms))
+		return false;
+
+	sdo_msleep(delay_ms);
+	return true;
+}
+
+/**
+ * Start the total retry budget. Called from app_initialize(), at the start
+ * of every sdo_sdk_run() and sdo_sdk_start().
+ */
+void sdo_backoff_budget_start(void)
+{
+	sdo_ctx_current()->retry_budget_start_ms = sdo_get_time_ms();
+}
+
+/**
+ * Restore the built-in policies, budget and callback.
+ */
+void sdo_backoff_reset_policies(void)
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+
+	for (int i = 0; i < SDO_RETRY_PHASE_MAX; i++)
+		ctx->retry_policy[i] = default_policy[i];
+	ctx->retry_budget_ms = 0;
+	ctx->retry_callback = NULL;
+}
+
+/**
+ * Override the retry policy of one phase.
+ *
+ * @param phase - phase to configure.
+ * @param retry_policy - base/cap delays in ms and the attempt limit
+ * (0 = unlimited). base_ms must not be greater than cap_ms.
+ * @return SDO_SUCCESS, or SDO_ERROR on invalid input.
+ */
+sdo_sdk_status sdo_sdk_set_retry_policy(sdo_sdk_retry_phase phase,
+					const sdo_sdk_retry_policy *retry_policy)
+{
+	if (phase >= SDO_RETRY_PHASE_MAX || !retry_policy ||
+	    retry_policy->base_ms > retry_policy->cap_ms) {
+		LOG(LOG_ERROR, "Invalid retry policy\n");
+		return SDO_ERROR;
+	}
+
+	sdo_ctx_current()->retry_policy[phase] = *retry_policy;
+	return SDO_SUCCESS;
+}
+
+/**
+ * Limit the total time spent retrying within one sdo_sdk_run().
+ *
+ * @param total_budget_ms - budget in milliseconds, 0 = unlimited.
+ * @return SDO_SUCCESS always.
+ */
+sdo_sdk_status sdo_sdk_set_retry_budget(uint32_t total_budget_ms)
+{
+	sdo_ctx_current()->retry_budget_ms = total_budget_ms;
+	return SDO_SUCCESS;
+}
+
+/**
+ * Register a callback invoked before every retry delay, for telemetry. The
+ * callback may return SDO_ABORT to give up instead of retrying.
+ *
+ * @param cb - callback, or NULL to unregister.
+ * @return SDO_SUCCESS always.
+ */
+sdo_sdk_status sdo_sdk_register_retry_cb(sdo_sdk_retryCB cb)
+{
+	sdo_ctx_current()->retry_callback = cb;
+	return SDO_SUCCESS;
+}
@@ -132,7 +132,7 @@ void sdo_resize_block(sdo_block_t *sdob, int need)
 	if (need > sdob->block_max) {
 		int new_size = (need + SDO_BLOCKINC - 1) & SDO_BLOCK_MASK;
 
-		sdob->block = realloc(sdob->block, new_size);
+		sdob->block = sdo_realloc(sdob->block, new_size);
 		sdob->block_max = new_size;
 
 		if (!sdob->block) {
@@ -536,6 +536,60 @@ int sdo_read_tag(sdor_t *sdor, char *bufp, int buf_sz)
 	return n;
 }
 
+/**
+ * Internal API
+ * Read a string in place: *data points at its first byte in the block and
+ * *len is its length, without the quotes. Nothing is copied and the string
+ * is not NUL-terminated.
+ */
+bool sdo_read_string_view(sdor_t *sdor, uint8_t **data, size_t *len)
+{
+	sdo_block_t *sdob = &sdor->b;
+	int start;
+	char c;
+
+	if (!_read_comma(sdor)) {
+		LOG(LOG_ERROR, "we were expecting , here!\n");
+		return false;
+	}
+
+	if (!_read_expected_char(sdor, '"')) {
+		LOG(LOG_ERROR, "Expected char read is not \"\n");
+		return false;
+	}
+
+	start = sdob->cursor;
+	do {
+		if (sdob_getc(sdob, &c) == -1) {
+			LOG(LOG_ERROR, "Unterminated string\n");
+			return false;
+		}
+	} while (c != '"');
+
+	*data = &sdob->block[start];
+	*len = (size_t)(sdob->cursor - 1 - start);
+	sdor->need_comma = true;
+	return true;
+}
+
+/**
+ * Internal API
+ * Read a tag in place, see sdo_read_string_view().
+ */
+bool sdo_read_tag_view(sdor_t *sdor, uint8_t **data, size_t *len)
+{
+	if (!sdo_read_string_view(sdor, data, len))
+		return false;
+
+	if (!_read_expected_char(sdor, ':')) {
+		LOG(LOG_ERROR, "Expected char read is not :\n");
+		return false;
+	}
+
+	sdor->need_comma = false;
+	return true;
+}
+
 /**
  * Internal API
  */
@@ -706,6 +760,16 @@ static void _write_comma(sdow_t *sdow)
 	}
 }
 
+/**
+ * Internal API
+ * @return true if c is written as a \uXXXX escape.
+ */
+static bool _escapechar(unsigned char c)
+{
+	return c < 0x20 || c > 0x7d || c == '[' || c == ']' || c == '"' ||
+	       c == '\\' || c == '{' || c == '}' || c == '&';
+}
+
 /**
  * Write a string to the block, extending block and converting
  * special characters.  Does NOT handle commas.
@@ -717,9 +781,7 @@ void _padstring(sdow_t *sdow, const char *s, int len, bool escape)
 	unsigned char c;
 
 	while (len-- != 0 && (c = (unsigned char)*s++) != 0) {
-		if (escape &&
-		    (c < 0x20 || c > 0x7d || c == '[' || c == ']' || c == '"' ||
-		     c == '\\' || c == '{' || c == '}' || c == '&')) {
+		if (escape && _escapechar(c)) {
 
 			if (snprintf_s_i(ucode, sizeof(ucode), "\\u%04x", c) <
 			    0) {
@@ -858,6 +920,47 @@ void sdo_write_string_len(sdow_t *sdow, const char *s, int len)
 	if (sdob->block_size < sdob->cursor)
 		sdob->block_size = sdob->cursor;
 }
+
+/**
+ * Internal API
+ * @return the bytes sdo_write_string_len() writes for s, quotes included,
+ * a comma before it not.
+ */
+size_t sdo_write_string_size(const char *s, int len)
+{
+	size_t size = 2;
+	unsigned char c;
+
+	while (len-- != 0 && (c = (unsigned char)*s++) != 0)
+		size += _escapechar(c) ? 6 : 1;
+	return size;
+}
+
+/**
+ * Internal API
+ * Write len bytes of JSON serialized by another writer as the next member
+ * of the current object or sequence.
+ * @return true if success, false on allocation failure.
+ */
+bool sdo_write_serialized(sdow_t *sdow, const uint8_t *data, size_t len)
+{
+	sdo_block_t *sdob = &sdow->b;
+
+	_write_comma(sdow);
+	sdo_resize_block(sdob, sdob->cursor + (int)len);
+	if (!sdob->block)
+		return false;
+	if (len && memcpy_s(sdob->block + sdob->cursor,
+			    sdob->block_max - sdob->cursor, data, len) != 0) {
+		LOG(LOG_ERROR, "Memcpy failed\n");
+		return false;
+	}
+	sdob->cursor += (int)len;
+	sdow->need_comma = true;
+	if (sdob->block_size < sdob->cursor)
+		sdob->block_size = sdob->cursor;
+	return true;
+}
 #if 0
 /**
  * Internal API
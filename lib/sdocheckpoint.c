@@ -0,0 +1,586 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief TO2 checkpoint/resume.
+ *
+ * Once the owner has acknowledged msg44 the TO2 session keys are agreed, so
+ * losing the connection after that point does not require a new key
+ * exchange. Two levels of resume are supported:
+ *
+ * 1. Within one sdo_sdk_run(): sdo_prot_ctx_run() re-sends the pending
+ *    msg46/48/50 on the same session after a transport failure, see
+ *    sdo_to2_resumable().
+ *
+ * 2. Across a restart: while the device is in the Device Service Info
+ *    phase (pending msg46), the session is sealed into the SDO_TO2_CHECKPOINT
+ *    secure blob before every send. On the next sdo_sdk_run() TO1 is skipped
+ *    and the pending msg46 is sent again. From msg47 on the owner has pushed
+ *    new credentials and service info into the modules, which is state that
+ *    cannot be rebuilt after a restart, so the checkpoint is invalidated.
+ *    The checkpoint is not written when RESALE_SUPPORTED is set, as msg50
+ *    then needs the full ownership voucher.
+ *
+ * The checkpoint is an SDO JSON object:
+ *
+ *	{"v":version, "g":GUID, "st":state, "mt":pending message type,
+ *	 "rt":round trips, "nn":DSI round, "dr":DSI rounds,
+ *	 "mp":DSI module position, "mi":DSI index within the module,
+ *	 "ip":owner IP, "po":owner port, "dn":owner DNS,
+ *	 "au":REST Authorization, "xt":REST X-Token,
+ *	 "sek", "svk", "ci":CTR IV, "cv":CTR counter, "iv":sdo_iv_t,
+ *	 "n6", "n7", "pk":owner public key, "m":pending message}
+ *
+ * A checkpoint is invalidated by overwriting it with {"v":0}.
+ */
+
+#include "util.h"
+#include "network_al.h"
+#include "sdocheckpoint.h"
+#include "sdoCrypto.h"
+#include "sdoCryptoCtx.h"
+#include "storage_al.h"
+#include "rest_interface.h"
+#include "safe_lib.h"
+#include "sdoctx.h"
+
+/**
+ * Internal API
+ */
+static void cp_write_bytes(sdow_t *sdow, const char *tag, const void *buf,
+			   size_t len)
+{
+	sdo_write_tag(sdow, tag);
+	sdo_write_byte_array_field(sdow, (uint8_t *)buf, (int)len);
+}
+
+/**
+ * Internal API
+ */
+static void cp_write_uint(sdow_t *sdow, const char *tag, uint32_t val)
+{
+	sdo_write_tag(sdow, tag);
+	sdo_writeUInt(sdow, val);
+}
+
+/**
+ * Internal API
+ */
+static sdo_byte_array_t *cp_read_bytes(sdor_t *sdor, const char *tag)
+{
+	sdo_byte_array_t *ba;
+
+	if (!sdo_read_expected_tag(sdor, tag))
+		return NULL;
+
+	ba = sdo_byte_array_alloc(0);
+	if (!ba)
+		return NULL;
+
+	/* An empty field reads as 0 bytes */
+	(void)sdo_byte_array_read_chars(sdor, ba);
+	return ba;
+}
+
+/**
+ * Internal API
+ */
+static bool cp_read_uint(sdor_t *sdor, const char *tag, uint32_t *val)
+{
+	if (!sdo_read_expected_tag(sdor, tag))
+		return false;
+
+	*val = sdo_read_uint(sdor);
+	return true;
+}
+
+/**
+ * Internal API
+ * Return a NUL terminated copy of a byte array, NULL if it is empty.
+ */
+static char *cp_strdup(sdo_byte_array_t *ba)
+{
+	char *s;
+
+	if (!ba || !ba->byte_sz)
+		return NULL;
+
+	s = sdo_alloc(ba->byte_sz + 1);
+	if (s && memcpy_s(s, ba->byte_sz + 1, ba->bytes, ba->byte_sz) != 0) {
+		sdo_free(s);
+		return NULL;
+	}
+	return s;
+}
+
+/**
+ * Internal API
+ * Zeroize and free a byte array holding key material.
+ */
+static void cp_free_secret(sdo_byte_array_t *ba)
+{
+	if (!ba)
+		return;
+	if (ba->bytes && ba->byte_sz)
+		(void)memset_s(ba->bytes, ba->byte_sz, 0);
+	sdo_byte_array_free(ba);
+}
+
+/**
+ * Internal API
+ * Zeroize and free a block holding a serialized checkpoint.
+ */
+static void cp_free_block(sdo_block_t *sdob)
+{
+	if (sdob->block) {
+		(void)memset_s(sdob->block, sdob->block_max, 0);
+		sdo_free(sdob->block);
+	}
+	sdob->block_max = 0;
+	sdob->block_size = 0;
+	sdob->cursor = 0;
+}
+
+/**
+ * Internal API
+ */
+static void cp_release(void)
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+
+	cp_free_block(&ctx->cp_reader.b);
+	ctx->cp_reader.have_block = false;
+	if (ctx->cp_auth)
+		sdo_free(ctx->cp_auth);
+	if (ctx->cp_xtoken)
+		sdo_free(ctx->cp_xtoken);
+}
+
+/**
+ * Check whether the pending message of a TO2 session can be sent again
+ * after a transport failure, i.e. the owner has acknowledged msg44 and the
+ * session keys are in place.
+ *
+ * @param ps - protocol state.
+ * @return true if the pending message may be re-sent.
+ */
+bool sdo_to2_resumable(sdo_prot_t *ps)
+{
+	if (!ps || ps->state == SDO_STATE_ERROR || ps->state == SDO_STATE_DONE)
+		return false;
+
+	switch (ps->sdow.msg_type) {
+	case SDO_TO2_NEXT_DEVICE_SERVICE_INFO:
+	case SDO_TO2_GET_NEXT_OWNER_SERVICE_INFO:
+	case SDO_TO2_DONE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Seal the TO2 session and the pending message to storage. Called before
+ * every send; outside of the Device Service Info phase any previous
+ * checkpoint is invalidated instead.
+ *
+ * @param prot_ctx - protocol context with the message about to be sent.
+ * @return true on success, false if the checkpoint could not be written.
+ */
+bool sdo_to2_checkpoint_save(sdo_prot_ctx_t *prot_ctx)
+{
+#ifndef NO_PERSISTENT_STORAGE
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+	sdo_prot_t *ps;
+	sdo_aes_keyset_t *keyset = get_keyset();
+	sdo_to2Sym_enc_ctx_t *to2sym_ctx = get_sdo_to2_ctx();
+	rest_ctx_t *rest = get_rest_context();
+	sdo_sdk_service_info_module_list_t *mod;
+	sdow_t sdowriter, *sdow = &sdowriter;
+	uint32_t mod_pos = 0;
+	bool ret = false;
+
+	if (!prot_ctx || !prot_ctx->protdata)
+		return false;
+	ps = prot_ctx->protdata;
+
+	if (ps->sdow.msg_type != SDO_TO2_NEXT_DEVICE_SERVICE_INFO ||
+	    resale_supported) {
+		sdo_to2_checkpoint_discard();
+		return true;
+	}
+
+	if (!sdow_init(sdow)) {
+		LOG(LOG_ERROR, "sdow_init() failed!\n");
+		return false;
+	}
+
+	if (!ps->g2 || !ps->iv || !ps->n6 || !ps->n7 ||
+	    !ps->owner_public_key || !keyset->sek || !keyset->svk ||
+	    !prot_ctx->host_ip || !rest) {
+		LOG(LOG_ERROR, "TO2 checkpoint: incomplete session\n");
+		goto end;
+	}
+
+	if (ps->dsi_info) {
+		for (mod = ps->sv_info_mod_list_head;
+		     mod && mod != ps->dsi_info->list_dsi; mod = mod->next)
+			mod_pos++;
+	}
+
+	sdow_next_block(sdow, ps->sdow.msg_type);
+	sdow_begin_object(sdow);
+	cp_write_uint(sdow, "v", SDO_TO2_CHECKPOINT_VERSION);
+	sdo_write_tag(sdow, "g");
+	sdo_byte_array_write_chars(sdow, ps->g2);
+	cp_write_uint(sdow, "st", ps->state);
+	cp_write_uint(sdow, "mt", ps->sdow.msg_type);
+	cp_write_uint(sdow, "rt", ps->round_trip_count);
+	cp_write_uint(sdow, "nn", ps->serv_req_info_num);
+	cp_write_uint(sdow, "dr", ps->total_dsi_rounds);
+	cp_write_uint(sdow, "mp", mod_pos);
+	cp_write_uint(sdow, "mi",
+		      ps->dsi_info ? ps->dsi_info->module_dsi_index : 0);
+	/* The resolved address, DNS is not looked up again on resume */
+	cp_write_bytes(sdow, "ip", prot_ctx->host_ip->addr,
+		       prot_ctx->host_ip->length);
+	cp_write_uint(sdow, "po", prot_ctx->host_port);
+	cp_write_bytes(sdow, "dn", ps->dns1,
+		       ps->dns1 ? strnlen_s(ps->dns1, SDO_MAX_STR_SIZE) : 0);
+	cp_write_bytes(sdow, "au", rest->authorization,
+		       rest->authorization
+			   ? strnlen_s(rest->authorization, SDO_MAX_STR_SIZE)
+			   : 0);
+	cp_write_bytes(sdow, "xt", rest->x_token_authorization,
+		       rest->x_token_authorization
+			   ? strnlen_s(rest->x_token_authorization,
+				       SDO_MAX_STR_SIZE)
+			   : 0);
+	cp_write_bytes(sdow, "sek", keyset->sek->bytes, keyset->sek->byte_sz);
+	cp_write_bytes(sdow, "svk", keyset->svk->bytes, keyset->svk->byte_sz);
+	cp_write_bytes(sdow, "ci", to2sym_ctx->initialization_vector,
+		       to2sym_ctx->initialization_vector ? AES_CTR_IV : 0);
+	cp_write_uint(sdow, "cv", to2sym_ctx->ctr_value);
+	cp_write_bytes(sdow, "iv", ps->iv, sizeof(sdo_iv_t));
+	sdo_write_tag(sdow, "n6");
+	sdo_byte_array_write_chars(sdow, ps->n6);
+	sdo_write_tag(sdow, "n7");
+	sdo_byte_array_write_chars(sdow, ps->n7);
+	sdo_write_tag(sdow, "pk");
+	sdo_public_key_write(sdow, ps->owner_public_key);
+	cp_write_bytes(sdow, "m", ps->sdow.b.block, ps->sdow.b.block_size);
+	sdow_end_object(sdow);
+
+	if (sdo_blob_write((char *)SDO_TO2_CHECKPOINT, SDO_SDK_SECURE_DATA,
+			   sdow->b.block, sdow->b.block_size) == -1) {
+		LOG(LOG_ERROR, "Failed to write TO2 checkpoint\n");
+		goto end;
+	}
+	ctx->cp_on_disk = true;
+	ret = true;
+
+end:
+	cp_free_block(&sdow->b);
+	if (!ret)
+		sdo_to2_checkpoint_discard();
+	return ret;
+#else
+	(void)prot_ctx;
+	return true;
+#endif
+}
+
+/**
+ * Load a sealed TO2 checkpoint, if one exists for this device.
+ *
+ * @param guid - GUID of the current device credentials.
+ * @return true if a checkpoint for guid was loaded and TO2 can be resumed.
+ */
+bool sdo_to2_checkpoint_load(sdo_byte_array_t *guid)
+{
+#ifndef NO_PERSISTENT_STORAGE
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+	sdor_t *sdor = &ctx->cp_reader;
+	sdo_byte_array_t *g = NULL;
+	uint32_t version = 0;
+	int32_t len;
+	bool ret = false;
+
+	cp_release();
+	if (!guid)
+		return false;
+
+	len = sdo_blob_size((char *)SDO_TO2_CHECKPOINT, SDO_SDK_SECURE_DATA);
+	if (len <= 0)
+		return false;
+
+	if (!sdor_init(sdor, NULL, NULL)) {
+		LOG(LOG_ERROR, "sdor_init() failed!\n");
+		return false;
+	}
+
+	/* Assume something is there until it is known to be a tombstone */
+	ctx->cp_on_disk = true;
+	sdo_resize_block(&sdor->b, len);
+	if (!sdor->b.block ||
+	    sdo_blob_read((char *)SDO_TO2_CHECKPOINT, SDO_SDK_SECURE_DATA,
+			  sdor->b.block, len) == -1) {
+		LOG(LOG_ERROR, "Could not read the TO2 checkpoint\n");
+		goto end;
+	}
+	sdor->b.block_size = len;
+	sdor->have_block = true;
+
+	if (!sdor_begin_object(sdor) || !cp_read_uint(sdor, "v", &version))
+		goto end;
+
+	if (version != SDO_TO2_CHECKPOINT_VERSION) {
+		if (version == 0)
+			ctx->cp_on_disk = false;
+		else
+			LOG(LOG_INFO, "TO2 checkpoint version %u unsupported\n",
+			    version);
+		goto end;
+	}
+
+	g = cp_read_bytes(sdor, "g");
+	if (!g || !sdo_compare_byte_arrays(g, guid)) {
+		LOG(LOG_INFO, "TO2 checkpoint is for another GUID\n");
+		goto end;
+	}
+	ret = true;
+
+end:
+	if (g)
+		sdo_byte_array_free(g);
+	if (!ret)
+		sdo_to2_checkpoint_discard();
+	return ret;
+#else
+	(void)guid;
+	return false;
+#endif
+}
+
+/**
+ * Restore the loaded checkpoint into the protocol state and the TO2 crypto
+ * context. Must follow sdo_kex_init() and sdo_prot_to2_init(). On success
+ * ps->sdow holds the pending message and ps->state the state waiting for
+ * its response.
+ *
+ * @param ps - protocol state.
+ * @return true on success, false if the checkpoint is unusable.
+ */
+bool sdo_to2_checkpoint_restore(sdo_prot_t *ps)
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+	sdor_t *sdor = &ctx->cp_reader;
+	sdo_aes_keyset_t *keyset = get_keyset();
+	sdo_to2Sym_enc_ctx_t *to2sym_ctx = get_sdo_to2_ctx();
+	sdo_sdk_service_info_module_list_t *mod = NULL;
+	sdo_byte_array_t *ip = NULL, *dn = NULL, *au = NULL, *xt = NULL;
+	sdo_byte_array_t *sek = NULL, *svk = NULL, *ci = NULL, *iv = NULL;
+	sdo_byte_array_t *msg = NULL;
+	uint32_t st = 0, mt = 0, rt = 0, nn = 0, dr = 0, mp = 0, mi = 0;
+	uint32_t po = 0, cv = 0;
+	int mod_mes_count = 0, mod_ret_val = 0;
+	bool ret = false;
+
+	if (!ps || !ps->iv || !sdor_have_block(sdor) || !keyset->sek ||
+	    !keyset->svk)
+		goto end;
+
+	if (!cp_read_uint(sdor, "st", &st) || !cp_read_uint(sdor, "mt", &mt) ||
+	    !cp_read_uint(sdor, "rt", &rt) || !cp_read_uint(sdor, "nn", &nn) ||
+	    !cp_read_uint(sdor, "dr", &dr) || !cp_read_uint(sdor, "mp", &mp) ||
+	    !cp_read_uint(sdor, "mi", &mi))
+		goto end;
+
+	ip = cp_read_bytes(sdor, "ip");
+	if (!ip || !cp_read_uint(sdor, "po", &po))
+		goto end;
+	dn = cp_read_bytes(sdor, "dn");
+	au = cp_read_bytes(sdor, "au");
+	xt = cp_read_bytes(sdor, "xt");
+	sek = cp_read_bytes(sdor, "sek");
+	svk = cp_read_bytes(sdor, "svk");
+	ci = cp_read_bytes(sdor, "ci");
+	if (!dn || !au || !xt || !sek || !svk || !ci ||
+	    !cp_read_uint(sdor, "cv", &cv))
+		goto end;
+	iv = cp_read_bytes(sdor, "iv");
+	ps->n6 = cp_read_bytes(sdor, "n6");
+	ps->n7 = cp_read_bytes(sdor, "n7");
+	if (!iv || !ps->n6 || !ps->n7 || !sdo_read_expected_tag(sdor, "pk"))
+		goto end;
+	ps->owner_public_key = sdo_public_key_read(sdor);
+	msg = cp_read_bytes(sdor, "m");
+	if (!ps->owner_public_key || !msg)
+		goto end;
+
+	if (mt != SDO_TO2_NEXT_DEVICE_SERVICE_INFO ||
+	    (st != SDO_STATE_TO2_RCV_GET_NEXT_DEVICE_SERVICE_INFO &&
+	     st != SDO_STATE_TO2_RCV_SETUP_DEVICE) ||
+	    !msg->byte_sz || !ip->byte_sz || ip->byte_sz > sizeof(ps->i1.addr) ||
+	    sek->byte_sz != keyset->sek->byte_sz ||
+	    svk->byte_sz != keyset->svk->byte_sz ||
+	    iv->byte_sz != sizeof(sdo_iv_t) ||
+	    ps->n6->byte_sz != SDO_NONCE_BYTES ||
+	    ps->n7->byte_sz != SDO_NONCE_BYTES ||
+	    (cv && ci->byte_sz != AES_CTR_IV)) {
+		LOG(LOG_ERROR, "TO2 checkpoint is malformed\n");
+		goto end;
+	}
+
+	/* The module set must be the one the owner was told about in msg44 */
+	if (!sdo_get_dsi_count(ps->sv_info_mod_list_head, &mod_mes_count,
+			       &mod_ret_val) ||
+	    (uint32_t)(1 + mod_mes_count) != dr) {
+		LOG(LOG_ERROR, "TO2 checkpoint: service info modules changed\n");
+		goto end;
+	}
+	if (ps->dsi_info) {
+		mod = ps->sv_info_mod_list_head;
+		while (mod && mp--)
+			mod = mod->next;
+		ps->dsi_info->list_dsi = mod;
+		ps->dsi_info->module_dsi_index = (int)mi;
+	}
+
+	/* Session keys and counters */
+	if (memcpy_s(keyset->sek->bytes, keyset->sek->byte_sz, sek->bytes,
+		     sek->byte_sz) != 0 ||
+	    memcpy_s(keyset->svk->bytes, keyset->svk->byte_sz, svk->bytes,
+		     svk->byte_sz) != 0 ||
+	    memcpy_s(ps->iv, sizeof(sdo_iv_t), iv->bytes, iv->byte_sz) != 0) {
+		LOG(LOG_ERROR, "Memcpy Failed\n");
+		goto end;
+	}
+	if (cv) {
+		if (!to2sym_ctx->initialization_vector)
+			to2sym_ctx->initialization_vector =
+			    sdo_alloc(AES_CTR_IV);
+		if (!to2sym_ctx->initialization_vector ||
+		    memcpy_s(to2sym_ctx->initialization_vector, AES_CTR_IV,
+			     ci->bytes, ci->byte_sz) != 0)
+			goto end;
+	}
+	to2sym_ctx->ctr_value = cv;
+
+	/* Owner address and REST session */
+	ps->i1.length = ip->byte_sz;
+	if (memcpy_s(ps->i1.addr, sizeof(ps->i1.addr), ip->bytes,
+		     ip->byte_sz) != 0)
+		goto end;
+	ps->port1 = po;
+	ps->dns1 = cp_strdup(dn);
+	ctx->cp_auth = cp_strdup(au);
+	ctx->cp_xtoken = cp_strdup(xt);
+
+	/* Pending message, sent as is on the first round */
+	sdow_next_block(&ps->sdow, mt);
+	sdo_resize_block(&ps->sdow.b, msg->byte_sz + 1);
+	if (!ps->sdow.b.block ||
+	    memcpy_s(ps->sdow.b.block, ps->sdow.b.block_max, msg->bytes,
+		     msg->byte_sz) != 0)
+		goto end;
+	ps->sdow.b.block_size = msg->byte_sz;
+	ps->sdow.b.cursor = msg->byte_sz;
+
+	ps->state = (int)st;
+	ps->round_trip_count = rt;
+	ps->serv_req_info_num = (uint16_t)nn;
+	ps->total_dsi_rounds = (int)dr;
+	ps->resumed = true;
+	ret = true;
+
+	LOG(LOG_INFO, "TO2 resumed at msg%u, round %u of %u\n", mt, nn, dr);
+
+end:
+	sdo_byte_array_free(ip);
+	sdo_byte_array_free(dn);
+	cp_free_secret(au);
+	cp_free_secret(xt);
+	cp_free_secret(sek);
+	cp_free_secret(svk);
+	sdo_byte_array_free(ci);
+	cp_free_secret(iv);
+	sdo_byte_array_free(msg);
+	cp_free_block(&sdor->b);
+	sdor->have_block = false;
+	if (!ret && ps) {
+		if (ps->owner_public_key) {
+			sdo_public_key_free(ps->owner_public_key);
+			ps->owner_public_key = NULL;
+		}
+		if (ps->n6) {
+			sdo_byte_array_free(ps->n6);
+			ps->n6 = NULL;
+		}
+		if (ps->n7) {
+			sdo_byte_array_free(ps->n7);
+			ps->n7 = NULL;
+		}
+	}
+	if (!ret)
+		sdo_to2_checkpoint_discard();
+	return ret;
+}
+
+/**
+ * Re-install the restored REST session (authorization token and host
+ * name) into the REST context of a new sdo_prot_ctx_run().
+ *
+ * @param prot_ctx - protocol context of the resumed TO2.
+ * @return true on success, false otherwise.
+ */
+bool sdo_to2_checkpoint_restore_session(sdo_prot_ctx_t *prot_ctx)
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+	rest_ctx_t *rest = get_rest_context();
+
+	if (!prot_ctx || !prot_ctx->protdata || !rest)
+		return false;
+
+	if (prot_ctx->host_dns && !cache_host_dns(prot_ctx->host_dns))
+		return false;
+
+	if (rest->authorization)
+		sdo_free(rest->authorization);
+	rest->authorization = ctx->cp_auth;
+	ctx->cp_auth = NULL;
+
+	if (rest->x_token_authorization)
+		sdo_free(rest->x_token_authorization);
+	rest->x_token_authorization = ctx->cp_xtoken;
+	ctx->cp_xtoken = NULL;
+
+	prot_ctx->protdata->resumed = false;
+	return true;
+}
+
+/**
+ * Invalidate the stored checkpoint, if any, and drop the loaded one.
+ * Called when TO2 completes or fails and when it leaves the phase that
+ * can be resumed after a restart.
+ */
+void sdo_to2_checkpoint_discard(void)
+{
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+	static const char tombstone[] = "{\"v\":0}";
+
+	cp_release();
+	if (!ctx->cp_on_disk)
+		return;
+
+	if (sdo_blob_write((char *)SDO_TO2_CHECKPOINT, SDO_SDK_SECURE_DATA,
+			   (const uint8_t *)tombstone,
+			   sizeof(tombstone) - 1) == -1) {
+		LOG(LOG_ERROR, "Failed to invalidate TO2 checkpoint\n");
+		return;
+	}
+	ctx->cp_on_disk = false;
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief SDK contexts and their binding to the calling thread.
+ */
+
+#include "util.h"
+#include "sdoctx.h"
+#include "safe_lib.h"
+
+/* Context of the threads that never called sdo_sdk_ctx_use() */
+static sdo_sdk_ctx default_ctx = SDO_CTX_INITIALIZER;
+
+/* Context bound to the calling thread, NULL for the default one */
+static SDO_CTX_TLS sdo_sdk_ctx *current;
+
+#if defined(TARGET_OS_LINUX)
+/* Serializes the device state all contexts share */
+static pthread_mutex_t device_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/**
+ * Internal API
+ * @return the context bound to the calling thread.
+ */
+sdo_sdk_ctx *sdo_ctx_current(void)
+{
+	return current ? current : &default_ctx;
+}
+
+/**
+ * Internal API
+ * Take the lock held around process-wide device state (crypto library and
+ * platform setup) that is shared by all contexts.
+ */
+void sdo_ctx_lock(void)
+{
+#if defined(TARGET_OS_LINUX)
+	(void)pthread_mutex_lock(&device_lock);
+#endif
+}
+
+/**
+ * Internal API
+ */
+void sdo_ctx_unlock(void)
+{
+#if defined(TARGET_OS_LINUX)
+	(void)pthread_mutex_unlock(&device_lock);
+#endif
+}
+
+/**
+ * Allocate an SDK context. A context holds the protocol, network, REST and
+ * crypto state of one onboarding session, so that several sessions can run
+ * in one process, each on its own thread.
+ *
+ * @return the new context, or NULL on allocation failure.
+ */
+sdo_sdk_ctx *sdo_sdk_ctx_new(void)
+{
+	static const sdo_sdk_ctx template = SDO_CTX_INITIALIZER;
+	sdo_sdk_ctx *ctx = sdo_alloc(sizeof(sdo_sdk_ctx));
+
+	if (!ctx) {
+		LOG(LOG_ERROR, "Failed to allocate SDK context\n");
+		return NULL;
+	}
+
+	*ctx = template;
+	return ctx;
+}
+
+/**
+ * Release an SDK context. Its session must have been closed with
+ * sdo_sdk_deinit() while the context was bound. If the context is bound to
+ * the calling thread, the thread goes back to the default context.
+ *
+ * @param ctx - context to release, may be NULL.
+ */
+void sdo_sdk_ctx_free(sdo_sdk_ctx *ctx)
+{
+	if (!ctx)
+		return;
+
+	if (ctx->sdo_data || ctx->rest)
+		LOG(LOG_ERROR, "SDK context freed with a session open\n");
+
+	if (current == ctx)
+		current = NULL;
+
+#ifdef CRED_STORE_ENABLED
+	cred_store_close(&ctx->cred_store);
+#endif
+	sdo_free(ctx->blob_dir);
+
+	if (memset_s(ctx, sizeof(*ctx), 0) != 0)
+		LOG(LOG_ERROR, "Failed to clear SDK context\n");
+	sdo_free(ctx);
+}
+
+/**
+ * Bind an SDK context to the calling thread. Every SDK call the thread makes
+ * afterwards, from sdo_sdk_init() to sdo_sdk_deinit(), works on this
+ * context. A context must not be bound to two threads at the same time.
+ *
+ * @param ctx - context to bind, or NULL for the default context.
+ * @return SDO_SUCCESS always.
+ */
+sdo_sdk_status sdo_sdk_ctx_use(sdo_sdk_ctx *ctx)
+{
+	current = ctx;
+	return SDO_SUCCESS;
+}
+
+/**
+ * Keep the blobs of a context in a directory of their own. Blob names that
+ * are relative to the working directory (built with a relative BLOB_PATH)
+ * are taken relative to dir instead, so that the sessions of one process
+ * can onboard different devices. The platform keys and IV are those of the
+ * process and are shared by all contexts.
+ *
+ * @param ctx - context, with no session open.
+ * @param dir - directory, or NULL for the working directory.
+ * @return SDO_SUCCESS on success, SDO_ERROR on invalid input or allocation
+ * failure.
+ */
+sdo_sdk_status sdo_sdk_ctx_set_blob_dir(sdo_sdk_ctx *ctx, const char *dir)
+{
+	char *copy = NULL;
+	size_t len;
+
+	if (!ctx || ctx->sdo_data) {
+		LOG(LOG_ERROR, "Invalid SDK context\n");
+		return SDO_ERROR;
+	}
+
+	if (dir) {
+		len = strnlen_s(dir, SDO_MAX_STR_SIZE);
+		if (!len || len == SDO_MAX_STR_SIZE) {
+			LOG(LOG_ERROR, "Invalid blob directory\n");
+			return SDO_ERROR;
+		}
+		copy = sdo_alloc(len + 1);
+		if (!copy || strcpy_s(copy, len + 1, dir) != 0) {
+			LOG(LOG_ERROR, "Failed to set blob directory\n");
+			sdo_free(copy);
+			return SDO_ERROR;
+		}
+	}
+
+#ifdef CRED_STORE_ENABLED
+	/* The store of the old directory is not the one to use any more */
+	cred_store_close(&ctx->cred_store);
+#endif
+	sdo_free(ctx->blob_dir);
+	ctx->blob_dir = copy;
+	return SDO_SUCCESS;
+}
@@ -0,0 +1,371 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Device service info built ahead of msg46 on a producer thread.
+ *
+ * Module DSIs go out one per msg46, and a module asked for a DSI in msg46
+ * keeps the round trip waiting while it reads its hardware inventory. The
+ * SDO_SI_GET_DSI callbacks of v2 modules registered with
+ * SDO_SI_FLAG_PREFETCH_DSI run instead on a producer thread, started as
+ * msg46 sends the platform DSIs. It builds the next DSIs in the order msg46
+ * sends them and serializes each one into a ready buffer, up to
+ * SDO_DSI_PREFETCH_DEPTH ahead of msg46, which then only copies the buffer
+ * into the message and encrypts it.
+ *
+ * The DSIs of the other modules are still built within msg46, which keeps
+ * the position of the DSI sent last in sdo_sv_info_dsi_info_t as before;
+ * the producer walks a copy of its own. A failed callback stops the
+ * producer and fails the msg46 that was to send its DSI. The producer is
+ * joined after the last msg46 and on the way out of TO2. Where the SDK has
+ * no threads, every DSI is built within msg46.
+ */
+
+#include "util.h"
+#include "sdodsi.h"
+#include "safe_lib.h"
+
+#if defined(TARGET_OS_LINUX)
+#include <pthread.h>
+#define DSI_PREFETCH_THREAD
+#endif
+
+/* One DSI, serialized as "module:message":"value" */
+typedef struct {
+	size_t len;
+	/* len bytes of JSON */
+} dsi_ready_t;
+
+struct sdo_dsi_prefetch_s {
+	sdo_sv_info_dsi_info_t next; /* DSI the producer builds next */
+	dsi_ready_t *ready[SDO_DSI_PREFETCH_DEPTH];
+	unsigned int head;
+	unsigned int count;
+	bool stop;
+	bool done;  /* every DSI left has been built */
+	int status; /* callback failure, SDO_SI_SUCCESS until then */
+#ifdef DSI_PREFETCH_THREAD
+	pthread_t thread;
+	pthread_mutex_t lock;
+	/* signalled when a DSI is made ready or taken, or the producer ends */
+	pthread_cond_t cond;
+#endif
+};
+
+/**
+ * Internal API
+ * Move a DSI position past the modules that have no DSI left to send.
+ */
+static void dsi_skip_sent(sdo_sv_info_dsi_info_t *pos)
+{
+	while (pos->list_dsi &&
+	       pos->module_dsi_index >= pos->list_dsi->module_dsi_count) {
+		pos->list_dsi = pos->list_dsi->next;
+		pos->module_dsi_index = 0;
+	}
+}
+
+/**
+ * Internal API
+ * Build the next DSI within msg46 and write it to sdow.
+ */
+static bool dsi_write_in_place(sdo_sv_info_dsi_info_t *dsi_info, sdow_t *sdow,
+			       int *cb_return_val)
+{
+	sdo_sdk_si_key_value *sv_kv = sdo_alloc(sizeof(sdo_sdk_si_key_value));
+	bool ret = false;
+
+	if (!sv_kv)
+		return false;
+
+	if (!sdo_construct_module_dsi(dsi_info, sv_kv, cb_return_val)) {
+		LOG(LOG_DEBUG, "Sv_info: module DSI Construction Failed\n");
+		goto end;
+	}
+	if (!sdo_mod_kv_write(sdow, sv_kv)) {
+		*cb_return_val = SDO_SI_INTERNAL_ERROR;
+		goto end;
+	}
+	dsi_skip_sent(dsi_info);
+	ret = true;
+
+end:
+	sdo_sv_key_value_free(sv_kv);
+	return ret;
+}
+
+#ifdef DSI_PREFETCH_THREAD
+/**
+ * Internal API
+ * @return true if the DSIs of module are built by the producer.
+ */
+static bool dsi_prefetched(sdo_sdk_service_info_module_list_t *module)
+{
+	return module->module.service_info_callback_v2 &&
+	       (module->module.flags & SDO_SI_FLAG_PREFETCH_DSI);
+}
+
+/**
+ * Internal API
+ * Build and serialize the DSI at pos, and move pos on.
+ * @return the serialized DSI, or NULL with cb_return_val set on failure.
+ */
+static dsi_ready_t *dsi_build(sdo_sv_info_dsi_info_t *pos, int *cb_return_val)
+{
+	sdo_sdk_si_key_value *sv_kv = sdo_alloc(sizeof(sdo_sdk_si_key_value));
+	dsi_ready_t *r = NULL;
+	sdow_t w = {0};
+
+	*cb_return_val = SDO_SI_INTERNAL_ERROR;
+	if (!sv_kv)
+		return NULL;
+
+	if (!sdow_init(&w))
+		goto end;
+	if (!sdo_construct_module_dsi(pos, sv_kv, cb_return_val)) {
+		LOG(LOG_DEBUG, "Sv_info: module DSI Construction Failed\n");
+		goto end;
+	}
+	dsi_skip_sent(pos);
+
+	*cb_return_val = SDO_SI_INTERNAL_ERROR;
+	if (!sdo_mod_kv_write(&w, sv_kv) || !w.b.block)
+		goto end;
+	r = sdo_alloc(sizeof(*r) + w.b.cursor);
+	if (!r)
+		goto end;
+	if (memcpy_s(r + 1, w.b.cursor, w.b.block, w.b.cursor) != 0) {
+		sdo_free(r);
+		goto end;
+	}
+	r->len = w.b.cursor;
+	*cb_return_val = SDO_SI_SUCCESS;
+
+end:
+	if (w.b.block)
+		sdo_free(w.b.block);
+	sdo_sv_key_value_free(sv_kv);
+	return r;
+}
+
+/**
+ * Internal API
+ * Producer thread: build the DSIs of the prefetched modules in order,
+ * staying at most SDO_DSI_PREFETCH_DEPTH ahead of msg46, until they are all
+ * built, a callback fails or it is told to stop.
+ * @param arg - the prefetch state.
+ */
+static void *dsi_producer(void *arg)
+{
+	struct sdo_dsi_prefetch_s *pf = arg;
+	dsi_ready_t *r;
+	unsigned int i;
+	bool done;
+	int ret;
+
+	(void)pthread_mutex_lock(&pf->lock);
+	while (!pf->stop) {
+		if (pf->count == SDO_DSI_PREFETCH_DEPTH) {
+			(void)pthread_cond_wait(&pf->cond, &pf->lock);
+			continue;
+		}
+		(void)pthread_mutex_unlock(&pf->lock);
+
+		/* the other modules' DSIs are built within msg46 */
+		while (pf->next.list_dsi && !dsi_prefetched(pf->next.list_dsi)) {
+			pf->next.list_dsi = pf->next.list_dsi->next;
+			pf->next.module_dsi_index = 0;
+			dsi_skip_sent(&pf->next);
+		}
+		done = !pf->next.list_dsi;
+		r = done ? NULL : dsi_build(&pf->next, &ret);
+
+		(void)pthread_mutex_lock(&pf->lock);
+		if (r) {
+			i = (pf->head + pf->count) % SDO_DSI_PREFETCH_DEPTH;
+			pf->ready[i] = r;
+			pf->count++;
+		} else if (done) {
+			pf->done = true;
+		} else {
+			pf->status = ret;
+		}
+		(void)pthread_cond_broadcast(&pf->cond);
+		if (!r)
+			break;
+	}
+	(void)pthread_mutex_unlock(&pf->lock);
+	return NULL;
+}
+
+/**
+ * Internal API
+ * Wait for the next prefetched DSI and write it to sdow.
+ */
+static bool dsi_write_prefetched(sdo_sv_info_dsi_info_t *dsi_info,
+				 sdow_t *sdow, int *cb_return_val)
+{
+	struct sdo_dsi_prefetch_s *pf = dsi_info->prefetch;
+	dsi_ready_t *r = NULL;
+	bool ret;
+
+	(void)pthread_mutex_lock(&pf->lock);
+	while (!pf->count && !pf->done && pf->status == SDO_SI_SUCCESS)
+		(void)pthread_cond_wait(&pf->cond, &pf->lock);
+	if (pf->count) {
+		r = pf->ready[pf->head];
+		pf->head = (pf->head + 1) % SDO_DSI_PREFETCH_DEPTH;
+		pf->count--;
+		(void)pthread_cond_broadcast(&pf->cond);
+	}
+	*cb_return_val = pf->status;
+	(void)pthread_mutex_unlock(&pf->lock);
+
+	if (!r) {
+		/* done early means msg46 and the producer lost step */
+		if (*cb_return_val == SDO_SI_SUCCESS) {
+			LOG(LOG_ERROR, "Sv_info: %s has no DSI ready\n",
+			    dsi_info->list_dsi->module.module_name);
+			*cb_return_val = SDO_SI_INTERNAL_ERROR;
+		}
+		return false;
+	}
+
+	*cb_return_val = SDO_SI_SUCCESS;
+	ret = sdo_write_serialized(sdow, (uint8_t *)(r + 1), r->len);
+	sdo_free(r);
+	if (!ret) {
+		*cb_return_val = SDO_SI_INTERNAL_ERROR;
+		return false;
+	}
+
+	dsi_info->module_dsi_index++;
+	dsi_skip_sent(dsi_info);
+	return true;
+}
+#endif
+
+/**
+ * Start building the DSIs of prefetched modules from the position of the
+ * next DSI msg46 sends. Does nothing if the producer runs already, no
+ * module ahead asks for it, or the SDK has no threads; msg46 then builds
+ * the DSIs itself.
+ * @param dsi_info - position of the next module DSI.
+ */
+void sdo_dsi_prefetch_start(sdo_sv_info_dsi_info_t *dsi_info)
+{
+#ifdef DSI_PREFETCH_THREAD
+	sdo_sdk_service_info_module_list_t *mod;
+	struct sdo_dsi_prefetch_s *pf;
+
+	if (!dsi_info || dsi_info->prefetch)
+		return;
+
+	for (mod = dsi_info->list_dsi; mod && !dsi_prefetched(mod);
+	     mod = mod->next)
+		;
+	if (!mod)
+		return;
+
+	pf = sdo_alloc(sizeof(*pf));
+	if (!pf)
+		return;
+
+	pf->next = *dsi_info;
+	dsi_skip_sent(&pf->next);
+	pf->status = SDO_SI_SUCCESS;
+	if (pthread_mutex_init(&pf->lock, NULL) != 0)
+		goto err_lock;
+	if (pthread_cond_init(&pf->cond, NULL) != 0)
+		goto err_cond;
+	if (pthread_create(&pf->thread, NULL, dsi_producer, pf) != 0)
+		goto err_thread;
+	dsi_info->prefetch = pf;
+	return;
+
+err_thread:
+	(void)pthread_cond_destroy(&pf->cond);
+err_cond:
+	(void)pthread_mutex_destroy(&pf->lock);
+err_lock:
+	LOG(LOG_ERROR, "Sv_info: no DSI producer, building DSIs in place\n");
+	sdo_free(pf);
+#else
+	(void)dsi_info;
+#endif
+}
+
+/**
+ * Write the next module DSI to msg46 and move the DSI position on.
+ * @param dsi_info - position of the next module DSI.
+ * @param sdow - msg46 being written.
+ * @param cb_return_val - filled with SDO_SI_SUCCESS, or the failure of the
+ * callback that was to build this DSI.
+ * @return true if success, false otherwise.
+ */
+bool sdo_dsi_write_next(sdo_sv_info_dsi_info_t *dsi_info, sdow_t *sdow,
+			int *cb_return_val)
+{
+	if (!cb_return_val)
+		return false;
+
+	*cb_return_val = SDO_SI_INTERNAL_ERROR;
+	if (!dsi_info || !sdow)
+		return false;
+
+	dsi_skip_sent(dsi_info);
+	if (!dsi_info->list_dsi) {
+		LOG(LOG_ERROR, "Sv_info: no module DSI left to send\n");
+		return false;
+	}
+
+#ifdef DSI_PREFETCH_THREAD
+	if (dsi_prefetched(dsi_info->list_dsi)) {
+		sdo_dsi_prefetch_start(dsi_info);
+		if (dsi_info->prefetch)
+			return dsi_write_prefetched(dsi_info, sdow,
+						    cb_return_val);
+	}
+#endif
+
+	return dsi_write_in_place(dsi_info, sdow, cb_return_val);
+}
+
+/**
+ * Stop the producer, dropping the DSIs it has built but msg46 has not sent.
+ * Called after the last msg46 and on the way out of TO2, so that no
+ * SDO_SI_GET_DSI runs once the modules get SDO_SI_END or SDO_SI_FAILURE.
+ * Calling it again does nothing.
+ * @param dsi_info - position of the next module DSI.
+ */
+void sdo_dsi_prefetch_stop(sdo_sv_info_dsi_info_t *dsi_info)
+{
+#ifdef DSI_PREFETCH_THREAD
+	struct sdo_dsi_prefetch_s *pf;
+
+	if (!dsi_info || !dsi_info->prefetch)
+		return;
+	pf = dsi_info->prefetch;
+
+	(void)pthread_mutex_lock(&pf->lock);
+	pf->stop = true;
+	(void)pthread_cond_broadcast(&pf->cond);
+	(void)pthread_mutex_unlock(&pf->lock);
+	(void)pthread_join(pf->thread, NULL);
+
+	while (pf->count) {
+		sdo_free(pf->ready[pf->head]);
+		pf->head = (pf->head + 1) % SDO_DSI_PREFETCH_DEPTH;
+		pf->count--;
+	}
+	(void)pthread_cond_destroy(&pf->cond);
+	(void)pthread_mutex_destroy(&pf->lock);
+	sdo_free(pf);
+	dsi_info->prefetch = NULL;
+#else
+	(void)dsi_info;
+#endif
+}
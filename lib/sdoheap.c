@@ -0,0 +1,489 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Accounting of the heap the SDK allocates with sdo_alloc().
+ *
+ * Built with HEAP_TRACK=true, sdo_alloc(), sdo_realloc() and sdo_free()
+ * keep every live allocation in a table, keyed by its address, with its
+ * size, the caller of sdo_alloc() and the message whose handler ran last
+ * on the thread. The message is kept from the start of its handler to the
+ * start of the next, so the buffers of its round trip count for it; its
+ * protocol gives the phase, DI, TO1, TO2 or none. Live and peak bytes are
+ * kept per phase and per message, where the peak is the most bytes live in
+ * the whole SDK while the message ran: that is what a RAM budget is sized
+ * by. sdo_free() of memory that sdo_alloc() did not return (strdup(),
+ * OpenSSL) is not counted.
+ *
+ * sdo_sdk_deinit() lists what was allocated since sdo_sdk_init() and is
+ * still live. With a budget set by sdo_sdk_set_heap_budget(), an allocation
+ * that would take the SDK past it fails, as on a device with that much RAM.
+ */
+
+#ifdef HEAP_TRACK_ENABLED
+#define _GNU_SOURCE /* dladdr() */
+#endif
+
+#include "util.h"
+#include "sdoheap.h"
+#include "sdostats.h"
+#include "sdo.h"
+#include "safe_lib.h"
+
+#ifdef HEAP_TRACK_ENABLED
+#include <dlfcn.h>
+#include <pthread.h>
+
+/* One live allocation */
+typedef struct {
+	void *ptr; /* NULL for a free slot */
+	uint32_t size;
+	uint32_t session; /* sdo_sdk_init() it was made after */
+	int msg;	  /* message running on the thread, 0 for none */
+	const void *caller;
+} heap_entry_t;
+
+/* Slots the table starts with; it doubles once half of them are taken */
+#define HEAP_TABLE_MIN 1024
+
+static struct {
+	pthread_mutex_t lock;
+	heap_entry_t *table;
+	size_t slots;
+	size_t used;
+	uint32_t session;
+	uint64_t budget; /* 0 for none */
+	sdo_sdk_heap_stats stats;
+} heap = {PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0, 0, {{0}}};
+
+static __thread int heap_msg;
+#endif
+
+/**
+ * Internal API
+ * Size class of an allocation.
+ * @return n for sizes up to 16 << n bytes, the last class for larger ones.
+ */
+uint32_t sdo_heap_size_class(size_t size)
+{
+	uint32_t c = 0;
+
+	while (c < SDO_HEAP_SIZE_CLASSES - 1 && size > ((size_t)16 << c))
+		c++;
+	return c;
+}
+
+#ifdef HEAP_TRACK_ENABLED
+/**
+ * Internal API
+ * First slot to look for an address in.
+ */
+static size_t heap_slot_of(const void *ptr)
+{
+	uint64_t h = (uint64_t)(uintptr_t)ptr * 0x9e3779b97f4a7c15ULL;
+
+	return (size_t)(h >> 32) & (heap.slots - 1);
+}
+
+/**
+ * Internal API
+ * Slot of a live allocation, or of the free slot it would go into.
+ */
+static size_t heap_find(const void *ptr)
+{
+	size_t i = heap_slot_of(ptr);
+
+	while (heap.table[i].ptr && heap.table[i].ptr != ptr)
+		i = (i + 1) & (heap.slots - 1);
+	return i;
+}
+
+/**
+ * Internal API
+ * Double the table, or allocate it.
+ * @return false if there is no memory for it.
+ */
+static bool heap_grow(void)
+{
+	heap_entry_t *old = heap.table;
+	size_t old_slots = heap.slots;
+	size_t i;
+
+	heap.slots = old_slots ? 2 * old_slots : HEAP_TABLE_MIN;
+	/* not sdo_alloc(): the table does not count itself */
+	heap.table = calloc(heap.slots, sizeof(*heap.table));
+	if (!heap.table) {
+		heap.table = old;
+		heap.slots = old_slots;
+		return false;
+	}
+
+	for (i = 0; i < old_slots; i++)
+		if (old[i].ptr)
+			heap.table[heap_find(old[i].ptr)] = old[i];
+	free(old);
+	return true;
+}
+
+/**
+ * Internal API
+ * Free slot i, moving up the entries after it that would no longer be
+ * found past it.
+ */
+static void heap_remove(size_t i)
+{
+	size_t mask = heap.slots - 1;
+	size_t j = i, k;
+
+	for (;;) {
+		j = (j + 1) & mask;
+		if (!heap.table[j].ptr)
+			break;
+		k = heap_slot_of(heap.table[j].ptr);
+		/* entry j stays if its first slot lies in (i, j] */
+		if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+		heap.table[i] = heap.table[j];
+		i = j;
+	}
+	heap.table[i].ptr = NULL;
+	heap.used--;
+}
+
+/**
+ * Internal API
+ * Raise the peaks of the total and of a message and its phase to the bytes
+ * live now. Called with the lock.
+ */
+static void heap_peaks(int msg)
+{
+	sdo_sdk_heap_stats *s = &heap.stats;
+	uint64_t live = s->total.live_bytes;
+
+	if (live > s->total.peak_bytes)
+		s->total.peak_bytes = live;
+	if (live > s->phase[sdo_stats_phase_of(msg)].peak_bytes)
+		s->phase[sdo_stats_phase_of(msg)].peak_bytes = live;
+	if (msg > 0 && msg < SDO_STATS_MSG_MAX &&
+	    live > s->msg[msg].peak_bytes)
+		s->msg[msg].peak_bytes = live;
+}
+
+/**
+ * Internal API
+ * Count an allocation, or its free, for the total, its phase and its
+ * message. Called with the lock.
+ */
+static void heap_count(const heap_entry_t *e, bool alloc)
+{
+	sdo_sdk_heap_use *use[3];
+	int i, n = 0;
+
+	use[n++] = &heap.stats.total;
+	use[n++] = &heap.stats.phase[sdo_stats_phase_of(e->msg)];
+	if (e->msg > 0 && e->msg < SDO_STATS_MSG_MAX)
+		use[n++] = &heap.stats.msg[e->msg];
+
+	for (i = 0; i < n; i++) {
+		if (alloc) {
+			use[i]->allocs++;
+			use[i]->alloc_bytes += e->size;
+			use[i]->live_bytes += e->size;
+		} else {
+			use[i]->live_bytes -= e->size;
+		}
+	}
+
+	if (alloc) {
+		heap.stats.live_allocs++;
+		heap.stats.size_class[sdo_heap_size_class(e->size)]++;
+		heap_peaks(e->msg);
+	} else {
+		heap.stats.live_allocs--;
+		heap.stats.frees++;
+	}
+}
+
+/**
+ * Internal API
+ * Whether the budget leaves room for size more bytes, once free_bytes are
+ * freed. Counts a refusal. Called with the lock.
+ */
+static bool heap_admit(size_t size, size_t free_bytes)
+{
+	if (!heap.budget ||
+	    heap.stats.total.live_bytes - free_bytes + size <= heap.budget)
+		return true;
+	heap.stats.over_budget++;
+	return false;
+}
+
+/**
+ * Internal API
+ * Enter an allocation in the table and count it. Called with the lock.
+ * Without memory for a bigger table, the allocation is left out.
+ */
+static void heap_insert(void *ptr, size_t size, const void *caller)
+{
+	heap_entry_t *e;
+
+	if (2 * (heap.used + 1) > heap.slots && !heap_grow())
+		return;
+
+	e = &heap.table[heap_find(ptr)];
+	e->ptr = ptr;
+	e->size = (uint32_t)size;
+	e->session = heap.session;
+	e->msg = heap_msg;
+	e->caller = caller;
+	heap.used++;
+	heap_count(e, true);
+}
+
+/**
+ * Internal API
+ * Count a new allocation of sdo_alloc().
+ * @param ptr - the allocation.
+ * @param size - its size.
+ * @param caller - code that asked for it.
+ * @return false if it takes the SDK past the heap budget: it is not counted
+ * and has to be freed with free().
+ */
+bool sdo_heap_track(void *ptr, size_t size, const void *caller)
+{
+	bool ok;
+
+	(void)pthread_mutex_lock(&heap.lock);
+	ok = heap_admit(size, 0);
+	if (ok)
+		heap_insert(ptr, size, caller);
+	(void)pthread_mutex_unlock(&heap.lock);
+
+	if (!ok) {
+		LOG(LOG_ERROR, "Heap: %zu bytes would exceed the budget of "
+			       "%llu\n",
+		    size, (unsigned long long)heap.budget);
+	}
+	return ok;
+}
+
+/**
+ * Internal API
+ * realloc() of sdo_realloc(), counted.
+ * @return the new buffer, or NULL if there is no memory for it or it takes
+ * the SDK past the heap budget; ptr is then left as it is.
+ */
+void *sdo_heap_realloc(void *ptr, size_t size, const void *caller)
+{
+	size_t old_size = 0, i;
+	void *p;
+	bool ok;
+
+	(void)pthread_mutex_lock(&heap.lock);
+	if (ptr && heap.table) {
+		i = heap_find(ptr);
+		if (heap.table[i].ptr)
+			old_size = heap.table[i].size;
+	}
+	ok = heap_admit(size, old_size);
+	(void)pthread_mutex_unlock(&heap.lock);
+	if (!ok) {
+		LOG(LOG_ERROR, "Heap: %zu bytes would exceed the budget of "
+			       "%llu\n",
+		    size, (unsigned long long)heap.budget);
+		return NULL;
+	}
+
+	p = realloc(ptr, size);
+	if (!p)
+		return NULL;
+
+	(void)pthread_mutex_lock(&heap.lock);
+	if (ptr && heap.table) {
+		i = heap_find(ptr);
+		if (heap.table[i].ptr) {
+			heap_count(&heap.table[i], false);
+			heap_remove(i);
+		}
+	}
+	heap_insert(p, size, caller);
+	(void)pthread_mutex_unlock(&heap.lock);
+	return p;
+}
+
+/**
+ * Internal API
+ * sdo_free() of a HEAP_TRACK build: count the free, then free.
+ */
+void sdo_heap_free(void *ptr)
+{
+	size_t i;
+
+	if (!ptr)
+		return;
+
+	(void)pthread_mutex_lock(&heap.lock);
+	if (heap.table) {
+		i = heap_find(ptr);
+		if (heap.table[i].ptr) {
+			heap_count(&heap.table[i], false);
+			heap_remove(i);
+		}
+	}
+	(void)pthread_mutex_unlock(&heap.lock);
+	free(ptr);
+}
+#endif
+
+/**
+ * Internal API
+ * Charge the allocations of the calling thread to a message, from the start
+ * of its handler on.
+ * @param msg_type - the message, 0 for none.
+ */
+void sdo_heap_set_msg(int msg_type)
+{
+#ifdef HEAP_TRACK_ENABLED
+	heap_msg = msg_type;
+	(void)pthread_mutex_lock(&heap.lock);
+	heap_peaks(msg_type);
+	(void)pthread_mutex_unlock(&heap.lock);
+#else
+	(void)msg_type;
+#endif
+}
+
+/**
+ * Internal API
+ * Start a session at sdo_sdk_init(): what is allocated from here on and
+ * still live at sdo_sdk_deinit() is reported as leaked.
+ */
+void sdo_heap_session_start(void)
+{
+#ifdef HEAP_TRACK_ENABLED
+	(void)pthread_mutex_lock(&heap.lock);
+	heap.session++;
+	(void)pthread_mutex_unlock(&heap.lock);
+	heap_msg = 0;
+#endif
+}
+
+/**
+ * Internal API
+ * At sdo_sdk_deinit(): log the allocations of the session still live, the
+ * first SDO_HEAP_LEAKS_LISTED of them with the code that made them.
+ */
+void sdo_heap_leak_report(void)
+{
+#ifdef HEAP_TRACK_ENABLED
+	heap_entry_t leak[SDO_HEAP_LEAKS_LISTED];
+	uint64_t count = 0, bytes = 0, peak;
+	size_t i, listed = 0;
+	Dl_info info;
+
+	(void)pthread_mutex_lock(&heap.lock);
+	for (i = 0; i < heap.slots; i++) {
+		if (!heap.table[i].ptr || heap.table[i].session != heap.session)
+			continue;
+		if (listed < SDO_HEAP_LEAKS_LISTED)
+			leak[listed++] = heap.table[i];
+		count++;
+		bytes += heap.table[i].size;
+	}
+	heap.stats.leaked_allocs = count;
+	heap.stats.leaked_bytes = bytes;
+	peak = heap.stats.total.peak_bytes;
+	(void)pthread_mutex_unlock(&heap.lock);
+
+	LOG(LOG_INFO, "Heap: peak %llu bytes, %llu bytes in %llu allocations "
+		      "left by the session\n",
+	    (unsigned long long)peak, (unsigned long long)bytes,
+	    (unsigned long long)count);
+	for (i = 0; i < listed; i++) {
+		/* an offset in the binary, for addr2line */
+		if (dladdr(leak[i].caller, &info) && info.dli_fname) {
+			LOG(LOG_INFO, "Heap:   %u bytes from %s+0x%lx, msg%d\n",
+			    (unsigned int)leak[i].size, info.dli_fname,
+			    (unsigned long)((const char *)leak[i].caller -
+					    (const char *)info.dli_fbase),
+			    leak[i].msg);
+		} else {
+			LOG(LOG_INFO, "Heap:   %u bytes from %p, msg%d\n",
+			    (unsigned int)leak[i].size, leak[i].caller,
+			    leak[i].msg);
+		}
+	}
+#endif
+}
+
+/**
+ * Get the heap use of the SDK since the start of the process: allocations
+ * by size class, and allocated, live and peak bytes in total, per protocol
+ * (the last entry of phase[] is for allocations outside DI, TO1 and TO2)
+ * and per message type. An allocation counts for the message whose handler
+ * ran last on the thread that made it.
+ *
+ * @param out - filled with the heap use.
+ * @return SDO_SUCCESS, or SDO_ERROR if out is NULL or the SDK was built
+ * without HEAP_TRACK.
+ */
+sdo_sdk_status sdo_sdk_get_heap_stats(sdo_sdk_heap_stats *out)
+{
+#ifdef HEAP_TRACK_ENABLED
+	if (!out)
+		return SDO_ERROR;
+
+	(void)pthread_mutex_lock(&heap.lock);
+	*out = heap.stats;
+	(void)pthread_mutex_unlock(&heap.lock);
+	return SDO_SUCCESS;
+#else
+	(void)out;
+	return SDO_ERROR;
+#endif
+}
+
+/**
+ * Start the peaks of the heap use over, to measure the peak of what runs
+ * next: the total one from the bytes live now, those of the phases and
+ * messages from 0.
+ */
+void sdo_sdk_reset_heap_peaks(void)
+{
+#ifdef HEAP_TRACK_ENABLED
+	size_t i;
+
+	(void)pthread_mutex_lock(&heap.lock);
+	heap.stats.total.peak_bytes = heap.stats.total.live_bytes;
+	for (i = 0; i <= SDO_HEAP_PHASE_NONE; i++)
+		heap.stats.phase[i].peak_bytes = 0;
+	for (i = 0; i < SDO_STATS_MSG_MAX; i++)
+		heap.stats.msg[i].peak_bytes = 0;
+	(void)pthread_mutex_unlock(&heap.lock);
+#endif
+}
+
+/**
+ * Limit the bytes the SDK may have allocated at once. An allocation that
+ * would take it past the limit fails, and is counted in over_budget, so
+ * that a test run fails where a device with that much heap would.
+ *
+ * @param budget_bytes - the limit, 0 for none.
+ * @return SDO_SUCCESS, or SDO_ERROR if the SDK was built without
+ * HEAP_TRACK.
+ */
+sdo_sdk_status sdo_sdk_set_heap_budget(uint64_t budget_bytes)
+{
+#ifdef HEAP_TRACK_ENABLED
+	(void)pthread_mutex_lock(&heap.lock);
+	heap.budget = budget_bytes;
+	(void)pthread_mutex_unlock(&heap.lock);
+	return SDO_SUCCESS;
+#else
+	(void)budget_bytes;
+	return SDO_ERROR;
+#endif
+}
@@ -0,0 +1,1030 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Log records kept in per-thread rings and formatted later.
+ *
+ * Built with LOG_RING=true, LOG() does not format: it stores the address of
+ * its format string, the time, and the raw arguments (numbers as 8 bytes,
+ * strings copied) into a ring of fixed size records owned by the calling
+ * thread. No lock is taken; once the ring is full the oldest record is
+ * overwritten. A log thread wakes every SDO_LOG_DRAIN_MS, or as soon as a
+ * ring is half full, formats what is new across the rings in time order and
+ * prints the records within LOG_LEVEL, as LOG() would have printed them.
+ *
+ * Records of every level are kept, so debug logging stays on where it is
+ * not printed: after a failed TO2, sdo_sdk_log_dump() writes the last
+ * SDO_LOG_RING_SLOTS records of each thread to a file.
+ *
+ * The format string is kept by address, so it has to be a string literal,
+ * as it is for every LOG() of the SDK.
+ */
+
+#include <ctype.h>
+#include "util.h"
+#include "sdolog.h"
+#include "sdo.h"
+#include "safe_lib.h"
+
+#ifdef LOG_RING_ENABLED
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#endif
+
+/* Length modifiers of a conversion */
+enum log_len {
+	LOG_LEN_NONE,
+	LOG_LEN_HH,
+	LOG_LEN_H,
+	LOG_LEN_L,
+	LOG_LEN_LL,
+	LOG_LEN_J,
+	LOG_LEN_Z,
+	LOG_LEN_T,
+	LOG_LEN_LD,
+};
+
+/* One conversion specification of a format string */
+typedef struct {
+	char flags[8];
+	size_t nflags;
+	bool star_width;
+	bool star_prec;
+	int width; /* -1 if none */
+	int prec;  /* -1 if none */
+	enum log_len len;
+	char conv;
+} log_spec_t;
+
+/* Upper bound of a width or precision written in a format */
+#define LOG_SPEC_NUM_MAX 100000
+
+/**
+ * Internal API
+ * Parse the conversion specification that follows a '%'.
+ * @param p - first character after the '%'.
+ * @param s - filled with the specification.
+ * @return the character after the conversion, or NULL if it is not one
+ * LOG() may use.
+ */
+static const char *log_spec_parse(const char *p, log_spec_t *s)
+{
+	s->nflags = 0;
+	s->star_width = false;
+	s->star_prec = false;
+	s->width = -1;
+	s->prec = -1;
+	s->len = LOG_LEN_NONE;
+
+	while (*p && strchr("-+ #0'", *p)) {
+		if (s->nflags < sizeof(s->flags) - 1)
+			s->flags[s->nflags++] = *p;
+		p++;
+	}
+	s->flags[s->nflags] = '\0';
+
+	if (*p == '*') {
+		s->star_width = true;
+		p++;
+	}
+	for (; isdigit((unsigned char)*p); p++) {
+		if (s->width < 0)
+			s->width = 0;
+		if (s->width < LOG_SPEC_NUM_MAX)
+			s->width = s->width * 10 + (*p - '0');
+	}
+
+	if (*p == '.') {
+		s->prec = 0;
+		p++;
+		if (*p == '*') {
+			s->star_prec = true;
+			p++;
+		}
+		for (; isdigit((unsigned char)*p); p++) {
+			if (s->prec < LOG_SPEC_NUM_MAX)
+				s->prec = s->prec * 10 + (*p - '0');
+		}
+	}
+
+	switch (*p) {
+	case 'h':
+		s->len = LOG_LEN_H;
+		if (*++p == 'h') {
+			s->len = LOG_LEN_HH;
+			p++;
+		}
+		break;
+	case 'l':
+		s->len = LOG_LEN_L;
+		if (*++p == 'l') {
+			s->len = LOG_LEN_LL;
+			p++;
+		}
+		break;
+	case 'j':
+		s->len = LOG_LEN_J;
+		p++;
+		break;
+	case 'z':
+		s->len = LOG_LEN_Z;
+		p++;
+		break;
+	case 't':
+		s->len = LOG_LEN_T;
+		p++;
+		break;
+	case 'L':
+		s->len = LOG_LEN_LD;
+		p++;
+		break;
+	default:
+		break;
+	}
+
+	s->conv = *p;
+	if (!*p || !strchr("diouxXcspnfFeEgGaA%", *p))
+		return NULL;
+	/* wide characters and strings are not kept */
+	if ((*p == 'c' || *p == 's') && s->len != LOG_LEN_NONE)
+		return NULL;
+	return p + 1;
+}
+
+/**
+ * Internal API
+ * Append n bytes to a record.
+ */
+static bool log_put(uint8_t **p, const uint8_t *end, const void *v, size_t n)
+{
+	if ((size_t)(end - *p) < n || memcpy_s(*p, n, v, n) != 0)
+		return false;
+	*p += n;
+	return true;
+}
+
+/**
+ * Internal API
+ * Take the next n bytes of a record.
+ */
+static bool log_get(const uint8_t **p, const uint8_t *end, void *v, size_t n)
+{
+	if ((size_t)(end - *p) < n || memcpy_s(v, n, *p, n) != 0)
+		return false;
+	*p += n;
+	return true;
+}
+
+/**
+ * Internal API
+ * Store the arguments of a LOG() call the way sdo_log_render() takes them:
+ * integers, pointers and doubles as 8 bytes, a string as a 16 bit length
+ * followed by its characters.
+ * @param buf - record arguments.
+ * @param size - bytes of buf.
+ * @param fmt - format of the call.
+ * @param ap - its arguments.
+ * @param truncated - set if not all of them fit.
+ * @return bytes of buf used.
+ */
+size_t sdo_log_encode(uint8_t *buf, size_t size, const char *fmt,
+		      va_list ap, bool *truncated)
+{
+	uint8_t *p = buf;
+	const uint8_t *limit = buf + size;
+	log_spec_t s;
+	const char *str;
+	int64_t i;
+	uint64_t u;
+	double d;
+	size_t room, n;
+	uint16_t n16;
+
+	*truncated = false;
+	while ((fmt = strchr(fmt, '%')) != NULL) {
+		fmt = log_spec_parse(fmt + 1, &s);
+		if (!fmt)
+			break; /* sdo_log_render() stops there as well */
+
+		if (s.star_width) {
+			i = va_arg(ap, int);
+			if (!log_put(&p, limit, &i, sizeof(i)))
+				goto full;
+		}
+		if (s.star_prec) {
+			i = va_arg(ap, int);
+			s.prec = i < 0 ? -1 : (int)i;
+			if (!log_put(&p, limit, &i, sizeof(i)))
+				goto full;
+		}
+
+		switch (s.conv) {
+		case 'd':
+		case 'i':
+			switch (s.len) {
+			case LOG_LEN_HH:
+				i = (signed char)va_arg(ap, int);
+				break;
+			case LOG_LEN_H:
+				i = (short)va_arg(ap, int);
+				break;
+			case LOG_LEN_L:
+				i = va_arg(ap, long);
+				break;
+			case LOG_LEN_LL:
+				i = va_arg(ap, long long);
+				break;
+			case LOG_LEN_J:
+				i = va_arg(ap, intmax_t);
+				break;
+			case LOG_LEN_Z:
+			case LOG_LEN_T:
+				i = va_arg(ap, ptrdiff_t);
+				break;
+			default:
+				i = va_arg(ap, int);
+				break;
+			}
+			if (!log_put(&p, limit, &i, sizeof(i)))
+				goto full;
+			break;
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+			switch (s.len) {
+			case LOG_LEN_HH:
+				u = (unsigned char)va_arg(ap, unsigned int);
+				break;
+			case LOG_LEN_H:
+				u = (unsigned short)va_arg(ap, unsigned int);
+				break;
+			case LOG_LEN_L:
+				u = va_arg(ap, unsigned long);
+				break;
+			case LOG_LEN_LL:
+				u = va_arg(ap, unsigned long long);
+				break;
+			case LOG_LEN_J:
+				u = va_arg(ap, uintmax_t);
+				break;
+			case LOG_LEN_Z:
+			case LOG_LEN_T:
+				u = va_arg(ap, size_t);
+				break;
+			default:
+				u = va_arg(ap, unsigned int);
+				break;
+			}
+			if (!log_put(&p, limit, &u, sizeof(u)))
+				goto full;
+			break;
+		case 'c':
+			i = va_arg(ap, int);
+			if (!log_put(&p, limit, &i, sizeof(i)))
+				goto full;
+			break;
+		case 'p':
+			u = (uintptr_t)va_arg(ap, void *);
+			if (!log_put(&p, limit, &u, sizeof(u)))
+				goto full;
+			break;
+		case 'n':
+			(void)va_arg(ap, void *);
+			break;
+		case '%':
+			break;
+		case 's':
+			str = va_arg(ap, const char *);
+			if (!str)
+				str = "(null)";
+			if ((size_t)(limit - p) <= sizeof(n16))
+				goto full;
+			room = (size_t)(limit - p) - sizeof(n16);
+			n = 0;
+			if (s.prec < 0 || (size_t)s.prec > room)
+				n = strnlen_s(str, room + 1);
+			else if (s.prec > 0)
+				n = strnlen_s(str, s.prec);
+			if (n > room) {
+				n = room;
+				*truncated = true;
+			}
+			n16 = (uint16_t)n;
+			if (!log_put(&p, limit, &n16, sizeof(n16)) ||
+			    (n && !log_put(&p, limit, str, n)))
+				goto full;
+			if (*truncated)
+				goto end;
+			break;
+		default:
+			if (s.len == LOG_LEN_LD)
+				d = (double)va_arg(ap, long double);
+			else
+				d = va_arg(ap, double);
+			if (!log_put(&p, limit, &d, sizeof(d)))
+				goto full;
+			break;
+		}
+	}
+	goto end;
+
+full:
+	*truncated = true;
+end:
+	return (size_t)(p - buf);
+}
+
+/**
+ * Internal API
+ * Write the conversion specification to hand to fprintf().
+ * @param spec - filled with it.
+ * @param size - bytes of spec.
+ * @param s - specification as parsed from the format.
+ * @param left - left alignment asked for by a negative '*' width.
+ * @param width - width, -1 for none.
+ * @param prec - precision, -1 for none.
+ * @param conv - length modifier and conversion to put at the end.
+ */
+static void log_spec_build(char *spec, size_t size, const log_spec_t *s,
+			   bool left, int width, int prec, const char *conv)
+{
+	int n;
+
+	n = snprintf(spec, size, "%%%s%s", s->flags, left ? "-" : "");
+	if (n > 0 && (size_t)n < size && width >= 0)
+		n += snprintf(spec + n, size - n, "%d", width);
+	if (n > 0 && (size_t)n < size && prec >= 0)
+		n += snprintf(spec + n, size - n, ".%d", prec);
+	if (n > 0 && (size_t)n < size)
+		(void)snprintf(spec + n, size - n, "%s", conv);
+}
+
+/**
+ * Internal API
+ * Format a record stored by sdo_log_encode().
+ * @param f - stream to write to.
+ * @param fmt - format of the LOG() call.
+ * @param buf - arguments of the record.
+ * @param len - bytes of buf.
+ * @param truncated - whether sdo_log_encode() ran out of room; the output
+ * then ends with " [...]" where the arguments do.
+ */
+void sdo_log_render(FILE *f, const char *fmt, const uint8_t *buf, size_t len,
+		    bool truncated)
+{
+	const uint8_t *p = buf;
+	const uint8_t *end = buf + len;
+	const char *start = fmt;
+	const char *c;
+	log_spec_t s;
+	char spec[48];
+	int64_t i;
+	uint64_t u;
+	double d;
+	uint16_t n16;
+	char conv[2] = {0};
+	int width, prec;
+	size_t flen;
+	bool left;
+
+	for (;;) {
+		c = strchr(fmt, '%');
+		if (!c) {
+			(void)fputs(fmt, f);
+			return;
+		}
+		(void)fwrite(fmt, 1, (size_t)(c - fmt), f);
+		fmt = log_spec_parse(c + 1, &s);
+		if (!fmt) {
+			/* printed as it is, nothing after it is stored */
+			(void)fputs(c, f);
+			return;
+		}
+
+		left = false;
+		width = s.width;
+		prec = s.prec;
+		if (s.star_width) {
+			if (!log_get(&p, end, &i, sizeof(i)))
+				goto cut;
+			left = i < 0;
+			width = (int)(left ? -i : i);
+		}
+		if (s.star_prec) {
+			if (!log_get(&p, end, &i, sizeof(i)))
+				goto cut;
+			prec = i < 0 ? -1 : (int)i;
+		}
+
+		switch (s.conv) {
+		case '%':
+			(void)fputc('%', f);
+			break;
+		case 'n':
+			break;
+		case 'd':
+		case 'i':
+			if (!log_get(&p, end, &i, sizeof(i)))
+				goto cut;
+			log_spec_build(spec, sizeof(spec), &s, left, width,
+				       prec, s.conv == 'd' ? "lld" : "lli");
+			(void)fprintf(f, spec, (long long)i);
+			break;
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+			if (!log_get(&p, end, &u, sizeof(u)))
+				goto cut;
+			log_spec_build(spec, sizeof(spec), &s, left, width,
+				       prec,
+				       s.conv == 'o'   ? "llo"
+				       : s.conv == 'u' ? "llu"
+				       : s.conv == 'x' ? "llx"
+						       : "llX");
+			(void)fprintf(f, spec, (unsigned long long)u);
+			break;
+		case 'c':
+			if (!log_get(&p, end, &i, sizeof(i)))
+				goto cut;
+			log_spec_build(spec, sizeof(spec), &s, left, width, -1,
+				       "c");
+			(void)fprintf(f, spec, (int)i);
+			break;
+		case 'p':
+			if (!log_get(&p, end, &u, sizeof(u)))
+				goto cut;
+			log_spec_build(spec, sizeof(spec), &s, left, width, -1,
+				       "p");
+			(void)fprintf(f, spec, (void *)(uintptr_t)u);
+			break;
+		case 's':
+			if (!log_get(&p, end, &n16, sizeof(n16)) ||
+			    (size_t)(end - p) < n16)
+				goto cut;
+			log_spec_build(spec, sizeof(spec), &s, left, width, -1,
+				       ".*s");
+			(void)fprintf(f, spec, (int)n16, (const char *)p);
+			p += n16;
+			break;
+		default:
+			if (!log_get(&p, end, &d, sizeof(d)))
+				goto cut;
+			conv[0] = s.conv;
+			log_spec_build(spec, sizeof(spec), &s, left, width,
+				       prec, conv);
+			(void)fprintf(f, spec, d);
+			break;
+		}
+
+		if (truncated && p == end)
+			goto cut;
+	}
+
+cut:
+	(void)fputs(" [...]", f);
+	flen = strnlen_s(start, SDO_MAX_STR_SIZE);
+	if (flen && start[flen - 1] == '\n')
+		(void)fputc('\n', f);
+}
+
+#ifdef LOG_RING_ENABLED
+/* Record flags */
+#define LOG_REC_TRUNCATED 0x1 /* arguments did not all fit */
+#define LOG_REC_HEX 0x2	      /* chunk of a hexdump() */
+#define LOG_REC_HEX_LAST 0x4  /* its last chunk */
+
+/* Bytes of a hexdump() each record holds: whole lines of 16 */
+#define LOG_HEX_LINE 16
+#define LOG_HEX_CHUNK (SDO_LOG_ARG_BYTES / LOG_HEX_LINE * LOG_HEX_LINE)
+
+/* One LOG() call, 256 bytes */
+typedef struct {
+	/* 2n + 2 once record n is written, odd while it is being written */
+	uint32_t seq;
+	uint8_t level;
+	uint8_t flags; /* LOG_REC_* */
+	uint16_t len;  /* bytes of args */
+	uint32_t line; /* offset of the chunk for a hexdump() */
+	uint64_t ts_us;
+	const char *file;
+	const char *fmt; /* message for a hexdump() */
+	uint8_t args[SDO_LOG_ARG_BYTES];
+} log_slot_t;
+
+typedef struct {
+	int owned;     /* taken by a running thread */
+	uint64_t head; /* records written, by the owner only */
+	log_slot_t slot[SDO_LOG_RING_SLOTS];
+} log_ring_t;
+
+static log_ring_t log_rings[SDO_LOG_RINGS];
+
+/* Held while records are formatted; never by a thread that logs */
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+/* records of each ring the log thread has printed */
+static uint64_t log_tail[SDO_LOG_RINGS];
+/* posted when a ring is half full, to wake the log thread early */
+static sem_t log_wake;
+/* set at exit, or if there is no log thread: LOG() prints right away */
+static bool log_direct;
+
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_key_t log_key;
+static __thread log_ring_t *thread_ring;
+
+/**
+ * Internal API
+ * Wall clock time in microseconds, as print_timestamp() shows it.
+ */
+static uint64_t log_now_us(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_REALTIME, &ts) != 0)
+		return 0;
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/**
+ * Internal API
+ * Print a time stamp the way print_timestamp() does.
+ */
+static void log_print_time(FILE *f, uint64_t ts_us)
+{
+	time_t sec = (time_t)(ts_us / 1000000);
+	char buf[TIMESTAMP_LEN];
+	struct tm t;
+
+	if (!localtime_r(&sec, &t) ||
+	    strftime(buf, sizeof(buf), "%T", &t) == 0) {
+		(void)fputs("Time_stamp ERROR\n", f);
+		return;
+	}
+	(void)fprintf(f, "%s:%3lu ", buf,
+		      (unsigned long)(ts_us % 1000000 / 1000));
+}
+
+/**
+ * Internal API
+ * Print a chunk of a hexdump() the way hexdump() prints it.
+ * @param message - title of the dump, printed with the first chunk.
+ * @param offset - offset of the chunk within the dump.
+ * @param bytes - the chunk.
+ * @param n - its length.
+ * @param last - whether the dump ends with it.
+ */
+static void log_render_hex(FILE *f, const char *message, size_t offset,
+			   const uint8_t *bytes, size_t n, bool last)
+{
+	size_t col, i;
+
+	if (!offset) {
+		(void)fprintf(f, "\n%s\n", message);
+		(void)fputs("-------------------------------------------------"
+			    "---------------------------\n",
+			    f);
+		(void)fputs("  offset: ", f);
+		for (col = 0; col < LOG_HEX_LINE; col++)
+			(void)fprintf(f, "%x%x ", (int)col, (int)col);
+		(void)fputs("| ", f);
+		for (col = 0; col < LOG_HEX_LINE; col++)
+			(void)fprintf(f, "%x", (int)col);
+		(void)fputs("\n--------: ", f);
+		for (col = 0; col < LOG_HEX_LINE; col++)
+			(void)fputs("---", f);
+		(void)fputs("|-", f);
+		for (col = 0; col < LOG_HEX_LINE; col++)
+			(void)fputc('-', f);
+		(void)fputc('\n', f);
+	}
+
+	for (i = 0; i < n; i += LOG_HEX_LINE) {
+		(void)fprintf(f, "%08x: ", (int)(offset + i));
+		for (col = 0; col < LOG_HEX_LINE; col++) {
+			if (i + col < n)
+				(void)fprintf(f, "%02x ", (int)bytes[i + col]);
+			else
+				(void)fputs("   ", f);
+		}
+		(void)fputs("| ", f);
+		for (col = 0; col < LOG_HEX_LINE; col++) {
+			if (i + col >= n)
+				(void)fputs("  ", f);
+			else if (isprint(bytes[i + col]))
+				(void)fputc(bytes[i + col], f);
+			else
+				(void)fputc('.', f);
+		}
+		(void)fputc('\n', f);
+	}
+	if (last)
+		(void)fputc('\n', f);
+}
+
+/**
+ * Internal API
+ * Print a record with the prefix LOG() gives its level.
+ */
+static void log_print(FILE *f, const log_slot_t *r)
+{
+	if (r->level == LOG_ERROR)
+		(void)fprintf(f, "ERROR:[%s:%u] ", r->file,
+			      (unsigned int)r->line);
+	if (r->level == LOG_DEBUG)
+		log_print_time(f, r->ts_us);
+
+	if (r->flags & LOG_REC_HEX)
+		log_render_hex(f, r->fmt, r->line, r->args, r->len,
+			       r->flags & LOG_REC_HEX_LAST);
+	else
+		sdo_log_render(f, r->fmt, r->args, r->len,
+			       r->flags & LOG_REC_TRUNCATED);
+}
+
+/**
+ * Internal API
+ * Copy record n of a ring, unless it is overwritten meanwhile.
+ */
+static bool log_slot_read(const log_ring_t *ring, uint64_t n, log_slot_t *out)
+{
+	const log_slot_t *s = &ring->slot[n % SDO_LOG_RING_SLOTS];
+	uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+
+	if (seq != (uint32_t)(2 * n + 2))
+		return false;
+	if (memcpy_s(out, sizeof(*out), s, sizeof(*s)) != 0)
+		return false;
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&s->seq, __ATOMIC_RELAXED) == seq;
+}
+
+/**
+ * Internal API
+ * Print the records of every ring from pos[] up to the newest, in time
+ * order across the rings, and move pos[] past them. Called with log_lock.
+ * @param max_level - records above it are skipped.
+ * @param lost - filled with the records overwritten before they were read.
+ * @return records printed.
+ */
+static uint64_t log_merge(FILE *f, uint64_t *pos, int max_level,
+			  uint64_t *lost)
+{
+	static log_slot_t next[SDO_LOG_RINGS];
+	bool have[SDO_LOG_RINGS];
+	uint64_t end[SDO_LOG_RINGS];
+	uint64_t printed = 0, head;
+	int i, pick;
+
+	*lost = 0;
+	for (i = 0; i < SDO_LOG_RINGS; i++) {
+		have[i] = false;
+		end[i] = __atomic_load_n(&log_rings[i].head, __ATOMIC_ACQUIRE);
+	}
+
+	for (;;) {
+		pick = -1;
+		for (i = 0; i < SDO_LOG_RINGS; i++) {
+			while (!have[i] && pos[i] < end[i]) {
+				head = __atomic_load_n(&log_rings[i].head,
+						       __ATOMIC_ACQUIRE);
+				if (head - pos[i] > SDO_LOG_RING_SLOTS) {
+					*lost += head - pos[i] -
+						 SDO_LOG_RING_SLOTS;
+					pos[i] = head - SDO_LOG_RING_SLOTS;
+					if (pos[i] >= end[i])
+						break;
+				}
+				if (log_slot_read(&log_rings[i], pos[i],
+						  &next[i])) {
+					have[i] = true;
+				} else {
+					(*lost)++;
+					pos[i]++;
+				}
+			}
+			if (have[i] &&
+			    (pick < 0 || next[i].ts_us < next[pick].ts_us))
+				pick = i;
+		}
+		if (pick < 0)
+			break;
+
+		if ((int)next[pick].level <= max_level) {
+			log_print(f, &next[pick]);
+			printed++;
+		}
+		have[pick] = false;
+		pos[pick]++;
+	}
+	return printed;
+}
+
+/**
+ * Internal API
+ * Print what is new in the rings.
+ * @return false once the log thread has to stop.
+ */
+static bool log_drain(void)
+{
+	uint64_t pos[SDO_LOG_RINGS];
+	uint64_t lost;
+	bool run;
+	int i;
+
+	(void)pthread_mutex_lock(&log_lock);
+	run = !__atomic_load_n(&log_direct, __ATOMIC_ACQUIRE);
+	if (run) {
+		for (i = 0; i < SDO_LOG_RINGS; i++)
+			pos[i] = log_tail[i];
+		if (log_merge(stdout, pos, LOG_LEVEL, &lost))
+			(void)fflush(stdout);
+		for (i = 0; i < SDO_LOG_RINGS; i++)
+			__atomic_store_n(&log_tail[i], pos[i],
+					 __ATOMIC_RELAXED);
+	}
+	(void)pthread_mutex_unlock(&log_lock);
+	return run;
+}
+
+/**
+ * Internal API
+ * Log thread: print the records every SDO_LOG_DRAIN_MS, or as soon as a
+ * ring is half full.
+ */
+static void *log_thread(void *arg)
+{
+	struct timespec t;
+
+	(void)arg;
+	do {
+		if (clock_gettime(CLOCK_REALTIME, &t) != 0)
+			break;
+		t.tv_nsec += SDO_LOG_DRAIN_MS * 1000000L;
+		if (t.tv_nsec >= 1000000000L) {
+			t.tv_sec++;
+			t.tv_nsec -= 1000000000L;
+		}
+		(void)sem_timedwait(&log_wake, &t);
+	} while (log_drain());
+	return NULL;
+}
+
+/**
+ * Internal API
+ * At exit: print what is left, and any later LOG() right away, as the log
+ * thread is not to touch stdout after exit() closes it.
+ */
+static void log_exit(void)
+{
+	(void)log_drain();
+	__atomic_store_n(&log_direct, true, __ATOMIC_RELEASE);
+}
+
+/**
+ * Internal API
+ * Free the ring of a thread as it exits; its records stay until they are
+ * overwritten by those of the next thread to take it.
+ */
+static void log_ring_release(void *ring)
+{
+	thread_ring = NULL;
+	__atomic_store_n(&((log_ring_t *)ring)->owned, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Internal API
+ * Start the log thread, with the first LOG() of the process.
+ */
+static void log_start(void)
+{
+	pthread_t t;
+
+	if (sem_init(&log_wake, 0, 0) != 0 ||
+	    pthread_key_create(&log_key, log_ring_release) != 0 ||
+	    pthread_create(&t, NULL, log_thread, NULL) != 0) {
+		__atomic_store_n(&log_direct, true, __ATOMIC_RELEASE);
+		return;
+	}
+	(void)pthread_detach(t);
+	(void)atexit(log_exit);
+}
+
+/**
+ * Internal API
+ * The ring of the calling thread, taken with its first LOG().
+ * @return the ring, or NULL if the record is to be printed right away: all
+ * SDO_LOG_RINGS rings are taken, or there is no log thread.
+ */
+static log_ring_t *log_ring_get(void)
+{
+	int i, free_ring;
+
+	if (thread_ring)
+		return __atomic_load_n(&log_direct, __ATOMIC_ACQUIRE)
+			   ? NULL
+			   : thread_ring;
+
+	(void)pthread_once(&log_once, log_start);
+	if (__atomic_load_n(&log_direct, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	for (i = 0; i < SDO_LOG_RINGS; i++) {
+		free_ring = 0;
+		if (__atomic_compare_exchange_n(&log_rings[i].owned, &free_ring,
+						1, false, __ATOMIC_ACQ_REL,
+						__ATOMIC_RELAXED)) {
+			thread_ring = &log_rings[i];
+			(void)pthread_setspecific(log_key, thread_ring);
+			return thread_ring;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Internal API
+ * Start the next record of a ring; it is not read before log_slot_commit().
+ */
+static log_slot_t *log_slot_begin(log_ring_t *ring)
+{
+	uint64_t n = ring->head;
+	log_slot_t *s = &ring->slot[n % SDO_LOG_RING_SLOTS];
+
+	__atomic_store_n(&s->seq, (uint32_t)(2 * n + 1), __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	return s;
+}
+
+/**
+ * Internal API
+ * Hand the record started by log_slot_begin() to the log thread.
+ */
+static void log_slot_commit(log_ring_t *ring, log_slot_t *s)
+{
+	uint64_t n = ring->head;
+	uint64_t tail = __atomic_load_n(&log_tail[ring - log_rings],
+					__ATOMIC_RELAXED);
+
+	__atomic_store_n(&s->seq, (uint32_t)(2 * n + 2), __ATOMIC_RELEASE);
+	__atomic_store_n(&ring->head, n + 1, __ATOMIC_RELEASE);
+	if (n + 1 - tail == SDO_LOG_RING_SLOTS / 2)
+		(void)sem_post(&log_wake);
+}
+
+/**
+ * Internal API
+ * LOG() of a LOG_RING build: keep a record for the log thread.
+ * @param level - LOG_ERROR to LOG_DEBUGNTS.
+ * @param file - source file of the call.
+ * @param line - its line.
+ * @param fmt - printf() format; a string literal.
+ */
+void sdo_log_record(int level, const char *file, int line, const char *fmt,
+		    ...)
+{
+	log_ring_t *ring = log_ring_get();
+	log_slot_t *s;
+	bool truncated;
+	va_list ap;
+
+	va_start(ap, fmt);
+	if (!ring) {
+		if (level > LOG_LEVEL)
+			goto end;
+		if (level == LOG_ERROR)
+			printf("ERROR:[%s:%d] ", file, line);
+		if (level == LOG_DEBUG)
+			log_print_time(stdout, log_now_us());
+		(void)vprintf(fmt, ap);
+		goto end;
+	}
+
+	s = log_slot_begin(ring);
+	s->level = (uint8_t)level;
+	s->line = (uint32_t)line;
+	s->ts_us = log_now_us();
+	s->file = file;
+	s->fmt = fmt;
+	s->len = (uint16_t)sdo_log_encode(s->args, sizeof(s->args), fmt, ap,
+					  &truncated);
+	s->flags = truncated ? LOG_REC_TRUNCATED : 0;
+	log_slot_commit(ring, s);
+end:
+	va_end(ap);
+}
+
+/**
+ * Internal API
+ * hexdump() of a LOG_RING build: keep the bytes, a record per
+ * LOG_HEX_CHUNK of them, rather than a record per character printed.
+ * @param level - level of the dump.
+ * @param message - title of the dump; a string literal.
+ * @param buffer - bytes to dump.
+ * @param size - their number.
+ */
+void sdo_log_record_hex(int level, const char *message, const void *buffer,
+			size_t size)
+{
+	log_ring_t *ring = log_ring_get();
+	const uint8_t *bytes = buffer;
+	size_t offset = 0, n;
+	log_slot_t *s;
+
+	if (!bytes)
+		size = 0;
+
+	do {
+		n = size - offset;
+		if (n > LOG_HEX_CHUNK)
+			n = LOG_HEX_CHUNK;
+
+		if (!ring) {
+			if (level <= LOG_LEVEL)
+				log_render_hex(stdout, message, offset,
+					       bytes + offset, n,
+					       offset + n == size);
+		} else {
+			s = log_slot_begin(ring);
+			s->level = (uint8_t)level;
+			s->flags = LOG_REC_HEX;
+			if (offset + n == size)
+				s->flags |= LOG_REC_HEX_LAST;
+			s->line = (uint32_t)offset;
+			s->ts_us = log_now_us();
+			s->file = NULL;
+			s->fmt = message;
+			s->len = (uint16_t)n;
+			if (n && memcpy_s(s->args, sizeof(s->args),
+					  bytes + offset, n) != 0)
+				s->len = 0;
+			log_slot_commit(ring, s);
+		}
+		offset += n;
+	} while (offset < size);
+}
+#endif
+
+/**
+ * Internal API
+ * Print the records the log thread has not printed yet, so that what the
+ * application prints next comes after them.
+ */
+void sdo_log_flush(void)
+{
+#ifdef LOG_RING_ENABLED
+	(void)log_drain();
+#endif
+}
+
+/**
+ * Write the records still held in the log rings of the SDK, of every level
+ * whatever LOG_LEVEL is, oldest first: the last SDO_LOG_RING_SLOTS records
+ * of each thread. Meant for a post-mortem of a failed run, e.g. from the
+ * error callback.
+ *
+ * @param path - file to create, or NULL for stdout.
+ * @return SDO_SUCCESS, or SDO_ERROR if the file cannot be written or the
+ * SDK was built without LOG_RING.
+ */
+sdo_sdk_status sdo_sdk_log_dump(const char *path)
+{
+#ifdef LOG_RING_ENABLED
+	sdo_sdk_status ret = SDO_SUCCESS;
+	uint64_t pos[SDO_LOG_RINGS];
+	uint64_t head, lost;
+	FILE *f = stdout;
+	int i;
+
+	if (path) {
+		f = fopen(path, "w");
+		if (!f) {
+			LOG(LOG_ERROR, "Log: cannot create %s\n", path);
+			return SDO_ERROR;
+		}
+	}
+
+	(void)pthread_mutex_lock(&log_lock);
+	for (i = 0; i < SDO_LOG_RINGS; i++) {
+		head = __atomic_load_n(&log_rings[i].head, __ATOMIC_ACQUIRE);
+		pos[i] = head > SDO_LOG_RING_SLOTS ? head - SDO_LOG_RING_SLOTS
+						   : 0;
+	}
+	(void)log_merge(f, pos, LOG_MAX_LEVEL, &lost);
+	(void)pthread_mutex_unlock(&log_lock);
+
+	if (ferror(f))
+		ret = SDO_ERROR;
+	if (path ? fclose(f) != 0 : fflush(f) != 0)
+		ret = SDO_ERROR;
+	return ret;
+#else
+	(void)path;
+	return SDO_ERROR;
+#endif
+}
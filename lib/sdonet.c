@@ -6,12 +6,15 @@
 #include "util.h"
 #include "network_al.h"
 #include "sdonet.h"
+#include "sdobackoff.h"
 #include "sdotypes.h"
 #include "safe_lib.h"
 #include <stdlib.h>
 #include "storage_al.h"
 #include "rest_interface.h"
 #include "safe_str_lib.h"
+#include "sdoctx.h"
+#include "sdostats.h"
 
 #if defined HTTPPROXY
 #ifdef TARGET_OS_FREERTOS
@@ -25,14 +28,6 @@
 #include <proxy.h>
 #endif
 #endif
-
-/* HTTP Proxy parameters */
-static sdo_ip_address_t rvproxy_ip;
-static uint16_t rvproxy_port;
-static sdo_ip_address_t mfgproxy_ip;
-static uint16_t mfgproxy_port;
-static sdo_ip_address_t ownerproxy_ip;
-static uint16_t ownerproxy_port;
 #endif // defined HTTPPROXY
 
 /**
@@ -41,7 +36,7 @@ static uint16_t ownerproxy_port;
 bool is_rv_proxy_defined(void)
 {
 #if defined HTTPPROXY
-	if (rvproxy_port != 0)
+	if (sdo_ctx_current()->rvproxy_port != 0)
 		return true;
 	LOG(LOG_DEBUG, "Proxy enabled but Not set\n");
 #endif // defined HTTPPROXY
@@ -54,7 +49,7 @@ bool is_rv_proxy_defined(void)
 bool is_mfg_proxy_defined(void)
 {
 #if defined HTTPPROXY
-	if (mfgproxy_port != 0)
+	if (sdo_ctx_current()->mfgproxy_port != 0)
 		return true;
 	LOG(LOG_DEBUG, "Proxy enabled but Not set\n");
 #endif // defined HTTPPROXY
@@ -67,7 +62,7 @@ bool is_mfg_proxy_defined(void)
 bool is_owner_proxy_defined(void)
 {
 #if defined HTTPPROXY
-	if (ownerproxy_port != 0)
+	if (sdo_ctx_current()->ownerproxy_port != 0)
 		return true;
 	LOG(LOG_DEBUG, "Proxy enabled but Not set\n");
 #endif // defined HTTPPROXY
@@ -110,6 +105,7 @@ static bool get_netip_port(const char *proxydata, uint8_t proxydatsize,
 	}
 
 	// resolve dn proxy-chain.intel.com
+	sdo_stats_dns_lookup();
 	if (sdo_con_dns_lookup(proxy_url, &ip_list, &num_ofIPs) == -1) {
 		LOG(LOG_ERROR, "DNS look-up failed!\n");
 		goto err;
@@ -273,35 +269,40 @@ err:
 void sdo_net_init(void)
 {
 #if defined HTTPPROXY
-	if (setup_http_proxy(MFG_PROXY, &mfgproxy_ip, &mfgproxy_port)) {
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+
+	if (setup_http_proxy(MFG_PROXY, &ctx->mfgproxy_ip,
+			     &ctx->mfgproxy_port)) {
 		LOG(LOG_INFO, "Manufacturer HTTP proxy has been configured\n");
 	}
 #if defined(PROXY_DISCOVERY)
 
 	else {
-		if (discover_proxy(&mfgproxy_ip, &mfgproxy_port))
+		if (discover_proxy(&ctx->mfgproxy_ip, &ctx->mfgproxy_port))
 			LOG(LOG_INFO, "Manufacturer HTTP proxy has been "
 				      "discovered & configured\n");
 	}
 #endif
 
-	if (setup_http_proxy(RV_PROXY, &rvproxy_ip, &rvproxy_port)) {
+	if (setup_http_proxy(RV_PROXY, &ctx->rvproxy_ip, &ctx->rvproxy_port)) {
 		LOG(LOG_INFO, "Rendezvous HTTP proxy has been configured\n");
 	}
 #if defined(PROXY_DISCOVERY)
 	else {
-		if (discover_proxy(&rvproxy_ip, &rvproxy_port))
+		if (discover_proxy(&ctx->rvproxy_ip, &ctx->rvproxy_port))
 			LOG(LOG_INFO, "Rendezvous HTTP proxy has been "
 				      "discovered & configured\n");
 	}
 #endif
 
-	if (setup_http_proxy(OWNER_PROXY, &ownerproxy_ip, &ownerproxy_port)) {
+	if (setup_http_proxy(OWNER_PROXY, &ctx->ownerproxy_ip,
+			     &ctx->ownerproxy_port)) {
 		LOG(LOG_INFO, "Owner HTTP proxy has been configured\n");
 	}
 #if defined(PROXY_DISCOVERY)
 	else {
-		if (discover_proxy(&ownerproxy_ip, &ownerproxy_port))
+		if (discover_proxy(&ctx->ownerproxy_ip,
+				   &ctx->ownerproxy_port))
 			LOG(LOG_INFO, "Owner HTTP proxy has been discovered & "
 				      "configured\n");
 	}
@@ -355,6 +356,7 @@ bool resolve_dn(const char *dn, sdo_ip_address_t **ip, uint16_t port,
 		goto end;
 	}
 	// get list of IPs resolved to given DNS
+	sdo_stats_dns_lookup();
 	if (sdo_con_dns_lookup(dn, &ip_list, &num_ofIPs) == -1) {
 		LOG(LOG_ERROR, "DNS look-up failed!\n");
 		goto end;
@@ -402,82 +404,139 @@ end:
 	return ret;
 }
 
+static const char *const server_name[] = {
+    [SDO_SERVER_MFG] = "Manufacturer",
+    [SDO_SERVER_RV] = "Rendezvous",
+    [SDO_SERVER_OWNER] = "Owner",
+};
+
 /**
- * Connects device to manufacturer or cred tool. Connection info should be
- * programmed into device by the manufacturer.
+ * Pick the address to connect to for a server: cache the server address in
+ * the REST context (it goes into the request line) and substitute the HTTP
+ * proxy configured for the server, if any.
  *
- * @param ip:   IP address of the server to connect to.
- * @param port: Port number of the server instance to connect to.
- * @param sock_hdl: Sock struct for subsequent read/write/close.
- * @param ssl:  ssl fd for subsequent read/write/close in case of https.
+ * @param server: server to connect to.
+ * @param ip:   in server IP address, out IP address to connect to.
+ * @param port: in server port, out port to connect to.
+ * @param ssl:  in/out ssl fd requested for the connection, NULL for a plain
+ * connection. A proxy establishes TLS itself, so *ssl is cleared for it.
  *
  * @return ret
  *         true if successful. false in case of error.
  */
-bool connect_to_manufacturer(sdo_ip_address_t *ip, uint16_t port,
-			     sdo_con_handle *sock_hdl, void **ssl)
+bool sdo_net_target(sdo_server_t server, sdo_ip_address_t **ip,
+		    uint16_t *port, void ***ssl)
 {
-	bool ret = false;
-	int retries = MANUFACTURER_CONNECT_RETRIES;
-
-	LOG(LOG_DEBUG, "Connecting to manufacturer Server\n");
+#if defined HTTPPROXY
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
 
-	if (!sock_hdl) {
-		LOG(LOG_ERROR, "Connection handle (socket) is NULL\n");
-		goto end;
-	}
+#endif
+	LOG(LOG_DEBUG, "Connecting to %s server\n", server_name[server]);
 
 	/* cache ip/dns and port to REST */
-	if (ip) {
-		if (!cache_host_ip(ip)) {
-			LOG(LOG_ERROR,
-			    "Mfg IP-address caching to REST failed!\n");
-			goto end;
+	if (*ip) {
+		if (!cache_host_ip(*ip)) {
+			LOG(LOG_ERROR, "%s IP-address caching to REST failed!\n",
+			    server_name[server]);
+			return false;
 		}
 	}
 
-	if (!cache_host_port(port)) {
-		LOG(LOG_ERROR, "Mfg portno caching to REST failed!\n");
-		goto end;
+	if (!cache_host_port(*port)) {
+		LOG(LOG_ERROR, "%s portno caching to REST failed!\n",
+		    server_name[server]);
+		return false;
 	}
 
-	if (is_mfg_proxy_defined()) {
-#if defined HTTPPROXY
-		ip = &mfgproxy_ip;
-		port = mfgproxy_port;
+	if (*ssl && !cache_tls_connection()) {
+		LOG(LOG_ERROR, "REST TLS caching failed!\n");
+		return false;
+	}
 
-		LOG(LOG_DEBUG, "via HTTP proxy <%u.%u.%u.%u:%u>\n",
-		    mfgproxy_ip.addr[0], mfgproxy_ip.addr[1],
-		    mfgproxy_ip.addr[2], mfgproxy_ip.addr[3], mfgproxy_port);
+#if defined HTTPPROXY
+	if (server == SDO_SERVER_MFG && is_mfg_proxy_defined()) {
+		*ip = &ctx->mfgproxy_ip;
+		*port = ctx->mfgproxy_port;
+	} else if (server == SDO_SERVER_RV && is_rv_proxy_defined()) {
+		*ip = &ctx->rvproxy_ip;
+		*port = ctx->rvproxy_port;
+		// When connecting through proxy, the proxy server will
+		// establish tls connection. Device opens a normal connection to
+		// Proxy server
+		*ssl = NULL;
+	} else if (server == SDO_SERVER_OWNER && is_owner_proxy_defined()) {
+		*ip = &ctx->ownerproxy_ip;
+		*port = ctx->ownerproxy_port;
+	} else {
+		goto direct;
+	}
+	LOG(LOG_DEBUG, "via HTTP proxy <%u.%u.%u.%u:%u>\n", (*ip)->addr[0],
+	    (*ip)->addr[1], (*ip)->addr[2], (*ip)->addr[3], *port);
+direct:
 #endif
+
+	if (!*ip || (*ip)->length == 0) {
+		LOG(LOG_ERROR, "Invalid Connection info for %s server!\n",
+		    server_name[server]);
+		return false;
+	}
+	LOG(LOG_DEBUG, "using IP\n");
+	return true;
+}
+
+/**
+ * Internal API
+ * Connect to a server, retrying with the connect backoff policy.
+ */
+static bool connect_to_server(sdo_server_t server, sdo_ip_address_t *ip,
+			      uint16_t port, sdo_con_handle *sock_hdl,
+			      void **ssl)
+{
+	sdo_backoff_t backoff;
+
+	if (!sock_hdl) {
+		LOG(LOG_ERROR, "Connection handle (socket) is NULL\n");
+		return false;
 	}
 
-	if (ip && ip->length > 0) {
-		LOG(LOG_DEBUG, "using IP\n");
+	if (!sdo_net_target(server, &ip, &port, &ssl))
+		return false;
 
-		*sock_hdl = sdo_con_connect(ip, port, ssl);
-		if ((*sock_hdl == SDO_CON_INVALID_HANDLE) &&
-		    retries--) {
-			LOG(LOG_INFO, "Failed to connect to Manufacturer "
-				      "server: retrying...\n");
-			sdo_sleep(RETRY_DELAY);
-		}
-	} else {
-		LOG(LOG_ERROR,
-		    "Invalid Connection info for Manufacturer server!\n");
-		goto end;
+	sdo_backoff_init(&backoff, SDO_RETRY_CONNECT);
+	while ((*sock_hdl = sdo_con_connect(ip, port, ssl)) ==
+	       SDO_CON_INVALID_HANDLE) {
+		LOG(LOG_INFO, "Failed to connect to %s server: retrying...\n",
+		    server_name[server]);
+		if (!sdo_backoff_wait(&backoff))
+			break;
 	}
 
 	if (SDO_CON_INVALID_HANDLE == *sock_hdl) {
-		LOG(LOG_ERROR,
-		    "Failed to connect to Manufacturer server: Giving up...\n");
-		goto end;
+		LOG(LOG_ERROR, "Failed to connect to %s server: Giving up...\n",
+		    server_name[server]);
+		return false;
 	}
-	ret = true;
+	return true;
+}
 
-end:
-	return ret;
+/**
+ * Connects device to manufacturer or cred tool. Connection info should be
+ * programmed into device by the manufacturer.
+ *
+ * @param ip:   IP address of the server to connect to.
+ * @param port: Port number of the server instance to connect to.
+ * @param sock_hdl: Sock struct for subsequent read/write/close.
+ * @param ssl:  ssl fd for subsequent read/write/close in case of https.
+ *
+ * @return ret
+ *         true if successful. false in case of error.
+ */
+bool connect_to_manufacturer(sdo_ip_address_t *ip, uint16_t port,
+			     sdo_con_handle *sock_hdl, void **ssl)
+{
+	return connect_to_server(SDO_SERVER_MFG, ip, port, sock_hdl, ssl);
 }
+
 /**
  * Connects device to rendezvous server by picking the connection info
  * from RV list stored in device credentials.
@@ -493,80 +552,11 @@ end:
 bool connect_to_rendezvous(sdo_ip_address_t *ip, uint16_t port,
 			   sdo_con_handle *sock_hdl, void **ssl)
 {
-	bool ret = false;
-	int retries = RENDEZVOUS_CONNECT_RETRIES;
-
-	LOG(LOG_DEBUG, "Connecting to Rendezvous server\n");
-
-	if (!sock_hdl) {
-		LOG(LOG_ERROR, "Connection handle (socket) is NULL\n");
-		goto end;
-	}
-
-	/* cache ip/dns and port to REST */
-	if (ip) {
-		if (!cache_host_ip(ip)) {
-			LOG(LOG_ERROR, "REST IP-address caching failed!\n");
-			goto end;
-		}
-	} else {
-	}
-
-	if (!cache_host_port(port)) {
-		LOG(LOG_ERROR, "RV portno caching to REST failed!\n");
-		goto end;
-	}
-
-	if (ssl)
-		if (!cache_tls_connection()) {
-			LOG(LOG_ERROR, "REST TLS caching failed!\n");
-			goto end;
-		}
-
-	if (is_rv_proxy_defined()) {
-#if defined HTTPPROXY
-		ip = &rvproxy_ip;
-		port = rvproxy_port;
-		// When connecting through proxy, the proxy server will
-		// establish tls connection. Device opens a normal connection to
-		// Proxy server
-		ssl = NULL;
-
-		LOG(LOG_DEBUG, "via HTTP proxy <%u.%u.%u.%u:%u>\n",
-		    rvproxy_ip.addr[0], rvproxy_ip.addr[1], rvproxy_ip.addr[2],
-		    rvproxy_ip.addr[3], rvproxy_port);
-#endif
-	}
-
-	if (ip && ip->length > 0) {
-		LOG(LOG_DEBUG, "using IP\n");
-
-		*sock_hdl = sdo_con_connect(ip, port, ssl);
-		if ((*sock_hdl == SDO_CON_INVALID_HANDLE) &&
-		    retries--) {
-			LOG(LOG_INFO, "Failed to connect to Rendezvous server: "
-				      "retrying...\n");
-			sdo_sleep(RETRY_DELAY);
-		}
-	} else {
-		LOG(LOG_ERROR,
-		    "Invalid Connection info for Rendezvous server!\n");
-		goto end;
-	}
-
-	if (SDO_CON_INVALID_HANDLE == *sock_hdl) {
-		LOG(LOG_ERROR,
-		    "Failed to connect to rendezvous: Giving up...\n");
-		goto end;
-	}
-	ret = true;
-
-end:
-	return ret;
+	return connect_to_server(SDO_SERVER_RV, ip, port, sock_hdl, ssl);
 }
 
 /**
- * onnects device to owner by picking the connection info from info
+ * Connects device to owner by picking the connection info from info
  * received by Rendezvous stored in device credentials.
  *
  * @param ip:   IP address of the server to connect to.
@@ -580,65 +570,7 @@ end:
 bool connect_to_owner(sdo_ip_address_t *ip, uint16_t port,
 		      sdo_con_handle *sock_hdl, void **ssl)
 {
-	bool ret = false;
-	int retries = OWNER_CONNECT_RETRIES;
-
-	LOG(LOG_DEBUG, "Connecting to owner server\n");
-
-	if (!sock_hdl) {
-		LOG(LOG_ERROR, "Connection handle (socket) is NULL\n");
-		goto end;
-	}
-
-	/* cache ip/dns and port to REST */
-	if (ip) {
-		if (!cache_host_ip(ip)) {
-			LOG(LOG_ERROR,
-			    "Owner IP-address caching to REST failed!\n");
-			goto end;
-		}
-	}
-
-	if (!cache_host_port(port)) {
-		LOG(LOG_ERROR, "Owner portno caching to REST failed!\n");
-		goto end;
-	}
-
-	if (is_owner_proxy_defined()) {
-#if defined HTTPPROXY
-		ip = &ownerproxy_ip;
-		port = ownerproxy_port;
-
-		LOG(LOG_DEBUG, "via HTTP proxy <%u.%u.%u.%u:%u>\n",
-		    ownerproxy_ip.addr[0], ownerproxy_ip.addr[1],
-		    ownerproxy_ip.addr[2], ownerproxy_ip.addr[3],
-		    ownerproxy_port);
-#endif
-	}
-
-	if (ip && ip->length > 0) {
-		LOG(LOG_DEBUG, "using IP\n");
-
-		*sock_hdl = sdo_con_connect(ip, port, ssl);
-		if ((*sock_hdl == SDO_CON_INVALID_HANDLE) &&
-		    retries--) {
-			LOG(LOG_INFO,
-			    "Failed to connect to Owner server: retrying...\n");
-			sdo_sleep(RETRY_DELAY);
-		}
-	} else {
-		LOG(LOG_ERROR, "Invalid Connection info for Owner server!\n");
-		goto end;
-	}
-
-	if (SDO_CON_INVALID_HANDLE == *sock_hdl) {
-		LOG(LOG_ERROR, "Failed to connect to Owner: Giving up...\n");
-		goto end;
-	}
-	ret = true;
-
-end:
-	return ret;
+	return connect_to_server(SDO_SERVER_OWNER, ip, port, sock_hdl, ssl);
 }
 
 /**
@@ -652,15 +584,17 @@ end:
  */
 int sdo_connection_restablish(sdo_prot_ctx_t *prot_ctx)
 {
-	int retries = OWNER_CONNECT_RETRIES;
+	sdo_backoff_t backoff;
+
+	sdo_backoff_init(&backoff, SDO_RETRY_CONNECT);
 
 	/* re-connect using server-IP */
-	while (((prot_ctx->sock_hdl = sdo_con_connect(
-		     prot_ctx->host_ip, prot_ctx->host_port, prot_ctx->ssl)) ==
-		SDO_CON_INVALID_HANDLE) &&
-	       retries--) {
-		LOG(LOG_INFO, "Failed reconnecting to server: retrying...");
-		sdo_sleep(RETRY_DELAY);
+	while ((prot_ctx->sock_hdl = sdo_con_connect(
+		    prot_ctx->host_ip, prot_ctx->host_port, prot_ctx->ssl)) ==
+	       SDO_CON_INVALID_HANDLE) {
+		LOG(LOG_INFO, "Failed reconnecting to server: retrying...\n");
+		if (!sdo_backoff_wait(&backoff))
+			break;
 	}
 
 	if (prot_ctx->sock_hdl == SDO_CON_INVALID_HANDLE) {
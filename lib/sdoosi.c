@@ -0,0 +1,364 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Owner service info run on module worker threads.
+ *
+ * A v2 module registered with SDO_SI_FLAG_ASYNC_OSI gets its SDO_SI_SET_OSI
+ * callbacks on a worker thread of its own, so that a slow callback (a file
+ * write, an exec) overlaps with the msg48/msg49 round trip of the next
+ * owner service info instead of delaying it. msg49 copies each message into
+ * the module's queue and goes on; it only waits while the queue holds
+ * SDO_OSI_QUEUE_DEPTH messages.
+ *
+ * Callbacks of one module run one at a time, in the order the owner sent
+ * them. Before an OSI message goes to a module, the queues of all other
+ * modules are waited for, so callbacks of different modules still run in the
+ * order of their messages. Once a callback fails, the module's queued
+ * messages are dropped and no later OSI message is dispatched to any module:
+ * the failure is reported by the next msg48, by msg49 before it hands out
+ * another message, or at the latest by the join before msg50, so the TO2 run
+ * fails as it does with a synchronous module. Where the SDK has no threads,
+ * the callback runs within msg49.
+ */
+
+#include "util.h"
+#include "sdoosi.h"
+#include "safe_lib.h"
+
+#if defined(TARGET_OS_LINUX)
+#include <pthread.h>
+#define OSI_ASYNC_THREAD
+#endif
+
+/* One OSI message, key and value copied out of the msg49 buffer */
+typedef struct {
+	sdo_sdk_si_kv_view kv;
+	/* key bytes, then value bytes */
+} osi_work_t;
+
+struct sdo_osi_queue_s {
+	sdo_sdk_service_info_module_list_t *module;
+	osi_work_t *work[SDO_OSI_QUEUE_DEPTH];
+	unsigned int head;
+	unsigned int count;
+	bool busy; /* a callback is running */
+	bool stop;
+	int status; /* first callback failure, SDO_SI_SUCCESS until then */
+#ifdef OSI_ASYNC_THREAD
+	pthread_t thread;
+	pthread_mutex_t lock;
+	/* signalled when work is queued or taken, or the status changes */
+	pthread_cond_t cond;
+#endif
+};
+
+/**
+ * Internal API
+ * Hand one OSI message to the module and move its OSI index on.
+ * @return the callback's return value.
+ */
+static int osi_run(sdo_sdk_service_info_module_list_t *module,
+		   sdo_sdk_si_kv_view *kv)
+{
+	int ret;
+
+	ret = module->module.service_info_callback_v2(
+	    SDO_SI_SET_OSI, &module->module_osi_index, kv);
+	if (ret != SDO_SI_SUCCESS)
+		LOG(LOG_ERROR, "Sv_info: %s's CB Failed for type:%d\n",
+		    module->module.module_name, SDO_SI_SET_OSI);
+	module->module_osi_index++;
+	return ret;
+}
+
+#ifdef OSI_ASYNC_THREAD
+/**
+ * Internal API
+ * Worker thread: run the queued messages of one module until it is told to
+ * stop and the queue is empty.
+ * @param arg - the module's queue.
+ */
+static void *osi_worker(void *arg)
+{
+	struct sdo_osi_queue_s *q = arg;
+	osi_work_t *w;
+	int ret;
+
+	(void)pthread_mutex_lock(&q->lock);
+	for (;;) {
+		while (!q->count && !q->stop)
+			(void)pthread_cond_wait(&q->cond, &q->lock);
+		if (!q->count)
+			break;
+
+		w = q->work[q->head];
+		q->head = (q->head + 1) % SDO_OSI_QUEUE_DEPTH;
+		q->count--;
+		q->busy = true;
+		ret = q->status;
+		(void)pthread_cond_broadcast(&q->cond);
+		(void)pthread_mutex_unlock(&q->lock);
+
+		/* after a failure the rest is dropped, as msg49 would */
+		if (ret == SDO_SI_SUCCESS)
+			ret = osi_run(q->module, &w->kv);
+		sdo_free(w);
+
+		(void)pthread_mutex_lock(&q->lock);
+		if (q->status == SDO_SI_SUCCESS && ret != SDO_SI_SUCCESS)
+			q->status = ret;
+		q->busy = false;
+		(void)pthread_cond_broadcast(&q->cond);
+	}
+	(void)pthread_mutex_unlock(&q->lock);
+	return NULL;
+}
+
+/**
+ * Internal API
+ * Create the queue of a module and start its worker.
+ * @return the queue, or NULL if the worker could not be started.
+ */
+static struct sdo_osi_queue_s *
+osi_queue_start(sdo_sdk_service_info_module_list_t *module)
+{
+	struct sdo_osi_queue_s *q = sdo_alloc(sizeof(*q));
+
+	if (!q)
+		return NULL;
+
+	q->module = module;
+	q->status = SDO_SI_SUCCESS;
+	if (pthread_mutex_init(&q->lock, NULL) != 0)
+		goto err_lock;
+	if (pthread_cond_init(&q->cond, NULL) != 0)
+		goto err_cond;
+	if (pthread_create(&q->thread, NULL, osi_worker, q) != 0)
+		goto err_thread;
+	return q;
+
+err_thread:
+	(void)pthread_cond_destroy(&q->cond);
+err_cond:
+	(void)pthread_mutex_destroy(&q->lock);
+err_lock:
+	sdo_free(q);
+	return NULL;
+}
+
+/**
+ * Internal API
+ * Copy an OSI message out of the msg49 buffer, which is reused by the next
+ * message before the worker gets to it.
+ */
+static osi_work_t *osi_work_alloc(const sdo_sdk_si_kv_view *kv)
+{
+	osi_work_t *w = sdo_alloc(sizeof(*w) + kv->key.len + kv->value.len);
+	uint8_t *p;
+
+	if (!w)
+		return NULL;
+
+	p = (uint8_t *)(w + 1);
+	if ((kv->key.len &&
+	     memcpy_s(p, kv->key.len, kv->key.data, kv->key.len) != 0) ||
+	    (kv->value.len && memcpy_s(p + kv->key.len, kv->value.len,
+				       kv->value.data, kv->value.len) != 0)) {
+		sdo_free(w);
+		return NULL;
+	}
+	w->kv.key.data = p;
+	w->kv.key.len = kv->key.len;
+	w->kv.value.data = p + kv->key.len;
+	w->kv.value.len = kv->value.len;
+	return w;
+}
+#endif
+
+/**
+ * Queue an OSI message for a module registered with SDO_SI_FLAG_ASYNC_OSI.
+ * The worker of the module is started with its first message.
+ * @param module - the module's list entry.
+ * @param sv_kv - module message and value; copied, not kept.
+ * @param cb_return_val - filled with SDO_SI_SUCCESS, or with the failure of
+ * this or an earlier callback of the module.
+ * @return true if the message was queued (or, without a worker, handled).
+ */
+bool sdo_osi_async_dispatch(sdo_sdk_service_info_module_list_t *module,
+			    sdo_sdk_si_kv_view *sv_kv, int *cb_return_val)
+{
+#ifdef OSI_ASYNC_THREAD
+	struct sdo_osi_queue_s *q;
+	osi_work_t *w;
+#endif
+
+	if (!cb_return_val)
+		return false;
+
+	if (!module || !module->module.service_info_callback_v2 || !sv_kv) {
+		*cb_return_val = SDO_SI_INTERNAL_ERROR;
+		return false;
+	}
+
+#ifdef OSI_ASYNC_THREAD
+	q = module->osi_queue;
+	if (!q) {
+		q = osi_queue_start(module);
+		if (!q)
+			LOG(LOG_ERROR, "Sv_info: no worker for %s, running OSI "
+				       "in place\n",
+			    module->module.module_name);
+		module->osi_queue = q;
+	}
+	if (q) {
+		w = osi_work_alloc(sv_kv);
+		if (!w) {
+			*cb_return_val = SDO_SI_INTERNAL_ERROR;
+			return false;
+		}
+
+		(void)pthread_mutex_lock(&q->lock);
+		while (q->count == SDO_OSI_QUEUE_DEPTH &&
+		       q->status == SDO_SI_SUCCESS)
+			(void)pthread_cond_wait(&q->cond, &q->lock);
+		*cb_return_val = q->status;
+		if (q->status == SDO_SI_SUCCESS) {
+			q->work[(q->head + q->count) % SDO_OSI_QUEUE_DEPTH] = w;
+			q->count++;
+			w = NULL;
+			(void)pthread_cond_broadcast(&q->cond);
+		}
+		(void)pthread_mutex_unlock(&q->lock);
+
+		if (w) {
+			sdo_free(w);
+			return false;
+		}
+		return true;
+	}
+#endif
+
+	*cb_return_val = osi_run(module, sv_kv);
+	return *cb_return_val == SDO_SI_SUCCESS;
+}
+
+/**
+ * Check, without waiting, whether an OSI callback running on a worker has
+ * failed.
+ * @param module_list - Global Module List Head Pointer.
+ * @param cb_return_val - filled with the first failure found, or
+ * SDO_SI_SUCCESS. May be NULL.
+ * @return true if no callback failed so far.
+ */
+bool sdo_osi_async_status(sdo_sdk_service_info_module_list_t *module_list,
+			  int *cb_return_val)
+{
+	int status = SDO_SI_SUCCESS;
+
+#ifdef OSI_ASYNC_THREAD
+	for (; module_list && status == SDO_SI_SUCCESS;
+	     module_list = module_list->next) {
+		if (!module_list->osi_queue)
+			continue;
+		(void)pthread_mutex_lock(&module_list->osi_queue->lock);
+		status = module_list->osi_queue->status;
+		(void)pthread_mutex_unlock(&module_list->osi_queue->lock);
+	}
+#else
+	(void)module_list;
+#endif
+
+	if (cb_return_val)
+		*cb_return_val = status;
+	return status == SDO_SI_SUCCESS;
+}
+
+/**
+ * Make an OSI message for a module wait for the earlier ones: wait until the
+ * workers of all other modules have handled their queued messages, then
+ * check that no callback, of those modules or of this one, has failed.
+ * Called by msg49 before each OSI message is dispatched.
+ * @param module_list - Global Module List Head Pointer.
+ * @param module - module the next message is for, NULL for none.
+ * @param cb_return_val - filled with the first failure found, or
+ * SDO_SI_SUCCESS.
+ * @return true if the message may be dispatched.
+ */
+bool sdo_osi_async_settle(sdo_sdk_service_info_module_list_t *module_list,
+			  sdo_sdk_service_info_module_list_t *module,
+			  int *cb_return_val)
+{
+	int status = SDO_SI_SUCCESS;
+#ifdef OSI_ASYNC_THREAD
+	struct sdo_osi_queue_s *q;
+
+	for (; module_list && status == SDO_SI_SUCCESS;
+	     module_list = module_list->next) {
+		q = module_list->osi_queue;
+		if (!q)
+			continue;
+
+		(void)pthread_mutex_lock(&q->lock);
+		while (module_list != module && (q->count || q->busy) &&
+		       q->status == SDO_SI_SUCCESS)
+			(void)pthread_cond_wait(&q->cond, &q->lock);
+		status = q->status;
+		(void)pthread_mutex_unlock(&q->lock);
+	}
+#else
+	(void)module_list;
+	(void)module;
+#endif
+
+	if (cb_return_val)
+		*cb_return_val = status;
+	return status == SDO_SI_SUCCESS;
+}
+
+/**
+ * Wait for the queued OSI messages of all modules to be handled and stop
+ * the workers. Called before msg50, and on the way out of TO2 so that no
+ * callback runs once the modules get SDO_SI_END or SDO_SI_FAILURE. Calling
+ * it again without new messages does nothing.
+ * @param module_list - Global Module List Head Pointer.
+ * @param cb_return_val - filled with the first failure of a module, or
+ * SDO_SI_SUCCESS. May be NULL.
+ * @return true if every callback succeeded.
+ */
+bool sdo_osi_async_join(sdo_sdk_service_info_module_list_t *module_list,
+			int *cb_return_val)
+{
+	int status = SDO_SI_SUCCESS;
+#ifdef OSI_ASYNC_THREAD
+	struct sdo_osi_queue_s *q;
+
+	for (; module_list; module_list = module_list->next) {
+		q = module_list->osi_queue;
+		if (!q)
+			continue;
+
+		(void)pthread_mutex_lock(&q->lock);
+		q->stop = true;
+		(void)pthread_cond_broadcast(&q->cond);
+		(void)pthread_mutex_unlock(&q->lock);
+		(void)pthread_join(q->thread, NULL);
+
+		if (status == SDO_SI_SUCCESS)
+			status = q->status;
+		(void)pthread_cond_destroy(&q->cond);
+		(void)pthread_mutex_destroy(&q->lock);
+		sdo_free(q);
+		module_list->osi_queue = NULL;
+	}
+#else
+	(void)module_list;
+#endif
+
+	if (cb_return_val)
+		*cb_return_val = status;
+	return status == SDO_SI_SUCCESS;
+}
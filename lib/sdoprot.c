@@ -18,6 +18,9 @@
 #include <stdlib.h>
 #include "safe_lib.h"
 #include "snprintf_s.h"
+#include "sdodsi.h"
+#include "sdotrace.h"
+#include "sdoheap.h"
 
 /* This is a test mode to skip the CEC1702 signing and present a constant n4
  * nonce and signature.  These were generated in the server.
@@ -72,6 +75,22 @@ static state_func to2_state_fn[] = {
     msg51, /* TO2.Done2 */
 };
 
+/**
+ * Internal API
+ * Run the handler of the current message, traced as msgNN.
+ */
+static int run_state_fn(state_func state_fn, sdo_prot_t *ps)
+{
+	int32_t msg_type = ps->state;
+	int ret;
+
+	SDO_TRACE_BEGIN(SDO_TRACE_MSG, "msg", msg_type);
+	sdo_heap_set_msg(msg_type);
+	ret = state_fn(ps);
+	SDO_TRACE_END(SDO_TRACE_MSG, "msg", msg_type);
+	return ret;
+}
+
 /**
  * ps_free() - free all the protocol state
  * ps stores the message data which gets used in the next messages, so,
@@ -110,6 +129,7 @@ static void ps_free(sdo_prot_t *ps)
 		ps->n7r = NULL;
 	}
 	if (ps->dsi_info) {
+		sdo_dsi_prefetch_stop(ps->dsi_info);
 		sdo_free(ps->dsi_info);
 		ps->dsi_info = NULL;
 	}
@@ -204,7 +224,8 @@ bool sdo_process_states(sdo_prot_t *ps)
 		if (!state_fn)
 			break;
 
-		if (ps->state != SDO_STATE_DONE && state_fn && state_fn(ps)) {
+		if (ps->state != SDO_STATE_DONE && state_fn &&
+		    run_state_fn(state_fn, ps)) {
 			char err_msg[64];
 
 			(void)snprintf_s_i(err_msg, sizeof(err_msg),
@@ -18,13 +18,15 @@
 #include "network_al.h"
 #include "sdoprotctx.h"
 #include "sdonet.h"
+#include "sdobackoff.h"
+#include "sdocheckpoint.h"
+#include "sdotrace.h"
+#include "sdostats.h"
 #include <stdlib.h>
 #include "load_credentials.h"
 #include "safe_lib.h"
 #include "snprintf_s.h"
 
-#define CONNECTION_RETRY 2
-
 /**
  * sdo_prot_ctx_alloc responsible for allocation of required protocol context.
  * @param protrun - pointer to function for intended protocol (DI/TO1/TO2).
@@ -64,15 +66,67 @@ sdo_prot_ctx_t *sdo_prot_ctx_alloc(bool (*protrun)(sdo_prot_t *ps),
 
 	prot_ctx->host_port = host_port;
 	prot_ctx->tls = tls;
+	prot_ctx->sock_hdl = SDO_CON_INVALID_HANDLE;
 	return prot_ctx;
 }
 
+static void prot_ctx_close(sdo_prot_ctx_t *prot_ctx);
+
+/**
+ * Internal API
+ * Move the trace of the message in flight to the span of its current step,
+ * ending the span that is open. NULL only ends it.
+ */
+static void prot_ctx_trace(sdo_prot_ctx_t *prot_ctx, const char *span)
+{
+	int32_t msg_type = prot_ctx->protdata->sdow.msg_type;
+
+	if (span == prot_ctx->trace_span)
+		return;
+	if (prot_ctx->trace_span)
+		SDO_TRACE_END(SDO_TRACE_NET, prot_ctx->trace_span, msg_type);
+	if (span)
+		SDO_TRACE_BEGIN(SDO_TRACE_NET, span, msg_type);
+	prot_ctx->trace_span = span;
+}
+
 /**
  * Internal API
+ * Name of the network span a step belongs to, NULL for the steps that run
+ * the protocol.
+ */
+static const char *prot_ctx_step_span(const sdo_prot_ctx_t *prot_ctx)
+{
+	switch (prot_ctx->step) {
+	case SDO_PROT_STEP_CONNECT:
+	case SDO_PROT_STEP_CONNECTING:
+		return prot_ctx->conn_tls ? "tls_connect" : "connect";
+	case SDO_PROT_STEP_SEND:
+		return "send";
+	case SDO_PROT_STEP_RECV_HEADER:
+	case SDO_PROT_STEP_RECV_BODY:
+		return "receive";
+	case SDO_PROT_STEP_DELAY:
+		return "retry_delay";
+	default:
+		return NULL;
+	}
+}
+
+/**
+ * Internal API
+ * A context freed in the middle of a run, e.g. when the run is cancelled,
+ * closes its connection first.
  */
 void sdo_prot_ctx_free(sdo_prot_ctx_t *prot_ctx)
 {
 	if (prot_ctx) {
+		if (prot_ctx->step != SDO_PROT_STEP_START &&
+		    prot_ctx->step != SDO_PROT_STEP_DONE) {
+			prot_ctx_trace(prot_ctx, NULL);
+			prot_ctx_close(prot_ctx);
+			sdo_con_teardown();
+		}
 		if (prot_ctx->host_dns)
 			sdo_free(prot_ctx->resolved_ip);
 		sdo_free(prot_ctx);
@@ -81,72 +135,48 @@ void sdo_prot_ctx_free(sdo_prot_ctx_t *prot_ctx)
 
 /**
  * Internal API
+ * Pick the server the current protocol state talks to, resolving its name
+ * if needed, and the address the connection goes to.
  */
-static bool sdo_prot_ctx_connect(sdo_prot_ctx_t *prot_ctx)
+static bool sdo_prot_ctx_target(sdo_prot_ctx_t *prot_ctx)
 {
 	bool ret = false;
-	static int prevstate;
+	bool resolve = false;
+	bool proxy = false;
+	sdo_server_t server;
+	void **ssl = NULL;
 
 	if (prot_ctx->protdata->state == SDO_STATE_ERROR)
-		prot_ctx->protdata->state = prevstate;
+		prot_ctx->protdata->state = prot_ctx->prevstate;
 
 	switch (prot_ctx->protdata->state) {
 	case SDO_STATE_DI_APP_START: /* type 10 */
 		ATTRIBUTE_FALLTHROUGH;
 	case SDO_STATE_DI_SET_CREDENTIALS: /* type 11 */
-		if (prot_ctx->host_dns) {
-			if (!resolve_dn(prot_ctx->host_dns,
-					&prot_ctx->resolved_ip,
-					prot_ctx->host_port, NULL,
-					is_mfg_proxy_defined())) {
-				ret = false;
-				break;
-			}
-			prot_ctx->host_ip = prot_ctx->resolved_ip;
-		}
+		resolve = true;
 		ATTRIBUTE_FALLTHROUGH;
 	case SDO_STATE_DI_SET_HMAC: /* type 12 */
 		ATTRIBUTE_FALLTHROUGH;
 	case SDO_STATE_DI_DONE: /* type 13 */
-		ret = connect_to_manufacturer(prot_ctx->host_ip,
-					      prot_ctx->host_port,
-					      &prot_ctx->sock_hdl, NULL);
+		server = SDO_SERVER_MFG;
+		proxy = is_mfg_proxy_defined();
 		break;
 	case SDO_STATE_T01_SND_HELLO_SDO: /* type 30 */
 		ATTRIBUTE_FALLTHROUGH;
 	case SDO_STATE_TO1_RCV_HELLO_SDOACK: /* type 31 */
-		if (prot_ctx->host_dns) {
-			if (!resolve_dn(prot_ctx->host_dns,
-					&prot_ctx->resolved_ip,
-					prot_ctx->host_port,
-					(prot_ctx->tls ? &prot_ctx->ssl : NULL),
-					is_rv_proxy_defined())) {
-				ret = false;
-				break;
-			}
-			prot_ctx->host_ip = prot_ctx->resolved_ip;
-		}
+		resolve = true;
 		ATTRIBUTE_FALLTHROUGH;
 	case SDO_STATE_TO1_SND_PROVE_TO_SDO: /* type 32 */
 		ATTRIBUTE_FALLTHROUGH;
 	case SDO_STATE_TO1_RCV_SDO_REDIRECT: /* type 33 */
-		ret = connect_to_rendezvous(
-		    prot_ctx->host_ip, prot_ctx->host_port, &prot_ctx->sock_hdl,
-		    (prot_ctx->tls ? &prot_ctx->ssl : NULL));
+		server = SDO_SERVER_RV;
+		proxy = is_rv_proxy_defined();
+		ssl = prot_ctx->tls ? &prot_ctx->ssl : NULL;
 		break;
 	case SDO_STATE_T02_SND_HELLO_DEVICE: /* type 40 */
 		ATTRIBUTE_FALLTHROUGH;
 	case SDO_STATE_TO2_RCV_PROVE_OVHDR: /* type 41 */
-		if (prot_ctx->host_dns) {
-			if (!resolve_dn(prot_ctx->host_dns,
-					&prot_ctx->resolved_ip,
-					prot_ctx->host_port, NULL,
-					is_owner_proxy_defined())) {
-				ret = false;
-				break;
-			}
-			prot_ctx->host_ip = prot_ctx->resolved_ip;
-		}
+		resolve = true;
 		ATTRIBUTE_FALLTHROUGH;
 	case SDO_STATE_TO2_SND_GET_OP_NEXT_ENTRY: /* type 42 */
 		ATTRIBUTE_FALLTHROUGH;
@@ -167,222 +197,655 @@ static bool sdo_prot_ctx_connect(sdo_prot_ctx_t *prot_ctx)
 	case SDO_STATE_TO2_SND_DONE: /* type 50 */
 		ATTRIBUTE_FALLTHROUGH;
 	case SDO_STATE_TO2_RCV_DONE_2: /* type 51 */
-		ret = connect_to_owner(prot_ctx->host_ip, prot_ctx->host_port,
-				       &prot_ctx->sock_hdl, NULL);
+		server = SDO_SERVER_OWNER;
+		proxy = is_owner_proxy_defined();
 		break;
 	default:
 		LOG(LOG_ERROR, "%s reached unknown state\n", __func__);
-		break;
+		goto end;
+	}
+
+	/* Name resolution blocks, it is done once per protocol */
+	if (resolve && prot_ctx->host_dns) {
+		sdo_free(prot_ctx->resolved_ip);
+		if (!resolve_dn(prot_ctx->host_dns, &prot_ctx->resolved_ip,
+				prot_ctx->host_port, ssl, proxy))
+			goto end;
+		prot_ctx->host_ip = prot_ctx->resolved_ip;
 	}
-	prevstate = prot_ctx->protdata->state;
+
+	prot_ctx->conn_ip = prot_ctx->host_ip;
+	prot_ctx->conn_port = prot_ctx->host_port;
+	ret = sdo_net_target(server, &prot_ctx->conn_ip, &prot_ctx->conn_port,
+			     &ssl);
+	prot_ctx->conn_tls = ssl != NULL;
+end:
+	prot_ctx->prevstate = prot_ctx->protdata->state;
 	return ret;
 }
 
 /**
- * sdo_prot_ctx_run responsible for running/maintaining DI, T01, T02 protocol
- * contexts and respond according to the state specified.
- * Managing the JSON packet to/from device to server is taken care.
- * Managing the ip/dns-to-ip resolution is taken care.
- * @param prot_ctx - Pointer of type sdo_prot_ctx_t, holds the all the
- * information,
- * @return 0 on success, -1 on error.
+ * Internal API
+ * Close the connection of the message in flight, if any.
  */
+static void prot_ctx_close(sdo_prot_ctx_t *prot_ctx)
+{
+	if (prot_ctx->sock_hdl != SDO_CON_INVALID_HANDLE &&
+	    sdo_con_disconnect(prot_ctx->sock_hdl, prot_ctx->ssl))
+		LOG(LOG_ERROR, "Error during socket close()\n");
+	prot_ctx->sock_hdl = SDO_CON_INVALID_HANDLE;
+	prot_ctx->ssl = NULL;
+	if (prot_ctx->tx)
+		sdo_free(prot_ctx->tx);
+}
 
-int sdo_prot_ctx_run(sdo_prot_ctx_t *prot_ctx)
+/**
+ * Internal API
+ * End the protocol run with result.
+ */
+static int prot_ctx_finish(sdo_prot_ctx_t *prot_ctx, int result)
 {
-	int ret = 0;
-	int n, size;
-	int retries = 0;
-	sdo_block_t *sdob = NULL;
-	sdor_t *sdor = NULL;
-	sdow_t *sdow = NULL;
-
-	if (!prot_ctx || !prot_ctx->protdata)
-		return -1;
-	sdor = &prot_ctx->protdata->sdor;
-	sdow = &prot_ctx->protdata->sdow;
+	sdo_block_t *sdob = &prot_ctx->protdata->sdor.b;
 
-	// init connection set-up for send/receive packets
-	if (sdo_con_setup(NULL, NULL, 0)) {
-		LOG(LOG_ERROR, "Connection setup failed!\n");
-		return -1;
+	prot_ctx_trace(prot_ctx, NULL);
+	prot_ctx_close(prot_ctx);
+	sdo_con_teardown();
+
+	if (sdob->block) {
+		sdob->block_max = 0;
+		sdob->block_size = 0;
+		sdob->cursor = 0;
+		sdo_free(sdob->block);
 	}
 
-	for (;;) {
+	prot_ctx->result = result;
+	prot_ctx->step = SDO_PROT_STEP_DONE;
+	return result;
+}
 
-		if (prot_ctx->protrun)
-			(*prot_ctx->protrun)(prot_ctx->protdata);
-		else {
-			ret = -1;
-			break;
-		}
+/**
+ * Internal API
+ * Go on with step once the next backoff delay of a retry site has passed.
+ * @return false if the retry site gave up.
+ */
+static bool prot_ctx_delay(sdo_prot_ctx_t *prot_ctx, sdo_backoff_t *bo,
+			   sdo_prot_step_t step)
+{
+	uint32_t delay_ms = 0;
 
-		/* ========================================================== */
-		/*  Transmit outbound packet */
+	if (!sdo_backoff_next(bo, &delay_ms))
+		return false;
 
+	prot_ctx->wake_ms = sdo_get_time_ms() + delay_ms;
+	prot_ctx->next_step = step;
+	prot_ctx->step = SDO_PROT_STEP_DELAY;
+	return true;
+}
 
-		/*  Protocol sets State as SDO_STATE_DONE at the end of the*/
-		/*  protocol(DI/T01/TO2) */
-		/*  Hence, when state = SDO_STATE_DONE, we have nothing more*/
-		/*  left to */
-		/*  send. Exit!! */
-		if (prot_ctx->protdata->state == SDO_STATE_DONE) {
-			ret = 0;
-			break;
-		}
+/**
+ * Internal API
+ * Recover from a transport error. Past msg44 the session keys are agreed,
+ * so the pending message is sent again instead of restarting TO2.
+ * @return false if the protocol run has failed.
+ */
+static bool prot_ctx_transport_err(sdo_prot_ctx_t *prot_ctx)
+{
+	prot_ctx_close(prot_ctx);
+
+	if (!sdo_to2_resumable(prot_ctx->protdata) ||
+	    !prot_ctx_delay(prot_ctx, &prot_ctx->resume_backoff,
+			    SDO_PROT_STEP_BUILD))
+		return false;
+
+	LOG(LOG_INFO, "Re-sending msg%d on the current TO2 session\n",
+	    prot_ctx->protdata->sdow.msg_type);
+	prot_ctx->resend = true;
+	prot_ctx->io_retry = false;
+	return true;
+}
+
+/**
+ * Internal API
+ * Recover from a failed send or receive: reconnect and send the message
+ * again, until the send/receive retries run out.
+ * @return false if the protocol run has failed.
+ */
+static bool prot_ctx_io_err(sdo_prot_ctx_t *prot_ctx)
+{
+	prot_ctx_close(prot_ctx);
+
+	if (!prot_ctx_delay(prot_ctx, &prot_ctx->io_backoff,
+			    SDO_PROT_STEP_BUILD))
+		return prot_ctx_transport_err(prot_ctx);
+
+	prot_ctx->resend = true;
+	prot_ctx->io_retry = true;
+	return true;
+}
+
+/**
+ * Internal API
+ * Retry a failed connect after the connect backoff delay.
+ * @return false if the protocol run has failed.
+ */
+static bool prot_ctx_connect_err(sdo_prot_ctx_t *prot_ctx)
+{
+	prot_ctx_close(prot_ctx);
+
+	if (prot_ctx_delay(prot_ctx, &prot_ctx->connect_backoff,
+			   SDO_PROT_STEP_CONNECT)) {
+		LOG(LOG_INFO, "Failed to connect to server: retrying...\n");
+		return true;
+	}
+
+	LOG(LOG_ERROR, "Failed to connect to server: Giving up...\n");
+	return prot_ctx_transport_err(prot_ctx);
+}
+
+/**
+ * Internal API
+ * Build the next message to send.
+ * @return 1 to go on, 0 or -1 if the protocol run ended with that result.
+ */
+static int prot_ctx_build(sdo_prot_ctx_t *prot_ctx)
+{
+	sdow_t *sdow = &prot_ctx->protdata->sdow;
+
+	/* A re-sent message goes out as built the first time */
+	if (!prot_ctx->resend) {
+		if (!prot_ctx->protrun)
+			return -1;
+		(*prot_ctx->protrun)(prot_ctx->protdata);
+
+		/*  Protocol sets State as SDO_STATE_DONE at the end */
+		/*  of the protocol(DI/T01/TO2) */
+		/*  Hence, when state = SDO_STATE_DONE, we have */
+		/*  nothing more left to send. Exit!! */
+		if (prot_ctx->protdata->state == SDO_STATE_DONE)
+			return 0;
 
 		if ((sdow->msg_type < SDO_DI_APP_START) ||
-		    (sdow->msg_type > SDO_TYPE_ERROR)) {
-			ret = -1;
-			break;
-		}
+		    (sdow->msg_type > SDO_TYPE_ERROR))
+			return -1;
 
-		if (!sdo_prot_ctx_connect(prot_ctx)) {
-			/* Giving up, we tried enough to
-			 * re-establish
-			 */
-			ret = -1;
-			break;
-		}
+		if (sdow->msg_type >= SDO_TO2_HELLO_DEVICE &&
+		    sdow->msg_type <= SDO_TO2_DONE2)
+			(void)sdo_to2_checkpoint_save(prot_ctx);
+	}
 
-		size = sdow->b.block_size;
-
-		sdow->b.block[size] = 0;
-		retries = CONNECTION_RETRY;
-		do {
-			n = sdo_con_send_message(
-			    prot_ctx->sock_hdl, SDO_PROT_SPEC_VERSION,
-			    sdow->msg_type, &sdow->b.block[0], size,
-			    prot_ctx->ssl);
-
-			if (n <= 0) {
-				if (sdo_con_disconnect(prot_ctx->sock_hdl,
-						       prot_ctx->ssl)) {
-					LOG(LOG_ERROR,
-					    "Error during socket close()\n");
-					ret = -1;
-					break;
-				}
-
-				if (sdo_connection_restablish(prot_ctx)) {
-					/* Giving up, we tried enough to
-					 * re-establish
-					 */
-					ret = -1;
-					break;
-				}
-			}
-		} while (n < 0 && retries--);
+	if (!prot_ctx->io_retry)
+		sdo_backoff_init(&prot_ctx->io_backoff, SDO_RETRY_NETIO);
+	prot_ctx->resend = false;
+	prot_ctx->io_retry = false;
 
-		if (n < 0) {
-			ret = -1;
-			break;
-		}
+	if (!sdo_prot_ctx_target(prot_ctx))
+		return prot_ctx_transport_err(prot_ctx) ? 1 : -1;
+
+	sdo_backoff_init(&prot_ctx->connect_backoff, SDO_RETRY_CONNECT);
+	prot_ctx->step = SDO_PROT_STEP_CONNECT;
+	return 1;
+}
+
+/**
+ * Internal API
+ * Open the connection for the message to send.
+ * @return false if the protocol run has failed.
+ */
+static bool prot_ctx_connect(sdo_prot_ctx_t *prot_ctx)
+{
+	void **ssl = prot_ctx->conn_tls ? &prot_ctx->ssl : NULL;
+
+	prot_ctx->connect_us = sdo_get_time_us();
+#if defined(SDO_CON_NONBLOCKING)
+	/* TLS handshakes run to completion, plain connects do not block */
+	prot_ctx->nonblocking = !ssl;
+	if (prot_ctx->nonblocking) {
+		prot_ctx->sock_hdl = sdo_con_connect_start(prot_ctx->conn_ip,
+							   prot_ctx->conn_port);
+		if (prot_ctx->sock_hdl == SDO_CON_INVALID_HANDLE)
+			return prot_ctx_connect_err(prot_ctx);
+		prot_ctx->step = SDO_PROT_STEP_CONNECTING;
+		return true;
+	}
+#endif
+	prot_ctx->sock_hdl =
+	    sdo_con_connect(prot_ctx->conn_ip, prot_ctx->conn_port, ssl);
+	if (prot_ctx->sock_hdl == SDO_CON_INVALID_HANDLE)
+		return prot_ctx_connect_err(prot_ctx);
+	prot_ctx->step = SDO_PROT_STEP_SEND;
+	return true;
+}
 
-		LOG(LOG_DEBUG, "Tx sdo_prot_ctx_run:body:%s\n\n",
-		    &sdow->b.block[0]);
+/**
+ * Internal API
+ * Allocate the body of the response, of msglen bytes.
+ * @return false on allocation failure.
+ */
+static bool prot_ctx_recv_body_start(sdo_prot_ctx_t *prot_ctx, uint32_t msglen)
+{
+	sdor_t *sdor = &prot_ctx->protdata->sdor;
+	sdo_block_t *sdob = &sdor->b;
 
-		/* ========================================================== */
-		/*  Receive response */
+	sdor_flush(sdor);
+	sdo_resize_block(sdob, msglen + 4);
 
-		sdob = &sdor->b;
+	if (!sdob->block || memset_s(sdob->block, msglen + 4, 0) != 0) {
+		LOG(LOG_ERROR, "Memset Failed\n");
+		return false;
+	}
 
-		uint32_t msglen = 0;
-		uint32_t protver = 0;
+	sdob->block_size = msglen;
+	prot_ctx->rx_len = msglen;
+	prot_ctx->rx_off = 0;
+	prot_ctx->step = SDO_PROT_STEP_RECV_BODY;
+	return true;
+}
 
-		ret = sdo_con_recv_msg_header(prot_ctx->sock_hdl, &protver,
-					      (uint32_t *)&sdor->msg_type,
-					      &msglen, prot_ctx->ssl);
-		if (ret == -1) {
-			LOG(LOG_ERROR, "sdo_con_recv_msg_header() Failed!\n");
-			ret = -1;
-			break;
+/**
+ * Internal API
+ * Hand the received response to the protocol.
+ * @return 1 to go on, 0 or -1 if the protocol run ended with that result.
+ */
+static int prot_ctx_received(sdo_prot_ctx_t *prot_ctx)
+{
+	sdor_t *sdor = &prot_ctx->protdata->sdor;
+	sdow_t *sdow = &prot_ctx->protdata->sdow;
+
+	prot_ctx_close(prot_ctx);
+	sdo_stats_round_trip(sdow->msg_type,
+			     sdo_get_time_us() - prot_ctx->connect_us);
+
+	LOG(LOG_DEBUG, "Rx sdo_prot_ctx_run:body:%s\n\n", &sdor->b.block[0]);
+
+	sdor_set_have_block(sdor);
+	sdo_backoff_init(&prot_ctx->resume_backoff, SDO_RETRY_TO2);
+
+	/*
+	 * When a REST error message(type 255) is sent over network,
+	 * the received response may have an empty body.
+	 */
+	if (prot_ctx->rx_len == 0 && sdow->msg_type == SDO_TYPE_ERROR)
+		return -1;
+	/* ERROR case ? */
+	if (sdor->msg_type == SDO_TYPE_ERROR)
+		return -1;
+
+	prot_ctx->step = SDO_PROT_STEP_BUILD;
+	return 1;
+}
+
+#if defined(SDO_CON_NONBLOCKING)
+/**
+ * Internal API
+ * Report the connection of the message in flight to wait on.
+ */
+static int prot_ctx_wait(sdo_prot_ctx_t *prot_ctx, sdo_sdk_wait *wait,
+			 uint32_t events)
+{
+	wait->fd = sdo_con_get_fd(prot_ctx->sock_hdl);
+	wait->events = events;
+	wait->timeout_ms = -1;
+	return 1;
+}
+
+/**
+ * Internal API
+ * Offset just past the empty line that ends the REST header in buf, 0 if
+ * the header is not complete yet.
+ */
+static size_t header_end(const char *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i + 1 < len; i++) {
+		if (buf[i] != '\n')
+			continue;
+		if (buf[i + 1] == '\n')
+			return i + 2;
+		if (buf[i + 1] == '\r' && i + 2 < len && buf[i + 2] == '\n')
+			return i + 3;
+	}
+	return 0;
+}
+
+/**
+ * Internal API
+ * Send the REST header and body without blocking.
+ * @return 1 to go on, -1 if the protocol run has failed.
+ */
+static int prot_ctx_send_some(sdo_prot_ctx_t *prot_ctx, sdo_sdk_wait *wait)
+{
+	sdow_t *sdow = &prot_ctx->protdata->sdow;
+	char hdr[REST_MAX_MSGHDR_SIZE] = {0};
+	size_t size = (size_t)sdow->b.block_size;
+	size_t hdr_len;
+	int32_t n;
+
+	if (!prot_ctx->tx) {
+		hdr_len = sdo_con_msg_header(SDO_PROT_SPEC_VERSION,
+					     sdow->msg_type, size, hdr,
+					     sizeof(hdr));
+		if (!hdr_len)
+			return prot_ctx_io_err(prot_ctx) ? 1 : -1;
+
+		prot_ctx->tx = sdo_alloc(hdr_len + size);
+		if (!prot_ctx->tx ||
+		    memcpy_s(prot_ctx->tx, hdr_len, hdr, hdr_len) != 0 ||
+		    memcpy_s(prot_ctx->tx + hdr_len, size, sdow->b.block,
+			     size) != 0) {
+			LOG(LOG_ERROR, "Failed to queue message\n");
+			return -1;
 		}
+		prot_ctx->tx_len = hdr_len + size;
+		prot_ctx->tx_off = 0;
+		LOG(LOG_DEBUG, "REST:header(%zu):%s\n", hdr_len, hdr);
+	}
 
-		sdor_flush(sdor);
-		sdob = &sdor->b;
-		sdo_resize_block(sdob, msglen + 4);
+	while (prot_ctx->tx_off < prot_ctx->tx_len) {
+		n = sdo_con_send_some(prot_ctx->sock_hdl,
+				      prot_ctx->tx + prot_ctx->tx_off,
+				      prot_ctx->tx_len - prot_ctx->tx_off);
+		if (n < 0)
+			return prot_ctx_io_err(prot_ctx) ? 1 : -1;
+		if (n == 0)
+			return prot_ctx_wait(prot_ctx, wait, SDO_WAIT_WRITE);
+		prot_ctx->tx_off += (size_t)n;
+	}
 
-		if (memset_s(sdob->block, msglen + 4, 0) != 0) {
-			LOG(LOG_ERROR, "Memset Failed\n");
-			ret = -1;
+	sdo_free(prot_ctx->tx);
+	LOG(LOG_DEBUG, "Tx sdo_prot_ctx_run:body:%s\n\n", &sdow->b.block[0]);
+	prot_ctx->rx_hdr_len = 0;
+	prot_ctx->step = SDO_PROT_STEP_RECV_HEADER;
+	return 1;
+}
+
+/**
+ * Internal API
+ * Receive the REST header of the response without blocking. Body bytes
+ * that arrive along with the header are kept for the body.
+ * @return 1 to go on, -1 if the protocol run has failed.
+ */
+static int prot_ctx_recv_header_some(sdo_prot_ctx_t *prot_ctx,
+				     sdo_sdk_wait *wait)
+{
+	sdor_t *sdor = &prot_ctx->protdata->sdor;
+	uint32_t protver = 0, msglen = 0;
+	size_t end, extra;
+	int32_t n;
+	char c;
+
+	for (;;) {
+		n = sdo_con_recv_some(
+		    prot_ctx->sock_hdl,
+		    (uint8_t *)prot_ctx->rx_hdr + prot_ctx->rx_hdr_len,
+		    sizeof(prot_ctx->rx_hdr) - 1 - prot_ctx->rx_hdr_len);
+		if (n == 0)
+			return prot_ctx_wait(prot_ctx, wait, SDO_WAIT_READ);
+		if (n < 0)
+			goto err;
+		prot_ctx->rx_hdr_len += (size_t)n;
+		prot_ctx->rx_hdr[prot_ctx->rx_hdr_len] = '\0';
+
+		end = header_end(prot_ctx->rx_hdr, prot_ctx->rx_hdr_len);
+		if (end)
 			break;
+		if (prot_ctx->rx_hdr_len == sizeof(prot_ctx->rx_hdr) - 1) {
+			LOG(LOG_ERROR, "REST header too long!\n");
+			goto err;
 		}
+	}
 
-		sdob->block_size = msglen;
-
-		if (msglen > 0) {
-			retries = CONNECTION_RETRY;
-			n = 0;
-			do {
-				n = sdo_con_recv_msg_body(
-				    prot_ctx->sock_hdl, &sdob->block[0], msglen,
-				    prot_ctx->ssl);
-				if (n < 0) {
-					if (sdo_con_disconnect(
-						prot_ctx->sock_hdl,
-						prot_ctx->ssl)) {
-						LOG(LOG_ERROR, "Error during "
-							       "socket "
-							       "close()\n");
-						ret = -1;
-						break;
-					}
-
-					if (sdo_connection_restablish(
-						prot_ctx)) {
-						/* Giving up, we tried enough to
-						 * re-establish
-						 */
-						ret = -1;
-						break;
-					}
-				}
-			} while (n < 0 && retries--);
-
-			if (n <= 0) {
-				LOG(LOG_ERROR, "Socket read not successful "
-					       "after retries!\n");
-				sdor_flush(sdor);
-				ret = -1;
-				break;
-			}
-		}
+	c = prot_ctx->rx_hdr[end];
+	prot_ctx->rx_hdr[end] = '\0';
+	if (sdo_con_parse_msg_header(prot_ctx->rx_hdr, &protver,
+				     (uint32_t *)&sdor->msg_type,
+				     &msglen) != 0)
+		goto err;
+	prot_ctx->rx_hdr[end] = c;
 
-		if (sdo_con_disconnect(prot_ctx->sock_hdl, prot_ctx->ssl)) {
-			LOG(LOG_ERROR, "Error during socket close()\n");
-			ret = -1;
-			break;
+	if (!prot_ctx_recv_body_start(prot_ctx, msglen))
+		return -1;
+
+	extra = prot_ctx->rx_hdr_len - end;
+	if (extra > msglen)
+		extra = msglen;
+	if (extra && memcpy_s(sdor->b.block, msglen, prot_ctx->rx_hdr + end,
+			      extra) != 0)
+		return -1;
+	prot_ctx->rx_off = (uint32_t)extra;
+	return 1;
+
+err:
+	LOG(LOG_ERROR, "sdo_con_recv_msg_header() Failed!\n");
+	return prot_ctx_transport_err(prot_ctx) ? 1 : -1;
+}
+
+/**
+ * Internal API
+ * Receive the body of the response without blocking.
+ * @return 1 to go on, 0 or -1 if the protocol run ended with that result.
+ */
+static int prot_ctx_recv_body_some(sdo_prot_ctx_t *prot_ctx,
+				   sdo_sdk_wait *wait)
+{
+	sdor_t *sdor = &prot_ctx->protdata->sdor;
+	int32_t n;
+
+	while (prot_ctx->rx_off < prot_ctx->rx_len) {
+		n = sdo_con_recv_some(prot_ctx->sock_hdl,
+				      sdor->b.block + prot_ctx->rx_off,
+				      prot_ctx->rx_len - prot_ctx->rx_off);
+		if (n == 0)
+			return prot_ctx_wait(prot_ctx, wait, SDO_WAIT_READ);
+		if (n < 0) {
+			LOG(LOG_ERROR,
+			    "Socket read not successful after retries!\n");
+			sdor_flush(sdor);
+			return prot_ctx_io_err(prot_ctx) ? 1 : -1;
 		}
+		prot_ctx->rx_off += (uint32_t)n;
+	}
+	return prot_ctx_received(prot_ctx);
+}
+#endif
+
+/**
+ * Internal API
+ * Send the message, without blocking if the connection allows.
+ */
+static int prot_ctx_send(sdo_prot_ctx_t *prot_ctx, sdo_sdk_wait *wait)
+{
+	sdow_t *sdow = &prot_ctx->protdata->sdow;
+	int size = sdow->b.block_size;
+	int n;
+
+	sdow->b.block[size] = 0;
+#if defined(SDO_CON_NONBLOCKING)
+	if (prot_ctx->nonblocking)
+		return prot_ctx_send_some(prot_ctx, wait);
+#endif
+	(void)wait;
+
+	n = sdo_con_send_message(prot_ctx->sock_hdl, SDO_PROT_SPEC_VERSION,
+				 sdow->msg_type, &sdow->b.block[0], size,
+				 prot_ctx->ssl);
+	if (n <= 0)
+		return prot_ctx_io_err(prot_ctx) ? 1 : -1;
+
+	LOG(LOG_DEBUG, "Tx sdo_prot_ctx_run:body:%s\n\n", &sdow->b.block[0]);
+	prot_ctx->step = SDO_PROT_STEP_RECV_HEADER;
+	return 1;
+}
 
-		LOG(LOG_DEBUG, "Rx sdo_prot_ctx_run:body:%s\n\n",
-		    &sdor->b.block[0]);
+/**
+ * Internal API
+ * Receive the REST header of the response.
+ */
+static int prot_ctx_recv_header(sdo_prot_ctx_t *prot_ctx, sdo_sdk_wait *wait)
+{
+	sdor_t *sdor = &prot_ctx->protdata->sdor;
+	uint32_t protver = 0, msglen = 0;
+
+#if defined(SDO_CON_NONBLOCKING)
+	if (prot_ctx->nonblocking)
+		return prot_ctx_recv_header_some(prot_ctx, wait);
+#endif
+	(void)wait;
+
+	if (sdo_con_recv_msg_header(prot_ctx->sock_hdl, &protver,
+				    (uint32_t *)&sdor->msg_type, &msglen,
+				    prot_ctx->ssl) == -1) {
+		LOG(LOG_ERROR, "sdo_con_recv_msg_header() Failed!\n");
+		return prot_ctx_transport_err(prot_ctx) ? 1 : -1;
+	}
 
-		sdor_set_have_block(sdor);
+	return prot_ctx_recv_body_start(prot_ctx, msglen) ? 1 : -1;
+}
 
-		/*
-		 * When a REST error message(type 255) is sent over network,
-		 * the received response may have an empty body.
-		 */
-		if (msglen == 0 && sdow->msg_type == SDO_TYPE_ERROR) {
-			ret = -1;
+/**
+ * Internal API
+ * Receive the body of the response.
+ */
+static int prot_ctx_recv_body(sdo_prot_ctx_t *prot_ctx, sdo_sdk_wait *wait)
+{
+	sdor_t *sdor = &prot_ctx->protdata->sdor;
+
+#if defined(SDO_CON_NONBLOCKING)
+	if (prot_ctx->nonblocking)
+		return prot_ctx_recv_body_some(prot_ctx, wait);
+#endif
+	(void)wait;
+
+	if (prot_ctx->rx_len > 0 &&
+	    sdo_con_recv_msg_body(prot_ctx->sock_hdl, &sdor->b.block[0],
+				  prot_ctx->rx_len, prot_ctx->ssl) <= 0) {
+		LOG(LOG_ERROR, "Socket read not successful after retries!\n");
+		sdor_flush(sdor);
+		return prot_ctx_io_err(prot_ctx) ? 1 : -1;
+	}
+	return prot_ctx_received(prot_ctx);
+}
+
+/**
+ * sdo_prot_ctx_step advances a DI, TO1 or TO2 protocol run as far as it can
+ * without waiting: messages are built and the responses processed, while
+ * connecting, sending, receiving and the retry delays are left to the
+ * caller to wait for. Name resolution and TLS connections still block.
+ *
+ * @param prot_ctx - Pointer of type sdo_prot_ctx_t, holds the all the
+ * information,
+ * @param wait - out, what to wait for before the next step.
+ * @return 1 if the run is in progress, 0 on success, -1 on error.
+ */
+int sdo_prot_ctx_step(sdo_prot_ctx_t *prot_ctx, sdo_sdk_wait *wait)
+{
+	uint64_t now;
+	int ret = 1;
+
+	if (!prot_ctx || !prot_ctx->protdata || !wait)
+		return -1;
+
+	while (ret > 0) {
+		prot_ctx_trace(prot_ctx, prot_ctx_step_span(prot_ctx));
+		switch (prot_ctx->step) {
+		case SDO_PROT_STEP_START:
+			// init connection set-up for send/receive packets
+			if (sdo_con_setup(NULL, NULL, 0)) {
+				LOG(LOG_ERROR, "Connection setup failed!\n");
+				return prot_ctx_finish(prot_ctx, -1);
+			}
+
+			if (prot_ctx->protdata->resumed &&
+			    !sdo_to2_checkpoint_restore_session(prot_ctx)) {
+				LOG(LOG_ERROR,
+				    "Failed to restore TO2 session!\n");
+				return prot_ctx_finish(prot_ctx, -1);
+			}
+
+			sdo_backoff_init(&prot_ctx->resume_backoff,
+					 SDO_RETRY_TO2);
+			prot_ctx->step = SDO_PROT_STEP_BUILD;
 			break;
-		}
-		 /* ERROR case ? */
-		if (sdor->msg_type == SDO_TYPE_ERROR) {
+		case SDO_PROT_STEP_BUILD:
+			ret = prot_ctx_build(prot_ctx);
+			break;
+		case SDO_PROT_STEP_CONNECT:
+			ret = prot_ctx_connect(prot_ctx) ? 1 : -1;
+			break;
+#if defined(SDO_CON_NONBLOCKING)
+		case SDO_PROT_STEP_CONNECTING:
+			ret = sdo_con_connect_done(prot_ctx->sock_hdl);
+			if (ret > 0)
+				return prot_ctx_wait(prot_ctx, wait,
+						     SDO_WAIT_WRITE);
+			if (ret == 0) {
+				prot_ctx->step = SDO_PROT_STEP_SEND;
+				ret = 1;
+			} else {
+				ret = prot_ctx_connect_err(prot_ctx) ? 1 : -1;
+			}
+			break;
+#endif
+		case SDO_PROT_STEP_SEND:
+			ret = prot_ctx_send(prot_ctx, wait);
+			if (ret > 0 && prot_ctx->step == SDO_PROT_STEP_SEND)
+				return 1;
+			break;
+		case SDO_PROT_STEP_RECV_HEADER:
+			ret = prot_ctx_recv_header(prot_ctx, wait);
+			if (ret > 0 &&
+			    prot_ctx->step == SDO_PROT_STEP_RECV_HEADER)
+				return 1;
+			break;
+		case SDO_PROT_STEP_RECV_BODY:
+			ret = prot_ctx_recv_body(prot_ctx, wait);
+			if (ret > 0 && prot_ctx->step == SDO_PROT_STEP_RECV_BODY)
+				return 1;
+			break;
+		case SDO_PROT_STEP_DELAY:
+			now = sdo_get_time_ms();
+			if (now < prot_ctx->wake_ms) {
+				wait->fd = -1;
+				wait->events = 0;
+				wait->timeout_ms =
+				    prot_ctx->wake_ms - now > INT32_MAX
+					? INT32_MAX
+					: (int32_t)(prot_ctx->wake_ms - now);
+				return 1;
+			}
+			prot_ctx->step = prot_ctx->next_step;
+			break;
+		case SDO_PROT_STEP_DONE:
+			return prot_ctx->result;
+		default:
 			ret = -1;
 			break;
 		}
 	}
 
-	sdo_con_teardown();
+	return prot_ctx_finish(prot_ctx, ret);
+}
 
-	if (sdob && sdob->block) {
-		sdob->block_max = 0;
-		sdob->block_size = 0;
-		sdob->cursor = 0;
-		sdo_free(sdob->block);
-		sdob->block = NULL;
-	}
+/**
+ * sdo_prot_ctx_run responsible for running/maintaining DI, T01, T02 protocol
+ * contexts and respond according to the state specified.
+ * Managing the JSON packet to/from device to server is taken care.
+ * Managing the ip/dns-to-ip resolution is taken care.
+ * Steps the context with sdo_prot_ctx_step() and waits in between.
+ * @param prot_ctx - Pointer of type sdo_prot_ctx_t, holds the all the
+ * information,
+ * @return 0 on success, -1 on error.
+ */
+int sdo_prot_ctx_run(sdo_prot_ctx_t *prot_ctx)
+{
+	sdo_sdk_wait wait;
+	int ret;
+
+	/* A finished context runs the protocol again from the start */
+	if (prot_ctx && prot_ctx->step == SDO_PROT_STEP_DONE)
+		prot_ctx->step = SDO_PROT_STEP_START;
+
+	while ((ret = sdo_prot_ctx_step(prot_ctx, &wait)) > 0)
+		(void)sdo_con_wait(wait.fd, wait.events, wait.timeout_ms);
 	return ret;
 }
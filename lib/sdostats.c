@@ -0,0 +1,216 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Statistics of the process: round trips, bytes, connections, DNS
+ * lookups, retries, crypto operations and per-message latency histograms.
+ *
+ * Every session of the process adds to the same counters without a lock.
+ * The latency histograms are log-linear: values up to 3 us have a bucket
+ * each, then every power of two is split into 4 buckets, so a bucket is at
+ * most 25% wide and 124 of them reach 2^32 us. A percentile read from them
+ * is accurate to that width, which is enough to tell p50 from p99 apart in
+ * fleet telemetry at a fixed cost per message.
+ */
+
+#include "util.h"
+#include "sdostats.h"
+#include "sdoprot.h"
+#include "safe_lib.h"
+
+static sdo_sdk_stats stats;
+
+#define STATS_ADD(counter, n)                                                  \
+	((void)__atomic_fetch_add(&(counter), (n), __ATOMIC_RELAXED))
+
+/**
+ * Internal API
+ * Bucket of a latency histogram a value falls into.
+ * @param us - latency in microseconds.
+ * @return index of the bucket, values past the last bucket go into it.
+ */
+uint32_t sdo_stats_bucket_of(uint64_t us)
+{
+	uint32_t exp;
+
+	if (us < 4)
+		return (uint32_t)us;
+	if (us >> 32)
+		return SDO_STATS_HIST_BUCKETS - 1;
+
+	exp = 63 - (uint32_t)__builtin_clzll(us);
+	return 4 * (exp - 1) + (uint32_t)((us >> (exp - 2)) & 3);
+}
+
+/**
+ * Internal API
+ * Count bytes of REST headers and bodies sent.
+ */
+void sdo_stats_bytes_sent(size_t bytes)
+{
+	STATS_ADD(stats.bytes_sent, (uint64_t)bytes);
+}
+
+/**
+ * Internal API
+ * Count bytes of REST headers and bodies received.
+ */
+void sdo_stats_bytes_received(size_t bytes)
+{
+	STATS_ADD(stats.bytes_received, (uint64_t)bytes);
+}
+
+/**
+ * Internal API
+ * Count a connection opened, or one that could not be.
+ */
+void sdo_stats_connect(bool connected)
+{
+	if (connected)
+		STATS_ADD(stats.connections, 1);
+	else
+		STATS_ADD(stats.connect_failures, 1);
+}
+
+/**
+ * Internal API
+ * Count a DNS lookup.
+ */
+void sdo_stats_dns_lookup(void)
+{
+	STATS_ADD(stats.dns_lookups, 1);
+}
+
+/**
+ * Internal API
+ * Count a retry granted by the backoff scheduler.
+ */
+void sdo_stats_retry(sdo_sdk_retry_phase phase)
+{
+	if (phase < SDO_RETRY_PHASE_MAX)
+		STATS_ADD(stats.retries[phase], 1);
+}
+
+/**
+ * Internal API
+ * Count a crypto operation.
+ */
+void sdo_stats_crypto(sdo_sdk_stats_crypto op)
+{
+	if (op < SDO_STATS_CRYPTO_MAX)
+		STATS_ADD(stats.crypto_ops[op], 1);
+}
+
+/**
+ * Internal API
+ * Protocol a message type belongs to.
+ * @return SDO_STATS_DI, SDO_STATS_TO1 or SDO_STATS_TO2, or
+ * SDO_STATS_PHASE_MAX for none of them.
+ */
+sdo_sdk_stats_phase sdo_stats_phase_of(int msg_type)
+{
+	if (msg_type >= SDO_DI_APP_START && msg_type <= SDO_DI_DONE)
+		return SDO_STATS_DI;
+	if (msg_type >= SDO_TO1_TYPE_HELLO_SDO &&
+	    msg_type <= SDO_TO1_TYPE_SDO_REDIRECT)
+		return SDO_STATS_TO1;
+	if (msg_type >= SDO_TO2_HELLO_DEVICE && msg_type <= SDO_TO2_DONE2)
+		return SDO_STATS_TO2;
+	return SDO_STATS_PHASE_MAX;
+}
+
+/**
+ * Internal API
+ * Count a message answered by the server and add its latency to the
+ * histogram of the message type.
+ * @param msg_type - type of the request.
+ * @param latency_us - time from the connect to the end of the response.
+ */
+void sdo_stats_round_trip(int msg_type, uint64_t latency_us)
+{
+	sdo_sdk_stats_phase phase = sdo_stats_phase_of(msg_type);
+	sdo_sdk_latency_hist *h;
+
+	if (phase < SDO_STATS_PHASE_MAX)
+		STATS_ADD(stats.round_trips[phase], 1);
+
+	if (msg_type < 0 || msg_type >= SDO_STATS_MSG_MAX)
+		return;
+	h = &stats.msg_latency[msg_type];
+	STATS_ADD(h->count, 1);
+	STATS_ADD(h->sum_us, latency_us);
+	STATS_ADD(h->bucket[sdo_stats_bucket_of(latency_us)], 1);
+}
+
+/**
+ * Get the statistics gathered since the start of the process or the last
+ * sdo_sdk_reset_stats(), summed over all sessions. Counters of sessions
+ * running meanwhile may be caught in the middle of an update.
+ *
+ * @param out - filled with the statistics.
+ * @return SDO_SUCCESS, or SDO_ERROR if out is NULL.
+ */
+sdo_sdk_status sdo_sdk_get_stats(sdo_sdk_stats *out)
+{
+	if (!out)
+		return SDO_ERROR;
+	if (memcpy_s(out, sizeof(*out), &stats, sizeof(stats)) != 0)
+		return SDO_ERROR;
+	return SDO_SUCCESS;
+}
+
+/**
+ * Set all statistics back to zero.
+ */
+void sdo_sdk_reset_stats(void)
+{
+	if (memset_s(&stats, sizeof(stats), 0) != 0)
+		LOG(LOG_ERROR, "Failed to reset the statistics\n");
+}
+
+/**
+ * Lowest latency that falls into a bucket of a latency histogram.
+ *
+ * @param bucket - index of the bucket.
+ * @return latency in microseconds, UINT64_MAX past the last bucket.
+ */
+uint64_t sdo_sdk_stats_bucket(uint32_t bucket)
+{
+	if (bucket >= SDO_STATS_HIST_BUCKETS)
+		return UINT64_MAX;
+	if (bucket < 4)
+		return bucket;
+	return (uint64_t)(4 + bucket % 4) << (bucket / 4 - 1);
+}
+
+/**
+ * Latency below which a share of the samples of a histogram falls, rounded
+ * up to the end of its bucket.
+ *
+ * @param hist - latency histogram.
+ * @param percent - share of the samples, 1 to 100.
+ * @return latency in microseconds, 0 if the histogram is empty.
+ */
+uint64_t sdo_sdk_stats_percentile(const sdo_sdk_latency_hist *hist,
+				  uint32_t percent)
+{
+	uint64_t seen = 0;
+	uint32_t i;
+
+	if (!hist || !hist->count || !percent)
+		return 0;
+	if (percent > 100)
+		percent = 100;
+
+	for (i = 0; i < SDO_STATS_HIST_BUCKETS; i++) {
+		seen += hist->bucket[i];
+		if (seen * 100 >= (uint64_t)hist->count * percent)
+			break;
+	}
+	if (i >= SDO_STATS_HIST_BUCKETS - 1)
+		return ((uint64_t)1 << 32) - 1;
+	return sdo_sdk_stats_bucket(i + 1) - 1;
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Phase tracing: begin/end events of the protocol message handlers,
+ * the network exchanges, the crypto operations and the blob accesses.
+ *
+ * Built with TRACE=true, each trace point reports an event to the callback
+ * registered with sdo_sdk_register_trace_cb() and appends it to the file
+ * opened with sdo_sdk_trace_to_file(), in the Chrome trace event format
+ * (load it in chrome://tracing or Perfetto). Spans begin and end on the same
+ * thread and nest, so a msg44 span holds its signature and the receive that
+ * follows it. Without a callback or file a trace point costs one load and
+ * branch; built without TRACE, nothing.
+ *
+ * Events that are not told their message take the one whose handler runs on
+ * the calling thread, so crypto and storage time is charged to the message
+ * it was spent for.
+ */
+
+#include "util.h"
+#include "sdotrace.h"
+#include "network_al.h"
+
+#ifdef TRACE_ENABLED
+#include <stdio.h>
+#include <pthread.h>
+
+volatile bool sdo_trace_on;
+
+static sdo_sdk_traceCB trace_callback;
+
+static const char *const cat_name[SDO_TRACE_CAT_MAX] = {
+    [SDO_TRACE_MSG] = "msg",
+    [SDO_TRACE_NET] = "net",
+    [SDO_TRACE_CRYPTO] = "crypto",
+    [SDO_TRACE_STORAGE] = "storage",
+};
+
+/* Chrome trace file, written as one JSON array */
+static struct {
+	pthread_mutex_t lock;
+	FILE *f;
+	bool first;	/* no event written yet */
+	uint64_t t0_us; /* time stamps in the file start at the open */
+} trace_file = {PTHREAD_MUTEX_INITIALIZER, NULL, true, 0};
+
+static uint32_t next_tid;
+static __thread uint32_t thread_tid;
+/* message whose handler runs on this thread, 0 if none */
+static __thread int32_t thread_msg;
+
+/**
+ * Internal API
+ * Append an event to the trace file.
+ */
+static void trace_file_write(const sdo_sdk_trace_event *ev)
+{
+	(void)pthread_mutex_lock(&trace_file.lock);
+	if (!trace_file.f)
+		goto end;
+
+	if (!trace_file.first && fputc(',', trace_file.f) == EOF)
+		goto end;
+	(void)fputs("\n{\"name\":\"", trace_file.f);
+	if (ev->cat == SDO_TRACE_MSG)
+		(void)fprintf(trace_file.f, "msg%d", (int)ev->msg_type);
+	else
+		(void)fputs(ev->name, trace_file.f);
+	(void)fprintf(trace_file.f,
+		      "\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":1,"
+		      "\"tid\":%u,\"args\":{\"msg\":%d}}",
+		      cat_name[ev->cat], ev->phase,
+		      (unsigned long long)(ev->ts_us > trace_file.t0_us
+					       ? ev->ts_us - trace_file.t0_us
+					       : 0),
+		      (unsigned int)ev->tid, (int)ev->msg_type);
+	trace_file.first = false;
+end:
+	(void)pthread_mutex_unlock(&trace_file.lock);
+}
+
+/**
+ * Internal API
+ * Report an event to the trace callback and file. Called through
+ * SDO_TRACE() once tracing is on.
+ * @param cat - layer the traced code runs in.
+ * @param name - what runs; must outlive the trace.
+ * @param msg_type - message it belongs to, 0 for the message whose handler
+ * runs on the calling thread.
+ * @param phase - 'B' as it begins, 'E' as it ends.
+ */
+void sdo_trace(sdo_sdk_trace_cat cat, const char *name, int32_t msg_type,
+	       char phase)
+{
+	sdo_sdk_traceCB cb = trace_callback;
+	sdo_sdk_trace_event ev;
+
+	if (cat == SDO_TRACE_MSG)
+		thread_msg = phase == 'B' ? msg_type : 0;
+	else if (!msg_type)
+		msg_type = thread_msg;
+
+	if (!thread_tid)
+		thread_tid = __sync_add_and_fetch(&next_tid, 1);
+
+	ev.name = name;
+	ev.msg_type = msg_type;
+	ev.cat = cat;
+	ev.phase = phase;
+	ev.tid = thread_tid;
+	ev.ts_us = sdo_get_time_us();
+
+	if (cb)
+		cb(&ev);
+	if (trace_file.f)
+		trace_file_write(&ev);
+}
+
+/**
+ * Internal API
+ * Turn the trace points on while there is a callback or file.
+ */
+static void trace_update(void)
+{
+	sdo_trace_on = trace_callback || trace_file.f;
+}
+#endif
+
+/**
+ * Register a callback invoked with every trace event. It runs on the thread
+ * that hit the trace point, in the middle of the traced phase, so it should
+ * return quickly.
+ *
+ * @param cb - callback, or NULL to unregister.
+ * @return SDO_SUCCESS, or SDO_ERROR if the SDK was built without TRACE.
+ */
+sdo_sdk_status sdo_sdk_register_trace_cb(sdo_sdk_traceCB cb)
+{
+#ifdef TRACE_ENABLED
+	trace_callback = cb;
+	trace_update();
+	return SDO_SUCCESS;
+#else
+	(void)cb;
+	return SDO_ERROR;
+#endif
+}
+
+/**
+ * Write trace events to a file in the Chrome trace event format, replacing
+ * the file that is open. The file is complete once it is closed by a call
+ * with NULL; it stays open across sdo_sdk_deinit() and sdo_sdk_init(), so
+ * that one file can hold several runs.
+ *
+ * @param path - file to create, or NULL to close the open one.
+ * @return SDO_SUCCESS, or SDO_ERROR if the file cannot be created or the
+ * SDK was built without TRACE.
+ */
+sdo_sdk_status sdo_sdk_trace_to_file(const char *path)
+{
+#ifdef TRACE_ENABLED
+	sdo_sdk_status ret = SDO_SUCCESS;
+	FILE *f = NULL;
+
+	if (path) {
+		f = fopen(path, "w");
+		if (!f || fputs("[", f) < 0) {
+			LOG(LOG_ERROR, "Trace: cannot create %s\n", path);
+			if (f)
+				(void)fclose(f);
+			return SDO_ERROR;
+		}
+	}
+
+	(void)pthread_mutex_lock(&trace_file.lock);
+	if (trace_file.f) {
+		if (fputs("\n]\n", trace_file.f) < 0)
+			ret = SDO_ERROR;
+		if (fclose(trace_file.f) != 0)
+			ret = SDO_ERROR;
+		if (ret != SDO_SUCCESS)
+			LOG(LOG_ERROR, "Trace: failed to complete the trace "
+				       "file\n");
+	}
+	trace_file.f = f;
+	trace_file.first = true;
+	trace_file.t0_us = sdo_get_time_us();
+	trace_update();
+	(void)pthread_mutex_unlock(&trace_file.lock);
+	return ret;
+#else
+	(void)path;
+	return SDO_ERROR;
+#endif
+}
@@ -22,6 +22,7 @@
 #include "safe_lib.h"
 #include "snprintf_s.h"
 #include "sdodeviceinfo.h"
+#include "sdoosi.h"
 
 int keyfromstring(const char *key);
 
@@ -4258,7 +4259,8 @@ void sdo_kv_write(sdow_t *sdow, sdo_key_value_t *kv)
 
 /**
  * Read multiple Sv_info (OSI) Key/Value pairs from the input buffer
- * All Key-value pairs MUST be a null terminated strings.
+ * The pairs are handed to the modules as views into the input buffer,
+ * nothing is copied.
  * @param sdor - pointer to the input buffer
  * @param module_list - Global Module List Head Pointer.
  * @param kv - pointer to the Sv_info key/value pair
@@ -4268,10 +4270,8 @@ void sdo_kv_write(sdow_t *sdow, sdo_key_value_t *kv)
  */
 bool sdo_osi_parsing(sdor_t *sdor,
 		     sdo_sdk_service_info_module_list_t *module_list,
-		     sdo_sdk_si_key_value *kv, int *cb_return_val)
+		     sdo_sdk_si_kv_view *kv, int *cb_return_val)
 {
-	int str_len;
-
 	if (!cb_return_val)
 		return false;
 
@@ -4285,45 +4285,20 @@ bool sdo_osi_parsing(sdor_t *sdor,
 	// for "sv" tag and "end of Msg 49".
 
 	while (sdor->b.cursor < sdor->b.block_size - 2) {
-		// get len of "key" in KV pair
-		str_len = sdo_read_string_sz(sdor);
-
-		kv->key = sdo_alloc(str_len + 1); // +1 for null termination
-
-		if (!kv->key) {
-			LOG(LOG_ERROR, "Malloc failed!\n");
-			return false;
-		}
-
-		// read tag "" from KV pair and copy to "kv->key"
-		sdo_read_tag(sdor, kv->key, str_len + 1);
-
-		// get len of "value" in KV pair
-		str_len = sdo_read_string_sz(sdor);
-
-		kv->value = sdo_alloc(str_len + 1); // +1 for null termination
-
-		if (!kv->value) {
-			LOG(LOG_ERROR, "Malloc failed!\n");
-			sdo_free(kv->key);
+		if (!sdo_read_tag_view(sdor, &kv->key.data, &kv->key.len) ||
+		    !sdo_read_string_view(sdor, &kv->value.data,
+					  &kv->value.len)) {
+			*cb_return_val = MESSAGE_BODY_ERROR;
 			return false;
 		}
 
-		// read value for above tag and copy into "kv->value"
-		sdo_read_string(sdor, kv->value, str_len + 1);
-
-		LOG(LOG_DEBUG, "OSI_KV pair:\n_key->%s,Value->%s\n", kv->key,
-		    kv->value);
+		LOG(LOG_DEBUG, "OSI_KV pair:\n_key->%.*s,Value->%.*s\n",
+		    (int)kv->key.len, (char *)kv->key.data,
+		    (int)kv->value.len, (char *)kv->value.data);
 
 		// call module callback's with appropriate KV pairs
-		if (!sdo_osi_handling(module_list, kv, cb_return_val)) {
-			sdo_free(kv->key);
-			sdo_free(kv->value);
+		if (!sdo_osi_handling(module_list, kv, cb_return_val))
 			return false;
-		}
-		// free present KV pair memory
-		sdo_free(kv->key);
-		sdo_free(kv->value);
 	}
 
 	return true;
@@ -4333,6 +4308,142 @@ bool sdo_osi_parsing(sdor_t *sdor,
 // Service_info handling
 //
 
+/* Entries a table starts out with */
+#define SDO_SI_MIN_KV 8
+
+/* What sdo_service_info_fetch()/get() point at when a table has no entries */
+static sdo_key_value_t *sdo_si_no_kv;
+
+/**
+ * Internal API
+ * FNV-1a hash of a name, optionally of its lower case form.
+ */
+static uint32_t sdo_name_hash(const char *name, size_t name_len,
+			      bool fold_case)
+{
+	uint32_t hash = 2166136261u;
+	uint8_t c;
+
+	while (name_len--) {
+		c = (uint8_t)*name++;
+		if (fold_case && c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		hash ^= c;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * Internal API
+ * @return the length of the key of kv, which may or may not count a
+ * terminating NUL in its byte_sz.
+ */
+static size_t sdo_si_key_len(const sdo_key_value_t *kv)
+{
+	if (!kv->key || !kv->key->bytes || kv->key->byte_sz <= 0)
+		return 0;
+	return strnlen_s(kv->key->bytes, kv->key->byte_sz);
+}
+
+/**
+ * Internal API
+ * @return true if the key of kv is key, compared without case.
+ */
+static bool sdo_si_key_eq(const sdo_key_value_t *kv, const char *key,
+			  size_t key_len)
+{
+	int res = 1;
+
+	if (sdo_si_key_len(kv) != key_len)
+		return false;
+	return strcasecmp_s(key, key_len, kv->key->bytes, &res) == 0 &&
+	       res == 0;
+}
+
+/**
+ * Internal API
+ * @return the bytes sdo_combine_platform_dsis() writes for kv, without the
+ * comma that separates it from the previous one.
+ */
+static size_t sdo_si_kv_write_sz(const sdo_key_value_t *kv)
+{
+	if (!kv->key || !kv->val)
+		return 0;
+	// "key":"value"
+	return sdo_write_string_size(kv->key->bytes, kv->key->byte_sz) + 1 +
+	       sdo_write_string_size(kv->val->bytes, kv->val->byte_sz);
+}
+
+/**
+ * Internal API
+ * Index the entry at position pos of the table, unless an earlier entry
+ * has the same key: lookups find the first one, as they did when the
+ * table was a list.
+ */
+static void sdo_si_index_add(sdo_service_info_t *si, int pos)
+{
+	sdo_key_value_t *kv = si->kv[pos];
+	size_t key_len = sdo_si_key_len(kv);
+	uint32_t mask = 2 * si->max_kv - 1;
+	uint32_t i;
+
+	if (!key_len)
+		return;
+
+	i = sdo_name_hash(kv->key->bytes, key_len, true) & mask;
+	while (si->index[i]) {
+		if (sdo_si_key_eq(si->kv[si->index[i] - 1], kv->key->bytes,
+				  key_len))
+			return;
+		i = (i + 1) & mask;
+	}
+	si->index[i] = pos + 1;
+}
+
+/**
+ * Internal API
+ * Double the room of the table and rebuild its index.
+ * @return true if success, false on allocation failure.
+ */
+static bool sdo_si_grow(sdo_service_info_t *si)
+{
+	int max_kv = si->max_kv ? 2 * si->max_kv : SDO_SI_MIN_KV;
+	sdo_key_value_t **kv;
+	uint32_t *index;
+	int i;
+
+	kv = sdo_alloc((max_kv + 1) * sizeof(*kv));
+	index = sdo_alloc(2 * max_kv * sizeof(*index));
+	if (!kv || !index) {
+		LOG(LOG_ERROR, "Service_info: Malloc failed!\n");
+		if (kv)
+			sdo_free(kv);
+		if (index)
+			sdo_free(index);
+		return false;
+	}
+
+	if (si->numKV && memcpy_s(kv, max_kv * sizeof(*kv), si->kv,
+				  si->numKV * sizeof(*kv)) != 0) {
+		LOG(LOG_ERROR, "Service_info: Memcpy failed!\n");
+		sdo_free(kv);
+		sdo_free(index);
+		return false;
+	}
+	if (si->kv)
+		sdo_free(si->kv);
+	if (si->index)
+		sdo_free(si->index);
+	si->kv = kv;
+	si->index = index;
+	si->max_kv = max_kv;
+
+	for (i = 0; i < si->numKV; i++)
+		sdo_si_index_add(si, i);
+	return true;
+}
+
 /**
  * Allocate an empty sdo_service_info_t object.
  * @return an allocated sdo_service_info_t object.
@@ -4360,12 +4471,12 @@ sdo_service_info_t *sdo_service_info_alloc_with(char *key, char *val)
 	if (si == NULL)
 		return NULL;
 	kv = sdo_kv_alloc_with_str(key, val);
-	if (!kv) {
+	if (!kv || !sdo_service_info_add_kv(si, kv)) {
+		if (kv)
+			sdo_kv_free(kv);
 		sdo_service_info_free(si);
 		return NULL;
 	}
-	si->kv = kv;
-	si->numKV = 1;
 	return si;
 }
 
@@ -4377,67 +4488,66 @@ sdo_service_info_t *sdo_service_info_alloc_with(char *key, char *val)
 
 void sdo_service_info_free(sdo_service_info_t *si)
 {
-	sdo_key_value_t *kv = NULL;
+	int i;
 
 	if (!si)
 		return;
-	while ((kv = si->kv) != NULL) {
-		si->kv = kv->next;
-		sdo_kv_free(kv);
-	}
+	for (i = 0; si->kv && i < si->numKV; i++)
+		sdo_kv_free(si->kv[i]);
+	if (si->kv)
+		sdo_free(si->kv);
+	if (si->index)
+		sdo_free(si->index);
 	sdo_free(si);
 }
 
 /**
- * Compares the kv member of si with key parameter and
- * if there is match, return the matched pointer,
- * else last entry in the list.
+ * Look up the entry of si with the given key, compared without case.
  * @param si  - Pointer to the sdo_service_info_t object si,
  * @param key - Pointer to the char buffer key,
- * @return pointer to sdo_key_value_t.
+ * @return pointer to the entry's place in the table; it points to NULL if
+ * there is no such entry.
  */
 
 sdo_key_value_t **sdo_service_info_fetch(sdo_service_info_t *si,
 					 const char *key)
 {
-	sdo_key_value_t **kvp, *kv;
-	int res = 1;
+	uint32_t mask, i;
+	size_t keylen;
 
-	for (kvp = &si->kv; (kv = *kvp) != NULL; kvp = &kv->next) {
-		int keylen = strnlen_s(key, SDO_MAX_STR_SIZE);
+	if (!si || !si->kv || !key)
+		return &sdo_si_no_kv;
 
-		if (!keylen || keylen == SDO_MAX_STR_SIZE) {
-			LOG(LOG_DEBUG, "strlen() failed!\n");
-			continue;
-		}
+	keylen = strnlen_s(key, SDO_MAX_STR_SIZE);
+	if (!keylen || keylen == SDO_MAX_STR_SIZE) {
+		LOG(LOG_DEBUG, "strlen() failed!\n");
+		return &si->kv[si->numKV];
+	}
 
-		if ((strcasecmp_s(key, keylen, (char *)(kv->key->bytes),
-				  &res) == 0) &&
-		    res == 0)
-			break;
+	mask = 2 * si->max_kv - 1;
+	i = sdo_name_hash(key, keylen, true) & mask;
+	while (si->index[i]) {
+		if (sdo_si_key_eq(si->kv[si->index[i] - 1], key, keylen))
+			return &si->kv[si->index[i] - 1];
+		i = (i + 1) & mask;
 	}
-	return kvp;
+	return &si->kv[si->numKV];
 }
 /**
- * Compares the corresponding index associated with kv member of si
- * & key_num parameter, if there is match, return the matched pointer,
- * else last entry in the list.
+ * Get the entry of si at position key_num, in insertion order.
  * @param si  - Pointer to the sdo_service_info_t object si,
  * @param key_num - Integer variable determines service request Info number,
- * @return pointer to sdo_key_value_t.
+ * @return pointer to the entry's place in the table; it points to NULL if
+ * there is no such entry.
  */
 
 sdo_key_value_t **sdo_service_info_get(sdo_service_info_t *si, int key_num)
 {
-	sdo_key_value_t **kvp, *kv;
-	int index;
-
-	for (kvp = &si->kv, index = 0; (kv = *kvp) != NULL;
-	     kvp = &kv->next, index++) {
-		if (index == key_num)
-			break;
-	}
-	return kvp;
+	if (!si || !si->kv)
+		return &sdo_si_no_kv;
+	if (key_num < 0 || key_num >= si->numKV)
+		return &si->kv[si->numKV];
+	return &si->kv[key_num];
 }
 /**
  * si & key are input to the function, it looks for the matching
@@ -4454,24 +4564,27 @@ sdo_key_value_t **sdo_service_info_get(sdo_service_info_t *si, int key_num)
 bool sdo_service_info_add_kv_str(sdo_service_info_t *si, const char *key,
 				 const char *val)
 {
-	sdo_key_value_t **kvp, *kv;
+	sdo_key_value_t *kv;
+	bool ret = true;
 
 	if (!si || !key || !val)
 		return false;
 
-	kvp = sdo_service_info_fetch(si, key);
-	kv = *kvp;
+	kv = *sdo_service_info_fetch(si, key);
 	if (kv == NULL) {
-		 /* Not found, at end of linked list, add a new entry */
+		 /* Not found, add a new entry at the end */
 		kv = sdo_kv_alloc_with_str(key, val);
 		if (kv == NULL)
 			return false;
-		*kvp = kv;  /* Use this pointer to update the next value */
-		si->numKV++;
+		if (!sdo_service_info_add_kv(si, kv)) {
+			sdo_kv_free(kv);
+			return false;
+		}
 		return true;
 	}
 
 	 /* Found, update value */
+	si->write_sz -= sdo_si_kv_write_sz(kv);
 	if (kv->val == NULL) {
 		 /* No allocated string present for value, make a new one */
 		kv->val = sdo_string_alloc_with_str(val);
@@ -4484,86 +4597,297 @@ bool sdo_service_info_add_kv_str(sdo_service_info_t *si, const char *key,
 			    "is either 'NULL' or"
 			    "'isn't 'NULL-terminating'\n", __func__);
 			sdo_string_free(kv->val);
-			return false;
+			kv->val = NULL;
+			ret = false;
+		} else {
+			 /* Update the string */
+			sdo_string_resize_with(kv->val, val_len, val);
 		}
-
-		 /* Update the string */
-		sdo_string_resize_with(kv->val, val_len, val);
 	}
+	si->write_sz += sdo_si_kv_write_sz(kv);
 
-	return true;
+	return ret;
 }
 /**
- * Add kvs object of type sdo_key_value_t to the end of the list(si) if
- * not empty else add it to the head.
- * @param si  - Pointer to the sdo_service_info_t list,
+ * Add kvs object of type sdo_key_value_t at the end of the table si.
+ * @param si  - Pointer to the sdo_service_info_t table,
  * @param kvs - Pointer to the sdo_key_value_t kvs, to be added,
  * @return true if updated correctly else false.
  */
 
 bool sdo_service_info_add_kv(sdo_service_info_t *si, sdo_key_value_t *kvs)
 {
-	sdo_key_value_t *kv = NULL;
-
 	if (!si || !kvs)
 		return false;
 
-	// Is the list empty?  If it is, add this to the head of the list
-	if (si->kv == NULL) {
-		si->kv = kvs;
-		si->numKV = 1;
-		kvs->next = NULL;
-	} else {
-		// Find the last entry
-		for (kv = si->kv; kv->next != NULL; kv = kv->next)
-			;
-		kv->next = kvs;
-		si->numKV++;
-		kvs->next = NULL;
-	}
+	// keep the index at most half full
+	if (si->numKV == si->max_kv && !sdo_si_grow(si))
+		return false;
+
+	si->kv[si->numKV] = kvs;
+	sdo_si_index_add(si, si->numKV);
+	si->numKV++;
+	si->kv[si->numKV] = NULL;
+	si->write_sz += sdo_si_kv_write_sz(kvs) + (si->numKV > 1 ? 1 : 0);
 	return true;
 }
 
 /**
  * Combine sdo_key_value_t objects into a single string from already built
- * platform DSI list.
+ * platform DSI table.
  * @param sdow  - Pointer to the output buffer.
- * @param si  - Pointer to the sdo_service_info_t list containing all platform
- * DSI's.
+ * @param si  - Pointer to the sdo_service_info_t table containing all
+ * platform DSI's.
  * @return true if combined successfully else false.
  */
 
 bool sdo_combine_platform_dsis(sdow_t *sdow, sdo_service_info_t *si)
 {
-	int num = 0;
-	bool ret = false;
-	sdo_key_value_t **kvp = NULL;
+	int num;
 	sdo_key_value_t *kv = NULL;
 
-	if (!sdow || !si)
-		goto end;
+	if (!sdow || !si || (si->numKV && !si->kv))
+		return false;
 
-	// fetch all platfrom DSI's one-by-one
-	while (num != si->numKV) {
-		kvp = sdo_service_info_get(si, num);
+	// make room for all platform DSI's at once
+	sdo_resize_block(&sdow->b, sdow->b.cursor + si->write_sz + 1);
+	if (!sdow->b.block)
+		return false;
 
-		kv = *kvp;
-		if (!kv || !kv->key || !kv->val) {
+	for (num = 0; num < si->numKV; num++) {
+		kv = si->kv[num];
+		if (!kv->key || !kv->val) {
 			LOG(LOG_ERROR, "Plaform DSI: key-value not found!\n");
-			goto end;
+			return false;
 		}
 
 		// Write KV pair
 		sdo_write_tag_len(sdow, kv->key->bytes, kv->key->byte_sz);
 		sdo_write_string_len(sdow, kv->val->bytes, kv->val->byte_sz);
 		sdow->need_comma = true;
+	}
+
+	return true;
+}
+
+/*
+ * Module registry: an open-addressed hash table from module name to list
+ * entry, kept by the head of the list. Every PSI tuple and OSI pair names
+ * its module, so the lookup must not grow with the number of modules.
+ */
+struct sdo_sv_info_index_s {
+	uint32_t mask;
+	sdo_sdk_service_info_module_list_t **slot;
+};
+
+/**
+ * Internal API
+ * @return true if the module name of mod_len bytes is name.
+ */
+static bool sdo_sv_info_name_eq(const char *mod_name, size_t mod_len,
+				const char *name, size_t name_len)
+{
+	int diff = 1;
+
+	if (mod_len != name_len)
+		return false;
+	if (!name_len)
+		return true;
+	return memcmp_s(mod_name, mod_len, name, name_len, &diff) == 0 &&
+	       diff == 0;
+}
+
+/**
+ * Index the modules of a list by name. Done once all modules are
+ * registered; without an index, lookups walk the list. When two modules
+ * share a name, the first one is found, as with the walk.
+ * @param module_list - Global Module List Head Pointer.
+ * @return true if success, false otherwise
+ */
+bool sdo_sv_info_index_build(sdo_sdk_service_info_module_list_t *module_list)
+{
+	struct sdo_sv_info_index_s *index;
+	sdo_sdk_service_info_module_list_t *mod, *other;
+	uint32_t count = 0, size = 8, i;
 
-		num++;
+	if (!module_list)
+		return false;
+
+	sdo_sv_info_index_free(module_list);
+	for (mod = module_list; mod; mod = mod->next) {
+		mod->name_len =
+		    strnlen_s(mod->module.module_name, SDO_MODULE_NAME_LEN);
+		count++;
 	}
+	// at most half full, so that probe sequences stay short
+	while (size < 2 * count)
+		size <<= 1;
 
-	ret = true;
-end:
-	return ret;
+	index = sdo_alloc(sizeof(*index) + size * sizeof(*index->slot));
+	if (!index) {
+		LOG(LOG_ERROR, "Sv_info: Malloc failed for the module index\n");
+		return false;
+	}
+	index->mask = size - 1;
+	index->slot = (sdo_sdk_service_info_module_list_t **)(index + 1);
+
+	for (mod = module_list; mod; mod = mod->next) {
+		i = sdo_name_hash(mod->module.module_name, mod->name_len, false) &
+		    index->mask;
+		while ((other = index->slot[i]) != NULL &&
+		       !sdo_sv_info_name_eq(other->module.module_name,
+					    other->name_len,
+					    mod->module.module_name,
+					    mod->name_len))
+			i = (i + 1) & index->mask;
+		if (other) {
+			LOG(LOG_ERROR, "Sv_info: module %s registered twice\n",
+			    mod->module.module_name);
+			continue;
+		}
+		index->slot[i] = mod;
+	}
+
+	module_list->index = index;
+	return true;
+}
+
+/**
+ * Drop the module index of a list.
+ * @param module_list - Global Module List Head Pointer.
+ */
+void sdo_sv_info_index_free(sdo_sdk_service_info_module_list_t *module_list)
+{
+	if (module_list && module_list->index)
+		sdo_free(module_list->index);
+}
+
+/**
+ * Find a module by name.
+ * @param module_list - Global Module List Head Pointer.
+ * @param name - module name, not necessarily NUL-terminated.
+ * @param name_len - length of name.
+ * @return the module's list entry, or NULL if there is none.
+ */
+sdo_sdk_service_info_module_list_t *
+sdo_sv_info_find_module(sdo_sdk_service_info_module_list_t *module_list,
+			const char *name, size_t name_len)
+{
+	struct sdo_sv_info_index_s *index;
+	sdo_sdk_service_info_module_list_t *mod;
+	uint32_t i;
+
+	if (!module_list || !name)
+		return NULL;
+
+	index = module_list->index;
+	if (!index) {
+		for (mod = module_list; mod; mod = mod->next)
+			if (sdo_sv_info_name_eq(
+				mod->module.module_name,
+				strnlen_s(mod->module.module_name,
+					  SDO_MODULE_NAME_LEN),
+				name, name_len))
+				return mod;
+		return NULL;
+	}
+
+	i = sdo_name_hash(name, name_len, false) & index->mask;
+	while ((mod = index->slot[i]) != NULL) {
+		if (sdo_sv_info_name_eq(mod->module.module_name, mod->name_len,
+					name, name_len))
+			return mod;
+		i = (i + 1) & index->mask;
+	}
+	return NULL;
+}
+
+/**
+ * Internal API
+ * Copy a view into a NUL-terminated string.
+ */
+static char *sdo_mod_strndup(const sdo_sdk_si_view *view)
+{
+	char *str = sdo_alloc(view->len + 1);
+
+	if (!str) {
+		LOG(LOG_ERROR, "Malloc failed!\n");
+		return NULL;
+	}
+	if (view->len && memcpy_s(str, view->len + 1, view->data, view->len)) {
+		LOG(LOG_ERROR, "Memcpy failed!\n");
+		sdo_free(str);
+	}
+	return str;
+}
+
+/**
+ * Internal API
+ * Call the callback of a module. v2 modules get the views as they are;
+ * string modules get NUL-terminated copies, and the strings they return
+ * for SDO_SI_GET_DSI are turned into views.
+ * @param module - the module to call.
+ * @param type - a valid Sv_info type.
+ * @param count - count or index argument of the callback.
+ * @param kv - key/value views, NULL for the types that carry none.
+ * @return the callback return value.
+ */
+static int sdo_mod_callback(sdo_sdk_service_info_module *module,
+			    sdo_sdk_si_type type, int *count,
+			    sdo_sdk_si_kv_view *kv)
+{
+	sdo_sdk_si_key_value sv = {NULL, NULL};
+	size_t key_len, value_len;
+	int ret = SDO_SI_INTERNAL_ERROR;
+
+	if (module->service_info_callback_v2)
+		return module->service_info_callback_v2(type, count, kv);
+	if (!module->service_info_callback)
+		return SDO_SI_INTERNAL_ERROR;
+	if (!kv)
+		return module->service_info_callback(type, count, NULL);
+
+	switch (type) {
+	case SDO_SI_SET_PSI:
+		// string modules keep PSI in fixed size buffers
+		if (kv->key.len > SDO_MODULE_MSG_LEN ||
+		    kv->value.len >= SDO_MODULE_VALUE_LEN) {
+			LOG(LOG_ERROR, "Module max-msg/val-len limit "
+				       "exceeded!\n");
+			return SDO_SI_CONTENT_ERROR;
+		}
+		/* fall through */
+	case SDO_SI_SET_OSI:
+		sv.key = sdo_mod_strndup(&kv->key);
+		sv.value = sdo_mod_strndup(&kv->value);
+		if (sv.key && sv.value)
+			ret = module->service_info_callback(type, count, &sv);
+		if (sv.key)
+			sdo_free(sv.key);
+		if (sv.value)
+			sdo_free(sv.value);
+		return ret;
+	case SDO_SI_GET_DSI:
+		ret = module->service_info_callback(type, count, &sv);
+		if (ret != SDO_SI_SUCCESS)
+			return ret;
+		if (!sv.key || !sv.value)
+			return SDO_SI_INTERNAL_ERROR;
+		key_len = strnlen_s(sv.key, SDO_MAX_STR_SIZE);
+		value_len = strnlen_s(sv.value, SDO_MAX_STR_SIZE);
+		if (key_len == SDO_MAX_STR_SIZE ||
+		    value_len == SDO_MAX_STR_SIZE) {
+			LOG(LOG_ERROR, "strlen() failed!\n");
+			return SDO_SI_INTERNAL_ERROR;
+		}
+		kv->key.data = (uint8_t *)sv.key;
+		kv->key.len = key_len;
+		kv->value.data = (uint8_t *)sv.value;
+		kv->value.len = value_len;
+		return ret;
+	default:
+		return module->service_info_callback(type, count, NULL);
+	}
 }
 
 /**
@@ -4577,8 +4901,8 @@ bool sdo_mod_exec_sv_infotype(sdo_sdk_service_info_module_list_t *module_list,
 			      sdo_sdk_si_type type)
 {
 	while (module_list) {
-		if (module_list->module.service_info_callback(
-			type, NULL, NULL) != SDO_SI_SUCCESS) {
+		if (sdo_mod_callback(&module_list->module, type, NULL,
+				     NULL) != SDO_SI_SUCCESS) {
 			LOG(LOG_DEBUG, "Sv_info: %s's CB Failed for type:%d\n",
 			    module_list->module.module_name, type);
 			return false;
@@ -4620,8 +4944,8 @@ bool sdo_get_dsi_count(sdo_sdk_service_info_module_list_t *module_list,
 	while (module_list) {
 		count = 0;
 		// check if module CB is successful
-		*cb_return_val = module_list->module.service_info_callback(
-		    SDO_SI_GET_DSI_COUNT, &count, NULL);
+		*cb_return_val = sdo_mod_callback(
+		    &module_list->module, SDO_SI_GET_DSI_COUNT, &count, NULL);
 		if (*cb_return_val != SDO_SI_SUCCESS) {
 			LOG(LOG_ERROR, "Sv_info: %s's DSI COUNT CB Failed!\n",
 			    module_list->module.module_name);
@@ -4639,66 +4963,132 @@ bool sdo_get_dsi_count(sdo_sdk_service_info_module_list_t *module_list,
 }
 
 /**
- * Traverse the list for OSI, comparing list with name & calling the appropriate
- * CB.
+ * Internal API
+ * Base64-decode a value in place; the view is updated to the decoded bytes.
+ * @return true if success, false if the value is not base64.
+ */
+static bool sdo_mod_decode_b64(sdo_sdk_si_view *value)
+{
+	int bin_len;
+
+	if (!value->len)
+		return true;
+
+	bin_len = b64To_bin(value->len, value->data, 0, value->len,
+			    value->data, 0);
+	if (bin_len < 0)
+		return false;
+
+	value->len = (size_t)bin_len;
+	return true;
+}
+
+/**
+ * Internal API
+ * Hand an OSI message to a module.
+ * @param module - the module's list entry.
+ * @param sv_kv - module message and value. The value is base64-decoded in
+ * place for modules that ask for it.
+ * @param cb_return_val - filled with the CB return value.
+ * @return true if success, false otherwise. For SDO_SI_FLAG_ASYNC_OSI
+ * modules the CB runs later, see sdoosi.c.
+ */
+static bool sdo_module_osi(sdo_sdk_service_info_module_list_t *module,
+			   sdo_sdk_si_kv_view *sv_kv, int *cb_return_val)
+{
+	if (module->module.service_info_callback_v2 &&
+	    (module->module.flags & SDO_SI_FLAG_DECODE_B64) &&
+	    !sdo_mod_decode_b64(&sv_kv->value)) {
+		LOG(LOG_ERROR, "Sv_info: %s's OSI value is not base64\n",
+		    module->module.module_name);
+		*cb_return_val = SDO_SI_CONTENT_ERROR;
+		return false;
+	}
+
+	if (module->module.service_info_callback_v2 &&
+	    (module->module.flags & SDO_SI_FLAG_ASYNC_OSI)) {
+		// the module's worker takes it from here
+		return sdo_osi_async_dispatch(module, sv_kv, cb_return_val);
+	}
+
+	// check if module CB is successful
+	*cb_return_val = sdo_mod_callback(&module->module, SDO_SI_SET_OSI,
+					  &(module->module_osi_index), sv_kv);
+	// Inc OSI index per module
+	module->module_osi_index++;
+
+	if (*cb_return_val != SDO_SI_SUCCESS) {
+		LOG(LOG_ERROR, "Sv_info: %s's CB Failed for type:%d\n",
+		    module->module.module_name, SDO_SI_SET_OSI);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Look up the module of an OSI message & call the appropriate CB.
  * @param module_list - Global Module List Head Pointer.
  * @param mod_name - Pointer to the mod_name, to be compared with list's modname
- * @param sv_kv - Pointer of type sdo_sdk_si_key_value, holds Module message &
- * value.
+ * @param sv_kv - Pointer of type sdo_sdk_si_kv_view, holds Module message &
+ * value. The value is base64-decoded in place for modules that ask for it.
  * @param cb_return_val - Pointer of type int which will be filled with CB
  * return value.
- * @return true if success (module found in list + CB succeed) else false.
+ * @return true if success (module not found, or CB succeed) else false.
+ * For SDO_SI_FLAG_ASYNC_OSI modules the CB runs later, see sdoosi.c.
  */
 
 bool sdo_supply_moduleOSI(sdo_sdk_service_info_module_list_t *module_list,
-			  char *mod_name, sdo_sdk_si_key_value *sv_kv,
+			  char *mod_name, sdo_sdk_si_kv_view *sv_kv,
 			  int *cb_return_val)
 {
-	int strcmp_result = 1;
-	bool retval = false;
+	sdo_sdk_service_info_module_list_t *module;
 
 	if (!cb_return_val)
-		return retval;
+		return false;
 
 	if (!sv_kv || !mod_name) {
 		*cb_return_val = SDO_SI_INTERNAL_ERROR;
-		return retval;
+		return false;
 	}
 
-	retval = true;
-	while (module_list) {
-		strcmp_s(module_list->module.module_name, SDO_MODULE_NAME_LEN,
-			 mod_name, &strcmp_result);
-		if (strcmp_result == 0) {
-			// check if module CB is successful
-			*cb_return_val =
-			    module_list->module.service_info_callback(
-				SDO_SI_SET_OSI,
-				&(module_list->module_osi_index), sv_kv);
-
-			if (*cb_return_val != SDO_SI_SUCCESS) {
-				LOG(LOG_ERROR,
-				    "Sv_info: %s's CB Failed for type:%d\n",
-				    module_list->module.module_name,
-				    SDO_SI_SET_OSI);
-				retval = false;
-			}
-			// Inc OSI index per module
-			module_list->module_osi_index++;
-			break;
-		}
-		module_list = module_list->next;
-	}
+	module = sdo_sv_info_find_module(
+	    module_list, mod_name, strnlen_s(mod_name, SDO_MODULE_NAME_LEN));
+	if (!module)
+		return true;
 
-	return retval;
+	return sdo_module_osi(module, sv_kv, cb_return_val);
 }
 
 /**
- * Traverse the list for PSI, comparing list with name & calling the appropriate
- * CB.
+ * Internal API
+ * Hand a PSI message to a module.
+ * @param module - the module's list entry.
+ * @param sv_kv - module message and value.
+ * @param cb_return_val - filled with the CB return value.
+ * @return true if success else false.
+ */
+static bool sdo_module_psi(sdo_sdk_service_info_module_list_t *module,
+			   sdo_sdk_si_kv_view *sv_kv, int *cb_return_val)
+{
+	// check if module CB is successful
+	*cb_return_val = sdo_mod_callback(&module->module, SDO_SI_SET_PSI,
+					  &(module->module_psi_index), sv_kv);
+	// Inc PSI index per module
+	module->module_psi_index++;
+
+	if (*cb_return_val != SDO_SI_SUCCESS) {
+		LOG(LOG_ERROR, "Sv_info: %s's CB Failed for type:%d\n",
+		    module->module.module_name, SDO_SI_SET_PSI);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Look up the module of a PSI message & call the appropriate CB.
  * @param module_list - Global Module List Head Pointer.
  * @param mod_name - Pointer to the mod_name, to be compared with list's modname
- * @param sv_kv - Pointer of type sdo_sdk_si_key_value, holds Module message &
+ * @param sv_kv - Pointer of type sdo_sdk_si_kv_view, holds Module message &
  * value.
  * @param cb_return_val - Pointer of type int which will be filled with CB
  * return value.
@@ -4706,51 +5096,31 @@ bool sdo_supply_moduleOSI(sdo_sdk_service_info_module_list_t *module_list,
  */
 
 bool sdo_supply_modulePSI(sdo_sdk_service_info_module_list_t *module_list,
-			  char *mod_name, sdo_sdk_si_key_value *sv_kv,
+			  char *mod_name, sdo_sdk_si_kv_view *sv_kv,
 			  int *cb_return_val)
 {
-	int strcmp_result = 1;
-	bool retval = false;
+	sdo_sdk_service_info_module_list_t *module;
 
 	if (!cb_return_val)
-		return retval;
+		return false;
 
 	if (!sv_kv || !mod_name) {
 		*cb_return_val = SDO_SI_INTERNAL_ERROR;
-		return retval;
+		return false;
 	}
 
-	retval = true;
-	while (module_list) {
-		strcmp_s(module_list->module.module_name, SDO_MODULE_NAME_LEN,
-			 mod_name, &strcmp_result);
-		if (strcmp_result == 0) {
-			// check if module CB is successful
-			*cb_return_val =
-			    module_list->module.service_info_callback(
-				SDO_SI_SET_PSI,
-				&(module_list->module_psi_index), sv_kv);
-
-			if (*cb_return_val != SDO_SI_SUCCESS) {
-				LOG(LOG_ERROR,
-				    "Sv_info: %s's CB Failed for type:%d\n",
-				    module_list->module.module_name,
-				    SDO_SI_SET_PSI);
-				retval = false;
-			}
-			// Inc PSI index per module
-			module_list->module_psi_index++;
-			break;
-		}
-		module_list = module_list->next;
-	}
+	module = sdo_sv_info_find_module(
+	    module_list, mod_name, strnlen_s(mod_name, SDO_MODULE_NAME_LEN));
+	if (!module)
+		return true;
 
-	return retval;
+	return sdo_module_psi(module, sv_kv, cb_return_val);
 }
 
 /**
  * Parsing the psi & differentiate string on different delimeters and call the
- * appropriate API's.
+ * appropriate API's. Module messages and values are handed to the modules as
+ * views into psi.
  * @param module_list - Global Module List Head Pointer.
  * @param psi - Pointer to null termincated psi string
  * @param psi_len - length of psi buffer
@@ -4762,6 +5132,11 @@ bool sdo_supply_modulePSI(sdo_sdk_service_info_module_list_t *module_list,
 bool sdo_psi_parsing(sdo_sdk_service_info_module_list_t *module_list, char *psi,
 		     int psi_len, int *cb_return_val)
 {
+	sdo_sdk_service_info_module_list_t *module;
+	sdo_sdk_si_kv_view sv_kv;
+	char *tuple, *next, *end, *colon, *tilde;
+	size_t name_len;
+
 	if (!cb_return_val)
 		return false;
 
@@ -4771,59 +5146,53 @@ bool sdo_psi_parsing(sdo_sdk_service_info_module_list_t *module_list, char *psi,
 		return true;
 	}
 
-	char mod_name[SDO_MODULE_NAME_LEN] = {0};
-	char mod_message[SDO_MODULE_MSG_LEN] = {0};
-	char mod_value[SDO_MODULE_VALUE_LEN] = {0};
-
-	// single PSI tuple
-	char *psi_tuple = NULL;
-	int psi_tuple_len = 0;
-	char *notused = NULL;
-	// delimiter= ','
-	const char *del = ",";
-
-	// strtok_s accepts size_t for string length
-	size_t len = psi_len - 1; // Buffer size contains ending '\0' char
-
-	// split based on Delimiter
-	psi_tuple = strtok_s(psi, &len, del, &notused);
+	if (!psi || psi_len <= 0) {
+		*cb_return_val = SDO_SI_INTERNAL_ERROR;
+		return false;
+	}
 
-	while (psi_tuple) {
-#if LOG_LEVEL == LOG_MAX_LEVEL
-		static int i;
+	// Buffer size contains ending '\0' char
+	end = psi + strnlen_s(psi, psi_len);
 
-		LOG(LOG_DEBUG, "PSI Entry#%d: |%s|\n", i++, psi_tuple);
-#endif
+	// split based on delimiter ','; PSI tuple is "name:message~value"
+	for (tuple = psi; tuple < end; tuple = next + 1) {
+		next = memchr(tuple, ',', end - tuple);
+		if (!next)
+			next = end;
+		if (next == tuple)
+			continue;
 
-		psi_tuple_len = strnlen_s(psi_tuple, SDO_MAX_STR_SIZE);
+		LOG(LOG_DEBUG, "PSI Entry: |%.*s|\n", (int)(next - tuple),
+		    tuple);
 
-		if (!psi_tuple_len || psi_tuple_len == SDO_MAX_STR_SIZE) {
-			LOG(LOG_ERROR, "Strlen() failed!\n");
-			*cb_return_val = SDO_SI_INTERNAL_ERROR;
+		colon = memchr(tuple, ':', next - tuple);
+		tilde = colon ? memchr(colon, '~', next - colon) : NULL;
+		if (!colon || colon == tuple || !tilde) {
+			LOG(LOG_ERROR, "Bad PSI entry: |%.*s|\n",
+			    (int)(next - tuple), tuple);
+			*cb_return_val = MESSAGE_BODY_ERROR;
 			return false;
 		}
 
-		// Get Module name, message and value
-		if (!sdo_get_module_name_msg_value(psi_tuple, psi_tuple_len,
-						   mod_name, mod_message,
-						   mod_value, cb_return_val)) {
-			LOG(LOG_ERROR, "Bad PSI entry: |%s|\n", psi_tuple);
+		name_len = colon - tuple;
+		if (name_len > SDO_MODULE_NAME_LEN) {
+			LOG(LOG_ERROR, "Module max-name-len limit exceeded!\n");
+			*cb_return_val = SDO_SI_CONTENT_ERROR;
 			return false;
 		}
+		module = sdo_sv_info_find_module(module_list, tuple, name_len);
+		if (!module)
+			continue;
 
 		// Fill SI data structure
-		sdo_sdk_si_key_value sv_kv;
-
-		sv_kv.key = mod_message;
-		sv_kv.value = mod_value;
+		sv_kv.key.data = (uint8_t *)colon + 1;
+		sv_kv.key.len = tilde - colon - 1;
+		sv_kv.value.data = (uint8_t *)tilde + 1;
+		sv_kv.value.len = next - tilde - 1;
 
 		// call CB's for PSI
-		if (!sdo_supply_modulePSI(module_list, mod_name, &sv_kv,
-					  cb_return_val))
+		if (!sdo_module_psi(module, &sv_kv, cb_return_val))
 			return false;
-
-		// check for next PSI tuple
-		psi_tuple = strtok_s(NULL, &len, del, &notused);
 	}
 
 	// module CB's were successful
@@ -4832,79 +5201,88 @@ bool sdo_psi_parsing(sdo_sdk_service_info_module_list_t *module_list, char *psi,
 }
 
 /**
- * Create Key_value Pair using mod_name sv_kv key-value pair
+ * Internal API
+ * Create the DSI key-value pair "mod_name:key":"value" of a module.
  * @param mod_name - Pointer to the char, to be used as a partial key
- * @param sv_kv - Pointer of type sdo_sdk_si_key_value, which holds message &
- * value.
+ * @param kv - key/value views returned by the module
+ * @param sv_kv - filled with the allocated key and value strings
  * @return true if success else false.
  */
-
-bool sdo_mod_data_kv(char *mod_name, sdo_sdk_si_key_value *sv_kv)
+static bool sdo_mod_data_kv_view(const char *mod_name,
+				 const sdo_sdk_si_kv_view *kv,
+				 sdo_sdk_si_key_value *sv_kv)
 {
-	// Example : "keypair:pubkey":"sample o/p of pubkey"
-	sdo_sdk_si_key_value sv_kv_t;
-
-	if (!mod_name || !sv_kv || !sv_kv->key || !sv_kv->value)
-		return false;
-
-	int strlen_name = strnlen_s(mod_name, SDO_MAX_STR_SIZE);
-	int strlen_sv_key = strnlen_s(sv_kv->key, SDO_MAX_STR_SIZE);
+	size_t name_len = strnlen_s(mod_name, SDO_MAX_STR_SIZE);
+	size_t key_size;
+	char *key, *value;
 
-	if (!strlen_name || !strlen_sv_key ||
-	    strlen_sv_key == SDO_MAX_STR_SIZE ||
-	    strlen_name == SDO_MAX_STR_SIZE) {
+	if (!name_len || name_len == SDO_MAX_STR_SIZE || !kv->key.len ||
+	    kv->key.len >= SDO_MAX_STR_SIZE ||
+	    kv->value.len >= SDO_MAX_STR_SIZE) {
 		LOG(LOG_ERROR, "strlen() failed!\n");
 		return false;
 	}
 
-	// + 1 is for ':' between mod_name & mod message(sv_kv->key)
+	// + 1 is for ':' between mod_name & mod message
 	// +1 for terminating null character
-	int sv_kv_t_key_size = strlen_name + strlen_sv_key + 2;
-
-	sv_kv_t.key = sdo_alloc(sv_kv_t_key_size);
-
-	if (!sv_kv_t.key) {
+	key_size = name_len + kv->key.len + 2;
+	key = sdo_alloc(key_size);
+	value = sdo_alloc(kv->value.len + 1);
+	if (!key || !value) {
 		LOG(LOG_ERROR, "Malloc Failed!\n");
-		return false;
+		goto err;
 	}
 
-	if (strcpy_s(sv_kv_t.key, sv_kv_t_key_size, mod_name) != 0) {
-		LOG(LOG_ERROR, "strcpy() failed!\n");
-		return false;
+	if (memcpy_s(key, key_size, mod_name, name_len) != 0) {
+		LOG(LOG_ERROR, "Memcpy() failed!\n");
+		goto err;
 	}
-
-	sv_kv_t.key[strlen_name] = ':';
-
-	if (strcpy_s(sv_kv_t.key + strlen_name + 1,
-		     sv_kv_t_key_size - (strlen_name + 1), sv_kv->key) != 0) {
-		LOG(LOG_ERROR, "strcpy() failed!\n");
-		return false;
+	key[name_len] = ':';
+	if (memcpy_s(key + name_len + 1, key_size - (name_len + 1),
+		     kv->key.data, kv->key.len) != 0) {
+		LOG(LOG_ERROR, "Memcpy() failed!\n");
+		goto err;
+	}
+	if (kv->value.len && memcpy_s(value, kv->value.len + 1,
+				      kv->value.data, kv->value.len) != 0) {
+		LOG(LOG_ERROR, "Memcpy() failed!\n");
+		goto err;
 	}
 
-	sv_kv->key = sv_kv_t.key;
+	sv_kv->key = key;
+	sv_kv->value = value;
+	return true;
 
-	int sv_kv_t_val_size = strnlen_s(sv_kv->value, SDO_MAX_STR_SIZE);
+err:
+	if (key)
+		sdo_free(key);
+	if (value)
+		sdo_free(value);
+	return false;
+}
 
-	if (sv_kv_t_val_size == SDO_MAX_STR_SIZE) {
-		LOG(LOG_ERROR, "strlen() failed!\n");
-		return false;
-	}
+/**
+ * Create Key_value Pair using mod_name sv_kv key-value pair
+ * @param mod_name - Pointer to the char, to be used as a partial key
+ * @param sv_kv - Pointer of type sdo_sdk_si_key_value, which holds message &
+ * value.
+ * @return true if success else false.
+ */
 
-	sv_kv_t.value =
-	    sdo_alloc(sv_kv_t_val_size + 1); // 1 is for NULL at the end
+bool sdo_mod_data_kv(char *mod_name, sdo_sdk_si_key_value *sv_kv)
+{
+	// Example : "keypair:pubkey":"sample o/p of pubkey"
+	sdo_sdk_si_kv_view kv;
 
-	if (!sv_kv_t.value) {
-		LOG(LOG_ERROR, "Malloc Failed!\n");
+	if (!mod_name || !sv_kv || !sv_kv->key || !sv_kv->value)
 		return false;
-	}
 
-	if (strcpy_s(sv_kv_t.value, sv_kv_t_val_size + 1, sv_kv->value) != 0) {
-		LOG(LOG_ERROR, "strcpy() failed!\n");
-		return false;
-	}
+	kv.key.data = (uint8_t *)sv_kv->key;
+	kv.key.len = strnlen_s(sv_kv->key, SDO_MAX_STR_SIZE);
+	kv.value.data = (uint8_t *)sv_kv->value;
+	kv.value.len = strnlen_s(sv_kv->value, SDO_MAX_STR_SIZE);
 
-	sv_kv->value = sv_kv_t.value;
-	return true;
+	return sdo_mod_data_kv_view(mod_name, &kv, sv_kv);
 }
 
 /**
@@ -4914,6 +5292,7 @@ bool sdo_mod_data_kv(char *mod_name, sdo_sdk_si_key_value *sv_kv)
 bool sdo_construct_module_dsi(sdo_sv_info_dsi_info_t *dsi_info,
 			      sdo_sdk_si_key_value *sv_kv, int *cb_return_val)
 {
+	sdo_sdk_si_kv_view kv = {{NULL, 0}, {NULL, 0}};
 	int temp_dsi_count;
 
 	if (!cb_return_val || !dsi_info)
@@ -4929,17 +5308,17 @@ bool sdo_construct_module_dsi(sdo_sv_info_dsi_info_t *dsi_info,
 	/* Finish DSI module-by-module */
 	if (dsi_info->module_dsi_index < temp_dsi_count) {
 		// check if module CB is successful
-		*cb_return_val =
-		    dsi_info->list_dsi->module.service_info_callback(
-			SDO_SI_GET_DSI, &(dsi_info->module_dsi_index), sv_kv);
+		*cb_return_val = sdo_mod_callback(
+		    &dsi_info->list_dsi->module, SDO_SI_GET_DSI,
+		    &(dsi_info->module_dsi_index), &kv);
 		if (*cb_return_val != SDO_SI_SUCCESS) {
 			LOG(LOG_ERROR, "Sv_info: %s's DSI CB Failed!\n",
 			    dsi_info->list_dsi->module.module_name);
 			return false;
 		}
 
-		if (!sdo_mod_data_kv(dsi_info->list_dsi->module.module_name,
-				     sv_kv)) {
+		if (!sdo_mod_data_kv_view(
+			dsi_info->list_dsi->module.module_name, &kv, sv_kv)) {
 			*cb_return_val = SDO_SI_INTERNAL_ERROR;
 			return false;
 		}
@@ -4998,7 +5377,7 @@ void sdo_sv_key_value_free(sdo_sdk_si_key_value *sv_kv)
 
 /**
  * Read a Sv_info (OSI) Key/Value pair from the input buffer
- * The Key and value both  MUST be a null terminated string.
+ * The key is "module name:module message".
  * @param module_list - Global Module List Head Pointer.
  * @param sv - pointer to the Sv_info key/value pair
  * @param cb_return_val - Pointer of type int which will be filled with CB
@@ -5006,65 +5385,52 @@ void sdo_sv_key_value_free(sdo_sdk_si_key_value *sv_kv)
  * @return true if read succeeded, false otherwise
  */
 bool sdo_osi_handling(sdo_sdk_service_info_module_list_t *module_list,
-		      sdo_sdk_si_key_value *sv, int *cb_return_val)
+		      sdo_sdk_si_kv_view *sv, int *cb_return_val)
 {
-	char mod_name[SDO_MODULE_NAME_LEN + 1];
-	char mod_msg[SDO_MODULE_MSG_LEN + 1];
+	sdo_sdk_service_info_module_list_t *module;
+	sdo_sdk_si_kv_view mod_kv;
+	uint8_t *colon;
+	size_t name_len;
 
 	if (!cb_return_val)
 		return false;
 
-	if (!sv || !sv->key) {
-		*cb_return_val = SDO_SI_INTERNAL_ERROR;
-		return false;
-	}
-
-	int osi_key_len = strnlen_s(sv->key, SDO_MODULE_NAME_LEN);
-
-	if (!osi_key_len || osi_key_len > SDO_MODULE_NAME_LEN) {
-		LOG(LOG_ERROR,
-		    "OSI key is either NULL or isin't NULL terminated!\n");
+	if (!sv || !sv->key.data) {
 		*cb_return_val = SDO_SI_INTERNAL_ERROR;
 		return false;
 	}
 
 	// get module name and message name from sv->key
 	// modulename and message name are separated using :
-	char *osi_key = sv->key;
-	int i = 0;
-
-	while (':' != osi_key[i]) {
-		if (i >= osi_key_len) {
-			*cb_return_val = MESSAGE_BODY_ERROR;
-			return false;
-		}
-
-		mod_name[i] = osi_key[i];
-		++i;
-	}
-
-	mod_name[i] = 0;
-
-	// consume one char for ':'
-	++i;
-
-	int j = 0;
-
-	while (i <= osi_key_len) {
-		mod_msg[j++] = osi_key[i++];
+	colon = memchr(sv->key.data, ':', sv->key.len);
+	if (!colon) {
+		*cb_return_val = MESSAGE_BODY_ERROR;
+		return false;
 	}
-	mod_msg[j] = 0;
 
-	if (strcpy_s(sv->key, strnlen_s(mod_msg, SDO_MODULE_MSG_LEN) + 1,
-		     mod_msg) != 0) {
-		LOG(LOG_ERROR, "Strcpy failed!\n");
+	name_len = colon - sv->key.data;
+	if (!name_len || name_len > SDO_MODULE_NAME_LEN) {
+		LOG(LOG_ERROR, "OSI module name is empty or too long!\n");
 		*cb_return_val = SDO_SI_INTERNAL_ERROR;
 		return false;
 	}
 
-	if (!sdo_supply_moduleOSI(module_list, mod_name, sv, cb_return_val))
+	module = sdo_sv_info_find_module(module_list, (char *)sv->key.data,
+					 name_len);
+
+	// no OSI message goes out once an earlier one has failed
+	if (!sdo_osi_async_settle(module_list, module, cb_return_val))
 		return false;
 
+	if (module) {
+		mod_kv.key.data = colon + 1;
+		mod_kv.key.len = sv->key.len - name_len - 1;
+		mod_kv.value = sv->value;
+
+		if (!sdo_module_osi(module, &mod_kv, cb_return_val))
+			return false;
+	}
+
 	*cb_return_val = SDO_SI_SUCCESS;
 	return true;
 }
@@ -5252,16 +5618,18 @@ end:
 void sdo_service_info_print(sdo_service_info_t *si)
 {
 	sdo_key_value_t *kv;
+	int i;
 #define KVBUF_SIZE 32
 	char kbuf[KVBUF_SIZE];
 	char vbuf[KVBUF_SIZE];
 
 	LOG(LOG_DEBUG, "{#SDOService_info numKV: %u\n", si->numKV);
-	for (kv = si->kv; kv; kv = kv->next) {
+	for (i = 0; i < si->numKV; i++) {
+		kv = si->kv[i];
 		LOG(LOG_DEBUG, "    \"%s\":\"%s\"%s\n",
 		    sdo_string_to_string(kv->key, kbuf, KVBUF_SIZE),
 		    sdo_string_to_string(kv->val, vbuf, KVBUF_SIZE),
-		    kv->next ? "," : "");
+		    i + 1 < si->numKV ? "," : "");
 	}
 	LOG(LOG_DEBUG, "}\n");
 }
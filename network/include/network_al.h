@@ -118,10 +118,80 @@ int32_t sdo_con_send_message(sdo_con_handle handle, uint32_t protocol_version,
  */
 int32_t sdo_con_teardown(void);
 
+/*
+ * Wait until a descriptor is ready or a timeout expires.
+ *
+ * @param[in] fd: descriptor to watch, -1 to only wait for the timeout.
+ * @param[in] events: SDO_WAIT_READ and/or SDO_WAIT_WRITE.
+ * @param[in] timeout_ms: longest wait in milliseconds, -1 for no limit.
+ * @retval 1 if fd is ready, 0 on timeout, -1 on failure.
+ */
+int32_t sdo_con_wait(int fd, uint32_t events, int32_t timeout_ms);
+
+#if defined(TARGET_OS_LINUX)
+/*
+ * Non-blocking connections, used by the step-driven API (sdo_sdk_step()).
+ * Platforms without them run their connections blocking within a step.
+ */
+#define SDO_CON_NONBLOCKING
+
+/*
+ * Start connecting to IP address and port without blocking.
+ *
+ * @retval connection handle on success, SDO_CON_INVALID_HANDLE on failure.
+ */
+sdo_con_handle sdo_con_connect_start(sdo_ip_address_t *addr, uint16_t port);
+
+/*
+ * Check on a connection started by sdo_con_connect_start().
+ *
+ * @retval 0 if connected, 1 if still in progress, -1 if the connect failed.
+ */
+int32_t sdo_con_connect_done(sdo_con_handle handle);
+
+/* Descriptor of a connection to wait on, -1 if there is none */
+int sdo_con_get_fd(sdo_con_handle handle);
+
+/*
+ * Construct the REST header of an outgoing message.
+ *
+ * @retval length of the header on success, 0 on failure.
+ */
+size_t sdo_con_msg_header(uint32_t protocol_version, uint32_t message_type,
+			  size_t length, char *hdr, size_t size);
+
+/*
+ * Parse a received REST header, ending with its empty line.
+ *
+ * @retval -1 on failure, 0 on success.
+ */
+int32_t sdo_con_parse_msg_header(const char *raw, uint32_t *protocol_version,
+				 uint32_t *message_type, uint32_t *msglen);
+
+/*
+ * Send/receive what the socket takes/holds without blocking.
+ *
+ * @retval number of bytes transferred, 0 if the socket is not ready, -1 on
+ * failure (or, when receiving, if the peer closed the connection).
+ */
+int32_t sdo_con_send_some(sdo_con_handle handle, const uint8_t *buf,
+			  size_t length);
+int32_t sdo_con_recv_some(sdo_con_handle handle, uint8_t *buf, size_t length);
+#endif
+
 /* put SDO device in Low power mode */
 // FIXME: we might have to find a suitable place for this API
 void sdo_sleep(int sec);
 
+/* put SDO device in Low power mode for msec milliseconds */
+void sdo_msleep(uint32_t msec);
+
+/* get a monotonic time stamp in milliseconds */
+uint64_t sdo_get_time_ms(void);
+
+/* get a monotonic time stamp in microseconds */
+uint64_t sdo_get_time_us(void);
+
 /* Convert from Network to Host byte order */
 uint32_t sdo_net_to_host_long(uint32_t value);
 
@@ -17,6 +17,10 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <netdb.h> //hostent
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
 #include <arpa/inet.h>
 
 #include "util.h"
@@ -24,6 +28,7 @@
 #include "sdoCryptoHal.h"
 #include "sdoprotctx.h"
 #include "sdonet.h"
+#include "sdostats.h"
 #include "safe_lib.h"
 #include "snprintf_s.h"
 #include "rest_interface.h"
@@ -43,7 +48,7 @@ struct sdo_sock_handle {
 static bool read_until_new_line(sdo_con_handle handle, char *out, size_t size,
 				void *ssl)
 {
-	size_t sz, n;
+	size_t sz, n, got = 0;
 	char c;
 	struct sdo_sock_handle *sock_hdl = handle;
 	int sockfd = sock_hdl->sockfd;
@@ -65,14 +70,17 @@ static bool read_until_new_line(sdo_con_handle handle, char *out, size_t size,
 			    "Socket Read Failed, ret=%zu, "
 			    "errno=%d, %d\n",
 			    n, errno, __LINE__);
+			sdo_stats_bytes_received(got);
 			return false;
 		}
+		got++;
 		if (sz < size)
 			out[sz++] = c;
 
 		if (c == '\n')
 			break;
 	}
+	sdo_stats_bytes_received(got);
 	out[sz] = 0;
 	/* remove \n and \r and don't process invalid string */
 	if ((sz < size) && (sz >= 1)) {
@@ -277,6 +285,7 @@ sdo_con_handle sdo_con_connect(sdo_ip_address_t *ip_addr, uint16_t port,
 				       "failed\n");
 			goto end;
 		}
+		sdo_stats_connect(true);
 		return MBEDTLS_NET_DUMMY_SOCKET;
 	}
 #endif
@@ -305,9 +314,11 @@ sdo_con_handle sdo_con_connect(sdo_ip_address_t *ip_addr, uint16_t port,
 	}
 #endif
 
+	sdo_stats_connect(true);
 	return sock_hdl;
 
 end:
+	sdo_stats_connect(false);
 	if (sock_hdl) {
 		close(sock_hdl->sockfd);
 		sdo_free(sock_hdl);
@@ -350,6 +361,39 @@ int32_t sdo_con_disconnect(sdo_con_handle handle, void *ssl)
 	return ret;
 }
 
+/**
+ * Process an accumulated REST header: one line per '\n', without CR/LF.
+ *
+ * @param hdr - header lines.
+ * @param protocol_version - out SDO protocol version
+ * @param message_type - out message type of incoming SDO message.
+ * @param msglen - out length of the body that follows.
+ * @retval -1 on failure, 0 on success.
+ */
+static int32_t process_msg_header(char *hdr, uint32_t *protocol_version,
+				  uint32_t *message_type, uint32_t *msglen)
+{
+	size_t hdrlen = strnlen_s(hdr, REST_MAX_MSGHDR_SIZE);
+	rest_ctx_t *rest = NULL;
+
+	/* Process REST header and get content-length of body */
+	if (!get_rest_content_length(hdr, hdrlen, msglen)) {
+		LOG(LOG_ERROR, "REST Header processing failed!!\n");
+		return -1;
+	}
+
+	rest = get_rest_context();
+	if (!rest) {
+		LOG(LOG_ERROR, "REST context is NULL!\n");
+		return -1;
+	}
+
+	// copy protver from REST context
+	*protocol_version = rest->prot_ver;
+	*message_type = rest->msg_type;
+	return 0;
+}
+
 /**
  * Receive(read) protocol version, message type and length of rest body
  *
@@ -368,8 +412,6 @@ int32_t sdo_con_recv_msg_header(sdo_con_handle handle,
 	int32_t ret = -1;
 	char hdr[REST_MAX_MSGHDR_SIZE] = {0};
 	char tmp[REST_MAX_MSGHDR_SIZE];
-	size_t hdrlen;
-	rest_ctx_t *rest = NULL;
 
 	if (!protocol_version || !message_type || !msglen)
 		goto err;
@@ -405,25 +447,7 @@ int32_t sdo_con_recv_msg_header(sdo_con_handle handle,
 		}
 	}
 
-	hdrlen = strnlen_s(hdr, REST_MAX_MSGHDR_SIZE);
-
-	/* Process REST header and get content-length of body */
-	if (!get_rest_content_length(hdr, hdrlen, msglen)) {
-		LOG(LOG_ERROR, "REST Header processing failed!!\n");
-		goto err;
-	}
-
-	rest = get_rest_context();
-	if (!rest) {
-		LOG(LOG_ERROR, "REST context is NULL!\n");
-		goto err;
-	}
-
-	// copy protver from REST context
-	*protocol_version = rest->prot_ver;
-	*message_type = rest->msg_type;
-
-	ret = 0;
+	ret = process_msg_header(hdr, protocol_version, message_type, msglen);
 
 err:
 	return ret;
@@ -460,11 +484,52 @@ int32_t sdo_con_recv_msg_body(sdo_con_handle handle, uint8_t *buf,
 		ret = -1;
 		goto err;
 	}
+	sdo_stats_bytes_received((size_t)n);
 	ret = n;
 err:
 	return ret;
 }
 
+/**
+ * Construct the REST header of an outgoing message.
+ *
+ * @param protocol_version - SDO protocol version
+ * @param message_type - message type of outgoing SDO message.
+ * @param length - length of the body that follows the header.
+ * @param hdr - out header, NUL terminated.
+ * @param size - size of hdr.
+ * @retval length of the header on success, 0 on failure.
+ */
+size_t sdo_con_msg_header(uint32_t protocol_version, uint32_t message_type,
+			  size_t length, char *hdr, size_t size)
+{
+	rest_ctx_t *rest = get_rest_context();
+	size_t header_len;
+
+	if (!rest) {
+		LOG(LOG_ERROR, "REST context is NULL!\n");
+		return 0;
+	}
+
+	// supply info to REST for POST-URL construction
+	rest->prot_ver = protocol_version;
+	rest->msg_type = message_type;
+	rest->content_length = length;
+
+	if (!construct_rest_header(rest, hdr, size)) {
+		LOG(LOG_ERROR, "Error during constrcution of REST hdr!\n");
+		return 0;
+	}
+
+	header_len = strnlen_s(hdr, size);
+
+	if (!header_len || header_len == size) {
+		LOG(LOG_ERROR, "Strlen() failed!\n");
+		return 0;
+	}
+	return header_len;
+}
+
 /**
  * Send(write) data.
  *
@@ -482,7 +547,6 @@ int32_t sdo_con_send_message(sdo_con_handle handle, uint32_t protocol_version,
 {
 	int ret = -1;
 	int n;
-	rest_ctx_t *rest = NULL;
 	char rest_hdr[REST_MAX_MSGHDR_SIZE] = {0};
 	size_t header_len = 0;
 	int sockfd = 0;
@@ -493,29 +557,10 @@ int32_t sdo_con_send_message(sdo_con_handle handle, uint32_t protocol_version,
 
 	sockfd = sock_hdl->sockfd;
 
-	rest = get_rest_context();
-
-	if (!rest) {
-		LOG(LOG_ERROR, "REST context is NULL!\n");
+	header_len = sdo_con_msg_header(protocol_version, message_type, length,
+					rest_hdr, sizeof(rest_hdr));
+	if (!header_len)
 		goto err;
-	}
-
-	// supply info to REST for POST-URL construction
-	rest->prot_ver = protocol_version;
-	rest->msg_type = message_type;
-	rest->content_length = length;
-
-	if (!construct_rest_header(rest, rest_hdr, REST_MAX_MSGHDR_SIZE)) {
-		LOG(LOG_ERROR, "Error during constrcution of REST hdr!\n");
-		goto err;
-	}
-
-	header_len = strnlen_s(rest_hdr, REST_MAX_MSGHDR_SIZE);
-
-	if (!header_len || header_len == REST_MAX_MSGHDR_SIZE) {
-		LOG(LOG_ERROR, "Strlen() failed!\n");
-		goto err;
-	}
 
 	/* Send REST header */
 	if (ssl) {
@@ -588,6 +633,7 @@ int32_t sdo_con_send_message(sdo_con_handle handle, uint32_t protocol_version,
 			    length);
 	}
 
+	sdo_stats_bytes_sent(header_len + length);
 	return n;
 
 hdrerr:
@@ -599,6 +645,244 @@ err:
 	return ret;
 }
 
+/**
+ * Start connecting a non-blocking socket. The connection is complete once
+ * sdo_con_connect_done() says so; wait for SDO_WAIT_WRITE on the descriptor
+ * of the handle in between.
+ *
+ * @param ip_addr - pointer to IP address info
+ * @param port - port number to connect to
+ * @return connection handle on success, SDO_CON_INVALID_HANDLE on failure
+ */
+sdo_con_handle sdo_con_connect_start(sdo_ip_address_t *ip_addr, uint16_t port)
+{
+	struct sdo_sock_handle *sock_hdl = SDO_CON_INVALID_HANDLE;
+	struct sockaddr_in haddr;
+	int flags;
+
+	if (!ip_addr)
+		return SDO_CON_INVALID_HANDLE;
+
+	if (memset_s(&haddr, sizeof(haddr), 0) != 0) {
+		LOG(LOG_ERROR, "Memset failed\n");
+		return SDO_CON_INVALID_HANDLE;
+	}
+
+	if (memcpy_s(&haddr.sin_addr.s_addr, ip_addr->length, &ip_addr->addr[0],
+		     ip_addr->length) != 0) {
+		LOG(LOG_ERROR, "Memcpy failed\n");
+		return SDO_CON_INVALID_HANDLE;
+	}
+	haddr.sin_family = AF_INET; // IPV4
+	haddr.sin_port = htons(port);
+
+	sock_hdl = (struct sdo_sock_handle *)sdo_alloc(sizeof(*sock_hdl));
+	if (!sock_hdl) {
+		LOG(LOG_ERROR, "Out of memory for sock handle\n");
+		return SDO_CON_INVALID_HANDLE;
+	}
+
+	sock_hdl->sockfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (sock_hdl->sockfd < 0)
+		goto err;
+
+	flags = fcntl(sock_hdl->sockfd, F_GETFL, 0);
+	if (flags < 0 ||
+	    fcntl(sock_hdl->sockfd, F_SETFL, flags | O_NONBLOCK) < 0)
+		goto err;
+
+	if (connect(sock_hdl->sockfd, (struct sockaddr *)&haddr,
+		    sizeof(haddr)) < 0 &&
+	    errno != EINPROGRESS) {
+		LOG(LOG_ERROR, "Socket Connect failed, errno=%d\n", errno);
+		goto err;
+	}
+	return sock_hdl;
+
+err:
+	sdo_stats_connect(false);
+	if (sock_hdl->sockfd >= 0)
+		close(sock_hdl->sockfd);
+	sdo_free(sock_hdl);
+	return SDO_CON_INVALID_HANDLE;
+}
+
+/**
+ * Check whether a connection started by sdo_con_connect_start() is up.
+ *
+ * @param handle - connection handle
+ * @retval 0 if connected, 1 if still in progress, -1 if the connect failed.
+ */
+int32_t sdo_con_connect_done(sdo_con_handle handle)
+{
+	struct sdo_sock_handle *sock_hdl = handle;
+	struct pollfd pfd;
+	socklen_t len = sizeof(int);
+	int err = 0;
+
+	if (!sock_hdl)
+		return -1;
+
+	pfd.fd = sock_hdl->sockfd;
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+	if (poll(&pfd, 1, 0) < 0)
+		return errno == EINTR ? 1 : -1;
+	if (!pfd.revents)
+		return 1;
+
+	if (getsockopt(sock_hdl->sockfd, SOL_SOCKET, SO_ERROR, &err, &len) <
+		0 ||
+	    err) {
+		LOG(LOG_ERROR, "Socket Connect failed, error=%d\n", err);
+		sdo_stats_connect(false);
+		return -1;
+	}
+	sdo_stats_connect(true);
+	return 0;
+}
+
+/**
+ * Return the descriptor to wait on for a connection.
+ *
+ * @param handle - connection handle
+ * @retval socket descriptor, -1 if there is none.
+ */
+int sdo_con_get_fd(sdo_con_handle handle)
+{
+	struct sdo_sock_handle *sock_hdl = handle;
+
+	return sock_hdl ? sock_hdl->sockfd : -1;
+}
+
+/**
+ * Send as much of buf as the socket takes without blocking.
+ *
+ * @param handle - connection handle of a non-blocking socket
+ * @param buf - data to send
+ * @param length - number of bytes in buf
+ * @retval number of bytes sent, 0 if the socket is full, -1 on failure.
+ */
+int32_t sdo_con_send_some(sdo_con_handle handle, const uint8_t *buf,
+			  size_t length)
+{
+	struct sdo_sock_handle *sock_hdl = handle;
+	ssize_t n;
+
+	if (!sock_hdl || !buf)
+		return -1;
+
+	n = send(sock_hdl->sockfd, buf, length, MSG_NOSIGNAL);
+	if (n < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return 0;
+		LOG(LOG_ERROR, "Socket write Failed, errno=%d\n", errno);
+		return -1;
+	}
+	sdo_stats_bytes_sent((size_t)n);
+	return (int32_t)n;
+}
+
+/**
+ * Receive what the socket holds, up to length bytes, without blocking.
+ *
+ * @param handle - connection handle of a non-blocking socket
+ * @param buf - buffer to read into
+ * @param length - size of buf
+ * @retval number of bytes read, 0 if nothing is pending, -1 on failure or
+ * when the peer closed the connection.
+ */
+int32_t sdo_con_recv_some(sdo_con_handle handle, uint8_t *buf, size_t length)
+{
+	struct sdo_sock_handle *sock_hdl = handle;
+	ssize_t n;
+
+	if (!sock_hdl || !buf || !length)
+		return -1;
+
+	n = recv(sock_hdl->sockfd, buf, length, 0);
+	if (n < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return 0;
+		LOG(LOG_ERROR, "Socket Read Failed, errno=%d\n", errno);
+		return -1;
+	}
+	if (n == 0) {
+		LOG(LOG_ERROR, "Connection closed by peer\n");
+		return -1;
+	}
+	sdo_stats_bytes_received((size_t)n);
+	return (int32_t)n;
+}
+
+/**
+ * Parse a REST header received in one piece, as read by
+ * sdo_con_recv_some(), up to and including the empty line that ends it.
+ *
+ * @param raw - received header, NUL terminated.
+ * @param protocol_version - out SDO protocol version
+ * @param message_type - out message type of incoming SDO message.
+ * @param msglen - out length of the body that follows.
+ * @retval -1 on failure, 0 on success.
+ */
+int32_t sdo_con_parse_msg_header(const char *raw, uint32_t *protocol_version,
+				 uint32_t *message_type, uint32_t *msglen)
+{
+	char hdr[REST_MAX_MSGHDR_SIZE] = {0};
+	size_t len = 0, line = 0;
+
+	if (!raw || !protocol_version || !message_type || !msglen)
+		return -1;
+
+	/* Same layout as sdo_con_recv_msg_header() accumulates */
+	for (; *raw; raw++) {
+		if (*raw == '\r')
+			continue;
+		if (*raw == '\n' && !line)
+			return process_msg_header(hdr, protocol_version,
+						  message_type, msglen);
+		if (len + 1 >= sizeof(hdr)) {
+			LOG(LOG_ERROR, "REST header too long!\n");
+			return -1;
+		}
+		hdr[len++] = *raw;
+		line = *raw == '\n' ? 0 : line + 1;
+	}
+
+	LOG(LOG_ERROR, "REST header incomplete!\n");
+	return -1;
+}
+
+/**
+ * Wait until a descriptor is ready or a timeout expires.
+ *
+ * @param fd - descriptor to watch, -1 to only wait for the timeout
+ * @param events - SDO_WAIT_READ and/or SDO_WAIT_WRITE
+ * @param timeout_ms - longest wait in milliseconds, -1 for no limit
+ * @retval 1 if fd is ready, 0 on timeout, -1 on failure.
+ */
+int32_t sdo_con_wait(int fd, uint32_t events, int32_t timeout_ms)
+{
+	struct pollfd pfd;
+	int n;
+
+	if (fd < 0) {
+		if (timeout_ms < 0)
+			return -1;
+		sdo_msleep((uint32_t)timeout_ms);
+		return 0;
+	}
+
+	pfd.fd = fd;
+	pfd.events = (short)(((events & SDO_WAIT_READ) ? POLLIN : 0) |
+			     ((events & SDO_WAIT_WRITE) ? POLLOUT : 0));
+	pfd.revents = 0;
+	n = poll(&pfd, 1, timeout_ms);
+	if (n < 0)
+		return errno == EINTR ? 0 : -1;
+	return n ? 1 : 0;
+}
+
 /**
  * sdo_con_tear_down connection tear-down.
  *
@@ -624,6 +908,54 @@ void sdo_sleep(int sec)
 	sleep(sec);
 }
 
+/**
+ * Put the SDO device to low power state
+ *
+ * @param msec
+ *        number of milliseconds to put the device to low power state
+ *
+ * @return none
+ */
+void sdo_msleep(uint32_t msec)
+{
+	struct timespec ts;
+
+	ts.tv_sec = msec / 1000;
+	ts.tv_nsec = (long)(msec % 1000) * 1000000L;
+	while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+		;
+}
+
+/**
+ * Get a monotonic time stamp
+ *
+ * @return
+ *        milliseconds elapsed since an unspecified starting point.
+ */
+uint64_t sdo_get_time_ms(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		return 0;
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/**
+ * Get a monotonic time stamp, on the same clock as sdo_get_time_ms()
+ *
+ * @return
+ *        microseconds elapsed since an unspecified starting point.
+ */
+uint64_t sdo_get_time_us(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		return 0;
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
 /**
  * Convert from Network to Host byte order
  *
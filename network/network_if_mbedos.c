@@ -20,6 +20,7 @@
 #include "def.h"
 #include "mbed_wait_api.h"
 #include "platform/mbed_thread.h"
+#include "hal/us_ticker_api.h"
 #include <lwip/ip4_addr.h>
 #include <lwip/sockets.h>
 
@@ -456,6 +457,25 @@ err:
 	return ret;
 }
 
+/**
+ * Wait until a descriptor is ready or a timeout expires. Connections here
+ * have no descriptor to wait on, so only the timeout is honoured.
+ *
+ * @param fd - descriptor to watch, always -1 on this platform
+ * @param events - SDO_WAIT_READ and/or SDO_WAIT_WRITE
+ * @param timeout_ms - longest wait in milliseconds, -1 for no limit
+ * @retval 0 on timeout, -1 on failure.
+ */
+int32_t sdo_con_wait(int fd, uint32_t events, int32_t timeout_ms)
+{
+	(void)fd;
+	(void)events;
+	if (timeout_ms < 0)
+		return -1;
+	thread_sleep_for(timeout_ms);
+	return 0;
+}
+
 /**
  * sdo_con_tear_down connection tear-down.
  *
@@ -481,6 +501,41 @@ void sdo_sleep(int sec)
 	thread_sleep_for(sec * 1000);
 }
 
+/**
+ * Put the SDO device to low power state
+ *
+ * @param msec
+ *        number of milliseconds to put the device to low power state
+ *
+ * @return none
+ */
+void sdo_msleep(uint32_t msec)
+{
+	thread_sleep_for(msec);
+}
+
+/**
+ * Get a monotonic time stamp
+ *
+ * @return
+ *        milliseconds elapsed since an unspecified starting point.
+ */
+uint64_t sdo_get_time_ms(void)
+{
+	return ticker_read_us(get_us_ticker_data()) / 1000;
+}
+
+/**
+ * Get a monotonic time stamp, on the same clock as sdo_get_time_ms()
+ *
+ * @return
+ *        microseconds elapsed since an unspecified starting point.
+ */
+uint64_t sdo_get_time_us(void)
+{
+	return ticker_read_us(get_us_ticker_data());
+}
+
 /**
  * Convert from Network to Host byte order
  *
@@ -18,13 +18,11 @@
 #include "safe_lib.h"
 #include "snprintf_s.h"
 #include "rest_interface.h"
+#include "sdoctx.h"
 
-// Global REST context is allocated ?
+// REST context is allocated ?
 #define isRESTContext_active() ((rest) ? true : false)
 
-// Global REST context
-static rest_ctx_t *rest;
-
 /**
  * Initialize REST context.
  *
@@ -32,11 +30,14 @@ static rest_ctx_t *rest;
  */
 bool init_rest_context(void)
 {
-	if (rest) {
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+
+	if (ctx->rest) {
 		LOG(LOG_ERROR, "rest context is already active\n");
 		return false;
 	} else {
-		return (rest = sdo_alloc(sizeof(rest_ctx_t))) ? true : false;
+		ctx->rest = sdo_alloc(sizeof(rest_ctx_t));
+		return ctx->rest ? true : false;
 	}
 }
 
@@ -49,7 +50,8 @@ bool init_rest_context(void)
  */
 rest_ctx_t *get_rest_context(void)
 {
-	return rest;
+	/* one per SDK context */
+	return sdo_ctx_current()->rest;
 }
 
 /**
@@ -61,6 +63,7 @@ rest_ctx_t *get_rest_context(void)
  */
 bool cache_host_dns(const char *dns)
 {
+	rest_ctx_t *rest = get_rest_context();
 	bool ret = false;
 
 	if (!dns)
@@ -104,6 +107,7 @@ err:
  */
 bool cache_host_ip(sdo_ip_address_t *ip)
 {
+	rest_ctx_t *rest = get_rest_context();
 	bool ret = false;
 
 	if (!ip)
@@ -141,6 +145,7 @@ err:
  */
 bool cache_host_port(uint16_t port)
 {
+	rest_ctx_t *rest = get_rest_context();
 	bool ret = false;
 
 	if (!isRESTContext_active()) {
@@ -162,6 +167,7 @@ err:
  */
 bool cache_tls_connection(void)
 {
+	rest_ctx_t *rest = get_rest_context();
 	bool ret = false;
 
 	if (!isRESTContext_active()) {
@@ -396,6 +402,7 @@ err:
  */
 bool get_rest_content_length(char *hdr, size_t hdrlen, uint32_t *cont_len)
 {
+	rest_ctx_t *rest = get_rest_context();
 	bool ret = false;
 	char *rem, *p1, *p2;
 	size_t remlen;
@@ -577,6 +584,9 @@ char get_rest_hdr_body_separator(void)
  */
 void exit_rest_context(void)
 {
+	sdo_sdk_ctx *ctx = sdo_ctx_current();
+	rest_ctx_t *rest = ctx->rest;
+
 	if (rest) {
 		if (rest->authorization)
 			sdo_free(rest->authorization);
@@ -587,5 +597,6 @@ void exit_rest_context(void)
 		if (rest->host_dns)
 			sdo_free(rest->host_dns);
 		sdo_free(rest);
+		ctx->rest = NULL;
 	}
 }
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*
+ * Credential Store declaration
+ *
+ * Single-file, memory-mapped and journaled store for the device credential
+ * blobs, used by the Linux storage layer when CRED_STORE_ENABLED is set.
+ */
+
+#ifndef __CRED_STORE_H__
+#define __CRED_STORE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+#include "util.h"
+
+#define CRED_STORE_MAX_RECORDS 8
+
+typedef struct {
+	const char *name; /* not NUL terminated when it points into the map */
+	size_t name_len;
+	const uint8_t *data;
+	uint32_t data_len;
+} cred_record_t;
+
+/* Mapping and record index of the store of one SDK context */
+typedef struct {
+	bool loaded;
+	char path[SDO_MAX_STR_SIZE]; /* store file, see sdo_blob_path() */
+	uint8_t *map;
+	size_t map_len;
+	size_t valid_len; /* end of the last intact frame */
+	size_t live_len;  /* bytes needed to store the current records */
+	uint32_t seq;
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime;
+	cred_record_t rec[CRED_STORE_MAX_RECORDS];
+	size_t nrec;
+	/* records staged by cred_store_write() between begin and end */
+	bool batch;
+	cred_record_t staged[CRED_STORE_MAX_RECORDS];
+	size_t nstaged;
+} cred_store_t;
+
+bool cred_store_owns(const char *name);
+bool cred_store_exists(const char *name);
+int32_t cred_store_size(const char *name);
+int32_t cred_store_read(const char *name, uint8_t *buf, size_t len);
+int32_t cred_store_write(const char *name, const uint8_t *buf, size_t len);
+int32_t cred_store_begin(void);
+int32_t cred_store_end(bool commit);
+void cred_store_close(cred_store_t *store);
+
+#endif /* __CRED_STORE_H__ */
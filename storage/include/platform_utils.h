@@ -14,6 +14,14 @@
 #define PLATFORM_AES_KEY_DEFAULT_LEN BUFF_SIZE_16_BYTES
 #define PLATFORM_HMAC_KEY_DEFAULT_LEN BUFF_SIZE_32_BYTES
 
+// IV increments reserved in the platform IV file per write
+#ifndef PLATFORM_IV_LEASE_LEN
+#define PLATFORM_IV_LEASE_LEN 256
+#endif
+
 bool get_platform_hmac_key(uint8_t *key, size_t len);
 bool get_platform_iv(uint8_t *iv, size_t len, size_t datalen);
 bool get_platform_aes_key(uint8_t *key, size_t len);
+bool platform_keyring_init(void);
+void platform_keyring_close(void);
+void platform_keyring_drop(const char *name);
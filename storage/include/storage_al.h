@@ -30,6 +30,9 @@ typedef enum {
 	SDO_SDK_OTP_DATA = 4,
 	SDO_SDK_RAW_DATA = 8
 } sdo_sdk_blob_flags;
+
+/* Blob opened for reading or writing in chunks */
+typedef struct sdo_blob_stream sdo_blob_stream_t;
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -42,6 +45,29 @@ int32_t sdo_blob_write(const char *blob_name, sdo_sdk_blob_flags flags,
 
 int32_t sdo_blob_size(const char *blob_name, sdo_sdk_blob_flags flags);
 
+sdo_blob_stream_t *sdo_blob_open_read(const char *blob_name,
+				      sdo_sdk_blob_flags flags,
+				      uint32_t *length);
+
+sdo_blob_stream_t *sdo_blob_open_write(const char *blob_name,
+				       sdo_sdk_blob_flags flags);
+
+int32_t sdo_blob_read_chunk(sdo_blob_stream_t *stream, uint8_t *buffer,
+			    uint32_t length);
+
+int32_t sdo_blob_write_chunk(sdo_blob_stream_t *stream,
+			     const uint8_t *buffer, uint32_t length);
+
+int32_t sdo_blob_close(sdo_blob_stream_t *stream);
+
+void sdo_blob_abort(sdo_blob_stream_t *stream);
+
+int32_t sdo_blob_batch_begin(void);
+
+int32_t sdo_blob_batch_end(bool commit);
+
+int sdo_blob_path(const char *blob_name, char *path, size_t path_len);
+
 int32_t create_hmac_normal_blob(void);
 
 #ifdef __cplusplus
@@ -0,0 +1,816 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*
+ * Credential Store
+ *
+ * The file implements a single-file credential store for Linux OS. The
+ * Normal, Mfg and Secure credential blobs and the TO2 checkpoint are kept as
+ * named records in SDO_CRED_STORE instead of one file each. Records hold the
+ * sealed image sdo_blob_write() would otherwise write to the blob file, so
+ * every record is still authenticated (and for secure data encrypted) on its
+ * own by storage_if_linux.c.
+ *
+ * The store is a journal:
+ *	[header: "SDOSTORE"(8) || version(4) || reserved(4)]
+ *	[frame]...
+ * and each frame is one atomic commit of one or more records:
+ *	[magic(4) || sequence(4) || record count(4) || body length(4)]
+ *	[body: {name length(2) || reserved(2) || data length(4) ||
+ *		name || data}...]
+ *	[SHA-256 of the frame header and body(32)]
+ * All integers are big endian. On load the file is mapped and scanned once;
+ * the last frame that names a record holds its current value. A frame that
+ * is cut short or does not match its hash ends the journal, so a power cut
+ * during a commit leaves the previous state in place. Once the file grows
+ * past CRED_STORE_COMPACT_LEN and is mostly dead records, the live records
+ * are rewritten into a new file that replaces the old one with rename().
+ * After a commit the mapping is extended over (or moved to) what was just
+ * written and only the new frame is indexed; the journal is not scanned
+ * again.
+ *
+ * The mapping is checked against the file on every access and reloaded if
+ * the file was replaced or removed by another process. Records that are not
+ * in the store yet are read from their legacy blob file, which is how
+ * existing devices and the plain-text Normal.blob written at provisioning
+ * are picked up.
+ *
+ * The mapping and the index belong to the SDK context of the calling
+ * thread; the store file and the legacy files are looked up in its blob
+ * directory (see sdo_blob_path()).
+ */
+
+#define _GNU_SOURCE /* mremap() */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "util.h"
+#include "safe_lib.h"
+#include "sdoCryptoHal.h"
+#include "storage_al.h"
+#include "sdoctx.h"
+#include "cred_store.h"
+
+#define CRED_STORE_MAGIC "SDOSTORE"
+#define CRED_STORE_VERSION 1
+#define CRED_STORE_HDR_LEN 16
+#define CRED_FRAME_MAGIC 0x53444f43 /* "SDOC" */
+#define CRED_FRAME_HDR_LEN 16
+#define CRED_REC_HDR_LEN 8
+#define CRED_FRAME_HASH_LEN SHA256_DIGEST_SIZE
+#define CRED_STORE_COMPACT_LEN (64 * 1024)
+
+/* Blobs kept in the store; everything else stays a plain file */
+static const char *const cred_store_names[] = {
+    SDO_CRED_NORMAL, SDO_CRED_MFG, SDO_CRED_SECURE, SDO_CRED_SNAPSHOT,
+    SDO_TO2_CHECKPOINT};
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)(v >> 24);
+	p[1] = (uint8_t)(v >> 16);
+	p[2] = (uint8_t)(v >> 8);
+	p[3] = (uint8_t)v;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+	       ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+/* Records are keyed by blob file name so the store survives a BLOB_PATH
+ * change.
+ */
+static const char *record_key(const char *name, size_t *len)
+{
+	const char *base = strrchr(name, '/');
+
+	base = base ? base + 1 : name;
+	*len = strnlen_s(base, SDO_MAX_STR_SIZE);
+	return base;
+}
+
+static cred_record_t *find_record(cred_record_t *recs, size_t n,
+				  const char *key, size_t key_len)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		if (recs[i].name_len == key_len &&
+		    memcmp(recs[i].name, key, key_len) == 0)
+			return &recs[i];
+	return NULL;
+}
+
+static void free_staged(cred_store_t *store)
+{
+	size_t i;
+
+	for (i = 0; i < store->nstaged; i++) {
+		uint8_t *data = (uint8_t *)store->staged[i].data;
+
+		if (data) {
+			(void)memset_s(data, store->staged[i].data_len, 0);
+			sdo_free(data);
+		}
+		store->staged[i].data = NULL;
+	}
+	store->nstaged = 0;
+}
+
+static void unmap_store(cred_store_t *store)
+{
+	if (store->map)
+		(void)munmap(store->map, store->map_len);
+	store->map = NULL;
+	store->map_len = 0;
+	store->valid_len = 0;
+	store->live_len = CRED_STORE_HDR_LEN;
+	store->seq = 0;
+	store->nrec = 0;
+	store->loaded = false;
+}
+
+/**
+ * Length of the frame that starts at off in the mapping, from its header.
+ *
+ * @return frame length, 0 if no complete frame starts there.
+ */
+static size_t frame_at(cred_store_t *store, size_t off)
+{
+	const uint8_t *frame = store->map + off;
+	uint32_t body_len;
+
+	if (store->map_len - off < CRED_FRAME_HDR_LEN + CRED_FRAME_HASH_LEN)
+		return 0;
+	body_len = get_u32(frame + 12);
+	if (get_u32(frame) != CRED_FRAME_MAGIC ||
+	    body_len > store->map_len - off - CRED_FRAME_HDR_LEN -
+			   CRED_FRAME_HASH_LEN)
+		return 0;
+	return CRED_FRAME_HDR_LEN + body_len + CRED_FRAME_HASH_LEN;
+}
+
+/**
+ * Apply the intact frame of len bytes at off in the mapping to the record
+ * index.
+ *
+ * @retval true on success, false if the records do not fill the frame or
+ * the store would hold more than CRED_STORE_MAX_RECORDS records.
+ */
+static bool index_frame(cred_store_t *store, size_t off, size_t len)
+{
+	const uint8_t *frame = store->map + off;
+	const uint8_t *p = frame + CRED_FRAME_HDR_LEN;
+	const uint8_t *body_end = frame + len - CRED_FRAME_HASH_LEN;
+	uint32_t nrec = get_u32(frame + 8);
+	cred_record_t recs[CRED_STORE_MAX_RECORDS];
+	cred_record_t *r;
+	uint32_t i;
+
+	if (nrec > CRED_STORE_MAX_RECORDS)
+		goto err;
+
+	for (i = 0; i < nrec; i++) {
+		if ((size_t)(body_end - p) < CRED_REC_HDR_LEN)
+			goto err;
+		recs[i].name_len = ((size_t)p[0] << 8) | p[1];
+		recs[i].data_len = get_u32(p + 4);
+		p += CRED_REC_HDR_LEN;
+		if (recs[i].name_len == 0 ||
+		    (size_t)(body_end - p) <
+			recs[i].name_len + (size_t)recs[i].data_len)
+			goto err;
+		recs[i].name = (const char *)p;
+		recs[i].data = p + recs[i].name_len;
+		p += recs[i].name_len + recs[i].data_len;
+	}
+	if (p != body_end)
+		goto err;
+
+	for (i = 0; i < nrec; i++) {
+		r = find_record(store->rec, store->nrec, recs[i].name,
+				recs[i].name_len);
+		if (!r) {
+			if (store->nrec == CRED_STORE_MAX_RECORDS)
+				goto err;
+			r = &store->rec[store->nrec++];
+		}
+		*r = recs[i];
+	}
+	store->seq = get_u32(frame + 4);
+	store->valid_len = off + len;
+	return true;
+
+err:
+	LOG(LOG_ERROR, "Bad frame at offset %zu of %s!\n", off,
+	    store->path);
+	return false;
+}
+
+/* Bytes a compacted store would take */
+static void update_live_len(cred_store_t *store)
+{
+	size_t i;
+
+	store->live_len = CRED_STORE_HDR_LEN + CRED_FRAME_HDR_LEN +
+			  CRED_FRAME_HASH_LEN;
+	for (i = 0; i < store->nrec; i++)
+		store->live_len += CRED_REC_HDR_LEN + store->rec[i].name_len +
+				   store->rec[i].data_len;
+}
+
+/**
+ * Walk the journal in the mapping and index the latest value of each
+ * record.
+ *
+ * @retval true on success, false if the header is not valid or an intact
+ * frame cannot be indexed.
+ */
+static bool scan_store(cred_store_t *store)
+{
+	uint8_t hash[CRED_FRAME_HASH_LEN];
+	size_t off = CRED_STORE_HDR_LEN, len;
+	int cmp = 1;
+
+	if (store->map_len < CRED_STORE_HDR_LEN ||
+	    memcmp(store->map, CRED_STORE_MAGIC, 8) != 0 ||
+	    get_u32(store->map + 8) != CRED_STORE_VERSION) {
+		LOG(LOG_ERROR, "%s is not a credential store!\n",
+		    store->path);
+		return false;
+	}
+
+	store->valid_len = off;
+	while ((len = frame_at(store, off)) != 0) {
+		if (crypto_hal_hash(SDO_CRYPTO_HASH_TYPE_SHA_256,
+				    store->map + off, len - CRED_FRAME_HASH_LEN,
+				    hash, sizeof(hash)) != 0)
+			break;
+		memcmp_s(hash, sizeof(hash),
+			 store->map + off + len - CRED_FRAME_HASH_LEN,
+			 sizeof(hash), &cmp);
+		if (cmp != 0)
+			break;
+
+		/* Frame is intact: apply it */
+		if (!index_frame(store, off, len))
+			return false;
+		off += len;
+	}
+
+	if (off != store->map_len)
+		LOG(LOG_DEBUG, "Ignoring %zu bytes at the end of %s\n",
+		    store->map_len - off, store->path);
+	return true;
+}
+
+/**
+ * Make sure the mapping reflects SDO_CRED_STORE, loading it on first use and
+ * reloading it when the file has been replaced or removed.
+ *
+ * @retval true on success, false if the store cannot be read.
+ */
+static bool load_store(cred_store_t *store)
+{
+	struct stat st;
+	int fd = -1;
+
+	if (sdo_blob_path(SDO_CRED_STORE, store->path, sizeof(store->path)) !=
+	    0)
+		return false;
+
+	if (stat(store->path, &st) != 0) {
+		if (errno != ENOENT) {
+			LOG(LOG_ERROR, "Could not stat %s!\n", store->path);
+			return false;
+		}
+		/* No store yet: everything comes from the legacy files */
+		unmap_store(store);
+		store->loaded = true;
+		return true;
+	}
+
+	if (store->loaded && store->map && st.st_dev == store->dev &&
+	    st.st_ino == store->ino && (size_t)st.st_size == store->map_len &&
+	    st.st_mtim.tv_sec == store->mtime.tv_sec &&
+	    st.st_mtim.tv_nsec == store->mtime.tv_nsec)
+		return true;
+
+	unmap_store(store);
+
+	fd = open(store->path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		LOG(LOG_ERROR, "Could not open %s!\n", store->path);
+		goto err;
+	}
+
+	if (st.st_size > 0) {
+		store->map = mmap(NULL, (size_t)st.st_size, PROT_READ,
+				  MAP_SHARED, fd, 0);
+		if (store->map == MAP_FAILED) {
+			store->map = NULL;
+			LOG(LOG_ERROR, "Could not map %s!\n", store->path);
+			goto err;
+		}
+		store->map_len = (size_t)st.st_size;
+	}
+	(void)close(fd);
+	fd = -1;
+
+	if (store->map_len && !scan_store(store))
+		goto err;
+
+	store->dev = st.st_dev;
+	store->ino = st.st_ino;
+	store->mtime = st.st_mtim;
+	update_live_len(store);
+	store->loaded = true;
+	return true;
+
+err:
+	if (fd >= 0)
+		(void)close(fd);
+	unmap_store(store);
+	return false;
+}
+
+/**
+ * Look a record up in the staged batch and then in the store.
+ */
+static const cred_record_t *lookup(cred_store_t *store, const char *name)
+{
+	const cred_record_t *r;
+	const char *key;
+	size_t key_len;
+
+	key = record_key(name, &key_len);
+	r = find_record(store->staged, store->nstaged, key, key_len);
+	if (r)
+		return r;
+	return find_record(store->rec, store->nrec, key, key_len);
+}
+
+/**
+ * Serialize one frame holding recs into out, which must have room for
+ * frame_len(recs, n) bytes.
+ */
+static size_t frame_len(const cred_record_t *recs, size_t n)
+{
+	size_t len = CRED_FRAME_HDR_LEN + CRED_FRAME_HASH_LEN;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		len += CRED_REC_HDR_LEN + recs[i].name_len + recs[i].data_len;
+	return len;
+}
+
+static bool build_frame(uint8_t *out, const cred_record_t *recs, size_t n,
+			uint32_t seq)
+{
+	uint8_t *p = out + CRED_FRAME_HDR_LEN;
+	size_t body_len;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		p[0] = (uint8_t)(recs[i].name_len >> 8);
+		p[1] = (uint8_t)recs[i].name_len;
+		p[2] = 0;
+		p[3] = 0;
+		put_u32(p + 4, recs[i].data_len);
+		p += CRED_REC_HDR_LEN;
+		if (memcpy_s(p, recs[i].name_len, recs[i].name,
+			     recs[i].name_len) != 0)
+			return false;
+		p += recs[i].name_len;
+		if (recs[i].data_len &&
+		    memcpy_s(p, recs[i].data_len, recs[i].data,
+			     recs[i].data_len) != 0)
+			return false;
+		p += recs[i].data_len;
+	}
+	body_len = p - out - CRED_FRAME_HDR_LEN;
+
+	put_u32(out, CRED_FRAME_MAGIC);
+	put_u32(out + 4, seq);
+	put_u32(out + 8, (uint32_t)n);
+	put_u32(out + 12, (uint32_t)body_len);
+	return crypto_hal_hash(SDO_CRYPTO_HASH_TYPE_SHA_256, out,
+			       CRED_FRAME_HDR_LEN + body_len, p,
+			       CRED_FRAME_HASH_LEN) == 0;
+}
+
+static bool write_all(int fd, const uint8_t *buf, size_t len, off_t off)
+{
+	while (len) {
+		ssize_t n = pwrite(fd, buf, len, off);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		buf += n;
+		len -= (size_t)n;
+		off += n;
+	}
+	return true;
+}
+
+/* Make a new or renamed store file durable by syncing its directory */
+static bool sync_store_dir(cred_store_t *store)
+{
+	char path[SDO_MAX_STR_SIZE];
+	int fd;
+	bool ret;
+
+	if (strcpy_s(path, sizeof(path), store->path) != 0)
+		return false;
+	fd = open(dirname(path), O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+		return false;
+	ret = (fsync(fd) == 0);
+	(void)close(fd);
+	return ret;
+}
+
+/**
+ * Take the frame of len bytes just written at off in the store file behind
+ * fd into the mapping and the record index. The mapping is extended (and
+ * maybe moved) rather than rebuilt, and the frame is not hashed again: it
+ * is the one this process built.
+ *
+ * @retval true on success, false if the store has to be loaded again.
+ */
+static bool remap_store(cred_store_t *store, int fd, size_t off, size_t len)
+{
+	struct stat st;
+	uint8_t *map;
+	size_t i;
+
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size != off + len)
+		return false;
+
+	if (store->map)
+		map = mremap(store->map, store->map_len, off + len,
+			     MREMAP_MAYMOVE);
+	else
+		map = mmap(NULL, off + len, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		return false;
+
+	/* Indexed records point into the old mapping */
+	for (i = 0; i < store->nrec; i++) {
+		store->rec[i].name =
+		    (const char *)map +
+		    ((const uint8_t *)store->rec[i].name - store->map);
+		store->rec[i].data = map + (store->rec[i].data - store->map);
+	}
+	store->map = map;
+	store->map_len = off + len;
+	if (!index_frame(store, off, len))
+		return false;
+
+	store->dev = st.st_dev;
+	store->ino = st.st_ino;
+	store->mtime = st.st_mtim;
+	update_live_len(store);
+	store->loaded = true;
+	return true;
+}
+
+/**
+ * Write the live records merged with recs into a fresh store file and
+ * atomically replace the store file with it.
+ */
+static bool rewrite_store(cred_store_t *store, const cred_record_t *recs,
+			  size_t n)
+{
+	char tmp[SDO_MAX_STR_SIZE];
+	cred_record_t all[CRED_STORE_MAX_RECORDS * 2];
+	size_t nall = 0, i, len;
+	uint8_t *image = NULL;
+	bool ret = false;
+	int fd = -1;
+
+	for (i = 0; i < store->nrec; i++)
+		if (!find_record((cred_record_t *)recs, n, store->rec[i].name,
+				 store->rec[i].name_len))
+			all[nall++] = store->rec[i];
+	for (i = 0; i < n; i++)
+		all[nall++] = recs[i];
+
+	len = CRED_STORE_HDR_LEN + frame_len(all, nall);
+	image = sdo_alloc(len);
+	if (!image) {
+		LOG(LOG_ERROR, "Malloc failed for credential store!\n");
+		return false;
+	}
+	if (memcpy_s(image, len, CRED_STORE_MAGIC, 8) != 0)
+		goto end;
+	put_u32(image + 8, CRED_STORE_VERSION);
+	if (!build_frame(image + CRED_STORE_HDR_LEN, all, nall, store->seq + 1))
+		goto end;
+
+	if (snprintf_s_si(tmp, sizeof(tmp), "%s.%d", store->path,
+			  (int)getpid()) < 0)
+		goto end;
+	fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		LOG(LOG_ERROR, "Could not create %s!\n", tmp);
+		goto end;
+	}
+	if (!write_all(fd, image, len, 0) || fdatasync(fd) != 0) {
+		LOG(LOG_ERROR, "Could not write %s!\n", tmp);
+		goto end;
+	}
+
+	if (rename(tmp, store->path) != 0 || !sync_store_dir(store)) {
+		LOG(LOG_ERROR, "Could not replace %s!\n", store->path);
+		goto end;
+	}
+	ret = true;
+
+	/* The new file starts with a single frame holding every record */
+	unmap_store(store);
+	if (!remap_store(store, fd, CRED_STORE_HDR_LEN,
+			 len - CRED_STORE_HDR_LEN))
+		unmap_store(store);
+
+end:
+	if (fd >= 0) {
+		(void)close(fd);
+		if (!ret)
+			(void)unlink(tmp);
+	}
+	(void)memset_s(image, len, 0);
+	sdo_free(image);
+	return ret;
+}
+
+/**
+ * Append one frame holding recs to the journal, dropping any torn frame at
+ * the end first.
+ */
+static bool append_store(cred_store_t *store, const cred_record_t *recs,
+			 size_t n)
+{
+	size_t len = frame_len(recs, n);
+	uint8_t *frame = NULL;
+	bool ret = false;
+	int fd;
+
+	frame = sdo_alloc(len);
+	if (!frame) {
+		LOG(LOG_ERROR, "Malloc failed for credential store!\n");
+		return false;
+	}
+	if (!build_frame(frame, recs, n, store->seq + 1))
+		goto end;
+
+	fd = open(store->path, O_RDWR);
+	if (fd < 0) {
+		LOG(LOG_ERROR, "Could not open %s!\n", store->path);
+		goto end;
+	}
+	if (ftruncate(fd, (off_t)store->valid_len) != 0 ||
+	    !write_all(fd, frame, len, (off_t)store->valid_len) ||
+	    fdatasync(fd) != 0) {
+		LOG(LOG_ERROR, "Could not write %s!\n", store->path);
+	} else {
+		ret = true;
+		if (!remap_store(store, fd, store->valid_len, len))
+			unmap_store(store);
+	}
+	(void)close(fd);
+
+end:
+	(void)memset_s(frame, len, 0);
+	sdo_free(frame);
+	return ret;
+}
+
+/**
+ * Commit recs as one atomic update of the store.
+ */
+static bool commit_records(cred_store_t *store, const cred_record_t *recs,
+			   size_t n)
+{
+	size_t nlive = n, i;
+
+	if (!load_store(store))
+		return false;
+
+	for (i = 0; i < store->nrec; i++)
+		if (!find_record((cred_record_t *)recs, n, store->rec[i].name,
+				 store->rec[i].name_len))
+			nlive++;
+	if (nlive > CRED_STORE_MAX_RECORDS) {
+		LOG(LOG_ERROR, "Too many records for %s!\n", store->path);
+		return false;
+	}
+
+	if (!store->map ||
+	    (store->valid_len + frame_len(recs, n) > CRED_STORE_COMPACT_LEN &&
+	     store->valid_len > 2 * store->live_len))
+		return rewrite_store(store, recs, n);
+	return append_store(store, recs, n);
+}
+
+/**
+ * Whether the blob name is kept in the credential store.
+ *
+ * @param name - blob/file name.
+ * @retval true if it is a store record, false for a plain file.
+ */
+bool cred_store_owns(const char *name)
+{
+	size_t i;
+
+	if (!name)
+		return false;
+	for (i = 0; i < sizeof(cred_store_names) / sizeof(cred_store_names[0]);
+	     i++)
+		if (strcmp(name, cred_store_names[i]) == 0)
+			return true;
+	return false;
+}
+
+/**
+ * Whether the record is in the store, or in its legacy blob file.
+ *
+ * @param name - blob/file name.
+ * @retval true if it exists, false otherwise.
+ */
+bool cred_store_exists(const char *name)
+{
+	cred_store_t *store = &sdo_ctx_current()->cred_store;
+	char path[SDO_MAX_STR_SIZE];
+
+	if (!load_store(store) || sdo_blob_path(name, path, sizeof(path)) != 0)
+		return false;
+	return lookup(store, name) || file_exists(path);
+}
+
+/**
+ * Size of the sealed record, or of its legacy blob file when the store does
+ * not hold it yet.
+ *
+ * @param name - blob/file name.
+ * @return size in bytes, -1 on error.
+ */
+int32_t cred_store_size(const char *name)
+{
+	cred_store_t *store = &sdo_ctx_current()->cred_store;
+	char path[SDO_MAX_STR_SIZE];
+	const cred_record_t *r;
+
+	if (!load_store(store))
+		return -1;
+
+	r = lookup(store, name);
+	if (r)
+		return (int32_t)r->data_len;
+	if (sdo_blob_path(name, path, sizeof(path)) != 0)
+		return -1;
+	return (int32_t)get_file_size(path);
+}
+
+/**
+ * Copy the first len bytes of a sealed record into buf.
+ *
+ * @param name - blob/file name.
+ * @param buf - output buffer.
+ * @param len - number of bytes to read.
+ * @return 0 on success, -1 on error.
+ */
+int32_t cred_store_read(const char *name, uint8_t *buf, size_t len)
+{
+	cred_store_t *store = &sdo_ctx_current()->cred_store;
+	char path[SDO_MAX_STR_SIZE];
+	const cred_record_t *r;
+
+	if (!buf || !load_store(store))
+		return -1;
+
+	r = lookup(store, name);
+	if (!r) {
+		if (sdo_blob_path(name, path, sizeof(path)) != 0)
+			return -1;
+		return read_buffer_from_file(path, buf, len);
+	}
+	if (r->data_len < len || memcpy_s(buf, len, r->data, len) != 0)
+		return -1;
+	return 0;
+}
+
+/**
+ * Store a sealed record. Inside cred_store_begin()/cred_store_end() the
+ * record is staged and committed together with the rest of the batch,
+ * otherwise it is committed on its own.
+ *
+ * @param name - blob/file name.
+ * @param buf - sealed record contents.
+ * @param len - length of buf.
+ * @return 0 on success, -1 on error.
+ */
+int32_t cred_store_write(const char *name, const uint8_t *buf, size_t len)
+{
+	cred_store_t *store = &sdo_ctx_current()->cred_store;
+	cred_record_t rec, *r;
+	uint8_t *copy;
+
+	if (!name || !buf || len > UINT32_MAX)
+		return -1;
+
+	rec.name = record_key(name, &rec.name_len);
+	rec.data = buf;
+	rec.data_len = (uint32_t)len;
+
+	if (!store->batch)
+		return commit_records(store, &rec, 1) ? 0 : -1;
+
+	copy = sdo_alloc(len);
+	if (!copy || memcpy_s(copy, len, buf, len) != 0) {
+		LOG(LOG_ERROR, "Could not stage %s!\n", name);
+		sdo_free(copy);
+		return -1;
+	}
+	r = find_record(store->staged, store->nstaged, rec.name, rec.name_len);
+	if (r) {
+		uint8_t *old = (uint8_t *)r->data;
+
+		(void)memset_s(old, r->data_len, 0);
+		sdo_free(old);
+	} else if (store->nstaged < CRED_STORE_MAX_RECORDS) {
+		r = &store->staged[store->nstaged++];
+	} else {
+		sdo_free(copy);
+		return -1;
+	}
+	*r = rec;
+	r->data = copy;
+	return 0;
+}
+
+/**
+ * Start a batch: records written until cred_store_end() are committed
+ * together.
+ *
+ * @return 0 on success, -1 if a batch is already open.
+ */
+int32_t cred_store_begin(void)
+{
+	cred_store_t *store = &sdo_ctx_current()->cred_store;
+
+	if (store->batch)
+		return -1;
+	store->batch = true;
+	return 0;
+}
+
+/**
+ * Close a batch, committing the staged records in one frame or dropping
+ * them.
+ *
+ * @param commit - true to commit, false to discard the batch.
+ * @return 0 on success, -1 on error.
+ */
+int32_t cred_store_end(bool commit)
+{
+	cred_store_t *store = &sdo_ctx_current()->cred_store;
+	int32_t ret = 0;
+
+	if (!store->batch)
+		return -1;
+	store->batch = false;
+
+	if (commit && store->nstaged &&
+	    !commit_records(store, store->staged, store->nstaged))
+		ret = -1;
+	free_staged(store);
+	return ret;
+}
+
+/**
+ * Release the mapping and any staged records of a store, when its SDK
+ * context goes away or moves to another blob directory.
+ *
+ * @param store - store of the context.
+ */
+void cred_store_close(cred_store_t *store)
+{
+	if (!store)
+		return;
+	free_staged(store);
+	store->batch = false;
+	unmap_store(store);
+}
@@ -8,37 +8,252 @@
  *
  * The file implements required platform utilities for SDO.
  */
+#include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "util.h"
 #include "safe_lib.h"
 #include "sdoCryptoHal.h"
 #include "platform_utils.h"
+
+/*
+ * Platform keyring
+ *
+ * Between platform_keyring_init() and platform_keyring_close() the blob
+ * sealing keys and the IV state are kept in a page that is locked in RAM and
+ * left out of core dumps, so blob reads and writes do not go back to the key
+ * files. Entries are filled at init from the files that exist, or on first
+ * use, and dropped when the corresponding file is rewritten.
+ *
+ * IVs are handed out from a lease: the IV file holds a high-water mark up to
+ * PLATFORM_IV_LEASE_LEN increments ahead of the last IV used, so it is only
+ * rewritten when the lease runs out. After a crash the device continues from
+ * the mark, skipping what was left of the lease but never reusing an IV.
+ */
+typedef struct {
+	bool aes_key_valid;
+	bool hmac_key_valid;
+	bool iv_valid;
+	uint8_t aes_key[PLATFORM_AES_KEY_DEFAULT_LEN];
+	uint8_t hmac_key[PLATFORM_HMAC_KEY_DEFAULT_LEN];
+	uint8_t iv[PLATFORM_IV_DEFAULT_LEN * 2]; /* [first_iv||latest_iv] */
+	uint8_t iv_mark[PLATFORM_IV_DEFAULT_LEN]; /* latest_iv in the file */
+	uint32_t iv_lease; /* increments left before iv_mark is reached */
+} platform_keyring_t;
+
+static platform_keyring_t *keyring;
+static size_t keyring_size;
+/* SDK contexts holding the keyring open */
+static unsigned int keyring_users;
+/* The keyring and the IV file are shared by all SDK contexts */
+static pthread_mutex_t keyring_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Copy key material into a keyring slot and mark it valid */
+static void keyring_put(uint8_t *slot, bool *valid, const uint8_t *src,
+			size_t len)
+{
+	*valid = (memcpy_s(slot, len, src, len) == 0);
+}
+
+/* The IV file is written here first, then renamed over PLATFORM_IV */
+#define PLATFORM_IV_TMP PLATFORM_IV ".tmp"
+
 /**
- * Generate platform IV (if not already generated) else provide already
- * generated IV.
+ * Flush the directory of the platform IV file to the storage device, making
+ * the rename of the IV file durable.
+ *
+ * @retval true on success, false otherwise.
+ */
+static bool platform_iv_sync_dir(void)
+{
+	const char *path = PLATFORM_IV;
+	const char *slash = strrchr(path, '/');
+	char dir[SDO_MAX_STR_SIZE] = {0};
+	size_t len = slash ? (size_t)(slash - path) : 0;
+	bool retval = false;
+	int fd;
+
+	if (!slash)
+		dir[len++] = '.';
+	else if (!len)
+		dir[len++] = '/';
+	else if (len >= sizeof(dir) || memcpy_s(dir, sizeof(dir), path, len))
+		return false;
+	dir[len] = '\0';
+
+	fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0) {
+		LOG(LOG_ERROR, "Could not open directory: %s\n", dir);
+		return false;
+	}
+	if (fsync(fd) == 0)
+		retval = true;
+	else
+		LOG(LOG_ERROR, "Could not sync directory: %s\n", dir);
+	if (close(fd) != 0)
+		retval = false;
+	return retval;
+}
+
+/**
+ * Write [first_iv||latest_iv] to the platform IV file and flush it to the
+ * storage device. The pair goes to a temporary file that is renamed over
+ * the IV file, so a crash leaves either the old mark or the new one, never
+ * a truncated file.
+ *
+ * @param buf - IV pair to store.
+ * @retval true on success, false otherwise.
+ */
+static bool platform_iv_store(const uint8_t *buf)
+{
+	size_t size = PLATFORM_IV_DEFAULT_LEN * 2;
+	struct stat st;
+	mode_t mode = 0666;
+	bool retval = false;
+	ssize_t n = 0;
+	int fd = -1;
+
+	if (stat(PLATFORM_IV, &st) == 0)
+		mode = st.st_mode & 0777;
+
+	fd = open(PLATFORM_IV_TMP, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+		  mode);
+	if (fd < 0) {
+		LOG(LOG_ERROR, "Could not open platform IV file!\n");
+		return false;
+	}
+
+	while (size) {
+		n = write(fd, buf, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			LOG(LOG_ERROR,
+			    "Plaform IV file is not written properly!\n");
+			goto end;
+		}
+		buf += n;
+		size -= (size_t)n;
+	}
+
+	if (fdatasync(fd) != 0) {
+		LOG(LOG_ERROR, "Plaform IV file could not be synced!\n");
+		goto end;
+	}
+	retval = true;
+
+end:
+	if (close(fd) != 0)
+		retval = false;
+	if (!retval) {
+		(void)remove(PLATFORM_IV_TMP);
+		return false;
+	}
+
+	if (rename(PLATFORM_IV_TMP, PLATFORM_IV) != 0) {
+		LOG(LOG_ERROR, "Could not replace platform IV file!\n");
+		(void)remove(PLATFORM_IV_TMP);
+		return false;
+	}
+	return platform_iv_sync_dir();
+}
+
+/**
+ * Move the high-water mark in the IV file PLATFORM_IV_LEASE_LEN increments
+ * further, stopping short if that would roll the IV over.
+ *
+ * @param needed - increments the caller needs from the lease.
+ * @retval true if the lease now covers needed increments, false otherwise.
+ */
+static bool platform_iv_extend_lease(uint32_t needed)
+{
+	uint8_t next[PLATFORM_IV_DEFAULT_LEN * 2] = {0};
+	uint32_t n;
+
+	if (memcpy_s(next, PLATFORM_IV_DEFAULT_LEN, keyring->iv,
+		     PLATFORM_IV_DEFAULT_LEN) != 0 ||
+	    memcpy_s(next + PLATFORM_IV_DEFAULT_LEN, PLATFORM_IV_DEFAULT_LEN,
+		     keyring->iv_mark, PLATFORM_IV_DEFAULT_LEN) != 0) {
+		LOG(LOG_ERROR, "Copying platform IV failed!\n");
+		return false;
+	}
+
+	for (n = 0; n < PLATFORM_IV_LEASE_LEN; n++)
+		if (inc_rollover_ctr(next, next + PLATFORM_IV_DEFAULT_LEN,
+				     PLATFORM_IV_DEFAULT_LEN, 0) == -1)
+			break;
+
+	if (keyring->iv_lease + n < needed) {
+		LOG(LOG_ERROR, "Roll over condition reached!\n");
+		return false;
+	}
+
+	if (!platform_iv_store(next))
+		return false;
+
+	if (memcpy_s(keyring->iv_mark, PLATFORM_IV_DEFAULT_LEN,
+		     next + PLATFORM_IV_DEFAULT_LEN,
+		     PLATFORM_IV_DEFAULT_LEN) != 0) {
+		LOG(LOG_ERROR, "Copying platform IV failed!\n");
+		return false;
+	}
+	keyring->iv_lease += n;
+	return true;
+}
+
+/**
+ * Hand out the next IV from the keyring, extending the lease first if it
+ * does not cover this encryption.
  *
  * @param iv - buffer of size len to output IV.
- * @param len - length(in bytes) of the IV to be generated.
+ * @param len - length(in bytes) of iv.
  * @param datalen - length(in bytes) of data to be encrypted.
  * @retval true if IV is copied successfully, false otherwise.
  */
-bool get_platform_iv(uint8_t *iv, size_t len, size_t datalen)
+static bool platform_iv_from_lease(uint8_t *iv, size_t len, size_t datalen)
+{
+	uint8_t *latest = keyring->iv + PLATFORM_IV_DEFAULT_LEN;
+	size_t aesblocks = datalen / PLATFORM_AES_BLOCK_LEN;
+	/* inc_rollover_ctr() steps twice for 2^32 blocks and more */
+	uint32_t steps = (aesblocks <= 0xFFFFFFFF) ? 1 : 2;
+
+	if (keyring->iv_lease < steps && !platform_iv_extend_lease(steps))
+		return false;
+
+	if (inc_rollover_ctr(keyring->iv, latest, PLATFORM_IV_DEFAULT_LEN,
+			     aesblocks) == -1) {
+		LOG(LOG_ERROR, "Roll over condition reached!\n");
+		return false;
+	}
+	keyring->iv_lease -= steps;
+
+	if (memcpy_s(iv, len, latest, PLATFORM_IV_DEFAULT_LEN) != 0) {
+		LOG(LOG_ERROR, "Copying platform IV failed!\n");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Generate a new platform IV pair, or read the stored one and advance the
+ * latest IV past the blocks about to be encrypted.
+ *
+ * @param buf - buffer receiving [first_iv||latest_iv].
+ * @param datalen - length(in bytes) of data to be encrypted.
+ * @retval true on success, false otherwise.
+ */
+static bool platform_iv_from_file(uint8_t *buf, size_t datalen)
 {
 	bool retval = false;
-	FILE *fp = NULL;
 	size_t fsize = 0;
-	uint8_t buf[PLATFORM_IV_DEFAULT_LEN * 2] = {0};
 	uint8_t *p_iv = NULL;
 
-	/*
-	 * Platform iv file storage format
-	 * [First_iv||latest_iv]
-	 */
-	if (!iv || len < PLATFORM_IV_DEFAULT_LEN) {
-		LOG(LOG_ERROR, "Invalid parameters!\n");
-		goto end;
-	}
-
 	if (!file_exists((const char *)PLATFORM_IV)) {
 		LOG(LOG_ERROR, "Plaform-IV file does not exists!\n");
 		goto end;
@@ -64,11 +279,13 @@ bool get_platform_iv(uint8_t *iv, size_t len, size_t datalen)
 		}
 
 		/* store the first iv */
-		if (memcpy_s(buf, len, p_iv, PLATFORM_IV_DEFAULT_LEN) != 0) {
+		if (memcpy_s(buf, PLATFORM_IV_DEFAULT_LEN, p_iv,
+			     PLATFORM_IV_DEFAULT_LEN) != 0) {
 			LOG(LOG_ERROR, "Copying platform IV failed!\n");
 			goto end;
 		}
-		if (memcpy_s(buf + PLATFORM_IV_DEFAULT_LEN, len, p_iv,
+		if (memcpy_s(buf + PLATFORM_IV_DEFAULT_LEN,
+			     PLATFORM_IV_DEFAULT_LEN, p_iv,
 			     PLATFORM_IV_DEFAULT_LEN) != 0) {
 			LOG(LOG_ERROR, "Copying platform IV failed!\n");
 			goto end;
@@ -77,7 +294,7 @@ bool get_platform_iv(uint8_t *iv, size_t len, size_t datalen)
 	} else {
 		/* return the previously generated IV */
 		if (0 != read_buffer_from_file((const char *)PLATFORM_IV, buf,
-					       sizeof(buf))) {
+					       PLATFORM_IV_DEFAULT_LEN * 2)) {
 			LOG(LOG_ERROR, "Failed to read platform IV file!\n");
 			goto end;
 		}
@@ -89,43 +306,80 @@ bool get_platform_iv(uint8_t *iv, size_t len, size_t datalen)
 			goto end;
 		}
 	}
+	retval = true;
 
-	fp = fopen((const char *)PLATFORM_IV, "w");
-	if (!fp) {
-		LOG(LOG_ERROR, "Could not open platform IV file!\n");
-		goto end;
-	}
+end:
+	if (p_iv)
+		sdo_free(p_iv);
+	return retval;
+}
 
-	if ((PLATFORM_IV_DEFAULT_LEN * 2) !=
-	    fwrite(buf, sizeof(char), sizeof(buf), fp)) {
-		LOG(LOG_ERROR, "Plaform IV file is not written properly!\n");
-		goto end;
+/**
+ * Internal API
+ * get_platform_iv() with keyring_lock held.
+ */
+static bool platform_iv_get(uint8_t *iv, size_t len, size_t datalen)
+{
+	uint8_t buf[PLATFORM_IV_DEFAULT_LEN * 2] = {0};
+
+	/*
+	 * Platform iv file storage format
+	 * [First_iv||latest_iv]
+	 */
+	if (!iv || len < PLATFORM_IV_DEFAULT_LEN) {
+		LOG(LOG_ERROR, "Invalid parameters!\n");
+		return false;
 	}
 
+	if (keyring && keyring->iv_valid)
+		return platform_iv_from_lease(iv, len, datalen);
+
+	if (!platform_iv_from_file(buf, datalen) || !platform_iv_store(buf))
+		return false;
+
 	if (memcpy_s(iv, len, buf + PLATFORM_IV_DEFAULT_LEN,
 		     PLATFORM_IV_DEFAULT_LEN) != 0) {
 		LOG(LOG_ERROR, "Copying platform IV failed!\n");
-		goto end;
+		return false;
 	}
-	retval = true;
 
-end:
-	if (fp)
-		fclose(fp);
-	if (p_iv)
-		sdo_free(p_iv);
-	return retval;
+	/* The IV just stored is the mark; the lease starts out empty */
+	if (keyring) {
+		keyring->iv_lease = 0;
+		keyring->iv_valid =
+		    memcpy_s(keyring->iv, sizeof(keyring->iv), buf,
+			     sizeof(buf)) == 0 &&
+		    memcpy_s(keyring->iv_mark, sizeof(keyring->iv_mark),
+			     buf + PLATFORM_IV_DEFAULT_LEN,
+			     PLATFORM_IV_DEFAULT_LEN) == 0;
+	}
+	return true;
 }
 
 /**
- * Generate platform AES Key (if not already generated) else provide already
- * generated Key.
+ * Generate platform IV (if not already generated) else provide already
+ * generated IV.
  *
- * @param key - buffer of size len to output KEY.
- * @param len - length(in bytes) of the KEY to be generated.
- * @retval true if Key is copied successfully, false otherwise.
+ * @param iv - buffer of size len to output IV.
+ * @param len - length(in bytes) of the IV to be generated.
+ * @param datalen - length(in bytes) of data to be encrypted.
+ * @retval true if IV is copied successfully, false otherwise.
  */
-bool get_platform_aes_key(uint8_t *key, size_t len)
+bool get_platform_iv(uint8_t *iv, size_t len, size_t datalen)
+{
+	bool ret;
+
+	(void)pthread_mutex_lock(&keyring_lock);
+	ret = platform_iv_get(iv, len, datalen);
+	(void)pthread_mutex_unlock(&keyring_lock);
+	return ret;
+}
+
+/**
+ * Internal API
+ * get_platform_aes_key() with keyring_lock held.
+ */
+static bool platform_aes_key_get(uint8_t *key, size_t len)
 {
 	bool retval = false;
 	FILE *fp = NULL;
@@ -136,6 +390,10 @@ bool get_platform_aes_key(uint8_t *key, size_t len)
 		goto end;
 	}
 
+	if (keyring && keyring->aes_key_valid)
+		return memcpy_s(key, len, keyring->aes_key,
+				PLATFORM_AES_KEY_DEFAULT_LEN) == 0;
+
 	if (!file_exists((const char *)PLATFORM_AES_KEY)) {
 		LOG(LOG_ERROR, "Plaform-AES-Key file does not exists!\n");
 		goto end;
@@ -179,6 +437,9 @@ bool get_platform_aes_key(uint8_t *key, size_t len)
 			goto end;
 		}
 	}
+	if (keyring)
+		keyring_put(keyring->aes_key, &keyring->aes_key_valid, key,
+			    PLATFORM_AES_KEY_DEFAULT_LEN);
 	retval = true;
 
 end:
@@ -186,16 +447,30 @@ end:
 		fclose(fp);
 	return retval;
 }
+
 /**
- * Generate HMAC Key (if not already generated) else provide already
+ * Generate platform AES Key (if not already generated) else provide already
  * generated Key.
  *
- * @param key - buffer of size len to output key.
- * @param len - length(in bytes) of the key to be generated.
- * @retval true if key is copied successfully, false otherwise.
+ * @param key - buffer of size len to output KEY.
+ * @param len - length(in bytes) of the KEY to be generated.
+ * @retval true if Key is copied successfully, false otherwise.
  */
+bool get_platform_aes_key(uint8_t *key, size_t len)
+{
+	bool ret;
 
-bool get_platform_hmac_key(uint8_t *key, size_t len)
+	(void)pthread_mutex_lock(&keyring_lock);
+	ret = platform_aes_key_get(key, len);
+	(void)pthread_mutex_unlock(&keyring_lock);
+	return ret;
+}
+
+/**
+ * Internal API
+ * get_platform_hmac_key() with keyring_lock held.
+ */
+static bool platform_hmac_key_get(uint8_t *key, size_t len)
 {
 	bool retval = false;
 	FILE *fp = NULL;
@@ -206,6 +481,10 @@ bool get_platform_hmac_key(uint8_t *key, size_t len)
 		goto end;
 	}
 
+	if (keyring && keyring->hmac_key_valid)
+		return memcpy_s(key, len, keyring->hmac_key,
+				PLATFORM_HMAC_KEY_DEFAULT_LEN) == 0;
+
 	if (!file_exists((const char *)PLATFORM_HMAC_KEY)) {
 		LOG(LOG_ERROR, "Plaform-HMAC-Key file does not exists!\n");
 		goto end;
@@ -248,6 +527,9 @@ bool get_platform_hmac_key(uint8_t *key, size_t len)
 			goto end;
 		}
 	}
+	if (keyring)
+		keyring_put(keyring->hmac_key, &keyring->hmac_key_valid, key,
+			    PLATFORM_HMAC_KEY_DEFAULT_LEN);
 	retval = true;
 
 end:
@@ -255,3 +537,161 @@ end:
 		fclose(fp);
 	return retval;
 }
+
+/**
+ * Generate HMAC Key (if not already generated) else provide already
+ * generated Key.
+ *
+ * @param key - buffer of size len to output key.
+ * @param len - length(in bytes) of the key to be generated.
+ * @retval true if key is copied successfully, false otherwise.
+ */
+bool get_platform_hmac_key(uint8_t *key, size_t len)
+{
+	bool ret;
+
+	(void)pthread_mutex_lock(&keyring_lock);
+	ret = platform_hmac_key_get(key, len);
+	(void)pthread_mutex_unlock(&keyring_lock);
+	return ret;
+}
+
+/**
+ * Internal API
+ * Zeroize and release the platform keyring, with keyring_lock held.
+ */
+static void keyring_unload(void)
+{
+	if (!keyring)
+		return;
+
+	if (memset_s(keyring, keyring_size, 0) != 0)
+		LOG(LOG_ERROR, "Failed to clear platform keyring!\n");
+	(void)munlock(keyring, keyring_size);
+	(void)munmap(keyring, keyring_size);
+	keyring = NULL;
+}
+
+/**
+ * Internal API
+ * Load the platform keyring, with keyring_lock held: allocate a locked page
+ * for it and fill it from the platform key and IV files that already exist.
+ * Keys that are not there yet are created and cached on first use, as
+ * without the keyring.
+ *
+ * @retval true if the keyring is available, false otherwise.
+ */
+static bool keyring_load(void)
+{
+	uint8_t aes_key[PLATFORM_AES_KEY_DEFAULT_LEN] = {0};
+	uint8_t hmac_key[PLATFORM_HMAC_KEY_DEFAULT_LEN] = {0};
+	long page = sysconf(_SC_PAGESIZE);
+	void *p;
+
+	if (keyring)
+		return true;
+
+	keyring_size = sizeof(platform_keyring_t);
+	if (page > 0 && (size_t)page > keyring_size)
+		keyring_size = (size_t)page;
+
+	p = mmap(NULL, keyring_size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		LOG(LOG_ERROR, "Could not map platform keyring!\n");
+		return false;
+	}
+
+	/* Not fatal: RLIMIT_MEMLOCK may be too low for even one page */
+	if (mlock(p, keyring_size) != 0)
+		LOG(LOG_DEBUG, "Platform keyring is not locked in memory\n");
+#ifdef MADV_DONTDUMP
+	(void)madvise(p, keyring_size, MADV_DONTDUMP);
+#endif
+	keyring = p;
+
+	if (file_exists((const char *)PLATFORM_AES_KEY))
+		(void)platform_aes_key_get(aes_key, sizeof(aes_key));
+	if (file_exists((const char *)PLATFORM_HMAC_KEY))
+		(void)platform_hmac_key_get(hmac_key, sizeof(hmac_key));
+	/* Everything up to the stored mark may have been used already */
+	if (file_exists((const char *)PLATFORM_IV) &&
+	    get_file_size((const char *)PLATFORM_IV) == sizeof(keyring->iv) &&
+	    read_buffer_from_file((const char *)PLATFORM_IV, keyring->iv,
+				  sizeof(keyring->iv)) == 0 &&
+	    memcpy_s(keyring->iv_mark, sizeof(keyring->iv_mark),
+		     keyring->iv + PLATFORM_IV_DEFAULT_LEN,
+		     PLATFORM_IV_DEFAULT_LEN) == 0)
+		keyring->iv_valid = true;
+
+	if (memset_s(aes_key, sizeof(aes_key), 0) != 0 ||
+	    memset_s(hmac_key, sizeof(hmac_key), 0) != 0) {
+		LOG(LOG_ERROR, "Failed to clear platform key!\n");
+		keyring_unload();
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Load the platform keyring, or take another reference to it when an SDK
+ * context already did. Each successful call is paired with a
+ * platform_keyring_close().
+ *
+ * @retval true if the keyring is available, false otherwise.
+ */
+bool platform_keyring_init(void)
+{
+	bool ret;
+
+	(void)pthread_mutex_lock(&keyring_lock);
+	ret = keyring_load();
+	if (ret)
+		keyring_users++;
+	(void)pthread_mutex_unlock(&keyring_lock);
+	return ret;
+}
+
+/**
+ * Drop a reference to the platform keyring; the last one zeroizes and
+ * releases it. Later key lookups read the platform key files again.
+ */
+void platform_keyring_close(void)
+{
+	(void)pthread_mutex_lock(&keyring_lock);
+	if (keyring_users > 0)
+		keyring_users--;
+	if (keyring_users == 0)
+		keyring_unload();
+	(void)pthread_mutex_unlock(&keyring_lock);
+}
+
+/**
+ * Forget the cached copy of a platform key or IV file that has been
+ * rewritten, so the next lookup reads the new contents.
+ *
+ * @param name - path of the file that was written.
+ */
+void platform_keyring_drop(const char *name)
+{
+	if (!name)
+		return;
+
+	(void)pthread_mutex_lock(&keyring_lock);
+	if (!keyring) {
+		(void)pthread_mutex_unlock(&keyring_lock);
+		return;
+	}
+
+	if (strcmp(name, (const char *)PLATFORM_AES_KEY) == 0) {
+		(void)memset_s(keyring->aes_key, sizeof(keyring->aes_key), 0);
+		keyring->aes_key_valid = false;
+	} else if (strcmp(name, (const char *)PLATFORM_HMAC_KEY) == 0) {
+		(void)memset_s(keyring->hmac_key, sizeof(keyring->hmac_key), 0);
+		keyring->hmac_key_valid = false;
+	} else if (strcmp(name, (const char *)PLATFORM_IV) == 0) {
+		keyring->iv_valid = false;
+		keyring->iv_lease = 0;
+	}
+	(void)pthread_mutex_unlock(&keyring_lock);
+}
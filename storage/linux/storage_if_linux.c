@@ -14,12 +14,49 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "safe_lib.h"
 #include "util.h"
 #include "sdoCryptoHal.h"
 #include "sdoCrypto.h"
 #include "crypto_utils.h"
 #include "platform_utils.h"
+#include "sdotrace.h"
+#include "sdoctx.h"
+#ifdef CRED_STORE_ENABLED
+#include "cred_store.h"
+#endif
+
+/* Size of the internal buffer streams process data in, a multiple of the AES
+ * block size
+ */
+#define BLOB_STREAM_CHUNK_SIZE BUFF_SIZE_2K_BYTES
+/* Largest header in front of the blob data, the NORMAL one */
+#define BLOB_STREAM_HEADER_MAX (PLATFORM_HMAC_SIZE + BLOB_CONTENT_SIZE)
+
+struct sdo_blob_stream {
+	FILE *f;
+	char *name;
+	char *tmp_name; /* NULL for read streams */
+	sdo_sdk_blob_flags flags;
+	bool failed;
+	uint32_t length; /* stored length, or bytes written so far */
+	uint32_t offset; /* bytes handed to the caller so far */
+	void *mac;
+	void *gcm;
+	uint8_t iv[PLATFORM_IV_DEFAULT_LEN];
+	uint8_t seal[PLATFORM_HMAC_SIZE]; /* stored HMAC or GCM tag */
+	/* Plaintext not yet handed out (read) or not yet encrypted (write),
+	 * always less than one AES block
+	 */
+	uint8_t carry[PLATFORM_AES_BLOCK_LEN];
+	size_t carry_len;
+	size_t carry_off;
+	uint8_t chunk[BLOB_STREAM_CHUNK_SIZE];
+};
 
 /****************************************************
  *
@@ -47,6 +84,322 @@
  *
  **********************************************************/
 
+/**
+ * Whether name is one of the platform key and IV files, which belong to the
+ * process rather than to an SDK context.
+ */
+static bool is_platform_file(const char *name)
+{
+	static const char *const platform_files[] = {
+	    PLATFORM_IV, PLATFORM_HMAC_KEY, PLATFORM_AES_KEY};
+	size_t i;
+	int result = 1;
+
+	for (i = 0; i < sizeof(platform_files) / sizeof(platform_files[0]);
+	     i++) {
+		if (strcmp_s(platform_files[i], SDO_MAX_STR_SIZE, name,
+			     &result) == 0 &&
+		    result == 0)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Internal API
+ * Path of the file of a blob for the SDK context of the calling thread. A
+ * relative name is taken relative to the blob directory of the context, if
+ * it has one (see sdo_sdk_ctx_set_blob_dir()). The platform keys and IV are
+ * always used as named.
+ * @param name - pointer to the blob/file name
+ * @param path - buffer the path is copied into
+ * @param path_len - size of path
+ * @return 0 on success, -1 if the path does not fit
+ */
+int sdo_blob_path(const char *name, char *path, size_t path_len)
+{
+	const char *dir = sdo_ctx_current()->blob_dir;
+
+	if (!name || !path)
+		return -1;
+	if (!dir || name[0] == '/' || is_platform_file(name)) {
+		if (strcpy_s(path, path_len, name) != 0)
+			goto err;
+		return 0;
+	}
+	if (strcpy_s(path, path_len, dir) != 0 ||
+	    strcat_s(path, path_len, "/") != 0 ||
+	    strcat_s(path, path_len, name) != 0)
+		goto err;
+	return 0;
+
+err:
+	LOG(LOG_ERROR, "Path of %s is too long\n", name);
+	return -1;
+}
+
+/**
+ * File currently holding the blob at path: the temporary file of a write
+ * that is waiting for the batch to end, otherwise the blob file itself.
+ */
+static const char *blob_file_path(const char *path)
+{
+	sdo_blob_batch_t *batch = &sdo_ctx_current()->blob_batch;
+	size_t i;
+	int result = 1;
+
+	for (i = 0; batch->open && i < batch->count; i++) {
+		if (strcmp_s(batch->pending[i].name, SDO_MAX_STR_SIZE, path,
+			     &result) == 0 &&
+		    result == 0)
+			return batch->pending[i].tmp_name;
+	}
+	return path;
+}
+
+/**
+ * Temporary file a blob is written to before it replaces the blob.
+ * @return allocated path, NULL on error
+ */
+static char *blob_tmp_name(const char *name)
+{
+	size_t len = strnlen_s(name, SDO_MAX_STR_SIZE) + sizeof(".tmp");
+	char *tmp_name = sdo_alloc(len);
+
+	if (!tmp_name || strcpy_s(tmp_name, len, name) != 0 ||
+	    strcat_s(tmp_name, len, ".tmp") != 0) {
+		LOG(LOG_ERROR, "Malloc Failed in %s!\n", __func__);
+		if (tmp_name)
+			sdo_free(tmp_name);
+		return NULL;
+	}
+	return tmp_name;
+}
+
+/**
+ * Copy the directory part of path into dir, "." if there is none.
+ * @return 0 on success, -1 on error
+ */
+static int blob_dir(const char *path, char *dir, size_t dir_len)
+{
+	size_t len = strnlen_s(path, SDO_MAX_STR_SIZE);
+
+	while (len && path[len - 1] != '/')
+		len--;
+	/* keep the slash of the root directory only */
+	if (len > 1)
+		len--;
+	if (len == 0)
+		return strcpy_s(dir, dir_len, ".") == 0 ? 0 : -1;
+	if (len >= dir_len || memcpy_s(dir, dir_len, path, len) != 0)
+		return -1;
+	dir[len] = '\0';
+	return 0;
+}
+
+/**
+ * Flush the directory entries of dir to the storage device, making the
+ * renames done in it durable.
+ * @return 0 on success, -1 on error
+ */
+static int sync_blob_dir(const char *dir)
+{
+	int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	int ret = -1;
+
+	if (fd < 0) {
+		LOG(LOG_ERROR, "Could not open directory: %s\n", dir);
+		return -1;
+	}
+	if (fsync(fd) == 0)
+		ret = 0;
+	else
+		LOG(LOG_ERROR, "Could not sync directory: %s\n", dir);
+	if (close(fd) != 0)
+		ret = -1;
+	return ret;
+}
+
+/**
+ * Write the sealed blob to path with a single write() (unless the kernel
+ * returns short) and flush it to the storage device. A blob being replaced
+ * passes on its permissions.
+ * @return 0 on success, -1 on error
+ */
+static int write_blob_file(const char *path, const char *name,
+			   const uint8_t *buf, size_t size)
+{
+	struct stat st;
+	mode_t mode = 0666;
+	ssize_t n = 0;
+	int fd = -1;
+	int ret = -1;
+
+	if (stat(name, &st) == 0)
+		mode = st.st_mode & 0777;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+	if (fd < 0) {
+		LOG(LOG_ERROR, "Could not open file: %s\n", path);
+		return -1;
+	}
+
+	while (size) {
+		n = write(fd, buf, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			LOG(LOG_ERROR, "file:%s not written properly\n", path);
+			goto end;
+		}
+		buf += n;
+		size -= (size_t)n;
+	}
+
+	if (fdatasync(fd) != 0) {
+		LOG(LOG_ERROR, "file:%s could not be synced\n", path);
+		goto end;
+	}
+	ret = 0;
+
+end:
+	if (close(fd) != 0) {
+		LOG(LOG_ERROR, "close() Failed in %s\n", __func__);
+		ret = -1;
+	}
+	return ret;
+}
+
+/**
+ * Move a fully written temporary file over its blob and make the rename
+ * durable. While a batch is open the file is only recorded, and moved by
+ * sdo_blob_batch_end().
+ * @return 0 on success, -1 on error
+ */
+static int publish_blob_file(const char *tmp_name, const char *name)
+{
+	sdo_blob_batch_t *batch = &sdo_ctx_current()->blob_batch;
+	char dir[SDO_MAX_STR_SIZE] = {0};
+	sdo_blob_pending_t *p = NULL;
+	size_t name_len = 0;
+
+	if (batch->open) {
+		/* a blob written again in the batch reuses its file */
+		if (blob_file_path(name) != name)
+			return 0;
+		if (batch->count == SDO_BLOB_BATCH_MAX) {
+			LOG(LOG_ERROR, "Too many blobs in one batch\n");
+			return -1;
+		}
+		p = &batch->pending[batch->count];
+		name_len = strnlen_s(name, SDO_MAX_STR_SIZE) + 1;
+		p->name = sdo_alloc(name_len);
+		p->tmp_name = blob_tmp_name(name);
+		if (!p->name || !p->tmp_name ||
+		    strcpy_s(p->name, name_len, name) != 0) {
+			LOG(LOG_ERROR, "Malloc Failed in %s!\n", __func__);
+			if (p->name)
+				sdo_free(p->name);
+			if (p->tmp_name)
+				sdo_free(p->tmp_name);
+			return -1;
+		}
+		batch->count++;
+		return 0;
+	}
+
+	if (rename(tmp_name, name) != 0) {
+		LOG(LOG_ERROR, "Could not replace file: %s\n", name);
+		return -1;
+	}
+	platform_keyring_drop(name);
+
+	if (blob_dir(name, dir, sizeof(dir)) != 0)
+		return -1;
+	return sync_blob_dir(dir);
+}
+
+/**
+ * Whether the blob is stored, in its own file or in the credential store.
+ */
+static bool stored_blob_exists(const char *name)
+{
+	char path[SDO_MAX_STR_SIZE];
+
+#ifdef CRED_STORE_ENABLED
+	if (cred_store_owns(name))
+		return cred_store_exists(name);
+#endif
+	if (sdo_blob_path(name, path, sizeof(path)) != 0)
+		return false;
+	return file_exists(blob_file_path(path));
+}
+
+/**
+ * Size of the stored (sealed) blob.
+ * @return size in bytes, -1 on error
+ */
+static int32_t stored_blob_size(const char *name)
+{
+	char path[SDO_MAX_STR_SIZE];
+
+#ifdef CRED_STORE_ENABLED
+	if (cred_store_owns(name))
+		return cred_store_size(name);
+#endif
+	if (sdo_blob_path(name, path, sizeof(path)) != 0)
+		return -1;
+	return (int32_t)get_file_size(blob_file_path(path));
+}
+
+/**
+ * Read the first size bytes of the stored (sealed) blob into buf.
+ * @return 0 on success, -1 on error
+ */
+static int read_stored_blob(const char *name, void *buf, size_t size)
+{
+	char path[SDO_MAX_STR_SIZE];
+
+#ifdef CRED_STORE_ENABLED
+	if (cred_store_owns(name))
+		return cred_store_read(name, buf, size);
+#endif
+	if (sdo_blob_path(name, path, sizeof(path)) != 0)
+		return -1;
+	return read_buffer_from_file(blob_file_path(path), buf, size);
+}
+
+/**
+ * Replace the stored (sealed) blob with buf. The blob file is replaced
+ * atomically: a power cut leaves either the old or the new contents.
+ * @return 0 on success, -1 on error
+ */
+static int write_stored_blob(const char *name, const uint8_t *buf, size_t size)
+{
+	char path[SDO_MAX_STR_SIZE];
+	char *tmp_name = NULL;
+	int ret = -1;
+
+#ifdef CRED_STORE_ENABLED
+	if (cred_store_owns(name))
+		return cred_store_write(name, buf, size);
+#endif
+	if (sdo_blob_path(name, path, sizeof(path)) != 0)
+		return -1;
+	tmp_name = blob_tmp_name(path);
+	if (!tmp_name)
+		return -1;
+
+	if (write_blob_file(tmp_name, path, buf, size) == 0 &&
+	    publish_blob_file(tmp_name, path) == 0)
+		ret = 0;
+	else
+		(void)remove(tmp_name);
+
+	sdo_free(tmp_name);
+	return ret;
+}
+
 /**
  * sdo_blob_size Get specified SDO blob(file) size
  * Note: SDO_SDK_OTP_DATA flag is not supported for this platform.
@@ -58,37 +411,41 @@
 int32_t sdo_blob_size(const char *name, sdo_sdk_blob_flags flags)
 {
 	int32_t retval = -1;
+	int32_t stored_size;
 
 	if (name == NULL) {
 		LOG(LOG_ERROR, "Invalid parameters!\n");
 		goto end;
 	}
 
-	if (file_exists(name) == false) {
+	if (stored_blob_exists(name) == false) {
 		LOG(LOG_DEBUG, "%s file does not exist!\n", name);
 		retval = 0;
 		goto end;
 	}
 
+	stored_size = stored_blob_size(name);
+	if (stored_size < 0)
+		goto end;
+
 	switch (flags) {
 	case SDO_SDK_RAW_DATA:
 		/* Raw Files are stored as plain files */
-		retval = (int32_t)(get_file_size(name));
+		retval = stored_size;
 		break;
 	case SDO_SDK_NORMAL_DATA:
 		/* Normal blob is stored as:
 		 * [HMAC(32bytes)||data-content-size(4bytes)||data-content(?)]
 		 */
-		retval = (int32_t)(get_file_size(name) - PLATFORM_HMAC_SIZE -
-				   BLOB_CONTENT_SIZE);
+		retval = stored_size - PLATFORM_HMAC_SIZE - BLOB_CONTENT_SIZE;
 		break;
 	case SDO_SDK_SECURE_DATA:
 		/* Secure blob is stored as:
 		 * [IV_data(12byte)||TAG(16bytes)||
 		 * data-content-size(4bytes)||data-content(?)]
 		 */
-		retval = (int32_t)(get_file_size(name) - PLATFORM_GCM_TAG_SIZE -
-				   PLATFORM_IV_DEFAULT_LEN - BLOB_CONTENT_SIZE);
+		retval = stored_size - PLATFORM_GCM_TAG_SIZE -
+			 PLATFORM_IV_DEFAULT_LEN - BLOB_CONTENT_SIZE;
 		break;
 	default:
 		LOG(LOG_ERROR, "Invalid storage flag:%d!\n", flags);
@@ -132,6 +489,7 @@ int32_t sdo_blob_read(const char *name, sdo_sdk_blob_flags flags, uint8_t *buf,
 	uint8_t aes_key[PLATFORM_AES_KEY_DEFAULT_LEN] = {0};
 	size_t dat_len_offst = 0;
 
+	SDO_TRACE_BEGIN(SDO_TRACE_STORAGE, "blob_read", 0);
 	if (!name || !buf || n_bytes == 0) {
 		LOG(LOG_ERROR, "Invalid parameters in %s!\n", __func__);
 		goto exit;
@@ -148,7 +506,7 @@ int32_t sdo_blob_read(const char *name, sdo_sdk_blob_flags flags, uint8_t *buf,
 	switch (flags) {
 	case SDO_SDK_RAW_DATA:
 		// Raw Files are stored as plain files
-		if (0 != read_buffer_from_file(name, buf, n_bytes)) {
+		if (0 != read_stored_blob(name, buf, n_bytes)) {
 			LOG(LOG_ERROR, "Failed to read %s file!\n", name);
 			goto exit;
 		}
@@ -172,7 +530,7 @@ int32_t sdo_blob_read(const char *name, sdo_sdk_blob_flags flags, uint8_t *buf,
 		}
 
 		if (0 !=
-		    read_buffer_from_file(name, sealed_data, sealed_data_len)) {
+		    read_stored_blob(name, sealed_data, sealed_data_len)) {
 			LOG(LOG_ERROR, "Failed to read %s file!\n", name);
 			goto exit;
 		}
@@ -250,8 +608,8 @@ int32_t sdo_blob_read(const char *name, sdo_sdk_blob_flags flags, uint8_t *buf,
 			goto exit;
 		}
 
-		if (0 != read_buffer_from_file(name, encrypted_data,
-					       encrypted_data_len)) {
+		if (0 != read_stored_blob(name, encrypted_data,
+					  encrypted_data_len)) {
 			LOG(LOG_ERROR, "Failed to read %s file!\n", name);
 			goto exit;
 		}
@@ -329,6 +687,7 @@ exit:
 		LOG(LOG_ERROR, "Failed to clear AES key\n");
 		retval = -1;
 	}
+	SDO_TRACE_END(SDO_TRACE_STORAGE, "blob_read", 0);
 	return retval;
 }
 
@@ -348,15 +707,14 @@ int32_t sdo_blob_write(const char *name, sdo_sdk_blob_flags flags,
 		       const uint8_t *buf, uint32_t n_bytes)
 {
 	int retval = -1;
-	FILE *f = NULL;
 	uint32_t write_context_len = 0;
 	uint8_t *write_context = NULL;
-	size_t bytes_written = 0;
 	uint8_t tag[PLATFORM_GCM_TAG_SIZE] = {0};
 	uint8_t iv[PLATFORM_IV_DEFAULT_LEN] = {0};
 	uint8_t aes_key[PLATFORM_AES_KEY_DEFAULT_LEN] = {0};
 	size_t dat_len_offst = 0;
 
+	SDO_TRACE_BEGIN(SDO_TRACE_STORAGE, "blob_write", 0);
 	if (!buf || !name || n_bytes == 0) {
 		LOG(LOG_ERROR, "Invalid parameters in %s!\n", __func__);
 		goto exit;
@@ -505,30 +863,713 @@ int32_t sdo_blob_write(const char *name, sdo_sdk_blob_flags flags,
 		goto exit;
 	}
 
-	f = fopen(name, "w");
-	if (f != NULL) {
-		bytes_written =
-		    fwrite(write_context, sizeof(char), write_context_len, f);
-		if (bytes_written != write_context_len) {
-			LOG(LOG_ERROR, "file:%s not written properly\n", name);
-			goto exit;
-		}
-	} else {
-		LOG(LOG_ERROR, "Could not open file: %s\n", name);
+	if (write_stored_blob(name, write_context, write_context_len) != 0)
 		goto exit;
-	}
 
 	retval = (int32_t)n_bytes;
 
 exit:
 	if (write_context)
 		sdo_free(write_context);
-	if (f)
-		if (fclose(f) == EOF)
-			LOG(LOG_ERROR, "fclose() Failed in %s\n", __func__);
 	if (memset_s(aes_key, PLATFORM_AES_KEY_DEFAULT_LEN, 0)) {
 		LOG(LOG_ERROR, "Failed to clear AES key\n");
 		retval = -1;
 	}
+	SDO_TRACE_END(SDO_TRACE_STORAGE, "blob_write", 0);
 	return retval;
 }
+
+/**
+ * sdo_blob_batch_begin Start a group of blob writes that are to be stored
+ * together. Blob files written until sdo_blob_batch_end() stay in their
+ * temporary files and are moved into place together, with a single flush of
+ * their directory. With the credential store, the credential blobs are
+ * committed as one atomic update.
+ * @return 0 on success, -1 on error
+ */
+int32_t sdo_blob_batch_begin(void)
+{
+	sdo_blob_batch_t *batch = &sdo_ctx_current()->blob_batch;
+
+	if (batch->open) {
+		LOG(LOG_ERROR, "A blob batch is already open\n");
+		return -1;
+	}
+
+#ifdef CRED_STORE_ENABLED
+	if (cred_store_begin() != 0)
+		return -1;
+#endif
+	batch->open = true;
+	return 0;
+}
+
+/**
+ * sdo_blob_batch_end End a group of blob writes started by
+ * sdo_blob_batch_begin().
+ * @param commit - true to store the group, false to drop what is pending
+ * @return 0 on success, -1 on error
+ */
+int32_t sdo_blob_batch_end(bool commit)
+{
+	sdo_blob_batch_t *batch = &sdo_ctx_current()->blob_batch;
+	char dir[SDO_MAX_STR_SIZE] = {0};
+	char synced[SDO_MAX_STR_SIZE] = {0};
+	int32_t ret = 0;
+	int result = 1;
+	size_t i;
+
+	if (!batch->open)
+		return -1;
+
+#ifdef CRED_STORE_ENABLED
+	if (cred_store_end(commit) != 0) {
+		ret = -1;
+		commit = false;
+	}
+#endif
+	batch->open = false;
+
+	for (i = 0; i < batch->count; i++) {
+		if (!commit || ret != 0) {
+			(void)remove(batch->pending[i].tmp_name);
+		} else if (rename(batch->pending[i].tmp_name,
+				  batch->pending[i].name) != 0) {
+			LOG(LOG_ERROR, "Could not replace file: %s\n",
+			    batch->pending[i].name);
+			(void)remove(batch->pending[i].tmp_name);
+			ret = -1;
+		} else {
+			platform_keyring_drop(batch->pending[i].name);
+		}
+	}
+
+	/* one flush per directory, the blobs normally share one */
+	for (i = 0; commit && i < batch->count; i++) {
+		if (blob_dir(batch->pending[i].name, dir, sizeof(dir)) != 0) {
+			ret = -1;
+			continue;
+		}
+		if (strcmp_s(dir, sizeof(dir), synced, &result) == 0 &&
+		    result == 0)
+			continue;
+		if (sync_blob_dir(dir) != 0 ||
+		    strcpy_s(synced, sizeof(synced), dir) != 0)
+			ret = -1;
+	}
+
+	for (i = 0; i < batch->count; i++) {
+		sdo_free(batch->pending[i].name);
+		sdo_free(batch->pending[i].tmp_name);
+	}
+	batch->count = 0;
+	return ret;
+}
+
+/**
+ * Size of the header in front of the data of a stored blob.
+ */
+static size_t blob_header_size(sdo_sdk_blob_flags flags)
+{
+	switch (flags) {
+	case SDO_SDK_RAW_DATA:
+		return 0;
+	case SDO_SDK_NORMAL_DATA:
+		return PLATFORM_HMAC_SIZE + BLOB_CONTENT_SIZE;
+	case SDO_SDK_SECURE_DATA:
+		return PLATFORM_IV_DEFAULT_LEN + PLATFORM_GCM_TAG_SIZE +
+		       BLOB_CONTENT_SIZE;
+	default:
+		return SIZE_MAX;
+	}
+}
+
+/**
+ * Allocate a stream for name, or NULL if the blob cannot be streamed.
+ */
+static sdo_blob_stream_t *blob_stream_alloc(const char *name,
+					    sdo_sdk_blob_flags flags)
+{
+	char path[SDO_MAX_STR_SIZE];
+	sdo_blob_stream_t *s = NULL;
+	size_t name_len = 0;
+
+	if (!name || blob_header_size(flags) == SIZE_MAX) {
+		LOG(LOG_ERROR, "Invalid parameters in %s!\n", __func__);
+		return NULL;
+	}
+
+#ifdef CRED_STORE_ENABLED
+	if (cred_store_owns(name)) {
+		LOG(LOG_ERROR, "%s is kept in the credential store and cannot "
+			       "be streamed\n", name);
+		return NULL;
+	}
+#endif
+
+	if (sdo_blob_path(name, path, sizeof(path)) != 0)
+		return NULL;
+
+	s = sdo_alloc(sizeof(sdo_blob_stream_t));
+	if (!s) {
+		LOG(LOG_ERROR, "Malloc Failed in %s!\n", __func__);
+		return NULL;
+	}
+
+	/* the stream works on the file of the blob for this context */
+	name_len = strnlen_s(path, SDO_MAX_STR_SIZE) + 1;
+	s->name = sdo_alloc(name_len);
+	if (!s->name || strcpy_s(s->name, name_len, path) != 0) {
+		LOG(LOG_ERROR, "Malloc Failed in %s!\n", __func__);
+		if (s->name)
+			sdo_free(s->name);
+		sdo_free(s);
+		return NULL;
+	}
+	s->flags = flags;
+	return s;
+}
+
+/**
+ * Release a stream, discarding any unfinished HMAC/GCM operation and clearing
+ * the plaintext it still holds.
+ */
+static void blob_stream_free(sdo_blob_stream_t *s)
+{
+	if (s->f && fclose(s->f) == EOF)
+		LOG(LOG_ERROR, "fclose() Failed in %s\n", __func__);
+	if (s->tmp_name) {
+		(void)remove(s->tmp_name);
+		sdo_free(s->tmp_name);
+	}
+	if (s->mac)
+		(void)sdo_storage_hmac_end(s->mac, NULL, 0);
+	if (s->gcm)
+		(void)sdo_crypto_aes_gcm_end(s->gcm, NULL, 0);
+	if (memset_s(s->carry, sizeof(s->carry), 0) != 0 ||
+	    memset_s(s->chunk, sizeof(s->chunk), 0) != 0) {
+		LOG(LOG_ERROR, "Failed to clear blob stream\n");
+	}
+	sdo_free(s->name);
+	sdo_free(s);
+}
+
+/**
+ * Start the HMAC or decryption/encryption of a NORMAL or SECURE stream.
+ * @return 0 on success, -1 on error
+ */
+static int blob_stream_start(sdo_blob_stream_t *s, bool encrypt)
+{
+	uint8_t aes_key[PLATFORM_AES_KEY_DEFAULT_LEN] = {0};
+	int ret = -1;
+
+	if (s->flags == SDO_SDK_NORMAL_DATA) {
+		s->mac = sdo_storage_hmac_begin();
+		return s->mac ? 0 : -1;
+	}
+	if (s->flags != SDO_SDK_SECURE_DATA)
+		return 0;
+
+	if (!get_platform_aes_key(aes_key, PLATFORM_AES_KEY_DEFAULT_LEN)) {
+		LOG(LOG_ERROR, "Could not get platform AES Key!\n");
+		goto end;
+	}
+
+	s->gcm = sdo_crypto_aes_gcm_begin(encrypt, s->iv,
+					  PLATFORM_IV_DEFAULT_LEN, aes_key,
+					  PLATFORM_AES_KEY_DEFAULT_LEN);
+	if (s->gcm)
+		ret = 0;
+end:
+	if (memset_s(aes_key, PLATFORM_AES_KEY_DEFAULT_LEN, 0)) {
+		LOG(LOG_ERROR, "Failed to clear AES key\n");
+		ret = -1;
+	}
+	return ret;
+}
+
+/**
+ * sdo_blob_open_read Open SDO blob(file) for reading in chunks, without
+ * the R_MAX_SIZE limit of sdo_blob_read(). Data is decrypted straight into
+ * the caller's buffers and is only authenticated once sdo_blob_close()
+ * returns 0, so it must not be trusted before that.
+ * Note: SDO_SDK_OTP_DATA flag is not supported for this platform.
+ * @param name - pointer to the blob/file name
+ * @param flags - descriptor telling type of file
+ * @param length - out: length(in bytes) of the blob data
+ * @return stream on success, NULL on error
+ */
+sdo_blob_stream_t *sdo_blob_open_read(const char *name,
+				      sdo_sdk_blob_flags flags,
+				      uint32_t *length)
+{
+	sdo_blob_stream_t *s = NULL;
+	uint8_t header[BLOB_STREAM_HEADER_MAX] = {0};
+	size_t header_len = blob_header_size(flags);
+	const uint8_t *len_field = NULL;
+	size_t file_size = 0;
+
+	if (!length) {
+		LOG(LOG_ERROR, "Invalid parameters in %s!\n", __func__);
+		return NULL;
+	}
+
+	s = blob_stream_alloc(name, flags);
+	if (!s)
+		return NULL;
+
+	file_size = get_file_size(blob_file_path(s->name));
+	if (file_size < header_len || file_size - header_len > UINT32_MAX) {
+		LOG(LOG_ERROR, "%s: invalid blob size\n", name);
+		goto err;
+	}
+
+	s->f = fopen(blob_file_path(s->name), "rb");
+	if (!s->f) {
+		LOG(LOG_ERROR, "Could not open file: %s\n", name);
+		goto err;
+	}
+
+	if (header_len &&
+	    fread(header, 1, header_len, s->f) != header_len) {
+		LOG(LOG_ERROR, "Failed to read %s file!\n", name);
+		goto err;
+	}
+
+	switch (flags) {
+	case SDO_SDK_RAW_DATA:
+		s->length = (uint32_t)file_size;
+		break;
+	case SDO_SDK_NORMAL_DATA:
+		if (memcpy_s(s->seal, PLATFORM_HMAC_SIZE, header,
+			     PLATFORM_HMAC_SIZE) != 0)
+			goto err;
+		len_field = header + PLATFORM_HMAC_SIZE;
+		break;
+	default:
+		if (memcpy_s(s->iv, PLATFORM_IV_DEFAULT_LEN, header,
+			     PLATFORM_IV_DEFAULT_LEN) != 0 ||
+		    memcpy_s(s->seal, PLATFORM_GCM_TAG_SIZE,
+			     header + PLATFORM_IV_DEFAULT_LEN,
+			     PLATFORM_GCM_TAG_SIZE) != 0)
+			goto err;
+		len_field = header + PLATFORM_IV_DEFAULT_LEN +
+			    PLATFORM_GCM_TAG_SIZE;
+		break;
+	}
+
+	if (len_field) {
+		s->length = ((uint32_t)len_field[0] << 24) |
+			    ((uint32_t)len_field[1] << 16) |
+			    ((uint32_t)len_field[2] << 8) | len_field[3];
+		if (s->length != file_size - header_len) {
+			LOG(LOG_ERROR, "%s: stored length does not match\n",
+			    name);
+			goto err;
+		}
+	}
+
+	if (blob_stream_start(s, false) != 0)
+		goto err;
+
+	*length = s->length;
+	return s;
+
+err:
+	blob_stream_free(s);
+	return NULL;
+}
+
+/**
+ * Read n bytes of blob data from the file into buf and verify/decrypt them
+ * in place. n is a multiple of the AES block size unless it ends the data.
+ * @return 0 on success, -1 on error
+ */
+static int blob_stream_fill(sdo_blob_stream_t *s, uint8_t *buf, uint32_t n)
+{
+	if (fread(buf, 1, n, s->f) != n) {
+		LOG(LOG_ERROR, "Failed to read %s file!\n", s->name);
+		return -1;
+	}
+
+	if (s->mac)
+		return sdo_storage_hmac_update(s->mac, buf, n);
+	if (s->gcm)
+		return sdo_crypto_aes_gcm_update(s->gcm, buf, buf, n);
+	return 0;
+}
+
+/**
+ * sdo_blob_read_chunk Read the next part of a blob opened with
+ * sdo_blob_open_read().
+ * @param s - stream to read from
+ * @param buf - pointer to buffer receiving the data
+ * @param n_bytes - size of buf
+ * @return num of bytes read, 0 at the end of the data, -1 on error
+ */
+int32_t sdo_blob_read_chunk(sdo_blob_stream_t *s, uint8_t *buf,
+			    uint32_t n_bytes)
+{
+	uint32_t n = 0;
+	uint32_t done = 0;
+	uint32_t left = 0;
+	uint32_t aligned = 0;
+	uint32_t block = 0;
+
+	if (!s || s->tmp_name || !buf || n_bytes == 0) {
+		LOG(LOG_ERROR, "Invalid parameters in %s!\n", __func__);
+		return -1;
+	}
+	if (s->failed)
+		return -1;
+
+	left = s->length - s->offset;
+	n = (n_bytes < left) ? n_bytes : left;
+	if (n > INT32_MAX)
+		n = INT32_MAX;
+
+	/* hand out what was left over from the last AES block first */
+	if (s->carry_len) {
+		done = (n < s->carry_len) ? n : (uint32_t)s->carry_len;
+		if (memcpy_s(buf, n_bytes, s->carry + s->carry_off, done) != 0)
+			goto err;
+		s->carry_off += done;
+		s->carry_len -= done;
+	}
+
+	left = s->length - s->offset - done - (uint32_t)s->carry_len;
+	if (n - done >= left || !s->gcm) {
+		/* the rest of the data, or no block alignment needed */
+		aligned = (n - done < left) ? n - done : left;
+		if (aligned && blob_stream_fill(s, buf + done, aligned) != 0)
+			goto err;
+		done += aligned;
+	} else if (n > done) {
+		aligned = (n - done) & ~(uint32_t)(PLATFORM_AES_BLOCK_LEN - 1);
+		if (aligned && blob_stream_fill(s, buf + done, aligned) != 0)
+			goto err;
+		done += aligned;
+		left -= aligned;
+
+		if (n > done) {
+			/* decrypt one more block and keep what is not asked
+			 * for yet
+			 */
+			block = (left < PLATFORM_AES_BLOCK_LEN)
+				    ? left
+				    : PLATFORM_AES_BLOCK_LEN;
+			if (blob_stream_fill(s, s->carry, block) != 0 ||
+			    memcpy_s(buf + done, n_bytes - done, s->carry,
+				     n - done) != 0)
+				goto err;
+			s->carry_off = n - done;
+			s->carry_len = block - s->carry_off;
+			done = n;
+		}
+	}
+
+	s->offset += done;
+	return (int32_t)done;
+
+err:
+	s->failed = true;
+	return -1;
+}
+
+/**
+ * sdo_blob_open_write Open SDO blob(file) for writing in chunks, without
+ * the R_MAX_SIZE limit of sdo_blob_write(). The data goes to a temporary file
+ * that replaces the blob only when sdo_blob_close() succeeds.
+ * Note: SDO_SDK_OTP_DATA flag is not supported for this platform.
+ * @param name - pointer to the blob/file name
+ * @param flags - descriptor telling type of file
+ * @return stream on success, NULL on error
+ */
+sdo_blob_stream_t *sdo_blob_open_write(const char *name,
+				       sdo_sdk_blob_flags flags)
+{
+	sdo_blob_stream_t *s = NULL;
+	uint8_t header[BLOB_STREAM_HEADER_MAX] = {0};
+	size_t header_len = blob_header_size(flags);
+
+	s = blob_stream_alloc(name, flags);
+	if (!s)
+		return NULL;
+
+	s->tmp_name = blob_tmp_name(s->name);
+	if (!s->tmp_name)
+		goto err;
+
+	if (flags == SDO_SDK_SECURE_DATA &&
+	    !get_platform_iv(s->iv, PLATFORM_IV_DEFAULT_LEN, UINT32_MAX)) {
+		LOG(LOG_ERROR, "Could not get platform IV!\n");
+		goto err;
+	}
+
+	if (blob_stream_start(s, true) != 0)
+		goto err;
+
+	s->f = fopen(s->tmp_name, "wb");
+	if (!s->f) {
+		LOG(LOG_ERROR, "Could not open file: %s\n", s->tmp_name);
+		goto err;
+	}
+
+	/* the header is filled in on close */
+	if (header_len &&
+	    fwrite(header, 1, header_len, s->f) != header_len) {
+		LOG(LOG_ERROR, "file:%s not written properly\n", s->tmp_name);
+		goto err;
+	}
+	return s;
+
+err:
+	blob_stream_free(s);
+	return NULL;
+}
+
+/**
+ * Encrypt n bytes (a multiple of the AES block size unless it ends the data)
+ * through the stream chunk and write them out.
+ * @return 0 on success, -1 on error
+ */
+static int blob_stream_seal(sdo_blob_stream_t *s, const uint8_t *buf,
+			    uint32_t n)
+{
+	uint32_t part = 0;
+
+	while (n) {
+		part = (n < BLOB_STREAM_CHUNK_SIZE) ? n
+						    : BLOB_STREAM_CHUNK_SIZE;
+		if (sdo_crypto_aes_gcm_update(s->gcm, buf, s->chunk, part) !=
+			0 ||
+		    fwrite(s->chunk, 1, part, s->f) != part) {
+			LOG(LOG_ERROR, "file:%s not written properly\n",
+			    s->tmp_name);
+			return -1;
+		}
+		buf += part;
+		n -= part;
+	}
+	return 0;
+}
+
+/**
+ * sdo_blob_write_chunk Append data to a blob opened with
+ * sdo_blob_open_write().
+ * @param s - stream to write to
+ * @param buf - pointer to the data
+ * @param n_bytes - length of data(in bytes) to be written
+ * @return num of bytes written if success, -1 on error
+ */
+int32_t sdo_blob_write_chunk(sdo_blob_stream_t *s, const uint8_t *buf,
+			     uint32_t n_bytes)
+{
+	uint32_t n = 0;
+	uint32_t fill = 0;
+	uint32_t aligned = 0;
+
+	if (!s || !s->tmp_name || !buf || n_bytes == 0 ||
+	    n_bytes > INT32_MAX) {
+		LOG(LOG_ERROR, "Invalid parameters in %s!\n", __func__);
+		return -1;
+	}
+	if (s->failed)
+		return -1;
+
+	if (n_bytes > UINT32_MAX - s->length) {
+		LOG(LOG_ERROR, "%s: blob too large\n", s->name);
+		goto err;
+	}
+
+	if (!s->gcm) {
+		if (s->mac &&
+		    sdo_storage_hmac_update(s->mac, buf, n_bytes) != 0)
+			goto err;
+		if (fwrite(buf, 1, n_bytes, s->f) != n_bytes) {
+			LOG(LOG_ERROR, "file:%s not written properly\n",
+			    s->tmp_name);
+			goto err;
+		}
+		s->length += n_bytes;
+		return (int32_t)n_bytes;
+	}
+
+	/* top up the partial block left by the last call */
+	n = n_bytes;
+	if (s->carry_len) {
+		fill = PLATFORM_AES_BLOCK_LEN - (uint32_t)s->carry_len;
+		if (fill > n)
+			fill = n;
+		if (memcpy_s(s->carry + s->carry_len, fill, buf, fill) != 0)
+			goto err;
+		s->carry_len += fill;
+		buf += fill;
+		n -= fill;
+		if (s->carry_len < PLATFORM_AES_BLOCK_LEN)
+			goto done;
+		if (blob_stream_seal(s, s->carry, PLATFORM_AES_BLOCK_LEN) != 0)
+			goto err;
+		s->carry_len = 0;
+	}
+
+	aligned = n & ~(uint32_t)(PLATFORM_AES_BLOCK_LEN - 1);
+	if (blob_stream_seal(s, buf, aligned) != 0)
+		goto err;
+
+	if (n > aligned) {
+		if (memcpy_s(s->carry, PLATFORM_AES_BLOCK_LEN, buf + aligned,
+			     n - aligned) != 0)
+			goto err;
+		s->carry_len = n - aligned;
+	}
+
+done:
+	s->length += n_bytes;
+	return (int32_t)n_bytes;
+
+err:
+	s->failed = true;
+	return -1;
+}
+
+/**
+ * Finish a read stream: consume the data not read by the caller and check
+ * the stored HMAC or GCM tag.
+ * @return 0 on success, -1 on error
+ */
+static int blob_stream_verify(sdo_blob_stream_t *s)
+{
+	uint8_t computed_hmac[PLATFORM_HMAC_SIZE] = {0};
+	uint32_t left = s->length - s->offset - (uint32_t)s->carry_len;
+	uint32_t part = 0;
+	int result = 1;
+	int ret = -1;
+
+	while (left) {
+		part = (left < BLOB_STREAM_CHUNK_SIZE) ? left
+						       : BLOB_STREAM_CHUNK_SIZE;
+		if (blob_stream_fill(s, s->chunk, part) != 0)
+			return -1;
+		left -= part;
+	}
+
+	if (s->gcm) {
+		ret = sdo_crypto_aes_gcm_end(s->gcm, s->seal, AES_GCM_TAG_LEN);
+		s->gcm = NULL;
+	} else if (s->mac) {
+		ret = sdo_storage_hmac_end(s->mac, computed_hmac,
+					   PLATFORM_HMAC_SIZE);
+		s->mac = NULL;
+		if (ret == 0 &&
+		    (memcmp_s(s->seal, PLATFORM_HMAC_SIZE, computed_hmac,
+			      PLATFORM_HMAC_SIZE, &result) != 0 ||
+		     result != 0))
+			ret = -1;
+	} else {
+		ret = 0;
+	}
+
+	if (ret != 0)
+		LOG(LOG_ERROR, "%s: blob authentication failed!\n", s->name);
+	return ret;
+}
+
+/**
+ * Finish a write stream: seal the data, fill in the header and move the
+ * temporary file over the blob.
+ * @return 0 on success, -1 on error
+ */
+static int blob_stream_commit(sdo_blob_stream_t *s)
+{
+	uint8_t header[BLOB_STREAM_HEADER_MAX] = {0};
+	size_t header_len = blob_header_size(s->flags);
+	uint8_t *len_field = NULL;
+	int ret = -1;
+
+	if (s->gcm) {
+		if (blob_stream_seal(s, s->carry, (uint32_t)s->carry_len) != 0)
+			return -1;
+		s->carry_len = 0;
+		ret = sdo_crypto_aes_gcm_end(s->gcm,
+					     header + PLATFORM_IV_DEFAULT_LEN,
+					     AES_GCM_TAG_LEN);
+		s->gcm = NULL;
+		if (ret != 0 || memcpy_s(header, PLATFORM_IV_DEFAULT_LEN, s->iv,
+					 PLATFORM_IV_DEFAULT_LEN) != 0)
+			return -1;
+		len_field = header + PLATFORM_IV_DEFAULT_LEN +
+			    PLATFORM_GCM_TAG_SIZE;
+	} else if (s->mac) {
+		ret = sdo_storage_hmac_end(s->mac, header, PLATFORM_HMAC_SIZE);
+		s->mac = NULL;
+		if (ret != 0)
+			return -1;
+		len_field = header + PLATFORM_HMAC_SIZE;
+	}
+
+	if (len_field) {
+		len_field[0] = s->length >> 24;
+		len_field[1] = s->length >> 16;
+		len_field[2] = s->length >> 8;
+		len_field[3] = s->length >> 0;
+		if (fseek(s->f, 0, SEEK_SET) != 0 ||
+		    fwrite(header, 1, header_len, s->f) != header_len) {
+			LOG(LOG_ERROR, "file:%s not written properly\n",
+			    s->tmp_name);
+			return -1;
+		}
+	}
+
+	if (fflush(s->f) != 0 || fdatasync(fileno(s->f)) != 0) {
+		LOG(LOG_ERROR, "file:%s not written properly\n", s->tmp_name);
+		return -1;
+	}
+	ret = fclose(s->f);
+	s->f = NULL;
+	if (ret == EOF) {
+		LOG(LOG_ERROR, "fclose() Failed in %s\n", __func__);
+		return -1;
+	}
+
+	if (publish_blob_file(s->tmp_name, s->name) != 0)
+		return -1;
+	sdo_free(s->tmp_name);
+	return 0;
+}
+
+/**
+ * sdo_blob_close Close a blob stream. For a read stream this authenticates
+ * all of the blob data, whether it was read or not; for a write stream it
+ * stores the blob, replacing the previous one.
+ * @param s - stream to close
+ * @return 0 on success, -1 on error (the data read must then be discarded,
+ * or the previous blob was kept)
+ */
+int32_t sdo_blob_close(sdo_blob_stream_t *s)
+{
+	int32_t ret = -1;
+
+	if (!s) {
+		LOG(LOG_ERROR, "Invalid parameters in %s!\n", __func__);
+		return -1;
+	}
+
+	if (!s->failed)
+		ret = s->tmp_name ? blob_stream_commit(s)
+				  : blob_stream_verify(s);
+
+	blob_stream_free(s);
+	return ret;
+}
+
+/**
+ * sdo_blob_abort Close a blob stream without finishing it. A blob being
+ * written keeps its previous contents.
+ * @param s - stream to abort
+ */
+void sdo_blob_abort(sdo_blob_stream_t *s)
+{
+	if (s)
+		blob_stream_free(s);
+}
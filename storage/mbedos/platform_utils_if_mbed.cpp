@@ -213,3 +213,31 @@ bool get_platform_hmac_key(uint8_t *key, size_t len)
 end:
 	return retval;
 }
+
+/**
+ * The mbed OS target has no swap to keep the platform keys out of, so keys
+ * are read from the SD card on every use and there is no keyring to load.
+ *
+ * @retval true always.
+ */
+bool platform_keyring_init(void)
+{
+	return true;
+}
+
+/**
+ * Nothing to release on mbed OS, see platform_keyring_init().
+ */
+void platform_keyring_close(void)
+{
+}
+
+/**
+ * Nothing is cached on mbed OS, see platform_keyring_init().
+ *
+ * @param name - path of the file that was written.
+ */
+void platform_keyring_drop(const char *name)
+{
+	(void)name;
+}
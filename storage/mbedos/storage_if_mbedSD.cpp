@@ -571,3 +571,97 @@ exit:
 	}
 	return retval;
 }
+
+/**
+ * sdo_blob_open_read Chunked blob access is not supported on this platform;
+ * blobs are limited to R_MAX_SIZE.
+ * @return NULL always
+ */
+sdo_blob_stream_t *sdo_blob_open_read(const char *name,
+				      sdo_sdk_blob_flags flags,
+				      uint32_t *length)
+{
+	(void)name;
+	(void)flags;
+	(void)length;
+	LOG(LOG_ERROR, "Blob streams are not supported\n");
+	return NULL;
+}
+
+/**
+ * sdo_blob_open_write Chunked blob access is not supported on this platform.
+ * @return NULL always
+ */
+sdo_blob_stream_t *sdo_blob_open_write(const char *name,
+				       sdo_sdk_blob_flags flags)
+{
+	(void)name;
+	(void)flags;
+	LOG(LOG_ERROR, "Blob streams are not supported\n");
+	return NULL;
+}
+
+/**
+ * sdo_blob_read_chunk See sdo_blob_open_read().
+ * @return -1 always
+ */
+int32_t sdo_blob_read_chunk(sdo_blob_stream_t *s, uint8_t *buf,
+			    uint32_t n_bytes)
+{
+	(void)s;
+	(void)buf;
+	(void)n_bytes;
+	return -1;
+}
+
+/**
+ * sdo_blob_write_chunk See sdo_blob_open_write().
+ * @return -1 always
+ */
+int32_t sdo_blob_write_chunk(sdo_blob_stream_t *s, const uint8_t *buf,
+			     uint32_t n_bytes)
+{
+	(void)s;
+	(void)buf;
+	(void)n_bytes;
+	return -1;
+}
+
+/**
+ * sdo_blob_close See sdo_blob_open_read().
+ * @return -1 always
+ */
+int32_t sdo_blob_close(sdo_blob_stream_t *s)
+{
+	(void)s;
+	return -1;
+}
+
+/**
+ * sdo_blob_abort See sdo_blob_open_read().
+ */
+void sdo_blob_abort(sdo_blob_stream_t *s)
+{
+	(void)s;
+}
+
+/**
+ * sdo_blob_batch_begin Start a group of blob writes. Blobs are separate
+ * files on the SD card and are written immediately.
+ * @return 0 always
+ */
+int32_t sdo_blob_batch_begin(void)
+{
+	return 0;
+}
+
+/**
+ * sdo_blob_batch_end End a group of blob writes, see sdo_blob_batch_begin().
+ * @param commit - ignored
+ * @return 0 always
+ */
+int32_t sdo_blob_batch_end(bool commit)
+{
+	(void)commit;
+	return 0;
+}
@@ -9,6 +9,8 @@
  */
 
 #include "util.h"
+#include "sdolog.h"
+#include "sdoheap.h"
 #include "network_al.h"
 #include <stdlib.h>
 #include <ctype.h>
@@ -147,6 +149,10 @@ void print_buffer(int log_level, const uint8_t *buffer, size_t length)
  */
 void hexdump(const char *message, const void *buffer, size_t size)
 {
+#ifdef LOG_RING_ENABLED
+	/* One log record per 13 lines rather than one per byte printed */
+	sdo_log_record_hex(LOG_DEBUGNTS, message, buffer, size);
+#else
 	size_t bytes_per_group = 1;
 	size_t groups_per_line = 16;
 	unsigned char *bytes = (unsigned char *)buffer;
@@ -243,6 +249,7 @@ void hexdump(const char *message, const void *buffer, size_t size)
 		line_offset += bytes_per_line;
 	}
 	LOG(LOG_DEBUGNTS, "\n");
+#endif
 }
 
 /**
@@ -263,9 +270,31 @@ void *sdo_alloc(int size)
 		goto end;
 	}
 
+#ifdef HEAP_TRACK_ENABLED
+	/* Refused if it takes the SDK past its heap budget */
+	if (!sdo_heap_track(buf, size, __builtin_return_address(0))) {
+		free(buf);
+		buf = NULL;
+	}
+#endif
+
 end:
 	return buf;
 }
+
+/**
+ * Internal API
+ * realloc() of a buffer from sdo_alloc(), to be freed with sdo_free().
+ */
+void *sdo_realloc(void *buf, int size)
+{
+#ifdef HEAP_TRACK_ENABLED
+	return sdo_heap_realloc(buf, size, __builtin_return_address(0));
+#else
+	return realloc(buf, size);
+#endif
+}
+
 /**
  * Internal API
  */
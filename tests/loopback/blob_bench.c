@@ -0,0 +1,542 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Blob write latency benchmark and crash-injection harness.
+ *
+ * The benchmark times sdo_blob_write() for every blob type and for a batch
+ * shaped like store_credential() (two Normal blobs and a Secure one).
+ *
+ * The crash mode (-c) checks that blob updates are atomic. A child process
+ * rewrites the batch and dies at a chosen point: half way through a write(),
+ * before fdatasync(), before each rename() or before the directory fsync()
+ * (the syscalls are wrapped at link time), or at a random moment through
+ * SIGKILL. The parent then checks that every blob is intact and holds
+ * either the old or the new contents, in the order the batch moves them into
+ * place. Killing the process does not drop the page cache, so this checks
+ * atomicity; durability across power loss is left to the syncs.
+ */
+
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "storage_al.h"
+#include "sdoCrypto.h"
+#include "sdoCryptoHal.h"
+#include "util.h"
+#include "safe_lib.h"
+
+#define BLOB_BENCH_COUNT 3
+#define BLOB_BENCH_MAX_SIZE R_MAX_SIZE
+#define BLOB_CRASH_EXIT 42
+
+typedef enum {
+	CRASH_NONE,
+	CRASH_WRITE,
+	CRASH_FDATASYNC,
+	CRASH_RENAME,
+	CRASH_FSYNC
+} crash_op_t;
+
+typedef struct {
+	crash_op_t op;
+	int nth; /* crash on the nth call of op */
+	int renamed; /* blobs that must hold the new contents afterwards */
+} crash_point_t;
+
+typedef struct {
+	const char *path;
+	char *data;
+	size_t len;
+} saved_file_t;
+
+static const sdo_sdk_blob_flags blob_flags[BLOB_BENCH_COUNT] = {
+    SDO_SDK_NORMAL_DATA, SDO_SDK_NORMAL_DATA, SDO_SDK_SECURE_DATA};
+static char blob_names[BLOB_BENCH_COUNT][SDO_MAX_STR_SIZE];
+static uint32_t blob_size = 2048;
+static uint8_t *blob_buf;
+
+static struct stat blob_dir_st;
+static crash_op_t crash_op = CRASH_NONE;
+static int crash_nth;
+static int crash_calls;
+
+/*==================================================================*/
+/* Crash injection, the storage layer links against these */
+
+ssize_t __real_write(int fd, const void *buf, size_t n);
+int __real_fdatasync(int fd);
+int __real_rename(const char *from, const char *to);
+int __real_fsync(int fd);
+ssize_t __wrap_write(int fd, const void *buf, size_t n);
+int __wrap_fdatasync(int fd);
+int __wrap_rename(const char *from, const char *to);
+int __wrap_fsync(int fd);
+
+static bool crash_due(crash_op_t op)
+{
+	return crash_op == op && ++crash_calls == crash_nth;
+}
+
+/*
+ * The platform IV file is replaced the same way as a blob, whenever its
+ * lease runs out; only the calls made for the blobs count.
+ */
+static bool crash_blob_fd(int fd)
+{
+	char link[32], path[PATH_MAX];
+	ssize_t n;
+
+	if (snprintf(link, sizeof(link), "/proc/self/fd/%d", fd) >=
+	    (int)sizeof(link))
+		return false;
+	n = readlink(link, path, sizeof(path) - 1);
+	if (n < 0)
+		return false;
+	path[n] = '\0';
+	return strstr(path, ".blob") != NULL;
+}
+
+ssize_t __wrap_write(int fd, const void *buf, size_t n)
+{
+	if (crash_op == CRASH_WRITE && crash_blob_fd(fd) &&
+	    crash_due(CRASH_WRITE)) {
+		/* torn write */
+		(void)__real_write(fd, buf, n / 2);
+		_exit(BLOB_CRASH_EXIT);
+	}
+	return __real_write(fd, buf, n);
+}
+
+int __wrap_fdatasync(int fd)
+{
+	if (crash_op == CRASH_FDATASYNC && crash_blob_fd(fd) &&
+	    crash_due(CRASH_FDATASYNC))
+		_exit(BLOB_CRASH_EXIT);
+	return __real_fdatasync(fd);
+}
+
+int __wrap_rename(const char *from, const char *to)
+{
+	if (strstr(to, ".blob") && crash_due(CRASH_RENAME))
+		_exit(BLOB_CRASH_EXIT);
+	return __real_rename(from, to);
+}
+
+/* Only the directory of the blobs counts */
+int __wrap_fsync(int fd)
+{
+	struct stat st;
+
+	if (fstat(fd, &st) == 0 && S_ISDIR(st.st_mode) &&
+	    st.st_dev == blob_dir_st.st_dev &&
+	    st.st_ino == blob_dir_st.st_ino && crash_due(CRASH_FSYNC))
+		_exit(BLOB_CRASH_EXIT);
+	return __real_fsync(fd);
+}
+
+/*==================================================================*/
+/* Blobs */
+
+static uint64_t bench_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/* Contents of blob i in generation gen: the generation, then a pattern */
+static void blob_fill(uint8_t *buf, int i, uint32_t gen)
+{
+	uint32_t k;
+
+	buf[0] = gen >> 24;
+	buf[1] = gen >> 16;
+	buf[2] = gen >> 8;
+	buf[3] = gen;
+	for (k = 4; k < blob_size; k++)
+		buf[k] = (uint8_t)(k * 7 + gen * 13 + i);
+}
+
+/* Generation held by blob i, -1 if it cannot be read or is corrupt */
+static int64_t blob_check(int i)
+{
+	uint8_t *expect = blob_buf + blob_size;
+	uint32_t gen;
+
+	if (sdo_blob_read(blob_names[i], blob_flags[i], blob_buf, blob_size) !=
+	    (int32_t)blob_size)
+		return -1;
+	gen = ((uint32_t)blob_buf[0] << 24) | ((uint32_t)blob_buf[1] << 16) |
+	      ((uint32_t)blob_buf[2] << 8) | blob_buf[3];
+	blob_fill(expect, i, gen);
+	if (memcmp(blob_buf, expect, blob_size) != 0)
+		return -1;
+	return gen;
+}
+
+/* Rewrite all blobs with generation gen in one batch */
+static bool blob_store(uint32_t gen)
+{
+	int i;
+
+	if (sdo_blob_batch_begin() != 0)
+		return false;
+	for (i = 0; i < BLOB_BENCH_COUNT; i++) {
+		blob_fill(blob_buf, i, gen);
+		if (sdo_blob_write(blob_names[i], blob_flags[i], blob_buf,
+				   blob_size) != (int32_t)blob_size) {
+			(void)sdo_blob_batch_end(false);
+			return false;
+		}
+	}
+	return sdo_blob_batch_end(true) == 0;
+}
+
+/*==================================================================*/
+/* Latency */
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void bench_report(const char *name, uint64_t *us, uint32_t n)
+{
+	uint64_t total = 0;
+	uint32_t k;
+
+	qsort(us, n, sizeof(*us), cmp_u64);
+	for (k = 0; k < n; k++)
+		total += us[k];
+	printf("%-10s %7u %9.3f ms %9.3f ms %9.3f ms %9.3f ms\n", name, n,
+	       total / 1000.0 / n, us[n / 2] / 1000.0,
+	       us[(n * 99) / 100] / 1000.0, us[n - 1] / 1000.0);
+}
+
+static bool bench_latency(uint32_t iterations)
+{
+	static const struct {
+		const char *name;
+		sdo_sdk_blob_flags flags;
+	} types[] = {{"raw", SDO_SDK_RAW_DATA},
+		     {"normal", SDO_SDK_NORMAL_DATA},
+		     {"secure", SDO_SDK_SECURE_DATA}};
+	uint64_t *us = calloc(iterations, sizeof(*us));
+	uint64_t t0;
+	uint32_t k;
+	size_t t;
+
+	if (!us)
+		return false;
+
+	printf("%u byte blobs\n%-10s %7s %12s %12s %12s %12s\n", blob_size,
+	       "write", "count", "avg", "p50", "p99", "max");
+	for (t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+		for (k = 0; k < iterations; k++) {
+			blob_fill(blob_buf, 0, k);
+			t0 = bench_now_us();
+			if (sdo_blob_write(blob_names[0], types[t].flags,
+					   blob_buf, blob_size) !=
+			    (int32_t)blob_size) {
+				fprintf(stderr, "bench: %s write failed\n",
+					types[t].name);
+				free(us);
+				return false;
+			}
+			us[k] = bench_now_us() - t0;
+		}
+		bench_report(types[t].name, us, iterations);
+	}
+
+	for (k = 0; k < iterations; k++) {
+		t0 = bench_now_us();
+		if (!blob_store(k)) {
+			fprintf(stderr, "bench: batch write failed\n");
+			free(us);
+			return false;
+		}
+		us[k] = bench_now_us() - t0;
+	}
+	bench_report("batch", us, iterations);
+	free(us);
+	return true;
+}
+
+/*==================================================================*/
+/* Crash injection */
+
+/* Run blob_store(gen) in a child, dying as cp says; false on harness error */
+static bool crash_child(const crash_point_t *cp, uint32_t gen,
+			uint32_t kill_us)
+{
+	pid_t pid;
+	int status;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		return false;
+	if (pid == 0) {
+		crash_op = cp ? cp->op : CRASH_NONE;
+		crash_nth = cp ? cp->nth : 0;
+		crash_calls = 0;
+		/* without a crash point, keep writing until killed */
+		do {
+			if (!blob_store(gen++))
+				_exit(1);
+		} while (!cp);
+		_exit(0);
+	}
+
+	if (!cp) {
+		usleep(kill_us);
+		kill(pid, SIGKILL);
+	}
+	if (waitpid(pid, &status, 0) != pid)
+		return false;
+	if (cp)
+		return WIFEXITED(status) &&
+		       (WEXITSTATUS(status) == BLOB_CRASH_EXIT ||
+			WEXITSTATUS(status) == 0);
+	return (WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL) ||
+	       (WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+/*
+ * Check the blobs after an interrupted update from generation gen. Blobs
+ * are moved into place in order, so the generations never go up from one
+ * blob to the next and differ by at most one. renamed >= 0 is the exact
+ * number of blobs expected to hold gen + 1.
+ */
+static bool crash_verify(uint32_t gen, int renamed, uint32_t *latest)
+{
+	int64_t g[BLOB_BENCH_COUNT];
+	int i;
+
+	for (i = 0; i < BLOB_BENCH_COUNT; i++) {
+		g[i] = blob_check(i);
+		if (g[i] < 0) {
+			fprintf(stderr, "crash: %s is corrupt\n",
+				blob_names[i]);
+			return false;
+		}
+		if (renamed >= 0 && g[i] != gen + (i < renamed)) {
+			fprintf(stderr,
+				"crash: %s holds generation %lld, "
+				"expected %u\n",
+				blob_names[i], (long long)g[i],
+				gen + (i < renamed));
+			return false;
+		}
+		if (g[i] < gen || (i && (g[i] > g[i - 1] ||
+					 g[i - 1] - g[i] > 1))) {
+			fprintf(stderr, "crash: blob generations out of "
+					"order\n");
+			return false;
+		}
+	}
+	/* the next update starts from the oldest blob */
+	*latest = (uint32_t)g[BLOB_BENCH_COUNT - 1];
+	return true;
+}
+
+static bool crash_test(uint32_t rounds, unsigned int seed)
+{
+	static const crash_point_t points[] = {
+	    {CRASH_WRITE, 1, 0},     {CRASH_WRITE, 3, 0},
+	    {CRASH_FDATASYNC, 1, 0}, {CRASH_FDATASYNC, 3, 0},
+	    {CRASH_RENAME, 1, 0},    {CRASH_RENAME, 2, 1},
+	    {CRASH_RENAME, 3, 2},    {CRASH_FSYNC, 1, 3},
+	    {CRASH_NONE, 0, 3}};
+	uint32_t gen, k, window;
+	uint64_t t0 = bench_now_us();
+	size_t p;
+
+	for (k = 0; k < 3; k++)
+		if (!blob_store(k))
+			return false;
+	gen = k - 1;
+	/* kill anywhere within the first few updates */
+	window = (uint32_t)(bench_now_us() - t0) + 1;
+
+	for (p = 0; p < sizeof(points) / sizeof(points[0]); p++) {
+		if (!crash_child(&points[p], gen + 1, 0) ||
+		    !crash_verify(gen, points[p].renamed, &gen)) {
+			fprintf(stderr, "crash: failed at point %zu\n", p);
+			return false;
+		}
+	}
+	printf("crash points: %zu passed\n", p);
+
+	srand(seed);
+	for (k = 0; k < rounds; k++) {
+		if (!crash_child(NULL, gen + 1, (uint32_t)rand() % window) ||
+		    !crash_verify(gen, -1, &gen)) {
+			fprintf(stderr, "crash: failed in round %u\n", k);
+			return false;
+		}
+	}
+	printf("random kills: %u passed, generation %u\n", rounds, gen);
+	return true;
+}
+
+/*==================================================================*/
+
+static void bench_usage(const char *prog)
+{
+	printf("Usage: %s [options]\n"
+	       "  -n N    write iterations (default 100)\n"
+	       "  -b N    blob size in bytes (default 2048)\n"
+	       "  -d DIR  directory for the blobs (default .)\n"
+	       "  -c      crash-injection test instead of the benchmark\n"
+	       "  -r N    random kills in the crash test (default 50)\n"
+	       "  -s N    seed for the random kills (default 1)\n",
+	       prog);
+}
+
+/* Remember a platform file so it can be put back afterwards */
+static void save_file(saved_file_t *f, const char *path)
+{
+	FILE *fp = fopen(path, "rb");
+	long sz;
+
+	f->path = path;
+	f->data = NULL;
+	f->len = 0;
+	if (!fp)
+		return;
+	if (fseek(fp, 0, SEEK_END) == 0 && (sz = ftell(fp)) >= 0 &&
+	    fseek(fp, 0, SEEK_SET) == 0) {
+		f->data = malloc((size_t)sz + 1);
+		if (f->data && fread(f->data, 1, (size_t)sz, fp) == (size_t)sz)
+			f->len = (size_t)sz;
+	}
+	fclose(fp);
+}
+
+static void restore_file(saved_file_t *f)
+{
+	FILE *fp;
+
+	if (!f->data) {
+		remove(f->path);
+		return;
+	}
+	fp = fopen(f->path, "wb");
+	if (fp) {
+		(void)fwrite(f->data, 1, f->len, fp);
+		fclose(fp);
+	}
+	free(f->data);
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = ".";
+	uint32_t iterations = 100, rounds = 50, seed = 1;
+	saved_file_t saved[2];
+	bool crash = false, ok = false;
+	unsigned long v = 0;
+	char *end = NULL;
+	FILE *fp;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "n:b:d:cr:s:h")) != -1) {
+		if (opt == 'c') {
+			crash = true;
+			continue;
+		}
+		if (opt == 'd') {
+			dir = optarg;
+			continue;
+		}
+		if (opt == 'h' || !optarg) {
+			bench_usage(argv[0]);
+			return 2;
+		}
+		v = strtoul(optarg, &end, 10);
+		if (*end || !v || v > UINT32_MAX) {
+			bench_usage(argv[0]);
+			return 2;
+		}
+		switch (opt) {
+		case 'n':
+			iterations = (uint32_t)v;
+			break;
+		case 'b':
+			blob_size = (uint32_t)v;
+			break;
+		case 'r':
+			rounds = (uint32_t)v;
+			break;
+		case 's':
+			seed = (uint32_t)v;
+			break;
+		default:
+			bench_usage(argv[0]);
+			return 2;
+		}
+	}
+	if (blob_size < 4 || blob_size > BLOB_BENCH_MAX_SIZE) {
+		fprintf(stderr, "bench: parameters out of range\n");
+		return 2;
+	}
+
+	if (stat(dir, &blob_dir_st) != 0) {
+		fprintf(stderr, "bench: no directory %s\n", dir);
+		return 2;
+	}
+	for (i = 0; i < BLOB_BENCH_COUNT; i++) {
+		if (snprintf(blob_names[i], sizeof(blob_names[i]),
+			     "%s/bench%d.blob", dir, i) >=
+		    (int)sizeof(blob_names[i]))
+			return 2;
+	}
+	blob_buf = malloc(2 * (size_t)blob_size);
+	if (!blob_buf)
+		return 1;
+
+	/*
+	 * Blobs are sealed with the platform keys, leave them as found. The
+	 * platform IV only ever moves forward and is not put back.
+	 */
+	save_file(&saved[0], PLATFORM_AES_KEY);
+	save_file(&saved[1], PLATFORM_HMAC_KEY);
+	fp = fopen(PLATFORM_AES_KEY, "ab");
+	if (fp)
+		fclose(fp);
+	fp = fopen(PLATFORM_IV, "ab");
+	if (fp)
+		fclose(fp);
+	if (random_init() != 0 || (!saved[1].len &&
+				   sdo_generate_storage_hmac_key() != 0)) {
+		fprintf(stderr, "bench: cannot set up platform keys\n");
+		goto end;
+	}
+
+	ok = crash ? crash_test(rounds, seed) : bench_latency(iterations);
+	random_close();
+
+end:
+	for (i = 0; i < BLOB_BENCH_COUNT; i++)
+		remove(blob_names[i]);
+	for (i = 0; i < 2; i++)
+		restore_file(&saved[i]);
+	free(blob_buf);
+	printf("\n%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
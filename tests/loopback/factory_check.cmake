@@ -0,0 +1,69 @@
+#
+# Copyright 2020 Intel Corporation
+# SPDX-License-Identifier: Apache 2.0
+#
+
+###################################################
+# sdo-factory smoke test, run with cmake -P
+#
+# Generates DEVICES devices numbered from FIRST into OUT and checks that
+# there is one directory per serial number, in sequence, each holding the
+# five files of a device and the serial number in its m-string.
+#
+#   -DFACTORY=<sdo-factory> -DOUT=<dir> -DDEVICES=<n> -DFIRST=<n>
+#   -DPREFIX=<serial prefix>
+
+file(REMOVE_RECURSE ${OUT})
+execute_process(
+  COMMAND ${FACTORY} -o ${OUT} -n ${DEVICES} -j 4 -f ${FIRST} -s ${PREFIX}
+  RESULT_VARIABLE result
+  )
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "sdo-factory failed: ${result}")
+endif()
+
+# key, serial and model number under data/, CSR and m-string
+file(GLOB_RECURSE files ${OUT}/*)
+list(LENGTH files count)
+math(EXPR expected "${DEVICES} * 5")
+if (NOT count EQUAL expected)
+  message(FATAL_ERROR "${count} files, expected ${expected}")
+endif()
+
+file(GLOB dirs RELATIVE ${OUT} ${OUT}/*)
+list(LENGTH dirs count)
+if (NOT count EQUAL DEVICES)
+  message(FATAL_ERROR "${count} device directories, expected ${DEVICES}")
+endif()
+
+math(EXPR last "${FIRST} + ${DEVICES} - 1")
+foreach (idx RANGE ${FIRST} ${last})
+  # PREFIX followed by the device number in 8 digits
+  set(number "0000000${idx}")
+  string(LENGTH ${number} len)
+  math(EXPR start "${len} - 8")
+  string(SUBSTRING ${number} ${start} 8 number)
+  set(serial ${PREFIX}${number})
+  set(dev ${OUT}/${serial})
+
+  foreach (name csr.pem m_string.bin data/manufacturer_sn.bin
+      data/manufacturer_mod.bin)
+    if (NOT EXISTS ${dev}/${name})
+      message(FATAL_ERROR "${dev}/${name} is missing")
+    endif()
+  endforeach()
+
+  file(READ ${dev}/data/manufacturer_sn.bin stored)
+  if (NOT stored STREQUAL serial)
+    message(FATAL_ERROR "${dev}: serial number is '${stored}'")
+  endif()
+
+  file(READ ${dev}/m_string.bin m_string HEX)
+  string(HEX ${serial} serial_hex)
+  string(FIND ${m_string} "00${serial_hex}00" pos)
+  if (pos EQUAL -1)
+    message(FATAL_ERROR "${dev}: serial number not in the m-string")
+  endif()
+endforeach()
+
+message(STATUS "sdo-factory: ${DEVICES} devices checked")
@@ -0,0 +1,1423 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Minimal manufacturer, rendezvous and owner servers speaking the SDO
+ * REST/JSON protocol over loopback (DI 10-13, TO1 30-33, TO2 40-51).
+ *
+ * The servers build every JSON body as text, so what is signed, hashed or
+ * MACed is byte for byte what goes on the wire. They implement just enough of
+ * the owner side to drive the device through ECDH/AES-CTR TO2: device
+ * signatures (msg32, msg44) are not verified, and there is no persistence.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/ecdsa.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#include <openssl/x509.h>
+#include "loopback_server.h"
+
+#define LB_HASH_LEN 32
+#define LB_GUID_LEN 16
+#define LB_NONCE_LEN 16
+#define LB_SEK_LEN 16
+#define LB_SVK_LEN 32
+#define LB_IV_LEN 16
+#define LB_OWNER_RANDOM_LEN 16
+#define LB_MAX_REQUEST (64 * 1024)
+#define LB_MAX_HEADER 2048
+#define LB_DEVINFO "loopback-device"
+
+#define LB_HASH_SHA256 8
+#define LB_PK_ECDSAP256 13
+#define LB_PK_X509 1
+#define LB_PK_NULL "[0,0,[0]]"
+#define LB_ENC_NONE "[13,0,\"\"]"
+
+#define LB_MSG_ERROR 255
+
+enum { LB_MFG, LB_RV, LB_OWNER, LB_NUM_SERVERS };
+
+typedef struct {
+	char *data;
+	size_t len;
+	size_t cap;
+} lb_buf_t;
+
+typedef struct {
+	const char *p;
+	size_t n;
+} lb_span_t;
+
+typedef struct {
+	EC_KEY *key;
+	uint8_t *der;
+	int der_len;
+} lb_key_t;
+
+typedef struct {
+	int fd;
+	uint16_t port;
+	int first_msg;
+	int last_msg;
+	pthread_t thread;
+	bool running;
+} lb_listener_t;
+
+typedef bool (*lb_handler_t)(const char *body, size_t len, lb_buf_t *out);
+
+static struct {
+	lb_config_t cfg;
+	volatile bool stop;
+	pthread_mutex_t lock;
+	lb_listener_t srv[LB_NUM_SERVERS];
+	unsigned int rand_state;
+
+	/* Keys: mfg signs the header, entries chain to the owner key */
+	lb_key_t mfg;
+	lb_key_t owner;
+	lb_key_t *chain;
+
+	/* Ownership voucher, fixed once DI is done */
+	uint8_t guid[LB_GUID_LEN];
+	lb_buf_t rvlist;
+	lb_buf_t guid_txt;
+	lb_buf_t oh;
+	lb_buf_t hmac;
+	lb_buf_t *entries;
+	bool voucher_ready;
+
+	/* TO2 session */
+	lb_buf_t n5;
+	lb_buf_t n7;
+	uint8_t n6[LB_NONCE_LEN];
+	EC_KEY *xkey;
+	uint8_t owner_random[LB_OWNER_RANDOM_LEN];
+	uint8_t sek[LB_SEK_LEN];
+	uint8_t svk[LB_SVK_LEN];
+	uint32_t dsi_rounds;
+
+	lb_stats_t stats;
+	uint64_t last_reply_us;
+} lb;
+
+/**
+ * Internal API
+ */
+static uint64_t lb_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/*==================================================================*/
+/* Text buffer */
+
+/**
+ * Internal API
+ */
+static bool lb_reserve(lb_buf_t *b, size_t extra)
+{
+	size_t cap = b->cap ? b->cap : 256;
+	char *p;
+
+	if (b->len + extra + 1 <= b->cap)
+		return true;
+	while (cap < b->len + extra + 1)
+		cap *= 2;
+	p = realloc(b->data, cap);
+	if (!p)
+		return false;
+	b->data = p;
+	b->cap = cap;
+	return true;
+}
+
+/**
+ * Internal API
+ */
+static bool lb_put(lb_buf_t *b, const char *s, size_t n)
+{
+	if (!lb_reserve(b, n))
+		return false;
+	memcpy(b->data + b->len, s, n);
+	b->len += n;
+	b->data[b->len] = '\0';
+	return true;
+}
+
+/**
+ * Internal API
+ */
+static bool lb_puts(lb_buf_t *b, const char *s)
+{
+	return lb_put(b, s, strlen(s));
+}
+
+/**
+ * Internal API
+ */
+static bool lb_put_buf(lb_buf_t *b, const lb_buf_t *src)
+{
+	return lb_put(b, src->data, src->len);
+}
+
+/**
+ * Internal API
+ */
+static bool lb_printf(lb_buf_t *b, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+static bool lb_printf(lb_buf_t *b, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	if (n < 0 || !lb_reserve(b, (size_t)n))
+		return false;
+	va_start(ap, fmt);
+	vsnprintf(b->data + b->len, (size_t)n + 1, fmt, ap);
+	va_end(ap);
+	b->len += (size_t)n;
+	return true;
+}
+
+/**
+ * Internal API
+ */
+static void lb_reset(lb_buf_t *b)
+{
+	b->len = 0;
+	if (b->data)
+		b->data[0] = '\0';
+}
+
+/**
+ * Internal API
+ */
+static void lb_buf_free(lb_buf_t *b)
+{
+	free(b->data);
+	b->data = NULL;
+	b->len = 0;
+	b->cap = 0;
+}
+
+/**
+ * Internal API
+ * Append the base64 encoding of bin (no quotes).
+ */
+static bool lb_put_b64(lb_buf_t *b, const uint8_t *bin, size_t len)
+{
+	size_t n = 4 * ((len + 2) / 3);
+
+	if (!lb_reserve(b, n))
+		return false;
+	EVP_EncodeBlock((unsigned char *)b->data + b->len, bin, (int)len);
+	b->len += n;
+	b->data[b->len] = '\0';
+	return true;
+}
+
+/**
+ * Internal API
+ * ByteArray: [len,"b64"]
+ */
+static bool lb_put_bytes(lb_buf_t *b, const uint8_t *bin, size_t len)
+{
+	return lb_printf(b, "[%zu,\"", len) && lb_put_b64(b, bin, len) &&
+	       lb_puts(b, "\"]");
+}
+
+/**
+ * Internal API
+ * Hash: [len,type,"b64"]
+ */
+static bool lb_put_hash(lb_buf_t *b, const uint8_t *hash)
+{
+	return lb_printf(b, "[%d,%d,\"", LB_HASH_LEN, LB_HASH_SHA256) &&
+	       lb_put_b64(b, hash, LB_HASH_LEN) && lb_puts(b, "\"]");
+}
+
+/**
+ * Internal API
+ * PublicKey: [algo,encoding,[len,"b64 DER"]]
+ */
+static bool lb_put_pubkey(lb_buf_t *b, const lb_key_t *k)
+{
+	return lb_printf(b, "[%d,%d,", LB_PK_ECDSAP256, LB_PK_X509) &&
+	       lb_put_bytes(b, k->der, (size_t)k->der_len) && lb_puts(b, "]");
+}
+
+/*==================================================================*/
+/* Request parsing */
+
+/**
+ * Internal API
+ * Return the end of the JSON value starting at p, or NULL.
+ */
+static const char *lb_json_end(const char *p, const char *end)
+{
+	bool in_str = false;
+	int depth = 0;
+
+	if (p >= end)
+		return NULL;
+
+	if (*p == '"') {
+		for (p++; p < end; p++) {
+			if (*p == '\\')
+				p++;
+			else if (*p == '"')
+				return p + 1;
+		}
+		return NULL;
+	}
+
+	if (*p != '{' && *p != '[') {
+		while (p < end && *p != ',' && *p != '}' && *p != ']')
+			p++;
+		return p;
+	}
+
+	for (; p < end; p++) {
+		if (in_str) {
+			if (*p == '\\')
+				p++;
+			else if (*p == '"')
+				in_str = false;
+		} else if (*p == '"') {
+			in_str = true;
+		} else if (*p == '{' || *p == '[') {
+			depth++;
+		} else if (*p == '}' || *p == ']') {
+			if (--depth == 0)
+				return p + 1;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Internal API
+ * Find the value of the first "key": in js.
+ */
+static bool lb_json_get(lb_span_t js, const char *key, lb_span_t *val)
+{
+	char tag[40];
+	const char *end = js.p + js.n, *p, *e;
+	int n = snprintf(tag, sizeof(tag), "\"%s\":", key);
+
+	if (n <= 0 || (size_t)n >= sizeof(tag))
+		return false;
+
+	for (p = js.p; p + n <= end; p++) {
+		if (memcmp(p, tag, (size_t)n) != 0)
+			continue;
+		e = lb_json_end(p + n, end);
+		if (!e || e == p + n)
+			return false;
+		val->p = p + n;
+		val->n = (size_t)(e - val->p);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Internal API
+ */
+static uint32_t lb_json_uint(lb_span_t v)
+{
+	return (uint32_t)strtoul(v.p, NULL, 10);
+}
+
+/**
+ * Internal API
+ * Return the contents of the idx'th quoted string within v.
+ */
+static bool lb_json_str(lb_span_t v, int idx, lb_span_t *s)
+{
+	const char *p = v.p, *end = v.p + v.n, *q;
+
+	for (;;) {
+		while (p < end && *p != '"')
+			p++;
+		if (p >= end)
+			return false;
+		q = lb_json_end(p, end);
+		if (!q)
+			return false;
+		if (idx-- == 0) {
+			s->p = p + 1;
+			s->n = (size_t)(q - p - 2);
+			return true;
+		}
+		p = q;
+	}
+}
+
+/**
+ * Internal API
+ * Decode the idx'th quoted base64 string within v into out.
+ */
+static int lb_json_b64(lb_span_t v, int idx, uint8_t *out, size_t cap)
+{
+	lb_span_t s;
+	uint8_t *tmp;
+	size_t pad = 0;
+	int n;
+
+	if (!lb_json_str(v, idx, &s) || s.n % 4)
+		return -1;
+	if (!s.n)
+		return 0;
+	if (s.p[s.n - 1] == '=')
+		pad++;
+	if (s.p[s.n - 2] == '=')
+		pad++;
+	if (s.n / 4 * 3 - pad > cap)
+		return -1;
+
+	/* EVP_DecodeBlock() also writes out the bytes of the padding */
+	tmp = malloc(s.n / 4 * 3);
+	if (!tmp)
+		return -1;
+	n = EVP_DecodeBlock(tmp, (const unsigned char *)s.p, (int)s.n);
+	if (n >= 0) {
+		n -= (int)pad;
+		memcpy(out, tmp, (size_t)n);
+	}
+	free(tmp);
+	return n;
+}
+
+/*==================================================================*/
+/* Crypto */
+
+/**
+ * Internal API
+ */
+static bool lb_key_gen(lb_key_t *k)
+{
+	unsigned char *der = NULL;
+
+	k->key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+	if (!k->key || !EC_KEY_generate_key(k->key))
+		return false;
+	k->der_len = i2d_EC_PUBKEY(k->key, &der);
+	if (k->der_len <= 0)
+		return false;
+	k->der = der;
+	return true;
+}
+
+/**
+ * Internal API
+ */
+static void lb_key_free(lb_key_t *k)
+{
+	if (k->key)
+		EC_KEY_free(k->key);
+	if (k->der)
+		OPENSSL_free(k->der);
+	k->key = NULL;
+	k->der = NULL;
+}
+
+/**
+ * Internal API
+ * Signature over msg with SHA256/ECDSA, written as [len,"b64 DER"].
+ */
+static bool lb_put_sig(lb_buf_t *b, const lb_key_t *k, const char *msg,
+		       size_t len)
+{
+	uint8_t dgst[SHA256_DIGEST_LENGTH];
+	uint8_t sig[128];
+	unsigned int siglen = sizeof(sig);
+
+	SHA256((const unsigned char *)msg, len, dgst);
+	if (!ECDSA_sign(0, dgst, sizeof(dgst), sig, &siglen, k->key))
+		return false;
+	return lb_put_bytes(b, sig, siglen);
+}
+
+/**
+ * Internal API
+ * {"bo":bo,"pk":pk,"sg":sig-over-bo}
+ */
+static bool lb_put_signed(lb_buf_t *b, const lb_buf_t *bo, const lb_key_t *pk,
+			  const lb_key_t *signer)
+{
+	return lb_puts(b, "{\"bo\":") && lb_put_buf(b, bo) &&
+	       lb_puts(b, ",\"pk\":") &&
+	       (pk ? lb_put_pubkey(b, pk) : lb_puts(b, LB_PK_NULL)) &&
+	       lb_puts(b, ",\"sg\":") &&
+	       lb_put_sig(b, signer, bo->data, bo->len) && lb_puts(b, "}");
+}
+
+/**
+ * Internal API
+ */
+static bool lb_aes_ctr(const uint8_t *iv, const uint8_t *in, size_t len,
+		       uint8_t *out)
+{
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	int n = 0, fin = 0;
+	bool ret = false;
+
+	if (!ctx)
+		return false;
+	if (EVP_EncryptInit_ex(ctx, EVP_aes_128_ctr(), NULL, lb.sek, iv) &&
+	    EVP_EncryptUpdate(ctx, out, &n, in, (int)len) &&
+	    EVP_EncryptFinal_ex(ctx, out + n, &fin))
+		ret = ((size_t)(n + fin) == len);
+	EVP_CIPHER_CTX_free(ctx);
+	return ret;
+}
+
+/**
+ * Internal API
+ * Wrap plain text into {"ct":[[16,"iv"],len,"ct"],"hmac":[32,"b64"]}.
+ */
+static bool lb_encrypt(lb_buf_t *out, const lb_buf_t *plain)
+{
+	uint8_t iv[LB_IV_LEN] = {0};
+	uint8_t mac[EVP_MAX_MD_SIZE];
+	unsigned int maclen = 0;
+	uint8_t *ct = malloc(plain->len + 1);
+	lb_buf_t ctt = {0};
+	bool ret = false;
+
+	if (!ct || RAND_bytes(iv, LB_IV_LEN - 4) != 1 ||
+	    !lb_aes_ctr(iv, (const uint8_t *)plain->data, plain->len, ct))
+		goto end;
+
+	if (!lb_puts(&ctt, "[") || !lb_put_bytes(&ctt, iv, sizeof(iv)) ||
+	    !lb_printf(&ctt, ",%zu,\"", plain->len) ||
+	    !lb_put_b64(&ctt, ct, plain->len) || !lb_puts(&ctt, "\"]"))
+		goto end;
+
+	if (!HMAC(EVP_sha256(), lb.svk, LB_SVK_LEN,
+		  (const unsigned char *)ctt.data, ctt.len, mac, &maclen))
+		goto end;
+
+	ret = lb_puts(out, "{\"ct\":") && lb_put_buf(out, &ctt) &&
+	      lb_printf(out, ",\"hmac\":[%u,\"", maclen) &&
+	      lb_put_b64(out, mac, maclen) && lb_puts(out, "\"]}");
+end:
+	free(ct);
+	lb_buf_free(&ctt);
+	return ret;
+}
+
+/**
+ * Internal API
+ * Check the HMAC of an encrypted device message and decrypt it.
+ */
+static bool lb_decrypt(const char *body, size_t len, lb_buf_t *plain)
+{
+	lb_span_t js = {body, len}, ct, mac;
+	uint8_t iv[LB_IV_LEN], rmac[LB_HASH_LEN], cmac[EVP_MAX_MD_SIZE];
+	unsigned int cmaclen = 0;
+	uint8_t *bin = NULL;
+	int n;
+	bool ret = false;
+
+	if (!lb_json_get(js, "ct", &ct) || !lb_json_get(js, "hmac", &mac))
+		return false;
+
+	if (!HMAC(EVP_sha256(), lb.svk, LB_SVK_LEN,
+		  (const unsigned char *)ct.p, ct.n, cmac, &cmaclen) ||
+	    lb_json_b64(mac, 0, rmac, sizeof(rmac)) != LB_HASH_LEN ||
+	    cmaclen != LB_HASH_LEN || memcmp(rmac, cmac, LB_HASH_LEN) != 0) {
+		fprintf(stderr, "loopback: device HMAC mismatch\n");
+		return false;
+	}
+
+	bin = malloc(ct.n);
+	if (!bin || lb_json_b64(ct, 0, iv, sizeof(iv)) != LB_IV_LEN)
+		goto end;
+	n = lb_json_b64(ct, 1, bin, ct.n);
+	if (n < 0 || !lb_reserve(plain, (size_t)n))
+		goto end;
+	if (!lb_aes_ctr(iv, bin, (size_t)n, (uint8_t *)plain->data))
+		goto end;
+	plain->len = (size_t)n;
+	plain->data[n] = '\0';
+	ret = true;
+end:
+	free(bin);
+	return ret;
+}
+
+/**
+ * Internal API
+ * Owner side of the ECDH key exchange, step 1: xA = X || Y || owner random,
+ * each prefixed by a 16 bit big endian length.
+ */
+static bool lb_kex_xa(uint8_t *xa, size_t *xalen)
+{
+	BIGNUM *x = BN_new(), *y = BN_new();
+	size_t ofs = 0;
+	bool ret = false;
+	int n;
+
+	if (lb.xkey)
+		EC_KEY_free(lb.xkey);
+	lb.xkey = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+	if (!x || !y || !lb.xkey || !EC_KEY_generate_key(lb.xkey) ||
+	    !EC_POINT_get_affine_coordinates(EC_KEY_get0_group(lb.xkey),
+					     EC_KEY_get0_public_key(lb.xkey),
+					     x, y, NULL))
+		goto end;
+
+	/* The device reads the owner random as a fixed-size big number */
+	if (RAND_bytes(lb.owner_random, LB_OWNER_RANDOM_LEN) != 1)
+		goto end;
+	lb.owner_random[0] |= 0x80;
+
+	n = BN_num_bytes(x);
+	xa[ofs++] = (uint8_t)(n >> 8);
+	xa[ofs++] = (uint8_t)n;
+	ofs += (size_t)BN_bn2bin(x, xa + ofs);
+	n = BN_num_bytes(y);
+	xa[ofs++] = (uint8_t)(n >> 8);
+	xa[ofs++] = (uint8_t)n;
+	ofs += (size_t)BN_bn2bin(y, xa + ofs);
+	xa[ofs++] = 0;
+	xa[ofs++] = LB_OWNER_RANDOM_LEN;
+	memcpy(xa + ofs, lb.owner_random, LB_OWNER_RANDOM_LEN);
+	*xalen = ofs + LB_OWNER_RANDOM_LEN;
+	ret = true;
+end:
+	BN_free(x);
+	BN_free(y);
+	return ret;
+}
+
+/**
+ * Internal API
+ */
+static void lb_kdf(uint8_t idx, const char *label, const uint8_t *secret,
+		   size_t slen, uint8_t *out, size_t outlen)
+{
+	static const char kdf_label[] = "MarshalPointKDF";
+	static const uint8_t zero_key[LB_HASH_LEN] = {0};
+	uint8_t mat[512], mac[EVP_MAX_MD_SIZE];
+	unsigned int maclen = 0;
+	size_t ofs = 0;
+
+	mat[ofs++] = idx;
+	memcpy(mat + ofs, kdf_label, sizeof(kdf_label) - 1);
+	ofs += sizeof(kdf_label) - 1;
+	mat[ofs++] = 0;
+	memcpy(mat + ofs, label, strlen(label));
+	ofs += strlen(label);
+	memcpy(mat + ofs, secret, slen);
+	ofs += slen;
+
+	HMAC(EVP_sha256(), zero_key, sizeof(zero_key), mat, ofs, mac, &maclen);
+	memcpy(out, mac, outlen);
+}
+
+/**
+ * Internal API
+ * Step 2: take xB from the device and derive sek/svk.
+ */
+static bool lb_kex_xb(const uint8_t *xb, size_t xblen)
+{
+	const EC_GROUP *group = EC_KEY_get0_group(lb.xkey);
+	EC_POINT *peer = NULL, *shared = NULL;
+	BIGNUM *x = BN_new(), *y = BN_new(), *shx = BN_new();
+	uint8_t secret[128];
+	size_t lx, ly, lr, ofs = 0, slen;
+	bool ret = false;
+
+	if (!x || !y || !shx || xblen < 6)
+		goto end;
+	lx = (size_t)(xb[0] << 8 | xb[1]);
+	if (2 + lx + 2 > xblen)
+		goto end;
+	ly = (size_t)(xb[2 + lx] << 8 | xb[3 + lx]);
+	if (4 + lx + ly + 2 > xblen)
+		goto end;
+	lr = (size_t)(xb[4 + lx + ly] << 8 | xb[5 + lx + ly]);
+	if (6 + lx + ly + lr > xblen || lr > 64)
+		goto end;
+
+	BN_bin2bn(xb + 2, (int)lx, x);
+	BN_bin2bn(xb + 4 + lx, (int)ly, y);
+	peer = EC_POINT_new(group);
+	shared = EC_POINT_new(group);
+	if (!peer || !shared ||
+	    !EC_POINT_set_affine_coordinates(group, peer, x, y, NULL) ||
+	    !EC_POINT_mul(group, shared, NULL, peer,
+			  EC_KEY_get0_private_key(lb.xkey), NULL) ||
+	    !EC_POINT_get_affine_coordinates(group, shared, shx, NULL, NULL))
+		goto end;
+
+	/* Sh_se = Shx || device random || owner random */
+	ofs = (size_t)BN_bn2bin(shx, secret);
+	memcpy(secret + ofs, xb + 6 + lx + ly, lr);
+	ofs += lr;
+	memcpy(secret + ofs, lb.owner_random, LB_OWNER_RANDOM_LEN);
+	slen = ofs + LB_OWNER_RANDOM_LEN;
+
+	lb_kdf(0x01, "AutomaticProvisioning-cipher", secret, slen, lb.sek,
+	       LB_SEK_LEN);
+	lb_kdf(0x02, "AutomaticProvisioning-hmac", secret, slen, lb.svk,
+	       LB_SVK_LEN);
+	OPENSSL_cleanse(secret, sizeof(secret));
+	ret = true;
+end:
+	EC_POINT_free(peer);
+	EC_POINT_free(shared);
+	BN_free(x);
+	BN_free(y);
+	BN_clear_free(shx);
+	return ret;
+}
+
+/*==================================================================*/
+/* Ownership voucher */
+
+/**
+ * Internal API
+ * Build the signed voucher entries once the header and its HMAC are known.
+ * Entry i carries key i of the chain and is signed by key i-1 (the
+ * manufacturer key for entry 0); the last key is the owner key.
+ */
+static bool lb_build_voucher(void)
+{
+	uint32_t n = lb.cfg.voucher_entries, i;
+	uint8_t hp[LB_HASH_LEN], hc[LB_HASH_LEN];
+	lb_buf_t bo = {0}, tmp = {0};
+	lb_span_t oh = {lb.oh.data, lb.oh.len}, g, d;
+	const lb_key_t *signer = &lb.mfg, *pk;
+	bool ret = false;
+
+	if (!lb_json_get(oh, "g", &g) || !lb_json_get(oh, "d", &d))
+		return false;
+
+	/* hc = SHA256(g || d), hp0 = SHA256(oh || hmac) */
+	if (!lb_put(&tmp, g.p, g.n) || !lb_put(&tmp, d.p, d.n))
+		goto end;
+	SHA256((const unsigned char *)tmp.data, tmp.len, hc);
+	lb_reset(&tmp);
+	if (!lb_put_buf(&tmp, &lb.oh) || !lb_put_buf(&tmp, &lb.hmac))
+		goto end;
+	SHA256((const unsigned char *)tmp.data, tmp.len, hp);
+
+	for (i = 0; i < n; i++) {
+		pk = (i == n - 1) ? &lb.owner : &lb.chain[i];
+		lb_reset(&bo);
+		lb_reset(&lb.entries[i]);
+		if (!lb_puts(&bo, "{\"hp\":") || !lb_put_hash(&bo, hp) ||
+		    !lb_puts(&bo, ",\"hc\":") || !lb_put_hash(&bo, hc) ||
+		    !lb_puts(&bo, ",\"pk\":") || !lb_put_pubkey(&bo, pk) ||
+		    !lb_puts(&bo, "}"))
+			goto end;
+		if (!lb_put_signed(&lb.entries[i], &bo, NULL, signer))
+			goto end;
+		SHA256((const unsigned char *)bo.data, bo.len, hp);
+		signer = pk;
+	}
+	lb.voucher_ready = true;
+	ret = true;
+end:
+	lb_buf_free(&bo);
+	lb_buf_free(&tmp);
+	return ret;
+}
+
+/*==================================================================*/
+/* DI: manufacturer */
+
+/**
+ * Internal API
+ * msg10 (AppStart) -> msg11 (SetCredentials)
+ */
+static bool lb_msg10(const char *body, size_t len, lb_buf_t *out)
+{
+	uint8_t hdc[LB_HASH_LEN];
+
+	(void)body;
+	(void)len;
+
+	lb.voucher_ready = false;
+	lb_reset(&lb.oh);
+	lb_reset(&lb.guid_txt);
+	if (RAND_bytes(lb.guid, LB_GUID_LEN) != 1 ||
+	    !lb_puts(&lb.guid_txt, "\"") ||
+	    !lb_put_b64(&lb.guid_txt, lb.guid, LB_GUID_LEN) ||
+	    !lb_puts(&lb.guid_txt, "\""))
+		return false;
+
+	/* hdc would be the hash of the device certificate chain */
+	SHA256((const unsigned char *)LB_DEVINFO, sizeof(LB_DEVINFO) - 1, hdc);
+
+	if (!lb_printf(&lb.oh, "{\"pv\":113,\"pe\":1,\"r\":") ||
+	    !lb_put_buf(&lb.oh, &lb.rvlist) || !lb_puts(&lb.oh, ",\"g\":") ||
+	    !lb_put_buf(&lb.oh, &lb.guid_txt) ||
+	    !lb_puts(&lb.oh, ",\"d\":\"" LB_DEVINFO "\",\"pk\":") ||
+	    !lb_put_pubkey(&lb.oh, &lb.mfg) || !lb_puts(&lb.oh, ",\"hdc\":") ||
+	    !lb_put_hash(&lb.oh, hdc) || !lb_puts(&lb.oh, "}"))
+		return false;
+
+	return lb_puts(out, "{\"oh\":") && lb_put_buf(out, &lb.oh) &&
+	       lb_puts(out, "}");
+}
+
+/**
+ * Internal API
+ * msg12 (SetHMAC) -> msg13 (Done)
+ */
+static bool lb_msg12(const char *body, size_t len, lb_buf_t *out)
+{
+	lb_span_t js = {body, len}, hmac;
+
+	if (!lb.oh.len || !lb_json_get(js, "hmac", &hmac))
+		return false;
+	lb_reset(&lb.hmac);
+	if (!lb_put(&lb.hmac, hmac.p, hmac.n) || !lb_build_voucher())
+		return false;
+	return lb_puts(out, "{}");
+}
+
+/*==================================================================*/
+/* TO1: rendezvous */
+
+/**
+ * Internal API
+ * msg30 (HelloSDO) -> msg31 (HelloSDOAck)
+ */
+static bool lb_msg30(const char *body, size_t len, lb_buf_t *out)
+{
+	uint8_t n4[LB_NONCE_LEN];
+
+	(void)body;
+	(void)len;
+	if (RAND_bytes(n4, sizeof(n4)) != 1)
+		return false;
+	return lb_puts(out, "{\"n4\":\"") && lb_put_b64(out, n4, sizeof(n4)) &&
+	       lb_puts(out, "\",\"eB\":" LB_ENC_NONE "}");
+}
+
+/**
+ * Internal API
+ * msg32 (ProveToSDO) -> msg33 (SDORedirect)
+ */
+static bool lb_msg32(const char *body, size_t len, lb_buf_t *out)
+{
+	uint8_t dh[LB_HASH_LEN] = {0};
+	lb_buf_t bo = {0};
+	bool ret;
+
+	(void)body;
+	(void)len;
+	ret = lb_puts(&bo, "{\"i1\":[4,\"fwAAAQ==\"],\"dns1\":\"\",") &&
+	      lb_printf(&bo, "\"port1\":%u,\"to0dh\":",
+			(unsigned int)lb.srv[LB_OWNER].port) &&
+	      lb_put_hash(&bo, dh) && lb_puts(&bo, "}") &&
+	      lb_put_signed(out, &bo, &lb.owner, &lb.owner);
+	lb_buf_free(&bo);
+	return ret;
+}
+
+/*==================================================================*/
+/* TO2: owner */
+
+/**
+ * Internal API
+ * msg40 (HelloDevice) -> msg41 (ProveOPHdr)
+ */
+static bool lb_msg40(const char *body, size_t len, lb_buf_t *out)
+{
+	lb_span_t js = {body, len}, n5;
+	uint8_t xa[256];
+	size_t xalen = 0;
+	lb_buf_t bo = {0};
+	bool ret = false;
+
+	if (!lb.voucher_ready || !lb_json_get(js, "n5", &n5))
+		return false;
+	lb_reset(&lb.n5);
+	if (!lb_put(&lb.n5, n5.p, n5.n) ||
+	    RAND_bytes(lb.n6, LB_NONCE_LEN) != 1 || !lb_kex_xa(xa, &xalen))
+		return false;
+
+	if (lb_printf(&bo, "{\"sz\":%u,\"oh\":", lb.cfg.voucher_entries) &&
+	    lb_put_buf(&bo, &lb.oh) && lb_puts(&bo, ",\"hmac\":") &&
+	    lb_put_buf(&bo, &lb.hmac) && lb_puts(&bo, ",\"n5\":") &&
+	    lb_put_buf(&bo, &lb.n5) && lb_puts(&bo, ",\"n6\":\"") &&
+	    lb_put_b64(&bo, lb.n6, LB_NONCE_LEN) &&
+	    lb_puts(&bo, "\",\"eB\":" LB_ENC_NONE ",\"xA\":") &&
+	    lb_put_bytes(&bo, xa, xalen) && lb_puts(&bo, "}"))
+		ret = lb_put_signed(out, &bo, &lb.owner, &lb.owner);
+	lb_buf_free(&bo);
+	return ret;
+}
+
+/**
+ * Internal API
+ * msg42 (GetOPNextEntry) -> msg43 (OPNextEntry)
+ */
+static bool lb_msg42(const char *body, size_t len, lb_buf_t *out)
+{
+	lb_span_t js = {body, len}, enn;
+	uint32_t i;
+
+	if (!lb_json_get(js, "enn", &enn))
+		return false;
+	i = lb_json_uint(enn);
+	if (i >= lb.cfg.voucher_entries)
+		return false;
+	return lb_printf(out, "{\"enn\":%u,\"eni\":", i) &&
+	       lb_put_buf(out, &lb.entries[i]) && lb_puts(out, "}");
+}
+
+/**
+ * Internal API
+ * msg45 (NextDeviceServiceInfo request), encrypted.
+ */
+static bool lb_reply45(uint32_t nn, lb_buf_t *out)
+{
+	lb_buf_t plain = {0};
+	bool ret;
+
+	ret = lb_printf(&plain, "{\"nn\":%u,\"psi\":\"\"}", nn) &&
+	      lb_encrypt(out, &plain);
+	lb_buf_free(&plain);
+	return ret;
+}
+
+/**
+ * Internal API
+ * msg44 (ProveDevice) -> msg45
+ */
+static bool lb_msg44(const char *body, size_t len, lb_buf_t *out)
+{
+	lb_span_t js = {body, len}, bo, n7, nn, xb;
+	uint8_t xbin[256];
+	int xblen;
+
+	if (!lb.xkey || !lb_json_get(js, "bo", &bo) ||
+	    !lb_json_get(bo, "n7", &n7) || !lb_json_get(bo, "nn", &nn) ||
+	    !lb_json_get(bo, "xB", &xb))
+		return false;
+	xblen = lb_json_b64(xb, 0, xbin, sizeof(xbin));
+	if (xblen <= 0 || !lb_kex_xb(xbin, (size_t)xblen))
+		return false;
+
+	lb_reset(&lb.n7);
+	if (!lb_put(&lb.n7, n7.p, n7.n))
+		return false;
+	lb.dsi_rounds = lb_json_uint(nn);
+
+	return lb_reply45(0, out);
+}
+
+/**
+ * Internal API
+ * msg46 (NextDeviceServiceInfo) -> msg45 for the next round, or msg47
+ * (SetupDevice) after the last one.
+ */
+static bool lb_msg46(const char *body, size_t len, lb_buf_t *out)
+{
+	lb_buf_t plain = {0}, noh = {0}, bo = {0};
+	lb_span_t js, nn;
+	uint32_t k;
+	bool ret = false;
+
+	if (!lb_decrypt(body, len, &plain))
+		goto end;
+	js.p = plain.data;
+	js.n = plain.len;
+	if (!lb_json_get(js, "nn", &nn))
+		goto end;
+	k = lb_json_uint(nn);
+	if (k + 1 < lb.dsi_rounds) {
+		ret = lb_reply45(k + 1, out);
+		goto end;
+	}
+
+	if (!lb_puts(&bo, "{\"r3\":") || !lb_put_buf(&bo, &lb.rvlist) ||
+	    !lb_puts(&bo, ",\"g3\":") || !lb_put_buf(&bo, &lb.guid_txt) ||
+	    !lb_puts(&bo, ",\"n7\":") || !lb_put_buf(&bo, &lb.n7) ||
+	    !lb_puts(&bo, "}"))
+		goto end;
+	if (!lb_printf(&noh, "{\"osinn\":%u,\"noh\":", lb.cfg.osi_rounds) ||
+	    !lb_put_signed(&noh, &bo, &lb.owner, &lb.owner) ||
+	    !lb_puts(&noh, "}"))
+		goto end;
+	ret = lb_encrypt(out, &noh);
+end:
+	lb_buf_free(&plain);
+	lb_buf_free(&noh);
+	lb_buf_free(&bo);
+	return ret;
+}
+
+/**
+ * Internal API
+ * msg48 (GetNextOwnerServiceInfo) -> msg49 (OwnerServiceInfo)
+ */
+static bool lb_msg48(const char *body, size_t len, lb_buf_t *out)
+{
+	lb_buf_t plain = {0}, osi = {0};
+	lb_span_t js, nn;
+	uint32_t i, j, v;
+	bool ret = false;
+
+	if (!lb_decrypt(body, len, &plain))
+		goto end;
+	js.p = plain.data;
+	js.n = plain.len;
+	if (!lb_json_get(js, "nn", &nn))
+		goto end;
+	i = lb_json_uint(nn);
+	if (i >= lb.cfg.osi_rounds)
+		goto end;
+
+	if (!lb_printf(&osi, "{\"nn\":%u,\"sv\":{", i))
+		goto end;
+	for (j = 0; j < lb.cfg.osi_kv_per_round; j++) {
+		if (!lb_printf(&osi, "%s\"" LB_MODULE_NAME ":osi%u_%u\":\"",
+			       j ? "," : "", i, j) ||
+		    !lb_reserve(&osi, lb.cfg.osi_value_len))
+			goto end;
+		for (v = 0; v < lb.cfg.osi_value_len; v++)
+			osi.data[osi.len++] =
+			    (char)('a' + rand_r(&lb.rand_state) % 26);
+		if (!lb_puts(&osi, "\""))
+			goto end;
+	}
+	if (!lb_puts(&osi, "}}"))
+		goto end;
+	ret = lb_encrypt(out, &osi);
+end:
+	lb_buf_free(&plain);
+	lb_buf_free(&osi);
+	return ret;
+}
+
+/**
+ * Internal API
+ * msg50 (Done) -> msg51 (Done2)
+ */
+static bool lb_msg50(const char *body, size_t len, lb_buf_t *out)
+{
+	lb_buf_t plain = {0}, done = {0};
+	bool ret = false;
+
+	if (!lb_decrypt(body, len, &plain))
+		goto end;
+	if (!lb_puts(&done, "{\"n7\":") || !lb_put_buf(&done, &lb.n7) ||
+	    !lb_puts(&done, "}"))
+		goto end;
+	ret = lb_encrypt(out, &done);
+	if (ret)
+		lb.stats.to2_done++;
+end:
+	lb_buf_free(&plain);
+	lb_buf_free(&done);
+	return ret;
+}
+
+/**
+ * Internal API
+ */
+static lb_handler_t lb_handler(int msg_type)
+{
+	switch (msg_type) {
+	case 10:
+		return lb_msg10;
+	case 12:
+		return lb_msg12;
+	case 30:
+		return lb_msg30;
+	case 32:
+		return lb_msg32;
+	case 40:
+		return lb_msg40;
+	case 42:
+		return lb_msg42;
+	case 44:
+		return lb_msg44;
+	case 46:
+		return lb_msg46;
+	case 48:
+		return lb_msg48;
+	case 50:
+		return lb_msg50;
+	default:
+		return NULL;
+	}
+}
+
+/*==================================================================*/
+/* Transport */
+
+/**
+ * Internal API
+ */
+static bool lb_send_all(int fd, const char *p, size_t n)
+{
+	ssize_t w;
+
+	while (n) {
+		w = send(fd, p, n, MSG_NOSIGNAL);
+		if (w <= 0)
+			return false;
+		p += w;
+		n -= (size_t)w;
+	}
+	return true;
+}
+
+/**
+ * Internal API
+ * Read one REST request: header up to the blank line, then the body.
+ */
+static bool lb_read_request(int fd, int *msg_type, lb_buf_t *body)
+{
+	char hdr[LB_MAX_HEADER];
+	size_t n = 0, clen = 0;
+	const char *p, *line;
+	ssize_t r;
+
+	for (;;) {
+		if (n + 1 >= sizeof(hdr))
+			return false;
+		r = recv(fd, hdr + n, 1, 0);
+		if (r <= 0)
+			return false;
+		n++;
+		if (n >= 4 && memcmp(hdr + n - 4, "\r\n\r\n", 4) == 0)
+			break;
+	}
+	hdr[n] = '\0';
+
+	p = strstr(hdr, "/msg/");
+	if (!p)
+		return false;
+	*msg_type = atoi(p + 5);
+
+	for (line = strchr(hdr, '\n'); line; line = strchr(line, '\n')) {
+		line++;
+		if (strncasecmp(line, "content-length:", 15) == 0)
+			clen = strtoul(line + 15, NULL, 10);
+	}
+	if (clen > LB_MAX_REQUEST || !lb_reserve(body, clen))
+		return false;
+
+	while (body->len < clen) {
+		r = recv(fd, body->data + body->len, clen - body->len, 0);
+		if (r <= 0)
+			return false;
+		body->len += (size_t)r;
+	}
+	body->data[body->len] = '\0';
+	return true;
+}
+
+/**
+ * Internal API
+ */
+static void lb_account(int msg_type, uint64_t in_us, uint64_t out_us)
+{
+	lb_msg_stats_t *s = &lb.stats.msg[msg_type & (LB_MAX_MSG_TYPE - 1)];
+	uint64_t dev = in_us > lb.last_reply_us ? in_us - lb.last_reply_us : 0;
+	uint64_t srv = out_us - in_us;
+
+	s->count++;
+	s->device_us += dev;
+	s->server_us += srv;
+	if (dev > s->device_max_us)
+		s->device_max_us = dev;
+	if (srv > s->server_max_us)
+		s->server_max_us = srv;
+	lb.last_reply_us = out_us;
+}
+
+/**
+ * Internal API
+ * Serve one request on an accepted connection.
+ */
+static void lb_serve(lb_listener_t *l, int fd)
+{
+	lb_buf_t req = {0}, resp = {0};
+	lb_handler_t handler;
+	int msg_type = 0;
+	uint64_t in_us;
+	bool drop, ok = false;
+	char hdr[128];
+	int hlen;
+
+	if (!lb_read_request(fd, &msg_type, &req))
+		goto end;
+	in_us = lb_now_us();
+
+	pthread_mutex_lock(&lb.lock);
+	drop = (msg_type != LB_MSG_ERROR && lb.cfg.loss_pct &&
+		(uint32_t)(rand_r(&lb.rand_state) % 100) < lb.cfg.loss_pct);
+	if (drop) {
+		lb.stats.dropped++;
+		lb.last_reply_us = in_us;
+		pthread_mutex_unlock(&lb.lock);
+		goto end;
+	}
+
+	if (msg_type == LB_MSG_ERROR) {
+		/* The device gave up on the exchange; acknowledge and count */
+		fprintf(stderr, "loopback: device error: %.*s\n",
+			(int)req.len, req.data ? req.data : "");
+		lb.stats.device_errors++;
+		ok = true;
+	} else if (msg_type >= l->first_msg && msg_type <= l->last_msg) {
+		handler = lb_handler(msg_type);
+		ok = handler && handler(req.data ? req.data : "", req.len,
+					&resp);
+	}
+	if (!ok) {
+		fprintf(stderr, "loopback: cannot handle msg%d\n", msg_type);
+		lb.stats.protocol_errors++;
+		lb.last_reply_us = lb_now_us();
+	}
+	pthread_mutex_unlock(&lb.lock);
+	if (!ok)
+		goto end;
+
+	if (lb.cfg.delay_ms)
+		usleep(lb.cfg.delay_ms * 1000);
+
+	/* Account before replying, the device may finish as soon as it reads */
+	pthread_mutex_lock(&lb.lock);
+	lb_account(msg_type, in_us, lb_now_us());
+	pthread_mutex_unlock(&lb.lock);
+
+	hlen = snprintf(hdr, sizeof(hdr),
+			"HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+			"Content-Length: %zu\r\n\r\n",
+			resp.len);
+	if (!lb_send_all(fd, hdr, (size_t)hlen))
+		goto end;
+	lb_send_all(fd, resp.data ? resp.data : "", resp.len);
+end:
+	close(fd);
+	lb_buf_free(&req);
+	lb_buf_free(&resp);
+}
+
+/**
+ * Internal API
+ */
+static void *lb_listener_thread(void *arg)
+{
+	lb_listener_t *l = arg;
+	int fd;
+
+	while (!lb.stop) {
+		fd = accept(l->fd, NULL, NULL);
+		if (fd < 0)
+			continue;
+		if (lb.stop) {
+			close(fd);
+			break;
+		}
+		lb_serve(l, fd);
+	}
+	return NULL;
+}
+
+/**
+ * Internal API
+ */
+static bool lb_listen(lb_listener_t *l, int first_msg, int last_msg)
+{
+	struct sockaddr_in addr;
+	socklen_t alen = sizeof(addr);
+	int one = 1;
+
+	l->first_msg = first_msg;
+	l->last_msg = last_msg;
+	l->fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (l->fd < 0)
+		return false;
+	setsockopt(l->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	if (bind(l->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(l->fd, 8) != 0 ||
+	    getsockname(l->fd, (struct sockaddr *)&addr, &alen) != 0)
+		return false;
+	l->port = ntohs(addr.sin_port);
+
+	if (pthread_create(&l->thread, NULL, lb_listener_thread, l) != 0)
+		return false;
+	l->running = true;
+	return true;
+}
+
+/**
+ * Start the manufacturer, rendezvous and owner servers on ephemeral
+ * loopback ports.
+ *
+ * @param cfg - voucher length, service info volume and fault injection.
+ * @return true on success, false otherwise.
+ */
+bool lb_server_start(const lb_config_t *cfg)
+{
+	uint32_t i;
+
+	if (!cfg || !cfg->voucher_entries || cfg->loss_pct >= 100)
+		return false;
+
+	memset(&lb, 0, sizeof(lb));
+	for (i = 0; i < LB_NUM_SERVERS; i++)
+		lb.srv[i].fd = -1;
+	lb.cfg = *cfg;
+	lb.rand_state = cfg->seed;
+	if (pthread_mutex_init(&lb.lock, NULL) != 0)
+		return false;
+
+	lb.chain = calloc(cfg->voucher_entries, sizeof(*lb.chain));
+	lb.entries = calloc(cfg->voucher_entries, sizeof(*lb.entries));
+	if (!lb.chain || !lb.entries || !lb_key_gen(&lb.mfg) ||
+	    !lb_key_gen(&lb.owner))
+		goto err;
+	for (i = 0; i + 1 < cfg->voucher_entries; i++) {
+		if (!lb_key_gen(&lb.chain[i]))
+			goto err;
+	}
+
+	if (!lb_listen(&lb.srv[LB_RV], 30, 33) ||
+	    !lb_listen(&lb.srv[LB_MFG], 10, 13) ||
+	    !lb_listen(&lb.srv[LB_OWNER], 40, 51))
+		goto err;
+
+	if (!lb_printf(&lb.rvlist,
+		       "[1,[3,{\"only\":\"dev\",\"ip\":[4,\"fwAAAQ==\"],"
+		       "\"po\":%u}]]",
+		       (unsigned int)lb.srv[LB_RV].port))
+		goto err;
+
+	lb.last_reply_us = lb_now_us();
+	return true;
+
+err:
+	lb_server_stop();
+	return false;
+}
+
+/**
+ * Stop the servers and release everything they hold.
+ */
+void lb_server_stop(void)
+{
+	uint32_t i;
+
+	lb.stop = true;
+	for (i = 0; i < LB_NUM_SERVERS; i++) {
+		if (lb.srv[i].fd >= 0)
+			shutdown(lb.srv[i].fd, SHUT_RDWR);
+		if (lb.srv[i].running)
+			pthread_join(lb.srv[i].thread, NULL);
+		if (lb.srv[i].fd >= 0)
+			close(lb.srv[i].fd);
+		lb.srv[i].fd = -1;
+		lb.srv[i].running = false;
+	}
+
+	lb_key_free(&lb.mfg);
+	lb_key_free(&lb.owner);
+	if (lb.chain) {
+		for (i = 0; i < lb.cfg.voucher_entries; i++)
+			lb_key_free(&lb.chain[i]);
+		free(lb.chain);
+		lb.chain = NULL;
+	}
+	if (lb.entries) {
+		for (i = 0; i < lb.cfg.voucher_entries; i++)
+			lb_buf_free(&lb.entries[i]);
+		free(lb.entries);
+		lb.entries = NULL;
+	}
+	if (lb.xkey)
+		EC_KEY_free(lb.xkey);
+	lb.xkey = NULL;
+	lb_buf_free(&lb.rvlist);
+	lb_buf_free(&lb.guid_txt);
+	lb_buf_free(&lb.oh);
+	lb_buf_free(&lb.hmac);
+	lb_buf_free(&lb.n5);
+	lb_buf_free(&lb.n7);
+	OPENSSL_cleanse(lb.sek, sizeof(lb.sek));
+	OPENSSL_cleanse(lb.svk, sizeof(lb.svk));
+	pthread_mutex_destroy(&lb.lock);
+}
+
+/**
+ * Port of the manufacturer server, for data/manufacturer_port.bin.
+ */
+uint16_t lb_server_mfg_port(void)
+{
+	return lb.srv[LB_MFG].port;
+}
+
+/**
+ * Mark the start of a device run: the device time of the next request is
+ * measured from here.
+ */
+void lb_server_mark(void)
+{
+	pthread_mutex_lock(&lb.lock);
+	lb.last_reply_us = lb_now_us();
+	pthread_mutex_unlock(&lb.lock);
+}
+
+/**
+ * Copy out the per-message timing collected so far.
+ */
+void lb_server_get_stats(lb_stats_t *stats)
+{
+	pthread_mutex_lock(&lb.lock);
+	*stats = lb.stats;
+	pthread_mutex_unlock(&lb.lock);
+}
+
+/**
+ * Clear the per-message timing.
+ */
+void lb_server_reset_stats(void)
+{
+	pthread_mutex_lock(&lb.lock);
+	memset(&lb.stats, 0, sizeof(lb.stats));
+	pthread_mutex_unlock(&lb.lock);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Loopback stand-ins for the SDO manufacturer, rendezvous and owner
+ * servers, used to exercise sdo_sdk_run() end to end on a single host.
+ */
+
+#ifndef __LOOPBACK_SERVER_H__
+#define __LOOPBACK_SERVER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LB_MAX_MSG_TYPE 256
+#define LB_MODULE_NAME "bench"
+
+typedef struct {
+	uint32_t voucher_entries;  /* ownership voucher entries, >= 1 */
+	uint32_t osi_rounds;	   /* owner service info rounds (osinn) */
+	uint32_t osi_kv_per_round; /* key/value pairs per msg49 */
+	uint32_t osi_value_len;	   /* length of each OSI value */
+	uint32_t delay_ms;	   /* delay injected before each reply */
+	uint32_t loss_pct;	   /* % of requests dropped without reply */
+	uint32_t seed;		   /* seed for the loss/value generator */
+} lb_config_t;
+
+typedef struct {
+	uint32_t count;
+	uint64_t device_us;	/* device time before the request arrived */
+	uint64_t server_us;	/* server time, including injected delay */
+	uint64_t device_max_us;
+	uint64_t server_max_us;
+} lb_msg_stats_t;
+
+typedef struct {
+	lb_msg_stats_t msg[LB_MAX_MSG_TYPE];
+	uint32_t dropped;
+	uint32_t device_errors;
+	uint32_t protocol_errors;
+	uint32_t to2_done;
+} lb_stats_t;
+
+bool lb_server_start(const lb_config_t *cfg);
+void lb_server_stop(void);
+uint16_t lb_server_mfg_port(void);
+void lb_server_mark(void);
+void lb_server_get_stats(lb_stats_t *stats);
+void lb_server_reset_stats(void);
+
+#endif /* __LOOPBACK_SERVER_H__ */
@@ -0,0 +1,744 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief End-to-end benchmark of sdo_sdk_run() against the loopback servers.
+ *
+ * Provisions a pristine device, runs DI once and then TO1/TO2 for the
+ * requested number of iterations (reusing the voucher, or redoing DI when the
+ * build does not support reuse), and reports per-message and per-phase
+ * timing as seen by the servers together with the wall time of each
+ * sdo_sdk_run() call. Exits non-zero unless every iteration onboarded.
+ * With -a the SDK is driven through sdo_sdk_start()/sdo_sdk_step() from a
+ * poll() loop of the benchmark instead. With -w the service info module is
+ * a v2 module whose OSI runs on the SDK's worker thread, each callback
+ * taking -W milliseconds.
+ */
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "sdo.h"
+#include "sdomodules.h"
+#include "util.h"
+#include "blob.h"
+#include "safe_lib.h"
+#include "loopback_server.h"
+
+/* sdo_mod_data_kv() rejects values of SDO_MAX_STR_SIZE and longer */
+#define BENCH_MAX_DSI_LEN (SDO_MAX_STR_SIZE - 1)
+#define BENCH_MAX_OSI_LEN 500
+#define BENCH_MAX_OSI_ROUND 2048
+#define BENCH_MAX_ROUNDS 255
+#define BENCH_MAX_ENTRIES 64
+
+typedef struct {
+	const char *name;
+	int first_msg;
+	int last_msg;
+} bench_phase_t;
+
+typedef struct {
+	uint32_t count;
+	uint64_t total_us;
+	uint64_t min_us;
+	uint64_t max_us;
+} bench_run_stats_t;
+
+static const bench_phase_t bench_phases[] = {
+    {"DI", 10, 13}, {"TO1", 30, 33}, {"TO2", 40, 51}};
+
+static uint32_t dsi_count = 2;
+static uint32_t dsi_len = 64;
+static char dsi_key[SDO_MODULE_MSG_LEN];
+static char dsi_value[BENCH_MAX_DSI_LEN + 1];
+static uint32_t osi_received;
+static bool bench_osi_worker;
+static uint32_t osi_work_ms;
+static bool bench_dsi_prefetch;
+static uint32_t dsi_work_ms;
+static uint32_t retries;
+static uint32_t errors;
+
+/**
+ * Service info module standing in for real ones: reports dsi_count values
+ * of dsi_len bytes and accepts whatever OSI the owner sends.
+ */
+static int bench_module(sdo_sdk_si_type type, int *count,
+			sdo_sdk_si_key_value *si)
+{
+	switch (type) {
+	case SDO_SI_START:
+	case SDO_SI_END:
+	case SDO_SI_FAILURE:
+	case SDO_SI_SET_PSI:
+		return SDO_SI_SUCCESS;
+	case SDO_SI_GET_DSI_COUNT:
+		*count = (int)dsi_count;
+		return SDO_SI_SUCCESS;
+	case SDO_SI_GET_DSI:
+		if (snprintf(dsi_key, sizeof(dsi_key), "dsi%d", *count) < 0)
+			return SDO_SI_INTERNAL_ERROR;
+		si->key = dsi_key;
+		si->value = dsi_value;
+		return SDO_SI_SUCCESS;
+	case SDO_SI_SET_OSI:
+		osi_received++;
+		return SDO_SI_SUCCESS;
+	default:
+		return SDO_SI_INTERNAL_ERROR;
+	}
+}
+
+/**
+ * The same module with the v2 callback. OSI may arrive on a worker thread
+ * and DSIs may be asked for by a producer thread; the OSI index checks
+ * that OSI arrives in order.
+ */
+static int bench_module_v2(sdo_sdk_si_type type, int *count,
+			   sdo_sdk_si_kv_view *si)
+{
+	switch (type) {
+	case SDO_SI_GET_DSI:
+		if (dsi_work_ms)
+			(void)usleep(dsi_work_ms * 1000);
+		if (snprintf(dsi_key, sizeof(dsi_key), "dsi%d", *count) < 0)
+			return SDO_SI_INTERNAL_ERROR;
+		si->key.data = (uint8_t *)dsi_key;
+		si->key.len = strnlen_s(dsi_key, sizeof(dsi_key));
+		si->value.data = (uint8_t *)dsi_value;
+		si->value.len = dsi_len;
+		return SDO_SI_SUCCESS;
+	case SDO_SI_SET_OSI:
+		if (*count != (int)osi_received)
+			return SDO_SI_CONTENT_ERROR;
+		if (osi_work_ms)
+			(void)usleep(osi_work_ms * 1000);
+		osi_received++;
+		return SDO_SI_SUCCESS;
+	default:
+		return bench_module(type, count, NULL);
+	}
+}
+
+static int bench_error_cb(sdo_sdk_status type, sdo_sdk_error errorcode)
+{
+	(void)type;
+	(void)errorcode;
+	errors++;
+	return SDO_SUCCESS;
+}
+
+static int bench_retry_cb(sdo_sdk_retry_phase phase, uint32_t attempt,
+			  uint32_t delay_ms, uint32_t elapsed_ms)
+{
+	(void)phase;
+	(void)attempt;
+	(void)delay_ms;
+	(void)elapsed_ms;
+	retries++;
+	return SDO_SUCCESS;
+}
+
+static uint64_t bench_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void bench_run_add(bench_run_stats_t *s, uint64_t us)
+{
+	if (!s->count || us < s->min_us)
+		s->min_us = us;
+	if (us > s->max_us)
+		s->max_us = us;
+	s->total_us += us;
+	s->count++;
+}
+
+/*==================================================================*/
+/* Device data files */
+
+static bool bench_write_file(const char *path, const void *data, size_t len)
+{
+	FILE *fp = fopen(path, "wb");
+	bool ret;
+
+	if (!fp) {
+		fprintf(stderr, "bench: cannot write %s\n", path);
+		return false;
+	}
+	ret = (fwrite(data, 1, len, fp) == len);
+	if (fclose(fp) == EOF)
+		ret = false;
+	return ret;
+}
+
+/* Read a whole file, NULL (and *len = 0) if it does not exist */
+static char *bench_read_file(const char *path, size_t *len)
+{
+	FILE *fp = fopen(path, "rb");
+	char *data = NULL;
+	long sz;
+
+	*len = 0;
+	if (!fp)
+		return NULL;
+	if (fseek(fp, 0, SEEK_END) == 0 && (sz = ftell(fp)) >= 0 &&
+	    fseek(fp, 0, SEEK_SET) == 0) {
+		data = malloc((size_t)sz + 1);
+		if (data && fread(data, 1, (size_t)sz, fp) == (size_t)sz)
+			*len = (size_t)sz;
+	}
+	fclose(fp);
+	return data;
+}
+
+/* Put the device back into its pristine (pre-DI) state */
+static bool bench_reset_device(void)
+{
+	static const char normal[] = "{\"ST\":1}";
+
+	if (!bench_write_file(PLATFORM_IV, "", 0) ||
+	    !bench_write_file(PLATFORM_HMAC_KEY, "", 0) ||
+	    !bench_write_file(PLATFORM_AES_KEY, "", 0) ||
+	    !bench_write_file(SDO_CRED_MFG, "", 0) ||
+	    !bench_write_file(SDO_CRED_SECURE, "", 0) ||
+	    !bench_write_file(RAW_BLOB, "", 0) ||
+	    !bench_write_file(SDO_CRED_NORMAL, normal, sizeof(normal) - 1))
+		return false;
+	remove(SDO_TO2_CHECKPOINT);
+#ifdef CRED_STORE_ENABLED
+	remove(SDO_CRED_STORE);
+#endif
+	return true;
+}
+
+/* Pristine device pointed at the loopback manufacturer server */
+static bool bench_provision(void)
+{
+	static const char ip[] = "127.0.0.1";
+	char port[8];
+	int n;
+
+	n = snprintf(port, sizeof(port), "%u",
+		     (unsigned int)lb_server_mfg_port());
+	if (n <= 0 || !bench_reset_device() ||
+	    !bench_write_file(MANUFACTURER_IP, ip, sizeof(ip) - 1) ||
+	    !bench_write_file(MANUFACTURER_PORT, port, (size_t)n))
+		return false;
+
+	if (configure_normal_blob() == -1) {
+		fprintf(stderr, "bench: configure_normal_blob() failed\n");
+		return false;
+	}
+	return true;
+}
+
+/*==================================================================*/
+/* Report */
+
+static double bench_ms(uint64_t us)
+{
+	return (double)us / 1000.0;
+}
+
+/* What sdo_sdk_get_stats() saw on the device side */
+static void bench_report_sdk_stats(void)
+{
+	static const char *const crypto_names[SDO_STATS_CRYPTO_MAX] = {
+	    "sign", "verify", "kex", "encrypt", "decrypt", "hmac", "hash"};
+	static sdo_sdk_stats s;
+	const sdo_sdk_latency_hist *h;
+	int i;
+
+	if (sdo_sdk_get_stats(&s) != SDO_SUCCESS)
+		return;
+
+	printf("\nsdk stats: round trips DI %llu, TO1 %llu, TO2 %llu\n",
+	       (unsigned long long)s.round_trips[SDO_STATS_DI],
+	       (unsigned long long)s.round_trips[SDO_STATS_TO1],
+	       (unsigned long long)s.round_trips[SDO_STATS_TO2]);
+	printf("bytes sent %llu, received %llu, connections %llu (%llu "
+	       "failed), DNS lookups %llu\n",
+	       (unsigned long long)s.bytes_sent,
+	       (unsigned long long)s.bytes_received,
+	       (unsigned long long)s.connections,
+	       (unsigned long long)s.connect_failures,
+	       (unsigned long long)s.dns_lookups);
+	printf("retries: connect %llu, net-io %llu, DI %llu, TO1 %llu, "
+	       "TO2 %llu\ncrypto:",
+	       (unsigned long long)s.retries[SDO_RETRY_CONNECT],
+	       (unsigned long long)s.retries[SDO_RETRY_NETIO],
+	       (unsigned long long)s.retries[SDO_RETRY_DI],
+	       (unsigned long long)s.retries[SDO_RETRY_TO1],
+	       (unsigned long long)s.retries[SDO_RETRY_TO2]);
+	for (i = 0; i < SDO_STATS_CRYPTO_MAX; i++)
+		printf(" %s %llu", crypto_names[i],
+		       (unsigned long long)s.crypto_ops[i]);
+
+	printf("\n\n%-10s %7s %12s %12s\n", "latency", "count", "p50",
+	       "p99");
+	for (i = 0; i < SDO_STATS_MSG_MAX; i++) {
+		h = &s.msg_latency[i];
+		if (!h->count)
+			continue;
+		printf("msg%-7d %7u %9.3f ms %9.3f ms\n", i, h->count,
+		       bench_ms(sdo_sdk_stats_percentile(h, 50)),
+		       bench_ms(sdo_sdk_stats_percentile(h, 99)));
+	}
+}
+
+/* What sdo_sdk_get_heap_stats() saw, with an SDK built with HEAP_TRACK=true */
+static void bench_report_heap(void)
+{
+	static const char *const phase_names[SDO_HEAP_PHASE_NONE + 1] = {
+	    "DI", "TO1", "TO2", "none"};
+	static sdo_sdk_heap_stats s;
+	const sdo_sdk_heap_use *u;
+	int i;
+
+	if (sdo_sdk_get_heap_stats(&s) != SDO_SUCCESS)
+		return;
+
+	printf("\nheap: peak %llu bytes, %llu allocations, %llu bytes live "
+	       "in %llu, %llu over budget\n",
+	       (unsigned long long)s.total.peak_bytes,
+	       (unsigned long long)s.total.allocs,
+	       (unsigned long long)s.total.live_bytes,
+	       (unsigned long long)s.live_allocs,
+	       (unsigned long long)s.over_budget);
+	printf("leaked by the last session: %llu bytes in %llu allocations\n",
+	       (unsigned long long)s.leaked_bytes,
+	       (unsigned long long)s.leaked_allocs);
+
+	printf("\n%-10s %9s %12s %12s %12s\n", "heap", "allocs", "bytes",
+	       "live", "peak");
+	for (i = 0; i <= SDO_HEAP_PHASE_NONE; i++) {
+		u = &s.phase[i];
+		printf("%-10s %9llu %12llu %12llu %12llu\n", phase_names[i],
+		       (unsigned long long)u->allocs,
+		       (unsigned long long)u->alloc_bytes,
+		       (unsigned long long)u->live_bytes,
+		       (unsigned long long)u->peak_bytes);
+	}
+	for (i = 0; i < SDO_STATS_MSG_MAX; i++) {
+		u = &s.msg[i];
+		if (!u->allocs && !u->peak_bytes)
+			continue;
+		printf("msg%-7d %9llu %12llu %12llu %12llu\n", i,
+		       (unsigned long long)u->allocs,
+		       (unsigned long long)u->alloc_bytes,
+		       (unsigned long long)u->live_bytes,
+		       (unsigned long long)u->peak_bytes);
+	}
+
+	printf("\nallocations by size:");
+	for (i = 0; i < SDO_HEAP_SIZE_CLASSES; i++) {
+		if (!s.size_class[i])
+			continue;
+		if (i < SDO_HEAP_SIZE_CLASSES - 1)
+			printf(" <=%u:%llu", 16u << i,
+			       (unsigned long long)s.size_class[i]);
+		else
+			printf(" more:%llu",
+			       (unsigned long long)s.size_class[i]);
+	}
+	printf("\n");
+}
+
+static void bench_report(const lb_stats_t *st, const bench_run_stats_t *di,
+			 const bench_run_stats_t *to)
+{
+	const lb_msg_stats_t *m;
+	size_t p;
+	int t;
+
+	printf("\n%-10s %7s %12s %12s %12s %12s\n", "request", "count",
+	       "device avg", "device max", "server avg", "server max");
+	for (t = 0; t < LB_MAX_MSG_TYPE; t++) {
+		m = &st->msg[t];
+		if (!m->count)
+			continue;
+		printf("msg%-7d %7u %9.3f ms %9.3f ms %9.3f ms %9.3f ms\n",
+		       t, m->count, bench_ms(m->device_us / m->count),
+		       bench_ms(m->device_max_us),
+		       bench_ms(m->server_us / m->count),
+		       bench_ms(m->server_max_us));
+	}
+
+	printf("\n%-10s %7s %12s %12s\n", "phase", "msgs", "device", "server");
+	for (p = 0; p < sizeof(bench_phases) / sizeof(bench_phases[0]); p++) {
+		uint64_t dev = 0, srv = 0;
+		uint32_t cnt = 0;
+
+		for (t = bench_phases[p].first_msg;
+		     t <= bench_phases[p].last_msg; t++) {
+			cnt += st->msg[t].count;
+			dev += st->msg[t].device_us;
+			srv += st->msg[t].server_us;
+		}
+		printf("%-10s %7u %9.3f ms %9.3f ms\n", bench_phases[p].name,
+		       cnt, bench_ms(dev), bench_ms(srv));
+	}
+
+	printf("\n%-10s %7s %12s %12s %12s\n", "sdk run", "runs", "avg", "min",
+	       "max");
+	if (di->count)
+		printf("%-10s %7u %9.3f ms %9.3f ms %9.3f ms\n", "DI",
+		       di->count, bench_ms(di->total_us / di->count),
+		       bench_ms(di->min_us), bench_ms(di->max_us));
+	if (to->count)
+		printf("%-10s %7u %9.3f ms %9.3f ms %9.3f ms\n", "TO1+TO2",
+		       to->count, bench_ms(to->total_us / to->count),
+		       bench_ms(to->min_us), bench_ms(to->max_us));
+
+	printf("\ndropped %u, retries %u, sdk errors %u, device errors %u, "
+	       "protocol errors %u, TO2 done %u\n",
+	       st->dropped, retries, errors, st->device_errors,
+	       st->protocol_errors, st->to2_done);
+	bench_report_sdk_stats();
+	bench_report_heap();
+}
+
+/* Drive the SDK through the step API from our own poll() loop */
+static bool bench_async;
+
+/* Chrome trace of the runs, with an SDK built with TRACE=true */
+static const char *bench_trace_file;
+
+/* Log records dumped here on failure, with an SDK built with LOG_RING=true */
+static const char *bench_log_file;
+
+/* Heap the SDK may use, with an SDK built with HEAP_TRACK=true; 0 for any */
+static uint32_t bench_heap_budget;
+
+/**
+ * Run the SDK once, the way the chosen driver does it.
+ */
+static sdo_sdk_status bench_sdk_run(void)
+{
+	sdo_sdk_wait wait;
+	sdo_sdk_status status;
+	struct pollfd pfd;
+
+	if (!bench_async)
+		return sdo_sdk_run();
+
+	status = sdo_sdk_start();
+	while (status == SDO_SUCCESS) {
+		status = sdo_sdk_step(&wait);
+		if (status != SDO_IN_PROGRESS)
+			break;
+		if (wait.fd < 0) {
+			if (wait.timeout_ms > 0)
+				usleep((useconds_t)wait.timeout_ms * 1000);
+		} else {
+			pfd.fd = wait.fd;
+			pfd.events = 0;
+			if (wait.events & SDO_WAIT_READ)
+				pfd.events |= POLLIN;
+			if (wait.events & SDO_WAIT_WRITE)
+				pfd.events |= POLLOUT;
+			pfd.revents = 0;
+			(void)poll(&pfd, 1, wait.timeout_ms);
+		}
+		status = SDO_SUCCESS;
+	}
+	return status;
+}
+
+static void bench_usage(const char *prog)
+{
+	printf("Usage: %s [options]\n"
+	       "  -i N  TO1/TO2 iterations (default 1)\n"
+	       "  -e N  ownership voucher entries (default 1)\n"
+	       "  -d N  device service info values (default 2)\n"
+	       "  -D N  device service info value size (default 64)\n"
+	       "  -o N  owner service info rounds (default 1)\n"
+	       "  -k N  owner service info values per round (default 2)\n"
+	       "  -O N  owner service info value size (default 64)\n"
+	       "  -l MS delay before every server reply (default 0)\n"
+	       "  -p N  %% of requests dropped without reply (default 0)\n"
+	       "  -s N  seed for loss and OSI generation (default 1)\n"
+	       "  -a    drive the SDK with sdo_sdk_step() instead of "
+	       "sdo_sdk_run()\n"
+	       "  -w    hand owner service info to a worker thread\n"
+	       "  -W MS time each owner service info callback takes "
+	       "(default 0)\n"
+	       "  -f    build device service info ahead on a producer thread\n"
+	       "  -T MS time each device service info callback takes "
+	       "(default 0)\n"
+	       "  -t FILE write a Chrome trace of the runs to FILE\n"
+	       "  -L FILE dump the SDK log records to FILE if a run fails\n"
+	       "  -B N  fail if the SDK has more than N bytes of heap "
+	       "allocated\n",
+	       prog);
+}
+
+static bool bench_parse_args(int argc, char **argv, uint32_t *iterations,
+			     lb_config_t *cfg)
+{
+	int opt;
+	unsigned long v;
+	char *end;
+
+	while ((opt = getopt(argc, argv,
+			     "i:e:d:D:o:k:O:l:p:s:W:T:t:L:B:afwh")) != -1) {
+		if (opt == 'a') {
+			bench_async = true;
+			continue;
+		}
+		if (opt == 'w') {
+			bench_osi_worker = true;
+			continue;
+		}
+		if (opt == 'f') {
+			bench_dsi_prefetch = true;
+			continue;
+		}
+		if (opt == 't') {
+			bench_trace_file = optarg;
+			continue;
+		}
+		if (opt == 'L') {
+			bench_log_file = optarg;
+			continue;
+		}
+		if (opt == 'h' || !optarg) {
+			bench_usage(argv[0]);
+			return false;
+		}
+		v = strtoul(optarg, &end, 10);
+		if (*end || v > UINT32_MAX) {
+			bench_usage(argv[0]);
+			return false;
+		}
+		switch (opt) {
+		case 'i':
+			*iterations = (uint32_t)v;
+			break;
+		case 'e':
+			cfg->voucher_entries = (uint32_t)v;
+			break;
+		case 'd':
+			dsi_count = (uint32_t)v;
+			break;
+		case 'D':
+			dsi_len = (uint32_t)v;
+			break;
+		case 'o':
+			cfg->osi_rounds = (uint32_t)v;
+			break;
+		case 'k':
+			cfg->osi_kv_per_round = (uint32_t)v;
+			break;
+		case 'O':
+			cfg->osi_value_len = (uint32_t)v;
+			break;
+		case 'l':
+			cfg->delay_ms = (uint32_t)v;
+			break;
+		case 'p':
+			cfg->loss_pct = (uint32_t)v;
+			break;
+		case 's':
+			cfg->seed = (uint32_t)v;
+			break;
+		case 'W':
+			osi_work_ms = (uint32_t)v;
+			break;
+		case 'T':
+			dsi_work_ms = (uint32_t)v;
+			break;
+		case 'B':
+			bench_heap_budget = (uint32_t)v;
+			break;
+		default:
+			bench_usage(argv[0]);
+			return false;
+		}
+	}
+
+	/* Keep every message within the REST body limit of the device */
+	if (!*iterations || !cfg->voucher_entries ||
+	    cfg->voucher_entries > BENCH_MAX_ENTRIES ||
+	    dsi_count >= BENCH_MAX_ROUNDS || !dsi_len ||
+	    dsi_len > BENCH_MAX_DSI_LEN || cfg->osi_rounds > BENCH_MAX_ROUNDS ||
+	    !cfg->osi_value_len || cfg->osi_value_len > BENCH_MAX_OSI_LEN ||
+	    cfg->osi_kv_per_round * (cfg->osi_value_len + 24) >
+		BENCH_MAX_OSI_ROUND ||
+	    (cfg->osi_rounds && !cfg->osi_kv_per_round) ||
+	    cfg->loss_pct >= 50 || osi_work_ms > 1000 || dsi_work_ms > 1000) {
+		fprintf(stderr, "bench: parameters out of range\n");
+		return false;
+	}
+	return true;
+}
+
+/*==================================================================*/
+
+int main(int argc, char **argv)
+{
+	lb_config_t cfg = {1, 1, 2, 64, 0, 0, 1};
+	sdo_sdk_retry_policy net = {5, 100, 20};
+	sdo_sdk_retry_policy proto = {5, 200, 20};
+	sdo_sdk_service_info_module module;
+	bench_run_stats_t di = {0}, to = {0};
+	static sdo_sdk_heap_stats heap;
+	lb_stats_t st;
+	uint32_t iterations = 1, done = 0, runs = 0, to2_done, expect_osi;
+	sdo_sdk_device_state state;
+	sdo_sdk_status status;
+	char *saved_ip, *saved_port;
+	size_t ip_len, port_len;
+	uint64_t t0;
+	int ret = 1;
+
+	if (!bench_parse_args(argc, argv, &iterations, &cfg))
+		return 2;
+	memset(dsi_value, 'v', dsi_len);
+#ifdef MODULES_ENABLED
+	expect_osi = cfg.osi_rounds * cfg.osi_kv_per_round;
+#else
+	/* No module registered: OSI is delivered but dropped by the SDK */
+	expect_osi = 0;
+#endif
+
+	memset(&module, 0, sizeof(module));
+	if (strncpy_s(module.module_name, SDO_MODULE_NAME_LEN, LB_MODULE_NAME,
+		      SDO_MODULE_NAME_LEN) != 0)
+		return 1;
+	if (bench_osi_worker || bench_dsi_prefetch || dsi_work_ms) {
+		module.service_info_callback_v2 = bench_module_v2;
+		if (bench_osi_worker)
+			module.flags |= SDO_SI_FLAG_ASYNC_OSI;
+		if (bench_dsi_prefetch)
+			module.flags |= SDO_SI_FLAG_PREFETCH_DSI;
+	} else {
+		module.service_info_callback = bench_module;
+	}
+
+	sdo_sdk_set_retry_policy(SDO_RETRY_CONNECT, &net);
+	sdo_sdk_set_retry_policy(SDO_RETRY_NETIO, &net);
+	sdo_sdk_set_retry_policy(SDO_RETRY_DI, &proto);
+	sdo_sdk_set_retry_policy(SDO_RETRY_TO1, &proto);
+	sdo_sdk_set_retry_policy(SDO_RETRY_TO2, &proto);
+	sdo_sdk_register_retry_cb(bench_retry_cb);
+
+	saved_ip = bench_read_file(MANUFACTURER_IP, &ip_len);
+	saved_port = bench_read_file(MANUFACTURER_PORT, &port_len);
+
+	if (!lb_server_start(&cfg)) {
+		fprintf(stderr, "bench: cannot start loopback servers\n");
+		goto end;
+	}
+	if (!bench_provision())
+		goto stop;
+	if (bench_heap_budget &&
+	    sdo_sdk_set_heap_budget(bench_heap_budget) != SDO_SUCCESS) {
+		fprintf(stderr, "bench: no heap budget without HEAP_TRACK\n");
+		goto stop;
+	}
+	if (bench_trace_file &&
+	    sdo_sdk_trace_to_file(bench_trace_file) != SDO_SUCCESS) {
+		fprintf(stderr, "bench: cannot trace to %s\n",
+			bench_trace_file);
+		goto stop;
+	}
+
+	/* DI, then TO1/TO2 per iteration; bounded in case nothing progresses */
+	while (done < iterations && runs++ < 4 * iterations + 4) {
+		if (sdo_sdk_init(bench_error_cb, 1, &module) != SDO_SUCCESS) {
+			fprintf(stderr, "bench: sdo_sdk_init failed\n");
+			goto stop;
+		}
+
+		state = sdo_sdk_get_status();
+		if (state != SDO_STATE_PRE_DI && state != SDO_STATE_PRE_TO1) {
+			/* Onboarded without reuse: start over from DI */
+			sdo_sdk_deinit();
+			if (!bench_provision())
+				goto stop;
+			continue;
+		}
+
+		lb_server_get_stats(&st);
+		to2_done = st.to2_done;
+		osi_received = 0;
+		lb_server_mark();
+		t0 = bench_now_us();
+		status = bench_sdk_run();
+		if (state == SDO_STATE_PRE_DI) {
+			bench_run_add(&di, bench_now_us() - t0);
+			if (status != SDO_SUCCESS) {
+				fprintf(stderr, "bench: DI failed\n");
+				goto stop;
+			}
+			continue;
+		}
+		bench_run_add(&to, bench_now_us() - t0);
+
+		lb_server_get_stats(&st);
+		if (status != SDO_SUCCESS || st.to2_done == to2_done ||
+		    osi_received != expect_osi) {
+			fprintf(stderr,
+				"bench: iteration %u failed (OSI %u/%u)\n",
+				done, osi_received, expect_osi);
+			goto stop;
+		}
+		done++;
+	}
+	if (done == iterations)
+		ret = 0;
+
+stop:
+	/* Ends the last session: the SDK reports what it left allocated */
+	if (runs)
+		sdo_sdk_deinit();
+	if (bench_heap_budget && sdo_sdk_get_heap_stats(&heap) == SDO_SUCCESS &&
+	    heap.over_budget) {
+		fprintf(stderr, "bench: heap budget of %u bytes exceeded\n",
+			bench_heap_budget);
+		ret = 1;
+	}
+	if (bench_trace_file && sdo_sdk_trace_to_file(NULL) != SDO_SUCCESS)
+		ret = 1;
+	if (ret && bench_log_file) {
+		if (sdo_sdk_log_dump(bench_log_file) == SDO_SUCCESS)
+			fprintf(stderr, "bench: log records dumped to %s\n",
+				bench_log_file);
+		else
+			fprintf(stderr, "bench: cannot dump log records to "
+					"%s\n",
+				bench_log_file);
+	}
+	lb_server_get_stats(&st);
+	lb_server_stop();
+	bench_report(&st, &di, &to);
+	printf("\n%s: %u/%u iterations onboarded\n", ret ? "FAIL" : "PASS",
+	       done, iterations);
+
+end:
+	/* Leave the data directory as it was found */
+	bench_reset_device();
+	if (saved_ip)
+		bench_write_file(MANUFACTURER_IP, saved_ip, ip_len);
+	else
+		remove(MANUFACTURER_IP);
+	if (saved_port)
+		bench_write_file(MANUFACTURER_PORT, saved_port, port_len);
+	else
+		remove(MANUFACTURER_PORT);
+	free(saved_ip);
+	free(saved_port);
+	return ret;
+}
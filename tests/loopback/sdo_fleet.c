@@ -0,0 +1,1039 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Fleet onboarding load driver.
+ *
+ * Forks one worker process per device. Each worker gets a data directory of
+ * its own, copied from a template directory (data/ by default), starts its
+ * own loopback servers, waits for its arrival time and then runs DI and
+ * TO1/TO2 through sdo_sdk_run(). With -T the devices are threads of one
+ * process instead, each with an SDK context whose blob directory is its
+ * data directory, and the loopback servers of every device run in a
+ * process of their own. With -m, no loopback servers are started
+ * and the whole fleet is onboarded by the one manufacturer server given,
+ * and the rendezvous and owner servers it points the devices at. Arrivals
+ * follow a fixed rate with optional jitter. The parent collects the results
+ * from shared memory and reports throughput, per-phase latency percentiles
+ * and failure/retry counts. Exits non-zero unless every device onboarded.
+ */
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "sdo.h"
+#include "util.h"
+#include "blob.h"
+#include "safe_lib.h"
+#include "loopback_server.h"
+
+#define FLEET_MAX_DEVICES 1024
+#define FLEET_MAX_ENTRIES 64
+#define FLEET_MAX_ROUNDS 255
+#define FLEET_COPY_CHUNK 4096
+
+enum { FLEET_PENDING, FLEET_ONBOARDED, FLEET_FAILED };
+
+enum { FLEET_DI, FLEET_TO1, FLEET_TO2, FLEET_NUM_PHASES };
+
+typedef struct {
+	const char *name;
+	int first_msg;
+	int last_msg;
+} fleet_phase_t;
+
+/* One slot per device, in memory shared with the parent */
+typedef struct {
+	uint32_t state;
+	uint32_t retries;
+	uint32_t errors;
+	uint32_t dropped;
+	uint32_t protocol_errors;
+	uint64_t start_us; /* relative to the start of the fleet */
+	uint64_t end_us;
+	uint64_t phase_us[FLEET_NUM_PHASES];
+} fleet_result_t;
+
+typedef struct {
+	uint32_t devices;
+	uint32_t rate;	     /* arrivals per second, 0 for all at once */
+	uint32_t jitter_pct; /* spread of each inter-arrival gap */
+	const char *template_dir;
+	const char *base_dir;
+	bool keep;
+	bool threads; /* devices run as threads of one process */
+	char *mfg_host; /* shared manufacturer server, NULL for loopback */
+	const char *mfg_port;
+	lb_config_t lb;
+} fleet_config_t;
+
+static const fleet_phase_t fleet_phases[FLEET_NUM_PHASES] = {
+    {"DI", 10, 13}, {"TO1", 30, 33}, {"TO2", 40, 51}};
+
+/* Loopback servers of a device, in its own process for the threads of -T */
+typedef struct {
+	pid_t pid; /* 0 when they run in the calling process */
+	int fd;	   /* socket to the server process */
+	uint16_t mfg_port;
+} fleet_servers_t;
+
+/* What a device thread needs, see fleet_thread() */
+typedef struct {
+	const fleet_config_t *cfg;
+	uint32_t idx;
+	const char *root;
+	uint64_t start_us;
+	uint64_t t0;
+	fleet_servers_t *srv;
+} fleet_thread_arg_t;
+
+static fleet_result_t *results;
+/* Slot of the device the calling thread or process onboards */
+static __thread fleet_result_t *result;
+
+/* The platform keys are shared by the threads of -T and created by the
+ * first device that is provisioned
+ */
+static pthread_mutex_t fleet_provision_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Service info module of every device: one DSI value, and whatever OSI the
+ * owner sends is accepted.
+ */
+static int fleet_module(sdo_sdk_si_type type, int *count,
+			sdo_sdk_si_key_value *si)
+{
+	static char key[] = "fleet";
+	static char value[] = "loopback";
+
+	switch (type) {
+	case SDO_SI_START:
+	case SDO_SI_END:
+	case SDO_SI_FAILURE:
+	case SDO_SI_SET_PSI:
+	case SDO_SI_SET_OSI:
+		return SDO_SI_SUCCESS;
+	case SDO_SI_GET_DSI_COUNT:
+		*count = 1;
+		return SDO_SI_SUCCESS;
+	case SDO_SI_GET_DSI:
+		si->key = key;
+		si->value = value;
+		return SDO_SI_SUCCESS;
+	default:
+		return SDO_SI_INTERNAL_ERROR;
+	}
+}
+
+static int fleet_error_cb(sdo_sdk_status type, sdo_sdk_error errorcode)
+{
+	(void)type;
+	(void)errorcode;
+	result->errors++;
+	return SDO_SUCCESS;
+}
+
+static int fleet_retry_cb(sdo_sdk_retry_phase phase, uint32_t attempt,
+			  uint32_t delay_ms, uint32_t elapsed_ms)
+{
+	(void)phase;
+	(void)attempt;
+	(void)delay_ms;
+	(void)elapsed_ms;
+	result->retries++;
+	return SDO_SUCCESS;
+}
+
+static uint64_t fleet_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void fleet_sleep_until(uint64_t us)
+{
+	struct timespec ts = {(time_t)(us / 1000000),
+			      (long)(us % 1000000) * 1000};
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+	       EINTR)
+		;
+}
+
+/*==================================================================*/
+/* Device data directories */
+
+/* Path of a blob of the device in dir, or in the working directory */
+static bool fleet_path(char *path, size_t len, const char *dir,
+		       const char *name)
+{
+	if (!dir)
+		return snprintf(path, len, "%s", name) < (int)len;
+	return snprintf(path, len, "%s/%s", dir, name) < (int)len;
+}
+
+static bool fleet_write_file(const char *dir, const char *name,
+			     const void *data, size_t len)
+{
+	char path[PATH_MAX];
+	FILE *fp = NULL;
+	bool ret;
+
+	if (fleet_path(path, sizeof(path), dir, name))
+		fp = fopen(path, "wb");
+	if (!fp)
+		return false;
+	ret = (fwrite(data, 1, len, fp) == len);
+	if (fclose(fp) == EOF)
+		ret = false;
+	return ret;
+}
+
+static bool fleet_copy_file(const char *from, const char *to)
+{
+	char buf[FLEET_COPY_CHUNK];
+	FILE *in = fopen(from, "rb");
+	FILE *out = in ? fopen(to, "wb") : NULL;
+	bool ret = (out != NULL);
+	size_t n;
+
+	while (ret && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+		ret = (fwrite(buf, 1, n, out) == n);
+	if (in && ferror(in))
+		ret = false;
+	if (out && fclose(out) == EOF)
+		ret = false;
+	if (in)
+		fclose(in);
+	return ret;
+}
+
+/* Create <dir>/data holding a copy of every regular file of the template */
+static bool fleet_make_device_dir(const char *template_dir, const char *dir)
+{
+	char from[PATH_MAX], to[PATH_MAX];
+	struct dirent *de;
+	struct stat sb;
+	DIR *d = NULL;
+	bool ret = false;
+
+	if (snprintf(to, sizeof(to), "%s/data", dir) >= (int)sizeof(to) ||
+	    mkdir(dir, 0700) != 0 || mkdir(to, 0700) != 0)
+		goto end;
+
+	d = opendir(template_dir);
+	if (!d)
+		goto end;
+	while ((de = readdir(d)) != NULL) {
+		if (snprintf(from, sizeof(from), "%s/%s", template_dir,
+			     de->d_name) >= (int)sizeof(from) ||
+		    snprintf(to, sizeof(to), "%s/data/%s", dir, de->d_name) >=
+			(int)sizeof(to))
+			goto end;
+		if (stat(from, &sb) != 0 || !S_ISREG(sb.st_mode))
+			continue;
+		if (!fleet_copy_file(from, to))
+			goto end;
+	}
+	ret = true;
+end:
+	if (d)
+		closedir(d);
+	if (!ret)
+		fprintf(stderr, "fleet: cannot populate %s from %s\n", dir,
+			template_dir);
+	return ret;
+}
+
+/* Remove dir and everything below it */
+static void fleet_remove_dir(const char *dir)
+{
+	char path[PATH_MAX];
+	struct dirent *de;
+	struct stat sb;
+	DIR *d = opendir(dir);
+
+	while (d && (de = readdir(d)) != NULL) {
+		if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..") ||
+		    snprintf(path, sizeof(path), "%s/%s", dir, de->d_name) >=
+			(int)sizeof(path) ||
+		    lstat(path, &sb) != 0)
+			continue;
+		if (S_ISDIR(sb.st_mode))
+			fleet_remove_dir(path);
+		else
+			remove(path);
+	}
+	if (d)
+		closedir(d);
+	rmdir(dir);
+}
+
+/* Platform keys and IV of the process, generated on first use */
+static bool fleet_reset_keys(void)
+{
+	return fleet_write_file(NULL, PLATFORM_IV, "", 0) &&
+	       fleet_write_file(NULL, PLATFORM_HMAC_KEY, "", 0) &&
+	       fleet_write_file(NULL, PLATFORM_AES_KEY, "", 0);
+}
+
+/*
+ * Pristine device pointed at the manufacturer server: host is an IPv4
+ * address or a name the device resolves. dir is the blob directory of the
+ * device thread, NULL for a worker process.
+ */
+static bool fleet_provision(const char *dir, const char *host,
+			    const char *port)
+{
+	static const char normal[] = "{\"ST\":1}";
+	char path[PATH_MAX];
+	struct in_addr addr;
+	bool is_ip = (inet_pton(AF_INET, host, &addr) == 1);
+	bool ret = false;
+
+	if ((!dir && !fleet_reset_keys()) ||
+	    !fleet_write_file(dir, SDO_CRED_MFG, "", 0) ||
+	    !fleet_write_file(dir, SDO_CRED_SECURE, "", 0) ||
+	    !fleet_write_file(dir, RAW_BLOB, "", 0) ||
+	    !fleet_write_file(dir, SDO_CRED_NORMAL, normal,
+			      sizeof(normal) - 1) ||
+	    !fleet_write_file(dir, MANUFACTURER_IP, host,
+			      is_ip ? strlen(host) : 0) ||
+	    !fleet_write_file(dir, MANUFACTURER_DN, host,
+			      is_ip ? 0 : strlen(host)) ||
+	    !fleet_write_file(dir, MANUFACTURER_PORT, port, strlen(port)))
+		return false;
+	if (fleet_path(path, sizeof(path), dir, SDO_TO2_CHECKPOINT))
+		remove(path);
+#ifdef CRED_STORE_ENABLED
+	if (fleet_path(path, sizeof(path), dir, SDO_CRED_STORE))
+		remove(path);
+#endif
+	pthread_mutex_lock(&fleet_provision_lock);
+	ret = (configure_normal_blob() != -1);
+	pthread_mutex_unlock(&fleet_provision_lock);
+	return ret;
+}
+
+/*==================================================================*/
+/* Loopback servers */
+
+static bool fleet_send(int fd, const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+	ssize_t n;
+
+	while (len) {
+		n = write(fd, p, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		len -= (size_t)n;
+	}
+	return true;
+}
+
+static bool fleet_recv(int fd, void *buf, size_t len)
+{
+	uint8_t *p = buf;
+	ssize_t n;
+
+	while (len) {
+		n = read(fd, p, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		len -= (size_t)n;
+	}
+	return true;
+}
+
+static bool fleet_servers_start(const lb_config_t *lb, fleet_servers_t *srv)
+{
+	if (!lb_server_start(lb))
+		return false;
+	srv->pid = 0;
+	srv->fd = -1;
+	srv->mfg_port = lb_server_mfg_port();
+	return true;
+}
+
+/*
+ * Start the servers of a device thread in a process of their own. The
+ * process marks the start of a run and hands over its statistics on the
+ * requests of fleet_servers_mark() and fleet_servers_stop(). Must be called
+ * before any thread is started.
+ */
+static bool fleet_servers_fork(const lb_config_t *lb, fleet_servers_t *srv)
+{
+	lb_stats_t st;
+	int sv[2];
+	char cmd;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+		return false;
+	fflush(stdout);
+	srv->pid = fork();
+	if (srv->pid < 0) {
+		close(sv[0]);
+		close(sv[1]);
+		return false;
+	}
+	if (srv->pid == 0) {
+		close(sv[0]);
+		if (!lb_server_start(lb))
+			_exit(1);
+		srv->mfg_port = lb_server_mfg_port();
+		if (fleet_send(sv[1], &srv->mfg_port, sizeof(srv->mfg_port))) {
+			while (fleet_recv(sv[1], &cmd, 1) && cmd == 'm') {
+				lb_server_mark();
+				if (!fleet_send(sv[1], &cmd, 1))
+					break;
+			}
+		}
+		lb_server_get_stats(&st);
+		lb_server_stop();
+		(void)fleet_send(sv[1], &st, sizeof(st));
+		_exit(0);
+	}
+	close(sv[1]);
+	srv->fd = sv[0];
+	return fleet_recv(srv->fd, &srv->mfg_port, sizeof(srv->mfg_port));
+}
+
+/* Start of a run: device time is counted from here */
+static bool fleet_servers_mark(const fleet_servers_t *srv)
+{
+	char cmd = 'm';
+
+	if (!srv->pid) {
+		lb_server_mark();
+		return true;
+	}
+	return fleet_send(srv->fd, &cmd, 1) && fleet_recv(srv->fd, &cmd, 1);
+}
+
+/* Stop the servers, leaving what they saw in st */
+static bool fleet_servers_stop(fleet_servers_t *srv, lb_stats_t *st)
+{
+	char cmd = 's';
+	bool ret;
+
+	if (!srv->pid) {
+		lb_server_get_stats(st);
+		lb_server_stop();
+		return true;
+	}
+	ret = fleet_send(srv->fd, &cmd, 1) &&
+	      fleet_recv(srv->fd, st, sizeof(*st));
+	close(srv->fd);
+	srv->fd = -1;
+	waitpid(srv->pid, NULL, 0);
+	srv->pid = 0;
+	return ret;
+}
+
+/*==================================================================*/
+/* Worker */
+
+/**
+ * Onboard device idx once, from DI to the end of TO2, and leave the outcome
+ * in result. A worker process works in the device directory; a device
+ * thread gets its blob directory dir and the servers srv already running.
+ * The phase latency is taken from the loopback servers, device time
+ * included, or with a shared server from the SDK's round trip times.
+ */
+static bool fleet_onboard(const fleet_config_t *cfg, uint32_t idx,
+			  const char *dir, fleet_servers_t *srv,
+			  uint64_t start_us, uint64_t t0)
+{
+	sdo_sdk_retry_policy net = {5, 100, 20};
+	sdo_sdk_retry_policy proto = {5, 200, 20};
+	sdo_sdk_service_info_module module;
+	fleet_servers_t own;
+	lb_config_t lb = cfg->lb;
+	lb_stats_t st;
+	static sdo_sdk_stats sdk_st;
+	sdo_sdk_device_state state;
+	sdo_sdk_status status;
+	char port[8];
+	bool ret = false;
+	int t, p;
+
+	memset(&module, 0, sizeof(module));
+	if (strncpy_s(module.module_name, SDO_MODULE_NAME_LEN, LB_MODULE_NAME,
+		      SDO_MODULE_NAME_LEN) != 0)
+		return false;
+	module.service_info_callback = fleet_module;
+
+	sdo_sdk_set_retry_policy(SDO_RETRY_CONNECT, &net);
+	sdo_sdk_set_retry_policy(SDO_RETRY_NETIO, &net);
+	sdo_sdk_set_retry_policy(SDO_RETRY_DI, &proto);
+	sdo_sdk_set_retry_policy(SDO_RETRY_TO1, &proto);
+	sdo_sdk_set_retry_policy(SDO_RETRY_TO2, &proto);
+	sdo_sdk_register_retry_cb(fleet_retry_cb);
+
+	if (cfg->mfg_host) {
+		ret = fleet_provision(dir, cfg->mfg_host, cfg->mfg_port);
+	} else {
+		if (!srv) {
+			lb.seed += idx;
+			srv = &own;
+			if (!fleet_servers_start(&lb, srv)) {
+				fprintf(stderr,
+					"fleet: device %u: cannot start "
+					"servers\n",
+					idx);
+				return false;
+			}
+		}
+		ret = (snprintf(port, sizeof(port), "%u",
+				(unsigned int)srv->mfg_port) > 0 &&
+		       fleet_provision(dir, "127.0.0.1", port));
+	}
+	if (!ret) {
+		fprintf(stderr, "fleet: device %u: cannot provision\n", idx);
+		goto stop;
+	}
+	ret = false;
+
+	fleet_sleep_until(t0 + start_us);
+	result->start_us = fleet_now_us() - t0;
+
+	/* DI, then TO1/TO2 on the voucher DI produced, one session each */
+	for (p = 0; p < 2; p++) {
+		if (sdo_sdk_init(fleet_error_cb, 1, &module) != SDO_SUCCESS)
+			goto stop;
+		state = sdo_sdk_get_status();
+		if (state != (p ? SDO_STATE_PRE_TO1 : SDO_STATE_PRE_DI)) {
+			fprintf(stderr, "fleet: device %u: unexpected state %d\n",
+				idx, (int)state);
+			sdo_sdk_deinit();
+			goto stop;
+		}
+		if (!cfg->mfg_host && !fleet_servers_mark(srv)) {
+			sdo_sdk_deinit();
+			goto stop;
+		}
+		status = sdo_sdk_run();
+		sdo_sdk_deinit();
+		if (status != SDO_SUCCESS) {
+			fprintf(stderr, "fleet: device %u: %s failed\n", idx,
+				p ? "TO1/TO2" : "DI");
+			goto stop;
+		}
+	}
+	ret = true;
+
+stop:
+	result->end_us = fleet_now_us() - t0;
+	if (cfg->mfg_host) {
+		if (sdo_sdk_get_stats(&sdk_st) != SDO_SUCCESS)
+			return false;
+		for (p = 0; p < FLEET_NUM_PHASES; p++) {
+			for (t = fleet_phases[p].first_msg;
+			     t <= fleet_phases[p].last_msg; t++)
+				result->phase_us[p] +=
+				    sdk_st.msg_latency[t].sum_us;
+		}
+		return ret;
+	}
+
+	if (!fleet_servers_stop(srv, &st))
+		return false;
+	ret = ret && st.to2_done == 1;
+
+	/* Phase latency as seen by the servers, device time included */
+	for (p = 0; p < FLEET_NUM_PHASES; p++) {
+		for (t = fleet_phases[p].first_msg;
+		     t <= fleet_phases[p].last_msg; t++)
+			result->phase_us[p] +=
+			    st.msg[t].device_us + st.msg[t].server_us;
+	}
+	result->dropped = st.dropped;
+	result->protocol_errors = st.protocol_errors;
+	return ret;
+}
+
+/**
+ * Body of the worker process of device idx.
+ */
+static bool fleet_device(const fleet_config_t *cfg, uint32_t idx,
+			 const char *root, uint64_t start_us, uint64_t t0)
+{
+	char dir[PATH_MAX];
+
+	/* The SDK log of each device goes next to its data */
+	if (snprintf(dir, sizeof(dir), "%s/dev%u", root, idx) >=
+		(int)sizeof(dir) ||
+	    chdir(dir) != 0 || !freopen("sdo.log", "w", stdout)) {
+		fprintf(stderr, "fleet: device %u: cannot enter %s\n", idx,
+			dir);
+		return false;
+	}
+	return fleet_onboard(cfg, idx, NULL, NULL, start_us, t0);
+}
+
+/**
+ * Body of the thread of device idx with -T: the device has an SDK context
+ * of its own, which finds its blobs in the device directory.
+ */
+static void *fleet_thread(void *arg)
+{
+	const fleet_thread_arg_t *a = arg;
+	char dir[PATH_MAX];
+	sdo_sdk_ctx *ctx = sdo_sdk_ctx_new();
+	lb_stats_t st;
+	bool ret = false;
+
+	result = results + a->idx;
+	if (snprintf(dir, sizeof(dir), "%s/dev%u", a->root, a->idx) >=
+		(int)sizeof(dir) ||
+	    !ctx || sdo_sdk_ctx_use(ctx) != SDO_SUCCESS ||
+	    sdo_sdk_ctx_set_blob_dir(ctx, dir) != SDO_SUCCESS) {
+		fprintf(stderr, "fleet: device %u: cannot set up a context\n",
+			a->idx);
+		if (a->srv->pid)
+			fleet_servers_stop(a->srv, &st);
+	} else {
+		ret = fleet_onboard(a->cfg, a->idx, dir, a->srv, a->start_us,
+				    a->t0);
+	}
+	result->state = ret ? FLEET_ONBOARDED : FLEET_FAILED;
+	sdo_sdk_ctx_use(NULL);
+	sdo_sdk_ctx_free(ctx);
+	return NULL;
+}
+
+/*==================================================================*/
+/* Report */
+
+static double fleet_ms(uint64_t us)
+{
+	return (double)us / 1000.0;
+}
+
+static int fleet_cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of n sorted samples */
+static uint64_t fleet_pct(const uint64_t *v, uint32_t n, uint32_t pct)
+{
+	uint32_t rank = (uint32_t)(((uint64_t)n * pct + 99) / 100);
+
+	return v[rank ? rank - 1 : 0];
+}
+
+static void fleet_report_row(const char *name, uint64_t *v, uint32_t n)
+{
+	if (!n) {
+		printf("%-10s %7u\n", name, 0);
+		return;
+	}
+	qsort(v, n, sizeof(*v), fleet_cmp_u64);
+	printf("%-10s %7u %9.3f ms %9.3f ms %9.3f ms %9.3f ms\n", name, n,
+	       fleet_ms(fleet_pct(v, n, 50)), fleet_ms(fleet_pct(v, n, 90)),
+	       fleet_ms(fleet_pct(v, n, 99)), fleet_ms(v[n - 1]));
+}
+
+static uint32_t fleet_report(const fleet_config_t *cfg,
+			     const fleet_result_t *res, uint32_t crashed)
+{
+	uint64_t *v = calloc(cfg->devices, sizeof(*v));
+	uint64_t first = UINT64_MAX, last = 0;
+	uint32_t done = 0, retries = 0, errors = 0, dropped = 0, proto = 0;
+	uint32_t i, n, p;
+	double wall;
+
+	for (i = 0; i < cfg->devices; i++) {
+		retries += res[i].retries;
+		errors += res[i].errors;
+		dropped += res[i].dropped;
+		proto += res[i].protocol_errors;
+		if (res[i].state != FLEET_ONBOARDED)
+			continue;
+		done++;
+		if (res[i].start_us < first)
+			first = res[i].start_us;
+		if (res[i].end_us > last)
+			last = res[i].end_us;
+	}
+
+	wall = done ? (double)(last - first) / 1000000.0 : 0.0;
+	printf("\n%u devices, %u onboarded in %.3f s: %.2f devices/s",
+	       cfg->devices, done, wall, wall > 0.0 ? done / wall : 0.0);
+	if (cfg->rate)
+		printf(" (offered %u/s, jitter %u%%)", cfg->rate,
+		       cfg->jitter_pct);
+	printf("\n");
+
+	printf("\n%-10s %7s %12s %12s %12s %12s\n", "phase", "devices", "p50",
+	       "p90", "p99", "max");
+	if (cfg->mfg_host)
+		printf("(phases: round trips as seen by the devices)\n");
+	for (p = 0; v && p <= FLEET_NUM_PHASES; p++) {
+		for (i = 0, n = 0; i < cfg->devices; i++) {
+			if (res[i].state != FLEET_ONBOARDED)
+				continue;
+			v[n++] = p < FLEET_NUM_PHASES
+				     ? res[i].phase_us[p]
+				     : res[i].end_us - res[i].start_us;
+		}
+		fleet_report_row(p < FLEET_NUM_PHASES ? fleet_phases[p].name
+						      : "onboard",
+				 v, n);
+	}
+	free(v);
+
+	printf("\nfailed %u, crashed %u, retries %u, sdk errors %u, "
+	       "dropped %u, protocol errors %u\n",
+	       cfg->devices - done, crashed, retries, errors, dropped, proto);
+	return done;
+}
+
+/*==================================================================*/
+
+static void fleet_usage(const char *prog)
+{
+	printf("Usage: %s [options]\n"
+	       "  -n N   devices, one worker process each (default 4)\n"
+	       "  -T     one thread per device in a single process, each on\n"
+	       "         an SDK context of its own\n"
+	       "  -r N   arrivals per second, 0 for all at once (default 0)\n"
+	       "  -j N   %% jitter of each inter-arrival gap (default 0)\n"
+	       "  -t DIR template data directory (default data)\n"
+	       "  -w DIR where device directories are created (default /tmp)\n"
+	       "  -K     keep the device directories and their sdo.log\n"
+	       "  -m HOST:PORT\n"
+	       "         manufacturer server shared by the fleet, instead of\n"
+	       "         loopback servers per device; -e to -p do not apply\n"
+	       "  -e N   ownership voucher entries (default 1)\n"
+	       "  -o N   owner service info rounds (default 1)\n"
+	       "  -k N   owner service info values per round (default 2)\n"
+	       "  -l MS  delay before every server reply (default 0)\n"
+	       "  -p N   %% of requests dropped without reply (default 0)\n"
+	       "  -s N   seed for arrivals, loss and OSI (default 1)\n",
+	       prog);
+}
+
+static bool fleet_parse_args(int argc, char **argv, fleet_config_t *cfg)
+{
+	int opt;
+	unsigned long v;
+	char *end;
+
+	while ((opt = getopt(argc, argv, "n:r:j:t:w:KTm:e:o:k:l:p:s:h")) !=
+	       -1) {
+		if (opt == 'h') {
+			fleet_usage(argv[0]);
+			return false;
+		}
+		if (opt == 't') {
+			cfg->template_dir = optarg;
+			continue;
+		}
+		if (opt == 'w') {
+			cfg->base_dir = optarg;
+			continue;
+		}
+		if (opt == 'K') {
+			cfg->keep = true;
+			continue;
+		}
+		if (opt == 'T') {
+			cfg->threads = true;
+			continue;
+		}
+		if (opt == 'm') {
+			end = strrchr(optarg, ':');
+			if (!end || end == optarg) {
+				fleet_usage(argv[0]);
+				return false;
+			}
+			*end = '\0';
+			cfg->mfg_host = optarg;
+			cfg->mfg_port = end + 1;
+			v = strtoul(cfg->mfg_port, &end, 10);
+			if (*end || !v || v > UINT16_MAX) {
+				fleet_usage(argv[0]);
+				return false;
+			}
+			continue;
+		}
+		if (!optarg) {
+			fleet_usage(argv[0]);
+			return false;
+		}
+		v = strtoul(optarg, &end, 10);
+		if (*end || v > UINT32_MAX) {
+			fleet_usage(argv[0]);
+			return false;
+		}
+		switch (opt) {
+		case 'n':
+			cfg->devices = (uint32_t)v;
+			break;
+		case 'r':
+			cfg->rate = (uint32_t)v;
+			break;
+		case 'j':
+			cfg->jitter_pct = (uint32_t)v;
+			break;
+		case 'e':
+			cfg->lb.voucher_entries = (uint32_t)v;
+			break;
+		case 'o':
+			cfg->lb.osi_rounds = (uint32_t)v;
+			break;
+		case 'k':
+			cfg->lb.osi_kv_per_round = (uint32_t)v;
+			break;
+		case 'l':
+			cfg->lb.delay_ms = (uint32_t)v;
+			break;
+		case 'p':
+			cfg->lb.loss_pct = (uint32_t)v;
+			break;
+		case 's':
+			cfg->lb.seed = (uint32_t)v;
+			break;
+		default:
+			fleet_usage(argv[0]);
+			return false;
+		}
+	}
+
+	if (!cfg->devices || cfg->devices > FLEET_MAX_DEVICES ||
+	    cfg->jitter_pct > 100 || !cfg->lb.voucher_entries ||
+	    cfg->lb.voucher_entries > FLEET_MAX_ENTRIES ||
+	    cfg->lb.osi_rounds > FLEET_MAX_ROUNDS ||
+	    (cfg->lb.osi_rounds && !cfg->lb.osi_kv_per_round) ||
+	    cfg->lb.osi_kv_per_round * (cfg->lb.osi_value_len + 24) > 2048 ||
+	    cfg->lb.loss_pct >= 50) {
+		fprintf(stderr, "fleet: parameters out of range\n");
+		return false;
+	}
+	/* The SDK statistics the phases come from with -m are per process */
+	if (cfg->threads && cfg->mfg_host) {
+		fprintf(stderr, "fleet: -T and -m cannot be combined\n");
+		return false;
+	}
+	return true;
+}
+
+/* Arrival time of every device: evenly spaced at the rate, each gap
+ * stretched or shrunk by up to jitter_pct percent */
+static void fleet_schedule(const fleet_config_t *cfg, uint64_t *start_us)
+{
+	unsigned int seed = cfg->lb.seed;
+	uint64_t at = 0;
+	int64_t gap, spread;
+	uint32_t i;
+
+	for (i = 0; i < cfg->devices; i++) {
+		start_us[i] = at;
+		if (!cfg->rate)
+			continue;
+		gap = 1000000 / cfg->rate;
+		spread = gap * cfg->jitter_pct / 100;
+		if (spread)
+			gap += (int64_t)(rand_r(&seed) % (2 * spread + 1)) -
+			       spread;
+		at += (uint64_t)gap;
+	}
+}
+
+/*
+ * Onboard the fleet as threads of this process. The loopback servers of
+ * every device are forked before the first thread starts, the platform
+ * keys go to root/data and the SDK log to root/sdo.log.
+ */
+static void fleet_run_threads(const fleet_config_t *cfg, const char *root,
+			      const uint64_t *start_us, uint64_t t0)
+{
+	fleet_thread_arg_t *args = calloc(cfg->devices, sizeof(*args));
+	fleet_servers_t *srv = calloc(cfg->devices, sizeof(*srv));
+	pthread_t *threads = calloc(cfg->devices, sizeof(*threads));
+	char path[PATH_MAX];
+	lb_config_t lb;
+	lb_stats_t st;
+	uint32_t i, forked = 0, started = 0;
+	int out = -1;
+
+	if (!args || !srv || !threads ||
+	    snprintf(path, sizeof(path), "%s/data", root) >=
+		(int)sizeof(path) ||
+	    mkdir(path, 0700) != 0 || chdir(root) != 0 || !fleet_reset_keys())
+		goto end;
+
+	for (; forked < cfg->devices; forked++) {
+		lb = cfg->lb;
+		lb.seed += forked;
+		if (!fleet_servers_fork(&lb, &srv[forked])) {
+			fprintf(stderr,
+				"fleet: device %u: cannot start servers\n",
+				forked);
+			if (srv[forked].pid > 0)
+				fleet_servers_stop(&srv[forked], &st);
+			goto end;
+		}
+	}
+
+	fflush(stdout);
+	out = dup(STDOUT_FILENO);
+	if (out < 0 || !freopen("sdo.log", "w", stdout))
+		goto end;
+	for (; started < cfg->devices; started++) {
+		args[started] = (fleet_thread_arg_t){cfg, started, root,
+						     start_us[started], t0,
+						     &srv[started]};
+		if (pthread_create(&threads[started], NULL, fleet_thread,
+				   &args[started]) != 0) {
+			fprintf(stderr, "fleet: cannot start a thread\n");
+			break;
+		}
+	}
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+end:
+	/* Servers of the devices that never ran */
+	for (i = started; i < forked; i++)
+		fleet_servers_stop(&srv[i], &st);
+	if (out >= 0) {
+		fflush(stdout);
+		dup2(out, STDOUT_FILENO);
+		close(out);
+	}
+	free(args);
+	free(srv);
+	free(threads);
+}
+
+int main(int argc, char **argv)
+{
+	fleet_config_t cfg = {4, 0, 0, "data", "/tmp", false, false,
+			      NULL, NULL, {1, 1, 2, 64, 0, 0, 1}};
+	char base[PATH_MAX], root[PATH_MAX], dir[PATH_MAX];
+	char template_dir[PATH_MAX];
+	uint64_t *start_us = NULL, t0;
+	pid_t *pids = NULL;
+	uint32_t i, forked = 0, crashed = 0, done;
+	int status, ret = 1;
+
+	if (!fleet_parse_args(argc, argv, &cfg))
+		return 2;
+
+	/* Every worker finds its blobs relative to its own directory */
+	if (SDO_CRED_NORMAL[0] == '/') {
+		fprintf(stderr, "fleet: blob paths are absolute, build with a "
+				"relative BLOB_PATH\n");
+		return 2;
+	}
+	if (!realpath(cfg.template_dir, template_dir)) {
+		fprintf(stderr, "fleet: no template directory %s\n",
+			cfg.template_dir);
+		return 2;
+	}
+
+	/* The process moves into root with -T, its name must be a full one */
+	if (snprintf(base, sizeof(base), "%s/sdo-fleet.XXXXXX",
+		     cfg.base_dir) >= (int)sizeof(base) ||
+	    !mkdtemp(base) || !realpath(base, root)) {
+		fprintf(stderr, "fleet: cannot create a directory in %s\n",
+			cfg.base_dir);
+		return 2;
+	}
+
+	results = mmap(NULL, cfg.devices * sizeof(*results),
+		       PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1,
+		       0);
+	start_us = calloc(cfg.devices, sizeof(*start_us));
+	pids = calloc(cfg.devices, sizeof(*pids));
+	if (results == MAP_FAILED || !start_us || !pids) {
+		results = NULL;
+		goto end;
+	}
+	memset(results, 0, cfg.devices * sizeof(*results));
+
+	for (i = 0; i < cfg.devices; i++) {
+		if (snprintf(dir, sizeof(dir), "%s/dev%u", root, i) >=
+			(int)sizeof(dir) ||
+		    !fleet_make_device_dir(template_dir, dir))
+			goto end;
+	}
+	fleet_schedule(&cfg, start_us);
+
+	/* Leave every worker time to set up before the first arrival */
+	t0 = fleet_now_us() + 100000;
+	fflush(stdout);
+	if (cfg.threads)
+		fleet_run_threads(&cfg, root, start_us, t0);
+	for (i = 0; !cfg.threads && i < cfg.devices; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			fprintf(stderr, "fleet: fork failed\n");
+			break;
+		}
+		if (pids[i] == 0) {
+			result = results + i;
+			result->state = fleet_device(&cfg, i, root, start_us[i],
+						     t0)
+					    ? FLEET_ONBOARDED
+					    : FLEET_FAILED;
+			fflush(stdout);
+			_exit(result->state == FLEET_ONBOARDED ? 0 : 1);
+		}
+		forked++;
+	}
+
+	for (i = 0; i < forked; i++) {
+		if (waitpid(pids[i], &status, 0) != pids[i] ||
+		    !WIFEXITED(status) ||
+		    (WEXITSTATUS(status) && results[i].state != FLEET_FAILED)) {
+			crashed++;
+			results[i].state = FLEET_FAILED;
+		}
+	}
+
+	done = fleet_report(&cfg, results, crashed);
+	if (done == cfg.devices)
+		ret = 0;
+	printf("\n%s: %u/%u devices onboarded\n", ret ? "FAIL" : "PASS", done,
+	       cfg.devices);
+
+end:
+	if (cfg.keep)
+		printf("device directories kept in %s\n", root);
+	else
+		fleet_remove_dir(root);
+	if (results)
+		munmap(results, cfg.devices * sizeof(*results));
+	free(start_us);
+	free(pids);
+	return ret;
+}
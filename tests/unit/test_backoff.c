@@ -0,0 +1,175 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Unit tests for the retry/backoff scheduler of SDO library.
+ */
+
+#include "util.h"
+#include "sdobackoff.h"
+#include "network_al.h"
+#include "unity.h"
+
+#ifdef TARGET_OS_LINUX
+/*** Unity Declarations. ***/
+void set_up(void);
+void tear_down(void);
+void test_backoff_delay_bounds(void);
+void test_backoff_max_attempts(void);
+void test_backoff_floor(void);
+void test_backoff_budget(void);
+void test_backoff_callback_abort(void);
+void test_backoff_invalid_policy(void);
+
+/*** Unity functions. ***/
+void set_up(void)
+{
+}
+
+void tear_down(void)
+{
+	sdo_backoff_reset_policies();
+}
+#endif
+
+static uint32_t cb_calls;
+static int retry_cb(sdo_sdk_retry_phase phase, uint32_t attempt,
+		    uint32_t delay_ms, uint32_t elapsed_ms)
+{
+	(void)phase;
+	(void)delay_ms;
+	(void)elapsed_ms;
+	cb_calls++;
+	return (attempt >= 2) ? SDO_ABORT : SDO_SUCCESS;
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("backoff_delay_bounds", "[backoff][sdo]")
+#else
+void test_backoff_delay_bounds(void)
+#endif
+{
+	sdo_sdk_retry_policy p = {100, 5000, 0};
+	sdo_backoff_t bo;
+	uint32_t prev = p.base_ms, delay = 0;
+
+	sdo_backoff_reset_policies();
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS,
+			      sdo_sdk_set_retry_policy(SDO_RETRY_CONNECT, &p));
+	sdo_backoff_init(&bo, SDO_RETRY_CONNECT);
+
+	for (int i = 0; i < 50; i++) {
+		TEST_ASSERT_TRUE(sdo_backoff_next(&bo, &delay));
+		TEST_ASSERT_TRUE(delay >= p.base_ms);
+		TEST_ASSERT_TRUE(delay <= p.cap_ms);
+		TEST_ASSERT_TRUE(delay <= prev * 3);
+		prev = delay;
+	}
+	TEST_ASSERT_EQUAL_UINT32(50, bo.attempt);
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("backoff_max_attempts", "[backoff][sdo]")
+#else
+void test_backoff_max_attempts(void)
+#endif
+{
+	sdo_sdk_retry_policy p = {0, 10, 3};
+	sdo_backoff_t bo;
+	uint32_t delay = 0;
+
+	sdo_backoff_reset_policies();
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS,
+			      sdo_sdk_set_retry_policy(SDO_RETRY_NETIO, &p));
+	sdo_backoff_init(&bo, SDO_RETRY_NETIO);
+
+	TEST_ASSERT_TRUE(sdo_backoff_next(&bo, &delay));
+	TEST_ASSERT_TRUE(sdo_backoff_next(&bo, &delay));
+	TEST_ASSERT_TRUE(sdo_backoff_next(&bo, &delay));
+	TEST_ASSERT_FALSE(sdo_backoff_next(&bo, &delay));
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("backoff_floor", "[backoff][sdo]")
+#else
+void test_backoff_floor(void)
+#endif
+{
+	sdo_sdk_retry_policy p = {10, 20, 0};
+	sdo_backoff_t bo;
+	uint32_t delay = 0;
+
+	sdo_backoff_reset_policies();
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS,
+			      sdo_sdk_set_retry_policy(SDO_RETRY_TO1, &p));
+	sdo_backoff_init(&bo, SDO_RETRY_TO1);
+	sdo_backoff_set_floor(&bo, 120000);
+
+	TEST_ASSERT_TRUE(sdo_backoff_next(&bo, &delay));
+	TEST_ASSERT_EQUAL_UINT32(120000, delay);
+	/* delaysec * 1000 beyond 32 bits is clamped, not wrapped */
+	sdo_backoff_set_floor(&bo, (uint64_t)UINT32_MAX * 1000);
+	TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, bo.floor_ms);
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("backoff_budget", "[backoff][sdo]")
+#else
+void test_backoff_budget(void)
+#endif
+{
+	sdo_sdk_retry_policy p = {1000, 1000, 0};
+	sdo_backoff_t bo;
+	uint32_t delay = 0;
+
+	sdo_backoff_reset_policies();
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS,
+			      sdo_sdk_set_retry_policy(SDO_RETRY_TO2, &p));
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_set_retry_budget(1500));
+	sdo_backoff_budget_start();
+	sdo_backoff_init(&bo, SDO_RETRY_TO2);
+
+	TEST_ASSERT_TRUE(sdo_backoff_next(&bo, &delay));
+	TEST_ASSERT_EQUAL_UINT32(1000, delay);
+
+	/* Budget is consumed by wall time, not by computed delays */
+	sdo_msleep(600);
+	TEST_ASSERT_FALSE(sdo_backoff_next(&bo, &delay));
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("backoff_callback_abort", "[backoff][sdo]")
+#else
+void test_backoff_callback_abort(void)
+#endif
+{
+	sdo_backoff_t bo;
+	uint32_t delay = 0;
+
+	sdo_backoff_reset_policies();
+	cb_calls = 0;
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_register_retry_cb(retry_cb));
+	sdo_backoff_init(&bo, SDO_RETRY_DI);
+
+	TEST_ASSERT_TRUE(sdo_backoff_next(&bo, &delay));
+	TEST_ASSERT_FALSE(sdo_backoff_next(&bo, &delay));
+	TEST_ASSERT_EQUAL_UINT32(2, cb_calls);
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("backoff_invalid_policy", "[backoff][sdo]")
+#else
+void test_backoff_invalid_policy(void)
+#endif
+{
+	sdo_sdk_retry_policy p = {10, 5, 0};
+
+	TEST_ASSERT_EQUAL_INT(SDO_ERROR,
+			      sdo_sdk_set_retry_policy(SDO_RETRY_CONNECT, &p));
+	TEST_ASSERT_EQUAL_INT(SDO_ERROR, sdo_sdk_set_retry_policy(
+					     SDO_RETRY_PHASE_MAX, NULL));
+	TEST_ASSERT_FALSE(sdo_backoff_next(NULL, NULL));
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Unit tests for the chunked blob streams of the storage layer.
+ */
+
+#include "util.h"
+#include "storage_al.h"
+#include "sdoCrypto.h"
+#include "sdoCryptoHal.h"
+#include "safe_lib.h"
+#include "unity.h"
+
+#ifdef TARGET_OS_LINUX
+/*** Unity Declarations. ***/
+void set_up(void);
+void tear_down(void);
+void test_blob_stream_normal_large(void);
+void test_blob_stream_secure_large(void);
+void test_blob_stream_tampered(void);
+void test_blob_stream_small_compat(void);
+
+/*** Unity functions. ***/
+void set_up(void)
+{
+}
+
+void tear_down(void)
+{
+}
+#endif
+
+#define TEST_STREAM_BLOB "/tmp/sdo_test_stream.blob"
+/* Larger than R_MAX_SIZE */
+#define TEST_STREAM_LEN (3 * R_MAX_SIZE + 123)
+
+/**
+ * Internal API
+ * Make sure the platform keys the blobs are sealed with exist.
+ */
+static void stream_init(void)
+{
+	FILE *fp = NULL;
+
+	/* an empty key file has a key generated on first use */
+	fp = fopen((const char *)PLATFORM_AES_KEY, "a");
+	TEST_ASSERT_NOT_NULL(fp);
+	TEST_ASSERT_EQUAL_INT(0, fclose(fp));
+	TEST_ASSERT_EQUAL_INT(0, random_init());
+	TEST_ASSERT_EQUAL_INT(0, sdo_generate_storage_hmac_key());
+}
+
+/**
+ * Internal API
+ * Fill buf with a pattern that differs from one offset to the next.
+ */
+static void fill_pattern(uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (uint8_t)((i * 31) + (i >> 8) + 7);
+}
+
+/**
+ * Internal API
+ * Write len bytes of data in chunks of step bytes.
+ */
+static void stream_write(sdo_sdk_blob_flags flags, const uint8_t *data,
+			 uint32_t len, uint32_t step)
+{
+	sdo_blob_stream_t *s = sdo_blob_open_write(TEST_STREAM_BLOB, flags);
+	uint32_t off = 0;
+	uint32_t n = 0;
+
+	TEST_ASSERT_NOT_NULL(s);
+	while (off < len) {
+		n = (len - off < step) ? len - off : step;
+		TEST_ASSERT_EQUAL_INT((int32_t)n,
+				      sdo_blob_write_chunk(s, data + off, n));
+		off += n;
+	}
+	TEST_ASSERT_EQUAL_INT(0, sdo_blob_close(s));
+}
+
+/**
+ * Internal API
+ * Read the whole blob in chunks of step bytes and return what close says.
+ */
+static int32_t stream_read(sdo_sdk_blob_flags flags, uint8_t *data,
+			   uint32_t len, uint32_t step)
+{
+	uint32_t stored_len = 0;
+	sdo_blob_stream_t *s =
+	    sdo_blob_open_read(TEST_STREAM_BLOB, flags, &stored_len);
+	uint32_t off = 0;
+	int32_t n = 0;
+
+	TEST_ASSERT_NOT_NULL(s);
+	TEST_ASSERT_EQUAL_UINT32(len, stored_len);
+	while ((n = sdo_blob_read_chunk(s, data + off,
+					(len - off < step) ? len - off
+							   : step)) > 0) {
+		off += (uint32_t)n;
+		if (off == len)
+			break;
+	}
+	TEST_ASSERT_EQUAL_UINT32(len, off);
+	return sdo_blob_close(s);
+}
+
+/**
+ * Internal API
+ * Write and read back a blob larger than R_MAX_SIZE with several different
+ * chunk sizes.
+ */
+static void stream_round_trip(sdo_sdk_blob_flags flags)
+{
+	uint8_t *data = malloc(TEST_STREAM_LEN);
+	uint8_t *back = malloc(TEST_STREAM_LEN);
+	uint32_t steps[] = {1, 15, 777, 4096, TEST_STREAM_LEN};
+	size_t i;
+
+	stream_init();
+	TEST_ASSERT_NOT_NULL(data);
+	TEST_ASSERT_NOT_NULL(back);
+	fill_pattern(data, TEST_STREAM_LEN);
+
+	for (i = 1; i < sizeof(steps) / sizeof(steps[0]); i++) {
+		stream_write(flags, data, TEST_STREAM_LEN, steps[i]);
+		memset(back, 0, TEST_STREAM_LEN);
+		TEST_ASSERT_EQUAL_INT(0, stream_read(flags, back,
+						     TEST_STREAM_LEN,
+						     steps[i - 1] + 2));
+		TEST_ASSERT_EQUAL_MEMORY(data, back, TEST_STREAM_LEN);
+	}
+
+	remove(TEST_STREAM_BLOB);
+	free(data);
+	free(back);
+}
+
+#ifndef TARGET_OS_FREERTOS
+void test_blob_stream_normal_large(void)
+#else
+TEST_CASE("blob_stream_normal_large", "[blob_stream][sdo]")
+#endif
+{
+	stream_round_trip(SDO_SDK_NORMAL_DATA);
+}
+
+#ifndef TARGET_OS_FREERTOS
+void test_blob_stream_secure_large(void)
+#else
+TEST_CASE("blob_stream_secure_large", "[blob_stream][sdo]")
+#endif
+{
+	stream_round_trip(SDO_SDK_SECURE_DATA);
+}
+
+#ifndef TARGET_OS_FREERTOS
+void test_blob_stream_tampered(void)
+#else
+TEST_CASE("blob_stream_tampered", "[blob_stream][sdo]")
+#endif
+{
+	sdo_sdk_blob_flags flags[] = {SDO_SDK_NORMAL_DATA,
+				      SDO_SDK_SECURE_DATA};
+	uint8_t *data = malloc(TEST_STREAM_LEN);
+	uint32_t stored_len = 0;
+	sdo_blob_stream_t *s = NULL;
+	uint8_t byte = 0;
+	FILE *f = NULL;
+	size_t i;
+
+	stream_init();
+	TEST_ASSERT_NOT_NULL(data);
+	fill_pattern(data, TEST_STREAM_LEN);
+
+	for (i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+		stream_write(flags[i], data, TEST_STREAM_LEN, 1000);
+
+		/* flip a bit near the end of the data */
+		f = fopen(TEST_STREAM_BLOB, "r+b");
+		TEST_ASSERT_NOT_NULL(f);
+		TEST_ASSERT_EQUAL_INT(0, fseek(f, -5, SEEK_END));
+		TEST_ASSERT_EQUAL_INT(1, fread(&byte, 1, 1, f));
+		byte ^= 0x01;
+		TEST_ASSERT_EQUAL_INT(0, fseek(f, -5, SEEK_END));
+		TEST_ASSERT_EQUAL_INT(1, fwrite(&byte, 1, 1, f));
+		TEST_ASSERT_EQUAL_INT(0, fclose(f));
+
+		/* reading everything and reading only a part both fail */
+		TEST_ASSERT_EQUAL_INT(-1, stream_read(flags[i], data,
+						      TEST_STREAM_LEN, 5000));
+		s = sdo_blob_open_read(TEST_STREAM_BLOB, flags[i],
+				       &stored_len);
+		TEST_ASSERT_NOT_NULL(s);
+		TEST_ASSERT_EQUAL_INT(100, sdo_blob_read_chunk(s, data, 100));
+		TEST_ASSERT_EQUAL_INT(-1, sdo_blob_close(s));
+		fill_pattern(data, TEST_STREAM_LEN);
+	}
+
+	remove(TEST_STREAM_BLOB);
+	free(data);
+}
+
+#ifndef TARGET_OS_FREERTOS
+void test_blob_stream_small_compat(void)
+#else
+TEST_CASE("blob_stream_small_compat", "[blob_stream][sdo]")
+#endif
+{
+	sdo_sdk_blob_flags flags[] = {SDO_SDK_RAW_DATA, SDO_SDK_NORMAL_DATA,
+				      SDO_SDK_SECURE_DATA};
+	uint8_t data[1000];
+	uint8_t back[1000];
+	size_t i;
+
+	stream_init();
+	fill_pattern(data, sizeof(data));
+
+	for (i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+		/* streamed blobs are read by sdo_blob_read() */
+		stream_write(flags[i], data, sizeof(data), 333);
+		memset(back, 0, sizeof(back));
+		TEST_ASSERT_EQUAL_INT(sizeof(back),
+				      sdo_blob_read(TEST_STREAM_BLOB, flags[i],
+						    back, sizeof(back)));
+		TEST_ASSERT_EQUAL_MEMORY(data, back, sizeof(data));
+
+		/* and blobs from sdo_blob_write() are streamed back */
+		TEST_ASSERT_EQUAL_INT(sizeof(data),
+				      sdo_blob_write(TEST_STREAM_BLOB, flags[i],
+						     data, sizeof(data)));
+		memset(back, 0, sizeof(back));
+		TEST_ASSERT_EQUAL_INT(0, stream_read(flags[i], back,
+						     sizeof(back), 64));
+		TEST_ASSERT_EQUAL_MEMORY(data, back, sizeof(data));
+	}
+
+	remove(TEST_STREAM_BLOB);
+}
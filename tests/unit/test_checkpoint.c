@@ -0,0 +1,226 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Unit tests for the TO2 checkpoint/resume of SDO library.
+ */
+
+#include "util.h"
+#include "network_al.h"
+#include "sdocheckpoint.h"
+#include "sdoCrypto.h"
+#include "sdoCryptoHal.h"
+#include "rest_interface.h"
+#include "safe_lib.h"
+#include "unity.h"
+
+#ifdef TARGET_OS_LINUX
+/*** Unity Declarations. ***/
+void set_up(void);
+void tear_down(void);
+void test_checkpoint_resumable(void);
+void test_checkpoint_roundtrip(void);
+void test_checkpoint_other_guid(void);
+
+/*** Unity functions. ***/
+void set_up(void)
+{
+}
+
+void tear_down(void)
+{
+}
+#endif
+
+static uint8_t test_guid[16] = {1, 2, 3, 4, 5, 6, 7, 8,
+				9, 10, 11, 12, 13, 14, 15, 16};
+static uint8_t test_pk[] = {0x30, 0x59, 0x30, 0x13, 0x06, 0x07, 0x2a, 0x86};
+static uint8_t test_ip[4] = {127, 0, 0, 1};
+static const char test_token[] = "Bearer token-123";
+static const char test_msg[] = "{\"ct\":[16,\"dGVzdA==\"]}";
+
+/**
+ * Internal API
+ * Build a TO2 session as it is just before msg46 is sent.
+ */
+static void build_session(sdo_prot_t *ps, sdo_prot_ctx_t *prot_ctx,
+			  sdo_ip_address_t *ip)
+{
+	sdo_aes_keyset_t *keyset = get_keyset();
+
+	TEST_ASSERT_EQUAL_INT(0, random_init());
+	keyset->sek = sdo_byte_array_alloc(SEK_KEY_SIZE);
+	keyset->svk = sdo_byte_array_alloc(SVK_KEY_SIZE);
+	TEST_ASSERT_NOT_NULL(keyset->sek);
+	TEST_ASSERT_NOT_NULL(keyset->svk);
+	TEST_ASSERT_EQUAL_INT(0, sdo_crypto_random_bytes(keyset->sek->bytes,
+							 SEK_KEY_SIZE));
+	TEST_ASSERT_EQUAL_INT(0, sdo_crypto_random_bytes(keyset->svk->bytes,
+							 SVK_KEY_SIZE));
+
+	TEST_ASSERT_EQUAL_INT(0, memset_s(ps, sizeof(*ps), 0));
+	TEST_ASSERT_TRUE(sdow_init(&ps->sdow));
+	ps->g2 = sdo_byte_array_alloc_with_byte_array(test_guid,
+						      sizeof(test_guid));
+	ps->iv = sdo_alloc(sizeof(sdo_iv_t));
+	ps->n6 = sdo_byte_array_alloc(SDO_NONCE_BYTES);
+	ps->n7 = sdo_byte_array_alloc(SDO_NONCE_BYTES);
+	ps->owner_public_key = sdo_public_key_alloc(
+	    SDO_CRYPTO_PUB_KEY_ALGO_ECDSAp256, SDO_CRYPTO_PUB_KEY_ENCODING_X509,
+	    sizeof(test_pk), test_pk);
+	TEST_ASSERT_NOT_NULL(ps->g2);
+	TEST_ASSERT_NOT_NULL(ps->iv);
+	TEST_ASSERT_NOT_NULL(ps->n6);
+	TEST_ASSERT_NOT_NULL(ps->n7);
+	TEST_ASSERT_NOT_NULL(ps->owner_public_key);
+	sdo_nonce_init_rand(ps->n6);
+	sdo_nonce_init_rand(ps->n7);
+	ps->iv->ctr_enc = 7;
+	ps->iv->pkt_count = 3;
+
+	ps->state = SDO_STATE_TO2_RCV_GET_NEXT_DEVICE_SERVICE_INFO;
+	ps->round_trip_count = 9;
+	ps->serv_req_info_num = 0;
+	ps->total_dsi_rounds = 1;
+	sdow_next_block(&ps->sdow, SDO_TO2_NEXT_DEVICE_SERVICE_INFO);
+	sdo_resize_block(&ps->sdow.b, sizeof(test_msg));
+	TEST_ASSERT_EQUAL_INT(0, memcpy_s(ps->sdow.b.block, sizeof(test_msg),
+					  test_msg, sizeof(test_msg)));
+	ps->sdow.b.block_size = sizeof(test_msg) - 1;
+
+	sdo_init_ipv4_address(ip, test_ip);
+	TEST_ASSERT_EQUAL_INT(0, memset_s(prot_ctx, sizeof(*prot_ctx), 0));
+	prot_ctx->protdata = ps;
+	prot_ctx->host_ip = ip;
+	prot_ctx->host_port = 8042;
+
+	TEST_ASSERT_TRUE(init_rest_context());
+	get_rest_context()->authorization = sdo_alloc(sizeof(test_token));
+	TEST_ASSERT_NOT_NULL(get_rest_context()->authorization);
+	TEST_ASSERT_EQUAL_INT(0, strcpy_s(get_rest_context()->authorization,
+					  sizeof(test_token), test_token));
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("checkpoint_resumable", "[checkpoint][sdo]")
+#else
+void test_checkpoint_resumable(void)
+#endif
+{
+	sdo_prot_t ps;
+
+	TEST_ASSERT_EQUAL_INT(0, memset_s(&ps, sizeof(ps), 0));
+	ps.state = SDO_STATE_TO2_RCV_SETUP_DEVICE;
+
+	ps.sdow.msg_type = SDO_TO2_PROVE_DEVICE;
+	TEST_ASSERT_FALSE(sdo_to2_resumable(&ps));
+	ps.sdow.msg_type = SDO_TO2_NEXT_DEVICE_SERVICE_INFO;
+	TEST_ASSERT_TRUE(sdo_to2_resumable(&ps));
+	ps.sdow.msg_type = SDO_TO2_GET_NEXT_OWNER_SERVICE_INFO;
+	TEST_ASSERT_TRUE(sdo_to2_resumable(&ps));
+	ps.sdow.msg_type = SDO_TO2_DONE;
+	TEST_ASSERT_TRUE(sdo_to2_resumable(&ps));
+
+	ps.state = SDO_STATE_ERROR;
+	TEST_ASSERT_FALSE(sdo_to2_resumable(&ps));
+	TEST_ASSERT_FALSE(sdo_to2_resumable(NULL));
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("checkpoint_roundtrip", "[checkpoint][sdo]")
+#else
+void test_checkpoint_roundtrip(void)
+#endif
+{
+	sdo_prot_t ps, rs;
+	sdo_prot_ctx_t prot_ctx;
+	sdo_ip_address_t ip;
+	sdo_aes_keyset_t *keyset = get_keyset();
+	uint8_t sek[SEK_KEY_SIZE];
+	int result = 1;
+
+	build_session(&ps, &prot_ctx, &ip);
+	TEST_ASSERT_TRUE(sdo_to2_checkpoint_save(&prot_ctx));
+	TEST_ASSERT_EQUAL_INT(0, memcpy_s(sek, sizeof(sek), keyset->sek->bytes,
+					  SEK_KEY_SIZE));
+	TEST_ASSERT_EQUAL_INT(0, memset_s(keyset->sek->bytes, SEK_KEY_SIZE, 0));
+	exit_rest_context();
+
+	/* A new run finds the checkpoint and restores the session */
+	TEST_ASSERT_TRUE(sdo_to2_checkpoint_load(ps.g2));
+	TEST_ASSERT_EQUAL_INT(0, memset_s(&rs, sizeof(rs), 0));
+	TEST_ASSERT_TRUE(sdow_init(&rs.sdow));
+	rs.iv = sdo_alloc(sizeof(sdo_iv_t));
+	TEST_ASSERT_NOT_NULL(rs.iv);
+	TEST_ASSERT_TRUE(sdo_to2_checkpoint_restore(&rs));
+
+	TEST_ASSERT_TRUE(rs.resumed);
+	TEST_ASSERT_EQUAL_INT(ps.state, rs.state);
+	TEST_ASSERT_EQUAL_INT(SDO_TO2_NEXT_DEVICE_SERVICE_INFO,
+			      rs.sdow.msg_type);
+	TEST_ASSERT_EQUAL_UINT32(ps.round_trip_count, rs.round_trip_count);
+	TEST_ASSERT_EQUAL_UINT32(8042, rs.port1);
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(test_ip, rs.i1.addr, sizeof(test_ip));
+	TEST_ASSERT_EQUAL_INT(ps.sdow.b.block_size, rs.sdow.b.block_size);
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(ps.sdow.b.block, rs.sdow.b.block,
+				      rs.sdow.b.block_size);
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(sek, keyset->sek->bytes, SEK_KEY_SIZE);
+	TEST_ASSERT_EQUAL_UINT32(7, rs.iv->ctr_enc);
+	TEST_ASSERT_EQUAL_UINT32(3, rs.iv->pkt_count);
+	TEST_ASSERT_TRUE(sdo_nonce_equal(ps.n6, rs.n6));
+	TEST_ASSERT_TRUE(sdo_nonce_equal(ps.n7, rs.n7));
+	TEST_ASSERT_TRUE(
+	    sdo_compare_public_keys(ps.owner_public_key, rs.owner_public_key));
+
+	/* The REST session token follows into the new connection */
+	TEST_ASSERT_TRUE(init_rest_context());
+	prot_ctx.protdata = &rs;
+	TEST_ASSERT_TRUE(sdo_to2_checkpoint_restore_session(&prot_ctx));
+	TEST_ASSERT_FALSE(rs.resumed);
+	TEST_ASSERT_NOT_NULL(get_rest_context()->authorization);
+	strcmp_s(get_rest_context()->authorization, SDO_MAX_STR_SIZE,
+		 test_token, &result);
+	TEST_ASSERT_EQUAL_INT(0, result);
+	exit_rest_context();
+
+	/* Once discarded, nothing is resumed */
+	sdo_to2_checkpoint_discard();
+	TEST_ASSERT_FALSE(sdo_to2_checkpoint_load(ps.g2));
+
+	sdo_kex_close();
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("checkpoint_other_guid", "[checkpoint][sdo]")
+#else
+void test_checkpoint_other_guid(void)
+#endif
+{
+	sdo_prot_t ps;
+	sdo_prot_ctx_t prot_ctx;
+	sdo_ip_address_t ip;
+	sdo_byte_array_t *other;
+
+	build_session(&ps, &prot_ctx, &ip);
+	TEST_ASSERT_TRUE(sdo_to2_checkpoint_save(&prot_ctx));
+	exit_rest_context();
+
+	other = sdo_byte_array_alloc(sizeof(test_guid));
+	TEST_ASSERT_NOT_NULL(other);
+	TEST_ASSERT_FALSE(sdo_to2_checkpoint_load(other));
+	/* The mismatching checkpoint was invalidated */
+	TEST_ASSERT_FALSE(sdo_to2_checkpoint_load(ps.g2));
+
+	/* Outside the DSI phase there is nothing to save */
+	TEST_ASSERT_TRUE(init_rest_context());
+	ps.sdow.msg_type = SDO_TO2_GET_NEXT_OWNER_SERVICE_INFO;
+	TEST_ASSERT_TRUE(sdo_to2_checkpoint_save(&prot_ctx));
+	TEST_ASSERT_FALSE(sdo_to2_checkpoint_load(ps.g2));
+	exit_rest_context();
+
+	sdo_byte_array_free(other);
+	sdo_kex_close();
+}
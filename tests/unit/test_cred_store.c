@@ -0,0 +1,338 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Unit tests for the journaled credential store of the Linux storage
+ * layer.
+ */
+
+#define _DEFAULT_SOURCE /* ftruncate(), pwrite() */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "util.h"
+#include "sdoCryptoHal.h"
+#include "safe_lib.h"
+#include "unity.h"
+#ifdef CRED_STORE_ENABLED
+#include "cred_store.h"
+#endif
+
+#ifdef TARGET_OS_LINUX
+/*** Unity Declarations. ***/
+void set_up(void);
+void tear_down(void);
+void test_cred_store_batch(void);
+void test_cred_store_torn_tail(void);
+void test_cred_store_compaction(void);
+void test_cred_store_legacy_file(void);
+void test_cred_store_too_many_records(void);
+#endif
+
+#ifdef CRED_STORE_ENABLED
+/* What the device had in place before the test, put back afterwards */
+#define SAVED_STORE SDO_CRED_STORE ".unit"
+#define SAVED_CHECKPOINT SDO_TO2_CHECKPOINT ".unit"
+
+/*
+ * Start from an empty store. A copy left behind by a test that failed is
+ * the device's own and is kept.
+ */
+static void store_save(void)
+{
+	if (file_exists(SAVED_STORE))
+		remove(SDO_CRED_STORE);
+	else
+		rename(SDO_CRED_STORE, SAVED_STORE);
+	if (file_exists(SAVED_CHECKPOINT))
+		remove(SDO_TO2_CHECKPOINT);
+	else
+		rename(SDO_TO2_CHECKPOINT, SAVED_CHECKPOINT);
+}
+
+static void store_restore(void)
+{
+	remove(SDO_CRED_STORE);
+	remove(SDO_TO2_CHECKPOINT);
+	rename(SAVED_STORE, SDO_CRED_STORE);
+	rename(SAVED_CHECKPOINT, SDO_TO2_CHECKPOINT);
+}
+
+/* On-disk sizes, see cred_store_linux.c */
+#define STORE_HDR_LEN 16
+#define REC_LEN(name_len, data_len) (8 + (name_len) + (data_len))
+#define FRAME_LEN(body_len) (16 + (body_len) + 32)
+
+static off_t store_file_size(void)
+{
+	struct stat st;
+
+	if (stat(SDO_CRED_STORE, &st) != 0)
+		return -1;
+	return st.st_size;
+}
+
+static void check_record(const char *name, const char *value)
+{
+	uint8_t buf[64] = {0};
+	size_t len = strnlen_s(value, sizeof(buf));
+
+	TEST_ASSERT_EQUAL_INT32((int32_t)len, cred_store_size(name));
+	TEST_ASSERT_EQUAL_INT32(0, cred_store_read(name, buf, len));
+	TEST_ASSERT_EQUAL_MEMORY(value, buf, len);
+}
+
+static void put_record(const char *name, const char *value)
+{
+	TEST_ASSERT_EQUAL_INT32(
+	    0, cred_store_write(name, (const uint8_t *)value,
+				strnlen_s(value, SDO_MAX_STR_SIZE)));
+}
+
+/*
+ * Make the store scan the file again, as it does when another process
+ * replaced it.
+ */
+static void reload_store(void)
+{
+	TEST_ASSERT_EQUAL_INT(0, rename(SDO_CRED_STORE, SAVED_STORE ".tmp"));
+	TEST_ASSERT_FALSE(cred_store_exists("rec_a"));
+	TEST_ASSERT_EQUAL_INT(0, rename(SAVED_STORE ".tmp", SDO_CRED_STORE));
+}
+
+static void truncate_store(off_t len)
+{
+	int fd = open(SDO_CRED_STORE, O_WRONLY);
+
+	TEST_ASSERT_TRUE(fd >= 0);
+	TEST_ASSERT_EQUAL_INT(0, ftruncate(fd, len));
+	close(fd);
+}
+
+/* Rewrite bytes of the store file behind the back of the store */
+static void patch_store(off_t off, const void *data, size_t len)
+{
+	int fd = open(SDO_CRED_STORE, O_WRONLY);
+
+	TEST_ASSERT_TRUE(fd >= 0);
+	TEST_ASSERT_EQUAL_INT((int)len, (int)pwrite(fd, data, len, off));
+	close(fd);
+}
+#endif
+
+#ifdef TARGET_OS_LINUX
+/*** Unity functions. ***/
+void set_up(void)
+{
+}
+
+void tear_down(void)
+{
+}
+#endif
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("cred_store_batch", "[cred_store][sdo]")
+#else
+void test_cred_store_batch(void)
+#endif
+{
+#ifdef CRED_STORE_ENABLED
+	const off_t len =
+	    STORE_HDR_LEN + FRAME_LEN(REC_LEN(5, 5) + REC_LEN(5, 3));
+
+	store_save();
+	TEST_ASSERT_EQUAL_INT32(-1, cred_store_end(true));
+
+	/* Nothing reaches the file before the batch is committed */
+	TEST_ASSERT_EQUAL_INT32(0, cred_store_begin());
+	TEST_ASSERT_EQUAL_INT32(-1, cred_store_begin());
+	put_record("rec_a", "one");
+	put_record("rec_b", "two");
+	put_record("rec_a", "three");
+	check_record("rec_a", "three");
+	TEST_ASSERT_EQUAL_INT(-1, (int)store_file_size());
+	TEST_ASSERT_EQUAL_INT32(0, cred_store_end(true));
+
+	/* One frame, the last value of each record */
+	TEST_ASSERT_EQUAL_INT((int)len, (int)store_file_size());
+	check_record("rec_a", "three");
+	check_record("rec_b", "two");
+
+	/* A dropped batch leaves the store as it was */
+	TEST_ASSERT_EQUAL_INT32(0, cred_store_begin());
+	put_record("rec_a", "four");
+	put_record("rec_c", "five");
+	TEST_ASSERT_EQUAL_INT32(0, cred_store_end(false));
+	check_record("rec_a", "three");
+	TEST_ASSERT_FALSE(cred_store_exists("rec_c"));
+	TEST_ASSERT_EQUAL_INT((int)len, (int)store_file_size());
+	store_restore();
+#else
+	TEST_IGNORE_MESSAGE("built without CRED_STORE");
+#endif
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("cred_store_torn_tail", "[cred_store][sdo]")
+#else
+void test_cred_store_torn_tail(void)
+#endif
+{
+#ifdef CRED_STORE_ENABLED
+	const off_t first = STORE_HDR_LEN + FRAME_LEN(REC_LEN(5, 3));
+	const off_t second = first + FRAME_LEN(REC_LEN(5, 3));
+	uint8_t flip = 0xff;
+
+	store_save();
+	put_record("rec_a", "old");
+	put_record("rec_a", "new");
+	TEST_ASSERT_EQUAL_INT((int)second, (int)store_file_size());
+	check_record("rec_a", "new");
+
+	/* Power cut in the middle of the second commit */
+	truncate_store(second - 10);
+	check_record("rec_a", "old");
+
+	/* The next commit goes where the torn frame was */
+	put_record("rec_b", "bbb");
+	TEST_ASSERT_EQUAL_INT((int)second, (int)store_file_size());
+	check_record("rec_a", "old");
+	check_record("rec_b", "bbb");
+
+	/* A frame that does not match its hash ends the journal as well */
+	patch_store(second - 1, &flip, 1);
+	reload_store();
+	TEST_ASSERT_FALSE(cred_store_exists("rec_b"));
+	check_record("rec_a", "old");
+	store_restore();
+#else
+	TEST_IGNORE_MESSAGE("built without CRED_STORE");
+#endif
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("cred_store_compaction", "[cred_store][sdo]")
+#else
+void test_cred_store_compaction(void)
+#endif
+{
+#ifdef CRED_STORE_ENABLED
+	static uint8_t big[4096];
+	uint8_t buf[sizeof(big)];
+	off_t len = 0, max_len = 0;
+	int i, compacted = 0;
+
+	store_save();
+	put_record("rec_a", "keep");
+
+	/* Overwrite one record until the dead frames get compacted away */
+	for (i = 0; i < 40; i++) {
+		memset(big, 'a' + i % 26, sizeof(big));
+		TEST_ASSERT_EQUAL_INT32(
+		    0, cred_store_write("rec_b", big, sizeof(big)));
+		if (store_file_size() < len)
+			compacted++;
+		len = store_file_size();
+		if (len > max_len)
+			max_len = len;
+	}
+	TEST_ASSERT_TRUE(compacted >= 2);
+	TEST_ASSERT_TRUE(max_len <= 64 * 1024);
+
+	check_record("rec_a", "keep");
+	TEST_ASSERT_EQUAL_INT32(0, cred_store_read("rec_b", buf, sizeof(buf)));
+	TEST_ASSERT_EQUAL_MEMORY(big, buf, sizeof(buf));
+
+	/* What the journal says from the start agrees with the index */
+	reload_store();
+	check_record("rec_a", "keep");
+	TEST_ASSERT_EQUAL_INT32(0, cred_store_read("rec_b", buf, sizeof(buf)));
+	TEST_ASSERT_EQUAL_MEMORY(big, buf, sizeof(buf));
+	store_restore();
+#else
+	TEST_IGNORE_MESSAGE("built without CRED_STORE");
+#endif
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("cred_store_legacy_file", "[cred_store][sdo]")
+#else
+void test_cred_store_legacy_file(void)
+#endif
+{
+#ifdef CRED_STORE_ENABLED
+	FILE *fp;
+
+	store_save();
+	fp = fopen(SDO_TO2_CHECKPOINT, "wb");
+	TEST_ASSERT_NOT_NULL(fp);
+	TEST_ASSERT_EQUAL_INT(6, (int)fwrite("legacy", 1, 6, fp));
+	fclose(fp);
+
+	/* Not in the store yet: the blob file is read */
+	TEST_ASSERT_TRUE(cred_store_owns(SDO_TO2_CHECKPOINT));
+	TEST_ASSERT_TRUE(cred_store_exists(SDO_TO2_CHECKPOINT));
+	check_record(SDO_TO2_CHECKPOINT, "legacy");
+
+	/* Once written, the record hides the file */
+	put_record(SDO_TO2_CHECKPOINT, "stored");
+	check_record(SDO_TO2_CHECKPOINT, "stored");
+	TEST_ASSERT_TRUE(file_exists(SDO_TO2_CHECKPOINT));
+	store_restore();
+#else
+	TEST_IGNORE_MESSAGE("built without CRED_STORE");
+#endif
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("cred_store_too_many_records", "[cred_store][sdo]")
+#else
+void test_cred_store_too_many_records(void)
+#endif
+{
+#ifdef CRED_STORE_ENABLED
+	uint8_t frame[FRAME_LEN(REC_LEN(5, 1))];
+	char name[8];
+	off_t end;
+	int i;
+
+	store_save();
+	for (i = 0; i < 8; i++) {
+		snprintf(name, sizeof(name), "rec_%d", i);
+		put_record(name, "x");
+	}
+	TEST_ASSERT_EQUAL_INT32(-1, cred_store_write("rec_8", (uint8_t *)"x",
+						     1));
+	TEST_ASSERT_FALSE(cred_store_exists("rec_8"));
+	check_record("rec_7", "x");
+
+	/* A ninth record in an intact frame is an error, not dropped */
+	end = store_file_size();
+	memset(frame, 0, sizeof(frame));
+	frame[0] = 'S';
+	frame[1] = 'D';
+	frame[2] = 'O';
+	frame[3] = 'C';
+	frame[7] = 100;
+	frame[11] = 1;
+	frame[15] = 8 + 5 + 1;
+	frame[17] = 5;
+	frame[23] = 1;
+	memcpy(frame + 24, "rec_8x", 6);
+	TEST_ASSERT_EQUAL_INT(
+	    0, crypto_hal_hash(SDO_CRYPTO_HASH_TYPE_SHA_256, frame, 30,
+			       frame + 30, sizeof(frame) - 30));
+	patch_store(end, frame, sizeof(frame));
+	TEST_ASSERT_EQUAL_INT32(-1, cred_store_size("rec_0"));
+	TEST_ASSERT_FALSE(cred_store_exists("rec_8"));
+	store_restore();
+#else
+	TEST_IGNORE_MESSAGE("built without CRED_STORE");
+#endif
+}
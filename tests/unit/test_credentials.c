@@ -15,6 +15,7 @@
 #include "safe_lib.h"
 #include "sdoCryptoHal.h"
 #include "platform_utils.h"
+#include "cred_snapshot.h"
 
 #ifdef TARGET_OS_FREERTOS
 extern bool g_malloc_fail;
@@ -36,6 +37,7 @@ void test_load_credential(void);
 void test_read_write_Device_credentials(void);
 void test_store_credential(void);
 void test_app_alloc_credentials(void);
+void test_cred_snapshot(void);
 
 /*** Wrapper Functions ***/
 bool __real_sdor_next_block(sdor_t *sdor, uint32_t *typep);
@@ -528,3 +530,95 @@ void test_app_alloc_credentials(void)
 	TEST_ASSERT_EQUAL(NULL, ret);
 	g_malloc_fail = false;
 }
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("cred_snapshot", "[credentials][sdo]")
+#else
+void test_cred_snapshot(void)
+#endif
+{
+	int ret = -1;
+	int result = 1;
+	uint8_t normal_buf[400] =
+	    "{\"ST\":5,\"O\":{\"pv\":112,\"pe\":3,\"g\":"
+	    "\"qhYasJzvSNe63J4g0aNQew==\",\"r\":[3,[4,{"
+	    "\"only\":\"dev\",\"po\":8041,\"dn\":\"localhost\","
+	    "\"pr\":\"http\"}],[4,{\"only\":\"dev\",\"po\":"
+	    "8041,\"dn\":\"localhost\",\"pr\":\"https\"}],[1,{"
+	    "\"delaysec\":1}]],\"pkh\":[32,8,\"NsoZ7HFUH/"
+	    "pt7+Fl0BTK1VdiXHbXKAeVWglf/Z7v7Gc=\"]}}";
+	sdo_dev_cred_t *ocred = NULL;
+	sdo_dev_cred_t *snap_cred = NULL;
+	sdo_rendezvous_t *rv = NULL;
+	sdo_rendezvous_t *snap_rv = NULL;
+
+	ret = sdo_sdk_init(NULL, 0, NULL);
+	TEST_ASSERT_EQUAL(SDO_SUCCESS, ret);
+
+	ret = sdo_blob_write((char *)SDO_CRED_NORMAL, SDO_SDK_NORMAL_DATA,
+			     normal_buf, sizeof(normal_buf));
+	TEST_ASSERT_NOT_EQUAL(-1, ret);
+
+	ocred = app_get_credentials();
+	ret = read_normal_device_credentials((char *)SDO_CRED_NORMAL,
+					     SDO_SDK_NORMAL_DATA, ocred);
+	TEST_ASSERT_TRUE(ret);
+
+	ret = cred_snapshot_save(SDO_CRED_SNAPSHOT, normal_buf,
+				 sizeof(normal_buf), ocred);
+	TEST_ASSERT_TRUE(ret);
+
+	/* Positive case: decodes to the same credentials */
+	snap_cred = sdo_dev_cred_alloc();
+	TEST_ASSERT_NOT_NULL(snap_cred);
+	ret = cred_snapshot_load(SDO_CRED_SNAPSHOT, SDO_CRED_NORMAL, snap_cred);
+	TEST_ASSERT_TRUE(ret);
+	TEST_ASSERT_EQUAL(ocred->ST, snap_cred->ST);
+	TEST_ASSERT_EQUAL(ocred->owner_blk->pv, snap_cred->owner_blk->pv);
+	TEST_ASSERT_EQUAL(ocred->owner_blk->pe, snap_cred->owner_blk->pe);
+	TEST_ASSERT_EQUAL(ocred->owner_blk->guid->byte_sz,
+			  snap_cred->owner_blk->guid->byte_sz);
+	memcmp_s(ocred->owner_blk->guid->bytes,
+		 ocred->owner_blk->guid->byte_sz,
+		 snap_cred->owner_blk->guid->bytes,
+		 snap_cred->owner_blk->guid->byte_sz, &result);
+	TEST_ASSERT_EQUAL(0, result);
+	memcmp_s(ocred->owner_blk->pkh->hash->bytes,
+		 ocred->owner_blk->pkh->hash->byte_sz,
+		 snap_cred->owner_blk->pkh->hash->bytes,
+		 snap_cred->owner_blk->pkh->hash->byte_sz, &result);
+	TEST_ASSERT_EQUAL(0, result);
+	TEST_ASSERT_EQUAL(ocred->owner_blk->rvlst->num_entries,
+			  snap_cred->owner_blk->rvlst->num_entries);
+
+	rv = ocred->owner_blk->rvlst->rv_entries;
+	snap_rv = snap_cred->owner_blk->rvlst->rv_entries;
+	while (rv && snap_rv) {
+		TEST_ASSERT_EQUAL(rv->num_params, snap_rv->num_params);
+		TEST_ASSERT_EQUAL(rv->po == NULL, snap_rv->po == NULL);
+		if (rv->po)
+			TEST_ASSERT_EQUAL(*rv->po, *snap_rv->po);
+		TEST_ASSERT_EQUAL(rv->pr == NULL, snap_rv->pr == NULL);
+		if (rv->pr)
+			TEST_ASSERT_EQUAL_STRING(rv->pr->bytes,
+						 snap_rv->pr->bytes);
+		TEST_ASSERT_EQUAL(rv->delaysec == NULL,
+				  snap_rv->delaysec == NULL);
+		rv = rv->next;
+		snap_rv = snap_rv->next;
+	}
+	TEST_ASSERT_NULL(rv);
+	TEST_ASSERT_NULL(snap_rv);
+
+	/* Negative case - Normal.blob changed since the snapshot was taken */
+	normal_buf[sizeof(normal_buf) - 1] = 1;
+	ret = sdo_blob_write((char *)SDO_CRED_NORMAL, SDO_SDK_NORMAL_DATA,
+			     normal_buf, sizeof(normal_buf));
+	TEST_ASSERT_NOT_EQUAL(-1, ret);
+	ret = cred_snapshot_load(SDO_CRED_SNAPSHOT, SDO_CRED_NORMAL, snap_cred);
+	TEST_ASSERT_FALSE(ret);
+
+	sdo_dev_cred_free(snap_cred);
+	sdo_free(snap_cred);
+	sdo_sdk_deinit();
+}
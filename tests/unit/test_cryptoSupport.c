@@ -18,6 +18,10 @@
 #include "safe_lib.h"
 #include "sdotypes.h"
 #include "test_RSARoutines.h"
+#ifdef TARGET_OS_LINUX
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 #if defined(KEX_DH_ENABLED) //(m size =2048)
 #define DH_PEER_RANDOM_SIZE 256
@@ -102,6 +106,8 @@ void test_crypto_support_sdo_msg_decrypt_invalid_cipher_length(void);
 void test_crypto_support_sdo_msg_decrypt_invalid_iv(void);
 void test_crypto_support_sdo_kex_init(void);
 void test_crypto_support_sdo_kex_close(void);
+void test_crypto_support_sdo_kex_precompute(void);
+void test_crypto_support_sdo_kex_precompute_discard(void);
 void test_crypto_support_sdo_kex_init_sdo_string_alloc_with_str_fail(void);
 void test_crypto_support_sdo_kex_init_sdo_byte_array_alloc_fail(void);
 void test_crypto_support_sdo_get_kex_paramB_valid(void);
@@ -127,6 +133,8 @@ void test_sdo_ov_verifyi_invalid_result(void);
 void test_sdo_device_sign(void);
 void test_sdo_device_sign_invalid_message(void);
 void test_sdo_device_sign_invalid_message_len(void);
+void test_sdo_device_sign_precompute(void);
+void test_sdo_device_sign_precompute_fork(void);
 void testcrypto_hal_hash(void);
 void testcrypto_hal_hash_SHA384(void);
 void test_sdo_cryptoHASH_invalid_message(void);
@@ -1448,6 +1456,55 @@ TEST_CASE("crypto_support_sdo_kex_close", "[crypto_support][sdo]")
 	TEST_ASSERT_EQUAL_INT(0, ret);
 }
 
+#ifndef TARGET_OS_FREERTOS
+void test_crypto_support_sdo_kex_precompute(void)
+#else
+TEST_CASE("crypto_support_sdo_kex_precompute", "[crypto_support][sdo]")
+#endif
+{
+	sdo_byte_array_t *xB = NULL;
+	sdo_byte_array_t *first = NULL;
+	int result = 0;
+
+	TEST_ASSERT_EQUAL_INT(0, sdo_kex_precompute_start());
+	/* A second start keeps the pending share */
+	TEST_ASSERT_EQUAL_INT(0, sdo_kex_precompute_start());
+	TEST_ASSERT_EQUAL_INT(0, sdo_kex_init());
+	TEST_ASSERT_EQUAL_INT(0, sdo_get_kex_paramB(&xB));
+	first = sdo_byte_array_alloc_with_byte_array(xB->bytes, xB->byte_sz);
+	TEST_ASSERT_NOT_NULL(first);
+	TEST_ASSERT_EQUAL_INT(0, sdo_kex_close());
+
+	/* The share is used once; the next init generates a fresh one */
+	xB = NULL;
+	TEST_ASSERT_EQUAL_INT(0, sdo_kex_init());
+	TEST_ASSERT_EQUAL_INT(0, sdo_get_kex_paramB(&xB));
+	TEST_ASSERT_EQUAL_INT(0, memcmp_s(xB->bytes, xB->byte_sz, first->bytes,
+					  first->byte_sz, &result));
+	TEST_ASSERT_NOT_EQUAL(0, result);
+	TEST_ASSERT_EQUAL_INT(0, sdo_kex_close());
+	sdo_byte_array_free(first);
+}
+
+#ifndef TARGET_OS_FREERTOS
+void test_crypto_support_sdo_kex_precompute_discard(void)
+#else
+TEST_CASE("crypto_support_sdo_kex_precompute_discard",
+	  "[crypto_support][sdo]")
+#endif
+{
+	sdo_kex_ctx_t *kex_ctx = getsdo_key_ctx();
+
+	TEST_ASSERT_EQUAL_INT(0, sdo_kex_precompute_start());
+	sdo_kex_precompute_discard();
+	/* Discarding twice is harmless */
+	sdo_kex_precompute_discard();
+
+	TEST_ASSERT_EQUAL_INT(0, sdo_kex_init());
+	TEST_ASSERT_NOT_NULL(kex_ctx->context);
+	TEST_ASSERT_EQUAL_INT(0, sdo_kex_close());
+}
+
 #ifndef TARGET_OS_FREERTOS
 void test_crypto_support_sdo_kex_init_sdo_string_alloc_with_str_fail(void)
 #else
@@ -2956,6 +3013,90 @@ TEST_CASE("sdo_device_sign_invalid_message_len", "[crypto_support][sdo]")
 	}
 }
 
+#ifndef TARGET_OS_FREERTOS
+void test_sdo_device_sign_precompute(void)
+#else
+TEST_CASE("sdo_device_sign_precompute", "[crypto_support][sdo]")
+#endif
+{
+	const uint8_t *message = test_buff1;
+	size_t message_len = sizeof(test_buff1);
+	sdo_byte_array_t *sig[3] = {NULL, NULL, NULL};
+	int result;
+
+	TEST_ASSERT_EQUAL(0, sdo_device_sign_precompute());
+	/* Two precomputed signatures and one computed inline */
+	for (int i = 0; i < 3; i++)
+		TEST_ASSERT_EQUAL(0, sdo_device_sign(message, message_len,
+						     &sig[i]));
+
+	/* A reused nonce would give identical signatures of one message */
+	for (int i = 0; i < 2; i++) {
+		result = 1;
+		if (sig[i]->byte_sz == sig[i + 1]->byte_sz)
+			TEST_ASSERT_EQUAL(
+			    0, memcmp_s(sig[i]->bytes, sig[i]->byte_sz,
+					sig[i + 1]->bytes, sig[i + 1]->byte_sz,
+					&result));
+		TEST_ASSERT_NOT_EQUAL(0, result);
+	}
+
+	TEST_ASSERT_EQUAL(0, sdo_device_sign_precompute());
+	sdo_device_sign_precompute_clear();
+	for (int i = 0; i < 3; i++)
+		sdo_byte_array_free(sig[i]);
+}
+
+#ifndef TARGET_OS_FREERTOS
+void test_sdo_device_sign_precompute_fork(void)
+#else
+TEST_CASE("sdo_device_sign_precompute_fork", "[crypto_support][sdo]")
+#endif
+{
+#ifdef TARGET_OS_LINUX
+	const uint8_t *message = test_buff1;
+	size_t message_len = sizeof(test_buff1);
+	sdo_byte_array_t *sig = NULL;
+	uint8_t child_sig[256] = {0};
+	ssize_t child_len;
+	int fds[2], status = -1, result = 1;
+	pid_t pid;
+
+	TEST_ASSERT_EQUAL(0, sdo_device_sign_precompute());
+	TEST_ASSERT_EQUAL(0, pipe(fds));
+	pid = fork();
+	TEST_ASSERT_TRUE(pid >= 0);
+	if (pid == 0) {
+		/* No Unity asserts here, the parent reports for the child */
+		close(fds[0]);
+		if (sdo_device_sign(message, message_len, &sig) != 0 ||
+		    write(fds[1], sig->bytes, sig->byte_sz) !=
+			(ssize_t)sig->byte_sz)
+			_exit(1);
+		_exit(0);
+	}
+	close(fds[1]);
+	child_len = read(fds[0], child_sig, sizeof(child_sig));
+	close(fds[0]);
+	TEST_ASSERT_EQUAL(pid, waitpid(pid, &status, 0));
+	TEST_ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	TEST_ASSERT_TRUE(child_len > 0);
+
+	/* The child must not have signed with an entry the parent still has */
+	TEST_ASSERT_EQUAL(0, sdo_device_sign(message, message_len, &sig));
+	if (sig->byte_sz == (size_t)child_len)
+		TEST_ASSERT_EQUAL(0, memcmp_s(sig->bytes, sig->byte_sz,
+					      child_sig, (size_t)child_len,
+					      &result));
+	TEST_ASSERT_NOT_EQUAL(0, result);
+
+	sdo_device_sign_precompute_clear();
+	sdo_byte_array_free(sig);
+#else
+	TEST_IGNORE();
+#endif
+}
+
 /* Test cases for sdo_crypto_hash */
 #ifndef TARGET_OS_FREERTOS
 void testcrypto_hal_hash(void)
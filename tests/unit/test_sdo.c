@@ -448,7 +448,7 @@ void test_sdo_sdk_service_info_register_module(void)
 	ret = sdo_sdk_init(NULL, 1, &module);
 	TEST_ASSERT_EQUAL(SDO_ERROR, ret);
 
-	ret = sdo_sdk_init(NULL, SDO_MAX_MODULES + 1, &module);
+	ret = sdo_sdk_init(NULL, SDO_SDK_MAX_MODULES + 1, &module);
 	TEST_ASSERT_EQUAL(SDO_ERROR, ret);
 
 	ret = sdo_sdk_init(NULL, 0, &module);
@@ -0,0 +1,259 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Unit tests for the file writes of the sdo_sys module.
+ */
+
+#define _DEFAULT_SOURCE /* mkdtemp() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "util.h"
+#include "sdoCryptoHal.h"
+#include "safe_lib.h"
+#include "unity.h"
+#include "sdomodules.h"
+
+#ifdef TARGET_OS_LINUX
+/*** Unity Declarations. ***/
+void set_up(void);
+void tear_down(void);
+void test_sdo_sys_file_sha256(void);
+void test_sdo_sys_file_sha256_mismatch(void);
+void test_sdo_sys_file_end(void);
+void test_sdo_sys_file_failure(void);
+#endif
+
+#ifdef MODULES_ENABLED
+#define FILE_LEN 300000
+#define FILE_RESERVE "400000"
+
+static char dir[sizeof("/tmp/sdo_sys.XXXXXX")];
+static char file_name[64];
+static uint8_t file_data[FILE_LEN];
+
+/* Chunks below, at and above the 64 KiB write buffer */
+static const size_t chunks[] = {1000, 70000, 30000, 65536, 65535, 1};
+
+/* Hand one owner service info message to the module */
+static int set_osi(const char *key, const void *value, size_t len)
+{
+	sdo_sdk_si_kv_view kv;
+
+	kv.key.data = (uint8_t *)key;
+	kv.key.len = strnlen_s(key, SDO_MAX_STR_SIZE);
+	kv.value.data = (uint8_t *)value;
+	kv.value.len = len;
+	return sdo_sys(SDO_SI_SET_OSI, NULL, &kv);
+}
+
+static int set_osi_str(const char *key, const char *value)
+{
+	return set_osi(key, value, strnlen_s(value, SDO_MAX_STR_SIZE));
+}
+
+/* Send file_data from off on, in the chunk sizes above */
+static void write_file(size_t off, size_t len)
+{
+	size_t i, n;
+
+	for (i = 0; len; i = (i + 1) % (sizeof(chunks) / sizeof(chunks[0]))) {
+		n = chunks[i] < len ? chunks[i] : len;
+		TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS,
+				      set_osi("write", file_data + off, n));
+		off += n;
+		len -= n;
+	}
+}
+
+static off_t file_size(void)
+{
+	struct stat st;
+
+	if (stat(file_name, &st) != 0)
+		return -1;
+	return st.st_size;
+}
+
+/* The file holds the first len bytes of file_data */
+static void check_file(size_t len)
+{
+	static uint8_t buf[FILE_LEN];
+	FILE *fp;
+
+	TEST_ASSERT_EQUAL_INT((int)len, (int)file_size());
+	fp = fopen(file_name, "rb");
+	TEST_ASSERT_NOT_NULL(fp);
+	TEST_ASSERT_EQUAL_INT((int)len, (int)fread(buf, 1, sizeof(buf), fp));
+	fclose(fp);
+	TEST_ASSERT_EQUAL_MEMORY(file_data, buf, len);
+}
+
+/* A fresh directory for the file, and the data written to it */
+static void sys_file_setup(void)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(file_data); i++)
+		file_data[i] = (uint8_t)(i * 7 + (i >> 8));
+	TEST_ASSERT_EQUAL_INT(0, strcpy_s(dir, sizeof(dir),
+					  "/tmp/sdo_sys.XXXXXX"));
+	TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+	TEST_ASSERT_TRUE(snprintf(file_name, sizeof(file_name), "%s/file.bin",
+				  dir) < (int)sizeof(file_name));
+	TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS,
+			      sdo_sys(SDO_SI_START, NULL, NULL));
+}
+
+static void sys_file_cleanup(void)
+{
+	(void)sdo_sys(SDO_SI_FAILURE, NULL, NULL);
+	(void)remove(file_name);
+	(void)rmdir(dir);
+}
+#endif
+
+#ifdef TARGET_OS_LINUX
+/*** Unity functions. ***/
+void set_up(void)
+{
+}
+
+void tear_down(void)
+{
+}
+#endif
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("sdo_sys_file_sha256", "[sdo_sys][sdo]")
+#else
+void test_sdo_sys_file_sha256(void)
+#endif
+{
+#ifdef MODULES_ENABLED
+	uint8_t sha256[SHA256_DIGEST_SIZE];
+
+	sys_file_setup();
+	TEST_ASSERT_EQUAL_INT(0, crypto_hal_hash(SDO_CRYPTO_HASH_TYPE_SHA_256,
+						 file_data, sizeof(file_data),
+						 sha256, sizeof(sha256)));
+
+	TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS,
+			      set_osi_str("filedesc", file_name));
+	TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS,
+			      set_osi_str("filesize", FILE_RESERVE));
+	TEST_ASSERT_EQUAL_INT(atoi(FILE_RESERVE), (int)file_size());
+	TEST_ASSERT_EQUAL_INT(SDO_SI_CONTENT_ERROR,
+			      set_osi_str("filesize", "12x"));
+	write_file(0, sizeof(file_data));
+
+	/* The space reserved beyond what was written is given back */
+	TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS,
+			      set_osi("sha256", sha256, sizeof(sha256)));
+	check_file(sizeof(file_data));
+
+	/* The file is complete: there is nothing left to check */
+	TEST_ASSERT_EQUAL_INT(SDO_SI_CONTENT_ERROR,
+			      set_osi("sha256", sha256, sizeof(sha256)));
+	TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS, sdo_sys(SDO_SI_END, NULL, NULL));
+	check_file(sizeof(file_data));
+	sys_file_cleanup();
+#else
+	TEST_IGNORE_MESSAGE("built without MODULES");
+#endif
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("sdo_sys_file_sha256_mismatch", "[sdo_sys][sdo]")
+#else
+void test_sdo_sys_file_sha256_mismatch(void)
+#endif
+{
+#ifdef MODULES_ENABLED
+	uint8_t sha256[SHA256_DIGEST_SIZE];
+
+	sys_file_setup();
+	TEST_ASSERT_EQUAL_INT(0, crypto_hal_hash(SDO_CRYPTO_HASH_TYPE_SHA_256,
+						 file_data, sizeof(file_data),
+						 sha256, sizeof(sha256)));
+
+	/* One byte short of what the digest was taken over */
+	TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS,
+			      set_osi_str("filedesc", file_name));
+	write_file(0, sizeof(file_data) - 1);
+	TEST_ASSERT_EQUAL_INT(SDO_SI_CONTENT_ERROR,
+			      set_osi("sha256", sha256, sizeof(sha256)));
+	TEST_ASSERT_EQUAL_INT(-1, (int)file_size());
+
+	/* A digest of the wrong length does not match either */
+	TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS,
+			      set_osi_str("filedesc", file_name));
+	write_file(0, sizeof(file_data));
+	TEST_ASSERT_EQUAL_INT(SDO_SI_CONTENT_ERROR,
+			      set_osi("sha256", sha256, sizeof(sha256) - 1));
+	TEST_ASSERT_EQUAL_INT(-1, (int)file_size());
+	sys_file_cleanup();
+#else
+	TEST_IGNORE_MESSAGE("built without MODULES");
+#endif
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("sdo_sys_file_end", "[sdo_sys][sdo]")
+#else
+void test_sdo_sys_file_end(void)
+#endif
+{
+#ifdef MODULES_ENABLED
+	sys_file_setup();
+	/* Still buffered when service info ends, written out by END */
+	TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS,
+			      set_osi_str("filedesc", file_name));
+	TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS,
+			      set_osi_str("filesize", FILE_RESERVE));
+	write_file(0, 1000);
+	TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS, sdo_sys(SDO_SI_END, NULL, NULL));
+	check_file(1000);
+
+	/* END closed the file */
+	TEST_ASSERT_EQUAL_INT(SDO_SI_INTERNAL_ERROR,
+			      set_osi("write", file_data, 1));
+	check_file(1000);
+	sys_file_cleanup();
+#else
+	TEST_IGNORE_MESSAGE("built without MODULES");
+#endif
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("sdo_sys_file_failure", "[sdo_sys][sdo]")
+#else
+void test_sdo_sys_file_failure(void)
+#endif
+{
+#ifdef MODULES_ENABLED
+	sys_file_setup();
+	TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS,
+			      set_osi_str("filedesc", file_name));
+	write_file(0, 100000);
+	TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS,
+			      sdo_sys(SDO_SI_FAILURE, NULL, NULL));
+
+	/* The file is abandoned: later messages find nothing open */
+	TEST_ASSERT_EQUAL_INT(SDO_SI_INTERNAL_ERROR,
+			      set_osi("write", file_data, 1));
+	TEST_ASSERT_EQUAL_INT(SDO_SI_CONTENT_ERROR,
+			      set_osi("sha256", file_data, SHA256_DIGEST_SIZE));
+	TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS, sdo_sys(SDO_SI_END, NULL, NULL));
+	TEST_ASSERT_TRUE(file_size() <= 100000);
+	sys_file_cleanup();
+#else
+	TEST_IGNORE_MESSAGE("built without MODULES");
+#endif
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Unit tests for the SDK contexts.
+ */
+
+#include "util.h"
+#include "sdoctx.h"
+#include "sdoCryptoCtx.h"
+#include "sdoCrypto.h"
+#include "rest_interface.h"
+#include "unity.h"
+#include <pthread.h>
+#include <sched.h>
+
+#ifdef TARGET_OS_LINUX
+/*** Unity Declarations. ***/
+void set_up(void);
+void tear_down(void);
+void test_sdoctx_isolation(void);
+void test_sdoctx_free_unbinds(void);
+void test_sdoctx_threads(void);
+
+/*** Unity functions. ***/
+void set_up(void)
+{
+}
+
+void tear_down(void)
+{
+}
+#endif
+
+#define TEST_CTX_THREADS 8
+#define TEST_CTX_ROUNDS 200
+
+/**
+ * Internal API
+ * Give the REST context of the bound SDK context a port of its own.
+ */
+static void rest_open(uint16_t port)
+{
+	TEST_ASSERT_NULL(get_rest_context());
+	TEST_ASSERT_TRUE(init_rest_context());
+	TEST_ASSERT_TRUE(cache_host_port(port));
+}
+
+#ifndef TARGET_OS_FREERTOS
+void test_sdoctx_isolation(void)
+#else
+TEST_CASE("sdoctx_isolation", "[sdoctx][sdo]")
+#endif
+{
+	sdo_sdk_ctx *a = sdo_sdk_ctx_new();
+	sdo_sdk_ctx *b = sdo_sdk_ctx_new();
+	sdo_sdk_retry_policy slow = {5000, 6000, 1};
+
+	TEST_ASSERT_NOT_NULL(a);
+	TEST_ASSERT_NOT_NULL(b);
+	TEST_ASSERT_NOT_NULL(sdo_ctx_current());
+
+	/* new contexts start out with the default retry policies */
+	TEST_ASSERT_EQUAL_UINT32(SDO_RETRY_CONNECT_BASE_MS,
+				 a->retry_policy[SDO_RETRY_CONNECT].base_ms);
+
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_ctx_use(a));
+	TEST_ASSERT_EQUAL_PTR(a, sdo_ctx_current());
+	rest_open(1111);
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS,
+			      sdo_sdk_set_retry_policy(SDO_RETRY_TO1, &slow));
+	get_keyset()->sek = (sdo_byte_array_t *)a;
+
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_ctx_use(b));
+	TEST_ASSERT_EQUAL_PTR(b, sdo_ctx_current());
+	rest_open(2222);
+	TEST_ASSERT_NULL(get_keyset()->sek);
+	TEST_ASSERT_EQUAL_UINT32(SDO_RETRY_PROTOCOL_BASE_MS,
+				 b->retry_policy[SDO_RETRY_TO1].base_ms);
+
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_ctx_use(a));
+	TEST_ASSERT_EQUAL_UINT16(1111, get_rest_context()->portno);
+	TEST_ASSERT_EQUAL_PTR(a, get_keyset()->sek);
+	TEST_ASSERT_EQUAL_UINT32(5000, a->retry_policy[SDO_RETRY_TO1].base_ms);
+	get_keyset()->sek = NULL;
+	exit_rest_context();
+
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_ctx_use(b));
+	TEST_ASSERT_EQUAL_UINT16(2222, get_rest_context()->portno);
+	exit_rest_context();
+
+	/* NULL goes back to the default context, which a and b did not touch */
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_ctx_use(NULL));
+	TEST_ASSERT_NULL(get_rest_context());
+
+	sdo_sdk_ctx_free(a);
+	sdo_sdk_ctx_free(b);
+}
+
+#ifndef TARGET_OS_FREERTOS
+void test_sdoctx_free_unbinds(void)
+#else
+TEST_CASE("sdoctx_free_unbinds", "[sdoctx][sdo]")
+#endif
+{
+	sdo_sdk_ctx *ctx = sdo_sdk_ctx_new();
+	sdo_sdk_ctx *dflt = sdo_ctx_current();
+
+	TEST_ASSERT_NOT_NULL(ctx);
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_ctx_use(ctx));
+	TEST_ASSERT_EQUAL_PTR(ctx, sdo_ctx_current());
+	sdo_sdk_ctx_free(ctx);
+	TEST_ASSERT_EQUAL_PTR(dflt, sdo_ctx_current());
+	sdo_sdk_ctx_free(NULL);
+}
+
+/**
+ * Internal API
+ * Thread body: bind a context of its own and keep checking that nothing
+ * written by the other threads shows through.
+ */
+static void *ctx_worker(void *arg)
+{
+	uint16_t port = (uint16_t)(uintptr_t)arg;
+	sdo_sdk_ctx *ctx = sdo_sdk_ctx_new();
+	uintptr_t failures = 0;
+	int i;
+
+	if (!ctx || sdo_sdk_ctx_use(ctx) != SDO_SUCCESS ||
+	    !init_rest_context())
+		return (void *)1;
+
+	for (i = 0; i < TEST_CTX_ROUNDS; i++) {
+		if (!cache_host_port((uint16_t)(port + i)) ||
+		    sdo_sdk_set_retry_budget(port) != SDO_SUCCESS)
+			failures++;
+		sched_yield();
+		if (get_rest_context()->portno != (uint16_t)(port + i) ||
+		    ctx->retry_budget_ms != port)
+			failures++;
+	}
+
+	exit_rest_context();
+	sdo_sdk_ctx_free(ctx);
+	return (void *)failures;
+}
+
+#ifndef TARGET_OS_FREERTOS
+void test_sdoctx_threads(void)
+#else
+TEST_CASE("sdoctx_threads", "[sdoctx][sdo]")
+#endif
+{
+	pthread_t threads[TEST_CTX_THREADS];
+	void *failures = NULL;
+	int i;
+
+	for (i = 0; i < TEST_CTX_THREADS; i++)
+		TEST_ASSERT_EQUAL_INT(
+		    0, pthread_create(&threads[i], NULL, ctx_worker,
+				      (void *)(uintptr_t)(1000 * (i + 1))));
+
+	for (i = 0; i < TEST_CTX_THREADS; i++) {
+		TEST_ASSERT_EQUAL_INT(0, pthread_join(threads[i], &failures));
+		TEST_ASSERT_NULL(failures);
+	}
+
+	/* the workers never touched the default context */
+	TEST_ASSERT_NULL(get_rest_context());
+}
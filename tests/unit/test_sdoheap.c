@@ -0,0 +1,147 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Unit tests for the accounting of the heap of sdo_alloc().
+ */
+
+#include "util.h"
+#include "sdoheap.h"
+#include "sdoprot.h"
+#include "sdo.h"
+#include "unity.h"
+
+#ifdef TARGET_OS_LINUX
+/*** Unity Declarations. ***/
+void set_up(void);
+void tear_down(void);
+void test_heap_size_class(void);
+void test_heap_accounting(void);
+void test_heap_budget(void);
+
+/*** Unity functions. ***/
+void set_up(void)
+{
+}
+
+void tear_down(void)
+{
+}
+#endif
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("heap_size_class", "[heap][sdo]")
+#else
+void test_heap_size_class(void)
+#endif
+{
+	TEST_ASSERT_EQUAL_UINT32(0, sdo_heap_size_class(0));
+	TEST_ASSERT_EQUAL_UINT32(0, sdo_heap_size_class(16));
+	TEST_ASSERT_EQUAL_UINT32(1, sdo_heap_size_class(17));
+	TEST_ASSERT_EQUAL_UINT32(1, sdo_heap_size_class(32));
+	TEST_ASSERT_EQUAL_UINT32(6, sdo_heap_size_class(1024));
+	TEST_ASSERT_EQUAL_UINT32(SDO_HEAP_SIZE_CLASSES - 2,
+				 sdo_heap_size_class(16 << 14));
+	TEST_ASSERT_EQUAL_UINT32(SDO_HEAP_SIZE_CLASSES - 1,
+				 sdo_heap_size_class((16 << 14) + 1));
+	TEST_ASSERT_EQUAL_UINT32(SDO_HEAP_SIZE_CLASSES - 1,
+				 sdo_heap_size_class((size_t)-1));
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("heap_accounting", "[heap][sdo]")
+#else
+void test_heap_accounting(void)
+#endif
+{
+	static sdo_sdk_heap_stats before, s;
+#ifdef HEAP_TRACK_ENABLED
+	uint8_t *buf[64];
+	uint8_t *p;
+	int i;
+
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_get_heap_stats(&before));
+	sdo_heap_set_msg(SDO_TO2_GET_NEXT_OWNER_SERVICE_INFO);
+
+	for (i = 0; i < 64; i++) {
+		buf[i] = sdo_alloc(100);
+		TEST_ASSERT_NOT_NULL(buf[i]);
+	}
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_get_heap_stats(&s));
+	TEST_ASSERT_EQUAL_UINT64(before.total.live_bytes + 6400,
+				 s.total.live_bytes);
+	TEST_ASSERT_EQUAL_UINT64(before.live_allocs + 64, s.live_allocs);
+	TEST_ASSERT_EQUAL_UINT64(before.size_class[3] + 64, s.size_class[3]);
+	TEST_ASSERT_EQUAL_UINT64(
+	    before.msg[SDO_TO2_GET_NEXT_OWNER_SERVICE_INFO].live_bytes + 6400,
+	    s.msg[SDO_TO2_GET_NEXT_OWNER_SERVICE_INFO].live_bytes);
+	TEST_ASSERT_EQUAL_UINT64(
+	    before.phase[SDO_STATS_TO2].live_bytes + 6400,
+	    s.phase[SDO_STATS_TO2].live_bytes);
+	TEST_ASSERT_TRUE(s.total.peak_bytes >= s.total.live_bytes);
+
+	/* A resize moves the bytes, and the old address is no longer known */
+	p = sdo_realloc(buf[0], 300);
+	TEST_ASSERT_NOT_NULL(p);
+	buf[0] = p;
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_get_heap_stats(&s));
+	TEST_ASSERT_EQUAL_UINT64(before.total.live_bytes + 6600,
+				 s.total.live_bytes);
+
+	for (i = 0; i < 64; i++)
+		sdo_free(buf[i]);
+	sdo_heap_set_msg(0);
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_get_heap_stats(&s));
+	TEST_ASSERT_EQUAL_UINT64(before.total.live_bytes, s.total.live_bytes);
+	TEST_ASSERT_EQUAL_UINT64(before.live_allocs, s.live_allocs);
+	TEST_ASSERT_EQUAL_UINT64(before.frees + 65, s.frees);
+
+	/* Memory sdo_alloc() did not return is freed but not counted */
+	p = malloc(8);
+	TEST_ASSERT_NOT_NULL(p);
+	sdo_free(p);
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_get_heap_stats(&s));
+	TEST_ASSERT_EQUAL_UINT64(before.frees + 65, s.frees);
+#else
+	(void)before;
+	TEST_ASSERT_EQUAL_INT(SDO_ERROR, sdo_sdk_get_heap_stats(&s));
+#endif
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("heap_budget", "[heap][sdo]")
+#else
+void test_heap_budget(void)
+#endif
+{
+#ifdef HEAP_TRACK_ENABLED
+	static sdo_sdk_heap_stats s;
+	uint8_t *p, *q;
+	uint64_t live, over;
+
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_get_heap_stats(&s));
+	live = s.total.live_bytes;
+	over = s.over_budget;
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS,
+			      sdo_sdk_set_heap_budget(live + 1000));
+
+	p = sdo_alloc(600);
+	TEST_ASSERT_NOT_NULL(p);
+	TEST_ASSERT_NULL(sdo_alloc(600));
+	/* A resize counts the bytes it gives back */
+	q = sdo_realloc(p, 1000);
+	TEST_ASSERT_NOT_NULL(q);
+	TEST_ASSERT_NULL(sdo_realloc(q, 1001));
+	sdo_free(q);
+
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_set_heap_budget(0));
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_get_heap_stats(&s));
+	TEST_ASSERT_EQUAL_UINT64(over + 2, s.over_budget);
+	TEST_ASSERT_EQUAL_UINT64(live, s.total.live_bytes);
+#else
+	TEST_ASSERT_EQUAL_INT(SDO_ERROR, sdo_sdk_set_heap_budget(1000));
+#endif
+}
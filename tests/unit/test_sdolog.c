@@ -0,0 +1,184 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Unit tests for the deferred formatting of the log ring.
+ */
+
+#include "util.h"
+#include "sdolog.h"
+#include "sdo.h"
+#include "unity.h"
+
+#ifdef LOG_RING_ENABLED
+#include <unistd.h>
+#endif
+
+#ifdef TARGET_OS_LINUX
+/*** Unity Declarations. ***/
+void set_up(void);
+void tear_down(void);
+void test_log_render_formats(void);
+void test_log_render_truncated(void);
+void test_log_dump(void);
+
+/*** Unity functions. ***/
+void set_up(void)
+{
+}
+
+void tear_down(void)
+{
+}
+#endif
+
+/* sdo_log_encode() of the arguments given */
+static size_t log_encode(uint8_t *args, bool *truncated, const char *fmt, ...)
+{
+	size_t len;
+	va_list ap;
+
+	va_start(ap, fmt);
+	len = sdo_log_encode(args, SDO_LOG_ARG_BYTES, fmt, ap, truncated);
+	va_end(ap);
+	return len;
+}
+
+/* sdo_log_render() of a record, in a string to free */
+static char *log_render(const char *fmt, const uint8_t *args, size_t len,
+			bool truncated)
+{
+	FILE *f = tmpfile();
+	char *out;
+	long n;
+
+	TEST_ASSERT_NOT_NULL(f);
+	sdo_log_render(f, fmt, args, len, truncated);
+	n = ftell(f);
+	TEST_ASSERT_TRUE(n >= 0);
+	out = calloc(1, (size_t)n + 1);
+	TEST_ASSERT_NOT_NULL(out);
+	rewind(f);
+	TEST_ASSERT_EQUAL_UINT32(n, fread(out, 1, (size_t)n, f));
+	TEST_ASSERT_EQUAL_INT(0, fclose(f));
+	return out;
+}
+
+/* Store the arguments, format them back, and compare with printf() */
+static void log_check(const char *fmt, ...)
+{
+	uint8_t args[SDO_LOG_ARG_BYTES];
+	char want[512];
+	char *got;
+	size_t len;
+	bool truncated;
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void)vsnprintf(want, sizeof(want), fmt, ap);
+	va_end(ap);
+
+	va_start(ap, fmt);
+	len = sdo_log_encode(args, sizeof(args), fmt, ap, &truncated);
+	va_end(ap);
+	TEST_ASSERT_FALSE(truncated);
+
+	got = log_render(fmt, args, len, truncated);
+	TEST_ASSERT_EQUAL_STRING(want, got);
+	free(got);
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("log_render_formats", "[log][sdo]")
+#else
+void test_log_render_formats(void)
+#endif
+{
+	const char *body = "0123456789";
+
+	log_check("no arguments\n");
+	log_check("%d %i %u %x %X %o\n", -42, 7, 42u, 0xbeefu, 0xbeefu, 8u);
+	log_check("[%5d|%-5d|%05d|%+d|% d]\n", 42, 42, 42, 42, 42);
+	log_check("%hhx %hd %ld %lld %zu %jd\n", 0x1ff, (short)-3, -5L,
+		  -1234567890123LL, (size_t)99, (intmax_t)-7);
+	log_check("%lu %llx %#x %#o\n", 3000000000UL, 0xfedcba9876ULL, 255u,
+		  8u);
+	log_check("%s|%.3s|%10s|%-10s|\n", "abc", "abcdef", "right", "left");
+	log_check("%.*s\n", 4, body);
+	log_check("%*d|%-*d|%*d|\n", 6, 1, 6, 2, -6, 3);
+	log_check("%c%c %% %p\n", 'o', 'k', (void *)body);
+	log_check("%f %.2e %g %8.3f\n", 3.5, 12345.678, 0.0001, -2.25);
+	log_check("ERROR:[%s:%d] %s failed to allocate\n", __FILE__, __LINE__,
+		  __func__);
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("log_render_truncated", "[log][sdo]")
+#else
+void test_log_render_truncated(void)
+#endif
+{
+	uint8_t args[SDO_LOG_ARG_BYTES];
+	char big[2 * SDO_LOG_ARG_BYTES];
+	char *got;
+	size_t len;
+	bool truncated;
+
+	memset(big, 'x', sizeof(big) - 1);
+	big[sizeof(big) - 1] = '\0';
+
+	/* The string takes what is left; the number after it is lost */
+	len = log_encode(args, &truncated, "body %d %s %d\n", 1, big, 5);
+	TEST_ASSERT_TRUE(truncated);
+	TEST_ASSERT_EQUAL_UINT32(sizeof(args), len);
+
+	got = log_render("body %d %s %d\n", args, len, truncated);
+	TEST_ASSERT_EQUAL_UINT32(strlen("body 1 ") + SDO_LOG_ARG_BYTES - 8 -
+				     2 + strlen(" [...]\n"),
+				 strlen(got));
+	TEST_ASSERT_EQUAL_INT(0, strncmp(got, "body 1 xxx", 10));
+	TEST_ASSERT_EQUAL_STRING("x [...]\n", got + strlen(got) - 8);
+	free(got);
+
+	/* A precision keeps the rest of the record */
+	len = log_encode(args, &truncated, "%.4s|%d\n", big, 5);
+	TEST_ASSERT_FALSE(truncated);
+	got = log_render("%.4s|%d\n", args, len, truncated);
+	TEST_ASSERT_EQUAL_STRING("xxxx|5\n", got);
+	free(got);
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("log_dump", "[log][sdo]")
+#else
+void test_log_dump(void)
+#endif
+{
+#ifdef LOG_RING_ENABLED
+	char path[] = "/tmp/test_sdolog_XXXXXX";
+	char line[128];
+	bool found = false;
+	FILE *f;
+	int fd;
+
+	LOG(LOG_DEBUG, "test_log_dump marker %d\n", 1234);
+
+	fd = mkstemp(path);
+	TEST_ASSERT_TRUE(fd >= 0);
+	(void)close(fd);
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_log_dump(path));
+	f = fopen(path, "r");
+	TEST_ASSERT_NOT_NULL(f);
+	while (fgets(line, sizeof(line), f))
+		if (strstr(line, "test_log_dump marker 1234"))
+			found = true;
+	(void)fclose(f);
+	(void)remove(path);
+	TEST_ASSERT_TRUE(found);
+#else
+	TEST_ASSERT_EQUAL_INT(SDO_ERROR, sdo_sdk_log_dump(NULL));
+#endif
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2020 Intel Corporation
+ * SPDX-License-Identifier: Apache 2.0
+ */
+
+/*!
+ * \file
+ * \brief Unit tests for the statistics of SDO library.
+ */
+
+#include "util.h"
+#include "sdostats.h"
+#include "sdoprot.h"
+#include "unity.h"
+
+#ifdef TARGET_OS_LINUX
+/*** Unity Declarations. ***/
+void set_up(void);
+void tear_down(void);
+void test_stats_buckets(void);
+void test_stats_percentile(void);
+void test_stats_counters(void);
+
+/*** Unity functions. ***/
+void set_up(void)
+{
+}
+
+void tear_down(void)
+{
+}
+#endif
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("stats_buckets", "[stats][sdo]")
+#else
+void test_stats_buckets(void)
+#endif
+{
+	uint64_t us;
+	uint32_t b;
+
+	TEST_ASSERT_EQUAL_UINT32(0, sdo_stats_bucket_of(0));
+	TEST_ASSERT_EQUAL_UINT32(3, sdo_stats_bucket_of(3));
+	TEST_ASSERT_EQUAL_UINT32(4, sdo_stats_bucket_of(4));
+	TEST_ASSERT_EQUAL_UINT32(7, sdo_stats_bucket_of(7));
+	TEST_ASSERT_EQUAL_UINT32(8, sdo_stats_bucket_of(8));
+	TEST_ASSERT_EQUAL_UINT32(8, sdo_stats_bucket_of(9));
+	TEST_ASSERT_EQUAL_UINT32(SDO_STATS_HIST_BUCKETS - 1,
+				 sdo_stats_bucket_of(UINT64_MAX));
+
+	/* Each bucket starts where the one before ends */
+	for (b = 0; b < SDO_STATS_HIST_BUCKETS; b++) {
+		us = sdo_sdk_stats_bucket(b);
+		TEST_ASSERT_EQUAL_UINT32(b, sdo_stats_bucket_of(us));
+		if (b)
+			TEST_ASSERT_EQUAL_UINT32(b - 1,
+						 sdo_stats_bucket_of(us - 1));
+	}
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX,
+				 sdo_sdk_stats_bucket(SDO_STATS_HIST_BUCKETS));
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("stats_percentile", "[stats][sdo]")
+#else
+void test_stats_percentile(void)
+#endif
+{
+	sdo_sdk_stats s;
+	const sdo_sdk_latency_hist *h = &s.msg_latency[SDO_TO2_PROVE_DEVICE];
+	int i;
+
+	sdo_sdk_reset_stats();
+	/* 98 fast round trips and 2 slow ones */
+	for (i = 0; i < 98; i++)
+		sdo_stats_round_trip(SDO_TO2_PROVE_DEVICE, 1000);
+	sdo_stats_round_trip(SDO_TO2_PROVE_DEVICE, 50000);
+	sdo_stats_round_trip(SDO_TO2_PROVE_DEVICE, 50000);
+
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_get_stats(&s));
+	TEST_ASSERT_EQUAL_UINT32(100, h->count);
+	TEST_ASSERT_EQUAL_UINT64(98 * 1000 + 2 * 50000, h->sum_us);
+	TEST_ASSERT_TRUE(sdo_sdk_stats_percentile(h, 50) >= 1000);
+	TEST_ASSERT_TRUE(sdo_sdk_stats_percentile(h, 50) < 1250);
+	TEST_ASSERT_TRUE(sdo_sdk_stats_percentile(h, 99) >= 50000);
+	TEST_ASSERT_TRUE(sdo_sdk_stats_percentile(h, 99) < 62500);
+	TEST_ASSERT_EQUAL_UINT64(0, sdo_sdk_stats_percentile(
+					&s.msg_latency[SDO_TO2_DONE], 50));
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("stats_counters", "[stats][sdo]")
+#else
+void test_stats_counters(void)
+#endif
+{
+	sdo_sdk_stats s;
+
+	sdo_sdk_reset_stats();
+	sdo_stats_round_trip(SDO_DI_APP_START, 10);
+	sdo_stats_round_trip(SDO_TO1_TYPE_HELLO_SDO, 10);
+	sdo_stats_round_trip(SDO_TO2_DONE2, 10);
+	sdo_stats_round_trip(SDO_TYPE_ERROR, 10);
+	sdo_stats_bytes_sent(100);
+	sdo_stats_bytes_received(200);
+	sdo_stats_connect(true);
+	sdo_stats_connect(false);
+	sdo_stats_dns_lookup();
+	sdo_stats_retry(SDO_RETRY_NETIO);
+	sdo_stats_retry(SDO_RETRY_PHASE_MAX);
+	sdo_stats_crypto(SDO_STATS_HMAC);
+
+	TEST_ASSERT_EQUAL_INT(SDO_ERROR, sdo_sdk_get_stats(NULL));
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_get_stats(&s));
+	TEST_ASSERT_EQUAL_UINT64(1, s.round_trips[SDO_STATS_DI]);
+	TEST_ASSERT_EQUAL_UINT64(1, s.round_trips[SDO_STATS_TO1]);
+	TEST_ASSERT_EQUAL_UINT64(1, s.round_trips[SDO_STATS_TO2]);
+	TEST_ASSERT_EQUAL_UINT64(100, s.bytes_sent);
+	TEST_ASSERT_EQUAL_UINT64(200, s.bytes_received);
+	TEST_ASSERT_EQUAL_UINT64(1, s.connections);
+	TEST_ASSERT_EQUAL_UINT64(1, s.connect_failures);
+	TEST_ASSERT_EQUAL_UINT64(1, s.dns_lookups);
+	TEST_ASSERT_EQUAL_UINT64(1, s.retries[SDO_RETRY_NETIO]);
+	TEST_ASSERT_EQUAL_UINT64(1, s.crypto_ops[SDO_STATS_HMAC]);
+
+	sdo_sdk_reset_stats();
+	TEST_ASSERT_EQUAL_INT(SDO_SUCCESS, sdo_sdk_get_stats(&s));
+	TEST_ASSERT_EQUAL_UINT64(0, s.bytes_sent);
+	TEST_ASSERT_EQUAL_UINT32(0, s.msg_latency[SDO_TO2_DONE2].count);
+}
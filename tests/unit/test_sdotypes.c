@@ -6,6 +6,8 @@
 #include "sdoCryptoHal.h"
 #include "util.h"
 #include "sdo.h"
+#include "sdoosi.h"
+#include "network_al.h"
 #include <stdlib.h>
 #include <inttypes.h>
 #include "safe_lib.h"
@@ -74,10 +76,15 @@ void test_sdo_kv_alloc_with_str(void);
 void test_sdo_service_info_alloc_with(void);
 void test_sdo_service_info_add_kv_str(void);
 void test_sdo_service_info_add_kv(void);
+void test_sdo_service_info_table(void);
 void test_psiparsing(void);
 void test_sdo_get_module_name_msg_value(void);
 void test_sdo_mod_data_kv(void);
 void test_sdo_osi_parsing(void);
+void test_sdo_osi_parsing_v2(void);
+void test_sdo_osi_async_failure(void);
+void test_psiparsing_v2(void);
+void test_sdo_sv_info_index(void);
 static int cb(sdo_sdk_si_type type, int *count, sdo_sdk_si_key_value *si);
 void test_sdo_get_dsi_count(void);
 void test_sdo_supply_moduleOSI(void);
@@ -1510,6 +1517,56 @@ void test_sdo_service_info_add_kv(void)
 	TEST_ASSERT_TRUE(ret);
 }
 
+#define TEST_SI_KEYS 40
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("sdo_service_info_table", "[sdo_types][sdo]")
+#else
+void test_sdo_service_info_table(void)
+#endif
+{
+	sdo_service_info_t *si = sdo_service_info_alloc();
+	char key[16];
+	char val[16];
+	sdow_t sdow;
+	int i;
+
+	TEST_ASSERT_NOT_NULL(si);
+	TEST_ASSERT_NULL(*sdo_service_info_get(si, 0));
+	TEST_ASSERT_NULL(*sdo_service_info_fetch(si, "key0"));
+
+	/* enough keys to grow the table a few times */
+	for (i = 0; i < TEST_SI_KEYS; i++) {
+		snprintf(key, sizeof(key), "Key%d", i);
+		snprintf(val, sizeof(val), "v\"%d", i);
+		TEST_ASSERT_TRUE(sdo_service_info_add_kv_str(si, key, val));
+	}
+	TEST_ASSERT_EQUAL_INT(TEST_SI_KEYS, si->numKV);
+
+	/* insertion order, keys looked up without case */
+	for (i = 0; i < TEST_SI_KEYS; i++) {
+		snprintf(key, sizeof(key), "kEY%d", i);
+		TEST_ASSERT_EQUAL_PTR(*sdo_service_info_get(si, i),
+				      *sdo_service_info_fetch(si, key));
+	}
+	TEST_ASSERT_NULL(*sdo_service_info_get(si, TEST_SI_KEYS));
+	TEST_ASSERT_NULL(*sdo_service_info_fetch(si, "key"));
+
+	/* an update replaces the value in place */
+	TEST_ASSERT_TRUE(sdo_service_info_add_kv_str(si, "KEY7", "longer value"));
+	TEST_ASSERT_EQUAL_INT(TEST_SI_KEYS, si->numKV);
+	TEST_ASSERT_EQUAL_STRING("longer value",
+				 (*sdo_service_info_get(si, 7))->val->bytes);
+
+	/* the precomputed size is what gets written */
+	TEST_ASSERT_TRUE(sdow_init(&sdow));
+	TEST_ASSERT_TRUE(sdo_combine_platform_dsis(&sdow, si));
+	TEST_ASSERT_EQUAL_UINT(si->write_sz, sdow.b.cursor);
+
+	sdo_free(sdow.b.block);
+	sdo_service_info_free(si);
+}
+
 #ifdef TARGET_OS_FREERTOS
 TEST_CASE("psiparsing", "[sdo_types][sdo]")
 #else
@@ -1760,7 +1817,7 @@ void test_sdo_osi_parsing(void)
 #endif
 {
 	sdor_t test_sdor;
-	sdo_sdk_si_key_value kv;
+	sdo_sdk_si_kv_view kv;
 	sdo_sdk_service_info_module_list_t module_list = {0};
 	bool ret;
 	int retval = 0;
@@ -1786,6 +1843,210 @@ void test_sdo_osi_parsing(void)
 	TEST_ASSERT_FALSE(ret);
 }
 
+/* What the v2 module below was handed last */
+static char v2_key[64];
+static char v2_value[256];
+static size_t v2_value_len;
+
+static int cb_v2(sdo_sdk_si_type type, int *count, sdo_sdk_si_kv_view *si)
+{
+	(void)count;
+	if (type != SDO_SI_SET_OSI && type != SDO_SI_SET_PSI)
+		return SDO_SI_SUCCESS;
+	if (si->key.len >= sizeof(v2_key) || si->value.len > sizeof(v2_value))
+		return SDO_SI_CONTENT_ERROR;
+	memset(v2_key, 0, sizeof(v2_key));
+	memcpy(v2_key, si->key.data, si->key.len);
+	memcpy(v2_value, si->value.data, si->value.len);
+	v2_value_len = si->value.len;
+	return SDO_SI_SUCCESS;
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("sdo_osi_parsing_v2", "[sdo_types][sdo]")
+#else
+void test_sdo_osi_parsing_v2(void)
+#endif
+{
+	sdor_t test_sdor = {0};
+	sdo_sdk_si_kv_view kv;
+	sdo_sdk_service_info_module_list_t module_list = {0};
+	int retval = 0;
+	/* "aGVsbG8Ad29ybGQ=" is base64 for "hello\0world" */
+	char in[] = "{\"v2mod:write\":\"aGVsbG8Ad29ybGQ=\"}";
+
+	strcpy_s(module_list.module.module_name, SDO_MODULE_NAME_LEN, "v2mod");
+	module_list.module.service_info_callback_v2 = cb_v2;
+	module_list.module.flags = SDO_SI_FLAG_DECODE_B64;
+
+	test_sdor.b.block = (uint8_t *)in;
+	test_sdor.b.block_size = sizeof(in) - 1;
+	test_sdor.b.block_max = sizeof(in);
+	sdor_begin_object(&test_sdor);
+
+	TEST_ASSERT_TRUE(
+	    sdo_osi_parsing(&test_sdor, &module_list, &kv, &retval));
+	TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS, retval);
+	TEST_ASSERT_EQUAL_STRING("write", v2_key);
+	TEST_ASSERT_EQUAL_UINT(11, v2_value_len);
+	TEST_ASSERT_EQUAL_MEMORY("hello\0world", v2_value, 11);
+	/* decoded in place, into the message buffer */
+	TEST_ASSERT_EQUAL_MEMORY("hello\0world", in + 16, 11);
+	TEST_ASSERT_EQUAL_INT(1, module_list.module_osi_index);
+}
+
+/* The async module fails its first message, a bit after it is queued */
+static int cb_async_fail(sdo_sdk_si_type type, int *count,
+			 sdo_sdk_si_kv_view *si)
+{
+	(void)count;
+	(void)si;
+	if (type != SDO_SI_SET_OSI)
+		return SDO_SI_SUCCESS;
+	sdo_msleep(50);
+	return SDO_SI_CONTENT_ERROR;
+}
+
+static int sync_osi_calls;
+
+static int cb_sync_count(sdo_sdk_si_type type, int *count,
+			 sdo_sdk_si_kv_view *si)
+{
+	(void)count;
+	(void)si;
+	if (type == SDO_SI_SET_OSI)
+		sync_osi_calls++;
+	return SDO_SI_SUCCESS;
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("sdo_osi_async_failure", "[sdo_types][sdo]")
+#else
+void test_sdo_osi_async_failure(void)
+#endif
+{
+	sdor_t test_sdor = {0};
+	sdo_sdk_si_kv_view kv;
+	sdo_sdk_service_info_module_list_t sync_mod = {0};
+	sdo_sdk_service_info_module_list_t module_list = {0};
+	int retval = 0;
+	char in[] = "{\"amod:a\":\"x\",\"smod:b\":\"y\"}";
+
+	strcpy_s(module_list.module.module_name, SDO_MODULE_NAME_LEN, "amod");
+	module_list.module.service_info_callback_v2 = cb_async_fail;
+	module_list.module.flags = SDO_SI_FLAG_ASYNC_OSI;
+	module_list.next = &sync_mod;
+	strcpy_s(sync_mod.module.module_name, SDO_MODULE_NAME_LEN, "smod");
+	sync_mod.module.service_info_callback_v2 = cb_sync_count;
+	sync_osi_calls = 0;
+
+	test_sdor.b.block = (uint8_t *)in;
+	test_sdor.b.block_size = sizeof(in) - 1;
+	test_sdor.b.block_max = sizeof(in);
+	sdor_begin_object(&test_sdor);
+
+	/* the message after the failed one is not handed to its module */
+	TEST_ASSERT_FALSE(
+	    sdo_osi_parsing(&test_sdor, &module_list, &kv, &retval));
+	TEST_ASSERT_EQUAL_INT(SDO_SI_CONTENT_ERROR, retval);
+	TEST_ASSERT_EQUAL_INT(0, sync_osi_calls);
+
+	TEST_ASSERT_FALSE(sdo_osi_async_join(&module_list, &retval));
+	TEST_ASSERT_EQUAL_INT(SDO_SI_CONTENT_ERROR, retval);
+	TEST_ASSERT_NULL(module_list.osi_queue);
+}
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("psiparsing_v2", "[sdo_types][sdo]")
+#else
+void test_psiparsing_v2(void)
+#endif
+{
+	sdo_sdk_service_info_module_list_t module_list = {0};
+	char psi[SDO_MODULE_VALUE_LEN + 64] = "v2mod:maxver~";
+	size_t len = strnlen_s(psi, sizeof(psi));
+	int cbret = 0;
+
+	/* longer than a string module could take */
+	memset(psi + len, 'x', SDO_MODULE_VALUE_LEN + 10);
+	len += SDO_MODULE_VALUE_LEN + 10;
+	strcpy_s(psi + len, sizeof(psi) - len, ",v2mod:minver~1");
+
+	strcpy_s(module_list.module.module_name, SDO_MODULE_NAME_LEN, "v2mod");
+	module_list.module.service_info_callback_v2 = cb_v2;
+	v2_value_len = 0;
+
+	TEST_ASSERT_TRUE(sdo_psi_parsing(&module_list, psi,
+					 strnlen_s(psi, sizeof(psi)) + 1,
+					 &cbret));
+	TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS, cbret);
+	TEST_ASSERT_EQUAL_INT(2, module_list.module_psi_index);
+	TEST_ASSERT_EQUAL_STRING("minver", v2_key);
+	TEST_ASSERT_EQUAL_UINT(1, v2_value_len);
+
+	/* the string module adapter keeps the old value limit */
+	module_list.module.service_info_callback_v2 = NULL;
+	module_list.module.service_info_callback = cb;
+	TEST_ASSERT_FALSE(sdo_psi_parsing(&module_list, psi,
+					  strnlen_s(psi, sizeof(psi)) + 1,
+					  &cbret));
+	TEST_ASSERT_EQUAL_INT(SDO_SI_CONTENT_ERROR, cbret);
+}
+
+#define TEST_INDEX_MODULES 12
+
+#ifdef TARGET_OS_FREERTOS
+TEST_CASE("sdo_sv_info_index", "[sdo_types][sdo]")
+#else
+void test_sdo_sv_info_index(void)
+#endif
+{
+	sdo_sdk_service_info_module_list_t mods[TEST_INDEX_MODULES + 1];
+	char psi[] = "mod7:ver~2,nomod:ver~1,mod11:ver~3";
+	char name[SDO_MODULE_NAME_LEN];
+	int cbret = 0;
+	int i;
+
+	memset(mods, 0, sizeof(mods));
+	for (i = 0; i <= TEST_INDEX_MODULES; i++) {
+		/* the last module has the name of the first one */
+		snprintf(name, sizeof(name), "mod%d",
+			 i % TEST_INDEX_MODULES);
+		strcpy_s(mods[i].module.module_name, SDO_MODULE_NAME_LEN,
+			 name);
+		mods[i].module.service_info_callback_v2 = cb_v2;
+		mods[i].next = i < TEST_INDEX_MODULES ? &mods[i + 1] : NULL;
+	}
+
+	/* the list walk and the index find the same modules */
+	TEST_ASSERT_EQUAL_PTR(&mods[3],
+			      sdo_sv_info_find_module(mods, "mod3:x", 4));
+	TEST_ASSERT_TRUE(sdo_sv_info_index_build(mods));
+	TEST_ASSERT_NOT_NULL(mods[0].index);
+	for (i = 0; i < TEST_INDEX_MODULES; i++) {
+		snprintf(name, sizeof(name), "mod%d:msg", i);
+		TEST_ASSERT_EQUAL_PTR(
+		    &mods[i], sdo_sv_info_find_module(
+				  mods, name, strnlen_s(name, sizeof(name)) - 4));
+	}
+	TEST_ASSERT_EQUAL_PTR(&mods[3],
+			      sdo_sv_info_find_module(mods, "mod3:x", 4));
+	TEST_ASSERT_NULL(sdo_sv_info_find_module(mods, "mod", 3));
+	TEST_ASSERT_NULL(sdo_sv_info_find_module(mods, "mod12", 5));
+
+	TEST_ASSERT_TRUE(sdo_psi_parsing(mods, psi,
+					 strnlen_s(psi, sizeof(psi)) + 1,
+					 &cbret));
+	TEST_ASSERT_EQUAL_INT(SDO_SI_SUCCESS, cbret);
+	TEST_ASSERT_EQUAL_INT(1, mods[7].module_psi_index);
+	TEST_ASSERT_EQUAL_INT(1, mods[11].module_psi_index);
+	TEST_ASSERT_EQUAL_STRING("ver", v2_key);
+	TEST_ASSERT_EQUAL_UINT(1, v2_value_len);
+
+	sdo_sv_info_index_free(mods);
+	TEST_ASSERT_NULL(mods[0].index);
+}
+
 static int cb(sdo_sdk_si_type type, int *count, sdo_sdk_si_key_value *si)
 {
 	(void)type; (void)count; (void)si;
@@ -1832,7 +2093,7 @@ void test_sdo_supply_modulePSI(void)
 {
 	bool ret = 0;
 	int cb_return_val = 0;
-	sdo_sdk_si_key_value sv_kv;
+	sdo_sdk_si_kv_view sv_kv;
 	char mod_name;
 
 	ret = sdo_supply_modulePSI(NULL, NULL, NULL, &cb_return_val);